@@ -15,4 +15,19 @@
 #define FATFS_DISKIO_ENABLE_MSD
 #define FATFS_DISKIO_MSD_DEVICE    1
 
+/* Enable a disk image file backend (host builds) */
+//#define FATFS_DISKIO_ENABLE_IMAGE
+//#define FATFS_DISKIO_IMAGE_DEVICE  2
+//#define FATFS_DISKIO_IMAGE_PATH    "fatfs.img"
+
+/* Sector cache for drives 0 .. FATFS_DISKIO_CACHE_DEVICES-1.  Each
+ * drive uses (SECTORS + FAT_SECTORS + 2 * READ_AHEAD) * 512 bytes of
+ * static memory, 32KB per drive with SECTORS set to 32.  The cache is
+ * disabled when FATFS_DISKIO_CACHE_SECTORS is 0.
+ */
+#define FATFS_DISKIO_CACHE_DEVICES      2
+#define FATFS_DISKIO_CACHE_SECTORS      0
+#define FATFS_DISKIO_CACHE_FAT_SECTORS  16
+#define FATFS_DISKIO_CACHE_READ_AHEAD   8
+
 #endif
@@ -25,11 +25,36 @@ static sSDCARD *sdcardHandle = NULL;
 static sMSD *msdHandle = NULL;
 #endif
 
+#ifdef FATFS_DISKIO_ENABLE_IMAGE
+#include <stdio.h>
+static FILE *imageHandle = NULL;
+#endif
+
 #ifndef FATFS_DISKIO_TIME
 #include <time.h>
 #define FATFS_DISKIO_TIME time
 #endif
 
+#include "diskio_cache.h"
+
+#if FATFS_DISKIO_CACHE_SECTORS > 0
+#ifndef FATFS_DISKIO_CACHE_DEVICES
+#define FATFS_DISKIO_CACHE_DEVICES 2
+#endif
+static DISK_CACHE diskCache[FATFS_DISKIO_CACHE_DEVICES];
+#if FF_FS_REENTRANT
+/* The cache of a drive is shared by everything calling disk_read() and
+ * disk_write(), not just the FatFs volume holding its own lock.
+ */
+static FF_SYNC_t diskCacheLock[FATFS_DISKIO_CACHE_DEVICES];
+#endif
+static DISK_CACHE *disk_cache_get(BYTE pdrv);
+static bool disk_cache_lock(BYTE pdrv);
+static void disk_cache_unlock(BYTE pdrv);
+static DISK_CACHE_RESULT disk_cache_read_cb(void *usr, void *buf, uint32_t sector, uint32_t count);
+static DISK_CACHE_RESULT disk_cache_write_cb(void *usr, const void *buf, uint32_t sector, uint32_t count);
+#endif
+
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
 /*-----------------------------------------------------------------------*/
@@ -54,6 +79,13 @@ DSTATUS disk_status (
                 status = RES_OK;
             }
             break;
+#endif
+#ifdef FATFS_DISKIO_ENABLE_IMAGE
+        case FATFS_DISKIO_IMAGE_DEVICE:
+            if (imageHandle != NULL) {
+                status = RES_OK;
+            }
+            break;
 #endif
         default:
             break;
@@ -90,11 +122,39 @@ DSTATUS disk_initialize (
                 status = RES_OK;
             }
             break;
+#endif
+#ifdef FATFS_DISKIO_ENABLE_IMAGE
+        case FATFS_DISKIO_IMAGE_DEVICE:
+            if (imageHandle == NULL) {
+                imageHandle = fopen(FATFS_DISKIO_IMAGE_PATH, "r+b");
+            }
+            if (imageHandle != NULL) {
+                status = RES_OK;
+            }
+            break;
 #endif
         default:
             break;
     }
 
+#if FATFS_DISKIO_CACHE_SECTORS > 0
+    /* The media may have changed so drop anything cached */
+    if ((status == RES_OK) && (pdrv < FATFS_DISKIO_CACHE_DEVICES)) {
+#if FF_FS_REENTRANT
+        if ((diskCacheLock[pdrv] == NULL) &&
+            !ff_cre_syncobj(pdrv, &diskCacheLock[pdrv])) {
+            return(RES_ERROR);
+        }
+#endif
+        if (!disk_cache_lock(pdrv)) {
+            return(RES_ERROR);
+        }
+        disk_cache_init(&diskCache[pdrv], disk_cache_read_cb,
+            disk_cache_write_cb, (void *)(uintptr_t)pdrv);
+        disk_cache_unlock(pdrv);
+    }
+#endif
+
     return(status);
 }
 
@@ -104,7 +164,7 @@ DSTATUS disk_initialize (
 /* Read Sector(s)                                                        */
 /*-----------------------------------------------------------------------*/
 
-DRESULT disk_read (
+static DRESULT disk_read_device (
     BYTE pdrv,      /* Physical drive nmuber to identify the drive */
     BYTE *buff,     /* Data buffer to store read data */
     LBA_t sector,   /* Start sector in LBA */
@@ -135,6 +195,16 @@ DRESULT disk_read (
                 }
             }
             break;
+#endif
+#ifdef FATFS_DISKIO_ENABLE_IMAGE
+        case FATFS_DISKIO_IMAGE_DEVICE:
+            if (imageHandle) {
+                if ((fseek(imageHandle, (long)sector * FF_MAX_SS, SEEK_SET) == 0) &&
+                    (fread(buff, FF_MAX_SS, count, imageHandle) == count)) {
+                    status = RES_OK;
+                }
+            }
+            break;
 #endif
         default:
             break;
@@ -143,6 +213,28 @@ DRESULT disk_read (
     return(status);
 }
 
+DRESULT disk_read (
+    BYTE pdrv,      /* Physical drive nmuber to identify the drive */
+    BYTE *buff,     /* Data buffer to store read data */
+    LBA_t sector,   /* Start sector in LBA */
+    UINT count      /* Number of sectors to read */
+)
+{
+#if FATFS_DISKIO_CACHE_SECTORS > 0
+    DISK_CACHE *cache = disk_cache_get(pdrv);
+    if (cache) {
+        DISK_CACHE_RESULT result;
+        if (!disk_cache_lock(pdrv)) {
+            return(RES_ERROR);
+        }
+        result = disk_cache_read(cache, buff, sector, count);
+        disk_cache_unlock(pdrv);
+        return((result == DISK_CACHE_OK) ? RES_OK : RES_ERROR);
+    }
+#endif
+    return(disk_read_device(pdrv, buff, sector, count));
+}
+
 
 
 /*-----------------------------------------------------------------------*/
@@ -151,7 +243,7 @@ DRESULT disk_read (
 
 #if FF_FS_READONLY == 0
 
-DRESULT disk_write (
+static DRESULT disk_write_device (
     BYTE pdrv,          /* Physical drive nmuber to identify the drive */
     const BYTE *buff,   /* Data to be written */
     LBA_t sector,       /* Start sector in LBA */
@@ -182,6 +274,16 @@ DRESULT disk_write (
                 }
             }
             break;
+#endif
+#ifdef FATFS_DISKIO_ENABLE_IMAGE
+        case FATFS_DISKIO_IMAGE_DEVICE:
+            if (imageHandle) {
+                if ((fseek(imageHandle, (long)sector * FF_MAX_SS, SEEK_SET) == 0) &&
+                    (fwrite(buff, FF_MAX_SS, count, imageHandle) == count)) {
+                    status = RES_OK;
+                }
+            }
+            break;
 #endif
         default:
             status = RES_ERROR;
@@ -191,6 +293,28 @@ DRESULT disk_write (
     return(status);
 }
 
+DRESULT disk_write (
+    BYTE pdrv,          /* Physical drive nmuber to identify the drive */
+    const BYTE *buff,   /* Data to be written */
+    LBA_t sector,       /* Start sector in LBA */
+    UINT count          /* Number of sectors to write */
+)
+{
+#if FATFS_DISKIO_CACHE_SECTORS > 0
+    DISK_CACHE *cache = disk_cache_get(pdrv);
+    if (cache) {
+        DISK_CACHE_RESULT result;
+        if (!disk_cache_lock(pdrv)) {
+            return(RES_ERROR);
+        }
+        result = disk_cache_write(cache, buff, sector, count);
+        disk_cache_unlock(pdrv);
+        return((result == DISK_CACHE_OK) ? RES_OK : RES_ERROR);
+    }
+#endif
+    return(disk_write_device(pdrv, buff, sector, count));
+}
+
 #endif
 
 
@@ -208,6 +332,20 @@ DRESULT disk_ioctl (
     switch (cmd) {
 
         case CTRL_SYNC:
+#if FATFS_DISKIO_CACHE_SECTORS > 0
+            /* Write back the cache before syncing the device */
+            if (disk_cache_get(pdrv)) {
+                DISK_CACHE_RESULT result;
+                if (!disk_cache_lock(pdrv)) {
+                    break;
+                }
+                result = disk_cache_flush(disk_cache_get(pdrv));
+                disk_cache_unlock(pdrv);
+                if (result != DISK_CACHE_OK) {
+                    break;
+                }
+            }
+#endif
             switch (pdrv) {
 #ifdef FATFS_DISKIO_ENABLE_SDCARD
                 case FATFS_DISKIO_SDCARD_DEVICE:
@@ -222,13 +360,38 @@ DRESULT disk_ioctl (
 #endif
 #ifdef FATFS_DISKIO_ENABLE_MSD
                 case FATFS_DISKIO_MSD_DEVICE:
-                    status = RES_OK;
+                    if (msdHandle) {
+                        MSD_SIMPLE_RESULT result;
+                        result = msd_flush(msdHandle);
+                        if (result == MSD_SIMPLE_SUCCESS) {
+                            status = RES_OK;
+                        }
+                    }
+                    break;
+#endif
+#ifdef FATFS_DISKIO_ENABLE_IMAGE
+                case FATFS_DISKIO_IMAGE_DEVICE:
+                    if (imageHandle && (fflush(imageHandle) == 0)) {
+                        status = RES_OK;
+                    }
                     break;
 #endif
                 default:
                     break;
             }
             break;
+#ifdef FATFS_DISKIO_ENABLE_IMAGE
+        case GET_SECTOR_COUNT:
+            if ((pdrv == FATFS_DISKIO_IMAGE_DEVICE) && imageHandle) {
+                if (fseek(imageHandle, 0, SEEK_END) == 0) {
+                    *(LBA_t *)buff = (LBA_t)(ftell(imageHandle) / FF_MAX_SS);
+                    status = RES_OK;
+                }
+            } else {
+                status = RES_PARERR;
+            }
+            break;
+#endif
         default:
             status = RES_PARERR;
             break;
@@ -239,6 +402,83 @@ DRESULT disk_ioctl (
 
 }
 
+/*-----------------------------------------------------------------------*/
+/* Sector Cache                                                          */
+/*-----------------------------------------------------------------------*/
+
+#if FATFS_DISKIO_CACHE_SECTORS > 0
+
+/* Returns the cache of an initialized drive, NULL if uncached */
+static DISK_CACHE *disk_cache_get (
+    BYTE pdrv
+)
+{
+    if ((pdrv < FATFS_DISKIO_CACHE_DEVICES) && diskCache[pdrv].read) {
+        return(&diskCache[pdrv]);
+    }
+    return(NULL);
+}
+
+/* Serializes access to the cache of a drive, false on timeout */
+static bool disk_cache_lock (
+    BYTE pdrv
+)
+{
+#if FF_FS_REENTRANT
+    return(ff_req_grant(diskCacheLock[pdrv]) != 0);
+#else
+    return(true);
+#endif
+}
+
+static void disk_cache_unlock (
+    BYTE pdrv
+)
+{
+#if FF_FS_REENTRANT
+    ff_rel_grant(diskCacheLock[pdrv]);
+#endif
+}
+
+static DISK_CACHE_RESULT disk_cache_read_cb (
+    void *usr, void *buf, uint32_t sector, uint32_t count
+)
+{
+    DRESULT status;
+    status = disk_read_device((BYTE)(uintptr_t)usr, buf, sector, count);
+    return((status == RES_OK) ? DISK_CACHE_OK : DISK_CACHE_ERROR);
+}
+
+static DISK_CACHE_RESULT disk_cache_write_cb (
+    void *usr, const void *buf, uint32_t sector, uint32_t count
+)
+{
+#if FF_FS_READONLY == 0
+    DRESULT status;
+    status = disk_write_device((BYTE)(uintptr_t)usr, buf, sector, count);
+    return((status == RES_OK) ? DISK_CACHE_OK : DISK_CACHE_ERROR);
+#else
+    return(DISK_CACHE_ERROR);
+#endif
+}
+
+bool disk_cache_get_stats (
+    uint8_t pdrv,               /* Physical drive number */
+    DISK_CACHE_STATS *stats,    /* Returned statistics */
+    bool clear                  /* Clear the statistics */
+)
+{
+    DISK_CACHE *cache = disk_cache_get(pdrv);
+    if ((cache == NULL) || !disk_cache_lock(pdrv)) {
+        return(false);
+    }
+    disk_cache_stats(cache, stats, clear);
+    disk_cache_unlock(pdrv);
+    return(true);
+}
+
+#endif
+
 DWORD get_fattime (void)
 {
     time_t t;
@@ -0,0 +1,415 @@
+/*-----------------------------------------------------------------------*/
+/* Sector cache for the FatFs diskio layer                               */
+/*-----------------------------------------------------------------------*/
+#include <string.h>
+
+#include "diskio_cache.h"
+
+#if FATFS_DISKIO_CACHE_SECTORS > 0
+
+#define SS               FATFS_DISKIO_CACHE_SECTOR_SIZE
+#define STAGE_SECTORS    FATFS_DISKIO_CACHE_READ_AHEAD
+
+#if STAGE_SECTORS > 32
+#error "FATFS_DISKIO_CACHE_READ_AHEAD must not exceed 32"
+#endif
+
+#define LINE_VALID       0x01
+#define LINE_DIRTY       0x02
+
+#define LINE_DATA(c, l)  ((uint8_t *)(c)->data[(l) - (c)->line])
+
+/*-----------------------------------------------------------------------*/
+/* Line management                                                       */
+/*-----------------------------------------------------------------------*/
+
+static DISK_CACHE_LINE *cache_find(DISK_CACHE *cache, uint32_t sector)
+{
+    DISK_CACHE_LINE *l;
+    int i;
+
+    for (i = 0; i < DISK_CACHE_LINES; i++) {
+        l = &cache->line[i];
+        if ((l->flags & LINE_VALID) && (l->sector == sector)) {
+            return(l);
+        }
+    }
+
+    return(NULL);
+}
+
+static void cache_touch(DISK_CACHE *cache, DISK_CACHE_LINE *l)
+{
+    l->lru = ++cache->lruTick;
+}
+
+static bool cache_is_fat(DISK_CACHE *cache, uint32_t sector)
+{
+    return((sector >= cache->fatStart) && (sector < cache->fatEnd));
+}
+
+/* Writes back the run of contiguous dirty sectors containing 'l' */
+static DISK_CACHE_RESULT cache_flush_run(DISK_CACHE *cache,
+    DISK_CACHE_LINE *l)
+{
+    DISK_CACHE_LINE *run[STAGE_SECTORS];
+    DISK_CACHE_LINE *n;
+    DISK_CACHE_RESULT result;
+    uint32_t start;
+    int count;
+    int i;
+
+    /* Find the start of the run */
+    start = l->sector;
+    for (i = 1; (i < STAGE_SECTORS) && (start > 0); i++) {
+        n = cache_find(cache, start - 1);
+        if ((n == NULL) || !(n->flags & LINE_DIRTY)) {
+            break;
+        }
+        start--;
+    }
+
+    /* Collect the run */
+    for (count = 0; count < STAGE_SECTORS; count++) {
+        n = cache_find(cache, start + count);
+        if ((n == NULL) || !(n->flags & LINE_DIRTY)) {
+            break;
+        }
+        run[count] = n;
+    }
+
+    if (count == 1) {
+        result = cache->write(cache->usr, LINE_DATA(cache, run[0]),
+            start, 1);
+    } else {
+        for (i = 0; i < count; i++) {
+            memcpy(cache->writeStage[i], LINE_DATA(cache, run[i]), SS);
+        }
+        result = cache->write(cache->usr, cache->writeStage, start, count);
+    }
+
+    cache->stats.deviceWrites++;
+    if (result == DISK_CACHE_OK) {
+        cache->stats.writeSectors += count;
+        for (i = 0; i < count; i++) {
+            run[i]->flags &= ~LINE_DIRTY;
+        }
+    }
+
+    return(result);
+}
+
+/* Returns a free line for 'sector' from the pool the sector belongs to,
+ * writing back the least recently used line if necessary.
+ */
+static DISK_CACHE_LINE *cache_alloc(DISK_CACHE *cache, uint32_t sector)
+{
+    DISK_CACHE_LINE *victim;
+    DISK_CACHE_LINE *l;
+    int first, last;
+    int i;
+
+    if ((FATFS_DISKIO_CACHE_FAT_SECTORS > 0) && cache_is_fat(cache, sector)) {
+        first = FATFS_DISKIO_CACHE_SECTORS;
+        last = DISK_CACHE_LINES;
+    } else {
+        first = 0;
+        last = FATFS_DISKIO_CACHE_SECTORS;
+    }
+
+    victim = NULL;
+    for (i = first; i < last; i++) {
+        l = &cache->line[i];
+        if (!(l->flags & LINE_VALID)) {
+            victim = l;
+            break;
+        }
+        if ((victim == NULL) || ((int32_t)(l->lru - victim->lru) < 0)) {
+            victim = l;
+        }
+    }
+
+    if (victim->flags & LINE_DIRTY) {
+        if (cache_flush_run(cache, victim) != DISK_CACHE_OK) {
+            return(NULL);
+        }
+    }
+
+    victim->sector = sector;
+    victim->flags = LINE_VALID;
+    cache_touch(cache, victim);
+
+    return(victim);
+}
+
+/*-----------------------------------------------------------------------*/
+/* FAT region detection                                                  */
+/*-----------------------------------------------------------------------*/
+
+static uint16_t ld_word(const uint8_t *p)
+{
+    return((uint16_t)p[0] | ((uint16_t)p[1] << 8));
+}
+
+static uint32_t ld_dword(const uint8_t *p)
+{
+    return((uint32_t)ld_word(p) | ((uint32_t)ld_word(p + 2) << 16));
+}
+
+/* Pins the FAT region of any FAT volume boot record passing through */
+static void cache_check_vbr(DISK_CACHE *cache, const uint8_t *d,
+    uint32_t sector)
+{
+    uint16_t rsvd;
+    uint32_t fatSize;
+    uint8_t numFats;
+
+    if ((d[510] != 0x55) || (d[511] != 0xAA)) {
+        return;
+    }
+    if ((d[0] != 0xEB) && (d[0] != 0xE9)) {
+        return;
+    }
+    if ((memcmp(&d[54], "FAT", 3) != 0) && (memcmp(&d[82], "FAT", 3) != 0)) {
+        return;
+    }
+    if (ld_word(&d[11]) != SS) {
+        return;
+    }
+
+    rsvd = ld_word(&d[14]);
+    numFats = d[16];
+    fatSize = ld_word(&d[22]);
+    if (fatSize == 0) {
+        fatSize = ld_dword(&d[36]);
+    }
+    if ((rsvd == 0) || (numFats == 0) || (numFats > 2) || (fatSize == 0)) {
+        return;
+    }
+
+    disk_cache_set_fat(cache, sector + rsvd, numFats * fatSize);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Public functions                                                      */
+/*-----------------------------------------------------------------------*/
+
+void disk_cache_init(DISK_CACHE *cache, DISK_CACHE_READ read,
+    DISK_CACHE_WRITE write, void *usr)
+{
+    cache->read = read;
+    cache->write = write;
+    cache->usr = usr;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    disk_cache_invalidate(cache);
+}
+
+void disk_cache_invalidate(DISK_CACHE *cache)
+{
+    memset(cache->line, 0, sizeof(cache->line));
+    cache->fatStart = 0;
+    cache->fatEnd = 0;
+    cache->nextSector = 0;
+    cache->lruTick = 0;
+}
+
+void disk_cache_set_fat(DISK_CACHE *cache, uint32_t start, uint32_t count)
+{
+    cache->fatStart = start;
+    cache->fatEnd = start + count;
+}
+
+DISK_CACHE_RESULT disk_cache_read(DISK_CACHE *cache, void *buf,
+    uint32_t sector, uint32_t count)
+{
+    DISK_CACHE_RESULT result;
+    DISK_CACHE_LINE *l;
+    uint8_t *out = buf;
+    uint32_t cached;
+    uint32_t n;
+    uint32_t i;
+
+    /* Stream large reads straight into the caller's buffer once any
+     * dirty sectors in the range have been written back.
+     */
+    if (count >= STAGE_SECTORS) {
+        for (i = 0; i < DISK_CACHE_LINES; i++) {
+            l = &cache->line[i];
+            if ((l->flags & LINE_DIRTY) &&
+                (l->sector >= sector) && (l->sector - sector < count)) {
+                result = cache_flush_run(cache, l);
+                if (result != DISK_CACHE_OK) {
+                    return(result);
+                }
+            }
+        }
+        cache->stats.bypassReads++;
+        cache->stats.deviceReads++;
+        cache->nextSector = sector + count;
+        return(cache->read(cache->usr, buf, sector, count));
+    }
+
+    while (count) {
+        l = cache_find(cache, sector);
+        if (l) {
+            cache->stats.hits++;
+        } else {
+            cache->stats.misses++;
+
+            /* Read ahead on sequential access */
+            n = (sector == cache->nextSector) ? STAGE_SECTORS : count;
+            cache->stats.deviceReads++;
+            result = cache->read(cache->usr, cache->readStage, sector, n);
+            if ((result != DISK_CACHE_OK) && (n > count)) {
+                /* Read ahead may run off the end of the media */
+                n = count;
+                cache->stats.deviceReads++;
+                result = cache->read(cache->usr, cache->readStage, sector, n);
+            }
+            if (result != DISK_CACHE_OK) {
+                return(result);
+            }
+            if (n > count) {
+                cache->stats.readAheads += n - count;
+            }
+
+            /* Fill lines, keeping any (possibly dirty) cached copies.
+             * Cached sectors are noted up front since filling may write
+             * back and evict one, leaving the staged copy stale.
+             */
+            cached = 0;
+            for (i = 0; i < n; i++) {
+                if (cache_find(cache, sector + i)) {
+                    cached |= (1UL << i);
+                }
+            }
+            for (i = 0; i < n; i++) {
+                if (cached & (1UL << i)) {
+                    continue;
+                }
+                cache_check_vbr(cache, (uint8_t *)cache->readStage[i],
+                    sector + i);
+                l = cache_alloc(cache, sector + i);
+                if (l == NULL) {
+                    return(DISK_CACHE_ERROR);
+                }
+                memcpy(LINE_DATA(cache, l), cache->readStage[i], SS);
+            }
+
+            l = cache_find(cache, sector);
+            if (l == NULL) {
+                /* Evicted again by a read ahead larger than its pool */
+                memcpy(out, cache->readStage[0], SS);
+            }
+        }
+
+        if (l) {
+            memcpy(out, LINE_DATA(cache, l), SS);
+            cache_touch(cache, l);
+        }
+
+        cache->nextSector = sector + 1;
+        out += SS;
+        sector++;
+        count--;
+    }
+
+    return(DISK_CACHE_OK);
+}
+
+DISK_CACHE_RESULT disk_cache_write(DISK_CACHE *cache, const void *buf,
+    uint32_t sector, uint32_t count)
+{
+    const uint8_t *in = buf;
+    DISK_CACHE_RESULT result;
+    DISK_CACHE_LINE *l;
+    uint32_t i;
+
+    /* Write large requests straight through.  Cached copies in the
+     * range are refreshed once the device write succeeds, or dropped if
+     * it fails as the media contents are then unknown.
+     */
+    if (count >= STAGE_SECTORS) {
+        cache->stats.bypassWrites++;
+        cache->stats.deviceWrites++;
+        result = cache->write(cache->usr, buf, sector, count);
+        for (i = 0; i < DISK_CACHE_LINES; i++) {
+            l = &cache->line[i];
+            if ((l->flags & LINE_VALID) &&
+                (l->sector >= sector) && (l->sector - sector < count)) {
+                if (result == DISK_CACHE_OK) {
+                    memcpy(LINE_DATA(cache, l),
+                        in + (l->sector - sector) * SS, SS);
+                    l->flags &= ~LINE_DIRTY;
+                } else {
+                    l->flags = 0;
+                }
+            }
+        }
+        return(result);
+    }
+
+    while (count) {
+        cache_check_vbr(cache, in, sector);
+        l = cache_find(cache, sector);
+        if (l == NULL) {
+            l = cache_alloc(cache, sector);
+            if (l == NULL) {
+                return(DISK_CACHE_ERROR);
+            }
+        }
+
+        memcpy(LINE_DATA(cache, l), in, SS);
+        l->flags |= LINE_DIRTY;
+        cache_touch(cache, l);
+
+        in += SS;
+        sector++;
+        count--;
+    }
+
+    return(DISK_CACHE_OK);
+}
+
+DISK_CACHE_RESULT disk_cache_flush(DISK_CACHE *cache)
+{
+    DISK_CACHE_RESULT result;
+    DISK_CACHE_LINE *lowest;
+    DISK_CACHE_LINE *l;
+    int i;
+
+    cache->stats.flushes++;
+
+    /* Write back in ascending sector order */
+    do {
+        lowest = NULL;
+        for (i = 0; i < DISK_CACHE_LINES; i++) {
+            l = &cache->line[i];
+            if ((l->flags & LINE_DIRTY) &&
+                ((lowest == NULL) || (l->sector < lowest->sector))) {
+                lowest = l;
+            }
+        }
+        if (lowest) {
+            result = cache_flush_run(cache, lowest);
+            if (result != DISK_CACHE_OK) {
+                return(result);
+            }
+        }
+    } while (lowest);
+
+    return(DISK_CACHE_OK);
+}
+
+void disk_cache_stats(DISK_CACHE *cache, DISK_CACHE_STATS *stats,
+    bool clear)
+{
+    if (stats) {
+        *stats = cache->stats;
+    }
+    if (clear) {
+        memset(&cache->stats, 0, sizeof(cache->stats));
+    }
+}
+
+#endif
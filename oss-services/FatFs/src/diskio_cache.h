@@ -0,0 +1,108 @@
+/*-----------------------------------------------------------------------*/
+/* Sector cache for the FatFs diskio layer                               */
+/*-----------------------------------------------------------------------*/
+/* LRU sector cache with a separate pinned pool for the FAT region,      */
+/* sequential read-ahead and write-back with coalescing of adjacent      */
+/* dirty sectors into multi-sector writes.  The cache has no driver or   */
+/* OS dependencies; the backing device is accessed through callbacks.    */
+/*-----------------------------------------------------------------------*/
+
+#ifndef _diskio_cache_h
+#define _diskio_cache_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fatfs_diskio_cfg.h"
+
+/* General pool size in sectors (0 disables the cache) */
+#ifndef FATFS_DISKIO_CACHE_SECTORS
+#define FATFS_DISKIO_CACHE_SECTORS      0
+#endif
+
+/* Pinned pool size in sectors reserved for the FAT region */
+#ifndef FATFS_DISKIO_CACHE_FAT_SECTORS
+#define FATFS_DISKIO_CACHE_FAT_SECTORS  16
+#endif
+
+/* Sectors read ahead on a sequential miss.  This is also the largest
+ * coalesced write and the request size at which the cache is bypassed.
+ */
+#ifndef FATFS_DISKIO_CACHE_READ_AHEAD
+#define FATFS_DISKIO_CACHE_READ_AHEAD   8
+#endif
+
+#ifndef FATFS_DISKIO_CACHE_SECTOR_SIZE
+#define FATFS_DISKIO_CACHE_SECTOR_SIZE  512
+#endif
+
+#define DISK_CACHE_LINES \
+    (FATFS_DISKIO_CACHE_SECTORS + FATFS_DISKIO_CACHE_FAT_SECTORS)
+
+typedef enum {
+    DISK_CACHE_OK = 0,
+    DISK_CACHE_ERROR
+} DISK_CACHE_RESULT;
+
+typedef DISK_CACHE_RESULT (*DISK_CACHE_READ)(void *usr, void *buf,
+    uint32_t sector, uint32_t count);
+typedef DISK_CACHE_RESULT (*DISK_CACHE_WRITE)(void *usr, const void *buf,
+    uint32_t sector, uint32_t count);
+
+typedef struct {
+    uint32_t hits;          /* Sectors served from the cache */
+    uint32_t misses;        /* Sectors not found in the cache */
+    uint32_t readAheads;    /* Sectors read ahead */
+    uint32_t bypassReads;   /* Large reads sent straight to the device */
+    uint32_t bypassWrites;  /* Large writes sent straight to the device */
+    uint32_t deviceReads;   /* Device read transactions */
+    uint32_t deviceWrites;  /* Device write transactions */
+    uint32_t writeSectors;  /* Sectors written back */
+    uint32_t flushes;       /* Explicit flushes */
+} DISK_CACHE_STATS;
+
+typedef struct {
+    uint32_t sector;
+    uint32_t lru;
+    uint8_t flags;
+} DISK_CACHE_LINE;
+
+typedef struct {
+    DISK_CACHE_READ read;
+    DISK_CACHE_WRITE write;
+    void *usr;
+
+    /* Pinned FAT region [fatStart, fatEnd) */
+    uint32_t fatStart;
+    uint32_t fatEnd;
+
+    uint32_t nextSector;
+    uint32_t lruTick;
+
+    DISK_CACHE_STATS stats;
+
+    DISK_CACHE_LINE line[DISK_CACHE_LINES];
+    uint32_t data[DISK_CACHE_LINES][FATFS_DISKIO_CACHE_SECTOR_SIZE / 4];
+    uint32_t readStage[FATFS_DISKIO_CACHE_READ_AHEAD]
+        [FATFS_DISKIO_CACHE_SECTOR_SIZE / 4];
+    uint32_t writeStage[FATFS_DISKIO_CACHE_READ_AHEAD]
+        [FATFS_DISKIO_CACHE_SECTOR_SIZE / 4];
+} DISK_CACHE;
+
+void disk_cache_init(DISK_CACHE *cache, DISK_CACHE_READ read,
+    DISK_CACHE_WRITE write, void *usr);
+void disk_cache_invalidate(DISK_CACHE *cache);
+void disk_cache_set_fat(DISK_CACHE *cache, uint32_t start, uint32_t count);
+DISK_CACHE_RESULT disk_cache_read(DISK_CACHE *cache, void *buf,
+    uint32_t sector, uint32_t count);
+DISK_CACHE_RESULT disk_cache_write(DISK_CACHE *cache, const void *buf,
+    uint32_t sector, uint32_t count);
+DISK_CACHE_RESULT disk_cache_flush(DISK_CACHE *cache);
+void disk_cache_stats(DISK_CACHE *cache, DISK_CACHE_STATS *stats,
+    bool clear);
+
+/* Returns the cache statistics of an initialized drive (diskio.c) */
+bool disk_cache_get_stats(uint8_t pdrv, DISK_CACHE_STATS *stats,
+    bool clear);
+
+#endif
@@ -0,0 +1,377 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host directory listing and streaming benchmark of FatFs and the
+ * diskio sector cache over the disk image backend.
+ *
+ * A FAT volume is created in 'fatfs_bench.img'.  A directory is filled
+ * with files and listed with f_readdir(), once straight after mounting
+ * and then repeatedly, and a large file is written and read back
+ * sequentially with f_write() and f_read().  The time, the
+ * disk_read() / disk_write() requests from FatFs and, with the cache
+ * enabled, the cache statistics are reported for each phase.
+ * Build once with and once without FATFS_DISKIO_CACHE_SECTORS to
+ * compare.
+ *
+ * FatFs is built with the host 'ffconf.h' next to this file, in place of
+ * the one in the 'FatFs' directory.  From the 'FatFs' directory:
+ *   mkdir -p bench && cp FatFs/ff.[ch] FatFs/diskio.h FatFs/ffunicode.c \
+ *       src/fatfs_bench/ffconf.h bench
+ *   gcc -O2 -Isrc/fatfs_bench -Ibench -Isrc \
+ *       -Wl,--wrap=disk_read,--wrap=disk_write -o fatfs_bench \
+ *       src/fatfs_bench/fatfs_bench.c src/diskio.c src/diskio_cache.c \
+ *       bench/ff.c bench/ffunicode.c
+ * Add '-DFATFS_DISKIO_CACHE_SECTORS=32' to enable the cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "diskio_cache.h"
+
+#define BENCH_VOLUME        "IMG:"
+#define BENCH_DIR           BENCH_VOLUME "/dir"
+#define BENCH_STREAM        BENCH_VOLUME "/stream.bin"
+#define BENCH_MAX_CHUNK     (65536)
+#define BENCH_FILE_SIZE     (100)
+
+typedef struct {
+    uint32_t imageMB;
+    uint32_t files;
+    uint32_t passes;
+    uint32_t streamMB;
+    uint32_t chunk;
+    uint32_t seed;
+} BENCH_CFG;
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint64_t start;
+    DISK_CACHE_STATS cache;
+} BENCH_PHASE;
+
+static FATFS fs;
+static uint8_t chunk[BENCH_MAX_CHUNK];
+static uint8_t check[BENCH_MAX_CHUNK];
+
+/*
+ * disk_read() / disk_write() requests from FatFs, counted by wrappers
+ * linked in with '-Wl,--wrap=disk_read,--wrap=disk_write'
+ */
+static uint32_t diskReads;
+static uint32_t diskWrites;
+
+DRESULT __real_disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count);
+DRESULT __real_disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector,
+    UINT count);
+
+DRESULT __wrap_disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
+{
+    diskReads++;
+    return(__real_disk_read(pdrv, buff, sector, count));
+}
+
+DRESULT __wrap_disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector,
+    UINT count)
+{
+    diskWrites++;
+    return(__real_disk_write(pdrv, buff, sector, count));
+}
+
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+static uint32_t bench_rand(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return(*state);
+}
+
+static void bench_fill(uint8_t *buf, uint32_t len, uint32_t *state)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = (uint8_t)bench_rand(state);
+    }
+}
+
+static void bench_cache_stats(DISK_CACHE_STATS *stats, bool clear)
+{
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+#if FATFS_DISKIO_CACHE_SECTORS > 0
+    disk_cache_get_stats(FATFS_DISKIO_IMAGE_DEVICE, stats, clear);
+#endif
+}
+
+static void bench_start(BENCH_PHASE *p)
+{
+    bench_cache_stats(NULL, true);
+    p->reads = diskReads;
+    p->writes = diskWrites;
+    p->start = bench_now();
+}
+
+static void bench_end(BENCH_PHASE *p, const char *name, uint64_t bytes,
+    bool ok)
+{
+    uint64_t ns = bench_now() - p->start;
+
+    bench_cache_stats(&p->cache, false);
+    printf("%-14s %9.3f %9.1f %8u %8u %8u %8u %8u %8u  %s\n", name,
+        ns / 1e6, bytes ? (bytes / 1048576.0) / (ns / 1e9) : 0.0,
+        diskReads - p->reads, diskWrites - p->writes,
+        p->cache.hits, p->cache.misses,
+        p->cache.deviceReads, p->cache.deviceWrites, ok ? "ok" : "FAIL");
+}
+
+/* Unmount and mount again so the cache starts empty */
+static bool bench_remount(void)
+{
+    f_mount(NULL, BENCH_VOLUME, 0);
+    return(f_mount(&fs, BENCH_VOLUME, 1) == FR_OK);
+}
+
+static bool bench_image(const BENCH_CFG *cfg)
+{
+    static BYTE work[FF_MAX_SS * 8];
+    MKFS_PARM opt = { FM_FAT32, 0, 0, 0, 0 };
+    FILE *f;
+
+    f = fopen(FATFS_DISKIO_IMAGE_PATH, "wb");
+    if (f == NULL) {
+        return(false);
+    }
+    if ((fseek(f, (long)cfg->imageMB * 1048576 - 1, SEEK_SET) != 0) ||
+        (fputc(0, f) == EOF)) {
+        fclose(f);
+        return(false);
+    }
+    fclose(f);
+
+    if (f_mkfs(BENCH_VOLUME, &opt, work, sizeof(work)) != FR_OK) {
+        return(false);
+    }
+    return(f_mount(&fs, BENCH_VOLUME, 1) == FR_OK);
+}
+
+static bool bench_populate(const BENCH_CFG *cfg)
+{
+    char name[64];
+    uint32_t i, state;
+    UINT bw;
+    FIL fil;
+
+    if (f_mkdir(BENCH_DIR) != FR_OK) {
+        return(false);
+    }
+    state = cfg->seed;
+    for (i = 0; i < cfg->files; i++) {
+        snprintf(name, sizeof(name), BENCH_DIR "/recording_%05u.wav",
+            (unsigned)i);
+        if (f_open(&fil, name, FA_CREATE_NEW | FA_WRITE) != FR_OK) {
+            return(false);
+        }
+        bench_fill(chunk, BENCH_FILE_SIZE, &state);
+        if ((f_write(&fil, chunk, BENCH_FILE_SIZE, &bw) != FR_OK) ||
+            (bw != BENCH_FILE_SIZE)) {
+            f_close(&fil);
+            return(false);
+        }
+        if (f_close(&fil) != FR_OK) {
+            return(false);
+        }
+    }
+
+    return(true);
+}
+
+static bool bench_list(const BENCH_CFG *cfg)
+{
+    FILINFO fno;
+    uint32_t found;
+    DIR dir;
+
+    if (f_opendir(&dir, BENCH_DIR) != FR_OK) {
+        return(false);
+    }
+    found = 0;
+    while ((f_readdir(&dir, &fno) == FR_OK) && fno.fname[0]) {
+        if (fno.fsize == BENCH_FILE_SIZE) {
+            found++;
+        }
+    }
+    f_closedir(&dir);
+
+    return(found == cfg->files);
+}
+
+static bool bench_write(const BENCH_CFG *cfg, uint64_t bytes)
+{
+    uint32_t state = cfg->seed;
+    uint64_t done;
+    uint32_t len;
+    UINT bw;
+    FIL fil;
+
+    if (f_open(&fil, BENCH_STREAM, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        return(false);
+    }
+    for (done = 0; done < bytes; done += len) {
+        len = (bytes - done > cfg->chunk) ? cfg->chunk : bytes - done;
+        bench_fill(chunk, len, &state);
+        if ((f_write(&fil, chunk, len, &bw) != FR_OK) || (bw != len)) {
+            f_close(&fil);
+            return(false);
+        }
+    }
+
+    return(f_close(&fil) == FR_OK);
+}
+
+static bool bench_read(const BENCH_CFG *cfg, uint64_t bytes)
+{
+    uint32_t state = cfg->seed;
+    bool ok = true;
+    uint64_t done;
+    uint32_t len;
+    UINT br;
+    FIL fil;
+
+    if (f_open(&fil, BENCH_STREAM, FA_READ) != FR_OK) {
+        return(false);
+    }
+    for (done = 0; done < bytes; done += len) {
+        len = (bytes - done > cfg->chunk) ? cfg->chunk : bytes - done;
+        if ((f_read(&fil, chunk, len, &br) != FR_OK) || (br != len)) {
+            ok = false;
+            break;
+        }
+        bench_fill(check, len, &state);
+        if (memcmp(chunk, check, len) != 0) {
+            ok = false;
+            break;
+        }
+    }
+    f_close(&fil);
+
+    return(ok);
+}
+
+static void usage(void)
+{
+    printf("fatfs_bench [options]\n");
+    printf("  -s <MB>      Image size (64)\n");
+    printf("  -n <files>   Files in the listed directory (1000)\n");
+    printf("  -l <passes>  Warm directory listings (10)\n");
+    printf("  -m <MB>      Streamed file size (16)\n");
+    printf("  -c <bytes>   f_read()/f_write() size (2048, max %d)\n",
+        BENCH_MAX_CHUNK);
+    printf("  -r <seed>    Random seed (1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    BENCH_CFG cfg = {
+        .imageMB = 64, .files = 1000, .passes = 10, .streamMB = 16,
+        .chunk = 2048, .seed = 1
+    };
+    BENCH_PHASE phase;
+    uint64_t bytes;
+    uint32_t i;
+    int fails = 0;
+    bool ok;
+    int c;
+
+    while ((c = getopt(argc, argv, "s:n:l:m:c:r:h")) != -1) {
+        switch (c) {
+            case 's': cfg.imageMB = strtoul(optarg, NULL, 0); break;
+            case 'n': cfg.files = strtoul(optarg, NULL, 0); break;
+            case 'l': cfg.passes = strtoul(optarg, NULL, 0); break;
+            case 'm': cfg.streamMB = strtoul(optarg, NULL, 0); break;
+            case 'c': cfg.chunk = strtoul(optarg, NULL, 0); break;
+            case 'r': cfg.seed = strtoul(optarg, NULL, 0); break;
+            default: usage(); return(1);
+        }
+    }
+    if ((cfg.imageMB < 48) || (cfg.streamMB >= cfg.imageMB - 16) ||
+        (cfg.chunk == 0) || (cfg.chunk > BENCH_MAX_CHUNK)) {
+        usage();
+        return(1);
+    }
+    if (cfg.seed == 0) {
+        cfg.seed = 1;
+    }
+    bytes = (uint64_t)cfg.streamMB * 1048576;
+
+    if (!bench_image(&cfg)) {
+        printf("Cannot create the volume in '%s'\n", FATFS_DISKIO_IMAGE_PATH);
+        return(1);
+    }
+
+    printf("%uMB FAT32 image, cache %u sectors, %u files, %uMB stream, "
+        "%u byte transfers\n\n", cfg.imageMB, FATFS_DISKIO_CACHE_SECTORS,
+        cfg.files, cfg.streamMB, cfg.chunk);
+    printf("%-14s %9s %9s %8s %8s %8s %8s %8s %8s\n", "phase", "ms", "MB/s",
+        "reads", "writes", "hits", "misses", "devRead", "devWrite");
+
+    bench_start(&phase);
+    ok = bench_populate(&cfg);
+    bench_end(&phase, "create files", 0, ok);
+    fails += !ok;
+
+    ok = bench_remount();
+    bench_start(&phase);
+    ok = ok && bench_list(&cfg);
+    bench_end(&phase, "list cold", 0, ok);
+    fails += !ok;
+
+    bench_start(&phase);
+    ok = true;
+    for (i = 0; i < cfg.passes; i++) {
+        ok = ok && bench_list(&cfg);
+    }
+    bench_end(&phase, "list warm", 0, ok);
+    fails += !ok;
+
+    bench_start(&phase);
+    ok = bench_write(&cfg, bytes);
+    bench_end(&phase, "stream write", bytes, ok);
+    fails += !ok;
+
+    ok = bench_remount();
+    bench_start(&phase);
+    ok = ok && bench_read(&cfg, bytes);
+    bench_end(&phase, "stream read", bytes, ok);
+    fails += !ok;
+
+    f_mount(NULL, BENCH_VOLUME, 0);
+
+    return(fails ? 2 : 0);
+}
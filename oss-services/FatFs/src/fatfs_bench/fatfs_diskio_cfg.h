@@ -0,0 +1,19 @@
+#ifndef _fatfs_diskio_cfg_h
+#define _fatfs_diskio_cfg_h
+
+/* Host (fatfs_bench) configuration, use in place of
+ * 'inc/fatfs_diskio_cfg.h'.  Only the disk image drive is enabled.
+ */
+#define FATFS_DISKIO_ENABLE_IMAGE
+#define FATFS_DISKIO_IMAGE_DEVICE  2
+#define FATFS_DISKIO_IMAGE_PATH    "fatfs_bench.img"
+
+/* Build with -DFATFS_DISKIO_CACHE_SECTORS=32 to enable the cache */
+#define FATFS_DISKIO_CACHE_DEVICES      3
+#ifndef FATFS_DISKIO_CACHE_SECTORS
+#define FATFS_DISKIO_CACHE_SECTORS      0
+#endif
+#define FATFS_DISKIO_CACHE_FAT_SECTORS  16
+#define FATFS_DISKIO_CACHE_READ_AHEAD   8
+
+#endif
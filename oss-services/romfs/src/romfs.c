@@ -1,6 +1,7 @@
 // Filesystem implementation
 #include "romfs.h"
 #include <string.h>
+#include <stddef.h>
 #include <errno.h>
 #include <stdio.h>
 #include <ctype.h>
@@ -16,6 +17,19 @@
 
 static FD fd_table[ TOTAL_MAX_FDS ];
 static int romfs_num_fd;
+// Descriptors holding a pointer into the memory-mapped flash window
+static int romfs_xip_holds;
+
+#if ROMFS_COMPACT
+// Flash sectors reserved at the end of the WOFS area for compaction
+#define ROMFS_COMPACT_SECTORS 3
+static void romfs_compact_recover( void );
+static void romfs_compact_reset( void );
+static int romfs_compact_unfinished( void );
+static int romfs_compact_moving( void );
+#else
+#define romfs_compact_moving() 0
+#endif
 
 #define WOFS_END_MARKER_CHAR  0xFF
 #define WOFS_DEL_FIELD_SIZE   ( ROMFS_ALIGN )
@@ -45,16 +59,6 @@ static void romfs_close_fd( int fd )
   fd_table[ fd ].flags = 0;
 }
 
-// Helper function: read a byte from the FS
-static u8 romfsh_read8( u32 addr, const FSDATA *pfs )
-{
-  u8 temp;
-  if( pfs->flags & ROMFS_FS_FLAG_DIRECT )
-    return pfs->pbase[ addr ] & 0xFF;
-  pfs->readf( &temp, addr, 1, pfs );
-  return temp & 0xFF;
-}
-
 // Helper function: read a buffer from the FS
 static u32 romfsh_read( u32 addr, void *data, u32 len, const FSDATA *pfs )
 {
@@ -66,6 +70,43 @@ static u32 romfsh_read( u32 addr, void *data, u32 len, const FSDATA *pfs )
   return(len);
 }
 
+// Bulk header reads.  File headers are small and, for small files, close
+// together so a scan reads ROMFS_SCAN_BUF_SIZE bytes at a time and serves
+// the following headers from RAM.  A read ahead only pays for its extra
+// bytes if it serves several headers, so it is only done while the last
+// two headers were less than a quarter of the buffer apart, otherwise just
+// the header is read.  The buffer is only valid for the duration of a
+// single scan and must be invalidated before each one.
+static u8 romfs_scan_buf[ ROMFS_SCAN_BUF_SIZE ];
+static u32 romfs_scan_addr;
+static u32 romfs_scan_len;
+static u32 romfs_scan_prev;
+
+static void romfsh_scan_invalidate( void )
+{
+  romfs_scan_len = 0;
+  romfs_scan_prev = 0;
+}
+
+static u32 romfsh_scan_read( u32 addr, void *data, u32 len, const FSDATA *pfs )
+{
+  u32 ahead;
+
+  if( ( pfs->flags & ROMFS_FS_FLAG_DIRECT ) || ( len > ROMFS_SCAN_BUF_SIZE ) )
+    return romfsh_read( addr, data, len, pfs );
+  if( ( addr < romfs_scan_addr ) ||
+      ( addr + len > romfs_scan_addr + romfs_scan_len ) )
+  {
+    ahead = ( addr - romfs_scan_prev < ROMFS_SCAN_BUF_SIZE / 4 ) ? ROMFS_SCAN_BUF_SIZE : len;
+    romfs_scan_addr = addr;
+    romfs_scan_len = fsmin( ahead, pfs->max_size - addr );
+    pfs->readf( romfs_scan_buf, romfs_scan_addr, romfs_scan_len, pfs );
+  }
+  romfs_scan_prev = addr;
+  memcpy( data, romfs_scan_buf + ( addr - romfs_scan_addr ), len );
+  return len;
+}
+
 // Helper function: return 1 if PFS reffers to a WOFS, 0 otherwise
 static int romfsh_is_wofs( const FSDATA* pfs )
 {
@@ -83,6 +124,7 @@ static u8 romfs_open_file( const char* fname, FD* pfd, FSDATA *pfs, u32 *plast,
 
   // Look for the file
   i = 0;
+  romfsh_scan_invalidate();
   while( 1 )
   {
     // Clear the previous file header
@@ -94,7 +136,7 @@ static u8 romfs_open_file( const char* fname, FD* pfd, FSDATA *pfs, u32 *plast,
     } else {
        j = pfs->max_size - i;
     }
-    romfsh_read(i, fsname, j, pfs);
+    romfsh_scan_read(i, fsname, j, pfs);
 
     // Reset indexes
     n = i; j = 0;
@@ -151,7 +193,297 @@ static u8 romfs_open_file( const char* fname, FD* pfd, FSDATA *pfs, u32 *plast,
     // On WOFS, all file names must begin at a multiple of ROMFS_ALIGN
     if( romfsh_is_wofs( pfs ) )
       i = ( i + ROMFS_ALIGN - 1 ) & ~( ROMFS_ALIGN - 1 );
+
+    // A damaged size (e.g. a torn write) can point past the end
+    if( ( i >= pfs->max_size ) || ( i <= n ) )
+    {
+      *plast = pfs->max_size;
+      return FS_FILE_NOT_FOUND;
+    }
+  }
+}
+
+// ****************************************************************************
+// WOFS file name index
+//
+// An open addressing hash table mapping file names to their headers.  It is
+// built by a single scan at romfs_init() and kept current by create, close,
+// unlink and format so an open does not walk every header (including the
+// deleted ones) from the start of the filesystem.  If the table overflows
+// the lookups fall back to romfs_open_file() until the next format.
+
+#if ROMFS_INDEX_SIZE > 0
+
+#if ( ROMFS_INDEX_SIZE & ( ROMFS_INDEX_SIZE - 1 ) ) != 0
+#error ROMFS_INDEX_SIZE must be a power of 2
+#endif
+
+#define ROMFS_INDEX_MAX_USED  ( ROMFS_INDEX_SIZE - ROMFS_INDEX_SIZE / 4 )
+#define ROMFS_INDEX_FREE      0xFFFFFFFF
+#define ROMFS_INDEX_REMOVED   0xFFFFFFFE
+
+enum
+{
+  ROMFS_INDEX_STALE,
+  ROMFS_INDEX_OK,
+  ROMFS_INDEX_OVERFLOW
+};
+
+typedef struct
+{
+  u32 hash;
+  u32 nameaddr;                   // header address or ROMFS_INDEX_FREE/REMOVED
+  u32 baseaddr;                   // file data address
+  u32 size;                       // file size
+} ROMFS_INDEX_ENTRY;
+
+typedef struct
+{
+  ROMFS_INDEX_ENTRY entry[ ROMFS_INDEX_SIZE ];
+  const FSDATA *pfs;              // indexed filesystem
+  u32 used;                       // live and removed slots
+  u32 live;                       // live slots
+  u32 last;                       // first free address in the filesystem
+  u32 pending_hash;               // file open for writing
+  u32 pending_nameaddr;
+  u8 state;
+} ROMFS_INDEX;
+
+static ROMFS_INDEX romfs_index;
+
+static u32 romfs_index_hash( const char *fname )
+{
+  u32 hash = 2166136261UL;
+  unsigned i;
+
+  for( i = 0; ( i < DM_MAX_FNAME_LENGTH ) && fname[ i ]; i ++ )
+  {
+    hash ^= ( u8 )fname[ i ];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+static void romfs_index_reset( const FSDATA *pfs, u32 last )
+{
+  unsigned i;
+
+  for( i = 0; i < ROMFS_INDEX_SIZE; i ++ )
+    romfs_index.entry[ i ].nameaddr = ROMFS_INDEX_FREE;
+  romfs_index.pfs = pfs;
+  romfs_index.used = romfs_index.live = 0;
+  romfs_index.last = last;
+  romfs_index.pending_nameaddr = ROMFS_INDEX_FREE;
+  romfs_index.state = ROMFS_INDEX_OK;
+}
+
+// Returns 0 if the table is full
+static int romfs_index_insert( u32 hash, u32 nameaddr, u32 baseaddr, u32 size )
+{
+  ROMFS_INDEX_ENTRY *pent;
+  u32 slot;
+
+  if( romfs_index.used >= ROMFS_INDEX_MAX_USED )
+    return 0;
+  slot = hash & ( ROMFS_INDEX_SIZE - 1 );
+  while( romfs_index.entry[ slot ].nameaddr != ROMFS_INDEX_FREE )
+    slot = ( slot + 1 ) & ( ROMFS_INDEX_SIZE - 1 );
+  pent = romfs_index.entry + slot;
+  pent->hash = hash;
+  pent->nameaddr = nameaddr;
+  pent->baseaddr = baseaddr;
+  pent->size = size;
+  romfs_index.used ++;
+  romfs_index.live ++;
+  return 1;
+}
+
+static void romfs_index_remove( u32 hash, u32 nameaddr )
+{
+  u32 slot;
+
+  slot = hash & ( ROMFS_INDEX_SIZE - 1 );
+  while( romfs_index.entry[ slot ].nameaddr != ROMFS_INDEX_FREE )
+  {
+    if( romfs_index.entry[ slot ].nameaddr == nameaddr )
+    {
+      romfs_index.entry[ slot ].nameaddr = ROMFS_INDEX_REMOVED;
+      romfs_index.live --;
+      return;
+    }
+    slot = ( slot + 1 ) & ( ROMFS_INDEX_SIZE - 1 );
+  }
+}
+
+// Scan the filesystem once and index every live file
+static void romfs_index_build( const FSDATA *pfs )
+{
+  char header[ WOFS_FILE_HEADER_MAX_LEN ];
+  int is_deleted;
+  u32 i, j, fsize;
+
+  romfs_index_reset( pfs, 0 );
+  romfsh_scan_invalidate();
+
+  i = 0;
+  while( i < pfs->max_size )
+  {
+    memset( header, 0, sizeof( header ) );
+    j = fsmin( WOFS_FILE_HEADER_MAX_LEN, pfs->max_size - i );
+    romfsh_scan_read( i, header, j, pfs );
+    if( header[ 0 ] == ( char )WOFS_END_MARKER_CHAR )
+      break;
+
+    j = 0;
+    while( ( j < DM_MAX_FNAME_LENGTH + 1 ) && ( header[ j++ ] != '\0' ) );
+    j = ROMFS_ALIGN_OFFSET( j );
+    if( romfsh_is_wofs( pfs ) )
+    {
+      is_deleted = header[ j ] == ( char )WOFS_FILE_DELETED;
+      j += WOFS_DEL_FIELD_SIZE;
+    }
+    else
+      is_deleted = 0;
+    fsize = ( ( ( ( u32 )header[ j + 0 ] & 0xFF ) <<  0 ) |
+              ( ( ( u32 )header[ j + 1 ] & 0xFF ) <<  8 ) |
+              ( ( ( u32 )header[ j + 2 ] & 0xFF ) << 16 ) |
+              ( ( ( u32 )header[ j + 3 ] & 0xFF ) << 24 ) );
+    j += ROMFS_SIZE_LEN;
+    if( fsize == 0xFFFFFFFF )
+      break;
+
+    if( !is_deleted )
+    {
+      header[ DM_MAX_FNAME_LENGTH ] = '\0';
+      if( !romfs_index_insert( romfs_index_hash( header ), i, i + j, fsize ) )
+      {
+        romfs_index.state = ROMFS_INDEX_OVERFLOW;
+        return;
+      }
+    }
+
+    i += j + fsize;
+    if( romfsh_is_wofs( pfs ) )
+      i = ROMFS_ALIGN_OFFSET( i );
+  }
+
+  romfs_index.last = i;
+}
+
+// Returns 1 if the index can be used for 'pfs', building it if needed
+static int romfs_index_ready( const FSDATA *pfs )
+{
+  if( romfs_index.pfs != pfs )
+    return 0;
+  if( romfs_index.state == ROMFS_INDEX_STALE )
+    romfs_index_build( pfs );
+  return romfs_index.state == ROMFS_INDEX_OK;
+}
+
+static u8 romfs_index_find( const char* fname, FD* pfd, const FSDATA *pfs, u32 *pnameaddr )
+{
+  char fsname[ DM_MAX_FNAME_LENGTH + 1 ];
+  ROMFS_INDEX_ENTRY *pent;
+  u32 hash, slot, len;
+
+  len = strlen( fname ) + 1;
+  if( len > sizeof( fsname ) )
+    return FS_FILE_NOT_FOUND;
+
+  hash = romfs_index_hash( fname );
+  slot = hash & ( ROMFS_INDEX_SIZE - 1 );
+  while( romfs_index.entry[ slot ].nameaddr != ROMFS_INDEX_FREE )
+  {
+    pent = romfs_index.entry + slot;
+    if( ( pent->nameaddr != ROMFS_INDEX_REMOVED ) && ( pent->hash == hash ) )
+    {
+      // Confirm the name, the hash only narrows the search
+      romfsh_read( pent->nameaddr, fsname, len, pfs );
+      if( memcmp( fsname, fname, len ) == 0 )
+      {
+        pfd->baseaddr = pent->baseaddr;
+        pfd->offset = 0;
+        pfd->size = pent->size;
+        if( pnameaddr )
+          *pnameaddr = pent->nameaddr;
+        return FS_FILE_OK;
+      }
+    }
+    slot = ( slot + 1 ) & ( ROMFS_INDEX_SIZE - 1 );
+  }
+  return FS_FILE_NOT_FOUND;
+}
+
+#endif
+
+// Look up a file through the index if possible
+static u8 romfs_lookup( const char* fname, FD* pfd, FSDATA *pfs, u32 *pnameaddr )
+{
+  u32 last;
+
+#if ROMFS_INDEX_SIZE > 0
+  if( romfs_index_ready( pfs ) )
+    return romfs_index_find( fname, pfd, pfs, pnameaddr );
+#endif
+  return romfs_open_file( fname, pfd, pfs, &last, pnameaddr );
+}
+
+// Return the first free address in the filesystem
+static u32 romfs_last( FSDATA *pfs )
+{
+  FD tempfd;
+  u32 last;
+
+#if ROMFS_INDEX_SIZE > 0
+  if( romfs_index_ready( pfs ) )
+    return romfs_index.last;
+#endif
+  // Look for a file with an invalid name
+  romfs_open_file( "\1", &tempfd, pfs, &last, NULL );
+  return last;
+}
+
+// Remove a deleted or replaced file from the index
+static void romfs_forget( const char *fname, FSDATA *pfs, u32 nameaddr )
+{
+#if ROMFS_INDEX_SIZE > 0
+  if( romfs_index_ready( pfs ) )
+    romfs_index_remove( romfs_index_hash( fname ), nameaddr );
+#endif
+}
+
+// Record the file being created at 'nameaddr'
+static void romfs_created( const char *fname, FSDATA *pfs, u32 nameaddr )
+{
+#if ROMFS_INDEX_SIZE > 0
+  if( romfs_index_ready( pfs ) )
+  {
+    romfs_index.pending_hash = romfs_index_hash( fname );
+    romfs_index.pending_nameaddr = nameaddr;
+  }
+#endif
+}
+
+// Add the file created at romfs_created() now that its size is known
+static void romfs_closed( const FD *pfd, FSDATA *pfs )
+{
+#if ROMFS_INDEX_SIZE > 0
+  if( romfs_index_ready( pfs ) &&
+      ( romfs_index.pending_nameaddr != ROMFS_INDEX_FREE ) )
+  {
+    if( !romfs_index_insert( romfs_index.pending_hash,
+          romfs_index.pending_nameaddr, pfd->baseaddr, pfd->size ) )
+    {
+      // Rescan to reclaim removed slots if that would make room
+      romfs_index.state = ( romfs_index.live < ROMFS_INDEX_MAX_USED ) ?
+        ROMFS_INDEX_STALE : ROMFS_INDEX_OVERFLOW;
+    }
+    romfs_index.pending_nameaddr = ROMFS_INDEX_FREE;
+    romfs_index.last = pfd->baseaddr + pfd->size;
+    if( romfsh_is_wofs( pfs ) )
+      romfs_index.last = ROMFS_ALIGN_OFFSET( romfs_index.last );
   }
+#endif
 }
 
 static int romfs_unlink_r( struct _reent *r, const char *path, void *pdata )
@@ -159,12 +491,17 @@ static int romfs_unlink_r( struct _reent *r, const char *path, void *pdata )
    FD tempfs;
    FSDATA *pfsdata = ( FSDATA* )pdata;
    int exists;
-   u32 firstfree, nameaddr;
+   u32 nameaddr;
 
-   exists = romfs_open_file( path, &tempfs, pfsdata, &firstfree, &nameaddr ) == FS_FILE_OK;
+   if( romfs_compact_moving() || romfs_xip_holds ) {
+      r->_errno = EBUSY;
+      return FS_FILE_NOT_FOUND;
+   }
+   exists = romfs_lookup( path, &tempfs, pfsdata, &nameaddr ) == FS_FILE_OK;
    if (exists) {
       u8 tempb[] = { WOFS_FILE_DELETED, 0xFF, 0xFF, 0xFF };
       pfsdata->writef( tempb, tempfs.baseaddr - ROMFS_SIZE_LEN - WOFS_DEL_FIELD_SIZE, WOFS_DEL_FIELD_SIZE, pfsdata );
+      romfs_forget( path, pfsdata, nameaddr );
       return FS_FILE_OK;
    } else {
       return FS_FILE_NOT_FOUND;
@@ -189,6 +526,12 @@ static int romfs_open_r( struct _reent *r, const char *path, int flags, int mode
     r->_errno = ENFILE;
     return -1;
   }
+  // A file is being moved by the compactor
+  if( romfs_compact_moving() )
+  {
+    r->_errno = EBUSY;
+    return -1;
+  }
   // Truncate the path if too long
   path_len = strlen( path );
   if (path_len > DM_MAX_FNAME_LENGTH) {
@@ -198,7 +541,7 @@ static int romfs_open_r( struct _reent *r, const char *path, int flags, int mode
      path = (char *)new_path;
   }
   // Does the file exist?
-  exists = romfs_open_file( path, &tempfs, pfsdata, &firstfree, &nameaddr ) == FS_FILE_OK;
+  exists = romfs_lookup( path, &tempfs, pfsdata, &nameaddr ) == FS_FILE_OK;
   // Now interpret "flags" to set file flags and to check if we should create the file
   if( flags & O_CREAT )
   {
@@ -223,6 +566,12 @@ static int romfs_open_r( struct _reent *r, const char *path, int flags, int mode
     r->_errno = EROFS;
     return -1;
   }
+  // The flash can't be programmed while a window pointer is held
+  if( must_create && romfs_xip_holds )
+  {
+    r->_errno = EBUSY;
+    return -1;
+  }
   // Decode access mode
   if( flags & O_WRONLY )
     lflags = ROMFS_FILE_FLAG_WRITE;
@@ -252,10 +601,10 @@ static int romfs_open_r( struct _reent *r, const char *path, int flags, int mode
       // the file length to WOFS_FILE_DELETED
       u8 tempb[] = { WOFS_FILE_DELETED, 0xFF, 0xFF, 0xFF };
       pfsdata->writef( tempb, tempfs.baseaddr - ROMFS_SIZE_LEN - WOFS_DEL_FIELD_SIZE, WOFS_DEL_FIELD_SIZE, pfsdata );
+      romfs_forget( path, pfsdata, nameaddr );
     }
-    // Find the last available position by asking romfs_open_file to look for a file
-    // with an invalid name
-    romfs_open_file( "\1", &tempfs, pfsdata, &firstfree, NULL );
+    // Find the last available position
+    firstfree = romfs_last( pfsdata );
     // Is there enough space on the FS for another file?
     if( pfsdata->max_size - firstfree + 1 < path_len + WOFS_MIN_NEEDED_SIZE + WOFS_DEL_FIELD_SIZE )
     {
@@ -272,6 +621,7 @@ static int romfs_open_r( struct _reent *r, const char *path, int flags, int mode
 
     // Write the name of the file
     pfsdata->writef( path, firstfree, path_len + 1, pfsdata );
+    romfs_created( path, pfsdata, firstfree );
     firstfree += path_len + 1; // skip over the name
     // Align to a multiple of ROMFS_ALIGN
     firstfree = ( firstfree + ROMFS_ALIGN - 1 ) & ~( ROMFS_ALIGN - 1 );
@@ -316,10 +666,17 @@ static int romfs_close_r( struct _reent *r, int fd, void *pdata )
     temp[ 2 ] = ( pfd->size >> 16 ) & 0xFF;
     temp[ 3 ] = ( pfd->size >> 24 ) & 0xFF;
     pfsdata->writef( temp, pfd->baseaddr - ROMFS_SIZE_LEN, ROMFS_SIZE_LEN, pfsdata );
+    romfs_closed( pfd, pfsdata );
     // Clear the "writing" flag on the FS instance to allow other files to be opened
     // in write mode
     romfs_fs_clear_flag( pfsdata, ROMFS_FS_FLAG_WRITING );
   }
+  if( pfd->flags & ROMFS_FILE_FLAG_XIP )
+  {
+    // Release the window pointer returned by getaddr
+    platform_flash_xip_release();
+    romfs_xip_holds --;
+  }
   romfs_close_fd( fd );
   romfs_num_fd --;
   return 0;
@@ -406,6 +763,8 @@ static u32 romfs_dir_data = 0;
 // opendir
 static void* romfs_opendir_r( struct _reent *r, const char* dname, void *pdata )
 {
+  if( romfs_compact_moving() )
+    return NULL;
   if( !dname || strlen( dname ) == 0 || ( strlen( dname ) == 1 && !strcmp( dname, "/" ) ) )
   {
     romfs_dir_data = 0;
@@ -502,15 +861,39 @@ static int romfs_closedir_r( struct _reent *r, void *d, void *pdata )
 }
 
 // getaddr
+// On a flash filesystem the file is only addressable through the
+// memory-mapped window.  The pointer holds the window until the file is
+// closed, and files can't be created or deleted meanwhile.
 static const char* romfs_getaddr_r( struct _reent *r, int fd, void *pdata )
 {
   FD* pfd = fd_table + fd;
   FSDATA *pfsdata = ( FSDATA* )pdata;
+  const u8 *ptr;
 
   if( pfsdata->flags & ROMFS_FS_FLAG_DIRECT )
     return ( const char* )pfsdata->pbase + pfd->baseaddr;
-  else
+  // A file being written can't be mapped
+  if( pfd->flags & ( ROMFS_FILE_FLAG_WRITE | ROMFS_FILE_FLAG_APPEND ) )
+  {
+    r->_errno = EBUSY;
     return NULL;
+  }
+  ptr = platform_flash_xip_ptr( ( u32 )pfsdata->pbase + pfd->baseaddr );
+  if( ptr == NULL )
+  {
+    // XIP is not enabled or a program or erase is in progress
+    r->_errno = ENXIO;
+    return NULL;
+  }
+  // One hold per descriptor
+  if( pfd->flags & ROMFS_FILE_FLAG_XIP )
+    platform_flash_xip_release();
+  else
+  {
+    pfd->flags |= ROMFS_FILE_FLAG_XIP;
+    romfs_xip_holds ++;
+  }
+  return ( const char* )ptr;
 }
 
 // ****************************************************************************
@@ -568,30 +951,45 @@ static FSDATA wofs_fsdata =
 int romfs_format( u8 all )
 {
   u32 sect_first, sect_last;
-  FD tempfd;
 
+  // The flash can't be erased while a window pointer is held
+  if( romfs_xip_holds )
+    return 0;
   platform_flash_get_first_free_block_address( &sect_first );
+#if ROMFS_COMPACT
+  // An unfinished compaction move leaves data past the apparent end
+  if( romfs_compact_unfinished() )
+    all = 1;
+#endif
   // Get the first free address in WOFS. We use this address to compute the last block that we need to
   // erase, instead of simply erasing everything from sect_first to the last Flash page.
   if (all) {
     sect_last = platform_flash_get_sector_of_address( ROMFS_FS_END_ADDRESS - 1);
   } else {
-    romfs_open_file( "\1", &tempfd, &wofs_fsdata, &sect_last, NULL );
+    sect_last = romfs_last( &wofs_fsdata );
     sect_last = platform_flash_get_sector_of_address( sect_last + ( u32 )wofs_fsdata.pbase );
   }
+#if ROMFS_INDEX_SIZE > 0
+  romfs_index.state = ROMFS_INDEX_STALE;
+#endif
+#if ROMFS_COMPACT
+  romfs_compact_reset();
+#endif
   while( sect_first <= sect_last )
     if( platform_flash_erase_sector( sect_first ++ ) == PLATFORM_ERR )
       return 0;
+#if ROMFS_INDEX_SIZE > 0
+  romfs_index_reset( &wofs_fsdata, 0 );
+#endif
   return 1;
 }
 
 int romfs_full(u32 *size, u32 *used)
 {
   u32 plast;
-  FD tempfd;
 
   // Get the first free address in WOFS.
-  romfs_open_file( "\1", &tempfd, &wofs_fsdata, &plast, NULL );
+  plast = romfs_last( &wofs_fsdata );
 
   // Calculate the amount used
   *size = wofs_fsdata.max_size;
@@ -614,10 +1012,23 @@ int romfs_init( const FLASH_INFO *fi )
   // Get the start address and size of WOFS and register it
   wofs_fsdata.pbase = ( u8* )platform_flash_get_first_free_block_address( NULL );
   wofs_fsdata.max_size = ROMFS_FS_END_ADDRESS - ROMFS_FS_START_ADDRESS;
+#if ROMFS_COMPACT
+  wofs_fsdata.max_size -= ROMFS_COMPACT_SECTORS * ROMFS_FLASH_SECTOR_SIZE;
+#endif
 
   // Initialize the platform with the flash handle
   platform_init(fi);
 
+#if ROMFS_COMPACT
+  // Finish a compaction step interrupted by a power failure
+  romfs_compact_recover();
+#endif
+
+#if ROMFS_INDEX_SIZE > 0
+  // Index the existing files
+  romfs_index_build( &wofs_fsdata );
+#endif
+
   // Register the filesystem with the device manager
   dm_register( "/wo", &wofs_fsdata, &romfs_device );
 
@@ -643,6 +1054,7 @@ int romfs_fsck(int repair, int *repaired)
    }
 
    i = 0;
+   romfsh_scan_invalidate();
    while( 1 )
    {
        // Clear the previous file header
@@ -654,7 +1066,7 @@ int romfs_fsck(int repair, int *repaired)
       } else {
          j = pfsdata->max_size - i;
       }
-      romfsh_read(i, header, j, pfsdata);
+      romfsh_scan_read(i, header, j, pfsdata);
       j = 0;
 
       // Check for end of filesystem
@@ -716,7 +1128,7 @@ int romfs_fsck(int repair, int *repaired)
          if (repair) {
             scanOff = repairOff = i + j;
             while (1) {
-               c = romfsh_read8(scanOff, pfsdata); scanOff++;
+               romfsh_scan_read(scanOff, &c, 1, pfsdata); scanOff++;
                if (c != (char)WOFS_END_MARKER_CHAR) {
                   repairOff = scanOff;
                }
@@ -730,6 +1142,10 @@ int romfs_fsck(int repair, int *repaired)
             temp[ 2 ] = ( fsize >> 16 ) & 0xFF;
             temp[ 3 ] = ( fsize >> 24 ) & 0xFF;
             pfsdata->writef( temp, i + j - ROMFS_SIZE_LEN, ROMFS_SIZE_LEN, pfsdata );
+            romfsh_scan_invalidate();
+#if ROMFS_INDEX_SIZE > 0
+            romfs_index.state = ROMFS_INDEX_STALE;
+#endif
             if (repaired) {
                *repaired = 1;
             }
@@ -755,3 +1171,503 @@ int romfs_fsck(int repair, int *repaired)
    }
 }
 
+// ****************************************************************************
+// WOFS online compaction
+//
+// Live files are slid down over deleted ones one run of adjacent live files
+// (a "move") at a time.  After each move a deleted filler record covers the
+// gap left behind so the filesystem is always a valid WOFS between moves.
+// Once the end of the filesystem is reached the final filler is replaced by
+// the end marker and the sectors behind it are erased.  Its journal entry is
+// only marked done once those erases have completed.
+//
+// A move rewrites destination sectors in ascending order.  The source of any
+// byte is always above its destination so rewriting a sector only destroys
+// data needed by that sector.  Each sector rewrite is journaled:
+//
+//  1. If the new sector image depends on the sector itself, erase and
+//     program the image sector with it
+//  2. Append a journal entry describing the move and sector (the commit)
+//  3. Erase and program the destination sector
+//  4. Mark the journal entry done
+//
+// romfs_init() replays an uncommitted sector from the journal and completes
+// the interrupted move.  Two journal sectors are used in turn so there is
+// always a committed entry on flash while the other one is erased.
+
+#if ROMFS_COMPACT
+
+#define ROMFS_CSECT             ROMFS_FLASH_SECTOR_SIZE
+#define ROMFS_CSECT_OF( x )     ( ( x ) - ( x ) % ROMFS_CSECT )
+#define ROMFS_FILLER_LEN        12
+#define ROMFS_JOURNAL_MAGIC     0x434D5057
+#define ROMFS_JOURNAL_SLOTS     ( ROMFS_CSECT / sizeof( ROMFS_JOURNAL ) )
+#define ROMFS_MOVE_IMAGED       0x01
+#define ROMFS_MOVE_FINAL        0x02
+#define ROMFS_JOURNAL_WRITTEN   0xFFFFFF00
+
+typedef struct
+{
+  u32 magic;
+  u32 seq;
+  u32 dst;                        // move destination
+  u32 src;                        // move source
+  u32 rec;                        // move length
+  u32 sector;                     // destination sector being rewritten
+  u32 flags;
+  u32 imgcrc;                     // image sector CRC (ROMFS_MOVE_IMAGED)
+  u32 crc;                        // CRC of the fields above
+  u32 done;                       // 0 once the sector is rewritten (final
+                                  // moves: WRITTEN, then 0 once the freed
+                                  // sectors are erased)
+} ROMFS_JOURNAL;
+
+typedef struct
+{
+  u32 dst;
+  u32 src;
+  u32 rec;
+  u8 final;                       // erase everything from 'dst' on
+} ROMFS_MOVE;
+
+typedef struct
+{
+  ROMFS_MOVE move;                // move in progress
+  u32 next;                       // next sector of the move
+  u32 w;                          // end of the compacted files
+  u32 r;                          // next file to examine
+  u32 seq;                        // next journal sequence number
+  u32 journal;                    // current journal sector
+  u32 slot;                       // next journal slot
+  u8 moving;
+  u8 active;
+} ROMFS_COMPACT_CTX;
+
+static ROMFS_COMPACT_CTX romfs_cctx;
+static u8 romfs_cbuf[ ROMFS_CSECT ];
+
+static u32 romfs_crc32( u32 crc, const void *data, u32 len )
+{
+  const u8 *p = ( const u8 * )data;
+  int k;
+
+  crc = ~crc;
+  while( len-- )
+  {
+    crc ^= *p++;
+    for( k = 0; k < 8; k ++ )
+      crc = ( crc >> 1 ) ^ ( 0xEDB88320UL & ( 0 - ( crc & 1 ) ) );
+  }
+  return ~crc;
+}
+
+static u32 romfs_journal_addr( u32 journal, u32 slot )
+{
+  return wofs_fsdata.max_size + journal * ROMFS_CSECT + slot * sizeof( ROMFS_JOURNAL );
+}
+
+static u32 romfs_image_addr( void )
+{
+  return wofs_fsdata.max_size + 2 * ROMFS_CSECT;
+}
+
+static void romfs_erase( u32 addr )
+{
+  platform_flash_erase_sector(
+    platform_flash_get_sector_of_address( addr + ( u32 )wofs_fsdata.pbase ) );
+}
+
+static u32 romfs_move_end( const ROMFS_MOVE *pm )
+{
+  return pm->final ? pm->dst : pm->dst + pm->rec + ROMFS_FILLER_LEN;
+}
+
+// Returns 1 if the new image of 'sect' depends on the contents of 'sect'
+static int romfs_move_needs_image( const ROMFS_MOVE *pm, u32 sect )
+{
+  u32 end = sect + ROMFS_CSECT;
+  u32 a0, a1;
+
+  if( sect < pm->dst )
+    return 1;
+  if( pm->final )
+    return 0;
+  if( pm->src + pm->rec < end )
+    return 1;
+  a0 = ( sect > pm->dst ) ? sect : pm->dst;
+  a1 = fsmin( end, pm->dst + pm->rec );
+  return ( a0 < a1 ) && ( a0 + pm->src - pm->dst < end );
+}
+
+// Build the new image of 'sect' in romfs_cbuf
+static void romfs_move_image( const ROMFS_MOVE *pm, u32 sect )
+{
+  u32 end = sect + ROMFS_CSECT;
+  u8 filler[ ROMFS_FILLER_LEN ] = { '.', 0, 0xFF, 0xFF, WOFS_FILE_DELETED, 0xFF, 0xFF, 0xFF };
+  u32 a0, a1, fsize, i;
+
+  memset( romfs_cbuf, 0xFF, sizeof( romfs_cbuf ) );
+
+  // Files already compacted
+  if( sect < pm->dst )
+    wofs_fsdata.readf( romfs_cbuf, sect, fsmin( end, pm->dst ) - sect, &wofs_fsdata );
+  if( pm->final )
+    return;
+
+  // Files being moved
+  a0 = ( sect > pm->dst ) ? sect : pm->dst;
+  a1 = fsmin( end, pm->dst + pm->rec );
+  if( a0 < a1 )
+    wofs_fsdata.readf( romfs_cbuf + a0 - sect, a0 + pm->src - pm->dst, a1 - a0, &wofs_fsdata );
+
+  // Filler covering the gap up to the files not yet moved
+  fsize = pm->src - pm->dst - ROMFS_FILLER_LEN;
+  filler[ 8 ] = fsize & 0xFF;
+  filler[ 9 ] = ( fsize >> 8 ) & 0xFF;
+  filler[ 10 ] = ( fsize >> 16 ) & 0xFF;
+  filler[ 11 ] = ( fsize >> 24 ) & 0xFF;
+  for( i = 0; i < ROMFS_FILLER_LEN; i ++ )
+  {
+    a0 = pm->dst + pm->rec + i;
+    if( ( a0 >= sect ) && ( a0 < end ) )
+      romfs_cbuf[ a0 - sect ] = filler[ i ];
+  }
+
+  // Files not yet moved
+  a0 = pm->src + pm->rec;
+  if( a0 < sect )
+    a0 = sect;
+  if( a0 < end )
+    wofs_fsdata.readf( romfs_cbuf + a0 - sect, a0, end - a0, &wofs_fsdata );
+}
+
+// Program romfs_cbuf into the erased sector 'sect'
+static void romfs_program_image( u32 sect )
+{
+  u32 len = ROMFS_CSECT;
+
+  while( ( len > 0 ) && ( romfs_cbuf[ len - 1 ] == 0xFF ) )
+    len --;
+  romfs_erase( sect );
+  if( len )
+    wofs_fsdata.writef( romfs_cbuf, sect, len, &wofs_fsdata );
+}
+
+static void romfs_journal_done( u32 journal, u32 slot, u32 done )
+{
+  wofs_fsdata.writef( &done, romfs_journal_addr( journal, slot ) +
+    offsetof( ROMFS_JOURNAL, done ), sizeof( done ), &wofs_fsdata );
+}
+
+// Journal and rewrite one destination sector of a move
+static void romfs_move_sector( const ROMFS_MOVE *pm, u32 sect )
+{
+  ROMFS_JOURNAL j;
+
+  memset( &j, 0xFF, sizeof( j ) );
+  j.magic = ROMFS_JOURNAL_MAGIC;
+  j.seq = romfs_cctx.seq ++;
+  j.dst = pm->dst;
+  j.src = pm->src;
+  j.rec = pm->rec;
+  j.sector = sect;
+  j.flags = pm->final ? ROMFS_MOVE_FINAL : 0;
+
+  romfs_move_image( pm, sect );
+  if( romfs_move_needs_image( pm, sect ) )
+  {
+    j.flags |= ROMFS_MOVE_IMAGED;
+    j.imgcrc = romfs_crc32( 0, romfs_cbuf, ROMFS_CSECT );
+    romfs_erase( romfs_image_addr() );
+    wofs_fsdata.writef( romfs_cbuf, romfs_image_addr(), ROMFS_CSECT, &wofs_fsdata );
+  }
+  j.crc = romfs_crc32( 0, &j, offsetof( ROMFS_JOURNAL, crc ) );
+
+  // Switch journal sectors when full, the last entry stays in the other
+  if( romfs_cctx.slot == ROMFS_JOURNAL_SLOTS )
+  {
+    romfs_cctx.journal ^= 1;
+    romfs_cctx.slot = 0;
+    romfs_erase( romfs_journal_addr( romfs_cctx.journal, 0 ) );
+  }
+  wofs_fsdata.writef( &j, romfs_journal_addr( romfs_cctx.journal, romfs_cctx.slot ),
+    offsetof( ROMFS_JOURNAL, done ), &wofs_fsdata );
+
+  romfs_program_image( sect );
+  romfs_journal_done( romfs_cctx.journal, romfs_cctx.slot, pm->final ? ROMFS_JOURNAL_WRITTEN : 0 );
+  romfs_cctx.slot ++;
+}
+
+// Erase the sectors freed by a final move, the new end marker is already
+// written so a partial erase here is only garbage past the end
+static void romfs_move_release( const ROMFS_MOVE *pm )
+{
+  u32 sect;
+
+  for( sect = ROMFS_CSECT_OF( pm->dst ) + ROMFS_CSECT; sect < pm->src; sect += ROMFS_CSECT )
+    romfs_erase( sect );
+}
+
+// Find the newest committed journal entry and the next free slot.  Returns
+// 0 if the journals are empty.
+static int romfs_journal_last( ROMFS_JOURNAL *plast, u32 *plastslot )
+{
+  ROMFS_JOURNAL j;
+  u32 journal, slot;
+  int found = 0;
+  unsigned i;
+
+  memset( &romfs_cctx, 0, sizeof( romfs_cctx ) );
+  for( journal = 0; journal < 2; journal ++ )
+  {
+    for( slot = 0; slot < ROMFS_JOURNAL_SLOTS; slot ++ )
+    {
+      wofs_fsdata.readf( &j, romfs_journal_addr( journal, slot ), sizeof( j ), &wofs_fsdata );
+      for( i = 0; i < sizeof( j ); i ++ )
+        if( ( ( u8 * )&j )[ i ] != 0xFF )
+          break;
+      if( i == sizeof( j ) )
+        break;
+      if( ( j.magic != ROMFS_JOURNAL_MAGIC ) ||
+          ( j.crc != romfs_crc32( 0, &j, offsetof( ROMFS_JOURNAL, crc ) ) ) )
+        continue;
+      if( !found || ( j.seq >= romfs_cctx.seq ) )
+      {
+        *plast = j;
+        found = 1;
+        romfs_cctx.seq = j.seq + 1;
+        romfs_cctx.journal = journal;
+        *plastslot = slot;
+      }
+    }
+    if( found && ( journal == romfs_cctx.journal ) )
+      romfs_cctx.slot = slot;
+  }
+  return found;
+}
+
+static void romfs_compact_recover( void )
+{
+  ROMFS_JOURNAL last;
+  ROMFS_MOVE m;
+  u32 sect, lastslot = 0;
+
+  if( !romfs_journal_last( &last, &lastslot ) )
+    return;
+
+  m.dst = last.dst;
+  m.src = last.src;
+  m.rec = last.rec;
+  m.final = ( last.flags & ROMFS_MOVE_FINAL ) != 0;
+
+  // Complete the interrupted sector
+  if( ( last.done != 0 ) && ( last.done != ROMFS_JOURNAL_WRITTEN ) )
+  {
+    if( last.flags & ROMFS_MOVE_IMAGED )
+    {
+      wofs_fsdata.readf( romfs_cbuf, romfs_image_addr(), ROMFS_CSECT, &wofs_fsdata );
+      if( romfs_crc32( 0, romfs_cbuf, ROMFS_CSECT ) != last.imgcrc )
+        return;
+    }
+    else
+      romfs_move_image( &m, last.sector );
+    romfs_program_image( last.sector );
+    romfs_journal_done( romfs_cctx.journal, lastslot, m.final ? ROMFS_JOURNAL_WRITTEN : 0 );
+    last.done = ROMFS_JOURNAL_WRITTEN;
+  }
+
+  // Finish releasing the space behind the new end of the filesystem
+  if( m.final )
+  {
+    if( last.done != 0 )
+    {
+      romfs_move_release( &m );
+      romfs_journal_done( romfs_cctx.journal, lastslot, 0 );
+    }
+    return;
+  }
+
+  // Complete the rest of the move
+  for( sect = last.sector + ROMFS_CSECT; sect < romfs_move_end( &m ); sect += ROMFS_CSECT )
+    romfs_move_sector( &m, sect );
+}
+
+// Returns 1 if the newest journaled move is not complete on flash
+static int romfs_compact_unfinished( void )
+{
+  ROMFS_JOURNAL last;
+  ROMFS_MOVE m;
+  u32 lastslot;
+
+  if( !romfs_journal_last( &last, &lastslot ) )
+    return 0;
+  if( last.done != 0 )
+    return 1;
+  if( last.flags & ROMFS_MOVE_FINAL )
+    return 0;
+  m.dst = last.dst;
+  m.src = last.src;
+  m.rec = last.rec;
+  m.final = 0;
+  return last.sector + ROMFS_CSECT < romfs_move_end( &m );
+}
+
+static int romfs_compact_moving( void )
+{
+  return romfs_cctx.moving;
+}
+
+// Forget any compaction in progress.  The journals are erased too so an
+// interrupted move is not replayed over the formatted filesystem.
+static void romfs_compact_reset( void )
+{
+  romfs_erase( romfs_journal_addr( 0, 0 ) );
+  romfs_erase( romfs_journal_addr( 1, 0 ) );
+  memset( &romfs_cctx, 0, sizeof( romfs_cctx ) );
+}
+
+// Parse the file header at 'off'.  Returns 1 for a file (deleted or not),
+// 0 at the end of the filesystem or an unfinished file.
+static int romfs_compact_record( u32 off, u32 *plen, int *pdeleted )
+{
+  char header[ WOFS_FILE_HEADER_MAX_LEN ];
+  u32 j, fsize;
+
+  if( off >= wofs_fsdata.max_size )
+    return 0;
+  memset( header, 0, sizeof( header ) );
+  romfsh_scan_read( off, header, fsmin( WOFS_FILE_HEADER_MAX_LEN, wofs_fsdata.max_size - off ), &wofs_fsdata );
+  if( header[ 0 ] == ( char )WOFS_END_MARKER_CHAR )
+    return 0;
+  j = 0;
+  while( ( j < DM_MAX_FNAME_LENGTH + 1 ) && ( header[ j++ ] != '\0' ) );
+  j = ROMFS_ALIGN_OFFSET( j );
+  *pdeleted = header[ j ] == ( char )WOFS_FILE_DELETED;
+  j += WOFS_DEL_FIELD_SIZE;
+  fsize = ( ( ( ( u32 )header[ j + 0 ] & 0xFF ) <<  0 ) |
+            ( ( ( u32 )header[ j + 1 ] & 0xFF ) <<  8 ) |
+            ( ( ( u32 )header[ j + 2 ] & 0xFF ) << 16 ) |
+            ( ( ( u32 )header[ j + 3 ] & 0xFF ) << 24 ) );
+  if( fsize == 0xFFFFFFFF )
+    return 0;
+  *plen = ROMFS_ALIGN_OFFSET( j + ROMFS_SIZE_LEN + fsize );
+  return 1;
+}
+
+// Reclaim the space held by deleted files.  Performs at most 'max_sectors'
+// sector rewrites or erases per call so it can run from a background task.
+// Returns ROMFS_COMPACT_MORE until complete, ROMFS_COMPACT_BUSY while files
+// are open (retry later) and ROMFS_COMPACT_ERROR if fsck fails.  While a
+// move is in progress opens and unlinks fail with EBUSY.
+int romfs_compact( u32 max_sectors )
+{
+  ROMFS_COMPACT_CTX *c = &romfs_cctx;
+  u32 len, off;
+  int deleted;
+  u8 marker;
+
+  while( max_sectors > 0 )
+  {
+    if( c->moving )
+    {
+      if( c->move.final )
+      {
+        // Write the new end marker first, then erase the freed sectors
+        if( c->next == ROMFS_CSECT_OF( c->move.dst ) )
+        {
+          romfs_move_sector( &c->move, c->next );
+#if ROMFS_INDEX_SIZE > 0
+          romfs_index.state = ROMFS_INDEX_STALE;
+#endif
+        }
+        else
+          romfs_erase( c->next );
+        max_sectors --;
+        c->next += ROMFS_CSECT;
+        if( c->next >= c->move.src )
+        {
+          romfs_journal_done( c->journal, c->slot - 1, 0 );
+          c->moving = c->active = 0;
+          return ROMFS_COMPACT_DONE;
+        }
+      }
+      else
+      {
+        romfs_move_sector( &c->move, c->next );
+        max_sectors --;
+        c->next += ROMFS_CSECT;
+        if( c->next >= romfs_move_end( &c->move ) )
+        {
+          c->moving = 0;
+          c->w = c->move.dst + c->move.rec;
+          c->r = c->move.src + c->move.rec;
+#if ROMFS_INDEX_SIZE > 0
+          romfs_index.state = ROMFS_INDEX_STALE;
+#endif
+        }
+      }
+      continue;
+    }
+
+    // Files can only move while none are open
+    if( ( romfs_num_fd > 0 ) || romfs_fs_is_flag_set( ( &wofs_fsdata ), ROMFS_FS_FLAG_WRITING ) )
+      return ROMFS_COMPACT_BUSY;
+
+    romfsh_scan_invalidate();
+    if( !c->active )
+    {
+      if( romfs_fsck( 0, NULL ) != FS_OK )
+        return ROMFS_COMPACT_ERROR;
+      // Start each pass with clean journals
+      romfs_erase( romfs_journal_addr( 0, 0 ) );
+      romfs_erase( romfs_journal_addr( 1, 0 ) );
+      c->journal = c->slot = 0;
+      // Find the first deleted file
+      off = 0;
+      while( romfs_compact_record( off, &len, &deleted ) && !deleted )
+        off += len;
+      if( !romfs_compact_record( off, &len, &deleted ) )
+        return ROMFS_COMPACT_DONE;
+      c->w = c->r = off;
+      c->active = 1;
+    }
+
+    // Skip deleted files (including the previous filler)
+    off = c->r;
+    while( romfs_compact_record( off, &len, &deleted ) && deleted )
+      off += len;
+    c->move.dst = c->w;
+    c->move.src = off;
+    if( romfs_compact_record( off, &len, &deleted ) )
+    {
+      // Move the run of live files
+      c->move.rec = 0;
+      while( romfs_compact_record( off, &len, &deleted ) && !deleted )
+      {
+        c->move.rec += len;
+        off += len;
+      }
+      c->move.final = 0;
+      c->next = ROMFS_CSECT_OF( c->move.dst );
+    }
+    else
+    {
+      // End of the filesystem, release everything past the last file
+      if( off < wofs_fsdata.max_size )
+      {
+        // Never release space behind an unfinished file
+        romfsh_scan_read( off, &marker, 1, &wofs_fsdata );
+        if( marker != WOFS_END_MARKER_CHAR )
+          return ROMFS_COMPACT_ERROR;
+      }
+      c->move.rec = 0;
+      c->move.final = 1;
+      c->next = ROMFS_CSECT_OF( c->move.dst );
+    }
+    c->moving = 1;
+  }
+
+  return ROMFS_COMPACT_MORE;
+}
+
+#endif
@@ -15,6 +15,24 @@
 #define TOTAL_MAX_FDS   8
 #endif
 
+// Number of slots in the in-RAM file name index (power of 2, 0 = disable).
+// Each slot takes 16 bytes.  Up to 3/4 of the slots hold live files before
+// lookups fall back to scanning the file headers.
+#ifndef ROMFS_INDEX_SIZE
+#define ROMFS_INDEX_SIZE      256
+#endif
+
+// Enable online WOFS compaction.  Reserves the last 3 flash sectors of the
+// filesystem area for the compaction journal and sector image.
+#ifndef ROMFS_COMPACT
+#define ROMFS_COMPACT         0
+#endif
+
+// Size of the buffer used to read file headers in bulk while scanning
+#ifndef ROMFS_SCAN_BUF_SIZE
+#define ROMFS_SCAN_BUF_SIZE   256
+#endif
+
 #ifndef ROMFS_FLASH_START_ADDRESS
 #error ROMFS_FLASH_START_ADDRESS must be defined
 #endif
@@ -64,6 +82,15 @@ enum
   FS_ERROR = -1
 };
 
+// romfs_compact() results
+enum
+{
+  ROMFS_COMPACT_ERROR = -1,
+  ROMFS_COMPACT_DONE = 0,
+  ROMFS_COMPACT_MORE,
+  ROMFS_COMPACT_BUSY
+};
+
 // ROMFS/WOFS functions
 typedef u32 ( *p_fs_read )( void *to, u32 fromaddr, u32 size, const void *pdata );
 typedef u32 ( *p_fs_write )( const void *from, u32 toaddr, u32 size, const void *pdata );
@@ -72,6 +99,7 @@ typedef u32 ( *p_fs_write )( const void *from, u32 toaddr, u32 size, const void
 #define ROMFS_FILE_FLAG_READ      0x01
 #define ROMFS_FILE_FLAG_WRITE     0x02
 #define ROMFS_FILE_FLAG_APPEND    0x04
+#define ROMFS_FILE_FLAG_XIP       0x08    // getaddr holds the flash window until close
 
 // A small "FILE" structure
 typedef struct
@@ -116,6 +144,9 @@ int romfs_init( const FLASH_INFO *fi );
 int romfs_format( u8 all);
 int romfs_full(u32 *size, u32 *used);
 int romfs_fsck(int repair, int *repaired);
+#if ROMFS_COMPACT
+int romfs_compact( u32 max_sectors );
+#endif
 
 #endif
 
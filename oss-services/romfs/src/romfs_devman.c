@@ -88,6 +88,13 @@ int fs_write(int fd, unsigned char *buf, int size)
     return(size);
 }
 
+const char* dm_getaddr( int fd )
+{
+   const char *addr;
+   addr = romfs.pdev->p_getaddr_r(&reent, fd - FD_OFFSET, romfs.pdata);
+   return(addr);
+}
+
 long fs_seek(int fd, long offset, int whence)
 {
    offset = romfs.pdev->p_lseek_r(&reent, fd - FD_OFFSET, offset, whence, romfs.pdata);
@@ -29,6 +29,16 @@ u32 platform_flash_read( u32 fromaddr, void *toaddr, u32 size )
     return(result);
 }
 
+const u8 *platform_flash_xip_ptr( u32 addr )
+{
+    return(flash_xip_ptr(flashHandle, addr));
+}
+
+void platform_flash_xip_release( void )
+{
+    flash_xip_release(flashHandle);
+}
+
 u32 platform_flash_get_first_free_block_address( u32 *psect )
 {
     u32 address;
@@ -7,6 +7,7 @@
    #include <unistd.h>
    #include <fcntl.h>
 #else
+   #include <stddef.h>
    #include "local_fcntl.h"
    #include "local_errno.h"
    struct _reent
@@ -47,5 +48,7 @@ u32 platform_s_flash_write( const void *from, u32 toaddr, u32 size );
 u32 platform_flash_get_num_sectors(void);
 int platform_flash_erase_sector( u32 sector_id );
 u32 platform_flash_read( u32 fromaddr, void *toaddr, u32 size );
+const u8 *platform_flash_xip_ptr( u32 addr );
+void platform_flash_xip_release( void );
 
 #endif
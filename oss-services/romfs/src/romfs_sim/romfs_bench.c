@@ -0,0 +1,387 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host benchmark for the romfs file name index and bulk header scans.
+ *
+ * The filesystem is filled by a random churn of creates, rewrites and
+ * deletes over a set of files so the live headers are spread among
+ * deleted ones.  The contents of every file are verified, before and
+ * after a remount, then romfs_init(), opens of existing files and opens
+ * of missing files are timed.  The flash simulator accounts each read
+ * as a command overhead plus a per byte time, so the simulated flash
+ * time per operation is reported along with the read commands and
+ * bytes.
+ *
+ * The files are also read through dm_getaddr() pointers into the
+ * memory-mapped window.  Files must not be created, deleted or the
+ * filesystem formatted while a pointer is held, and a file must be
+ * writable again once the pointers have been released by fs_close().
+ *
+ * Build with and without the index to compare, from the 'romfs'
+ * directory with:
+ *   gcc -O2 -DFLASH_SIM_HOST -Iinc -Isrc \
+ *       -I../../simple-drivers/flash/src \
+ *       -I../../simple-drivers/flash/src/flash_sim \
+ *       -o romfs_bench src/romfs_sim/romfs_bench.c src/romfs.c \
+ *       src/romfs_devman.c src/romfs_platform.c \
+ *       ../../simple-drivers/flash/src/flash.c \
+ *       ../../simple-drivers/flash/src/flash_sim/flash_sim.c -lpthread
+ *
+ *   Add -DROMFS_INDEX_SIZE=0 -DROMFS_SCAN_BUF_SIZE=0 for the original
+ *   header by header scan.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "flash.h"
+#include "flash_sim.h"
+#include "romfs.h"
+#include "romfs_devman.h"
+
+#define BENCH_MAX_FILES     1000
+#define BENCH_MAX_FILE      4096
+
+typedef struct {
+    uint32_t files;
+    uint32_t churn;
+    uint32_t maxSize;
+    uint32_t rounds;
+    uint32_t seed;
+} BENCH_CFG;
+
+typedef struct {
+    const FLASH_INFO *fi;
+    int size[BENCH_MAX_FILES];      /* -1 = no file */
+    int gen[BENCH_MAX_FILES];
+    uint8_t buf[BENCH_MAX_FILE];
+} BENCH_STATE;
+
+static BENCH_STATE bench;
+
+static uint32_t rngState;
+
+static uint32_t bench_rand(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return(rngState);
+}
+
+static uint8_t bench_fill(int i, int k)
+{
+    return((uint8_t)(i + bench.gen[i] + k));
+}
+
+static void bench_name(char *name, int i)
+{
+    snprintf(name, 16, "file_%03d.dat", i);
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((double)ts.tv_sec + (double)ts.tv_nsec * 1e-9);
+}
+
+static int bench_check(uint32_t files)
+{
+    char name[16];
+    int fd, n, k;
+    uint32_t i;
+    int bad = 0;
+
+    for (i = 0; i < files; i++) {
+        bench_name(name, i);
+        fd = fs_open(name, O_RDONLY);
+        if (bench.size[i] < 0) {
+            if (fd >= 0) {
+                bad++;
+                fs_close(fd);
+            }
+            continue;
+        }
+        if (fd < 0) {
+            bad++;
+            continue;
+        }
+        n = fs_read(fd, bench.buf, sizeof(bench.buf));
+        if (n != bench.size[i]) {
+            bad++;
+        } else {
+            for (k = 0; k < n; k++) {
+                if (bench.buf[k] != bench_fill(i, k)) {
+                    bad++;
+                    break;
+                }
+            }
+        }
+        fs_close(fd);
+    }
+    return(bad);
+}
+
+/* Verify every file through a pointer into the memory-mapped window */
+static int bench_xip(uint32_t files)
+{
+    char name[16];
+    const char *p, *q;
+    int fd, wfd, k;
+    uint32_t i;
+    int bad = 0;
+
+    for (i = 0; i < files; i++) {
+        if (bench.size[i] < 0) {
+            continue;
+        }
+        bench_name(name, i);
+        fd = fs_open(name, O_RDONLY);
+        if (fd < 0) {
+            bad++;
+            continue;
+        }
+        p = dm_getaddr(fd);
+        q = dm_getaddr(fd);
+        if ((p == NULL) || (q != p)) {
+            bad++;
+            fs_close(fd);
+            continue;
+        }
+        for (k = 0; k < bench.size[i]; k++) {
+            if ((uint8_t)p[k] != bench_fill(i, k)) {
+                bad++;
+                break;
+            }
+        }
+        /* Reads nest inside the hold, writes are refused */
+        if (fs_read(fd, bench.buf, sizeof(bench.buf)) != bench.size[i]) {
+            bad++;
+        }
+        wfd = fs_open("xip_new.dat", O_WRONLY | O_CREAT | O_TRUNC);
+        if (wfd >= 0) {
+            bad++;
+            fs_close(wfd);
+        }
+        if ((dm_unlink(name) == FS_FILE_OK) || romfs_format(0)) {
+            bad++;
+        }
+        fs_close(fd);
+    }
+
+    /* Writable again once released */
+    fd = fs_open("xip_new.dat", O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) {
+        return(bad + 1);
+    }
+    fs_write(fd, (unsigned char *)"xip", 3);
+    fs_close(fd);
+    if (dm_unlink("xip_new.dat") != FS_FILE_OK) {
+        bad++;
+    }
+
+    return(bad);
+}
+
+/* Print the cost of 'ops' operations since the statistics were reset */
+static void bench_report(const char *what, uint32_t ops, double start)
+{
+    FLASH_SIM_STATS stats;
+    double us;
+
+    us = (bench_now() - start) * 1e6;
+    flash_sim_stats(bench.fi, &stats, true);
+    printf("%-14s %8u %10.2f %10.1f %10.0f %10.1f\n", what, ops, us / ops,
+        (double)stats.reads / ops, (double)stats.readBytes / ops,
+        (double)stats.busyNs / 1000.0 / ops);
+}
+
+static void usage(void)
+{
+    printf("romfs_bench [options]\n");
+    printf("  -f <files>   Number of file names (200, max %d)\n", BENCH_MAX_FILES);
+    printf("  -c <ops>     Create/rewrite/delete operations (1500)\n");
+    printf("  -z <bytes>   Max file size (600, max %d)\n", BENCH_MAX_FILE);
+    printf("  -r <rounds>  Open rounds over all names (20)\n");
+    printf("  -s <seed>    Random seed (3)\n");
+}
+
+int main(int argc, char **argv)
+{
+    BENCH_CFG cfg = {
+        .files = 200, .churn = 1500, .maxSize = 600, .rounds = 20, .seed = 3
+    };
+    /* 50MHz quad SPI: ~1uS per read command, 40nS per byte */
+    FLASH_SIM_CONFIG simCfg = {
+        .size = ROMFS_FS_END_ADDRESS, .eraseSize = ROMFS_FLASH_SECTOR_SIZE,
+        .pageSize = 256, .readSetupNs = 1000, .readByteNs = 40, .seed = 1
+    };
+    char name[16];
+    u32 size, used;
+    uint32_t i, n, live, r;
+    double start;
+    int fd, k, rep;
+    int c;
+
+    while ((c = getopt(argc, argv, "f:c:z:r:s:h")) != -1) {
+        switch (c) {
+            case 'f': cfg.files = strtoul(optarg, NULL, 0); break;
+            case 'c': cfg.churn = strtoul(optarg, NULL, 0); break;
+            case 'z': cfg.maxSize = strtoul(optarg, NULL, 0); break;
+            case 'r': cfg.rounds = strtoul(optarg, NULL, 0); break;
+            case 's': cfg.seed = strtoul(optarg, NULL, 0); break;
+            default: usage(); return(1);
+        }
+    }
+    if ((cfg.files == 0) || (cfg.files > BENCH_MAX_FILES) ||
+        (cfg.maxSize == 0) || (cfg.maxSize > BENCH_MAX_FILE)) {
+        usage();
+        return(1);
+    }
+    rngState = cfg.seed ? cfg.seed : 1;
+
+    bench.fi = flash_sim_open(&simCfg);
+    if (bench.fi == NULL) {
+        printf("flash_sim_open failed\n");
+        return(1);
+    }
+    romfs_init(bench.fi);
+    romfs_format(1);
+    romfs_init(bench.fi);
+
+    /* Churn */
+    for (i = 0; i < cfg.files; i++) {
+        bench.size[i] = -1;
+    }
+    for (n = 0; n < cfg.churn; n++) {
+        i = bench_rand() % cfg.files;
+        bench_name(name, i);
+        if ((bench_rand() % 4 == 0) && (bench.size[i] >= 0)) {
+            dm_unlink(name);
+            bench.size[i] = -1;
+            continue;
+        }
+        romfs_full(&size, &used);
+        if (used + cfg.maxSize + 64 > size) {
+            break;
+        }
+        fd = fs_open(name, O_WRONLY | O_CREAT | O_TRUNC);
+        if (fd < 0) {
+            printf("open for write failed after %u operations\n", n);
+            break;
+        }
+        bench.gen[i] = bench_rand() % 50;
+        bench.size[i] = bench_rand() % cfg.maxSize;
+        for (k = 0; k < bench.size[i]; k++) {
+            bench.buf[k] = bench_fill(i, k);
+        }
+        fs_write(fd, bench.buf, bench.size[i]);
+        fs_close(fd);
+    }
+
+    if (bench_check(cfg.files)) {
+        printf("%d files bad\n", bench_check(cfg.files));
+        return(2);
+    }
+    romfs_init(bench.fi);
+    if (bench_check(cfg.files) || (romfs_fsck(0, &rep) != FS_OK)) {
+        printf("filesystem bad after remount\n");
+        return(2);
+    }
+
+    /* Pointers into the window, then back to reads for the timings */
+    for (i = 0; (i < cfg.files) && (bench.size[i] < 0); i++);
+    bench_name(name, i);
+    fd = fs_open(name, O_RDONLY);
+    if ((fd >= 0) && (dm_getaddr(fd) != NULL)) {
+        printf("address returned without XIP\n");
+        return(2);
+    }
+    if (fd >= 0) {
+        fs_close(fd);
+    }
+    if ((flash_xip_enable((FLASH_INFO *)bench.fi) != FLASH_OK) ||
+        bench_xip(cfg.files) || (flash_xip_disable((FLASH_INFO *)bench.fi) != FLASH_OK) ||
+        bench_check(cfg.files) || (romfs_fsck(0, &rep) != FS_OK)) {
+        printf("filesystem bad through the XIP window\n");
+        return(2);
+    }
+
+    live = 0;
+    for (i = 0; i < cfg.files; i++) {
+        if (bench.size[i] >= 0) {
+            live++;
+        }
+    }
+    romfs_full(&size, &used);
+    printf("index %u slots, scan buffer %u bytes\n",
+        (unsigned)ROMFS_INDEX_SIZE, (unsigned)ROMFS_SCAN_BUF_SIZE);
+    printf("%u live files of %u names, %u of %u bytes used\n\n",
+        live, cfg.files, used, size);
+    printf("%-14s %8s %10s %10s %10s %10s\n", "operation", "count",
+        "host uS", "reads", "bytes", "flash uS");
+
+    /* Mount */
+    flash_sim_stats(bench.fi, NULL, true);
+    start = bench_now();
+    romfs_init(bench.fi);
+    bench_report("romfs_init", 1, start);
+
+    /* Opens of existing files */
+    n = 0;
+    start = bench_now();
+    for (r = 0; r < cfg.rounds; r++) {
+        for (i = 0; i < cfg.files; i++) {
+            if (bench.size[i] >= 0) {
+                bench_name(name, i);
+                fd = fs_open(name, O_RDONLY);
+                if (fd >= 0) {
+                    fs_close(fd);
+                }
+                n++;
+            }
+        }
+    }
+    if (n) {
+        bench_report("open found", n, start);
+    }
+
+    /* Opens of missing files */
+    n = 0;
+    start = bench_now();
+    for (r = 0; r < cfg.rounds; r++) {
+        for (i = 0; i < cfg.files; i++) {
+            if (bench.size[i] < 0) {
+                bench_name(name, i);
+                fd = fs_open(name, O_RDONLY);
+                if (fd >= 0) {
+                    fs_close(fd);
+                }
+                n++;
+            }
+        }
+    }
+    if (n) {
+        bench_report("open missing", n, start);
+    }
+
+    flash_sim_close(bench.fi);
+
+    return(0);
+}
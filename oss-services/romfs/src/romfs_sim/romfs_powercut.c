@@ -0,0 +1,372 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host power-cut test for romfs compaction and format.
+ *
+ * Each trial formats the filesystem, fills it with a random mix of
+ * writes and deletes, then compacts it in random size steps with reads
+ * and writes in between.  The flash simulator cuts the power during a
+ * random program or erase, optionally again during the recovery in
+ * romfs_init(), and sometimes the filesystem is then formatted before
+ * the recovery has run.  After every reboot the filesystem must pass
+ * romfs_fsck() and hold exactly the files written before the cut (or no
+ * files after a format), and a completed compaction must leave no
+ * deleted space and an erased tail.
+ *
+ * Build from the 'romfs' directory with:
+ *   gcc -O2 -DFLASH_SIM_HOST -DROMFS_COMPACT=1 -Iinc -Isrc \
+ *       -I../../simple-drivers/flash/src \
+ *       -I../../simple-drivers/flash/src/flash_sim \
+ *       -o romfs_powercut src/romfs_sim/romfs_powercut.c src/romfs.c \
+ *       src/romfs_devman.c src/romfs_platform.c \
+ *       ../../simple-drivers/flash/src/flash.c \
+ *       ../../simple-drivers/flash/src/flash_sim/flash_sim.c -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "flash.h"
+#include "flash_sim.h"
+#include "romfs.h"
+#include "romfs_devman.h"
+
+#if !ROMFS_COMPACT
+#error "Build with ROMFS_COMPACT=1"
+#endif
+
+#define SIM_FILES           40
+#define SIM_MAX_FILE        20000
+#define SIM_MAX_STEPS       100000
+
+typedef struct {
+    const FLASH_INFO *fi;
+    int size[SIM_FILES];            /* -1 = no file */
+    int gen[SIM_FILES];
+    uint8_t buf[SIM_MAX_FILE];
+    bool verbose;
+} SIM_STATE;
+
+static SIM_STATE sim;
+
+static uint32_t rngState;
+
+static uint32_t sim_rand(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return(rngState);
+}
+
+static uint8_t sim_fill(int i, int k)
+{
+    return((uint8_t)(i * 7 + sim.gen[i] * 13 + k));
+}
+
+static void sim_name(char *name, int i)
+{
+    sprintf(name, "f%02d", i);
+}
+
+static bool sim_write(int i, int size)
+{
+    char name[8];
+    int fd, k, n;
+
+    sim_name(name, i);
+    fd = fs_open(name, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) {
+        return(false);
+    }
+    sim.gen[i] = sim_rand() % 100;
+    for (k = 0; k < size; k++) {
+        sim.buf[k] = sim_fill(i, k);
+    }
+    n = fs_write(fd, sim.buf, size);
+    fs_close(fd);
+    sim.size[i] = size;
+    return(n == size);
+}
+
+static void sim_unlink(int i)
+{
+    char name[8];
+
+    sim_name(name, i);
+    dm_unlink(name);
+    sim.size[i] = -1;
+}
+
+static bool sim_room(u32 need)
+{
+    u32 size, used;
+
+    romfs_full(&size, &used);
+    return(used + need < size);
+}
+
+/* Returns the number of files not matching the model.  Opens fail
+ * with EBUSY while a compaction move is in progress, those files are
+ * skipped if 'moving' is set. */
+static int sim_check(const char *tag, bool moving)
+{
+    char name[8];
+    int i, k, n, fd;
+    int bad = 0;
+
+    for (i = 0; i < SIM_FILES; i++) {
+        sim_name(name, i);
+        fd = fs_open(name, O_RDONLY);
+        if ((fd < 0) && moving) {
+            continue;
+        }
+        if (sim.size[i] < 0) {
+            if (fd >= 0) {
+                bad++;
+                fs_close(fd);
+            }
+            continue;
+        }
+        if (fd < 0) {
+            bad++;
+            continue;
+        }
+        n = fs_read(fd, sim.buf, sizeof(sim.buf));
+        if (n != sim.size[i]) {
+            bad++;
+        } else {
+            for (k = 0; k < n; k++) {
+                if (sim.buf[k] != sim_fill(i, k)) {
+                    bad++;
+                    break;
+                }
+            }
+        }
+        fs_close(fd);
+    }
+    if (bad) {
+        printf("  %s: %d bad files\n", tag, bad);
+    }
+    return(bad);
+}
+
+/* Power back on, with the power optionally cut again during the
+ * recovery done by romfs_init().  Returns true if it was cut. */
+static bool sim_reboot(uint32_t cutOps)
+{
+    bool cut = false;
+
+    flash_sim_power_on(sim.fi);
+    if (cutOps) {
+        flash_sim_power_cut(sim.fi, cutOps);
+        romfs_init(sim.fi);
+        cut = flash_sim_power_lost(sim.fi);
+        flash_sim_power_on(sim.fi);
+    }
+    return(cut);
+}
+
+static int sim_trial(uint32_t trial, uint32_t maxCut)
+{
+    u32 size, used, expect, a;
+    uint32_t cutOps, steps;
+    uint8_t *mem;
+    const char *how;
+    int i, ops, r, rep;
+    bool cut;
+
+    rngState = trial * 2654435761u + 1;
+
+    romfs_init(sim.fi);
+    romfs_format(1);
+    romfs_init(sim.fi);
+    for (i = 0; i < SIM_FILES; i++) {
+        sim.size[i] = -1;
+    }
+
+    /* Fragment the filesystem */
+    ops = 20 + sim_rand() % 60;
+    while (ops--) {
+        i = sim_rand() % SIM_FILES;
+        if ((sim.size[i] >= 0) && (sim_rand() % 4 == 0)) {
+            sim_unlink(i);
+        } else {
+            r = (sim_rand() % 5 == 0) ? sim_rand() % SIM_MAX_FILE :
+                sim_rand() % 1500;
+            if (!sim_room(r + 200)) {
+                break;
+            }
+            sim_write(i, r);
+        }
+    }
+
+    /* Compact with the power cut somewhere in the first 'maxCut'
+     * programs and erases, or not at all in every third trial.  Files
+     * are only written during the compaction when there is no cut as
+     * a torn file write is not recoverable. */
+    cutOps = (trial % 3 == 0) ? 0 : 1 + sim_rand() % maxCut;
+    flash_sim_power_cut(sim.fi, cutOps);
+    steps = 0;
+    do {
+        r = romfs_compact(1 + sim_rand() % 4);
+        if (flash_sim_power_lost(sim.fi)) {
+            break;
+        }
+        if ((r == ROMFS_COMPACT_MORE) && (sim_rand() % 3 == 0) &&
+            sim_check("during compact", true)) {
+            flash_sim_power_cut(sim.fi, 0);
+            printf("trial %u\n", trial);
+            return(1);
+        }
+        if ((r == ROMFS_COMPACT_MORE) && (cutOps == 0) &&
+            (sim_rand() % 10 == 0)) {
+            if (sim_room(3000)) {
+                sim_write(sim_rand() % SIM_FILES, sim_rand() % 2000);
+            }
+        }
+    } while (((r == ROMFS_COMPACT_MORE) || (r == ROMFS_COMPACT_BUSY)) &&
+        (++steps < SIM_MAX_STEPS));
+    cut = flash_sim_power_lost(sim.fi);
+    flash_sim_power_cut(sim.fi, 0);
+    if (!cut && (r != ROMFS_COMPACT_DONE)) {
+        printf("trial %u: compact result %d\n", trial, r);
+        return(1);
+    }
+
+    /* Reboot, sometimes cutting the recovery short.  A quarter of the
+     * cut trials then format, as an application would after a failed
+     * mount, without the recovery having completed. */
+    how = cut ? "cut" : "compact";
+    if (cut && (sim_rand() % 4 == 0)) {
+        how = sim_reboot(1 + sim_rand() % 6) ?
+            "format after cut recovery" : "format";
+        romfs_format(sim_rand() % 2);
+        for (i = 0; i < SIM_FILES; i++) {
+            sim.size[i] = -1;
+        }
+    } else if (cut) {
+        if (sim_reboot((sim_rand() % 2) ? 1 + sim_rand() % 6 : 0)) {
+            how = "cut recovery";
+        }
+    }
+    romfs_init(sim.fi);
+    if (romfs_fsck(0, &rep) != FS_OK) {
+        printf("trial %u (%s): fsck failed\n", trial, how);
+        return(1);
+    }
+    if (sim_check("after reboot", false)) {
+        printf("trial %u (%s)\n", trial, how);
+        return(1);
+    }
+
+    /* Finish the compaction */
+    steps = 0;
+    while (((r = romfs_compact(8)) == ROMFS_COMPACT_MORE) &&
+        (++steps < SIM_MAX_STEPS));
+    if (r != ROMFS_COMPACT_DONE) {
+        printf("trial %u (%s): finish result %d\n", trial, how, r);
+        return(1);
+    }
+    romfs_init(sim.fi);
+    if ((romfs_fsck(0, &rep) != FS_OK) || sim_check("final", false)) {
+        printf("trial %u (%s): final\n", trial, how);
+        return(1);
+    }
+
+    /* No deleted space and an erased tail.  Names are "fNN" so each
+     * header is 4 bytes of name, a flags word and a size word. */
+    expect = 0;
+    for (i = 0; i < SIM_FILES; i++) {
+        if (sim.size[i] >= 0) {
+            expect += (4 + 4 + 4 + sim.size[i] + 3) & ~3;
+        }
+    }
+    romfs_full(&size, &used);
+    if (used != expect) {
+        printf("trial %u (%s): used %u expected %u\n", trial, how, used,
+            expect);
+        return(1);
+    }
+    mem = flash_sim_mem(sim.fi) + ROMFS_FS_START_ADDRESS;
+    for (a = used; a < size; a++) {
+        if (mem[a] != 0xFF) {
+            printf("trial %u (%s): tail not erased at %u\n", trial, how,
+                a);
+            return(1);
+        }
+    }
+
+    /* Still writable */
+    sim_write(0, 777);
+    if (sim_check("write after compact", false)) {
+        printf("trial %u (%s)\n", trial, how);
+        return(1);
+    }
+
+    if (sim.verbose) {
+        printf("trial %u (%s): ok\n", trial, how);
+    }
+    return(0);
+}
+
+static void usage(void)
+{
+    printf("romfs_powercut [options]\n");
+    printf("  -n <trials>  Number of trials (2000)\n");
+    printf("  -s <first>   First trial (0)\n");
+    printf("  -c <ops>     Cut within the first <ops> programs/erases (400)\n");
+    printf("  -v           Print every trial\n");
+}
+
+int main(int argc, char **argv)
+{
+    FLASH_SIM_CONFIG cfg = {
+        .size = ROMFS_FS_END_ADDRESS, .eraseSize = ROMFS_FLASH_SECTOR_SIZE,
+        .pageSize = 256, .seed = 1
+    };
+    uint32_t trials = 2000, first = 0, maxCut = 400, t;
+    int fails = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:s:c:vh")) != -1) {
+        switch (c) {
+            case 'n': trials = strtoul(optarg, NULL, 0); break;
+            case 's': first = strtoul(optarg, NULL, 0); break;
+            case 'c': maxCut = strtoul(optarg, NULL, 0); break;
+            case 'v': sim.verbose = true; break;
+            default: usage(); return(1);
+        }
+    }
+    if (maxCut == 0) {
+        maxCut = 1;
+    }
+
+    sim.fi = flash_sim_open(&cfg);
+    if (sim.fi == NULL) {
+        printf("flash_sim_open failed\n");
+        return(1);
+    }
+
+    for (t = first; t < first + trials; t++) {
+        fails += sim_trial(t, (t % 3 == 1) ? 40 : maxCut);
+    }
+    printf("%u trials, %d failed\n", trials, fails);
+
+    flash_sim_close(sim.fi);
+
+    return(fails ? 2 : 0);
+}
@@ -10,6 +10,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #ifdef FREE_RTOS
 #include "FreeRTOS.h"
@@ -20,7 +21,9 @@
 #include "spiffs_fs.h"
 #include "spiffs_fs_cfg.h"
 
+#ifndef FLASH_SIM_HOST
 #include "spi_simple.h"
+#endif
 
 #ifndef SPIFFS_FS_CALLOC
 #define SPIFFS_FS_CALLOC calloc
@@ -46,6 +49,15 @@
 #error Must define SPIFFS_FS_FLASH_PAGE_SIZE
 #endif
 
+/* Number of flash pages held in the SPIFFS cache (1 to 32) */
+#ifndef SPIFFS_FS_CACHE_PAGES
+#define SPIFFS_FS_CACHE_PAGES  8
+#endif
+
+#if SPIFFS_CACHE && ((SPIFFS_FS_CACHE_PAGES < 1) || (SPIFFS_FS_CACHE_PAGES > 32))
+#error SPIFFS_FS_CACHE_PAGES must be between 1 and 32
+#endif
+
 typedef struct SPIFFS_FS {
     FLASH_INFO *fi;
 #ifdef FREE_RTOS
@@ -56,23 +68,29 @@ typedef struct SPIFFS_FS {
     u8_t *spiffs_work_buf;
     u8_t *spiffs_fds;
     u32_t filedescs_size;
+    SPIFFS_FS_STATS stats;
 } SPIFFS_FS;
 
 static s32_t my_spiffs_read(spiffs *fs, u32_t addr, u32_t size, u8_t *dst) {
     SPIFFS_FS *FS = (SPIFFS_FS *)fs->user_data;
     int ok = flash_read(FS->fi, addr, dst, size);
+    FS->stats.flashReads++;
+    FS->stats.flashReadBytes += size;
     return(ok == FLASH_OK ? SPIFFS_OK : -1);
 }
 
 static s32_t my_spiffs_write(spiffs *fs, u32_t addr, u32_t size, u8_t *src) {
     SPIFFS_FS *FS = (SPIFFS_FS *)fs->user_data;
     int ok = flash_program(FS->fi, addr, src, size);
+    FS->stats.flashWrites++;
+    FS->stats.flashWriteBytes += size;
     return(ok == FLASH_OK ? SPIFFS_OK : -1);
 }
 
 static s32_t my_spiffs_erase(spiffs *fs, u32_t addr, u32_t size) {
     SPIFFS_FS *FS = (SPIFFS_FS *)fs->user_data;
     int ok = flash_erase(FS->fi, addr, size);
+    FS->stats.flashErases++;
     return(ok == FLASH_OK ? SPIFFS_OK : -1);
 }
 
@@ -97,6 +115,19 @@ s32_t spiffs_mount(spiffs *fs, FLASH_INFO *fi)
     spiffs_config cfg;
     SPIFFS_FS *FS;
 
+    cfg.phys_size = SPIFFS_FS_SIZE;
+    cfg.phys_addr = SPIFFS_FS_OFFSET;
+    cfg.phys_erase_block = SPIFFS_FS_ERASE_BLOCK_SIZE;
+    cfg.log_block_size = SPIFFS_FS_ERASE_BLOCK_SIZE * 16;
+    cfg.log_page_size = SPIFFS_FS_FLASH_PAGE_SIZE;
+
+    cfg.hal_read_f = my_spiffs_read;
+    cfg.hal_write_f = my_spiffs_write;
+    cfg.hal_erase_f = my_spiffs_erase;
+
+    /* SPIFFS_buffer_bytes_for_cache() sizes pages from fs->cfg */
+    fs->cfg = cfg;
+
     FS = SPIFFS_FS_CALLOC(1, sizeof(*FS));
     FS->spiffs_work_buf =
         SPIFFS_FS_CALLOC(SPIFFS_FS_FLASH_PAGE_SIZE*2, sizeof(u8_t));
@@ -105,7 +136,7 @@ s32_t spiffs_mount(spiffs *fs, FLASH_INFO *fi)
     FS->spiffs_fds =
         SPIFFS_FS_CALLOC(FS->filedescs_size, sizeof(u8_t));
 #if SPIFFS_CACHE
-    FS->cache_size = SPIFFS_buffer_bytes_for_cache(fs, 32);
+    FS->cache_size = SPIFFS_buffer_bytes_for_cache(fs, SPIFFS_FS_CACHE_PAGES);
     FS->spiffs_cache_buf = SPIFFS_FS_CALLOC(FS->cache_size, sizeof(u8_t));
 #else
     FS->cache_size = 0;
@@ -117,16 +148,6 @@ s32_t spiffs_mount(spiffs *fs, FLASH_INFO *fi)
     FS->fi = fi;
     fs->user_data = FS;
 
-    cfg.phys_size = SPIFFS_FS_SIZE;
-    cfg.phys_addr = SPIFFS_FS_OFFSET;
-    cfg.phys_erase_block = SPIFFS_FS_ERASE_BLOCK_SIZE;
-    cfg.log_block_size = SPIFFS_FS_ERASE_BLOCK_SIZE * 16;
-    cfg.log_page_size = SPIFFS_FS_FLASH_PAGE_SIZE;
-
-    cfg.hal_read_f = my_spiffs_read;
-    cfg.hal_write_f = my_spiffs_write;
-    cfg.hal_erase_f = my_spiffs_erase;
-
     int res = SPIFFS_mount(fs,
         &cfg,
         FS->spiffs_work_buf,
@@ -190,3 +211,37 @@ s32_t spiffs_format(spiffs *fs)
 
     return(ok);
 }
+
+void spiffs_stats(spiffs *fs, SPIFFS_FS_STATS *stats, bool reset)
+{
+    SPIFFS_FS *FS = (SPIFFS_FS *)fs->user_data;
+
+    spiffs_lock(fs);
+
+    if (stats) {
+        *stats = FS->stats;
+#if SPIFFS_CACHE
+        stats->cachePages = SPIFFS_FS_CACHE_PAGES;
+#if SPIFFS_CACHE_STATS
+        stats->cacheHits = fs->cache_hits;
+        stats->cacheMisses = fs->cache_misses;
+#endif
+#endif
+#if SPIFFS_GC_STATS
+        stats->gcRuns = fs->stats_gc_runs;
+#endif
+    }
+
+    if (reset) {
+        memset(&FS->stats, 0, sizeof(FS->stats));
+#if SPIFFS_CACHE && SPIFFS_CACHE_STATS
+        fs->cache_hits = 0;
+        fs->cache_misses = 0;
+#endif
+#if SPIFFS_GC_STATS
+        fs->stats_gc_runs = 0;
+#endif
+    }
+
+    spiffs_unlock(fs);
+}
@@ -12,13 +12,34 @@
 #ifndef _spiffs_fs_h
 #define _spiffs_fs_h
 
+#include <stdbool.h>
+
 #include "spiffs.h"
 #include "flash.h"
 
+typedef struct SPIFFS_FS_STATS {
+    u32_t cachePages;       /**< Pages in the cache (0 if disabled) */
+    u32_t cacheHits;        /**< Cache hits (SPIFFS_CACHE_STATS) */
+    u32_t cacheMisses;      /**< Cache misses (SPIFFS_CACHE_STATS) */
+    u32_t gcRuns;           /**< Garbage collections (SPIFFS_GC_STATS) */
+    u32_t flashReads;       /**< flash_read() calls */
+    u32_t flashReadBytes;   /**< Bytes read from flash */
+    u32_t flashWrites;      /**< flash_program() calls */
+    u32_t flashWriteBytes;  /**< Bytes programmed into flash */
+    u32_t flashErases;      /**< flash_erase() calls */
+} SPIFFS_FS_STATS;
+
 s32_t spiffs_mount(spiffs *fs, FLASH_INFO *f);
+void spiffs_unmount(spiffs *fs, FLASH_INFO **fi);
 s32_t spiffs_format(spiffs *fs);
 
 void spiffs_lock(spiffs *fs);
 void spiffs_unlock(spiffs *fs);
 
+/* Returns the cache, gc and flash access counters of a mounted
+ * filesystem in 'stats' (optional).  If 'reset' is true the counters
+ * are cleared afterwards.
+ */
+void spiffs_stats(spiffs *fs, SPIFFS_FS_STATS *stats, bool reset);
+
 #endif
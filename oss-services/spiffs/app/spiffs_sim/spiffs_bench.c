@@ -0,0 +1,379 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host benchmark of SPIFFS over the simulated flash from
+ * 'simple-drivers/flash' (flash_sim).
+ *
+ * A 1MB filesystem is formatted and filled with files written in small
+ * chunks.  The files are then read sequentially and at random offsets,
+ * and finally rewritten at random with new sizes until the garbage
+ * collector has had to run many times.  The contents of every file are
+ * checked at the end.  For each phase the simulated flash time, the
+ * SPIFFS cache hits and misses, the garbage collections and the flash
+ * reads, programs and erases are reported, followed by the spread of
+ * block erase counts.  It exits with 2 on a failure.
+ *
+ * The cache and garbage collector are configured at compile time, so
+ * build once per setting of SPIFFS_FS_CACHE_PAGES, SPIFFS_CACHE_WR,
+ * SPIFFS_CACHE or SPIFFS_GC_HEUR_* to compare ('spiffs_bench.sh' does
+ * this).  Build from the 'spiffs' directory with:
+ *   FLASH=../../simple-drivers/flash/src
+ *   gcc -O2 -DFLASH_SIM_HOST -Iapp/spiffs_sim -Iinc -Isrc -Iapp -I$FLASH \
+ *       -I$FLASH/flash_sim -o spiffs_bench app/spiffs_sim/spiffs_bench.c \
+ *       app/spiffs_fs.c src/spiffs_*.c $FLASH/flash.c \
+ *       $FLASH/flash_sim/flash_sim.c -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "spiffs.h"
+#include "spiffs_fs.h"
+#include "spiffs_fs_cfg.h"
+
+#include "flash.h"
+#include "flash_sim.h"
+
+#define BENCH_MAX_FILES     (128)
+#define BENCH_MAX_CHUNK     (4096)
+
+typedef struct {
+    uint32_t files;
+    uint32_t maxKB;
+    uint32_t chunk;
+    uint32_t passes;
+    uint32_t randomReads;
+    uint32_t rewrites;
+    uint32_t seed;
+} BENCH_CFG;
+
+typedef struct {
+    uint32_t seed;
+    uint32_t size;
+} BENCH_FILE;
+
+static spiffs fs;
+static FLASH_INFO *flash;
+static BENCH_FILE files[BENCH_MAX_FILES];
+static uint8_t buf[BENCH_MAX_CHUNK];
+static uint32_t randState;
+static SPIFFS_FS_STATS benchTotal;
+static uint64_t benchTotalNs;
+
+static uint32_t bench_rand(void)
+{
+    randState ^= randState << 13;
+    randState ^= randState >> 17;
+    randState ^= randState << 5;
+    return(randState);
+}
+
+/* File contents are a function of the file seed and the offset */
+static uint8_t bench_byte(uint32_t seed, uint32_t offset)
+{
+    uint32_t x = seed + offset * 0x9E3779B1u;
+
+    x ^= x >> 15;
+    x *= 0x2C1B3C6Du;
+    x ^= x >> 12;
+    return((uint8_t)x);
+}
+
+static void bench_fill(uint8_t *b, uint32_t seed, uint32_t offset,
+    uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        b[i] = bench_byte(seed, offset + i);
+    }
+}
+
+static bool bench_check(const uint8_t *b, uint32_t seed, uint32_t offset,
+    uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        if (b[i] != bench_byte(seed, offset + i)) {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+static void bench_name(char *name, uint32_t idx)
+{
+    sprintf(name, "file%03u.dat", (unsigned)idx);
+}
+
+static bool bench_write_file(const BENCH_CFG *cfg, uint32_t idx)
+{
+    BENCH_FILE *f = &files[idx];
+    char name[SPIFFS_OBJ_NAME_LEN];
+    spiffs_file fh;
+    uint32_t done, len;
+    bool ok = true;
+
+    f->seed = bench_rand();
+    f->size = 1 + bench_rand() % (cfg->maxKB * 1024);
+
+    bench_name(name, idx);
+    fh = SPIFFS_open(&fs, name, SPIFFS_CREAT | SPIFFS_TRUNC | SPIFFS_WRONLY, 0);
+    if (fh < 0) {
+        printf("open %s failed (%d)\n", name, (int)SPIFFS_errno(&fs));
+        return(false);
+    }
+    for (done = 0; done < f->size; done += len) {
+        len = (f->size - done > cfg->chunk) ? cfg->chunk : f->size - done;
+        bench_fill(buf, f->seed, done, len);
+        if (SPIFFS_write(&fs, fh, buf, len) != (s32_t)len) {
+            printf("write %s failed (%d)\n", name, (int)SPIFFS_errno(&fs));
+            ok = false;
+            break;
+        }
+    }
+    if (SPIFFS_close(&fs, fh) != SPIFFS_OK) {
+        ok = false;
+    }
+    return(ok);
+}
+
+static bool bench_read_file(const BENCH_CFG *cfg, uint32_t idx)
+{
+    BENCH_FILE *f = &files[idx];
+    char name[SPIFFS_OBJ_NAME_LEN];
+    spiffs_file fh;
+    uint32_t done, len;
+    bool ok = true;
+
+    bench_name(name, idx);
+    fh = SPIFFS_open(&fs, name, SPIFFS_RDONLY, 0);
+    if (fh < 0) {
+        printf("open %s failed (%d)\n", name, (int)SPIFFS_errno(&fs));
+        return(false);
+    }
+    for (done = 0; done < f->size; done += len) {
+        len = (f->size - done > cfg->chunk) ? cfg->chunk : f->size - done;
+        if ((SPIFFS_read(&fs, fh, buf, len) != (s32_t)len) ||
+            !bench_check(buf, f->seed, done, len)) {
+            printf("read %s failed at %u\n", name, (unsigned)done);
+            ok = false;
+            break;
+        }
+    }
+    SPIFFS_close(&fs, fh);
+    return(ok);
+}
+
+static bool bench_read_random(const BENCH_CFG *cfg, uint32_t idx)
+{
+    BENCH_FILE *f = &files[idx];
+    char name[SPIFFS_OBJ_NAME_LEN];
+    spiffs_file fh;
+    uint32_t offset, len;
+    bool ok = true;
+
+    bench_name(name, idx);
+    fh = SPIFFS_open(&fs, name, SPIFFS_RDONLY, 0);
+    if (fh < 0) {
+        return(false);
+    }
+    offset = bench_rand() % f->size;
+    len = (f->size - offset > cfg->chunk) ? cfg->chunk : f->size - offset;
+    if ((SPIFFS_lseek(&fs, fh, offset, SPIFFS_SEEK_SET) != (s32_t)offset) ||
+        (SPIFFS_read(&fs, fh, buf, len) != (s32_t)len) ||
+        !bench_check(buf, f->seed, offset, len)) {
+        printf("random read %s failed at %u\n", name, (unsigned)offset);
+        ok = false;
+    }
+    SPIFFS_close(&fs, fh);
+    return(ok);
+}
+
+static void bench_print(const char *name, uint64_t busyNs,
+    const SPIFFS_FS_STATS *st, bool ok)
+{
+    printf("%-14s %9.1f %8u %8u %5u %8u %9u %8u %9u %7u  %s\n", name,
+        busyNs / 1e6, (unsigned)st->cacheHits, (unsigned)st->cacheMisses,
+        (unsigned)st->gcRuns, (unsigned)st->flashReads,
+        (unsigned)(st->flashReadBytes / 1024), (unsigned)st->flashWrites,
+        (unsigned)(st->flashWriteBytes / 1024), (unsigned)st->flashErases,
+        ok ? "ok" : "FAIL");
+}
+
+static void bench_phase(const char *name, bool ok)
+{
+    SPIFFS_FS_STATS st;
+    FLASH_SIM_STATS fst;
+
+    spiffs_stats(&fs, &st, true);
+    flash_sim_stats(flash, &fst, true);
+    bench_print(name, fst.busyNs, &st, ok);
+
+    benchTotalNs += fst.busyNs;
+    benchTotal.cacheHits += st.cacheHits;
+    benchTotal.cacheMisses += st.cacheMisses;
+    benchTotal.gcRuns += st.gcRuns;
+    benchTotal.flashReads += st.flashReads;
+    benchTotal.flashReadBytes += st.flashReadBytes;
+    benchTotal.flashWrites += st.flashWrites;
+    benchTotal.flashWriteBytes += st.flashWriteBytes;
+    benchTotal.flashErases += st.flashErases;
+}
+
+static void usage(void)
+{
+    printf("spiffs_bench [options]\n");
+    printf("  -f <files>   Number of files (40, max %d)\n", BENCH_MAX_FILES);
+    printf("  -s <KB>      Largest file size (16)\n");
+    printf("  -c <bytes>   Read and write size (64, max %d)\n",
+        BENCH_MAX_CHUNK);
+    printf("  -p <passes>  Sequential read passes (4)\n");
+    printf("  -n <reads>   Random reads (2000)\n");
+    printf("  -w <files>   Random rewrites (400)\n");
+    printf("  -r <seed>    Random seed (1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    BENCH_CFG cfg = {
+        .files = 40, .maxKB = 16, .chunk = 64, .passes = 4,
+        .randomReads = 2000, .rewrites = 400, .seed = 1
+    };
+    FLASH_SIM_CONFIG fcfg = {
+        .size = SPIFFS_FS_SIZE,
+        .eraseSize = SPIFFS_FS_ERASE_BLOCK_SIZE,
+        .pageSize = SPIFFS_FS_FLASH_PAGE_SIZE,
+        /* Quad SPI NOR through the simple SPI driver */
+        .readSetupNs = 2000,
+        .readByteNs = 40,
+        .programPageNs = 700000,
+        .eraseBlockNs = 45000000
+    };
+    uint32_t i, addr, minErase, maxErase, count;
+    u32_t total, used;
+    int fails = 0;
+    bool ok;
+    int c;
+
+    while ((c = getopt(argc, argv, "f:s:c:p:n:w:r:h")) != -1) {
+        switch (c) {
+            case 'f': cfg.files = strtoul(optarg, NULL, 0); break;
+            case 's': cfg.maxKB = strtoul(optarg, NULL, 0); break;
+            case 'c': cfg.chunk = strtoul(optarg, NULL, 0); break;
+            case 'p': cfg.passes = strtoul(optarg, NULL, 0); break;
+            case 'n': cfg.randomReads = strtoul(optarg, NULL, 0); break;
+            case 'w': cfg.rewrites = strtoul(optarg, NULL, 0); break;
+            case 'r': cfg.seed = strtoul(optarg, NULL, 0); break;
+            default: usage(); return(1);
+        }
+    }
+    if ((cfg.files == 0) || (cfg.files > BENCH_MAX_FILES) ||
+        (cfg.maxKB == 0) || (cfg.chunk == 0) ||
+        (cfg.chunk > BENCH_MAX_CHUNK)) {
+        usage();
+        return(1);
+    }
+    randState = cfg.seed ? cfg.seed : 1;
+
+    flash = flash_sim_open(&fcfg);
+    if (flash == NULL) {
+        printf("flash_sim_open failed\n");
+        return(1);
+    }
+    spiffs_mount(&fs, flash);
+    if (spiffs_format(&fs) != SPIFFS_OK) {
+        printf("spiffs_format failed\n");
+        return(1);
+    }
+
+#if SPIFFS_CACHE
+    printf("Cache %u pages, %s, ", (unsigned)SPIFFS_FS_CACHE_PAGES,
+        SPIFFS_CACHE_WR ? "write-back" : "write-through");
+#else
+    printf("No cache, ");
+#endif
+    printf("GC weights delete %d used %d erase age %d\n",
+        SPIFFS_GC_HEUR_W_DELET, SPIFFS_GC_HEUR_W_USED,
+        SPIFFS_GC_HEUR_W_ERASE_AGE);
+    printf("%u files up to %uKB, %u byte transfers\n\n",
+        (unsigned)cfg.files, (unsigned)cfg.maxKB, (unsigned)cfg.chunk);
+    printf("%-14s %9s %8s %8s %5s %8s %9s %8s %9s %7s\n", "phase",
+        "flash ms", "hits", "misses", "gc", "reads", "read KB", "writes",
+        "write KB", "erases");
+
+    spiffs_stats(&fs, NULL, true);
+    flash_sim_stats(flash, NULL, true);
+
+    ok = true;
+    for (i = 0; ok && (i < cfg.files); i++) {
+        ok = bench_write_file(&cfg, i);
+    }
+    bench_phase("create", ok);
+    fails += !ok;
+
+    ok = true;
+    for (i = 0; ok && (i < cfg.passes * cfg.files); i++) {
+        ok = bench_read_file(&cfg, bench_rand() % cfg.files);
+    }
+    bench_phase("read", ok);
+    fails += !ok;
+
+    ok = true;
+    for (i = 0; ok && (i < cfg.randomReads); i++) {
+        ok = bench_read_random(&cfg, bench_rand() % cfg.files);
+    }
+    bench_phase("read random", ok);
+    fails += !ok;
+
+    ok = true;
+    for (i = 0; ok && (i < cfg.rewrites); i++) {
+        ok = bench_write_file(&cfg, bench_rand() % cfg.files);
+    }
+    bench_phase("rewrite", ok);
+    fails += !ok;
+
+    ok = true;
+    for (i = 0; ok && (i < cfg.files); i++) {
+        ok = bench_read_file(&cfg, i);
+    }
+    bench_phase("verify", ok);
+    fails += !ok;
+
+    bench_print("total", benchTotalNs, &benchTotal, fails == 0);
+
+    minErase = UINT32_MAX;
+    maxErase = 0;
+    for (addr = 0; addr < SPIFFS_FS_SIZE; addr += SPIFFS_FS_ERASE_BLOCK_SIZE) {
+        count = flash_sim_erase_count(flash, SPIFFS_FS_OFFSET + addr);
+        if (count < minErase) {
+            minErase = count;
+        }
+        if (count > maxErase) {
+            maxErase = count;
+        }
+    }
+    SPIFFS_info(&fs, &total, &used);
+    printf("\nUsed %uKB of %uKB, block erases min %u max %u\n",
+        (unsigned)(used / 1024), (unsigned)(total / 1024),
+        (unsigned)minErase, (unsigned)maxErase);
+
+    spiffs_unmount(&fs, NULL);
+    flash_sim_close(flash);
+
+    return(fails ? 2 : 0);
+}
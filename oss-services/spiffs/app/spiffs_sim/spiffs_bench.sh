@@ -0,0 +1,84 @@
+#!/bin/bash
+#
+# Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+# This software is proprietary and confidential to Analog Devices, Inc.
+# and its licensors.
+#
+# This software is subject to the terms and conditions of the license set
+# forth in the project LICENSE file. Downloading, reproducing, distributing or
+# otherwise using the software constitutes acceptance of the license. The
+# software may not be used except as expressly authorized under the license.
+#
+# Builds spiffs_bench for a series of SPIFFS cache settings and prints
+# the totals of each run, one line per setting.  Run from the 'spiffs'
+# directory with:
+#   app/spiffs_sim/spiffs_bench.sh [-g "<cflags>"] [-b "<bench args>"] [-v]
+#
+#   -g   Extra compiler flags for every build, e.g.
+#        "-DSPIFFS_GC_HEUR_W_ERASE_AGE=10"
+#   -b   Extra spiffs_bench arguments, e.g. "-c 16 -w 800"
+#   -v   Print the phases of every run
+#
+
+set -u
+
+FLASH=../../simple-drivers/flash/src
+
+CFLAGS=
+ARGS=
+VERBOSE=no
+while getopts "g:b:vh" opt; do
+    case $opt in
+        g) CFLAGS=$OPTARG ;;
+        b) ARGS=$OPTARG ;;
+        v) VERBOSE=yes ;;
+        *) echo "usage: app/spiffs_sim/spiffs_bench.sh [-g cflags] [-b args] [-v]"
+           exit 1 ;;
+    esac
+done
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+FAILS=0
+
+# run <title> <cflags>
+run() {
+    local title=$1 flags=$2 rc
+
+    gcc -O2 -DFLASH_SIM_HOST $flags $CFLAGS -Iapp/spiffs_sim -Iinc -Isrc \
+        -Iapp -I$FLASH -I$FLASH/flash_sim -o $WORK/spiffs_bench \
+        app/spiffs_sim/spiffs_bench.c app/spiffs_fs.c src/spiffs_*.c \
+        $FLASH/flash.c $FLASH/flash_sim/flash_sim.c -lpthread || exit 1
+    $WORK/spiffs_bench $ARGS > $WORK/bench.log
+    rc=$?
+    if [ $VERBOSE = yes ]; then
+        echo "== $title"
+        cat $WORK/bench.log
+        echo
+    else
+        printf "%-22s %s\n" "$title" \
+            "$(grep '^total' $WORK/bench.log | cut -c 15-)"
+    fi
+    if [ $rc -ne 0 ]; then
+        FAILS=$((FAILS + 1))
+    fi
+}
+
+if [ $VERBOSE = no ]; then
+    printf "%-22s %9s %8s %8s %5s %8s %9s %8s %9s %7s\n" "setting" \
+        "flash ms" "hits" "misses" "gc" "reads" "read KB" "writes" \
+        "write KB" "erases"
+fi
+
+run "no cache" "-DSPIFFS_CACHE=0"
+run "8 pages write-through" "-DSPIFFS_FS_CACHE_PAGES=8 -DSPIFFS_CACHE_WR=0"
+for pages in 1 2 4 8 16 32; do
+    run "$pages pages write-back" "-DSPIFFS_FS_CACHE_PAGES=$pages"
+done
+
+if [ $FAILS -ne 0 ]; then
+    echo
+    echo "$FAILS runs failed"
+    exit 2
+fi
+exit 0
@@ -0,0 +1,35 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host (spiffs_bench) configuration.  Takes the place of
+ * 'inc/spiffs_fs_cfg.h' with the C library heap and a 1MB filesystem at
+ * the start of the simulated flash.  SPIFFS_FS_CACHE_PAGES can be set
+ * on the command line.
+ */
+
+#ifndef _spiffs_fs_cfg_h
+#define _spiffs_fs_cfg_h
+
+#include <stdlib.h>
+
+#define SPIFFS_FS_CALLOC            calloc
+#define SPIFFS_FS_FREE              free
+#define SPIFFS_FS_SIZE              (1024 * 1024)
+#define SPIFFS_FS_OFFSET            (0)
+#define SPIFFS_FS_ERASE_BLOCK_SIZE  (4 * 1024)
+#define SPIFFS_FS_FLASH_PAGE_SIZE   (256)
+
+#ifndef SPIFFS_FS_CACHE_PAGES
+#define SPIFFS_FS_CACHE_PAGES       8
+#endif
+
+#endif
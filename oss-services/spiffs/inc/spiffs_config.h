@@ -44,7 +44,24 @@ extern void spiffs_unlock(struct spiffs_t *fs);
 #define SPIFFS_USE_MAGIC                (1)
 #define SPIFFS_USE_MAGIC_LENGTH         (1)
 #define SPIFFS_HAL_CALLBACK_EXTRA       (1)
-#define SPIFFS_CACHE                    (0)
+
+// Cache flash pages in RAM.  The number of cached pages is set by
+// SPIFFS_FS_CACHE_PAGES in spiffs_fs_cfg.h.
+#ifndef SPIFFS_CACHE
+#define SPIFFS_CACHE                    (1)
+#endif
+#if SPIFFS_CACHE
+// 1 = write-back: file writes are collected in a cache page and
+//     programmed when the page fills or the file is flushed/closed
+// 0 = write-through: every write is programmed immediately
+#ifndef SPIFFS_CACHE_WR
+#define SPIFFS_CACHE_WR                 (1)
+#endif
+// Count cache hits and misses (see spiffs_stats())
+#ifndef SPIFFS_CACHE_STATS
+#define SPIFFS_CACHE_STATS              (1)
+#endif
+#endif
 
 #define SPIFFS_LOCK(fs)       spiffs_lock(fs)
 #define SPIFFS_UNLOCK(fs)     spiffs_unlock(fs)
@@ -21,6 +21,7 @@
 #define SPIFFS_FS_OFFSET            SPIFFS_OFFSET
 #define SPIFFS_FS_ERASE_BLOCK_SIZE  ERASE_BLOCK_SIZE
 #define SPIFFS_FS_FLASH_PAGE_SIZE   FLASH_PAGE_SIZE
+#define SPIFFS_FS_CACHE_PAGES       8
 
 
 #endif
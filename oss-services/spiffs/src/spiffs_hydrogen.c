@@ -4,6 +4,9 @@
  *  Created on: Jun 16, 2013
  *      Author: petera
  */
+/*
+ * This file has been modified by Analog Devices, Inc.
+ */
 
 #include "spiffs.h"
 #include "spiffs_nucleus.h"
@@ -434,9 +437,14 @@ static s32_t spiffs_hydro_write(spiffs *fs, spiffs_fd *fd, void *buf, u32_t offs
   (void)fs;
   s32_t res = SPIFFS_OK;
   s32_t remaining = len;
+  // ADI: an append crossing an object index page reports the partial
+  // size to all fds, which clamps fdoffset.  A write cache flush writes
+  // behind fdoffset, so keep the file position across the write.
+  u32_t fdoffset = fd->fdoffset;
   if (fd->size != SPIFFS_UNDEFINED_LEN && offset < fd->size) {
     s32_t m_len = MIN((s32_t)(fd->size - offset), len);
     res = spiffs_object_modify(fd, offset, (u8_t *)buf, m_len);
+    fd->fdoffset = fdoffset;
     SPIFFS_CHECK_RES(res);
     remaining -= m_len;
     u8_t *buf_8 = (u8_t *)buf;
@@ -446,6 +454,7 @@ static s32_t spiffs_hydro_write(spiffs *fs, spiffs_fd *fd, void *buf, u32_t offs
   }
   if (remaining > 0) {
     res = spiffs_object_append(fd, offset, (u8_t *)buf, remaining);
+    fd->fdoffset = fdoffset;
     SPIFFS_CHECK_RES(res);
   }
   return len;
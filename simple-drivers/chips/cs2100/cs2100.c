@@ -83,6 +83,10 @@ CS2100_RESULT cs2100_set_ratio(sTWI *twiHandle, uint8_t address,
     twiResult = twi_writeRead(twiHandle, address,
         &regAddr, sizeof(regAddr), &regVal, sizeof(regVal));
 
+    if (twiResult != TWI_SIMPLE_SUCCESS) {
+        return(CS2100_ERROR);
+    }
+
     if (regVal & BITM_FUNCT_CFG_2_LFRATIOCFG) {
         /* High accuracy 12.20 */
         if (ratio >= 4096.0) {
@@ -103,8 +107,9 @@ CS2100_RESULT cs2100_set_ratio(sTWI *twiHandle, uint8_t address,
     twiResult = twi_writeWrite(twiHandle, address,
         &regAddr, sizeof(regAddr), RudBuf, sizeof(RudBuf));
 
-    twiResult = twi_writeRead(twiHandle, address,
-        &regAddr, sizeof(regAddr), RudBuf, sizeof(RudBuf));
+    if (twiResult != TWI_SIMPLE_SUCCESS) {
+        return(CS2100_ERROR);
+    }
 
     return(CS2100_SUCCESS);
 }
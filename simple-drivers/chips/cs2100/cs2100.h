@@ -69,6 +69,13 @@ typedef struct CS2100_CFG {
 extern "C" {
 #endif
 
+/*!****************************************************************
+ * @brief Set the CS2100 ratio
+ *
+ * The ratio can be changed while running, for example to steer the
+ * output clock from clock-discipline.  The resolution is 1/2^20 in
+ * high accuracy mode and 1/2^12 in high multiplier mode.
+ ******************************************************************/
 CS2100_RESULT cs2100_set_ratio(sTWI *twiHandle, uint8_t address,
     double ratio);
 
@@ -12,23 +12,717 @@
 #include <string.h>
 #include "flash.h"
 
+#ifdef FREE_RTOS
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+#endif
+
+#if defined(__ADSPARM__)
+#include <adi/cortex-a5/runtime/cache/adi_cache.h>
+#elif defined(__ADSP21000__)
+#include <sys/cache.h>
+#endif
+
+/* Sleep between status reads of an asynchronous operation */
+#ifndef FLASH_ASYNC_POLL_MS
+#define FLASH_ASYNC_POLL_MS  (1)
+#endif
+
+/* Erase time between suspends, so frequent reads cannot stall an erase */
+#ifndef FLASH_ASYNC_RESUME_MS
+#define FLASH_ASYNC_RESUME_MS  (2)
+#endif
+
+/* Asynchronous operations */
+enum {
+    FLASH_ASYNC_IDLE = 0,
+    FLASH_ASYNC_ERASE,
+    FLASH_ASYNC_PROGRAM
+};
+
+static void flash_async_lock(FLASH_ASYNC *async)
+{
+#ifdef FREE_RTOS
+    xSemaphoreTake((SemaphoreHandle_t)async->lock, portMAX_DELAY);
+#endif
+}
+
+static void flash_async_unlock(FLASH_ASYNC *async)
+{
+#ifdef FREE_RTOS
+    xSemaphoreGive((SemaphoreHandle_t)async->lock);
+#endif
+}
+
+/* Serializes memory-mapped window reads against program and erase */
+static void flash_xip_lock(const FLASH_INFO *fi)
+{
+    if (fi->async) {
+        flash_async_lock(fi->async);
+        return;
+    }
+#ifdef FREE_RTOS
+    if (fi->xipLock) {
+        xSemaphoreTake((SemaphoreHandle_t)fi->xipLock, portMAX_DELAY);
+    }
+#endif
+}
+
+static void flash_xip_unlock(const FLASH_INFO *fi)
+{
+    if (fi->async) {
+        flash_async_unlock(fi->async);
+        return;
+    }
+#ifdef FREE_RTOS
+    if (fi->xipLock) {
+        xSemaphoreGive((SemaphoreHandle_t)fi->xipLock);
+    }
+#endif
+}
+
+/* The window cannot be read while the device programs or erases */
+static void flash_xip_suspend(const FLASH_INFO *fi, bool suspend)
+{
+    /* The handle is only const to the application */
+    FLASH_INFO *info = (FLASH_INFO *)fi;
+
+    if (suspend) {
+        info->xipSuspend++;
+    } else {
+        info->xipSuspend--;
+    }
+}
+
+/* Keep the port in memory-mapped mode while the window is read */
+static bool flash_xip_hold(const FLASH_INFO *fi, bool hold)
+{
+    if (fi->flash_xip_hold == NULL) {
+        return(true);
+    }
+    return(fi->flash_xip_hold(fi, hold) == FLASH_OK);
+}
+
+/* Returns true if the read was served from the window */
+static bool flash_xip_read(const FLASH_INFO *fi, uint32_t addr, uint8_t *buf, int size)
+{
+    if ((fi->xip == NULL) || (fi->xipSuspend > 0) || (size < 0) ||
+        (addr >= fi->xipSize) || ((uint32_t)size > fi->xipSize - addr)) {
+        return(false);
+    }
+
+    if (!flash_xip_hold(fi, true)) {
+        return(false);
+    }
+    memcpy(buf, fi->xip + addr, size);
+    flash_xip_hold(fi, false);
+
+    return(true);
+}
+
+/* Drop cached window contents of a programmed or erased range */
+static void flash_xip_invalidate(const FLASH_INFO *fi, uint32_t addr, uint32_t size)
+{
+#if defined(__ADSPARM__) || defined(__ADSP21000__)
+    uint8_t *start;
+
+    if ((fi->xip == NULL) || (size == 0) || (addr >= fi->xipSize)) {
+        return;
+    }
+    if (size > fi->xipSize - addr) {
+        size = fi->xipSize - addr;
+    }
+    start = (uint8_t *)fi->xip + addr;
+    flush_data_buffer(start, start + size - 1, ADI_FLUSH_DATA_INV);
+#endif
+}
+
+static void flash_async_sleep(void)
+{
+#ifdef FREE_RTOS
+    vTaskDelay(pdMS_TO_TICKS(FLASH_ASYNC_POLL_MS));
+#endif
+}
+
+static uint32_t flash_async_tick(void)
+{
+#ifdef FREE_RTOS
+    return(xTaskGetTickCount());
+#else
+    return(0);
+#endif
+}
+
+/* Returns true once the device has run FLASH_ASYNC_RESUME_MS since the
+ * erase unit was started or resumed */
+static bool flash_async_ran(FLASH_ASYNC *async)
+{
+#ifdef FREE_RTOS
+    return((uint32_t)(xTaskGetTickCount() - async->runTick) >=
+        pdMS_TO_TICKS(FLASH_ASYNC_RESUME_MS));
+#else
+    return(true);
+#endif
+}
+
+/* Returns true if a read can be served by suspending the erase in
+ * progress.  The unit being erased is undefined until it completes. */
+static bool flash_async_suspendable(const FLASH_INFO *fi, FLASH_ASYNC *async,
+    uint32_t addr, int size)
+{
+    uint32_t start = async->addr - async->unit;
+
+    if ((async->op != FLASH_ASYNC_ERASE) ||
+        (fi->flash_erase_suspend == NULL) || (fi->flash_erase_resume == NULL)) {
+        return(false);
+    }
+    return((size <= 0) || ((uint64_t)addr + size <= start) ||
+        (addr >= async->addr));
+}
+
+static uint32_t flash_erase_plan(const FLASH_INFO *fi, uint32_t addr, uint32_t left)
+{
+    uint32_t unit;
+    int i;
+
+    /* Largest unit aligned at 'addr' which does not pass the end */
+    for (i = FLASH_MAX_ERASE_SIZES - 1; i > 0; i--) {
+        unit = fi->eraseSizes[i];
+        if (unit && ((addr % unit) == 0) && (unit <= left)) {
+            return(unit);
+        }
+    }
+    return(fi->eraseSizes[0]);
+}
+
+/* Extend [addr, addr + size) to the smallest erase unit */
+static uint32_t flash_erase_align(const FLASH_INFO *fi, uint32_t *addr, int size)
+{
+    uint32_t minSize = fi->eraseSizes[0];
+    uint64_t end;
+
+    end = (uint64_t)*addr + size;
+    *addr -= *addr % minSize;
+    if (end % minSize) {
+        end += minSize - (end % minSize);
+    }
+    return(end - *addr);
+}
+
+/*
+ * Advance the asynchronous operation by at most one device operation.
+ * Called with the lock held.  Sets 'advanced' when an erase unit or
+ * page completes.
+ */
+static int flash_async_step(const FLASH_INFO *fi, FLASH_ASYNC *async, bool *advanced)
+{
+    uint32_t unit;
+    int result;
+
+    if (async->op == FLASH_ASYNC_IDLE) {
+        return(async->result);
+    }
+
+    if (async->started) {
+        result = fi->flash_busy(fi);
+        if (result == FLASH_BUSY) {
+            return(FLASH_BUSY);
+        }
+        async->started = false;
+        if (result != FLASH_OK) {
+            goto done;
+        }
+        flash_xip_invalidate(fi, async->addr - async->unit, async->unit);
+        async->done += async->unit;
+        *advanced = true;
+    }
+
+    if (async->left == 0) {
+        result = FLASH_OK;
+        goto done;
+    }
+
+    if (async->op == FLASH_ASYNC_ERASE) {
+        unit = flash_erase_plan(fi, async->addr, async->left);
+        result = fi->flash_erase_start(fi, async->addr, unit);
+    } else {
+        /* Program at most up to the next page boundary */
+        unit = fi->pageSize - (async->addr % fi->pageSize);
+        if (async->left < unit) {
+            unit = async->left;
+        }
+        result = fi->flash_program_start(fi, async->addr, async->buf, unit);
+        async->buf += unit;
+    }
+    if (result != FLASH_OK) {
+        goto done;
+    }
+
+    async->runTick = flash_async_tick();
+    async->addr += unit;
+    async->left -= unit;
+    async->unit = unit;
+    async->started = true;
+
+    return(FLASH_BUSY);
+
+done:
+    async->op = FLASH_ASYNC_IDLE;
+    async->owner = NULL;
+    async->result = result;
+    flash_xip_suspend(fi, false);
+    return(result);
+}
+
+/*
+ * Start an asynchronous operation.  An operation with an 'owner' is
+ * only advanced by flash_async_service() calls from the same owner.
+ */
+static int flash_async_start(const FLASH_INFO *fi, int op, uint32_t addr,
+    const uint8_t *buf, int size, FLASH_ERASE_PROGRESS progress,
+    FLASH_ASYNC_CALLBACK callback, void *usr, const void *owner)
+{
+    FLASH_ASYNC *async = fi->async;
+    bool advanced = false;
+    uint32_t total;
+    int result;
+
+    if ((async == NULL) || (size < 0)) {
+        return(FLASH_ERROR);
+    }
+
+    if (op == FLASH_ASYNC_ERASE) {
+        total = size ? flash_erase_align(fi, &addr, size) : 0;
+    } else {
+        total = size;
+    }
+
+    flash_async_lock(async);
+
+    /* Only one completion callback can wait for the next poll */
+    if ((async->op != FLASH_ASYNC_IDLE) ||
+        (callback && async->pendCallback)) {
+        flash_async_unlock(async);
+        return(FLASH_BUSY);
+    }
+
+    async->op = op;
+    async->addr = addr;
+    async->left = total;
+    async->buf = buf;
+    async->unit = 0;
+    async->done = 0;
+    async->total = total;
+    async->result = FLASH_OK;
+    async->started = false;
+    async->progress = progress;
+    async->callback = callback;
+    async->usr = usr;
+    async->owner = owner;
+    flash_xip_suspend(fi, true);
+
+    /* Start the first page or erase unit now */
+    result = flash_async_step(fi, async, &advanced);
+
+    flash_async_unlock(async);
+
+    if (result == FLASH_OK) {
+        /* Nothing to do */
+        if (callback) {
+            callback(fi, result, usr);
+        }
+    }
+
+    return((result == FLASH_ERROR) ? FLASH_ERROR : FLASH_OK);
+}
+
+/*
+ * Advance the asynchronous operation on behalf of 'owner'.  An owned
+ * operation is only advanced by its owner, so its progress calls and
+ * result stay with it.  The completion callback of an unowned operation
+ * is made if 'owner' is NULL, otherwise it is left for the next
+ * flash_async_poll().
+ */
+static int flash_async_service(const FLASH_INFO *fi, const void *owner)
+{
+    FLASH_ASYNC *async = fi->async;
+    FLASH_ERASE_PROGRESS progress;
+    FLASH_ASYNC_CALLBACK callback;
+    FLASH_ASYNC_CALLBACK pending = NULL;
+    bool advanced = false;
+    uint32_t done, total;
+    void *usr, *pendUsr = NULL;
+    int pendResult = FLASH_OK;
+    bool owned;
+    int op;
+    int result;
+
+    flash_async_lock(async);
+
+    op = async->op;
+    owned = (async->owner != NULL);
+    if ((op != FLASH_ASYNC_IDLE) && owned && (async->owner != owner)) {
+        flash_async_unlock(async);
+        return(FLASH_BUSY);
+    }
+
+    result = flash_async_step(fi, async, &advanced);
+    progress = async->progress;
+    callback = async->callback;
+    usr = async->usr;
+    done = async->done;
+    total = async->total;
+
+    if ((op == FLASH_ASYNC_IDLE) || (result == FLASH_BUSY)) {
+        callback = NULL;
+    }
+    if (callback && owner && !owned) {
+        async->pendCallback = callback;
+        async->pendUsr = usr;
+        async->pendResult = result;
+        callback = NULL;
+    }
+    if ((owner == NULL) && async->pendCallback) {
+        pending = async->pendCallback;
+        pendUsr = async->pendUsr;
+        pendResult = async->pendResult;
+        async->pendCallback = NULL;
+    }
+
+    flash_async_unlock(async);
+
+    /* Callbacks are made without the lock so they may use the flash */
+    if (advanced && progress) {
+        progress(fi, done, total, usr);
+    }
+    if (pending) {
+        pending(fi, pendResult, pendUsr);
+    }
+    if (callback) {
+        callback(fi, result, usr);
+    }
+
+    return(result);
+}
+
+/*
+ * Returns with the lock held and no asynchronous operation active.  The
+ * caller may hold locks of its own, so completion callbacks are left
+ * for the next flash_async_poll().
+ */
+static void flash_async_lock_idle(const FLASH_INFO *fi)
+{
+    FLASH_ASYNC *async = fi->async;
+
+    while (1) {
+        if (flash_async_service(fi, async) != FLASH_BUSY) {
+            flash_async_lock(async);
+            if (async->op == FLASH_ASYNC_IDLE) {
+                break;
+            }
+            flash_async_unlock(async);
+        }
+        flash_async_sleep();
+    }
+}
+
 int flash_read(const FLASH_INFO *fi, uint32_t addr, uint8_t *buf, int size)
 {
+    FLASH_ASYNC *async = fi->async;
     int result;
-    result = fi->flash_read(fi, addr, buf, size);
+
+    if (async == NULL) {
+        flash_xip_lock(fi);
+        if (flash_xip_read(fi, addr, buf, size)) {
+            result = FLASH_OK;
+        } else {
+            result = fi->flash_read(fi, addr, buf, size);
+        }
+        flash_xip_unlock(fi);
+        return result;
+    }
+
+    flash_async_lock(async);
+
+    if ((async->op != FLASH_ASYNC_IDLE) && async->started) {
+        result = FLASH_BUSY;
+        if (flash_async_suspendable(fi, async, addr, size)) {
+            /* Let the erase progress between suspends */
+            while (!flash_async_ran(async) &&
+                ((result = fi->flash_busy(fi)) == FLASH_BUSY)) {
+                flash_async_sleep();
+            }
+            if (result == FLASH_BUSY) {
+                /* Serve the read from the suspended erase */
+                result = fi->flash_erase_suspend(fi);
+                if (result == FLASH_OK) {
+                    result = fi->flash_read(fi, addr, buf, size);
+                    if (fi->flash_erase_resume(fi) != FLASH_OK) {
+                        result = FLASH_ERROR;
+                    }
+                    async->runTick = flash_async_tick();
+                }
+                flash_async_unlock(async);
+                return result;
+            }
+        }
+        /* Let the page or erase unit in progress finish */
+        while ((result == FLASH_BUSY) &&
+            ((result = fi->flash_busy(fi)) == FLASH_BUSY)) {
+            flash_async_sleep();
+        }
+        if (result != FLASH_OK) {
+            flash_async_unlock(async);
+            return result;
+        }
+    }
+
+    if (flash_xip_read(fi, addr, buf, size)) {
+        result = FLASH_OK;
+    } else {
+        result = fi->flash_read(fi, addr, buf, size);
+    }
+
+    flash_async_unlock(async);
+
     return result;
 }
 
 int flash_erase(const FLASH_INFO *fi, uint32_t addr, int size)
 {
     int result;
-    result = fi->flash_erase(fi, addr, size);
+    result = flash_erase_progress(fi, addr, size, NULL, NULL);
     return result;
 }
 
+static int flash_erase_sync(const FLASH_INFO *fi, uint32_t addr, int size,
+    FLASH_ERASE_PROGRESS progress, void *usr)
+{
+    uint32_t total, done, unit;
+    int result;
+
+    if ((fi->flash_erase_unit == NULL) || (fi->eraseSizes[0] == 0)) {
+        result = fi->flash_erase(fi, addr, size);
+        flash_xip_invalidate(fi, addr, size);
+        if ((result == FLASH_OK) && progress) {
+            progress(fi, size, size, usr);
+        }
+        return(result);
+    }
+
+    total = flash_erase_align(fi, &addr, size);
+
+    result = FLASH_OK;
+    done = 0;
+
+    while (done < total) {
+        unit = flash_erase_plan(fi, addr, total - done);
+        result = fi->flash_erase_unit(fi, addr, unit);
+        flash_xip_invalidate(fi, addr, unit);
+        if (result != FLASH_OK) {
+            break;
+        }
+        addr += unit;
+        done += unit;
+        if (progress) {
+            progress(fi, done, total, usr);
+        }
+    }
+
+    return(result);
+}
+
+int flash_erase_progress(const FLASH_INFO *fi, uint32_t addr, int size,
+    FLASH_ERASE_PROGRESS progress, void *usr)
+{
+    uint8_t owner;
+    int result;
+
+    if (size <= 0) {
+        return(FLASH_OK);
+    }
+
+    /*
+     * Sleep between status reads if asynchronous operation is enabled.
+     * The erase is owned by this call so no other context advances it,
+     * makes the progress calls or takes its result.
+     */
+    if (fi->async) {
+        while ((result = flash_async_start(fi, FLASH_ASYNC_ERASE, addr,
+                NULL, size, progress, NULL, usr, &owner)) == FLASH_BUSY) {
+            flash_async_service(fi, &owner);
+            flash_async_sleep();
+        }
+        if (result == FLASH_OK) {
+            while ((result = flash_async_service(fi, &owner)) == FLASH_BUSY) {
+                flash_async_sleep();
+            }
+        }
+        return(result);
+    }
+
+    flash_xip_lock(fi);
+    flash_xip_suspend(fi, true);
+    result = flash_erase_sync(fi, addr, size, progress, usr);
+    flash_xip_suspend(fi, false);
+    flash_xip_unlock(fi);
+
+    return(result);
+}
+
 int flash_program(const FLASH_INFO *fi, uint32_t addr, const uint8_t *buf, int size)
 {
     int result;
+
+    if (fi->async == NULL) {
+        flash_xip_lock(fi);
+        flash_xip_suspend(fi, true);
+        result = fi->flash_program(fi, addr, buf, size);
+        flash_xip_invalidate(fi, addr, (size > 0) ? size : 0);
+        flash_xip_suspend(fi, false);
+        flash_xip_unlock(fi);
+        return result;
+    }
+
+    flash_async_lock_idle(fi);
+    flash_xip_suspend(fi, true);
     result = fi->flash_program(fi, addr, buf, size);
+    flash_xip_invalidate(fi, addr, (size > 0) ? size : 0);
+    flash_xip_suspend(fi, false);
+    flash_async_unlock(fi->async);
+
     return result;
 }
+
+int flash_async_init(FLASH_INFO *fi, FLASH_ASYNC *async)
+{
+    if ((fi->flash_erase_start == NULL) || (fi->flash_program_start == NULL) ||
+        (fi->flash_busy == NULL) || (fi->eraseSizes[0] == 0) ||
+        (fi->pageSize == 0)) {
+        return(FLASH_ERROR);
+    }
+
+    memset(async, 0, sizeof(*async));
+    async->op = FLASH_ASYNC_IDLE;
+    async->result = FLASH_OK;
+
+#ifdef FREE_RTOS
+    async->lock = xSemaphoreCreateMutex();
+    if (async->lock == NULL) {
+        return(FLASH_ERROR);
+    }
+#endif
+
+    fi->async = async;
+
+    return(FLASH_OK);
+}
+
+int flash_erase_async(const FLASH_INFO *fi, uint32_t addr, int size,
+    FLASH_ASYNC_CALLBACK callback, void *usr)
+{
+    int result;
+    result = flash_async_start(fi, FLASH_ASYNC_ERASE, addr, NULL, size,
+        NULL, callback, usr, NULL);
+    return result;
+}
+
+int flash_program_async(const FLASH_INFO *fi, uint32_t addr,
+    const uint8_t *buf, int size, FLASH_ASYNC_CALLBACK callback, void *usr)
+{
+    int result;
+    result = flash_async_start(fi, FLASH_ASYNC_PROGRAM, addr, buf, size,
+        NULL, callback, usr, NULL);
+    return result;
+}
+
+int flash_async_poll(const FLASH_INFO *fi)
+{
+    if (fi->async == NULL) {
+        return(FLASH_ERROR);
+    }
+
+    return(flash_async_service(fi, NULL));
+}
+
+int flash_async_wait(const FLASH_INFO *fi)
+{
+    int result;
+
+    while ((result = flash_async_poll(fi)) == FLASH_BUSY) {
+        flash_async_sleep();
+    }
+
+    return(result);
+}
+
+int flash_xip_enable(FLASH_INFO *fi)
+{
+    const uint8_t *window;
+    uint32_t size;
+    int result;
+
+    if (fi->flash_xip_enable == NULL) {
+        return(FLASH_ERROR);
+    }
+
+    if (fi->xip) {
+        return(FLASH_OK);
+    }
+
+#ifdef FREE_RTOS
+    if (fi->xipLock == NULL) {
+        fi->xipLock = xSemaphoreCreateMutex();
+        if (fi->xipLock == NULL) {
+            return(FLASH_ERROR);
+        }
+    }
+#endif
+
+    flash_xip_lock(fi);
+    result = fi->flash_xip_enable(fi, &window, &size);
+    if (result == FLASH_OK) {
+        fi->xipSize = size;
+        fi->xip = window;
+    }
+    flash_xip_unlock(fi);
+
+    return(result);
+}
+
+int flash_xip_disable(FLASH_INFO *fi)
+{
+    int result;
+
+    if (fi->xip == NULL) {
+        return(FLASH_OK);
+    }
+
+    flash_xip_lock(fi);
+    fi->xip = NULL;
+    result = fi->flash_xip_disable(fi);
+    flash_xip_unlock(fi);
+
+    return(result);
+}
+
+const uint8_t *flash_xip_ptr(const FLASH_INFO *fi, uint32_t addr)
+{
+    const uint8_t *ptr = NULL;
+
+    /* Program and erase commands queue behind the hold once it is taken */
+    flash_xip_lock(fi);
+    if (fi->xip && (fi->xipSuspend == 0) && (addr < fi->xipSize) &&
+        flash_xip_hold(fi, true)) {
+        ptr = fi->xip + addr;
+    }
+    flash_xip_unlock(fi);
+
+    return(ptr);
+}
+
+void flash_xip_release(const FLASH_INFO *fi)
+{
+    flash_xip_hold(fi, false);
+}
@@ -23,17 +23,76 @@
 #define FLASH_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
+/* Host builds (flash_sim) have no SPI driver */
+#ifdef FLASH_SIM_HOST
+typedef struct sSPIPeriph sSPIPeriph;
+#else
 #include "spi_simple.h"
+#endif
 
 /*!****************************************************************
  * @brief   Flash result codes
  ******************************************************************/
 #define FLASH_OK        (0)   /**< Flash operation successful */
 #define FLASH_ERROR     (-1)  /**< Flash operation failed */
+#define FLASH_BUSY      (1)   /**< Flash operation in progress */
+
+/*!****************************************************************
+ * @brief   Maximum number of erase unit sizes a device can declare
+ ******************************************************************/
+#define FLASH_MAX_ERASE_SIZES   (4)
 
 typedef struct _FLASH_INFO FLASH_INFO;
 
+/*!****************************************************************
+ * @brief  Flash erase progress callback.
+ *
+ * Called after each erase operation with the number of bytes erased
+ * so far and the total number of bytes to erase.
+ ******************************************************************/
+typedef void (*FLASH_ERASE_PROGRESS)(const FLASH_INFO *fi,
+    uint32_t done, uint32_t total, void *usr);
+
+/*!****************************************************************
+ * @brief  Asynchronous flash operation completion callback.
+ *
+ * Called from the context polling the operation with FLASH_OK or
+ * FLASH_ERROR.  If the operation completes while flash_program() or
+ * flash_erase() waits for it, the call is made by the next
+ * flash_async_poll() or flash_async_wait() instead.
+ ******************************************************************/
+typedef void (*FLASH_ASYNC_CALLBACK)(const FLASH_INFO *fi, int result,
+    void *usr);
+
+/*!****************************************************************
+ * @brief  Asynchronous flash operation state.
+ *
+ * Allocated by the application and attached to a flash handle with
+ * flash_async_init().  The contents are private to flash.c.
+ ******************************************************************/
+typedef struct _FLASH_ASYNC {
+    int op;
+    uint32_t addr;
+    uint32_t left;
+    const uint8_t *buf;
+    uint32_t unit;
+    uint32_t done;
+    uint32_t total;
+    int result;
+    bool started;
+    FLASH_ERASE_PROGRESS progress;
+    FLASH_ASYNC_CALLBACK callback;
+    void *usr;
+    const void *owner;
+    FLASH_ASYNC_CALLBACK pendCallback;
+    void *pendUsr;
+    int pendResult;
+    uint32_t runTick;
+    void *lock;
+} FLASH_ASYNC;
+
 /*!****************************************************************
  * @brief  Simple flash read.
  *
@@ -58,6 +117,10 @@ int flash_read(const FLASH_INFO *fi, uint32_t addr, uint8_t *buf, int size);
  * operations are extended, on both sides, to align with the device's
  * erase block boundaries.
  *
+ * If the device declares more than one erase unit size the range is
+ * erased using the largest aligned units that fit, including a chip
+ * erase when the range covers the whole device.
+ *
  * This function is thread safe.
  *
  * @param [in]   fi      A handle to the flash device to erase
@@ -69,6 +132,27 @@ int flash_read(const FLASH_INFO *fi, uint32_t addr, uint8_t *buf, int size);
  ******************************************************************/
 int flash_erase(const FLASH_INFO *fi, uint32_t addr, int size);
 
+/*!****************************************************************
+ * @brief  Flash erase with progress.
+ *
+ * This function is the same as flash_erase() but calls 'progress'
+ * after every erase operation.  Devices which do not declare their
+ * erase unit sizes report progress once, when the erase completes.
+ *
+ * This function is thread safe.
+ *
+ * @param [in]   fi        A handle to the flash device to erase
+ * @param [in]   addr      The address of the flash device to erase
+ * @param [in]   size      The number of bytes to erase
+ * @param [in]   progress  The progress callback (optional)
+ * @param [in]   usr       A user pointer passed to the callback
+ *
+ * @return Returns FLASH_OK if successful, otherwise
+ *         an error.
+ ******************************************************************/
+int flash_erase_progress(const FLASH_INFO *fi, uint32_t addr, int size,
+    FLASH_ERASE_PROGRESS progress, void *usr);
+
 /*!****************************************************************
  * @brief  Simple flash program.
  *
@@ -88,6 +172,156 @@ int flash_erase(const FLASH_INFO *fi, uint32_t addr, int size);
  ******************************************************************/
 int flash_program(const FLASH_INFO *fi, uint32_t addr, const uint8_t *buf, int size);
 
+/*!****************************************************************
+ * @brief  Enable asynchronous operations on a flash device.
+ *
+ * Attaches 'async' to the flash handle.  Once attached, flash_erase()
+ * is run through the asynchronous engine so it sleeps between status
+ * reads, and flash_read() during an asynchronous erase suspends the
+ * erase, if the device supports it, rather than waiting for it.
+ *
+ * The device driver must provide the non-blocking flash_erase_start,
+ * flash_program_start and flash_busy functions.
+ *
+ * @param [in]   fi      A handle to the flash device
+ * @param [in]   async   Operation state, valid until the device is closed
+ *
+ * @return Returns FLASH_OK if successful, otherwise
+ *         an error.
+ ******************************************************************/
+int flash_async_init(FLASH_INFO *fi, FLASH_ASYNC *async);
+
+/*!****************************************************************
+ * @brief  Asynchronous flash erase.
+ *
+ * Starts erasing a section of a flash device, as flash_erase(), and
+ * returns.  The erase advances each time flash_async_poll() or
+ * flash_async_wait() is called and 'callback' is called when it
+ * completes.  Only one asynchronous operation can be active per
+ * device.
+ *
+ * A flash_read() during the erase suspends it, unless the read
+ * overlaps the erase unit in progress, which it waits for.  The erase
+ * runs for at least FLASH_ASYNC_RESUME_MS between suspends with
+ * FREE_RTOS.
+ *
+ * @param [in]   fi        A handle to the flash device to erase
+ * @param [in]   addr      The address of the flash device to erase
+ * @param [in]   size      The number of bytes to erase
+ * @param [in]   callback  The completion callback (optional)
+ * @param [in]   usr       A user pointer passed to the callback
+ *
+ * @return Returns FLASH_OK if started, FLASH_BUSY if another
+ *         operation is active or its callback has not been made,
+ *         otherwise an error.
+ ******************************************************************/
+int flash_erase_async(const FLASH_INFO *fi, uint32_t addr, int size,
+    FLASH_ASYNC_CALLBACK callback, void *usr);
+
+/*!****************************************************************
+ * @brief  Asynchronous flash program.
+ *
+ * As flash_erase_async() but programs 'buf', which must remain valid
+ * until the callback.
+ ******************************************************************/
+int flash_program_async(const FLASH_INFO *fi, uint32_t addr,
+    const uint8_t *buf, int size, FLASH_ASYNC_CALLBACK callback, void *usr);
+
+/*!****************************************************************
+ * @brief  Advance an asynchronous flash operation.
+ *
+ * Reads the device status once and, if the device is ready, starts
+ * the next page program or erase unit.  Never blocks on the device.
+ *
+ * This function is thread safe.
+ *
+ * @param [in]   fi      A handle to the flash device
+ *
+ * @return Returns FLASH_BUSY while an operation is in progress,
+ *         FLASH_OK when idle, or FLASH_ERROR if the operation failed.
+ ******************************************************************/
+int flash_async_poll(const FLASH_INFO *fi);
+
+/*!****************************************************************
+ * @brief  Wait for an asynchronous flash operation.
+ *
+ * Polls the operation to completion.  With FREE_RTOS the calling task
+ * sleeps FLASH_ASYNC_POLL_MS between status reads so the SPI port and
+ * processor are free for other tasks.
+ *
+ * This function is thread safe.
+ *
+ * @param [in]   fi      A handle to the flash device
+ *
+ * @return Returns the result of the operation.
+ ******************************************************************/
+int flash_async_wait(const FLASH_INFO *fi);
+
+/*!****************************************************************
+ * @brief  Enable memory-mapped (XIP) reads of a flash device.
+ *
+ * Switches the SPI port into memory-mapped mode so the device can be
+ * read, or code executed, directly through the processor's flash
+ * window.  flash_read() then copies from the window and
+ * flash_xip_ptr() returns direct pointers into it.
+ *
+ * Program and erase operations automatically suspend the window: the
+ * SPI port leaves memory-mapped mode for each command and flash_read()
+ * uses normal read commands until the device is idle again.  Window
+ * reads hold the SPI port in memory-mapped mode, so other transfers on
+ * the port wait for them.  The data cache is invalidated over each
+ * programmed or erased range.  Code executed from the window must
+ * invalidate the instruction cache itself.
+ *
+ * The flash must use a hardware slave select on a SPI port with a
+ * memory-mapped window (SPI2).
+ *
+ * @param [in]   fi      A handle to the flash device
+ *
+ * @return Returns FLASH_OK if successful, otherwise
+ *         an error.
+ ******************************************************************/
+int flash_xip_enable(FLASH_INFO *fi);
+
+/*!****************************************************************
+ * @brief  Disable memory-mapped (XIP) reads of a flash device.
+ *
+ * @param [in]   fi      A handle to the flash device
+ *
+ * @return Returns FLASH_OK if successful, otherwise
+ *         an error.
+ ******************************************************************/
+int flash_xip_disable(FLASH_INFO *fi);
+
+/*!****************************************************************
+ * @brief  Direct pointer to flash contents.
+ *
+ * Returns a pointer into the memory-mapped window and holds the SPI
+ * port in memory-mapped mode until flash_xip_release() is called.
+ * Transfers to other devices on the port, and program and erase
+ * commands, wait for the release, so the hold must be brief and the
+ * caller must not call other flash functions on the device before
+ * releasing it.
+ *
+ * @param [in]   fi      A handle to the flash device
+ * @param [in]   addr    The flash address
+ *
+ * @return Returns a pointer to 'addr' in the memory-mapped window or
+ *         NULL if XIP is not enabled, a program or erase is in
+ *         progress or 'addr' is outside the window.  NULL is not
+ *         released.
+ ******************************************************************/
+const uint8_t *flash_xip_ptr(const FLASH_INFO *fi, uint32_t addr);
+
+/*!****************************************************************
+ * @brief  Release a pointer returned by flash_xip_ptr().
+ *
+ * The pointer must not be dereferenced afterwards.
+ *
+ * @param [in]   fi      A handle to the flash device
+ ******************************************************************/
+void flash_xip_release(const FLASH_INFO *fi);
+
 /*!****************************************************************
  * @brief   Flash handle (flash info)
  *
@@ -107,6 +341,42 @@ struct _FLASH_INFO {
     int (*flash_erase)(const FLASH_INFO *fi, uint32_t addr, int size);
     /** Flash device driver program function */
     int (*flash_program)(const FLASH_INFO *fi, uint32_t addr, const uint8_t *buf, int size);
+    /** Erase unit sizes in ascending order, zero terminated.  A unit
+     *  equal to the device size is a chip erase. */
+    uint32_t eraseSizes[FLASH_MAX_ERASE_SIZES];
+    /** Flash device driver single unit erase function (optional).
+     *  'addr' is aligned to 'size', which is one of eraseSizes[]. */
+    int (*flash_erase_unit)(const FLASH_INFO *fi, uint32_t addr, uint32_t size);
+    /** Program page size in bytes */
+    uint32_t pageSize;
+    /** Flash device driver non-blocking single unit erase (optional) */
+    int (*flash_erase_start)(const FLASH_INFO *fi, uint32_t addr, uint32_t size);
+    /** Flash device driver non-blocking single page program (optional) */
+    int (*flash_program_start)(const FLASH_INFO *fi, uint32_t addr, const uint8_t *buf, int size);
+    /** Flash device driver status, FLASH_BUSY, FLASH_OK or an error (optional) */
+    int (*flash_busy)(const FLASH_INFO *fi);
+    /** Flash device driver erase suspend, returns once suspended (optional) */
+    int (*flash_erase_suspend)(const FLASH_INFO *fi);
+    /** Flash device driver erase resume (optional) */
+    int (*flash_erase_resume)(const FLASH_INFO *fi);
+    /** Asynchronous operation state (set by flash_async_init()) */
+    FLASH_ASYNC *async;
+    /** Flash device driver memory-mapped mode enable, returns the
+     *  window and its size (optional) */
+    int (*flash_xip_enable)(const FLASH_INFO *fi, const uint8_t **window, uint32_t *size);
+    /** Flash device driver memory-mapped mode disable (optional) */
+    int (*flash_xip_disable)(const FLASH_INFO *fi);
+    /** Flash device driver window hold, keeps the port in memory-mapped
+     *  mode until released (optional) */
+    int (*flash_xip_hold)(const FLASH_INFO *fi, bool hold);
+    /** Memory-mapped window (set by flash_xip_enable()) */
+    const uint8_t *xip;
+    /** Memory-mapped window size */
+    uint32_t xipSize;
+    /** Program and erase operations in progress */
+    volatile uint32_t xipSuspend;
+    /** Serializes window reads against program and erase */
+    void *xipLock;
 };
 
 #endif /* FLASH_H */
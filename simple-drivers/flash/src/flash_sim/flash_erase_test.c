@@ -0,0 +1,302 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host test of the flash_erase() erase unit planner.
+ *
+ * The simulated device declares 4K sectors, 32K and 64K blocks and a
+ * chip erase.  Random ranges, a mix of small, large and whole device
+ * ranges, are erased over programmed contents through flash_erase(),
+ * flash_erase_progress() or the asynchronous engine.  Each erase must
+ * leave exactly the range extended to 4K boundaries erased, erase
+ * every block in it once and nothing outside it, report progress up
+ * to the total, and use the fewest erase commands possible.  The
+ * fewest is found independently by a search over all aligned units.
+ *
+ * Reads are made between the status polls of the asynchronous erases.
+ * The simulator leaves a unit undefined while it is erased, so a read
+ * must return either the programmed or the erased contents.  A
+ * flash_program() while an asynchronous erase completes must leave the
+ * completion callback to the next flash_async_poll().
+ *
+ * Build from the 'flash' directory with:
+ *   gcc -O2 -DFLASH_SIM_HOST -Isrc -Isrc/flash_sim \
+ *       -o flash_erase_test src/flash_sim/flash_erase_test.c \
+ *       src/flash.c src/flash_sim/flash_sim.c -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "flash.h"
+#include "flash_sim.h"
+
+#define TEST_SIZE       (4 * 1024 * 1024)
+#define TEST_SECTOR     (4 * 1024)
+#define TEST_BLOCKS     (TEST_SIZE / TEST_SECTOR)
+
+typedef struct {
+    uint32_t calls;
+    uint32_t done;
+    uint32_t total;
+    bool bad;
+} TEST_PROGRESS;
+
+static const uint32_t testUnits[] = {
+    TEST_SECTOR, 32 * 1024, 64 * 1024, TEST_SIZE
+};
+
+static uint32_t eraseCount[TEST_BLOCKS];
+static uint32_t fewest[TEST_BLOCKS + 1];
+
+static uint32_t rngState;
+static int callbacks;
+
+static uint32_t test_rand(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return(rngState);
+}
+
+static void test_progress(const FLASH_INFO *fi, uint32_t done,
+    uint32_t total, void *usr)
+{
+    TEST_PROGRESS *p = (TEST_PROGRESS *)usr;
+
+    if ((done <= p->done) || (done > total) ||
+        (p->calls && (total != p->total))) {
+        p->bad = true;
+    }
+    p->calls++;
+    p->done = done;
+    p->total = total;
+}
+
+static void test_done(const FLASH_INFO *fi, int result, void *usr)
+{
+    callbacks++;
+}
+
+/* Fewest aligned units erasing exactly blocks [first, last) */
+static uint32_t test_fewest(uint32_t first, uint32_t last)
+{
+    uint32_t b, u, n, best;
+
+    fewest[last] = 0;
+    for (b = last; b-- > first; ) {
+        best = UINT32_MAX;
+        for (u = 0; u < sizeof(testUnits) / sizeof(testUnits[0]); u++) {
+            n = testUnits[u] / TEST_SECTOR;
+            if (((b % n) == 0) && (b + n <= last) &&
+                (fewest[b + n] + 1 < best)) {
+                best = fewest[b + n] + 1;
+            }
+        }
+        fewest[b] = best;
+    }
+    return(fewest[first]);
+}
+
+static int test_range(const FLASH_INFO *fi, uint32_t trial,
+    uint32_t addr, uint32_t size, int how)
+{
+    FLASH_SIM_STATS stats;
+    TEST_PROGRESS progress;
+    uint32_t first, last, b, a, ops, expect;
+    uint8_t *mem, v;
+    int result;
+    int u;
+
+    first = addr / TEST_SECTOR;
+    last = (addr + size + TEST_SECTOR - 1) / TEST_SECTOR;
+
+    /* Program everything around the range */
+    mem = flash_sim_mem(fi);
+    a = (first > 16) ? (first - 16) * TEST_SECTOR : 0;
+    b = (last + 16 < TEST_BLOCKS) ? (last + 16) * TEST_SECTOR : TEST_SIZE;
+    memset(mem + a, 0x00, b - a);
+
+    memset(&progress, 0, sizeof(progress));
+    flash_sim_stats(fi, NULL, true);
+    if (how == 0) {
+        result = flash_erase(fi, addr, size);
+    } else if (how == 1) {
+        result = flash_erase_progress(fi, addr, size, test_progress,
+            &progress);
+    } else {
+        result = flash_erase_async(fi, addr, size, NULL, NULL);
+        while ((result != FLASH_ERROR) &&
+            ((result = flash_async_poll(fi)) == FLASH_BUSY)) {
+            a = (first + test_rand() % (last - first)) * TEST_SECTOR +
+                test_rand() % TEST_SECTOR;
+            if ((flash_read(fi, a, &v, 1) != FLASH_OK) ||
+                ((v != 0x00) && (v != 0xFF))) {
+                printf("trial %u: erase 0x%x+0x%x read 0x%02x at 0x%x\n",
+                    trial, addr, size, v, a);
+                return(1);
+            }
+        }
+    }
+    flash_sim_stats(fi, &stats, false);
+
+    if (result != FLASH_OK) {
+        printf("trial %u: erase 0x%x+0x%x failed\n", trial, addr, size);
+        return(1);
+    }
+
+    /* Exactly the aligned range erased, each block once */
+    for (b = 0; b < TEST_BLOCKS; b++) {
+        expect = ((b >= first) && (b < last)) ? 1 : 0;
+        if (flash_sim_erase_count(fi, b * TEST_SECTOR) !=
+                eraseCount[b] + expect) {
+            printf("trial %u: erase 0x%x+0x%x block %u erased %u times\n",
+                trial, addr, size, b,
+                flash_sim_erase_count(fi, b * TEST_SECTOR) - eraseCount[b]);
+            return(1);
+        }
+        eraseCount[b] += expect;
+    }
+    for (a = first * TEST_SECTOR; a < last * TEST_SECTOR; a++) {
+        if (mem[a] != 0xFF) {
+            printf("trial %u: erase 0x%x+0x%x not erased at 0x%x\n",
+                trial, addr, size, a);
+            return(1);
+        }
+    }
+
+    /* Fewest erase commands */
+    ops = 0;
+    for (u = 0; u < FLASH_MAX_ERASE_SIZES; u++) {
+        ops += stats.eraseOps[u];
+    }
+    expect = test_fewest(first, last);
+    if (ops != expect) {
+        printf("trial %u: erase 0x%x+0x%x took %u erases, %u needed\n",
+            trial, addr, size, ops, expect);
+        return(1);
+    }
+
+    if ((how == 1) && (progress.bad || (progress.calls != ops) ||
+        (progress.done != progress.total))) {
+        printf("trial %u: erase 0x%x+0x%x bad progress\n", trial, addr,
+            size);
+        return(1);
+    }
+
+    return(0);
+}
+
+/* The callback of an erase completed by flash_program() is deferred */
+static int test_deferred(const FLASH_INFO *fi)
+{
+    uint8_t buf[4] = { 0 };
+    int fails = 0;
+
+    memset(flash_sim_mem(fi), 0xFF, TEST_SIZE);
+    callbacks = 0;
+    if ((flash_erase_async(fi, 0, TEST_SECTOR, test_done, NULL) != FLASH_OK) ||
+        (flash_program(fi, 2 * TEST_SECTOR, buf, sizeof(buf)) != FLASH_OK)) {
+        printf("deferred callback: erase or program failed\n");
+        return(1);
+    }
+    if (callbacks != 0) {
+        printf("deferred callback: called by flash_program()\n");
+        fails++;
+    }
+    if (flash_erase_async(fi, 0, TEST_SECTOR, test_done, NULL) != FLASH_BUSY) {
+        printf("deferred callback: erase started before the callback\n");
+        fails++;
+    }
+    flash_async_wait(fi);
+    if (callbacks != 1) {
+        printf("deferred callback: %d calls\n", callbacks);
+        fails++;
+    }
+    return(fails);
+}
+
+static void usage(void)
+{
+    printf("flash_erase_test [options]\n");
+    printf("  -n <ranges>  Number of random ranges (2000)\n");
+    printf("  -s <seed>    Random seed (1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    FLASH_SIM_CONFIG cfg = {
+        .size = TEST_SIZE, .eraseSize = TEST_SECTOR, .pageSize = 256,
+        .eraseSizes = { TEST_SECTOR, 32 * 1024, 64 * 1024, TEST_SIZE },
+        .seed = 1
+    };
+    uint32_t trials = 2000, seed = 1, t, addr, size, r;
+    FLASH_ASYNC async;
+    FLASH_INFO *fi;
+    int fails = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (c) {
+            case 'n': trials = strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            default: usage(); return(1);
+        }
+    }
+    rngState = seed ? seed : 1;
+
+    fi = flash_sim_open(&cfg);
+    if (fi == NULL) {
+        printf("flash_sim_open failed\n");
+        return(1);
+    }
+
+    for (t = 0; t < trials; t++) {
+        /* Mostly small ranges, some up to the end and some whole */
+        r = test_rand() % 20;
+        if (r == 0) {
+            addr = 0;
+            size = TEST_SIZE;
+        } else {
+            addr = test_rand() % TEST_SIZE;
+            if (r < 4) {
+                size = 1 + test_rand() % (TEST_SIZE - addr);
+            } else {
+                size = 1 + test_rand() % (256 * 1024);
+                if (size > TEST_SIZE - addr) {
+                    size = TEST_SIZE - addr;
+                }
+            }
+        }
+
+        /* The last third runs through the asynchronous engine */
+        if ((t == (trials * 2) / 3) &&
+            (flash_async_init(fi, &async) != FLASH_OK)) {
+            printf("flash_async_init failed\n");
+            return(1);
+        }
+        fails += test_range(fi, t, addr, size,
+            fi->async ? 2 : (int)(t % 2));
+    }
+    if (fi->async) {
+        fails += test_deferred(fi);
+    }
+    printf("%u ranges, %d failed\n", trials, fails);
+
+    flash_sim_close(fi);
+
+    return(fails ? 2 : 0);
+}
@@ -0,0 +1,648 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "flash.h"
+#include "flash_sim.h"
+
+typedef struct _FLASH_SIM {
+    FLASH_INFO info;                /* Must be first */
+    FLASH_SIM_CONFIG cfg;
+    pthread_mutex_t lock;
+    int fd;
+    uint8_t *mem;
+    uint32_t *eraseCount;
+    FLASH_SIM_STATS stats;
+    uint32_t cutOps;                /* Operations left before the cut */
+    bool powerLost;
+    uint32_t rand;
+    bool busy;                      /* Started operation in progress */
+    bool suspended;                 /* Erase suspended */
+    bool erasing;                   /* Started operation is an erase */
+    uint64_t busyUntil;             /* End of the started operation */
+    uint64_t busyLeft;              /* Remaining time of a suspended erase */
+    uint32_t eraseAddr;             /* Unit of the started erase */
+    uint32_t eraseEnd;
+    uint32_t xipHold;               /* Window reads in progress */
+} FLASH_SIM;
+
+static FLASH_SIM *flash_sim(const FLASH_INFO *fi)
+{
+    return((FLASH_SIM *)fi);
+}
+
+static uint32_t flash_sim_rand(FLASH_SIM *sim)
+{
+    /* xorshift32 */
+    sim->rand ^= sim->rand << 13;
+    sim->rand ^= sim->rand >> 17;
+    sim->rand ^= sim->rand << 5;
+    return(sim->rand);
+}
+
+static uint64_t flash_sim_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+static void flash_sim_busy(FLASH_SIM *sim, uint64_t ns)
+{
+    struct timespec ts;
+
+    sim->stats.busyNs += ns;
+
+    if (sim->cfg.realTime && ns) {
+        ts.tv_sec = ns / 1000000000ull;
+        ts.tv_nsec = ns % 1000000000ull;
+        nanosleep(&ts, NULL);
+    }
+}
+
+/*
+ * Account for a started operation without waiting for it.  In real time
+ * it completes after 'ns', otherwise after the first busy status read.
+ */
+static void flash_sim_start(FLASH_SIM *sim, uint64_t ns, bool erasing)
+{
+    sim->stats.busyNs += ns;
+    sim->busy = true;
+    sim->erasing = erasing;
+    sim->busyUntil = flash_sim_now() + ns;
+    sim->busyLeft = ns;
+}
+
+/*
+ * Complete the started operation.  A started erase only leaves its unit
+ * erased now, until then the contents are undefined.
+ */
+static void flash_sim_complete(FLASH_SIM *sim)
+{
+    if (sim->erasing) {
+        memset(&sim->mem[sim->eraseAddr], 0xFF,
+            sim->eraseEnd - sim->eraseAddr);
+        sim->erasing = false;
+    }
+    sim->busy = false;
+}
+
+/* Returns true if a started operation is still in progress */
+static bool flash_sim_in_progress(FLASH_SIM *sim)
+{
+    if (sim->busy && sim->cfg.realTime && !sim->suspended &&
+        (flash_sim_now() >= sim->busyUntil)) {
+        flash_sim_complete(sim);
+    }
+    return(sim->busy && !sim->suspended);
+}
+
+/* Returns true if this operation is interrupted by the armed power cut */
+static bool flash_sim_cut(FLASH_SIM *sim)
+{
+    if (sim->cutOps == 0) {
+        return(false);
+    }
+    sim->cutOps--;
+    if (sim->cutOps == 0) {
+        sim->powerLost = true;
+        return(true);
+    }
+    return(false);
+}
+
+static bool flash_sim_range(FLASH_SIM *sim, uint32_t addr, int size)
+{
+    return((size >= 0) && (addr <= sim->cfg.size) &&
+        ((uint32_t)size <= sim->cfg.size - addr));
+}
+
+static int flash_sim_read(const FLASH_INFO *fi, uint32_t addr, uint8_t *buf, int size)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+    int result = FLASH_OK;
+
+    pthread_mutex_lock(&sim->lock);
+
+    /* Reads are only possible while idle or suspended */
+    if (sim->powerLost || flash_sim_in_progress(sim) ||
+        !flash_sim_range(sim, addr, size)) {
+        result = FLASH_ERROR;
+    } else {
+        memcpy(buf, &sim->mem[addr], size);
+        sim->stats.reads++;
+        sim->stats.readBytes += size;
+        flash_sim_busy(sim, sim->cfg.readSetupNs +
+            (uint64_t)sim->cfg.readByteNs * size);
+    }
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return(result);
+}
+
+/*
+ * Erase [addr, end) as one operation of erase unit 'unit'.  If 'start'
+ * the range is left partially erased until the operation completes.
+ */
+static int flash_sim_erase_op(FLASH_SIM *sim, uint32_t addr, uint32_t end,
+    int unit, bool start, uint64_t *ns)
+{
+    uint32_t eraseSize = sim->cfg.eraseSize;
+    uint32_t i;
+    uint8_t *p;
+
+    p = &sim->mem[addr];
+    if (flash_sim_cut(sim)) {
+        /* Partially erased, random bits have reached 1 */
+        for (i = 0; i < end - addr; i++) {
+            p[i] |= (uint8_t)flash_sim_rand(sim);
+        }
+        return(FLASH_ERROR);
+    }
+    if (start) {
+        for (i = 0; i < end - addr; i++) {
+            p[i] |= (uint8_t)flash_sim_rand(sim);
+        }
+        sim->eraseAddr = addr;
+        sim->eraseEnd = end;
+    } else {
+        memset(p, 0xFF, end - addr);
+    }
+    for (; addr < end; addr += eraseSize) {
+        sim->eraseCount[addr / eraseSize]++;
+        sim->stats.erases++;
+    }
+    sim->stats.eraseOps[unit]++;
+    *ns = sim->cfg.eraseUnitNs[unit] ?
+        sim->cfg.eraseUnitNs[unit] : sim->cfg.eraseBlockNs;
+
+    return(FLASH_OK);
+}
+
+static int flash_sim_erase(const FLASH_INFO *fi, uint32_t addr, int size)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+    uint32_t eraseSize = sim->cfg.eraseSize;
+    uint32_t end;
+    uint64_t ns;
+    int result = FLASH_OK;
+
+    pthread_mutex_lock(&sim->lock);
+
+    if (sim->powerLost || flash_sim_in_progress(sim) || sim->suspended ||
+        sim->xipHold || !flash_sim_range(sim, addr, size)) {
+        pthread_mutex_unlock(&sim->lock);
+        return(FLASH_ERROR);
+    }
+
+    /* Extend to the erase block boundaries on both sides */
+    end = addr + size;
+    addr -= addr % eraseSize;
+    if (end % eraseSize) {
+        end += eraseSize - (end % eraseSize);
+    }
+
+    for (; addr < end; addr += eraseSize) {
+        result = flash_sim_erase_op(sim, addr, addr + eraseSize, 0, false, &ns);
+        if (result != FLASH_OK) {
+            break;
+        }
+        flash_sim_busy(sim, ns);
+    }
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return(result);
+}
+
+/* Erase one declared unit, waiting for it unless 'start' */
+static int flash_sim_erase_one(const FLASH_INFO *fi, uint32_t addr,
+    uint32_t size, bool start)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+    int result = FLASH_ERROR;
+    uint64_t ns;
+    int unit;
+
+    pthread_mutex_lock(&sim->lock);
+
+    /* Like the real parts, only declared and aligned units are valid */
+    for (unit = 0; unit < FLASH_MAX_ERASE_SIZES; unit++) {
+        if (sim->info.eraseSizes[unit] == size) {
+            break;
+        }
+    }
+    if (!sim->powerLost && !flash_sim_in_progress(sim) && !sim->suspended &&
+        !sim->xipHold && size && (unit < FLASH_MAX_ERASE_SIZES) && ((addr % size) == 0) &&
+        flash_sim_range(sim, addr, size)) {
+        result = flash_sim_erase_op(sim, addr, addr + size, unit, start, &ns);
+        if (result == FLASH_OK) {
+            if (start) {
+                flash_sim_start(sim, ns, true);
+            } else {
+                flash_sim_busy(sim, ns);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return(result);
+}
+
+static int flash_sim_erase_unit(const FLASH_INFO *fi, uint32_t addr, uint32_t size)
+{
+    return(flash_sim_erase_one(fi, addr, size, false));
+}
+
+static int flash_sim_erase_start(const FLASH_INFO *fi, uint32_t addr, uint32_t size)
+{
+    return(flash_sim_erase_one(fi, addr, size, true));
+}
+
+/* Program within one page */
+static int flash_sim_program_page(FLASH_SIM *sim, uint32_t addr,
+    const uint8_t *buf, uint32_t psize)
+{
+    uint32_t n, i;
+    uint8_t *p;
+
+    p = &sim->mem[addr];
+    for (i = 0; i < psize; i++) {
+        if (buf[i] & ~p[i]) {
+            sim->stats.programViolations++;
+            if (sim->cfg.strict) {
+                return(FLASH_ERROR);
+            }
+        }
+    }
+
+    /* Programming only clears bits */
+    n = psize;
+    if (flash_sim_cut(sim)) {
+        n = flash_sim_rand(sim) % psize;
+    }
+    for (i = 0; i < n; i++) {
+        p[i] &= buf[i];
+    }
+    if (n != psize) {
+        return(FLASH_ERROR);
+    }
+
+    sim->stats.programs++;
+    sim->stats.programBytes += psize;
+
+    return(FLASH_OK);
+}
+
+static int flash_sim_program(const FLASH_INFO *fi,
+        uint32_t addr, const uint8_t *buf, int size)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+    uint32_t psize;
+    int result = FLASH_OK;
+
+    pthread_mutex_lock(&sim->lock);
+
+    if (sim->powerLost || flash_sim_in_progress(sim) || sim->suspended ||
+        sim->xipHold || !flash_sim_range(sim, addr, size)) {
+        pthread_mutex_unlock(&sim->lock);
+        return(FLASH_ERROR);
+    }
+
+    while (size > 0) {
+
+        /* Write at most up to the next page boundary */
+        psize = sim->cfg.pageSize - (addr % sim->cfg.pageSize);
+        if ((uint32_t)size < psize) {
+            psize = size;
+        }
+
+        result = flash_sim_program_page(sim, addr, buf, psize);
+        if (result != FLASH_OK) {
+            break;
+        }
+        flash_sim_busy(sim, sim->cfg.programPageNs);
+
+        addr += psize;
+        size -= psize;
+        buf += psize;
+    }
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return(result);
+}
+
+static int flash_sim_program_start(const FLASH_INFO *fi,
+        uint32_t addr, const uint8_t *buf, int size)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+    int result = FLASH_ERROR;
+
+    pthread_mutex_lock(&sim->lock);
+
+    /* Must not cross a page boundary */
+    if (!sim->powerLost && !flash_sim_in_progress(sim) && !sim->suspended &&
+        !sim->xipHold && (size > 0) && flash_sim_range(sim, addr, size) &&
+        ((addr % sim->cfg.pageSize) + size <= sim->cfg.pageSize)) {
+        result = flash_sim_program_page(sim, addr, buf, size);
+        if (result == FLASH_OK) {
+            flash_sim_start(sim, sim->cfg.programPageNs, false);
+        }
+    }
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return(result);
+}
+
+static int flash_sim_busy_status(const FLASH_INFO *fi)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+    int result = FLASH_OK;
+
+    pthread_mutex_lock(&sim->lock);
+
+    if (sim->powerLost) {
+        result = FLASH_ERROR;
+    } else if (flash_sim_in_progress(sim)) {
+        result = FLASH_BUSY;
+        sim->stats.busyPolls++;
+        if (!sim->cfg.realTime) {
+            flash_sim_complete(sim);
+        }
+    }
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return(result);
+}
+
+static int flash_sim_erase_suspend(const FLASH_INFO *fi)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+    uint64_t now;
+
+    pthread_mutex_lock(&sim->lock);
+
+    /* Ignored unless an erase is in progress */
+    if (flash_sim_in_progress(sim) && sim->erasing) {
+        now = flash_sim_now();
+        sim->busyLeft = (sim->busyUntil > now) ? sim->busyUntil - now : 0;
+        sim->suspended = true;
+        sim->stats.suspends++;
+    }
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return(FLASH_OK);
+}
+
+static int flash_sim_erase_resume(const FLASH_INFO *fi)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+
+    pthread_mutex_lock(&sim->lock);
+
+    if (sim->suspended) {
+        sim->suspended = false;
+        sim->busyUntil = flash_sim_now() + sim->busyLeft;
+    }
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return(FLASH_OK);
+}
+
+/* The simulated contents are the memory-mapped window */
+static int flash_sim_xip_enable(const FLASH_INFO *fi,
+    const uint8_t **window, uint32_t *size)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+
+    *window = sim->mem;
+    *size = sim->cfg.size;
+
+    return(FLASH_OK);
+}
+
+static int flash_sim_xip_disable(const FLASH_INFO *fi)
+{
+    return(FLASH_OK);
+}
+
+/*
+ * A held window keeps the port in memory-mapped mode, so the commands of
+ * a program or erase issued meanwhile fail rather than wait.
+ */
+static int flash_sim_xip_hold(const FLASH_INFO *fi, bool hold)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+    int result = FLASH_OK;
+
+    pthread_mutex_lock(&sim->lock);
+
+    if (hold) {
+        sim->xipHold++;
+        sim->stats.xipHolds++;
+    } else if (sim->xipHold) {
+        sim->xipHold--;
+    } else {
+        result = FLASH_ERROR;
+    }
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return(result);
+}
+
+FLASH_INFO *flash_sim_open(const FLASH_SIM_CONFIG *cfg)
+{
+    FLASH_SIM *sim;
+    struct stat st;
+    bool blank = true;
+    int i;
+
+    if ((cfg == NULL) || (cfg->eraseSize == 0) || (cfg->pageSize == 0) ||
+        (cfg->size == 0) || (cfg->size % cfg->eraseSize)) {
+        return(NULL);
+    }
+    if (cfg->eraseSizes[0] && (cfg->eraseSizes[0] != cfg->eraseSize)) {
+        return(NULL);
+    }
+    for (i = 1; i < FLASH_MAX_ERASE_SIZES && cfg->eraseSizes[i]; i++) {
+        if ((cfg->eraseSizes[i] <= cfg->eraseSizes[i-1]) ||
+            (cfg->eraseSizes[i] % cfg->eraseSize) ||
+            (cfg->size % cfg->eraseSizes[i])) {
+            return(NULL);
+        }
+    }
+
+    sim = calloc(1, sizeof(*sim));
+    if (sim == NULL) {
+        return(NULL);
+    }
+    sim->cfg = *cfg;
+    sim->fd = -1;
+    sim->rand = cfg->seed ? cfg->seed : 1;
+
+    sim->eraseCount = calloc(cfg->size / cfg->eraseSize, sizeof(uint32_t));
+    if (sim->eraseCount == NULL) {
+        goto abort;
+    }
+
+    if (cfg->path) {
+        sim->fd = open(cfg->path, O_RDWR | O_CREAT, 0644);
+        if (sim->fd < 0) {
+            goto abort;
+        }
+        if (fstat(sim->fd, &st) == 0) {
+            blank = (st.st_size == 0);
+        }
+        if (ftruncate(sim->fd, cfg->size) != 0) {
+            goto abort;
+        }
+        sim->mem = mmap(NULL, cfg->size, PROT_READ | PROT_WRITE,
+            MAP_SHARED, sim->fd, 0);
+    } else {
+        sim->mem = mmap(NULL, cfg->size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (sim->mem == MAP_FAILED) {
+        sim->mem = NULL;
+        goto abort;
+    }
+    if (blank) {
+        memset(sim->mem, 0xFF, cfg->size);
+    }
+
+    pthread_mutex_init(&sim->lock, NULL);
+
+    sim->info.flashHandle = NULL;
+    sim->info.flash_read = flash_sim_read;
+    sim->info.flash_erase = flash_sim_erase;
+    sim->info.flash_program = flash_sim_program;
+    sim->info.flash_erase_unit = flash_sim_erase_unit;
+    sim->info.pageSize = cfg->pageSize;
+    sim->info.flash_erase_start = flash_sim_erase_start;
+    sim->info.flash_program_start = flash_sim_program_start;
+    sim->info.flash_busy = flash_sim_busy_status;
+    sim->info.flash_erase_suspend = flash_sim_erase_suspend;
+    sim->info.flash_erase_resume = flash_sim_erase_resume;
+    sim->info.flash_xip_enable = flash_sim_xip_enable;
+    sim->info.flash_xip_disable = flash_sim_xip_disable;
+    sim->info.flash_xip_hold = flash_sim_xip_hold;
+    if (cfg->eraseSizes[0]) {
+        memcpy(sim->info.eraseSizes, cfg->eraseSizes, sizeof(cfg->eraseSizes));
+    } else {
+        sim->info.eraseSizes[0] = cfg->eraseSize;
+    }
+
+    return(&sim->info);
+
+abort:
+    if (sim->fd >= 0) {
+        close(sim->fd);
+    }
+    if (sim->eraseCount) {
+        free(sim->eraseCount);
+    }
+    free(sim);
+    return(NULL);
+}
+
+int flash_sim_close(const FLASH_INFO *fi)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+    int result = FLASH_OK;
+
+    if (sim->fd >= 0) {
+        if (msync(sim->mem, sim->cfg.size, MS_SYNC) != 0) {
+            result = FLASH_ERROR;
+        }
+    }
+    munmap(sim->mem, sim->cfg.size);
+    if (sim->fd >= 0) {
+        close(sim->fd);
+    }
+    pthread_mutex_destroy(&sim->lock);
+    free(sim->eraseCount);
+    free(sim);
+
+    return(result);
+}
+
+void flash_sim_stats(const FLASH_INFO *fi, FLASH_SIM_STATS *stats, bool reset)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+
+    pthread_mutex_lock(&sim->lock);
+    if (stats) {
+        *stats = sim->stats;
+    }
+    if (reset) {
+        memset(&sim->stats, 0, sizeof(sim->stats));
+    }
+    pthread_mutex_unlock(&sim->lock);
+}
+
+uint32_t flash_sim_erase_count(const FLASH_INFO *fi, uint32_t addr)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+
+    if (addr >= sim->cfg.size) {
+        return(0);
+    }
+    return(sim->eraseCount[addr / sim->cfg.eraseSize]);
+}
+
+void flash_sim_power_cut(const FLASH_INFO *fi, uint32_t ops)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+
+    pthread_mutex_lock(&sim->lock);
+    sim->cutOps = ops;
+    pthread_mutex_unlock(&sim->lock);
+}
+
+bool flash_sim_power_lost(const FLASH_INFO *fi)
+{
+    return(flash_sim(fi)->powerLost);
+}
+
+void flash_sim_power_on(const FLASH_INFO *fi)
+{
+    FLASH_SIM *sim = flash_sim(fi);
+
+    pthread_mutex_lock(&sim->lock);
+    sim->powerLost = false;
+    sim->cutOps = 0;
+    sim->busy = false;
+    sim->erasing = false;
+    sim->suspended = false;
+    pthread_mutex_unlock(&sim->lock);
+}
+
+uint8_t *flash_sim_mem(const FLASH_INFO *fi)
+{
+    return(flash_sim(fi)->mem);
+}
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*!
+ * @brief  Host (Linux) NOR flash simulator for use with the generic
+ *         flash interface driver.
+ *
+ * Simulates a NOR flash in memory or in a memory-mapped file so
+ * flash based filesystems and the bootloader flash path can be tested
+ * without hardware.  Programming only clears bits and erases work on
+ * whole erase blocks.  Operation timings, per-block erase counts and
+ * power-cut injection are provided for performance and robustness
+ * testing.  The non-blocking program, erase and erase suspend
+ * functions used by the asynchronous flash operations are supported,
+ * as is XIP with the simulated contents as the window.
+ *
+ * Build with FLASH_SIM_HOST defined.
+ *
+ * @file       flash_sim.h
+ * @version    1.0.0
+ * @copyright  2022 Analog Devices, Inc.  All rights reserved.
+ *
+*/
+
+#ifndef _flash_sim_h
+#define _flash_sim_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "flash.h"
+
+/*!****************************************************************
+ * @brief   Flash simulator configuration
+ ******************************************************************/
+typedef struct _FLASH_SIM_CONFIG {
+    /** Backing file, created if necessary (NULL = memory only) */
+    const char *path;
+    /** Device size in bytes, a multiple of eraseSize */
+    uint32_t size;
+    /** Erase block size in bytes */
+    uint32_t eraseSize;
+    /** Program page size in bytes, programs are split at page boundaries */
+    uint32_t pageSize;
+    /** Read command overhead in ns */
+    uint32_t readSetupNs;
+    /** Read time per byte in ns */
+    uint32_t readByteNs;
+    /** Page program time in ns */
+    uint32_t programPageNs;
+    /** Block erase time in ns */
+    uint32_t eraseBlockNs;
+    /** Erase units in ascending order, zero terminated, starting with
+     *  eraseSize (all zero = eraseSize only).  A unit equal to 'size'
+     *  is a chip erase. */
+    uint32_t eraseSizes[FLASH_MAX_ERASE_SIZES];
+    /** Erase time in ns of each erase unit (0 = eraseBlockNs) */
+    uint64_t eraseUnitNs[FLASH_MAX_ERASE_SIZES];
+    /** Sleep for the simulated time instead of only accounting for it */
+    bool realTime;
+    /** Fail programs which try to set a programmed bit back to 1 */
+    bool strict;
+    /** Seed for the torn operation contents of a power cut */
+    uint32_t seed;
+} FLASH_SIM_CONFIG;
+
+/*!****************************************************************
+ * @brief   Flash simulator statistics
+ ******************************************************************/
+typedef struct _FLASH_SIM_STATS {
+    uint32_t reads;                 /**< flash_read() calls */
+    uint64_t readBytes;             /**< Bytes read */
+    uint32_t programs;              /**< Pages programmed */
+    uint64_t programBytes;          /**< Bytes programmed */
+    uint32_t erases;                /**< Blocks erased */
+    uint32_t eraseOps[FLASH_MAX_ERASE_SIZES]; /**< Erase commands per unit */
+    uint32_t programViolations;     /**< Programs setting 0 bits to 1 */
+    uint32_t busyPolls;             /**< Status reads returning busy */
+    uint32_t suspends;              /**< Erases suspended */
+    uint32_t xipHolds;              /**< Window holds for reads */
+    uint64_t busyNs;                /**< Simulated device busy time */
+} FLASH_SIM_STATS;
+
+/*!****************************************************************
+ * @brief  Flash simulator open.
+ *
+ * This function returns a flash info handle for use by the generic
+ * flash interface driver.  A new backing file, or a memory only
+ * device, starts fully erased.
+ *
+ * @param [in]   cfg    The simulated device configuration
+ *
+ * @return Returns a flash handle or NULL on error.
+ ******************************************************************/
+FLASH_INFO *flash_sim_open(const FLASH_SIM_CONFIG *cfg);
+
+/*!****************************************************************
+ * @brief  Flash simulator close.
+ *
+ * This function flushes the backing file and frees the handle.
+ *
+ * @param [in]   fi    A flash simulator handle
+ *
+ * @return FLASH_OK on success or FLASH_ERROR on error.
+ ******************************************************************/
+int flash_sim_close(const FLASH_INFO *fi);
+
+/*!****************************************************************
+ * @brief  Flash simulator statistics.
+ *
+ * @param [in]   fi      A flash simulator handle
+ * @param [out]  stats   The statistics (optional)
+ * @param [in]   reset   Clear the statistics afterwards
+ ******************************************************************/
+void flash_sim_stats(const FLASH_INFO *fi, FLASH_SIM_STATS *stats, bool reset);
+
+/*!****************************************************************
+ * @brief  Returns the number of times the erase block holding
+ *         'addr' has been erased since open.
+ ******************************************************************/
+uint32_t flash_sim_erase_count(const FLASH_INFO *fi, uint32_t addr);
+
+/*!****************************************************************
+ * @brief  Arm a power cut.
+ *
+ * The power is cut during the 'ops'th following page program or
+ * block erase (1 = the next one, 0 = disarm).  The interrupted page
+ * is only partially programmed and the interrupted block is left
+ * partially erased.  All operations then fail with FLASH_ERROR until
+ * flash_sim_power_on() is called.
+ *
+ * @param [in]   fi    A flash simulator handle
+ * @param [in]   ops   Operation to interrupt
+ ******************************************************************/
+void flash_sim_power_cut(const FLASH_INFO *fi, uint32_t ops);
+
+/*!****************************************************************
+ * @brief  Returns true if an armed power cut has happened
+ ******************************************************************/
+bool flash_sim_power_lost(const FLASH_INFO *fi);
+
+/*!****************************************************************
+ * @brief  Restore power after a power cut
+ ******************************************************************/
+void flash_sim_power_on(const FLASH_INFO *fi);
+
+/*!****************************************************************
+ * @brief  Returns the simulated flash contents for inspection
+ ******************************************************************/
+uint8_t *flash_sim_mem(const FLASH_INFO *fi);
+
+#endif
@@ -0,0 +1,339 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host test of the memory-mapped (XIP) read path.
+ *
+ * flash_sim exposes its contents as the window.  flash_xip_ptr() must
+ * return NULL until flash_xip_enable() and after flash_xip_disable(),
+ * and for addresses outside the window, and otherwise point at the
+ * flash contents.  Random flash_read() ranges must be served from the
+ * window, without a driver read, and return the programmed contents.
+ *
+ * A held pointer keeps the port in memory-mapped mode, so the simulator
+ * fails a program issued meanwhile.  Reads nest inside the hold.  After
+ * flash_xip_release() the program must succeed and show through the
+ * window.  While an asynchronous erase runs flash_xip_ptr() must return
+ * NULL and flash_read() must fall back to driver reads of the correct
+ * contents.  Every window access must be balanced by a release.
+ *
+ * Build from the 'flash' directory with:
+ *   gcc -O2 -DFLASH_SIM_HOST -Isrc -Isrc/flash_sim \
+ *       -o flash_xip_test src/flash_sim/flash_xip_test.c \
+ *       src/flash.c src/flash_sim/flash_sim.c -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "flash.h"
+#include "flash_sim.h"
+
+#define TEST_SIZE       (4 * 1024 * 1024)
+#define TEST_SECTOR     (4 * 1024)
+#define TEST_BLOCK      (64 * 1024)
+#define TEST_MAX_READ   (8 * 1024)
+
+static uint8_t image[TEST_SIZE];
+static uint8_t buf[TEST_MAX_READ];
+
+static uint32_t rngState;
+
+static uint32_t test_rand(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return(rngState);
+}
+
+/* Random reads compared with the image, served from the window or not */
+static int test_reads(const FLASH_INFO *fi, uint32_t reads, bool window,
+    const char *what)
+{
+    FLASH_SIM_STATS stats;
+    uint32_t i, addr, size;
+
+    flash_sim_stats(fi, NULL, true);
+    for (i = 0; i < reads; i++) {
+        addr = test_rand() % TEST_SIZE;
+        size = 1 + test_rand() % TEST_MAX_READ;
+        if (size > TEST_SIZE - addr) {
+            size = TEST_SIZE - addr;
+        }
+        if ((flash_read(fi, addr, buf, size) != FLASH_OK) ||
+            (memcmp(buf, image + addr, size) != 0)) {
+            printf("%s: read 0x%x+0x%x wrong\n", what, addr, size);
+            return(1);
+        }
+    }
+    flash_sim_stats(fi, &stats, false);
+
+    if (window && ((stats.reads != 0) || (stats.xipHolds != reads))) {
+        printf("%s: %u driver reads and %u holds for %u window reads\n",
+            what, stats.reads, stats.xipHolds, reads);
+        return(1);
+    }
+    if (!window && ((stats.reads != reads) || (stats.xipHolds != 0))) {
+        printf("%s: %u driver reads and %u holds for %u reads\n",
+            what, stats.reads, stats.xipHolds, reads);
+        return(1);
+    }
+
+    return(0);
+}
+
+/* Pointers into the window, in and out of range */
+static int test_ptr(const FLASH_INFO *fi, uint32_t ptrs)
+{
+    FLASH_SIM_STATS stats;
+    const uint8_t *p;
+    uint32_t i, addr, size;
+    int fails = 0;
+
+    flash_sim_stats(fi, NULL, true);
+    for (i = 0; i < ptrs; i++) {
+        addr = test_rand() % TEST_SIZE;
+        size = 1 + test_rand() % TEST_MAX_READ;
+        if (size > TEST_SIZE - addr) {
+            size = TEST_SIZE - addr;
+        }
+        p = flash_xip_ptr(fi, addr);
+        if ((p == NULL) || (p != flash_sim_mem(fi) + addr) ||
+            (memcmp(p, image + addr, size) != 0)) {
+            printf("pointer: 0x%x+0x%x wrong\n", addr, size);
+            fails++;
+        }
+        if (p) {
+            flash_xip_release(fi);
+        }
+    }
+    if (flash_xip_ptr(fi, TEST_SIZE) != NULL) {
+        printf("pointer: returned past the end of the window\n");
+        fails++;
+    }
+    flash_sim_stats(fi, &stats, false);
+    if (stats.xipHolds != ptrs) {
+        printf("pointer: %u holds for %u pointers\n", stats.xipHolds, ptrs);
+        fails++;
+    }
+
+    return(fails);
+}
+
+/* A program is refused while a pointer is held */
+static int test_hold(const FLASH_INFO *fi)
+{
+    const uint32_t addr = 3 * TEST_BLOCK + 100;
+    uint8_t data[64];
+    const uint8_t *p;
+    uint32_t i;
+    int fails = 0;
+
+    memset(data, 0x5A, sizeof(data));
+
+    p = flash_xip_ptr(fi, addr);
+    if (p == NULL) {
+        printf("hold: no pointer\n");
+        return(1);
+    }
+    if (flash_program(fi, addr, data, sizeof(data)) == FLASH_OK) {
+        printf("hold: programmed while held\n");
+        fails++;
+    }
+    /* Window reads nest inside the hold */
+    if ((flash_read(fi, addr, buf, sizeof(data)) != FLASH_OK) ||
+        (memcmp(buf, image + addr, sizeof(data)) != 0)) {
+        printf("hold: nested read wrong\n");
+        fails++;
+    }
+    flash_xip_release(fi);
+
+    if (flash_program(fi, addr, data, sizeof(data)) != FLASH_OK) {
+        printf("hold: program after the release failed\n");
+        return(fails + 1);
+    }
+    /* Programming only clears bits */
+    for (i = 0; i < sizeof(data); i++) {
+        image[addr + i] &= data[i];
+    }
+    if (memcmp(p, image + addr, sizeof(data)) != 0) {
+        printf("hold: program not visible in the window\n");
+        fails++;
+    }
+
+    return(fails);
+}
+
+/* The window is suspended while an asynchronous erase runs */
+static int test_erase(const FLASH_INFO *fi, uint32_t reads)
+{
+    FLASH_SIM_STATS stats;
+    uint32_t addr, a, size, polls, i;
+    const uint8_t *p;
+    int result;
+    int fails = 0;
+
+    addr = (test_rand() % (TEST_SIZE / TEST_BLOCK)) * TEST_BLOCK;
+    polls = 0;
+
+    flash_sim_stats(fi, NULL, true);
+    result = flash_erase_async(fi, addr, TEST_BLOCK, NULL, NULL);
+    while ((result != FLASH_ERROR) &&
+        ((result = flash_async_poll(fi)) == FLASH_BUSY)) {
+        polls++;
+        p = flash_xip_ptr(fi, addr);
+        if (p != NULL) {
+            printf("erase: pointer returned while erasing\n");
+            flash_xip_release(fi);
+            fails++;
+        }
+        /* Reads outside the erased block, through the driver */
+        for (i = 0; i < reads; i++) {
+            a = test_rand() % (TEST_SIZE - TEST_BLOCK);
+            if (a >= addr) {
+                a += TEST_BLOCK;
+            }
+            size = 1 + test_rand() % 256;
+            if (size > TEST_SIZE - a) {
+                size = TEST_SIZE - a;
+            }
+            if ((a < addr) && (size > addr - a)) {
+                size = addr - a;
+            }
+            if ((flash_read(fi, a, buf, size) != FLASH_OK) ||
+                (memcmp(buf, image + a, size) != 0)) {
+                printf("erase: read 0x%x+0x%x wrong\n", a, size);
+                return(fails + 1);
+            }
+        }
+    }
+    flash_sim_stats(fi, &stats, false);
+
+    if (result != FLASH_OK) {
+        printf("erase: 0x%x failed\n", addr);
+        return(fails + 1);
+    }
+    if (polls == 0) {
+        printf("erase: finished without a busy poll\n");
+        fails++;
+    }
+    if (stats.xipHolds != 0) {
+        printf("erase: %u window holds while erasing\n", stats.xipHolds);
+        fails++;
+    }
+    memset(image + addr, 0xFF, TEST_BLOCK);
+
+    p = flash_xip_ptr(fi, addr);
+    if (p == NULL) {
+        printf("erase: no pointer after the erase\n");
+        return(fails + 1);
+    }
+    if (memcmp(p, image + addr, TEST_BLOCK) != 0) {
+        printf("erase: window not erased\n");
+        fails++;
+    }
+    flash_xip_release(fi);
+
+    return(fails);
+}
+
+static void usage(void)
+{
+    printf("flash_xip_test [options]\n");
+    printf("  -n <reads>   Number of random reads (2000)\n");
+    printf("  -s <seed>    Random seed (1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    FLASH_SIM_CONFIG cfg = {
+        .size = TEST_SIZE, .eraseSize = TEST_SECTOR, .pageSize = 256,
+        .eraseSizes = { TEST_SECTOR, TEST_BLOCK },
+        .eraseBlockNs = 50000000, .seed = 1
+    };
+    uint32_t reads = 2000, seed = 1, i;
+    FLASH_ASYNC async;
+    FLASH_INFO *fi;
+    int fails = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (c) {
+            case 'n': reads = strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            default: usage(); return(1);
+        }
+    }
+    rngState = seed ? seed : 1;
+
+    fi = flash_sim_open(&cfg);
+    if (fi == NULL) {
+        printf("flash_sim_open failed\n");
+        return(1);
+    }
+
+    for (i = 0; i < TEST_SIZE; i++) {
+        image[i] = test_rand();
+    }
+    if (flash_program(fi, 0, image, TEST_SIZE) != FLASH_OK) {
+        printf("flash_program failed\n");
+        return(1);
+    }
+
+    /* Disabled */
+    if (flash_xip_ptr(fi, 0) != NULL) {
+        printf("disabled: pointer returned\n");
+        fails++;
+    }
+    fails += test_reads(fi, reads / 10, false, "disabled");
+
+    /* Enabled */
+    if (flash_xip_enable(fi) != FLASH_OK) {
+        printf("flash_xip_enable failed\n");
+        return(1);
+    }
+    fails += test_reads(fi, reads, true, "window");
+    fails += test_ptr(fi, reads);
+    fails += test_hold(fi);
+    fails += test_reads(fi, reads, true, "window after program");
+
+    /* Asynchronous erases */
+    if (flash_async_init(fi, &async) != FLASH_OK) {
+        printf("flash_async_init failed\n");
+        return(1);
+    }
+    for (i = 0; i < 4; i++) {
+        fails += test_erase(fi, 4);
+    }
+    fails += test_reads(fi, reads, true, "window after erase");
+
+    /* Disabled again */
+    if (flash_xip_disable(fi) != FLASH_OK) {
+        printf("flash_xip_disable failed\n");
+        fails++;
+    }
+    if (flash_xip_ptr(fi, 0) != NULL) {
+        printf("disabled again: pointer returned\n");
+        fails++;
+    }
+    fails += test_reads(fi, reads / 10, false, "disabled again");
+
+    printf("%u reads, %d failed\n", reads, fails);
+
+    flash_sim_close(fi);
+
+    return(fails ? 2 : 0);
+}
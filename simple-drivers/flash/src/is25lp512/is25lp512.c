@@ -23,12 +23,18 @@
 #define CMD_WRITE_ENABLE                    0x06
 #define CMD_WRITE_DISABLE                   0x04
 #define CMD_4KB_SUBSECTOR_ERASE             0x21
+#define CMD_32KB_BLOCK_ERASE                0x5C
+#define CMD_64KB_BLOCK_ERASE                0xDC
+#define CMD_CHIP_ERASE                      0xC7
 #define CMD_ENTER_4_BYTE_ADDRESS_MODE       0xB7
 #define CMD_EXIT_4_BYTE_ADDRESS_MODE        0x29
 #define CMD_READ_STATUS_REGISTER            0x05
 #define CMD_WRITE_STATUS_REGISTER           0x01
 #define CMD_4_BYTE_QUAD_INPUT_FAST_PROGRAM  0x34
 #define CMD_READ_UID                        0x4B
+#define CMD_ERASE_SUSPEND                   0x75
+#define CMD_ERASE_RESUME                    0x7A
+#define CMD_QUAD_IO_FAST_READ               0xEB
 
 /* Status register bits */
 #define WRITE_IN_PROGRESS       (0x01)
@@ -40,6 +46,17 @@
 /* Erase sizes and commands */
 #define ERASE_CMD               (CMD_4KB_SUBSECTOR_ERASE)
 #define ERASE_SECTOR_SIZE       (4*1024)
+#define ERASE_32K_CMD           (CMD_32KB_BLOCK_ERASE)
+#define ERASE_32K_SIZE          (32*1024)
+#define ERASE_64K_CMD           (CMD_64KB_BLOCK_ERASE)
+#define ERASE_64K_SIZE          (64*1024)
+#define CHIP_ERASE_CMD          (CMD_CHIP_ERASE)
+#define CHIP_SIZE               (64*1024*1024)
+
+/* Memory-mapped read dummy bytes, including the mode byte */
+#ifndef IS25LP_XIP_DUMMY_BYTES
+#define IS25LP_XIP_DUMMY_BYTES  (5)
+#endif
 
 static int is25lp_write_enable(const FLASH_INFO *fi);
 static int is25lp_wait_ready(const FLASH_INFO *fi);
@@ -144,7 +161,7 @@ static int is25lp_write_disable(const FLASH_INFO *fi)
     return(result);
 }
 
-static int is25lp_wait_ready(const FLASH_INFO *fi)
+static int is25lp_busy(const FLASH_INFO *fi)
 {
     int result;
     SPI_SIMPLE_RESULT spiResult;
@@ -155,13 +172,23 @@ static int is25lp_wait_ready(const FLASH_INFO *fi)
     result = FLASH_OK;
 
     cmd[0] = CMD_READ_STATUS_REGISTER;
+    spiResult = spi_xfer(fi->flashHandle, 2, status, cmd);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        result = FLASH_ERROR;
+    } else if (status[1] & WRITE_IN_PROGRESS) {
+        result = FLASH_BUSY;
+    }
+
+    return(result);
+}
+
+static int is25lp_wait_ready(const FLASH_INFO *fi)
+{
+    int result;
+
     do {
-        spiResult = spi_xfer(fi->flashHandle, 2, status, cmd);
-        if (spiResult != SPI_SIMPLE_SUCCESS) {
-            result = FLASH_ERROR;
-            break;
-        }
-    } while (status[1] & WRITE_IN_PROGRESS);
+        result = is25lp_busy(fi);
+    } while (result == FLASH_BUSY);
 
     return(result);
 }
@@ -246,45 +273,159 @@ static int is25lp_read_uid(const FLASH_INFO *fi, uint32_t addr, uint8_t *buf, in
 }
 
 
-static int is25lp_erase(const FLASH_INFO *fi, uint32_t addr, int size)
+/* Start erasing one aligned sector, block or the whole chip */
+static int is25lp_erase_start(const FLASH_INFO *fi, uint32_t addr, uint32_t size)
 {
     int result;
     SPI_SIMPLE_RESULT spiResult;
 
     uint8_t cmd[5];
+    int len = 5;
 
-    /* Align to the start of the ERASE_SECTOR_SIZE boundary */
-    addr -= addr % ERASE_SECTOR_SIZE;
-    size += addr % ERASE_SECTOR_SIZE;
+    if (size == ERASE_SECTOR_SIZE) {
+        cmd[0] = ERASE_CMD;
+    } else if (size == ERASE_32K_SIZE) {
+        cmd[0] = ERASE_32K_CMD;
+    } else if (size == ERASE_64K_SIZE) {
+        cmd[0] = ERASE_64K_CMD;
+    } else if (size == CHIP_SIZE) {
+        cmd[0] = CHIP_ERASE_CMD;
+        len = 1;
+    } else {
+        return(FLASH_ERROR);
+    }
+    cmd[1] = (addr >> 24) & 0xFF;
+    cmd[2] = (addr >> 16) & 0xFF;
+    cmd[3] = (addr >> 8) & 0xFF;
+    cmd[4] = (addr >> 0) & 0xFF;
 
-    result = FLASH_OK;
+    /* Set write enable */
+    result = is25lp_write_enable(fi);
+    if (result != FLASH_OK) {
+        return(result);
+    }
 
-    while (size > 0) {
+    /* Erase */
+    spiResult = spi_xfer(fi->flashHandle, len, NULL, cmd);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
 
-        /* Set write enable */
-        result = is25lp_write_enable(fi);
-        if (result != FLASH_OK) {
-            break;
-        }
+    return(FLASH_OK);
+}
 
-        /* Erase the sector */
-        cmd[0] = ERASE_CMD;
-        cmd[1] = (addr >> 24) & 0xFF;
-        cmd[2] = (addr >> 16) & 0xFF;
-        cmd[3] = (addr >> 8) & 0xFF;
-        cmd[4] = (addr >> 0) & 0xFF;
-        spiResult = spi_xfer(fi->flashHandle, 5, NULL, cmd);
-        if (spiResult != SPI_SIMPLE_SUCCESS) {
-            result = FLASH_ERROR;
-            break;
-        }
+static int is25lp_erase_unit(const FLASH_INFO *fi, uint32_t addr, uint32_t size)
+{
+    int result;
 
-        /* Poll for complete */
+    result = is25lp_erase_start(fi, addr, size);
+    if (result == FLASH_OK) {
         result = is25lp_wait_ready(fi);
+    }
+
+    return(result);
+}
+
+static int is25lp_erase_suspend(const FLASH_INFO *fi)
+{
+    int result;
+    SPI_SIMPLE_RESULT spiResult;
+
+    uint8_t tx[1];
+
+    /* Ready again once suspended (ignored if the erase has finished) */
+    tx[0] = CMD_ERASE_SUSPEND;
+    spiResult = spi_xfer(fi->flashHandle, 1, NULL, tx);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
+
+    result = is25lp_wait_ready(fi);
+
+    return(result);
+}
+
+static int is25lp_erase_resume(const FLASH_INFO *fi)
+{
+    int result;
+    SPI_SIMPLE_RESULT spiResult;
+
+    uint8_t tx[1];
+
+    result = FLASH_OK;
+
+    tx[0] = CMD_ERASE_RESUME;
+    spiResult = spi_xfer(fi->flashHandle, 1, NULL, tx);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        result = FLASH_ERROR;
+    }
+
+    return(result);
+}
+
+#ifdef SPI_SIMPLE_MM_SUPPORTED
+static int is25lp_xip_enable(const FLASH_INFO *fi,
+    const uint8_t **window, uint32_t *size)
+{
+    SPI_SIMPLE_RESULT spiResult;
+    uint32_t header;
+    const void *mm;
+
+    /* QUAD IO FAST READ with 4-byte addresses, as the boot loader.  The
+ * 0xFF mode byte keeps the device out of continuous read mode. */
+    header = SPI_SIMPLE_MM_READ_HEADER(CMD_QUAD_IO_FAST_READ, 4, 1, 0xFF,
+        IS25LP_XIP_DUMMY_BYTES, 2);
+
+    spiResult = spi_enableMemoryMapped(fi->flashHandle, header, CHIP_SIZE,
+        SPI_SIMPLE_XFER_QUAD_IO, &mm);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
+
+    *window = (const uint8_t *)mm;
+    *size = CHIP_SIZE;
+
+    return(FLASH_OK);
+}
+
+static int is25lp_xip_disable(const FLASH_INFO *fi)
+{
+    SPI_SIMPLE_RESULT spiResult;
+
+    spiResult = spi_disableMemoryMapped(fi->flashHandle);
+
+    return((spiResult == SPI_SIMPLE_SUCCESS) ? FLASH_OK : FLASH_ERROR);
+}
+
+static int is25lp_xip_hold(const FLASH_INFO *fi, bool hold)
+{
+    SPI_SIMPLE_RESULT spiResult;
+
+    if (hold) {
+        spiResult = spi_holdMemoryMapped(fi->flashHandle);
+    } else {
+        spiResult = spi_releaseMemoryMapped(fi->flashHandle);
+    }
+
+    return((spiResult == SPI_SIMPLE_SUCCESS) ? FLASH_OK : FLASH_ERROR);
+}
+#endif
+
+static int is25lp_erase(const FLASH_INFO *fi, uint32_t addr, int size)
+{
+    int result;
+
+    /* Align to the start of the ERASE_SECTOR_SIZE boundary */
+    size += addr % ERASE_SECTOR_SIZE;
+    addr -= addr % ERASE_SECTOR_SIZE;
+
+    result = FLASH_OK;
+
+    while (size > 0) {
+        result = is25lp_erase_unit(fi, addr, ERASE_SECTOR_SIZE);
         if (result != FLASH_OK) {
             break;
         }
-
         addr += ERASE_SECTOR_SIZE;
         size -= ERASE_SECTOR_SIZE;
     }
@@ -292,22 +433,59 @@ static int is25lp_erase(const FLASH_INFO *fi, uint32_t addr, int size)
     return(result);
 }
 
-static int is25lp_program(const FLASH_INFO *fi,
+/* Start programming at most one page */
+static int is25lp_program_start(const FLASH_INFO *fi,
         uint32_t addr, const uint8_t *buf, int size)
 {
-    int psize;
-
     int result;
     SPI_SIMPLE_RESULT spiResult;
 
     sSPIXfer spiMultiXfer[2];
     uint8_t cmd[5];
 
-    result = FLASH_OK;
-
     /* Clear the SPI transfer struct */
     memset(&spiMultiXfer, 0, sizeof(spiMultiXfer));
 
+    /* Set write enable */
+    result = is25lp_write_enable(fi);
+    if (result != FLASH_OK) {
+        return(result);
+    }
+
+    /* Configure the 4_BYTE_QUAD_INPUT_FAST_PROGRAM command */
+    cmd[0] = CMD_4_BYTE_QUAD_INPUT_FAST_PROGRAM;
+    cmd[1] = (addr >> 24) & 0xFF;
+    cmd[2] = (addr >> 16) & 0xFF;
+    cmd[3] = (addr >> 8) & 0xFF;
+    cmd[4] = (addr >> 0) & 0xFF;
+
+    spiMultiXfer[0].tx = cmd;
+    spiMultiXfer[0].len = 5;
+    spiMultiXfer[0].flags = SPI_SIMPLE_XFER_NORMAL_IO;
+
+    /* Configure the data transfer */
+    spiMultiXfer[1].tx = (uint8_t *)buf;
+    spiMultiXfer[1].len = size;
+    spiMultiXfer[1].flags = SPI_SIMPLE_XFER_QUAD_IO;
+
+    /* Write the data */
+    spiResult = spi_batch_xfer(fi->flashHandle, 2, spiMultiXfer);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
+
+    return(FLASH_OK);
+}
+
+static int is25lp_program(const FLASH_INFO *fi,
+        uint32_t addr, const uint8_t *buf, int size)
+{
+    int psize;
+
+    int result;
+
+    result = FLASH_OK;
+
     while (size > 0) {
 
         /* Write at most up to the next page boundary */
@@ -315,35 +493,12 @@ static int is25lp_program(const FLASH_INFO *fi,
         if (size < psize) {
             psize = size;
         }
-        /* Set write enable */
-        result = is25lp_write_enable(fi);
+        /* Program the page */
+        result = is25lp_program_start(fi, addr, buf, psize);
         if (result != FLASH_OK) {
             break;
         }
 
-        /* Configure the 4_BYTE_QUAD_INPUT_FAST_PROGRAM command */
-        cmd[0] = CMD_4_BYTE_QUAD_INPUT_FAST_PROGRAM;
-        cmd[1] = (addr >> 24) & 0xFF;
-        cmd[2] = (addr >> 16) & 0xFF;
-        cmd[3] = (addr >> 8) & 0xFF;
-        cmd[4] = (addr >> 0) & 0xFF;
-
-        spiMultiXfer[0].tx = cmd;
-        spiMultiXfer[0].len = 5;
-        spiMultiXfer[0].flags = SPI_SIMPLE_XFER_NORMAL_IO;
-
-        /* Configure the data transfer */
-        spiMultiXfer[1].tx = (uint8_t *)buf;
-        spiMultiXfer[1].len = psize;
-        spiMultiXfer[1].flags = SPI_SIMPLE_XFER_QUAD_IO;
-
-        /* Write the data */
-        spiResult = spi_batch_xfer(fi->flashHandle, 2, spiMultiXfer);
-        if (spiResult != SPI_SIMPLE_SUCCESS) {
-            result = FLASH_ERROR;
-            break;
-        }
-
         /* Poll for complete */
         result = is25lp_wait_ready(fi);
         if (result != FLASH_OK) {
@@ -364,7 +519,20 @@ FLASH_INFO is25lp_info =
     .flashHandle = NULL,
     .flash_read = is25lp_read,
     .flash_erase = is25lp_erase,
-    .flash_program = is25lp_program
+    .flash_program = is25lp_program,
+    .eraseSizes = { ERASE_SECTOR_SIZE, ERASE_32K_SIZE, ERASE_64K_SIZE, CHIP_SIZE },
+    .flash_erase_unit = is25lp_erase_unit,
+    .pageSize = WRITE_PAGE_SIZE,
+    .flash_erase_start = is25lp_erase_start,
+    .flash_program_start = is25lp_program_start,
+    .flash_busy = is25lp_busy,
+    .flash_erase_suspend = is25lp_erase_suspend,
+    .flash_erase_resume = is25lp_erase_resume,
+#ifdef SPI_SIMPLE_MM_SUPPORTED
+    .flash_xip_enable = is25lp_xip_enable,
+    .flash_xip_disable = is25lp_xip_disable,
+    .flash_xip_hold = is25lp_xip_hold
+#endif
 };
 
 FLASH_INFO *is25lp_open(sSPIPeriph *spiFlashHandle)
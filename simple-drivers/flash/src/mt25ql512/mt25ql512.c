@@ -23,9 +23,14 @@
 #define CMD_WRITE_ENABLE                    0x06
 #define CMD_WRITE_DISABLE                   0x04
 #define CMD_4_BYTE_4KB_SUBSECTOR_ERASE      0x21
+#define CMD_4_BYTE_32KB_SUBSECTOR_ERASE     0x5C
+#define CMD_4_BYTE_SECTOR_ERASE             0xDC
+#define CMD_BULK_ERASE                      0xC7
 #define CMD_ENTER_4_BYTE_ADDRESS_MODE       0xB7
 #define CMD_READ_STATUS_REGISTER            0x05
 #define CMD_4_BYTE_QUAD_INPUT_FAST_PROGRAM  0x34
+#define CMD_ERASE_SUSPEND                   0x75
+#define CMD_ERASE_RESUME                    0x7A
 
 /* Status register bits */
 #define WRITE_IN_PROGRESS       (0x01)
@@ -36,6 +41,17 @@
 /* Erase sizes and commands */
 #define ERASE_CMD               (CMD_4_BYTE_4KB_SUBSECTOR_ERASE)
 #define ERASE_SECTOR_SIZE       (4*1024)
+#define ERASE_32K_CMD           (CMD_4_BYTE_32KB_SUBSECTOR_ERASE)
+#define ERASE_32K_SIZE          (32*1024)
+#define ERASE_64K_CMD           (CMD_4_BYTE_SECTOR_ERASE)
+#define ERASE_64K_SIZE          (64*1024)
+#define CHIP_ERASE_CMD          (CMD_BULK_ERASE)
+#define CHIP_SIZE               (64*1024*1024)
+
+/* Memory-mapped read dummy bytes, including the mode byte */
+#ifndef MT25Q_XIP_DUMMY_BYTES
+#define MT25Q_XIP_DUMMY_BYTES  (1)
+#endif
 
 static int mt25q_init(const FLASH_INFO *fi)
 {
@@ -96,7 +112,7 @@ static int mt25q_write_disable(const FLASH_INFO *fi)
     return(result);
 }
 
-static int mt25q_wait_ready(const FLASH_INFO *fi)
+static int mt25q_busy(const FLASH_INFO *fi)
 {
     int result;
     SPI_SIMPLE_RESULT spiResult;
@@ -107,13 +123,23 @@ static int mt25q_wait_ready(const FLASH_INFO *fi)
     result = FLASH_OK;
 
     cmd[0] = CMD_READ_STATUS_REGISTER;
+    spiResult = spi_xfer(fi->flashHandle, 2, status, cmd);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        result = FLASH_ERROR;
+    } else if (status[1] & WRITE_IN_PROGRESS) {
+        result = FLASH_BUSY;
+    }
+
+    return(result);
+}
+
+static int mt25q_wait_ready(const FLASH_INFO *fi)
+{
+    int result;
+
     do {
-        spiResult = spi_xfer(fi->flashHandle, 2, status, cmd);
-        if (spiResult != SPI_SIMPLE_SUCCESS) {
-            result = FLASH_ERROR;
-            break;
-        }
-    } while (status[1] & WRITE_IN_PROGRESS);
+        result = mt25q_busy(fi);
+    } while (result == FLASH_BUSY);
 
     return(result);
 }
@@ -158,45 +184,158 @@ static int mt25q_read(const FLASH_INFO *fi, uint32_t addr, uint8_t *buf, int siz
     return(result);
 }
 
-static int mt25q_erase(const FLASH_INFO *fi, uint32_t addr, int size)
+/* Start erasing one aligned sector, block or the whole chip */
+static int mt25q_erase_start(const FLASH_INFO *fi, uint32_t addr, uint32_t size)
 {
     int result;
     SPI_SIMPLE_RESULT spiResult;
 
     uint8_t cmd[5];
+    int len = 5;
 
-    /* Align to the start of the ERASE_SECTOR_SIZE boundary */
-    addr -= addr % ERASE_SECTOR_SIZE;
-    size += addr % ERASE_SECTOR_SIZE;
+    if (size == ERASE_SECTOR_SIZE) {
+        cmd[0] = ERASE_CMD;
+    } else if (size == ERASE_32K_SIZE) {
+        cmd[0] = ERASE_32K_CMD;
+    } else if (size == ERASE_64K_SIZE) {
+        cmd[0] = ERASE_64K_CMD;
+    } else if (size == CHIP_SIZE) {
+        cmd[0] = CHIP_ERASE_CMD;
+        len = 1;
+    } else {
+        return(FLASH_ERROR);
+    }
+    cmd[1] = (addr >> 24) & 0xFF;
+    cmd[2] = (addr >> 16) & 0xFF;
+    cmd[3] = (addr >> 8) & 0xFF;
+    cmd[4] = (addr >> 0) & 0xFF;
 
-    result = FLASH_OK;
+    /* Set write enable */
+    result = mt25q_write_enable(fi);
+    if (result != FLASH_OK) {
+        return(result);
+    }
 
-    while (size > 0) {
+    /* Erase */
+    spiResult = spi_xfer(fi->flashHandle, len, NULL, cmd);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
 
-        /* Set write enable */
-        result = mt25q_write_enable(fi);
-        if (result != FLASH_OK) {
-            break;
-        }
+    return(FLASH_OK);
+}
 
-        /* Erase the sector */
-        cmd[0] = ERASE_CMD;
-        cmd[1] = (addr >> 24) & 0xFF;
-        cmd[2] = (addr >> 16) & 0xFF;
-        cmd[3] = (addr >> 8) & 0xFF;
-        cmd[4] = (addr >> 0) & 0xFF;
-        spiResult = spi_xfer(fi->flashHandle, 5, NULL, cmd);
-        if (spiResult != SPI_SIMPLE_SUCCESS) {
-            result = FLASH_ERROR;
-            break;
-        }
+static int mt25q_erase_unit(const FLASH_INFO *fi, uint32_t addr, uint32_t size)
+{
+    int result;
 
-        /* Poll for complete */
+    result = mt25q_erase_start(fi, addr, size);
+    if (result == FLASH_OK) {
         result = mt25q_wait_ready(fi);
+    }
+
+    return(result);
+}
+
+static int mt25q_erase_suspend(const FLASH_INFO *fi)
+{
+    int result;
+    SPI_SIMPLE_RESULT spiResult;
+
+    uint8_t tx[1];
+
+    /* Ready again once suspended (ignored if the erase has finished) */
+    tx[0] = CMD_ERASE_SUSPEND;
+    spiResult = spi_xfer(fi->flashHandle, 1, NULL, tx);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
+
+    result = mt25q_wait_ready(fi);
+
+    return(result);
+}
+
+static int mt25q_erase_resume(const FLASH_INFO *fi)
+{
+    int result;
+    SPI_SIMPLE_RESULT spiResult;
+
+    uint8_t tx[1];
+
+    result = FLASH_OK;
+
+    tx[0] = CMD_ERASE_RESUME;
+    spiResult = spi_xfer(fi->flashHandle, 1, NULL, tx);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        result = FLASH_ERROR;
+    }
+
+    return(result);
+}
+
+#ifdef SPI_SIMPLE_MM_SUPPORTED
+static int mt25q_xip_enable(const FLASH_INFO *fi,
+    const uint8_t **window, uint32_t *size)
+{
+    SPI_SIMPLE_RESULT spiResult;
+    uint32_t header;
+    const void *mm;
+
+    /* 4-BYTE QUAD OUTPUT FAST READ with 8 dummy cycles, as mt25q_read() */
+    header = SPI_SIMPLE_MM_READ_HEADER(CMD_4_BYTE_QUAD_OUTPUT_FAST_READ, 4, 0, 0xFF,
+        MT25Q_XIP_DUMMY_BYTES, 0);
+
+    spiResult = spi_enableMemoryMapped(fi->flashHandle, header, CHIP_SIZE,
+        SPI_SIMPLE_XFER_QUAD_IO, &mm);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
+
+    *window = (const uint8_t *)mm;
+    *size = CHIP_SIZE;
+
+    return(FLASH_OK);
+}
+
+static int mt25q_xip_disable(const FLASH_INFO *fi)
+{
+    SPI_SIMPLE_RESULT spiResult;
+
+    spiResult = spi_disableMemoryMapped(fi->flashHandle);
+
+    return((spiResult == SPI_SIMPLE_SUCCESS) ? FLASH_OK : FLASH_ERROR);
+}
+
+static int mt25q_xip_hold(const FLASH_INFO *fi, bool hold)
+{
+    SPI_SIMPLE_RESULT spiResult;
+
+    if (hold) {
+        spiResult = spi_holdMemoryMapped(fi->flashHandle);
+    } else {
+        spiResult = spi_releaseMemoryMapped(fi->flashHandle);
+    }
+
+    return((spiResult == SPI_SIMPLE_SUCCESS) ? FLASH_OK : FLASH_ERROR);
+}
+#endif
+
+static int mt25q_erase(const FLASH_INFO *fi, uint32_t addr, int size)
+{
+    int result;
+
+    /* Align to the start of the ERASE_SECTOR_SIZE boundary */
+    size += addr % ERASE_SECTOR_SIZE;
+    addr -= addr % ERASE_SECTOR_SIZE;
+
+    result = FLASH_OK;
+
+    while (size > 0) {
+        result = mt25q_erase_unit(fi, addr, ERASE_SECTOR_SIZE);
         if (result != FLASH_OK) {
             break;
         }
-
         addr += ERASE_SECTOR_SIZE;
         size -= ERASE_SECTOR_SIZE;
     }
@@ -204,22 +343,59 @@ static int mt25q_erase(const FLASH_INFO *fi, uint32_t addr, int size)
     return(result);
 }
 
-static int mt25q_program(const FLASH_INFO *fi,
+/* Start programming at most one page */
+static int mt25q_program_start(const FLASH_INFO *fi,
         uint32_t addr, const uint8_t *buf, int size)
 {
-    int psize;
-
     int result;
     SPI_SIMPLE_RESULT spiResult;
 
     sSPIXfer spiMultiXfer[2];
     uint8_t cmd[5];
 
-    result = FLASH_OK;
-
     /* Clear the SPI transfer struct */
     memset(&spiMultiXfer, 0, sizeof(spiMultiXfer));
 
+    /* Set write enable */
+    result = mt25q_write_enable(fi);
+    if (result != FLASH_OK) {
+        return(result);
+    }
+
+    /* Configure the 4_BYTE_QUAD_INPUT_FAST_PROGRAM command */
+    cmd[0] = CMD_4_BYTE_QUAD_INPUT_FAST_PROGRAM;
+    cmd[1] = (addr >> 24) & 0xFF;
+    cmd[2] = (addr >> 16) & 0xFF;
+    cmd[3] = (addr >> 8) & 0xFF;
+    cmd[4] = (addr >> 0) & 0xFF;
+
+    spiMultiXfer[0].tx = cmd;
+    spiMultiXfer[0].len = 5;
+    spiMultiXfer[0].flags = SPI_SIMPLE_XFER_NORMAL_IO;
+
+    /* Configure the data transfer */
+    spiMultiXfer[1].tx = (uint8_t *)buf;
+    spiMultiXfer[1].len = size;
+    spiMultiXfer[1].flags = SPI_SIMPLE_XFER_QUAD_IO;
+
+    /* Write the data */
+    spiResult = spi_batch_xfer(fi->flashHandle, 2, spiMultiXfer);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
+
+    return(FLASH_OK);
+}
+
+static int mt25q_program(const FLASH_INFO *fi,
+        uint32_t addr, const uint8_t *buf, int size)
+{
+    int psize;
+
+    int result;
+
+    result = FLASH_OK;
+
     while (size > 0) {
 
         /* Write at most up to the next page boundary */
@@ -228,35 +404,12 @@ static int mt25q_program(const FLASH_INFO *fi,
             psize = size;
         }
 
-        /* Set write enable */
-        result = mt25q_write_enable(fi);
+        /* Program the page */
+        result = mt25q_program_start(fi, addr, buf, psize);
         if (result != FLASH_OK) {
             break;
         }
 
-        /* Configure the 4_BYTE_QUAD_INPUT_FAST_PROGRAM command */
-        cmd[0] = CMD_4_BYTE_QUAD_INPUT_FAST_PROGRAM;
-        cmd[1] = (addr >> 24) & 0xFF;
-        cmd[2] = (addr >> 16) & 0xFF;
-        cmd[3] = (addr >> 8) & 0xFF;
-        cmd[4] = (addr >> 0) & 0xFF;
-
-        spiMultiXfer[0].tx = cmd;
-        spiMultiXfer[0].len = 5;
-        spiMultiXfer[0].flags = SPI_SIMPLE_XFER_NORMAL_IO;
-
-        /* Configure the data transfer */
-        spiMultiXfer[1].tx = (uint8_t *)buf;
-        spiMultiXfer[1].len = psize;
-        spiMultiXfer[1].flags = SPI_SIMPLE_XFER_QUAD_IO;
-
-        /* Write the data */
-        spiResult = spi_batch_xfer(fi->flashHandle, 2, spiMultiXfer);
-        if (spiResult != SPI_SIMPLE_SUCCESS) {
-            result = FLASH_ERROR;
-            break;
-        }
-
         /* Poll for complete */
         result = mt25q_wait_ready(fi);
         if (result != FLASH_OK) {
@@ -277,7 +430,20 @@ FLASH_INFO mt25q_info =
     .flashHandle = NULL,
     .flash_read = mt25q_read,
     .flash_erase = mt25q_erase,
-    .flash_program = mt25q_program
+    .flash_program = mt25q_program,
+    .eraseSizes = { ERASE_SECTOR_SIZE, ERASE_32K_SIZE, ERASE_64K_SIZE, CHIP_SIZE },
+    .flash_erase_unit = mt25q_erase_unit,
+    .pageSize = WRITE_PAGE_SIZE,
+    .flash_erase_start = mt25q_erase_start,
+    .flash_program_start = mt25q_program_start,
+    .flash_busy = mt25q_busy,
+    .flash_erase_suspend = mt25q_erase_suspend,
+    .flash_erase_resume = mt25q_erase_resume,
+#ifdef SPI_SIMPLE_MM_SUPPORTED
+    .flash_xip_enable = mt25q_xip_enable,
+    .flash_xip_disable = mt25q_xip_disable,
+    .flash_xip_hold = mt25q_xip_hold
+#endif
 };
 
 
@@ -13,6 +13,12 @@
  * @brief  Micron mt25ql512 specific driver for use with the Simple
  *         SPI device driver and generic flash interface driver.
  *
+ *         Memory-mapped (XIP) reads use the 4-byte quad output fast read (0x6C)
+ *         command with 8 dummy cycles, as mt25q_read() does.  The
+ *         command and dummy cycles are taken from the datasheet and
+ *         have NOT been verified on hardware.  MT25Q_XIP_DUMMY_BYTES
+ *         overrides the dummy bytes.
+ *
  * @file       mt25ql512.h
  * @version    1.0.0
  * @copyright  2019 Analog Devices, Inc.  All rights reserved.
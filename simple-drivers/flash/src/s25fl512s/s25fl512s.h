@@ -13,6 +13,12 @@
  * @brief  Cypress s25fl512s specific driver for use with the Simple
  *         SPI device driver and generic flash interface driver.
  *
+ *         Memory-mapped (XIP) reads use the 4-byte read quad out (0x6C)
+ *         command with 8 dummy cycles, as s25fl512s_read() does.  The
+ *         command and dummy cycles are taken from the datasheet and
+ *         have NOT been verified on hardware.  S25FL512S_XIP_DUMMY_BYTES
+ *         overrides the dummy bytes.
+ *
  * @file       s25fl512s.h
  * @version    1.0.0
  * @copyright  2020 Analog Devices, Inc.  All rights reserved.
@@ -30,7 +30,12 @@
 #define CMD_WRITE_STATUS_REGISTER_3       0x11
 #define CMD_FAST_READ_QUAD_OUTPUT         0x6b
 #define CMD_SECTOR_ERASE_4K               0x20
+#define CMD_BLOCK_ERASE_32K               0x52
+#define CMD_BLOCK_ERASE_64K               0xD8
+#define CMD_CHIP_ERASE                    0xC7
 #define CMD_QUAD_PAGE_PROGRAM             0x32
+#define CMD_ERASE_SUSPEND                 0x75
+#define CMD_ERASE_RESUME                  0x7A
 
 /* Status Register-1 bits */
 #define STATUS_REGISTER_1_BUSY            0x01
@@ -48,6 +53,17 @@
 /* Erase sizes and commands */
 #define ERASE_CMD                        (CMD_SECTOR_ERASE_4K)
 #define ERASE_SECTOR_SIZE                (4*1024)
+#define ERASE_32K_CMD                    (CMD_BLOCK_ERASE_32K)
+#define ERASE_32K_SIZE                   (32*1024)
+#define ERASE_64K_CMD                    (CMD_BLOCK_ERASE_64K)
+#define ERASE_64K_SIZE                   (64*1024)
+#define CHIP_ERASE_CMD                   (CMD_CHIP_ERASE)
+#define CHIP_SIZE                        (16*1024*1024)
+
+/* Memory-mapped read dummy bytes, including the mode byte */
+#ifndef W25Q128FV_XIP_DUMMY_BYTES
+#define W25Q128FV_XIP_DUMMY_BYTES  (1)
+#endif
 
 static int w25q128fv_write_cmd(const FLASH_INFO *fi, uint8_t cmd)
 {
@@ -157,19 +173,26 @@ static int w25q128fv_read_status(const FLASH_INFO *fi,
     return(result);
 }
 
-static int w25q128fv_wait_ready(const FLASH_INFO *fi)
+static int w25q128fv_busy(const FLASH_INFO *fi)
 {
     int result;
     uint8_t status;
 
-    result = FLASH_OK;
+    result = w25q128fv_read_status(fi, CMD_READ_STATUS_REGISTER_1, &status);
+    if ((result == FLASH_OK) && (status & STATUS_REGISTER_1_BUSY)) {
+        result = FLASH_BUSY;
+    }
+
+    return(result);
+}
+
+static int w25q128fv_wait_ready(const FLASH_INFO *fi)
+{
+    int result;
 
     do {
-        result = w25q128fv_read_status(fi, CMD_READ_STATUS_REGISTER_1, &status);
-        if (result != FLASH_OK) {
-            break;
-        }
-    } while (status & STATUS_REGISTER_1_BUSY);
+        result = w25q128fv_busy(fi);
+    } while (result == FLASH_BUSY);
 
     return(result);
 }
@@ -251,44 +274,157 @@ static int w25q128fv_read(const FLASH_INFO *fi, uint32_t addr, uint8_t *buf, int
     return(result);
 }
 
-static int w25q128fv_erase(const FLASH_INFO *fi, uint32_t addr, int size)
+/* Start erasing one aligned sector, block or the whole chip */
+static int w25q128fv_erase_start(const FLASH_INFO *fi, uint32_t addr, uint32_t size)
 {
     int result;
     SPI_SIMPLE_RESULT spiResult;
 
     uint8_t cmd[4];
+    int len = 4;
 
-    /* Align to the start of the ERASE_SECTOR_SIZE boundary */
-    addr -= addr % ERASE_SECTOR_SIZE;
-    size += addr % ERASE_SECTOR_SIZE;
+    if (size == ERASE_SECTOR_SIZE) {
+        cmd[0] = ERASE_CMD;
+    } else if (size == ERASE_32K_SIZE) {
+        cmd[0] = ERASE_32K_CMD;
+    } else if (size == ERASE_64K_SIZE) {
+        cmd[0] = ERASE_64K_CMD;
+    } else if (size == CHIP_SIZE) {
+        cmd[0] = CHIP_ERASE_CMD;
+        len = 1;
+    } else {
+        return(FLASH_ERROR);
+    }
+    cmd[1] = (addr >> 16) & 0xFF;
+    cmd[2] = (addr >> 8) & 0xFF;
+    cmd[3] = (addr >> 0) & 0xFF;
 
-    result = FLASH_OK;
+    /* Set write enable */
+    result = w25q128fv_write_enable(fi);
+    if (result != FLASH_OK) {
+        return(result);
+    }
 
-    while (size > 0) {
+    /* Erase */
+    spiResult = spi_xfer(fi->flashHandle, len, NULL, cmd);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
 
-        /* Set write enable */
-        result = w25q128fv_write_enable(fi);
-        if (result != FLASH_OK) {
-            break;
-        }
+    return(FLASH_OK);
+}
 
-        /* Erase the sector */
-        cmd[0] = ERASE_CMD;
-        cmd[1] = (addr >> 16) & 0xFF;
-        cmd[2] = (addr >> 8) & 0xFF;
-        cmd[3] = (addr >> 0) & 0xFF;
-        spiResult = spi_xfer(fi->flashHandle, 4, NULL, cmd);
-        if (spiResult != SPI_SIMPLE_SUCCESS) {
-            result = FLASH_ERROR;
-            break;
-        }
+static int w25q128fv_erase_unit(const FLASH_INFO *fi, uint32_t addr, uint32_t size)
+{
+    int result;
 
-        /* Poll for complete */
+    result = w25q128fv_erase_start(fi, addr, size);
+    if (result == FLASH_OK) {
         result = w25q128fv_wait_ready(fi);
+    }
+
+    return(result);
+}
+
+static int w25q128fv_erase_suspend(const FLASH_INFO *fi)
+{
+    int result;
+    SPI_SIMPLE_RESULT spiResult;
+
+    uint8_t tx[1];
+
+    /* Ready again once suspended (ignored if the erase has finished) */
+    tx[0] = CMD_ERASE_SUSPEND;
+    spiResult = spi_xfer(fi->flashHandle, 1, NULL, tx);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
+
+    result = w25q128fv_wait_ready(fi);
+
+    return(result);
+}
+
+static int w25q128fv_erase_resume(const FLASH_INFO *fi)
+{
+    int result;
+    SPI_SIMPLE_RESULT spiResult;
+
+    uint8_t tx[1];
+
+    result = FLASH_OK;
+
+    tx[0] = CMD_ERASE_RESUME;
+    spiResult = spi_xfer(fi->flashHandle, 1, NULL, tx);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        result = FLASH_ERROR;
+    }
+
+    return(result);
+}
+
+#ifdef SPI_SIMPLE_MM_SUPPORTED
+static int w25q128fv_xip_enable(const FLASH_INFO *fi,
+    const uint8_t **window, uint32_t *size)
+{
+    SPI_SIMPLE_RESULT spiResult;
+    uint32_t header;
+    const void *mm;
+
+    /* Fast Read Quad Output with 8 dummy cycles, as w25q128fv_read() */
+    header = SPI_SIMPLE_MM_READ_HEADER(CMD_FAST_READ_QUAD_OUTPUT, 3, 0, 0xFF,
+        W25Q128FV_XIP_DUMMY_BYTES, 0);
+
+    spiResult = spi_enableMemoryMapped(fi->flashHandle, header, CHIP_SIZE,
+        SPI_SIMPLE_XFER_QUAD_IO, &mm);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
+
+    *window = (const uint8_t *)mm;
+    *size = CHIP_SIZE;
+
+    return(FLASH_OK);
+}
+
+static int w25q128fv_xip_disable(const FLASH_INFO *fi)
+{
+    SPI_SIMPLE_RESULT spiResult;
+
+    spiResult = spi_disableMemoryMapped(fi->flashHandle);
+
+    return((spiResult == SPI_SIMPLE_SUCCESS) ? FLASH_OK : FLASH_ERROR);
+}
+
+static int w25q128fv_xip_hold(const FLASH_INFO *fi, bool hold)
+{
+    SPI_SIMPLE_RESULT spiResult;
+
+    if (hold) {
+        spiResult = spi_holdMemoryMapped(fi->flashHandle);
+    } else {
+        spiResult = spi_releaseMemoryMapped(fi->flashHandle);
+    }
+
+    return((spiResult == SPI_SIMPLE_SUCCESS) ? FLASH_OK : FLASH_ERROR);
+}
+#endif
+
+static int w25q128fv_erase(const FLASH_INFO *fi, uint32_t addr, int size)
+{
+    int result;
+
+    /* Align to the start of the ERASE_SECTOR_SIZE boundary */
+    size += addr % ERASE_SECTOR_SIZE;
+    addr -= addr % ERASE_SECTOR_SIZE;
+
+    result = FLASH_OK;
+
+    while (size > 0) {
+        result = w25q128fv_erase_unit(fi, addr, ERASE_SECTOR_SIZE);
         if (result != FLASH_OK) {
             break;
         }
-
         addr += ERASE_SECTOR_SIZE;
         size -= ERASE_SECTOR_SIZE;
     }
@@ -296,22 +432,58 @@ static int w25q128fv_erase(const FLASH_INFO *fi, uint32_t addr, int size)
     return(result);
 }
 
-static int w25q128fv_program(const FLASH_INFO *fi,
+/* Start programming at most one page */
+static int w25q128fv_program_start(const FLASH_INFO *fi,
         uint32_t addr, const uint8_t *buf, int size)
 {
-    int psize;
-
     int result;
     SPI_SIMPLE_RESULT spiResult;
 
     sSPIXfer spiMultiXfer[2];
     uint8_t cmd[4];
 
-    result = FLASH_OK;
-
     /* Clear the SPI transfer struct */
     memset(&spiMultiXfer, 0, sizeof(spiMultiXfer));
 
+    /* Set write enable */
+    result = w25q128fv_write_enable(fi);
+    if (result != FLASH_OK) {
+        return(result);
+    }
+
+    /* Configure the CMD_QUAD_PAGE_PROGRAM command */
+    cmd[0] = CMD_QUAD_PAGE_PROGRAM;
+    cmd[1] = (addr >> 16) & 0xFF;
+    cmd[2] = (addr >> 8) & 0xFF;
+    cmd[3] = (addr >> 0) & 0xFF;
+
+    spiMultiXfer[0].tx = cmd;
+    spiMultiXfer[0].len = 4;
+    spiMultiXfer[0].flags = SPI_SIMPLE_XFER_NORMAL_IO;
+
+    /* Configure the data transfer */
+    spiMultiXfer[1].tx = (uint8_t *)buf;
+    spiMultiXfer[1].len = size;
+    spiMultiXfer[1].flags = SPI_SIMPLE_XFER_QUAD_IO;
+
+    /* Write the data */
+    spiResult = spi_batch_xfer(fi->flashHandle, 2, spiMultiXfer);
+    if (spiResult != SPI_SIMPLE_SUCCESS) {
+        return(FLASH_ERROR);
+    }
+
+    return(FLASH_OK);
+}
+
+static int w25q128fv_program(const FLASH_INFO *fi,
+        uint32_t addr, const uint8_t *buf, int size)
+{
+    int psize;
+
+    int result;
+
+    result = FLASH_OK;
+
     while (size > 0) {
 
         /* Write at most up to the next page boundary */
@@ -320,34 +492,12 @@ static int w25q128fv_program(const FLASH_INFO *fi,
             psize = size;
         }
 
-        /* Set write enable */
-        result = w25q128fv_write_enable(fi);
+        /* Program the page */
+        result = w25q128fv_program_start(fi, addr, buf, psize);
         if (result != FLASH_OK) {
             break;
         }
 
-        /* Configure the CMD_QUAD_PAGE_PROGRAM command */
-        cmd[0] = CMD_QUAD_PAGE_PROGRAM;
-        cmd[1] = (addr >> 16) & 0xFF;
-        cmd[2] = (addr >> 8) & 0xFF;
-        cmd[3] = (addr >> 0) & 0xFF;
-
-        spiMultiXfer[0].tx = cmd;
-        spiMultiXfer[0].len = 4;
-        spiMultiXfer[0].flags = SPI_SIMPLE_XFER_NORMAL_IO;
-
-        /* Configure the data transfer */
-        spiMultiXfer[1].tx = (uint8_t *)buf;
-        spiMultiXfer[1].len = psize;
-        spiMultiXfer[1].flags = SPI_SIMPLE_XFER_QUAD_IO;
-
-        /* Write the data */
-        spiResult = spi_batch_xfer(fi->flashHandle, 2, spiMultiXfer);
-        if (spiResult != SPI_SIMPLE_SUCCESS) {
-            result = FLASH_ERROR;
-            break;
-        }
-
         /* Poll for complete */
         result = w25q128fv_wait_ready(fi);
         if (result != FLASH_OK) {
@@ -368,7 +518,20 @@ FLASH_INFO w25q128fv_info =
     .flashHandle = NULL,
     .flash_read = w25q128fv_read,
     .flash_erase = w25q128fv_erase,
-    .flash_program = w25q128fv_program
+    .flash_program = w25q128fv_program,
+    .eraseSizes = { ERASE_SECTOR_SIZE, ERASE_32K_SIZE, ERASE_64K_SIZE, CHIP_SIZE },
+    .flash_erase_unit = w25q128fv_erase_unit,
+    .pageSize = WRITE_PAGE_SIZE,
+    .flash_erase_start = w25q128fv_erase_start,
+    .flash_program_start = w25q128fv_program_start,
+    .flash_busy = w25q128fv_busy,
+    .flash_erase_suspend = w25q128fv_erase_suspend,
+    .flash_erase_resume = w25q128fv_erase_resume,
+#ifdef SPI_SIMPLE_MM_SUPPORTED
+    .flash_xip_enable = w25q128fv_xip_enable,
+    .flash_xip_disable = w25q128fv_xip_disable,
+    .flash_xip_hold = w25q128fv_xip_hold
+#endif
 };
 
 
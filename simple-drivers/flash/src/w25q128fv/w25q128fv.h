@@ -13,6 +13,12 @@
  * @brief  Winbond w25q128fv specific driver for use with the Simple
  *         SPI device driver and generic flash interface driver.
  *
+ *         Memory-mapped (XIP) reads use the fast read quad output (0x6B)
+ *         command with 8 dummy cycles, as w25q128fv_read() does.  The
+ *         command and dummy cycles are taken from the datasheet and
+ *         have NOT been verified on hardware.  W25Q128FV_XIP_DUMMY_BYTES
+ *         overrides the dummy bytes.
+ *
  * @file       w25q128fv.h
  * @version    1.0.0
  * @copyright  2019 Analog Devices, Inc.  All rights reserved.
@@ -35,6 +35,37 @@
     #define MSD_UNLOCK()
 #endif
 
+/* Read-ahead window limits in sectors (0 disables read-ahead).  The
+ * window starts at the minimum and doubles on each sequential hit.
+ * Two buffers of the maximum window size are used so the next READ(10)
+ * is in flight while the previous window is consumed.
+ */
+#ifndef MSD_READ_AHEAD_MAX_SECTORS
+#define MSD_READ_AHEAD_MAX_SECTORS  64
+#endif
+
+#ifndef MSD_READ_AHEAD_MIN_SECTORS
+#define MSD_READ_AHEAD_MIN_SECTORS  8
+#endif
+
+/* Sequential write coalescing buffer in sectors (0 disables) */
+#ifndef MSD_WRITE_COALESCE_SECTORS
+#define MSD_WRITE_COALESCE_SECTORS  64
+#endif
+
+typedef enum _MSD_RA_STATE {
+    MSD_RA_EMPTY = 0,
+    MSD_RA_IN_FLIGHT,
+    MSD_RA_VALID
+} MSD_RA_STATE;
+
+typedef struct _MSD_READ_AHEAD {
+    uint8_t data[MSD_READ_AHEAD_MAX_SECTORS * 512] __attribute__((aligned(64)));
+    uint64_t sector;
+    uint32_t count;
+    MSD_RA_STATE state;
+} MSD_READ_AHEAD;
+
 struct sMSD {
 
     bool open;
@@ -47,14 +78,33 @@ struct sMSD {
 #endif
 
     volatile bool rwOK;
+    bool busy;
 
     uint64_t capacity;
+
+#if MSD_READ_AHEAD_MAX_SECTORS > 0
+    MSD_READ_AHEAD ra[2];
+    uint32_t raWindow;
+    uint64_t nextSector;
+#endif
+
+#if MSD_WRITE_COALESCE_SECTORS > 0
+    uint8_t wrData[MSD_WRITE_COALESCE_SECTORS * 512] __attribute__((aligned(64)));
+    uint64_t wrSector;
+    uint32_t wrCount;
+    bool wrError;
+#endif
 };
 
 
 /* MSD port context containers */
 static sMSD msdContext[MSD_END];
 
+static void msd_reset(sMSD *msd);
+#if MSD_WRITE_COALESCE_SECTORS > 0
+static MSD_SIMPLE_RESULT msd_writeFlush(sMSD *msd);
+#endif
+
 static void
 msd_flushDataCache(uint8_t *pBuffer, uint32_t bufferSize, int invalidate)
 {
@@ -86,6 +136,7 @@ MSD_SIMPLE_RESULT msd_init(void)
 #endif
 
         msd->open = false;
+        msd_reset(msd);
 
     }
 
@@ -200,31 +251,307 @@ static void msdCB(bool success, void *usr)
 }
 
 /***********************************************************************
- * Write
+ * Command issue / completion
  ***********************************************************************/
-MSD_SIMPLE_RESULT msd_write(sMSD *msd, void *data, uint64_t sector, uint32_t count)
+static bool msd_issue(sMSD *msd, bool read, void *data,
+    uint64_t sector, uint32_t count)
 {
-    MSD_SIMPLE_RESULT result = MSD_SIMPLE_SUCCESS;
     CLD_RV cldResult;
-#ifdef FREE_RTOS
-    BaseType_t rtosResult;
-#endif
 
-    MSD_LOCK();
-    if (count > 1) {
-        asm("nop;");
-    }
     msd_flushDataCache(data, 512u * count, false);
 #ifndef FREE_RTOS
     msd->msdDone = false;
 #endif
-    cldResult = msd_host_write(data, sector, count, msdCB, msd);
+    if (read) {
+        cldResult = msd_host_read(data, sector, count, msdCB, msd);
+    } else {
+        cldResult = msd_host_write(data, sector, count, msdCB, msd);
+    }
+    if (cldResult == CLD_FAIL) {
+        return(false);
+    }
+    msd->busy = true;
+
+    return(true);
+}
+
+static bool msd_wait(sMSD *msd)
+{
+#ifdef FREE_RTOS
+    BaseType_t rtosResult;
+#endif
+
+    if (!msd->busy) {
+        return(true);
+    }
 #ifdef FREE_RTOS
     rtosResult = xSemaphoreTake(msd->portBlock, portMAX_DELAY);
 #else
     while (msd->msdDone == false);
 #endif
-    result = msd->rwOK ? MSD_SIMPLE_SUCCESS : MSD_SIMPLE_ERROR;
+    msd->busy = false;
+
+    return(msd->rwOK);
+}
+
+static MSD_SIMPLE_RESULT msd_transfer(sMSD *msd, bool read, void *data,
+    uint64_t sector, uint32_t count)
+{
+    bool ok;
+
+    ok = msd_issue(msd, read, data, sector, count);
+    if (ok) {
+        ok = msd_wait(msd);
+    }
+    if (read) {
+        msd_flushDataCache(data, 512u * count, true);
+    }
+
+    return(ok ? MSD_SIMPLE_SUCCESS : MSD_SIMPLE_ERROR);
+}
+
+#if MSD_READ_AHEAD_MAX_SECTORS > 0
+
+/***********************************************************************
+ * Read-ahead
+ ***********************************************************************/
+static bool msd_raOverlaps(MSD_READ_AHEAD *ra, uint64_t sector, uint32_t count)
+{
+    return((ra->state != MSD_RA_EMPTY) &&
+        (sector < ra->sector + ra->count) && (ra->sector < sector + count));
+}
+
+static bool msd_raContains(MSD_READ_AHEAD *ra, uint64_t sector, uint32_t count)
+{
+    return((ra->state != MSD_RA_EMPTY) &&
+        (sector >= ra->sector) && (sector + count <= ra->sector + ra->count));
+}
+
+/* Completes the read-ahead in flight, if any */
+static void msd_raComplete(sMSD *msd)
+{
+    MSD_READ_AHEAD *ra;
+    unsigned i;
+
+    for (i = 0; i < 2; i++) {
+        ra = &msd->ra[i];
+        if (ra->state == MSD_RA_IN_FLIGHT) {
+            if (msd_wait(msd)) {
+                msd_flushDataCache(ra->data, 512u * ra->count, true);
+                ra->state = MSD_RA_VALID;
+            } else {
+                ra->state = MSD_RA_EMPTY;
+            }
+        }
+    }
+}
+
+/* Drops read-ahead data overlapping a range about to be written */
+static void msd_raInvalidate(sMSD *msd, uint64_t sector, uint32_t count)
+{
+    unsigned i;
+
+    msd_raComplete(msd);
+    for (i = 0; i < 2; i++) {
+        if (msd_raOverlaps(&msd->ra[i], sector, count)) {
+            msd->ra[i].state = MSD_RA_EMPTY;
+        }
+    }
+}
+
+/* Starts reading the next window into buffer 'i' */
+static void msd_raStart(sMSD *msd, unsigned i, uint64_t sector)
+{
+    MSD_READ_AHEAD *ra = &msd->ra[i];
+    uint32_t count;
+
+    count = msd->raWindow;
+    if (msd->capacity && (sector + count > msd->capacity / 512)) {
+        if (sector >= msd->capacity / 512) {
+            return;
+        }
+        count = (uint32_t)(msd->capacity / 512 - sector);
+    }
+
+#if MSD_WRITE_COALESCE_SECTORS > 0
+    /* Never read sectors still waiting in the coalescing buffer.  Stop
+     * the window short of them or write them back first.
+     */
+    if ((msd->wrCount > 0) &&
+        (sector < msd->wrSector + msd->wrCount) &&
+        (msd->wrSector < sector + count)) {
+        if (msd->wrSector > sector) {
+            count = (uint32_t)(msd->wrSector - sector);
+        } else if (msd_writeFlush(msd) != MSD_SIMPLE_SUCCESS) {
+            msd->wrError = true;
+        }
+    }
+#endif
+
+    ra->sector = sector;
+    ra->count = count;
+    if (msd_issue(msd, true, ra->data, sector, count)) {
+        ra->state = MSD_RA_IN_FLIGHT;
+    } else {
+        ra->state = MSD_RA_EMPTY;
+    }
+}
+
+static MSD_SIMPLE_RESULT msd_readAhead(sMSD *msd, uint8_t *data,
+    uint64_t sector, uint32_t count)
+{
+    MSD_READ_AHEAD *ra;
+    bool sequential;
+    uint32_t n;
+    unsigned i;
+
+    sequential = (sector == msd->nextSector);
+    msd->nextSector = sector + count;
+
+    /* Random access shrinks the window and bypasses the buffers */
+    if (!sequential) {
+        msd->raWindow = MSD_READ_AHEAD_MIN_SECTORS;
+        if (count >= MSD_READ_AHEAD_MIN_SECTORS) {
+            msd_raComplete(msd);
+            return(msd_transfer(msd, true, data, sector, count));
+        }
+    }
+
+    while (count) {
+
+        /* Find the buffer holding 'sector', waiting for it if in flight */
+        for (i = 0; i < 2; i++) {
+            if (msd_raContains(&msd->ra[i], sector, 1)) {
+                break;
+            }
+        }
+        if (i < 2) {
+            msd_raComplete(msd);
+        }
+        if ((i == 2) || (msd->ra[i].state != MSD_RA_VALID)) {
+            /* Miss, read a window synchronously into the free buffer */
+            msd_raComplete(msd);
+            i = (msd->ra[0].state == MSD_RA_VALID) &&
+                (msd->ra[0].sector + msd->ra[0].count == sector) ? 1 : 0;
+            msd_raStart(msd, i, sector);
+            msd_raComplete(msd);
+            if (!msd_raContains(&msd->ra[i], sector, 1) ||
+                (msd->ra[i].state != MSD_RA_VALID)) {
+                /* The window may run past the end of the media */
+                return(msd_transfer(msd, true, data, sector, count));
+            }
+        } else if (sequential && (msd->raWindow < MSD_READ_AHEAD_MAX_SECTORS)) {
+            /* Sequential hit, grow the window */
+            msd->raWindow *= 2;
+            if (msd->raWindow > MSD_READ_AHEAD_MAX_SECTORS) {
+                msd->raWindow = MSD_READ_AHEAD_MAX_SECTORS;
+            }
+        }
+        ra = &msd->ra[i];
+
+        /* Keep the next window in flight while this one is consumed */
+        if (sequential && !msd->busy &&
+            !msd_raContains(&msd->ra[i ^ 1], ra->sector + ra->count, 1)) {
+            msd_raStart(msd, i ^ 1, ra->sector + ra->count);
+        }
+
+        n = (uint32_t)(ra->sector + ra->count - sector);
+        if (n > count) {
+            n = count;
+        }
+        memcpy(data, ra->data + (sector - ra->sector) * 512u, n * 512u);
+
+        data += n * 512u; sector += n; count -= n;
+    }
+
+    return(MSD_SIMPLE_SUCCESS);
+}
+
+#endif
+
+#if MSD_WRITE_COALESCE_SECTORS > 0
+
+/***********************************************************************
+ * Write coalescing
+ ***********************************************************************/
+static MSD_SIMPLE_RESULT msd_writeFlush(sMSD *msd)
+{
+    MSD_SIMPLE_RESULT result;
+
+    if (msd->wrCount == 0) {
+        result = msd->wrError ? MSD_SIMPLE_ERROR : MSD_SIMPLE_SUCCESS;
+        msd->wrError = false;
+        return(result);
+    }
+
+#if MSD_READ_AHEAD_MAX_SECTORS > 0
+    msd_raComplete(msd);
+#endif
+    result = msd_transfer(msd, false, msd->wrData, msd->wrSector, msd->wrCount);
+#if MSD_READ_AHEAD_MAX_SECTORS > 0
+    msd_raInvalidate(msd, msd->wrSector, msd->wrCount);
+#endif
+    msd->wrCount = 0;
+    if (msd->wrError) {
+        result = MSD_SIMPLE_ERROR;
+        msd->wrError = false;
+    }
+
+    return(result);
+}
+
+static bool msd_writeOverlaps(sMSD *msd, uint64_t sector, uint32_t count)
+{
+    return((msd->wrCount > 0) &&
+        (sector < msd->wrSector + msd->wrCount) &&
+        (msd->wrSector < sector + count));
+}
+
+#endif
+
+/***********************************************************************
+ * Write
+ ***********************************************************************/
+MSD_SIMPLE_RESULT msd_write(sMSD *msd, void *data, uint64_t sector, uint32_t count)
+{
+    MSD_SIMPLE_RESULT result = MSD_SIMPLE_SUCCESS;
+
+    MSD_LOCK();
+
+#if MSD_READ_AHEAD_MAX_SECTORS > 0
+    msd_raInvalidate(msd, sector, count);
+    msd->nextSector = UINT64_MAX;
+#endif
+
+#if MSD_WRITE_COALESCE_SECTORS > 0
+    /* Append sequential small writes to the coalescing buffer */
+    if ((msd->wrCount > 0) &&
+        (sector == msd->wrSector + msd->wrCount) &&
+        (msd->wrCount + count <= MSD_WRITE_COALESCE_SECTORS)) {
+        memcpy(msd->wrData + msd->wrCount * 512u, data, count * 512u);
+        msd->wrCount += count;
+    } else {
+        if (msd_writeFlush(msd) != MSD_SIMPLE_SUCCESS) {
+            msd->wrError = true;
+        }
+        if (count < MSD_WRITE_COALESCE_SECTORS) {
+            memcpy(msd->wrData, data, count * 512u);
+            msd->wrSector = sector;
+            msd->wrCount = count;
+        } else {
+            result = msd_transfer(msd, false, data, sector, count);
+        }
+    }
+
+    /* Report deferred write errors on the next write */
+    if (msd->wrError) {
+        msd->wrError = false;
+        result = MSD_SIMPLE_ERROR;
+    }
+#else
+    result = msd_transfer(msd, false, data, sector, count);
+#endif
+
     MSD_UNLOCK();
 
     return(result);
@@ -236,32 +563,65 @@ MSD_SIMPLE_RESULT msd_write(sMSD *msd, void *data, uint64_t sector, uint32_t cou
 MSD_SIMPLE_RESULT msd_read(sMSD *msd, void *data, uint64_t sector, uint32_t count)
 {
     MSD_SIMPLE_RESULT result = MSD_SIMPLE_SUCCESS;
-    CLD_RV cldResult;
-#ifdef FREE_RTOS
-    BaseType_t rtosResult;
-#endif
 
     MSD_LOCK();
-    if (count > 1) {
-        asm("nop;");
+
+#if MSD_WRITE_COALESCE_SECTORS > 0
+    if (msd_writeOverlaps(msd, sector, count)) {
+        if (msd_writeFlush(msd) != MSD_SIMPLE_SUCCESS) {
+            msd->wrError = true;
+        }
     }
-    msd_flushDataCache(data, 512u * count, false);
-#ifndef FREE_RTOS
-    msd->msdDone = false;
 #endif
-    cldResult = msd_host_read(data, sector, count, msdCB, msd);
-#ifdef FREE_RTOS
-    rtosResult = xSemaphoreTake(msd->portBlock, portMAX_DELAY);
+
+#if MSD_READ_AHEAD_MAX_SECTORS > 0
+    result = msd_readAhead(msd, data, sector, count);
 #else
-    while (msd->msdDone == false);
+    result = msd_transfer(msd, true, data, sector, count);
 #endif
-    msd_flushDataCache(data, 512u * count, true);
-    result = msd->rwOK ? MSD_SIMPLE_SUCCESS : MSD_SIMPLE_ERROR;
+
     MSD_UNLOCK();
 
     return(result);
 }
 
+/***********************************************************************
+ * Flush
+ ***********************************************************************/
+MSD_SIMPLE_RESULT msd_flush(sMSD *msd)
+{
+    MSD_SIMPLE_RESULT result = MSD_SIMPLE_SUCCESS;
+
+    if (msd == NULL) {
+        return(MSD_SIMPLE_ERROR);
+    }
+
+    MSD_LOCK();
+#if MSD_WRITE_COALESCE_SECTORS > 0
+    result = msd_writeFlush(msd);
+#endif
+#if MSD_READ_AHEAD_MAX_SECTORS > 0
+    msd_raComplete(msd);
+#endif
+    MSD_UNLOCK();
+
+    return(result);
+}
+
+/***********************************************************************
+ * Discards read-ahead data (i.e. on device change)
+ ***********************************************************************/
+static void msd_reset(sMSD *msd)
+{
+#if MSD_READ_AHEAD_MAX_SECTORS > 0
+    msd_raComplete(msd);
+    msd->ra[0].state = MSD_RA_EMPTY;
+    msd->ra[1].state = MSD_RA_EMPTY;
+    msd->raWindow = MSD_READ_AHEAD_MIN_SECTORS;
+    msd->nextSector = UINT64_MAX;
+#endif
+}
+
 /***********************************************************************
  * Info Function
  ***********************************************************************/
@@ -277,6 +637,8 @@ MSD_SIMPLE_RESULT msd_info(sMSD *msd, MSD_SIMPLE_INFO *info)
 
     MSD_LOCK();
     ok = msd_host_info(&hostInfo);
+    msd->capacity = ok ? hostInfo.capacity : 0;
+    msd_reset(msd);
     if (info) {
         if (ok) {
             info->capacity = hostInfo.capacity;
@@ -144,6 +144,11 @@ MSD_SIMPLE_RESULT msd_info(sMSD *msdHandle, MSD_SIMPLE_INFO *info);
 MSD_SIMPLE_RESULT msd_write(sMSD *msd, void *data, uint64_t sector, uint32_t count);
 MSD_SIMPLE_RESULT msd_read(sMSD *msd, void *data, uint64_t sector, uint32_t count);
 
+/* Writes any coalesced write data to the device.  Write errors are
+ * reported by this function or the next msd_write().
+ */
+MSD_SIMPLE_RESULT msd_flush(sMSD *msd);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -22,6 +22,8 @@
  *  - Standard, Dual, or Quad I/O device transfers
  *  - Multiple transfers within a single atomic slave select
  *  - Blocking transfers
+ *  - Queued non-blocking transfers chained from the interrupt
+ *  - Memory-mapped flash reads (SPI2)
  *
  */
 
@@ -42,6 +44,13 @@
     #include "task.h"
     #define SPI_ENTER_CRITICAL()  taskENTER_CRITICAL()
     #define SPI_EXIT_CRITICAL()   taskEXIT_CRITICAL()
+#elif defined (__ADSPARM__)
+    #define SPI_ENTER_CRITICAL()  __builtin_disable_interrupts()
+    #define SPI_EXIT_CRITICAL()   __builtin_enable_interrupts()
+#elif defined(__ADSP21000__)
+    #include "interrupt.h"
+    #define SPI_ENTER_CRITICAL()  adi_rtl_disable_interrupts()
+    #define SPI_EXIT_CRITICAL()   adi_rtl_reenable_interrupts()
 #else
     #define SPI_ENTER_CRITICAL()
     #define SPI_EXIT_CRITICAL()
@@ -51,6 +60,10 @@
 
 #define SPI_SLVSEL_DEFAULT (0x0000FE00u)
 
+/* SPI2 memory-mapped read window */
+#define SPI_MM_BASE_ADDR   (0x60000000u)
+#define SPI_MM_MAX_SIZE    (0x10000000u)
+
 /* SHARC L1 Slave 1 port addresses and offsets */
 #if !defined(__ADSPARM__)
     #define SHARC_L1_ADDR_START   0x00240000u
@@ -76,6 +89,8 @@ struct sSPI {
     volatile uint32_t * pREG_SPI_IMSK_CLR;
     volatile uint32_t * pREG_SPI_IMSK_SET;
     volatile uint32_t * pREG_SPI_ILAT_CLR;
+    volatile uint32_t * pREG_SPI_MMRDH;
+    volatile uint32_t * pREG_SPI_MMTOP;
 
 
     volatile const uint32_t * pREG_SPI_RFIFO;
@@ -115,6 +130,20 @@ struct sSPI {
     ///< Reference to the active device
     sSPIPeriph *device;
 
+    ///< Running batch and batches waiting, highest priority first
+    sSPIBatch *active;
+    sSPIBatch *queue;
+    volatile bool inIsr;
+
+    ///< Memory-mapped mode, restored whenever the queue is idle
+    sSPIPeriph *mmDevice;
+    uint32_t mmReadHeader;
+    uint32_t mmSize;
+    uint32_t mmFlags;
+    bool mmActive;
+    ///< Window accesses in progress, queued transfers wait for them
+    volatile uint32_t mmHold;
+
 #ifdef FREE_RTOS
     SemaphoreHandle_t portLock;
     SemaphoreHandle_t portBlock;
@@ -572,6 +601,10 @@ SPI_SIMPLE_RESULT spi_init(void)
             spi->pREG_SPI_IMSK_CLR = pREG_SPI2_IMSK_CLR;
             spi->pREG_SPI_IMSK_SET = pREG_SPI2_IMSK_SET;
             spi->pREG_SPI_ILAT_CLR = pREG_SPI2_ILAT_CLR;
+#ifdef SPI_SIMPLE_MM_SUPPORTED
+            spi->pREG_SPI_MMRDH    = pREG_SPI2_MMRDH;
+            spi->pREG_SPI_MMTOP    = pREG_SPI2_MMTOP;
+#endif
 
             spi->SPI_STAT_IRQ_ID   = INTR_SPI2_STAT;
 
@@ -769,6 +802,14 @@ SPI_SIMPLE_RESULT spi_close(sSPI **spiHandle)
         return (SPI_SIMPLE_ERROR);
     }
 
+    /* Queued transfers must finish first */
+    if (spi->active != NULL) {
+        return (SPI_SIMPLE_PORT_BUSY);
+    }
+    spi->mmDevice = NULL;
+    spi->mmActive = false;
+    spi->mmHold = 0;
+
 #ifdef FREE_RTOS
     rtosResult = xSemaphoreTake(spi->portLock, portMAX_DELAY);
     if (rtosResult != pdTRUE) {
@@ -947,17 +988,123 @@ static void spi_setup_port_device(sSPIPeriph *deviceHandle, uint16_t len, void *
     *spi->pREG_SPI_CTL = reg | ENUM_SPI_CTL_EN;
 }
 
+/* Switch the port into memory-mapped mode */
+static void spi_mm_enter(sSPI *spi)
+{
+#ifdef SPI_SIMPLE_MM_SUPPORTED
+    sSPIPeriph *device = spi->mmDevice;
+    uint32_t reg;
+
+    *spi->pREG_SPI_CTL = 0x00000000u;
+    *spi->pREG_SPI_CLK = device->SPI_CLK;
+    *spi->pREG_SPI_SLVSEL = device->SPI_SLVSEL_DEASSERT;
+    *spi->pREG_SPI_IMSK_CLR = (ENUM_SPI_IMSK_RF_HI | ENUM_SPI_IMSK_TF_HI);
+    *spi->pREG_SPI_TXCTL = (BITM_SPI_TXCTL_TTI | BITM_SPI_TXCTL_TEN);
+    *spi->pREG_SPI_RXCTL = BITM_SPI_RXCTL_REN;
+    *spi->pREG_SPI_MMRDH = spi->mmReadHeader;
+    *spi->pREG_SPI_MMTOP = SPI_MM_BASE_ADDR + spi->mmSize;
+
+    /* 32-bit words, hardware slave select, device clock mode and IO */
+    reg = device->SPI_CTL & ~BITM_SPI_CTL_SIZE;
+    reg |= ENUM_SPI_CTL_MM_EN | ENUM_SPI_CTL_MASTER | ENUM_SPI_CTL_SIZE32 |
+        ENUM_SPI_CTL_HW_SSEL | ENUM_SPI_CTL_ASSRT_SSEL;
+    spi_apply_flags(&reg, spi->mmFlags);
+    *spi->pREG_SPI_CTL = reg;
+    *spi->pREG_SPI_CTL = reg | ENUM_SPI_CTL_EN;
+
+    spi->mmActive = true;
+#endif
+}
+
+/* Leave memory-mapped mode for normal transfers */
+static void spi_mm_leave(sSPI *spi)
+{
+    *spi->pREG_SPI_CTL = 0x00000000u;
+#ifdef SPI_SIMPLE_MM_SUPPORTED
+    *spi->pREG_SPI_MMRDH = 0x00000000u;
+#endif
+    *spi->pREG_SPI_TXCTL = 0x00000000u;
+    *spi->pREG_SPI_RXCTL = 0x00000000u;
+    *spi->pREG_SPI_SLVSEL = SPI_SLVSEL_DEFAULT;
+
+    spi->mmActive = false;
+}
+
+/* Start the first transfer of a batch */
+static void spi_start_batch(sSPI *spi, sSPIBatch *batch)
+{
+    sSPIPeriph *device = batch->device;
+    void *rx;
+    void *tx;
+    uint16_t len;
+
+    if (spi->mmActive) {
+        spi_mm_leave(spi);
+    }
+
+    /* Store a reference to the current active device */
+    spi->device = device;
+
+    /* Indicate to the ISR now many xfers remain */
+    spi->xfers = batch->xfers;
+    spi->xferIndex = 0;
+    spi->xferCount = batch->numXfers - 1;
+
+    /* Set some convenience variables */
+    len = spi->xfers[spi->xferIndex].len;
+    rx = spi->xfers[spi->xferIndex].rx;
+    tx = spi->xfers[spi->xferIndex].tx;
+
+    /* Setup the device specific SPI settings, IO mode, and enable to assert outputs */
+    spi_setup_port_device(device, len, rx, tx, spi->xfers[spi->xferIndex].flags);
+
+    /* Configure the DMA */
+    spi_setup_dma(spi, len, rx, tx);
+
+    /* Assert the device slave select */
+    if (device->ssCallBack != NULL) {
+        device->ssCallBack(true, device->ssCallBackUsrPtr);
+    } else {
+        *spi->pREG_SPI_SLVSEL = device->SPI_SLVSEL_ASSERT;
+#if defined WA_20000062 && WA_20000062
+        /* Must write twice for some devices */
+        *spi->pREG_SPI_SLVSEL = device->SPI_SLVSEL_ASSERT;
+#endif
+    }
+
+    /* Configure the Rx/Tx ctl and count registers to initiate transfer */
+    spi_setup_port_rxtx(spi, len, rx, tx);
+}
+
+/* Release the slave select and port after the last transfer of a batch */
+static void spi_end_batch(sSPI *spi)
+{
+    sSPIPeriph *device = spi->device;
+
+    /* Deassert chip select (must write twice for some devices) */
+    if (device->ssCallBack != NULL) {
+        device->ssCallBack(false, device->ssCallBackUsrPtr);
+    } else {
+        *spi->pREG_SPI_SLVSEL = device->SPI_SLVSEL_DEASSERT;
+#if defined WA_20000062 && WA_20000062
+        /* Must write twice for some devices */
+        *spi->pREG_SPI_SLVSEL = device->SPI_SLVSEL_DEASSERT;
+#endif
+    }
+
+    /* Disable the SPI port */
+    *spi->pREG_SPI_CTL &= ~ENUM_SPI_CTL_EN;
+}
+
 static void spi_stat_irq(uint32_t id, void *usrPtr)
 {
     sSPI *spi = (sSPI *)usrPtr;
+    sSPIBatch *done;
+    sSPIBatch *next;
     void *rx;
     void *tx;
     uint16_t len;
     uint32_t flags;
-#ifdef FREE_RTOS
-    BaseType_t rtosResult;
-    BaseType_t contextSwitch = pdFALSE;
-#endif
     uint8_t *flushStart, *flushEnd;
 
     *spi->pREG_SPI_STAT = *spi->pREG_SPI_STAT;
@@ -971,12 +1118,29 @@ static void spi_stat_irq(uint32_t id, void *usrPtr)
     }
 
     if (spi->xferCount == 0) {
-#ifdef FREE_RTOS
-        rtosResult = xSemaphoreGiveFromISR(spi->portBlock, &contextSwitch);
-        portYIELD_FROM_ISR(contextSwitch);
-#else
-        spi->spiDone = true;
-#endif
+
+        /* Finish this batch and chain straight into the next one */
+        done = spi->active;
+        spi_end_batch(spi);
+
+        next = spi->queue;
+        if (next != NULL) {
+            spi->queue = next->next;
+        }
+        spi->active = next;
+        if (next != NULL) {
+            spi_start_batch(spi, next);
+        } else if (spi->mmDevice != NULL) {
+            spi_mm_enter(spi);
+        }
+
+        /* Call-backs may queue more batches */
+        if (done->cb != NULL) {
+            spi->inIsr = true;
+            done->cb(done, done->usrPtr);
+            spi->inIsr = false;
+        }
+
     } else {
         /* Modify the xfer counts */
         spi->xferIndex++;
@@ -999,6 +1163,67 @@ static void spi_stat_irq(uint32_t id, void *usrPtr)
     }
 }
 
+SPI_SIMPLE_RESULT spi_submit(sSPIBatch *batch)
+{
+    sSPI *spi;
+    sSPIBatch **pos;
+    sSPIBatch *start = NULL;
+    bool inIsr;
+
+    if ((batch == NULL) || (batch->device == NULL) ||
+        (batch->xfers == NULL) || (batch->numXfers == 0)) {
+        return(SPI_SIMPLE_ERROR);
+    }
+
+    spi = batch->device->spiHandle;
+    batch->next = NULL;
+
+    /* The SPI interrupt already excludes tasks while in a call-back */
+    inIsr = spi->inIsr;
+    if (!inIsr) {
+        SPI_ENTER_CRITICAL();
+    }
+
+    /* Insert behind all batches of the same or a higher priority */
+    pos = &spi->queue;
+    while ((*pos != NULL) && ((*pos)->priority >= batch->priority)) {
+        pos = &(*pos)->next;
+    }
+    batch->next = *pos;
+    *pos = batch;
+
+    /* Start the port if it is idle and the window is not being read */
+    if ((spi->active == NULL) && (spi->mmHold == 0)) {
+        start = spi->queue;
+        spi->queue = start->next;
+        spi->active = start;
+    }
+
+    if (!inIsr) {
+        SPI_EXIT_CRITICAL();
+    }
+
+    /* The port interrupt cannot fire until the batch is started */
+    if (start != NULL) {
+        spi_start_batch(spi, start);
+    }
+
+    return(SPI_SIMPLE_SUCCESS);
+}
+
+static void spi_batch_xfer_done(sSPIBatch *batch, void *usrPtr)
+{
+    sSPI *spi = (sSPI *)usrPtr;
+#ifdef FREE_RTOS
+    BaseType_t contextSwitch = pdFALSE;
+
+    xSemaphoreGiveFromISR(spi->portBlock, &contextSwitch);
+    portYIELD_FROM_ISR(contextSwitch);
+#else
+    spi->spiDone = true;
+#endif
+}
+
 SPI_SIMPLE_RESULT spi_batch_xfer(sSPIPeriph *deviceHandle, uint16_t numXfers, sSPIXfer *xfers)
 {
     SPI_SIMPLE_RESULT result = SPI_SIMPLE_SUCCESS;
@@ -1007,15 +1232,13 @@ SPI_SIMPLE_RESULT spi_batch_xfer(sSPIPeriph *deviceHandle, uint16_t numXfers, sS
 #ifdef FREE_RTOS
     BaseType_t rtosResult;
 #endif
-    void *rx;
-    void *tx;
-    uint16_t len;
+    sSPIBatch batch;
 
     if (numXfers == 0) {
         return(SPI_SIMPLE_ERROR);
     }
 
-    /* Lock the SPI port */
+    /* Lock the SPI port, one blocking transfer at a time */
 #ifdef FREE_RTOS
     rtosResult = xSemaphoreTake(spi->portLock, portMAX_DELAY);
     if (rtosResult != pdTRUE) {
@@ -1023,67 +1246,32 @@ SPI_SIMPLE_RESULT spi_batch_xfer(sSPIPeriph *deviceHandle, uint16_t numXfers, sS
     }
 #endif
 
-    /* Store a reference to the current active device */
-    spi->device = deviceHandle;
-
-    /* Indicate to the ISR now many xfers remain */
-    spi->xfers = xfers;
-    spi->xferIndex = 0;
-    spi->xferCount = numXfers - 1;
-
-    /* Set some convenience variables */
-    len = xfers[spi->xferIndex].len;
-    rx = xfers[spi->xferIndex].rx;
-    tx = xfers[spi->xferIndex].tx;
-
-    /* Setup the device specific SPI settings, IO mode, and enable to assert outputs */
-    spi_setup_port_device(device, len, rx, tx, xfers[spi->xferIndex].flags);
-
-    /* Configure the DMA */
-    spi_setup_dma(spi, len, rx, tx);
-
-    /* Assert the device slave select */
-    if (device->ssCallBack != NULL) {
-        device->ssCallBack(true, device->ssCallBackUsrPtr);
-    } else {
-        *spi->pREG_SPI_SLVSEL = device->SPI_SLVSEL_ASSERT;
-#if defined WA_20000062 && WA_20000062
-        /* Must write twice for some devices */
-        *spi->pREG_SPI_SLVSEL = device->SPI_SLVSEL_ASSERT;
-#endif
-    }
+    batch.device = device;
+    batch.xfers = xfers;
+    batch.numXfers = numXfers;
+    batch.priority = SPI_SIMPLE_BLOCKING_PRIORITY;
+    batch.cb = spi_batch_xfer_done;
+    batch.usrPtr = spi;
 
 #ifndef FREE_RTOS
     spi->spiDone = false;
 #endif
 
-    /* Configure the Rx/Tx ctl and count registers to initiate transfer */
-    spi_setup_port_rxtx(spi, len, rx, tx);
+    /* Queue behind, or start ahead of, any submitted transfers */
+    result = spi_submit(&batch);
 
     /* Block until complete */
+    if (result == SPI_SIMPLE_SUCCESS) {
 #ifdef FREE_RTOS
-    rtosResult = xSemaphoreTake(spi->portBlock, portMAX_DELAY);
-    if (rtosResult != pdTRUE) {
-        result = SPI_SIMPLE_ERROR;
-    }
+        rtosResult = xSemaphoreTake(spi->portBlock, portMAX_DELAY);
+        if (rtosResult != pdTRUE) {
+            result = SPI_SIMPLE_ERROR;
+        }
 #else
-    while (spi->spiDone == false);
-#endif
-
-    /* Deassert chip select (must write twice for some devices) */
-    if (device->ssCallBack != NULL) {
-        device->ssCallBack(false, device->ssCallBackUsrPtr);
-    } else {
-        *spi->pREG_SPI_SLVSEL = device->SPI_SLVSEL_DEASSERT;
-#if defined WA_20000062 && WA_20000062
-        /* Must write twice for some devices */
-        *spi->pREG_SPI_SLVSEL = device->SPI_SLVSEL_DEASSERT;
+        while (spi->spiDone == false);
 #endif
     }
 
-    /* Disable the SPI port */
-    *spi->pREG_SPI_CTL &= ~ENUM_SPI_CTL_EN;
-
     /* Unlock the SPI port */
 #ifdef FREE_RTOS
     rtosResult = xSemaphoreGive(spi->portLock);
@@ -1095,6 +1283,125 @@ SPI_SIMPLE_RESULT spi_batch_xfer(sSPIPeriph *deviceHandle, uint16_t numXfers, sS
     return(result);
 }
 
+SPI_SIMPLE_RESULT spi_enableMemoryMapped(sSPIPeriph *deviceHandle,
+    uint32_t readHeader, uint32_t size, uint32_t flags, const void **window)
+{
+    sSPIPeriph *device = deviceHandle;
+    sSPI *spi = device->spiHandle;
+#ifdef FREE_RTOS
+    BaseType_t rtosResult;
+#endif
+
+    /* Only SPI2 has a memory-mapped window, driven by the hardware select */
+    if ((spi->pREG_SPI_MMRDH == NULL) || (device->ssCallBack != NULL) ||
+        (size == 0) || (size > SPI_MM_MAX_SIZE)) {
+        return(SPI_SIMPLE_ERROR);
+    }
+
+#ifdef FREE_RTOS
+    rtosResult = xSemaphoreTake(spi->portLock, portMAX_DELAY);
+    if (rtosResult != pdTRUE) {
+        return(SPI_SIMPLE_ERROR);
+    }
+#endif
+
+    SPI_ENTER_CRITICAL();
+    spi->mmDevice = device;
+    spi->mmReadHeader = readHeader;
+    spi->mmSize = size;
+    spi->mmFlags = flags;
+    /* Otherwise entered when the queue drains */
+    if (spi->active == NULL) {
+        spi_mm_enter(spi);
+    }
+    SPI_EXIT_CRITICAL();
+
+#ifdef FREE_RTOS
+    xSemaphoreGive(spi->portLock);
+#endif
+
+    if (window) {
+        *window = (const void *)SPI_MM_BASE_ADDR;
+    }
+
+    return(SPI_SIMPLE_SUCCESS);
+}
+
+SPI_SIMPLE_RESULT spi_disableMemoryMapped(sSPIPeriph *deviceHandle)
+{
+    sSPIPeriph *device = deviceHandle;
+    sSPI *spi = device->spiHandle;
+
+    if ((spi->mmDevice != device) || (spi->mmHold > 0)) {
+        return(SPI_SIMPLE_ERROR);
+    }
+
+    SPI_ENTER_CRITICAL();
+    spi->mmDevice = NULL;
+    if (spi->mmActive) {
+        spi_mm_leave(spi);
+    }
+    SPI_EXIT_CRITICAL();
+
+    return(SPI_SIMPLE_SUCCESS);
+}
+
+SPI_SIMPLE_RESULT spi_holdMemoryMapped(sSPIPeriph *deviceHandle)
+{
+    sSPIPeriph *device = deviceHandle;
+    sSPI *spi = device->spiHandle;
+    bool held = false;
+
+    if (spi->mmDevice != device) {
+        return(SPI_SIMPLE_ERROR);
+    }
+
+    /* Wait for the queue to drain and the port to enter the window */
+    while (1) {
+        SPI_ENTER_CRITICAL();
+        if (spi->mmActive) {
+            spi->mmHold++;
+            held = true;
+        }
+        SPI_EXIT_CRITICAL();
+        if (held) {
+            break;
+        }
+#ifdef FREE_RTOS
+        vTaskDelay(1);
+#endif
+    }
+
+    return(SPI_SIMPLE_SUCCESS);
+}
+
+SPI_SIMPLE_RESULT spi_releaseMemoryMapped(sSPIPeriph *deviceHandle)
+{
+    sSPIPeriph *device = deviceHandle;
+    sSPI *spi = device->spiHandle;
+    sSPIBatch *start = NULL;
+
+    if ((spi->mmDevice != device) || (spi->mmHold == 0)) {
+        return(SPI_SIMPLE_ERROR);
+    }
+
+    /* Start the transfers queued behind the last window access */
+    SPI_ENTER_CRITICAL();
+    spi->mmHold--;
+    if ((spi->mmHold == 0) && (spi->active == NULL) && (spi->queue != NULL)) {
+        start = spi->queue;
+        spi->queue = start->next;
+        spi->active = start;
+    }
+    SPI_EXIT_CRITICAL();
+
+    if (start != NULL) {
+        spi_start_batch(spi, start);
+    }
+
+    return(SPI_SIMPLE_SUCCESS);
+}
+
 SPI_SIMPLE_RESULT spi_xfer(sSPIPeriph *deviceHandle, uint16_t len, void *rx, void *tx)
 {
     SPI_SIMPLE_RESULT result = SPI_SIMPLE_SUCCESS;
@@ -22,6 +22,8 @@
  *     - Standard, Dual, or Quad I/O device transfers
  *     - Multiple transfers within a single atomic slave select
  *     - Blocking transfers
+ *     - Queued non-blocking transfers with priorities and callbacks
+ *     - Memory-mapped flash reads (SPI2)
  *
  * @file      spi_simple.h
  * @version   1.0.0
@@ -60,6 +62,17 @@
 #define SPI_SIMPLE_MAX_DEVICES   (4)
 #endif
 
+/*!****************************************************************
+ * @brief Queue priority of blocking transfers.
+ *
+ * Blocking spi_xfer() and spi_batch_xfer() transfers are queued
+ * with this priority.  Queued transfers with a higher priority
+ * run first.
+ ******************************************************************/
+#ifndef SPI_SIMPLE_BLOCKING_PRIORITY
+#define SPI_SIMPLE_BLOCKING_PRIORITY   (0)
+#endif
+
 /*!****************************************************************
  * @brief Hardware SPI port.
  ******************************************************************/
@@ -142,6 +155,28 @@ typedef enum SPI_SIMPLE_XFER_FLAGS {
 } SPI_SIMPLE_XFER_FLAGS;
 #define SPI_SIMPLE_XFER_IO_MASK  0x00000003  /**< Transfer mode mask */
 
+/*!****************************************************************
+ * @brief Memory-mapped read support.
+ *
+ * SPI2 of the ADSP-SC5xx processors can map a flash device into the
+ * processor's address space.  SPI_SIMPLE_MM_READ_HEADER() builds the
+ * 'readHeader' argument of spi_enableMemoryMapped() from the read
+ * command opcode, the number of address bytes, the address and dummy
+ * pins (0 = single, 1 = transfer IO mode), the mode byte, the number
+ * of dummy bytes including the mode byte and the TRIDMY field which
+ * selects when the pins are tristated during the dummy bytes.
+ ******************************************************************/
+#if !defined(__ADSP21569_FAMILY__)
+#define SPI_SIMPLE_MM_SUPPORTED
+#define SPI_SIMPLE_MM_READ_HEADER(opcode, adrBytes, adrPins, mode, dmyBytes, triDmy) ( \
+    (((opcode) << BITP_SPI_MMRDH_OPCODE) & BITM_SPI_MMRDH_OPCODE) | \
+    ((((adrBytes) - 1) << BITP_SPI_MMRDH_ADRSIZE) & BITM_SPI_MMRDH_ADRSIZE) | \
+    (((adrPins) << BITP_SPI_MMRDH_ADRPINS) & BITM_SPI_MMRDH_ADRPINS) | \
+    (((mode) << BITP_SPI_MMRDH_MODE) & BITM_SPI_MMRDH_MODE) | \
+    (((dmyBytes) << BITP_SPI_MMRDH_DMYSIZE) & BITM_SPI_MMRDH_DMYSIZE) | \
+    (((triDmy) << BITP_SPI_MMRDH_TRIDMY) & BITM_SPI_MMRDH_TRIDMY) )
+#endif
+
 
 /*!****************************************************************
  * @brief Transfer descrption for batch transfers.
@@ -163,6 +198,37 @@ typedef struct sSPIPeriph sSPIPeriph;
  ******************************************************************/
 typedef struct sSPI sSPI;
 
+typedef struct sSPIBatch sSPIBatch;
+
+/*!****************************************************************
+ * @brief Queued batch completion call-back.
+ *
+ * Called from the SPI interrupt once the batch has finished and the
+ * slave select has been deasserted.  The next queued batch is already
+ * running.  The call-back may queue further batches on the same port
+ * with spi_submit().
+ *
+ * @param [in] batch   The completed batch
+ * @param [in] usrPtr  User data from the batch
+ ******************************************************************/
+typedef void (*SPI_SIMPLE_BATCH_CALLBACK)(sSPIBatch *batch, void *usrPtr);
+
+/*!****************************************************************
+ * @brief Queued batch transfer.
+ *
+ * The batch, and the transfers and buffers it references, must
+ * remain valid until its call-back.
+ ******************************************************************/
+struct sSPIBatch {
+    sSPIPeriph *device;               /**< Device to transfer with */
+    sSPIXfer *xfers;                  /**< Transfers, in one slave select */
+    uint16_t numXfers;                /**< Number of transfers */
+    uint8_t priority;                 /**< Higher priorities run first */
+    SPI_SIMPLE_BATCH_CALLBACK cb;     /**< Completion call-back (optional) */
+    void *usrPtr;                     /**< User data for the call-back */
+    sSPIBatch *next;                  /**< Private to the driver */
+};
+
 #ifdef __cplusplus
 extern "C"{
 #endif
@@ -508,6 +574,9 @@ SPI_SIMPLE_RESULT spi_xfer(sSPIPeriph *deviceHandle, uint16_t len, void *rx, voi
  * The 'len' is the length of the 'tx' and 'rx' buffers in their
  * native word size.
  *
+ * The transfers are queued behind any batches submitted with
+ * spi_submit() of the same or a higher priority.
+ *
  * If using the SPI driver under FreeRTOS, this function must be
  * called after the RTOS has been started.
  *
@@ -524,6 +593,104 @@ SPI_SIMPLE_RESULT spi_xfer(sSPIPeriph *deviceHandle, uint16_t len, void *rx, voi
  ******************************************************************/
 SPI_SIMPLE_RESULT spi_batch_xfer(sSPIPeriph *deviceHandle, uint16_t numXfers, sSPIXfer *xfers);
 
+/*!****************************************************************
+ * @brief Simple SPI memory-mapped mode enable.
+ *
+ * This function switches the port into memory-mapped read mode for
+ * the device.  Reads of the returned window then become device read
+ * commands described by 'readHeader' (the SPI_MMRDH register value).
+ * Only SPI2 has a memory-mapped window and the device must use a
+ * hardware slave select.
+ *
+ * Transfers on the port leave memory-mapped mode while they run and
+ * it is restored once no transfers are queued.  The window must only
+ * be accessed under spi_holdMemoryMapped().
+ *
+ * If using the SPI driver under FreeRTOS, this function must be
+ * called after the RTOS has been started.
+ *
+ * @param [in]  deviceHandle  A handle to a SPI device
+ * @param [in]  readHeader    The memory-mapped read header
+ * @param [in]  size          Size of the window in bytes
+ * @param [in]  flags         One of SPI_SIMPLE_XFER_FLAGS for the data IO
+ * @param [out] window        The window start address (optional)
+ *
+ * @return Returns SPI_SIMPLE_SUCCESS if successful, otherwise
+ *         an error.
+ ******************************************************************/
+SPI_SIMPLE_RESULT spi_enableMemoryMapped(sSPIPeriph *deviceHandle,
+    uint32_t readHeader, uint32_t size, uint32_t flags, const void **window);
+
+/*!****************************************************************
+ * @brief Simple SPI memory-mapped mode disable.
+ *
+ * This function returns the port to normal transfers.
+ *
+ * @param [in] deviceHandle  The device memory-mapped mode was
+ *                           enabled for
+ *
+ * @return Returns SPI_SIMPLE_SUCCESS if successful, otherwise
+ *         an error.
+ ******************************************************************/
+SPI_SIMPLE_RESULT spi_disableMemoryMapped(sSPIPeriph *deviceHandle);
+
+/*!****************************************************************
+ * @brief Simple SPI memory-mapped window hold.
+ *
+ * This function waits for queued transfers to finish and keeps the
+ * port in memory-mapped mode until spi_releaseMemoryMapped() is
+ * called, so the window can be read safely.  Transfers submitted in
+ * the meantime are queued and blocking transfers wait.  Holds may be
+ * nested and must be brief.  The holder must not issue transfers on
+ * the port itself until it releases the window.
+ *
+ * @param [in] deviceHandle  The device memory-mapped mode was
+ *                           enabled for
+ *
+ * @return Returns SPI_SIMPLE_SUCCESS if successful, otherwise
+ *         an error.
+ ******************************************************************/
+SPI_SIMPLE_RESULT spi_holdMemoryMapped(sSPIPeriph *deviceHandle);
+
+/*!****************************************************************
+ * @brief Simple SPI memory-mapped window release.
+ *
+ * This function ends a spi_holdMemoryMapped() hold and starts any
+ * transfers queued behind it.
+ *
+ * @param [in] deviceHandle  The device memory-mapped mode was
+ *                           enabled for
+ *
+ * @return Returns SPI_SIMPLE_SUCCESS if successful, otherwise
+ *         an error.
+ ******************************************************************/
+SPI_SIMPLE_RESULT spi_releaseMemoryMapped(sSPIPeriph *deviceHandle);
+
+/*!****************************************************************
+ * @brief Simple SPI queued transfer.
+ *
+ * This function queues a batch of transfers, performed in a single
+ * chip select as spi_batch_xfer(), and returns without waiting.
+ * Each port runs its queued batches back to back from the SPI
+ * interrupt, switching devices and slave selects as needed, in
+ * priority order and first-in first-out within a priority.
+ *
+ * Slave select call-backs of queued devices are called from the
+ * SPI interrupt.
+ *
+ * If using the SPI driver under FreeRTOS, this function must be
+ * called after the RTOS has been started.
+ *
+ * This function is thread safe.  It may also be called from the
+ * batch call-backs of the same port, but not from other interrupts.
+ *
+ * @param [in] batch  The batch to queue
+ *
+ * @return Returns SPI_SIMPLE_SUCCESS if successful, otherwise
+ *         an error.
+ ******************************************************************/
+SPI_SIMPLE_RESULT spi_submit(sSPIBatch *batch);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
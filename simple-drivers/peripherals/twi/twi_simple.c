@@ -17,6 +17,7 @@
  *  - Fully protected multi-threaded TWI transfers
  *  - Up to 64k read and write transfers
  *  - Blocking transfers
+ *  - Batches of transfers chained from the interrupt
  *
  */
 #include <string.h>
@@ -107,6 +108,16 @@ struct sTWI {
     TWI_SIMPLE_XFER_TYPE xferType;
     TWI_SIMPLE_XFER_TYPE xferState;
 
+    /* Active batch */
+    sTWIOp * volatile ops;
+    uint16_t numOps;
+    uint16_t opIdx;
+    uint16_t opErrors;
+    bool stopOnError;
+    bool batchAsync;
+    TWI_SIMPLE_BATCH_CALLBACK batchCb;
+    void *batchUsrPtr;
+
 #ifdef FREE_RTOS
     SemaphoreHandle_t portLock;
     SemaphoreHandle_t portBlock;
@@ -257,84 +268,143 @@ static void twi_empty_fifo(sTWI *twi)
 }
 
 
-static TWI_SIMPLE_RESULT twi_xfer(sTWI *twi, uint8_t address,
-    TWI_SIMPLE_XFER_TYPE xferType,
-    uint8_t *out, uint16_t outLen,
-    uint8_t *in, uint16_t inLen )
+/* Validates a transfer and converts it to its simplest type */
+static TWI_SIMPLE_RESULT twi_check_xfer(TWI_SIMPLE_XFER_TYPE *xferType,
+    uint16_t outLen, uint8_t *in, uint16_t inLen)
 {
-    TWI_SIMPLE_RESULT result;
-    uint16_t mstrctrl;
-    uint16_t twiErrors;
-#ifdef FREE_RTOS
-    BaseType_t rtosResult;
-#endif
-
-    if (twi == NULL) {
-        return(TWI_SIMPLE_ERROR);
-    }
-
-    result = TWI_SIMPLE_SUCCESS;
-
-#ifdef FREE_RTOS
-    rtosResult = xSemaphoreTake(twi->portLock, portMAX_DELAY);
-    if (rtosResult != pdTRUE) {
-        result = TWI_SIMPLE_ERROR;
-        return(result);
-    }
-#endif
+    TWI_SIMPLE_RESULT result = TWI_SIMPLE_SUCCESS;
 
     /* Convert write/reads if necessary */
-    if (xferType == TWI_SIMPLE_WRITEREAD) {
+    if (*xferType == TWI_SIMPLE_WRITEREAD) {
         if (outLen > TWI_MAX_DCNT) {
             result = TWI_SIMPLE_BAD_LENGTH;
         }
         if ((outLen == 0) && (inLen == 0)) {
             result = TWI_SIMPLE_BAD_LENGTH;
         } else if (outLen == 0) {
-            xferType = TWI_SIMPLE_READ;
+            *xferType = TWI_SIMPLE_READ;
         } else if (inLen == 0) {
-            xferType = TWI_SIMPLE_WRITE;
+            *xferType = TWI_SIMPLE_WRITE;
         }
     }
 
     /* Convert write/writes if necessary */
-    if (xferType == TWI_SIMPLE_WRITEWRITE) {
+    if (*xferType == TWI_SIMPLE_WRITEWRITE) {
         if ((outLen == 0) && (inLen == 0)) {
             result = TWI_SIMPLE_BAD_LENGTH;
         } else if ((in == NULL) || (inLen == 0)) {
-            xferType = TWI_SIMPLE_WRITE;
+            *xferType = TWI_SIMPLE_WRITE;
         }
     }
 
     /* Don't allow zero byte reads.  Confuses some devices */
-    if ((xferType == TWI_SIMPLE_READ) && (inLen == 0)) {
+    if ((*xferType == TWI_SIMPLE_READ) && (inLen == 0)) {
         result = TWI_SIMPLE_BAD_LENGTH;
     }
 
-    if (result == TWI_SIMPLE_SUCCESS) {
+    return(result);
+}
+
+/* Save the transfer info and start it */
+static void twi_start(sTWI *twi, uint8_t address,
+    TWI_SIMPLE_XFER_TYPE xferType,
+    uint8_t *out, uint16_t outLen,
+    uint8_t *in, uint16_t inLen)
+{
+    uint16_t mstrctrl;
 
-        /* Save the transfer info */
-        twi->address = address;
-        twi->sdata = out;
-        twi->slen = outLen;
-        twi->xferType = xferType;
-        twi->rdata = in;
-        twi->rlen = inLen;
+    twi->address = address;
+    twi->sdata = out;
+    twi->slen = outLen;
+    twi->xferType = xferType;
+    twi->rdata = in;
+    twi->rlen = inLen;
 
-        /* Setup the transfer */
-        mstrctrl = twi_begin(twi);
+    /* Setup the transfer */
+    mstrctrl = twi_begin(twi);
 
-        /* Prefill the FIFO */
-        if (twi->xferType != TWI_SIMPLE_READ) {
-            twi_fill_fifo(twi);
+    /* Prefill the FIFO */
+    if (twi->xferType != TWI_SIMPLE_READ) {
+        twi_fill_fifo(twi);
+    }
+
+    /* Start the transfer */
+    *twi->pREG_TWI_MSTRCTL = mstrctrl | ENUM_TWI_MSTRCTL_EN;
+}
+
+/*
+ * Starts the next runnable op of the active batch.  Returns false
+ * once the batch is complete.
+ */
+static bool twi_batch_start(sTWI *twi)
+{
+    TWI_SIMPLE_XFER_TYPE xferType;
+    TWI_SIMPLE_RESULT result;
+    sTWIOp *op;
+
+    while (twi->opIdx < twi->numOps) {
+        op = &twi->ops[twi->opIdx];
+        if (op->type == TWI_SIMPLE_OP_READ) {
+            xferType = TWI_SIMPLE_READ;
+        } else if (op->type == TWI_SIMPLE_OP_WRITEREAD) {
+            xferType = TWI_SIMPLE_WRITEREAD;
+        } else {
+            xferType = TWI_SIMPLE_WRITE;
+        }
+        result = twi_check_xfer(&xferType, op->outLen, op->in, op->inLen);
+        if (result == TWI_SIMPLE_SUCCESS) {
+            twi_start(twi, op->address, xferType,
+                op->out, op->outLen, op->in, op->inLen);
+            return(true);
         }
+        op->result = result;
+        twi->opErrors++;
+        twi->opIdx = twi->stopOnError ? twi->numOps : twi->opIdx + 1;
+    }
+
+    return(false);
+}
+
+static TWI_SIMPLE_RESULT twi_xfer(sTWI *twi, uint8_t address,
+    TWI_SIMPLE_XFER_TYPE xferType,
+    uint8_t *out, uint16_t outLen,
+    uint8_t *in, uint16_t inLen )
+{
+    TWI_SIMPLE_RESULT result;
+    uint16_t twiErrors;
+#ifdef FREE_RTOS
+    BaseType_t rtosResult;
+#endif
+
+    if (twi == NULL) {
+        return(TWI_SIMPLE_ERROR);
+    }
+
+    result = TWI_SIMPLE_SUCCESS;
+
+#ifdef FREE_RTOS
+    rtosResult = xSemaphoreTake(twi->portLock, portMAX_DELAY);
+    if (rtosResult != pdTRUE) {
+        result = TWI_SIMPLE_ERROR;
+        return(result);
+    }
+#endif
+
+#ifndef FREE_RTOS
+    /* Wait for a non-blocking batch to finish */
+    while (twi->ops != NULL);
+#endif
+
+    result = twi_check_xfer(&xferType, outLen, in, inLen);
+
+    if (result == TWI_SIMPLE_SUCCESS) {
 
 #ifndef FREE_RTOS
         twi->twiDone = false;
 #endif
 
         /* Start the transfer */
-        *twi->pREG_TWI_MSTRCTL = mstrctrl | ENUM_TWI_MSTRCTL_EN;
+        twi_start(twi, address, xferType, out, outLen, in, inLen);
 
         /* Block until complete */
 #ifdef FREE_RTOS
@@ -409,6 +479,123 @@ TWI_SIMPLE_RESULT twi_writeWrite(sTWI *twiHandle, uint8_t address,
     return(result);
 }
 
+static TWI_SIMPLE_RESULT twi_batch_submit(sTWI *twi, sTWIOp *ops,
+    uint16_t numOps, bool stopOnError, bool batchAsync,
+    TWI_SIMPLE_BATCH_CALLBACK cb, void *usrPtr)
+{
+    bool started;
+    uint16_t i;
+
+    for (i = 0; i < numOps; i++) {
+        ops[i].result = TWI_SIMPLE_SKIPPED;
+    }
+
+#ifndef FREE_RTOS
+    while (twi->ops != NULL);
+    twi->twiDone = false;
+#endif
+
+    twi->numOps = numOps;
+    twi->opIdx = 0;
+    twi->opErrors = 0;
+    twi->stopOnError = stopOnError;
+    twi->batchAsync = batchAsync;
+    twi->batchCb = cb;
+    twi->batchUsrPtr = usrPtr;
+
+    /* The interrupt is quiet until the first op starts */
+    twi->ops = ops;
+    started = twi_batch_start(twi);
+    if (!started) {
+        twi->ops = NULL;
+    }
+
+    return(started ? TWI_SIMPLE_SUCCESS : TWI_SIMPLE_ERROR);
+}
+
+TWI_SIMPLE_RESULT twi_batch(sTWI *twiHandle, sTWIOp *ops, uint16_t numOps,
+    bool stopOnError)
+{
+    sTWI *twi = twiHandle;
+    TWI_SIMPLE_RESULT result;
+    uint16_t errors;
+#ifdef FREE_RTOS
+    BaseType_t rtosResult;
+#endif
+
+    if ((twi == NULL) || (ops == NULL) || (numOps == 0)) {
+        return(TWI_SIMPLE_ERROR);
+    }
+
+#ifdef FREE_RTOS
+    rtosResult = xSemaphoreTake(twi->portLock, portMAX_DELAY);
+    if (rtosResult != pdTRUE) {
+        return(TWI_SIMPLE_ERROR);
+    }
+#endif
+
+    result = twi_batch_submit(twi, ops, numOps, stopOnError, false, NULL, NULL);
+
+    /* Block until every op has run */
+    if (result == TWI_SIMPLE_SUCCESS) {
+#ifdef FREE_RTOS
+        rtosResult = xSemaphoreTake(twi->portBlock, portMAX_DELAY);
+        if (rtosResult != pdTRUE) {
+            result = TWI_SIMPLE_ERROR;
+        }
+#else
+        while (twi->twiDone == false);
+#endif
+    }
+
+    errors = twi->opErrors;
+    if (errors) {
+        result = TWI_SIMPLE_ERROR;
+    }
+
+#ifdef FREE_RTOS
+    rtosResult = xSemaphoreGive(twi->portLock);
+    if (rtosResult != pdTRUE) {
+        result = TWI_SIMPLE_ERROR;
+    }
+#endif
+
+    return(result);
+}
+
+TWI_SIMPLE_RESULT twi_batchAsync(sTWI *twiHandle, sTWIOp *ops,
+    uint16_t numOps, bool stopOnError, TWI_SIMPLE_BATCH_CALLBACK cb,
+    void *usrPtr)
+{
+    sTWI *twi = twiHandle;
+    TWI_SIMPLE_RESULT result;
+#ifdef FREE_RTOS
+    BaseType_t rtosResult;
+#endif
+
+    if ((twi == NULL) || (ops == NULL) || (numOps == 0)) {
+        return(TWI_SIMPLE_ERROR);
+    }
+
+    /* The port lock is released by the interrupt when the batch ends */
+#ifdef FREE_RTOS
+    rtosResult = xSemaphoreTake(twi->portLock, portMAX_DELAY);
+    if (rtosResult != pdTRUE) {
+        return(TWI_SIMPLE_ERROR);
+    }
+#endif
+
+    result = twi_batch_submit(twi, ops, numOps, stopOnError, true, cb, usrPtr);
+
+#ifdef FREE_RTOS
+    if (result != TWI_SIMPLE_SUCCESS) {
+        xSemaphoreGive(twi->portLock);
+    }
+#endif
+
+    return(result);
+}
+
 static void twi_initRegs(sTWI *twi)
 {
     twi->DEFAULT_TWI_MSTRCTL  = 0x0000u;
@@ -638,6 +825,11 @@ TWI_SIMPLE_RESULT twi_close(sTWI **twiHandle)
     }
 #endif
 
+#ifndef FREE_RTOS
+    /* Wait for a non-blocking batch to finish */
+    while (twi->ops != NULL);
+#endif
+
     twi->open = false;
     twi_initRegs(twi);
 
@@ -663,6 +855,52 @@ TWI_SIMPLE_RESULT twi_close(sTWI **twiHandle)
     return(result);
 }
 
+/* Completes the current op of the active batch and starts the next */
+#ifdef FREE_RTOS
+static void twi_batch_irq(sTWI *twi, BaseType_t *contextSwitch)
+#else
+static void twi_batch_irq(sTWI *twi)
+#endif
+{
+    TWI_SIMPLE_BATCH_CALLBACK cb;
+    sTWIOp *ops;
+    sTWIOp *op;
+
+    op = &twi->ops[twi->opIdx];
+    if (twi_end(twi)) {
+        op->result = TWI_SIMPLE_ERROR;
+        twi->opErrors++;
+        twi->opIdx = twi->stopOnError ? twi->numOps : twi->opIdx + 1;
+    } else {
+        op->result = TWI_SIMPLE_SUCCESS;
+        twi->opIdx++;
+    }
+
+    if (twi_batch_start(twi)) {
+        return;
+    }
+
+    /* Batch complete */
+    ops = twi->ops;
+    cb = twi->batchCb;
+    twi->ops = NULL;
+
+    if (twi->batchAsync) {
+#ifdef FREE_RTOS
+        xSemaphoreGiveFromISR(twi->portLock, contextSwitch);
+#endif
+        if (cb) {
+            cb(twi, ops, twi->numOps, twi->opErrors, twi->batchUsrPtr);
+        }
+    } else {
+#ifdef FREE_RTOS
+        xSemaphoreGiveFromISR(twi->portBlock, contextSwitch);
+#else
+        twi->twiDone = true;
+#endif
+    }
+}
+
 static void twi_data_irq(uint32_t id, void *usrPtr)
 {
     sTWI *twi = (sTWI *)usrPtr;
@@ -755,7 +993,14 @@ static void twi_data_irq(uint32_t id, void *usrPtr)
                 twi->xferType = TWI_SIMPLE_READ;
             }
 
-            if (xferDone) {
+            if (xferDone && (twi->ops != NULL)) {
+#ifdef FREE_RTOS
+                twi_batch_irq(twi, &contextSwitch);
+                portYIELD_FROM_ISR(contextSwitch);
+#else
+                twi_batch_irq(twi);
+#endif
+            } else if (xferDone) {
 #ifdef FREE_RTOS
                 rtosResult = xSemaphoreGiveFromISR(twi->portBlock, &contextSwitch);
                 portYIELD_FROM_ISR(contextSwitch);
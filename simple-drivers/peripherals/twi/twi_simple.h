@@ -16,6 +16,7 @@
  *     - FreeRTOS or no RTOS main-loop modes
  *     - Fully protected multi-threaded device transfers
  *     - Blocking transfers
+ *     - Batches of transfers chained from the interrupt
  *
  * @file      twi_simple.h
  * @version   1.0.0
@@ -69,7 +70,8 @@ typedef enum TWI_SIMPLE_RESULT {
     TWI_SIMPLE_INVALID_PORT,     /**< Invalid TWI port open */
     TWI_SIMPLE_PORT_BUSY,        /**< TWI port is already opened */
     TWI_SIMPLE_ERROR,            /**< Generic error */
-    TWI_SIMPLE_BAD_LENGTH        /**< Transfer length is too long (>254) */
+    TWI_SIMPLE_BAD_LENGTH,       /**< Transfer length is too long (>254) */
+    TWI_SIMPLE_SKIPPED           /**< Batch op not run after an earlier error */
 } TWI_SIMPLE_RESULT;
 
 /*!****************************************************************
@@ -77,6 +79,37 @@ typedef enum TWI_SIMPLE_RESULT {
  ******************************************************************/
 typedef struct sTWI sTWI;
 
+/*!****************************************************************
+ * @brief Simple TWI batch op types.
+ ******************************************************************/
+typedef enum TWI_SIMPLE_OP_TYPE {
+    TWI_SIMPLE_OP_WRITE,         /**< Write 'out' */
+    TWI_SIMPLE_OP_READ,          /**< Read 'in' */
+    TWI_SIMPLE_OP_WRITEREAD      /**< Write 'out', repeated start, read 'in' */
+} TWI_SIMPLE_OP_TYPE;
+
+/*!****************************************************************
+ * @brief Simple TWI batch op.
+ ******************************************************************/
+typedef struct sTWIOp {
+    uint8_t address;             /**< Device address */
+    TWI_SIMPLE_OP_TYPE type;     /**< Op type */
+    uint8_t *out;                /**< Write data */
+    uint16_t outLen;             /**< Write length */
+    uint8_t *in;                 /**< Read data */
+    uint16_t inLen;              /**< Read length */
+    TWI_SIMPLE_RESULT result;    /**< Op result, set by the driver */
+} sTWIOp;
+
+/*!****************************************************************
+ * @brief Simple TWI batch completion callback.
+ *
+ * Called from the TWI interrupt once every op of a batch has run.
+ * 'errors' is the number of ops which did not succeed.
+ ******************************************************************/
+typedef void (*TWI_SIMPLE_BATCH_CALLBACK)(sTWI *twiHandle, sTWIOp *ops,
+    uint16_t numOps, uint16_t errors, void *usrPtr);
+
 #ifdef __cplusplus
 extern "C"{
 #endif
@@ -262,6 +295,64 @@ TWI_SIMPLE_RESULT twi_writeRead(sTWI *twiHandle, uint8_t address,
 TWI_SIMPLE_RESULT twi_writeWrite(sTWI *twiHandle, uint8_t address,
     uint8_t *out, uint16_t outLen, uint8_t *out2, uint16_t out2Len);
 
+/*!****************************************************************
+ * @brief Simple TWI batch.
+ *
+ * This function runs an array of write, read and write-read ops as a
+ * single locked transaction.  Each op is started from the TWI
+ * interrupt as soon as the previous one completes, with a stop
+ * condition between ops, so the calling thread is only woken once.
+ * The result of each op is returned in its 'result' field.
+ *
+ * If 'stopOnError' is set the ops following a failed op are not run
+ * and are marked TWI_SIMPLE_SKIPPED.
+ *
+ * If using the TWI driver under FreeRTOS, this function must be
+ * called after the RTOS has been started.
+ *
+ * This function is thread safe.
+ *
+ * @param [in]     twiHandle    A handle to a TWI port
+ * @param [in,out] ops          Array of ops
+ * @param [in]     numOps       Number of ops
+ * @param [in]     stopOnError  Skip the remaining ops after an error
+ *
+ * @return Returns TWI_SIMPLE_SUCCESS if all ops were successful,
+ *         otherwise an error.
+ ******************************************************************/
+TWI_SIMPLE_RESULT twi_batch(sTWI *twiHandle, sTWIOp *ops, uint16_t numOps,
+    bool stopOnError);
+
+/*!****************************************************************
+ * @brief Simple TWI non-blocking batch.
+ *
+ * This function starts a batch as twi_batch() and returns.  'cb' is
+ * called from the TWI interrupt when the batch completes.  The ops
+ * and their buffers must remain valid until then.  The port is held
+ * by the batch so other transfers on the port wait for it.
+ *
+ * The callback must not start TWI transfers.
+ *
+ * If using the TWI driver under FreeRTOS, this function must be
+ * called after the RTOS has been started.
+ *
+ * This function is thread safe.
+ *
+ * @param [in]     twiHandle    A handle to a TWI port
+ * @param [in,out] ops          Array of ops
+ * @param [in]     numOps       Number of ops
+ * @param [in]     stopOnError  Skip the remaining ops after an error
+ * @param [in]     cb           Completion callback (optional)
+ * @param [in]     usrPtr       User pointer passed to the callback
+ *
+ * @return Returns TWI_SIMPLE_SUCCESS if the batch was started,
+ *         otherwise an error.  The callback is not called if no op
+ *         could be started.
+ ******************************************************************/
+TWI_SIMPLE_RESULT twi_batchAsync(sTWI *twiHandle, sTWIOp *ops,
+    uint16_t numOps, bool stopOnError, TWI_SIMPLE_BATCH_CALLBACK cb,
+    void *usrPtr);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
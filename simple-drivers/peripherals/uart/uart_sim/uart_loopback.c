@@ -0,0 +1,308 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host loopback throughput test of uart_simple.
+ *
+ * uart_simple.c runs against uart_sim, which loops UART0's transmitter
+ * back to its receiver in real time at the programmed baud rate.  A
+ * writer sends a random stream with uart_write() while a reader thread
+ * takes it back with uart_read() and compares it, in interrupt mode and
+ * then in DMA mode.  The rate achieved, the interrupts taken and the
+ * processor load they would cost at a given time per interrupt are
+ * reported for each mode.  The reader can be slowed down to show how
+ * much latency the receive ring absorbs before data is lost.
+ *
+ * The host can hold off the reader for around 10mS, more than a 1K
+ * receive ring lasts at 921600 baud, so build with a larger ring from
+ * the 'peripherals' directory with:
+ *   gcc -O2 -DUART_SIM_HOST -DUART0_RX_BUFFER_SIZE=8192 \
+ *       -Iinc -Iuart -Iuart/uart_sim -o uart_loopback \
+ *       uart/uart_sim/uart_loopback.c uart/uart_simple.c \
+ *       uart/uart_sim/uart_sim.c -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "uart_simple.h"
+#include "uart_sim.h"
+
+#define LOOP_MAX_CHUNK      (65536)
+
+#ifndef UART0_TX_BUFFER_SIZE
+#define UART0_TX_BUFFER_SIZE    (1024)
+#endif
+
+/* Time the reader waits for missing data once everything is sent */
+#define LOOP_DRAIN_NS       (200000000ull)
+
+typedef struct {
+    uint32_t bytes;
+    uint32_t baud;
+    uint32_t readSize;
+    uint32_t writeSize;
+    uint32_t readDelayUs;
+    uint32_t irqNs;
+    uint32_t seed;
+    int modes;
+} LOOP_CFG;
+
+typedef struct {
+    sUART *uart;
+    const LOOP_CFG *cfg;
+    volatile bool sent;
+    uint32_t received;
+    uint32_t errors;
+    uint32_t firstError;
+    uint8_t rx[LOOP_MAX_CHUNK];
+    uint8_t tx[LOOP_MAX_CHUNK];
+} LOOP_STATE;
+
+static const struct {
+    uint32_t baud;
+    UART_SIMPLE_SPEED speed;
+} loopSpeeds[] = {
+    { 115200, UART_SIMPLE_BAUD_115200 },
+    { 230400, UART_SIMPLE_BAUD_230400 },
+    { 460800, UART_SIMPLE_BAUD_460800 },
+    { 921600, UART_SIMPLE_BAUD_921600 }
+};
+
+static LOOP_STATE loop;
+
+static uint32_t rngState;
+
+static uint32_t loop_rand(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return(rngState);
+}
+
+/* Next stream byte, the reader and writer each keep their own state */
+static uint8_t loop_byte(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return((uint8_t)*state);
+}
+
+static uint64_t loop_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+static void *loop_reader(void *arg)
+{
+    const LOOP_CFG *cfg = loop.cfg;
+    uint32_t state = cfg->seed;
+    uint64_t idle = 0;
+    uint32_t len, i;
+    uint8_t expect;
+
+    while (loop.received < cfg->bytes) {
+        len = cfg->readSize;
+        uart_read(loop.uart, loop.rx, &len);
+        if (len == 0) {
+            if (!loop.sent) {
+                continue;
+            }
+            if (idle == 0) {
+                idle = loop_now();
+            } else if (loop_now() - idle > LOOP_DRAIN_NS) {
+                break;
+            }
+            continue;
+        }
+        idle = 0;
+        for (i = 0; i < len; i++) {
+            expect = loop_byte(&state);
+            if (loop.rx[i] != expect) {
+                if (loop.errors == 0) {
+                    loop.firstError = loop.received + i;
+                }
+                loop.errors++;
+            }
+        }
+        loop.received += len;
+        if (cfg->readDelayUs) {
+            usleep(cfg->readDelayUs);
+        }
+    }
+
+    return(NULL);
+}
+
+static int loop_run(const LOOP_CFG *cfg, UART_SIMPLE_MODE mode)
+{
+    UART_SIM_STATS stats;
+    pthread_t reader;
+    uint32_t state = cfg->seed;
+    uint32_t sent, len, i, irqs, queued;
+    uint64_t start, ns;
+    double rate, line;
+
+    if (uart_setMode(loop.uart, mode) != UART_SIMPLE_SUCCESS) {
+        printf("uart_setMode failed\n");
+        return(1);
+    }
+    loop.sent = false;
+    loop.received = 0;
+    loop.errors = 0;
+    uart_sim_stats(UART0, NULL, true);
+
+    start = loop_now();
+    pthread_create(&reader, NULL, loop_reader, NULL);
+    for (sent = 0; sent < cfg->bytes; sent += len) {
+        /*
+         * Only write what fits in the transmit ring so uart_write()
+         * does not spin, the host may have a single processor.
+         */
+        uart_sim_stats(UART0, &stats, false);
+        queued = sent - (uint32_t)stats.txBytes;
+        if (queued + 2 >= UART0_TX_BUFFER_SIZE) {
+            usleep(100);
+            len = 0;
+            continue;
+        }
+        len = UART0_TX_BUFFER_SIZE - 2 - queued;
+        if (len > cfg->writeSize) {
+            len = cfg->writeSize;
+        }
+        if (len > cfg->bytes - sent) {
+            len = cfg->bytes - sent;
+        }
+        for (i = 0; i < len; i++) {
+            loop.tx[i] = loop_byte(&state);
+        }
+        uart_write(loop.uart, loop.tx, &len);
+    }
+    loop.sent = true;
+    pthread_join(reader, NULL);
+    ns = loop_now() - start;
+
+    uart_sim_stats(UART0, &stats, false);
+    irqs = stats.statusIrqs + stats.txDmaIrqs;
+    rate = (double)loop.received * 1e9 / ns;
+    line = stats.baud / 10.0;
+    printf("%-5s %9u %9u %8.1f %6.1f%% %9u %8.3f %6.2f%% %8u %8u\n",
+        (mode == UART_SIMPLE_MODE_DMA) ? "dma" : "irq",
+        cfg->bytes, loop.received, rate / 1024.0, 100.0 * rate / line,
+        irqs, (double)irqs / (loop.received ? loop.received : 1),
+        100.0 * irqs * cfg->irqNs / ns, stats.overruns, loop.errors);
+    if (loop.errors) {
+        printf("      first error at byte %u\n", loop.firstError);
+    }
+
+    return(((loop.received != cfg->bytes) || loop.errors) ? 1 : 0);
+}
+
+static void usage(void)
+{
+    printf("uart_loopback [options]\n");
+    printf("  -n <bytes>   Bytes sent per mode (200000)\n");
+    printf("  -b <baud>    115200, 230400, 460800 or 921600 (921600)\n");
+    printf("  -r <bytes>   Read size (1024, max %d)\n", LOOP_MAX_CHUNK);
+    printf("  -w <bytes>   Write size (4096, max %d)\n", LOOP_MAX_CHUNK);
+    printf("  -d <uS>      Reader delay after each read (0)\n");
+    printf("  -c <nS>      Processor time per interrupt for the load (1000)\n");
+    printf("  -m <mode>    irq, dma or both (both)\n");
+    printf("  -s <seed>    Random seed (1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    LOOP_CFG cfg = {
+        .bytes = 200000, .baud = 921600, .readSize = 1024, .writeSize = 4096,
+        .readDelayUs = 0, .irqNs = 1000, .seed = 1, .modes = 3
+    };
+    UART_SIMPLE_SPEED speed = UART_SIMPLE_BAUD_NONE;
+    unsigned i;
+    int fails = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:b:r:w:d:c:m:s:h")) != -1) {
+        switch (c) {
+            case 'n': cfg.bytes = strtoul(optarg, NULL, 0); break;
+            case 'b': cfg.baud = strtoul(optarg, NULL, 0); break;
+            case 'r': cfg.readSize = strtoul(optarg, NULL, 0); break;
+            case 'w': cfg.writeSize = strtoul(optarg, NULL, 0); break;
+            case 'd': cfg.readDelayUs = strtoul(optarg, NULL, 0); break;
+            case 'c': cfg.irqNs = strtoul(optarg, NULL, 0); break;
+            case 'm':
+                cfg.modes = (strcmp(optarg, "irq") == 0) ? 1 :
+                    (strcmp(optarg, "dma") == 0) ? 2 :
+                    (strcmp(optarg, "both") == 0) ? 3 : 0;
+                break;
+            case 's': cfg.seed = strtoul(optarg, NULL, 0); break;
+            default: usage(); return(1);
+        }
+    }
+    for (i = 0; i < sizeof(loopSpeeds) / sizeof(loopSpeeds[0]); i++) {
+        if (loopSpeeds[i].baud == cfg.baud) {
+            speed = loopSpeeds[i].speed;
+        }
+    }
+    if ((speed == UART_SIMPLE_BAUD_NONE) || (cfg.modes == 0) ||
+        (cfg.readSize == 0) || (cfg.readSize > LOOP_MAX_CHUNK) ||
+        (cfg.writeSize == 0) || (cfg.writeSize > LOOP_MAX_CHUNK)) {
+        usage();
+        return(1);
+    }
+    rngState = cfg.seed ? cfg.seed : 1;
+    cfg.seed = loop_rand();
+    loop.cfg = &cfg;
+
+    uart_init();
+    if (!uart_sim_start(SCLK0)) {
+        printf("uart_sim_start failed\n");
+        return(1);
+    }
+    if (uart_open(UART0, &loop.uart) != UART_SIMPLE_SUCCESS) {
+        printf("uart_open failed\n");
+        return(1);
+    }
+    uart_setProtocol(loop.uart, speed, UART_SIMPLE_8BIT,
+        UART_SIMPLE_PARITY_DISABLE, UART_SIMPLE_STOP_BITS1);
+    uart_setTimeouts(loop.uart, UART_SIMPLE_TIMEOUT_NONE,
+        UART_SIMPLE_TIMEOUT_INF);
+
+    printf("%u baud, %u byte reads, %u byte writes, %u uS reader delay\n\n",
+        cfg.baud, cfg.readSize, cfg.writeSize, cfg.readDelayUs);
+    printf("%-5s %9s %9s %8s %7s %9s %8s %7s %8s %8s\n", "mode", "sent",
+        "received", "KB/s", "line", "irqs", "irqs/B", "load", "overrun",
+        "errors");
+
+    if (cfg.modes & 1) {
+        fails += loop_run(&cfg, UART_SIMPLE_MODE_IRQ);
+    }
+    if (cfg.modes & 2) {
+        fails += loop_run(&cfg, UART_SIMPLE_MODE_DMA);
+    }
+
+    uart_close(&loop.uart);
+    uart_sim_stop();
+    uart_deinit();
+
+    return(fails ? 2 : 0);
+}
@@ -0,0 +1,366 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "uart_sim.h"
+
+/* Characters simulated per port before the thread sleeps again */
+#define UART_SIM_MAX_STEPS      (256)
+
+/* Simulator thread sleep (nS) */
+#define UART_SIM_SLEEP_NS       (20000)
+
+/* THR value meaning nothing was written by the status interrupt */
+#define UART_SIM_THR_EMPTY      (0xFFFFFFFF)
+
+typedef struct {
+    uint32_t imsk;                  /* Interrupt mask */
+    uint32_t clk;                   /* UART_CLK the timing is based on */
+    uint64_t charNs;                /* Character time, 0 = disabled */
+    uint64_t lastNs;                /* Time simulated up to */
+
+    bool thrFull;                   /* Character waiting in THR */
+    uint8_t thrByte;
+    bool rbrFull;                   /* Character waiting in RBR */
+    uint8_t rbrByte;
+
+    bool txActive;                  /* Transmit DMA running */
+    uint32_t txAddr;
+    uint32_t txLeft;
+    bool rxActive;                  /* Receive DMA running */
+    uint32_t rxStart;
+    uint32_t rxCount;
+    uint32_t rxPos;
+
+    UART_SIM_STATS stats;
+} UART_SIM_PORT;
+
+typedef struct {
+    ADI_INT_HANDLER_PTR handler;
+    void *arg;
+} UART_SIM_IRQ;
+
+UART_SIM_REGS uartSimRegs[UART_SIM_PORTS];
+
+static UART_SIM_PORT simPort[UART_SIM_PORTS];
+static UART_SIM_IRQ simIrq[UART_SIM_PORTS * 2];
+static pthread_mutex_t simLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t simThread;
+static volatile bool simRunning = false;
+static uint32_t simSclk0;
+static int simIsrPort = -1;
+static struct timespec simStart;
+
+static uint64_t uart_sim_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t)(ts.tv_sec - simStart.tv_sec) * 1000000000ull +
+        ts.tv_nsec - simStart.tv_nsec);
+}
+
+static uint8_t *uart_sim_ptr(uint32_t addr)
+{
+    return((uint8_t *)uartSimRegs + (int32_t)addr);
+}
+
+/* Character time of 8N1 at the baud rate in UART_CLK */
+static uint64_t uart_sim_char_ns(uint32_t clk)
+{
+    uint32_t div = clk & BITM_UART_CLK_DIV;
+    uint64_t baud;
+
+    if (div == 0) {
+        return(0);
+    }
+    if (clk & ENUM_UART_CLK_EN_DIV_BY_ONE) {
+        baud = simSclk0 / div;
+    } else {
+        baud = simSclk0 / 16 / div;
+    }
+    if (baud == 0) {
+        return(0);
+    }
+    return(10ull * 1000000000ull / baud);
+}
+
+static void uart_sim_irq(int port, int irq)
+{
+    UART_SIM_IRQ *i = &simIrq[port * 2 + irq];
+
+    if (i->handler) {
+        i->handler(port * 2 + irq, i->arg);
+    }
+}
+
+static void uart_sim_masks(UART_SIM_REGS *r, UART_SIM_PORT *p)
+{
+    p->imsk &= ~r->imskClr;
+    r->imskClr = 0;
+    p->imsk |= r->imskSet;
+    r->imskSet = 0;
+}
+
+static void uart_sim_dma(UART_SIM_REGS *r, UART_SIM_PORT *p)
+{
+    if (p->txActive && !(r->txDma.cfg & ENUM_DMA_CFG_EN)) {
+        p->txActive = false;
+    }
+    if (!p->txActive && (r->txDma.cfg & ENUM_DMA_CFG_EN)) {
+        p->txActive = true;
+        p->txAddr = r->txDma.addrStart;
+        p->txLeft = r->txDma.xCnt;
+    }
+
+    if (p->rxActive && !(r->rxDma.cfg & ENUM_DMA_CFG_EN)) {
+        p->rxActive = false;
+    }
+    if (!p->rxActive && (r->rxDma.cfg & ENUM_DMA_CFG_EN)) {
+        p->rxActive = true;
+        p->rxStart = r->rxDma.addrStart;
+        p->rxCount = r->rxDma.xCnt;
+        p->rxPos = 0;
+        r->rxDma.addrCur = p->rxStart;
+    }
+}
+
+/* Simulate one character time */
+static void uart_sim_step(int port)
+{
+    UART_SIM_REGS *r = &uartSimRegs[port];
+    UART_SIM_PORT *p = &simPort[port];
+    bool sent = false;
+    uint8_t byte = 0;
+
+    uart_sim_masks(r, p);
+    uart_sim_dma(r, p);
+
+    /* Transmit */
+    if (p->thrFull) {
+        byte = p->thrByte;
+        p->thrFull = false;
+        sent = true;
+    } else if (p->txActive && (p->imsk & BITM_UART_IMSK_SET_ETBEI)) {
+        if (p->txLeft) {
+            byte = *uart_sim_ptr(p->txAddr);
+            p->txAddr++;
+            p->txLeft--;
+            sent = true;
+        }
+        if (p->txLeft == 0) {
+            r->txDma.cfg &= ~ENUM_DMA_CFG_EN;
+            r->txDma.stat |= ENUM_DMA_STAT_IRQDONE;
+            p->txActive = false;
+            if (r->txDma.cfg & ENUM_DMA_CFG_XCNT_INT) {
+                p->stats.txDmaIrqs++;
+                uart_sim_irq(port, 1);
+                uart_sim_masks(r, p);
+                uart_sim_dma(r, p);
+            }
+        }
+    }
+
+    /* Looped back to the receiver */
+    if (sent) {
+        p->stats.txBytes++;
+        if (p->rxActive && (p->imsk & BITM_UART_IMSK_SET_ERBFI)) {
+            *uart_sim_ptr(p->rxStart + p->rxPos) = byte;
+            p->rxPos++;
+            if (p->rxPos >= p->rxCount) {
+                p->rxPos = 0;
+            }
+            r->rxDma.addrCur = p->rxStart + p->rxPos;
+            p->stats.rxBytes++;
+        } else if (!p->rbrFull) {
+            p->rbrFull = true;
+            p->rbrByte = byte;
+            p->stats.rxBytes++;
+        } else {
+            p->stats.overruns++;
+        }
+    }
+
+    /* Status interrupt */
+    if ((p->rbrFull && !p->rxActive && (p->imsk & BITM_UART_IMSK_SET_ERBFI)) ||
+        (!p->thrFull && !p->txActive && (p->imsk & BITM_UART_IMSK_SET_ETBEI))) {
+        /*
+         * Status writes to clear bits are only memory here, so only DR
+         * and THRE are presented and overruns are only counted.
+         */
+        r->stat = UART_SIM_STAT_DR | (p->thrFull ? 0 : BITM_UART_STAT_THRE);
+        r->thr = UART_SIM_THR_EMPTY;
+        simIsrPort = port;
+        p->stats.statusIrqs++;
+        uart_sim_irq(port, 0);
+        simIsrPort = -1;
+        if (r->thr != UART_SIM_THR_EMPTY) {
+            p->thrFull = true;
+            p->thrByte = (uint8_t)r->thr;
+        }
+        uart_sim_masks(r, p);
+        uart_sim_dma(r, p);
+    }
+}
+
+static void *uart_sim_thread(void *arg)
+{
+    struct timespec ts = { 0, UART_SIM_SLEEP_NS };
+    UART_SIM_PORT *p;
+    uint64_t now, steps;
+    int port;
+
+    while (simRunning) {
+        now = uart_sim_now();
+        pthread_mutex_lock(&simLock);
+        for (port = 0; port < UART_SIM_PORTS; port++) {
+            p = &simPort[port];
+            if (uartSimRegs[port].clk != p->clk) {
+                p->clk = uartSimRegs[port].clk;
+                p->charNs = uart_sim_char_ns(p->clk);
+                p->lastNs = now;
+            }
+            if ((p->charNs == 0) ||
+                !(uartSimRegs[port].ctl & BITM_UART_CTL_EN)) {
+                p->lastNs = now;
+                continue;
+            }
+            steps = (now - p->lastNs) / p->charNs;
+            if (steps > UART_SIM_MAX_STEPS) {
+                steps = UART_SIM_MAX_STEPS;
+            }
+            p->lastNs += steps * p->charNs;
+            while (steps--) {
+                uart_sim_step(port);
+            }
+        }
+        pthread_mutex_unlock(&simLock);
+        nanosleep(&ts, NULL);
+    }
+
+    return(NULL);
+}
+
+ADI_INT_STATUS adi_int_InstallHandler(uint32_t iid,
+    ADI_INT_HANDLER_PTR pfHandler, void *pCBParam, bool bEnable)
+{
+    if (iid >= UART_SIM_PORTS * 2) {
+        return(ADI_INT_FAILURE);
+    }
+    simIrq[iid].handler = pfHandler;
+    simIrq[iid].arg = pCBParam;
+    return(ADI_INT_SUCCESS);
+}
+
+ADI_INT_STATUS adi_int_UninstallHandler(uint32_t iid)
+{
+    if (iid >= UART_SIM_PORTS * 2) {
+        return(ADI_INT_FAILURE);
+    }
+    simIrq[iid].handler = NULL;
+    return(ADI_INT_SUCCESS);
+}
+
+ADI_INT_STATUS adi_int_EnableInt(uint32_t iid, bool bEnable)
+{
+    return((iid < UART_SIM_PORTS * 2) ? ADI_INT_SUCCESS : ADI_INT_FAILURE);
+}
+
+void *local_to_system_addr(void *ptr)
+{
+    return((void *)(uintptr_t)(uint32_t)((uint8_t *)ptr - (uint8_t *)uartSimRegs));
+}
+
+/*
+ * IMSK_SET and IMSK_CLR writes are events on the hardware but only
+ * memory here, so take them in before a later write can replace them.
+ * The driver only writes them in critical sections, in interrupt
+ * handlers and when opening or changing the mode of a port.
+ */
+static void uart_sim_all_masks(void)
+{
+    int port;
+
+    for (port = 0; port < UART_SIM_PORTS; port++) {
+        uart_sim_masks(&uartSimRegs[port], &simPort[port]);
+    }
+}
+
+void uart_sim_enter_critical(void)
+{
+    pthread_mutex_lock(&simLock);
+    uart_sim_all_masks();
+}
+
+void uart_sim_exit_critical(void)
+{
+    uart_sim_all_masks();
+    pthread_mutex_unlock(&simLock);
+}
+
+uint32_t uart_sim_stat_dr(void)
+{
+    UART_SIM_PORT *p;
+
+    if (simIsrPort < 0) {
+        return(0);
+    }
+    p = &simPort[simIsrPort];
+    if (!p->rbrFull) {
+        return(0);
+    }
+    uartSimRegs[simIsrPort].rbr = p->rbrByte;
+    p->rbrFull = false;
+    return(0xFFFFFFFF);
+}
+
+bool uart_sim_start(uint32_t sclk0)
+{
+    if (simRunning) {
+        return(false);
+    }
+    memset(simPort, 0, sizeof(simPort));
+    simSclk0 = sclk0;
+    clock_gettime(CLOCK_MONOTONIC, &simStart);
+    simRunning = true;
+    if (pthread_create(&simThread, NULL, uart_sim_thread, NULL) != 0) {
+        simRunning = false;
+        return(false);
+    }
+    return(true);
+}
+
+void uart_sim_stop(void)
+{
+    if (simRunning) {
+        simRunning = false;
+        pthread_join(simThread, NULL);
+    }
+}
+
+void uart_sim_stats(int port, UART_SIM_STATS *stats, bool reset)
+{
+    UART_SIM_PORT *p = &simPort[port];
+
+    pthread_mutex_lock(&simLock);
+    p->stats.baud = p->charNs ? (uint32_t)(10000000000ull / p->charNs) : 0;
+    if (stats) {
+        *stats = p->stats;
+    }
+    if (reset) {
+        memset(&p->stats, 0, sizeof(p->stats));
+    }
+    pthread_mutex_unlock(&simLock);
+}
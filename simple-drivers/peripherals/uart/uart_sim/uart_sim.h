@@ -0,0 +1,275 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*!
+ * @brief  Host (Linux) UART and DMA register simulator for use with the
+ *         uart_simple driver.
+ *
+ * Supplies the registers, interrupt and cache functions uart_simple.c
+ * needs so the driver can be built and run on a host.  A
+ * simulator thread plays the hardware: every UART's transmitter is
+ * looped back to its own receiver, one character per character time
+ * at the baud rate programmed into UART_CLK, in real time.  Interrupt
+ * handlers run on the simulator thread and are held off while the
+ * driver is in a critical section.
+ *
+ *  - In interrupt mode the status interrupt is raised while a received
+ *    character is waiting and ERBFI is set, or while THR is empty and
+ *    ETBEI is set.
+ *  - With a DMA channel enabled ERBFI and ETBEI request the DMA instead.
+ *    Receive DMA autobuffers through its buffer and ADDR_CUR follows
+ *    it.  Transmit DMA raises its interrupt when XCNT bytes are sent.
+ *  - A received character which cannot be stored is an overrun.
+ *
+ * Build with UART_SIM_HOST defined.
+ *
+ * @file       uart_sim.h
+ * @version    1.0.0
+ * @copyright  2023 Analog Devices, Inc.  All rights reserved.
+ *
+*/
+
+#ifndef _uart_sim_h
+#define _uart_sim_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!****************************************************************
+ * @brief   Number of simulated UART ports
+ ******************************************************************/
+#define UART_SIM_PORTS  (3)
+
+/*!****************************************************************
+ * @brief   Simulated registers of one UART and its DMA channels
+ ******************************************************************/
+typedef struct _UART_SIM_DMA_REGS {
+    volatile uint32_t cfg;
+    volatile uint32_t addrStart;
+    volatile uint32_t addrCur;
+    volatile uint32_t xCnt;
+    volatile uint32_t xMod;
+    volatile uint32_t stat;
+} UART_SIM_DMA_REGS;
+
+typedef struct _UART_SIM_REGS {
+    volatile uint32_t ctl;
+    volatile uint32_t clk;
+    volatile uint32_t stat;
+    volatile uint32_t thr;
+    volatile uint32_t rbr;
+    volatile uint32_t imskClr;
+    volatile uint32_t imskSet;
+    UART_SIM_DMA_REGS txDma;
+    UART_SIM_DMA_REGS rxDma;
+} UART_SIM_REGS;
+
+extern UART_SIM_REGS uartSimRegs[UART_SIM_PORTS];
+
+/*!****************************************************************
+ * @brief   Register addresses
+ ******************************************************************/
+#define pREG_UART0_CTL          (&uartSimRegs[0].ctl)
+#define pREG_UART0_CLK          (&uartSimRegs[0].clk)
+#define pREG_UART0_STAT         (&uartSimRegs[0].stat)
+#define pREG_UART0_THR          (&uartSimRegs[0].thr)
+#define pREG_UART0_RBR          (&uartSimRegs[0].rbr)
+#define pREG_UART0_IMSK_CLR     (&uartSimRegs[0].imskClr)
+#define pREG_UART0_IMSK_SET     (&uartSimRegs[0].imskSet)
+#define pREG_UART1_CTL          (&uartSimRegs[1].ctl)
+#define pREG_UART1_CLK          (&uartSimRegs[1].clk)
+#define pREG_UART1_STAT         (&uartSimRegs[1].stat)
+#define pREG_UART1_THR          (&uartSimRegs[1].thr)
+#define pREG_UART1_RBR          (&uartSimRegs[1].rbr)
+#define pREG_UART1_IMSK_CLR     (&uartSimRegs[1].imskClr)
+#define pREG_UART1_IMSK_SET     (&uartSimRegs[1].imskSet)
+#define pREG_UART2_CTL          (&uartSimRegs[2].ctl)
+#define pREG_UART2_CLK          (&uartSimRegs[2].clk)
+#define pREG_UART2_STAT         (&uartSimRegs[2].stat)
+#define pREG_UART2_THR          (&uartSimRegs[2].thr)
+#define pREG_UART2_RBR          (&uartSimRegs[2].rbr)
+#define pREG_UART2_IMSK_CLR     (&uartSimRegs[2].imskClr)
+#define pREG_UART2_IMSK_SET     (&uartSimRegs[2].imskSet)
+
+#define pREG_DMA20_CFG          (&uartSimRegs[0].txDma.cfg)
+#define pREG_DMA20_ADDRSTART    (&uartSimRegs[0].txDma.addrStart)
+#define pREG_DMA20_XCNT         (&uartSimRegs[0].txDma.xCnt)
+#define pREG_DMA20_XMOD         (&uartSimRegs[0].txDma.xMod)
+#define pREG_DMA20_STAT         (&uartSimRegs[0].txDma.stat)
+#define pREG_DMA21_CFG          (&uartSimRegs[0].rxDma.cfg)
+#define pREG_DMA21_ADDRSTART    (&uartSimRegs[0].rxDma.addrStart)
+#define pREG_DMA21_ADDR_CUR     (&uartSimRegs[0].rxDma.addrCur)
+#define pREG_DMA21_XCNT         (&uartSimRegs[0].rxDma.xCnt)
+#define pREG_DMA21_XMOD         (&uartSimRegs[0].rxDma.xMod)
+#define pREG_DMA21_STAT         (&uartSimRegs[0].rxDma.stat)
+#define pREG_DMA34_CFG          (&uartSimRegs[1].txDma.cfg)
+#define pREG_DMA34_ADDRSTART    (&uartSimRegs[1].txDma.addrStart)
+#define pREG_DMA34_XCNT         (&uartSimRegs[1].txDma.xCnt)
+#define pREG_DMA34_XMOD         (&uartSimRegs[1].txDma.xMod)
+#define pREG_DMA34_STAT         (&uartSimRegs[1].txDma.stat)
+#define pREG_DMA35_CFG          (&uartSimRegs[1].rxDma.cfg)
+#define pREG_DMA35_ADDRSTART    (&uartSimRegs[1].rxDma.addrStart)
+#define pREG_DMA35_ADDR_CUR     (&uartSimRegs[1].rxDma.addrCur)
+#define pREG_DMA35_XCNT         (&uartSimRegs[1].rxDma.xCnt)
+#define pREG_DMA35_XMOD         (&uartSimRegs[1].rxDma.xMod)
+#define pREG_DMA35_STAT         (&uartSimRegs[1].rxDma.stat)
+#define pREG_DMA37_CFG          (&uartSimRegs[2].txDma.cfg)
+#define pREG_DMA37_ADDRSTART    (&uartSimRegs[2].txDma.addrStart)
+#define pREG_DMA37_XCNT         (&uartSimRegs[2].txDma.xCnt)
+#define pREG_DMA37_XMOD         (&uartSimRegs[2].txDma.xMod)
+#define pREG_DMA37_STAT         (&uartSimRegs[2].txDma.stat)
+#define pREG_DMA38_CFG          (&uartSimRegs[2].rxDma.cfg)
+#define pREG_DMA38_ADDRSTART    (&uartSimRegs[2].rxDma.addrStart)
+#define pREG_DMA38_ADDR_CUR     (&uartSimRegs[2].rxDma.addrCur)
+#define pREG_DMA38_XCNT         (&uartSimRegs[2].rxDma.xCnt)
+#define pREG_DMA38_XMOD         (&uartSimRegs[2].rxDma.xMod)
+#define pREG_DMA38_STAT         (&uartSimRegs[2].rxDma.stat)
+
+/*!****************************************************************
+ * @brief   Register fields used by uart_simple
+ ******************************************************************/
+#define BITM_UART_CTL_EN                (0x00000001)
+#define BITM_UART_CTL_WLS               (0x00000300)
+#define BITM_UART_CTL_STB               (0x00001000)
+#define BITM_UART_CTL_PEN               (0x00004000)
+#define BITM_UART_CTL_EPS               (0x00008000)
+#define ENUM_UART_CTL_CLK_DIS           (0x00000000)
+#define ENUM_UART_CTL_CLK_EN            (0x00000001)
+#define ENUM_UART_CTL_WL5BITS           (0x00000000)
+#define ENUM_UART_CTL_WL6BITS           (0x00000100)
+#define ENUM_UART_CTL_WL7BITS           (0x00000200)
+#define ENUM_UART_CTL_WL8BITS           (0x00000300)
+#define ENUM_UART_CTL_NO_EXTRA_STB      (0x00000000)
+#define ENUM_UART_CTL_ONE_EXTRA_STB     (0x00001000)
+#define ENUM_UART_CTL_PARITY_DIS        (0x00000000)
+#define ENUM_UART_CTL_PARITY_EN         (0x00004000)
+#define ENUM_UART_CTL_ODD_PARITY        (0x00000000)
+#define ENUM_UART_CTL_EVEN_PARITY       (0x00008000)
+
+#define BITM_UART_CLK_DIV               (0x0000FFFF)
+#define ENUM_UART_CLK_DIS_DIV_BY_ONE    (0x00000000)
+#define ENUM_UART_CLK_EN_DIV_BY_ONE     (0x80000000)
+
+#define BITM_UART_STAT_OE               (0x00000002)
+#define BITM_UART_STAT_PE               (0x00000004)
+#define BITM_UART_STAT_FE               (0x00000008)
+#define BITM_UART_STAT_BI               (0x00000010)
+#define BITM_UART_STAT_THRE             (0x00000020)
+#define BITM_UART_STAT_ADDR             (0x00000040)
+
+/*
+ * DR is tested before every RBR read, so testing it moves the next
+ * received character into RBR.  It evaluates to all ones while a
+ * character was moved, as the status register is never zero.
+ */
+#define UART_SIM_STAT_DR                (0x00000001)
+#define BITM_UART_STAT_DR               (uart_sim_stat_dr())
+
+#define BITM_UART_IMSK_SET_ERBFI        (0x00000001)
+#define BITM_UART_IMSK_SET_ETBEI        (0x00000002)
+#define BITM_UART_IMSK_SET_ELSI         (0x00000004)
+#define BITM_UART_IMSK_SET_ERXS         (0x00000100)
+#define BITM_UART_IMSK_SET_ETXS         (0x00000200)
+
+#define ENUM_DMA_CFG_EN                 (0x00000001)
+#define ENUM_DMA_CFG_READ               (0x00000000)
+#define ENUM_DMA_CFG_WRITE              (0x00000002)
+#define ENUM_DMA_CFG_SYNC               (0x00000004)
+#define ENUM_DMA_CFG_PSIZE01            (0x00000000)
+#define ENUM_DMA_CFG_MSIZE01            (0x00000000)
+#define ENUM_DMA_CFG_STOP               (0x00000000)
+#define ENUM_DMA_CFG_AUTO               (0x00001000)
+#define ENUM_DMA_CFG_XCNT_INT           (0x00100000)
+
+#define ENUM_DMA_STAT_IRQDONE           (0x00000001)
+#define ENUM_DMA_STAT_IRQERR            (0x00000002)
+#define ENUM_DMA_STAT_PIRQ              (0x00000004)
+
+/*!****************************************************************
+ * @brief   Interrupt IDs, status then transmit DMA for each port
+ ******************************************************************/
+#define INTR_UART0_STAT     (0)
+#define INTR_UART0_TXDMA    (1)
+#define INTR_UART1_STAT     (2)
+#define INTR_UART1_TXDMA    (3)
+#define INTR_UART2_STAT     (4)
+#define INTR_UART2_TXDMA    (5)
+
+/*!****************************************************************
+ * @brief   Subset of the adi_int API implemented by the simulator
+ ******************************************************************/
+typedef enum ADI_INT_STATUS {
+    ADI_INT_SUCCESS = 0,
+    ADI_INT_FAILURE
+} ADI_INT_STATUS;
+
+typedef void (*ADI_INT_HANDLER_PTR)(uint32_t iid, void *handlerArg);
+
+ADI_INT_STATUS adi_int_InstallHandler(uint32_t iid,
+    ADI_INT_HANDLER_PTR pfHandler, void *pCBParam, bool bEnable);
+ADI_INT_STATUS adi_int_UninstallHandler(uint32_t iid);
+ADI_INT_STATUS adi_int_EnableInt(uint32_t iid, bool bEnable);
+
+/*!****************************************************************
+ * @brief   System addresses are 32-bit offsets into the host's
+ *          address space.  The caches are not simulated.
+ ******************************************************************/
+void *local_to_system_addr(void *ptr);
+
+#define ADI_DCACHE_INV_WB               (0)
+#define dcache_invalidate_both(x)
+
+/*!****************************************************************
+ * @brief   Critical sections hold off the simulated interrupts
+ ******************************************************************/
+void uart_sim_enter_critical(void);
+void uart_sim_exit_critical(void);
+
+uint32_t uart_sim_stat_dr(void);
+
+/*!****************************************************************
+ * @brief   UART simulator statistics
+ ******************************************************************/
+typedef struct _UART_SIM_STATS {
+    uint64_t txBytes;               /**< Characters sent */
+    uint64_t rxBytes;               /**< Characters stored by the UART */
+    uint32_t statusIrqs;            /**< Status interrupts */
+    uint32_t txDmaIrqs;             /**< Transmit DMA interrupts */
+    uint32_t overruns;              /**< Characters lost by the UART */
+    uint32_t baud;                  /**< Current baud rate */
+} UART_SIM_STATS;
+
+/*!****************************************************************
+ * @brief  UART simulator start.
+ *
+ * Starts the simulator thread.  Call after uart_init().
+ *
+ * @param [in]   sclk0   The UART clock in Hz
+ *
+ * @return Returns true if successful.
+ ******************************************************************/
+bool uart_sim_start(uint32_t sclk0);
+
+/*!****************************************************************
+ * @brief  UART simulator stop.
+ ******************************************************************/
+void uart_sim_stop(void);
+
+/*!****************************************************************
+ * @brief  UART simulator statistics.
+ *
+ * @param [in]   port    The UART port
+ * @param [out]  stats   The statistics (optional)
+ * @param [in]   reset   Clear the statistics afterwards
+ ******************************************************************/
+void uart_sim_stats(int port, UART_SIM_STATS *stats, bool reset);
+
+#endif
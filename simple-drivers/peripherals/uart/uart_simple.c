@@ -16,11 +16,23 @@
  *  - FreeRTOS or no RTOS main-loop modes
  *  - Fully protected multi-threaded UART transfers
  *  - Blocking transfers
+ *  - Per-port ring buffer sizes
+ *  - Optional DMA to and from the ring buffers
  *
  */
 #include <string.h>
+#ifdef UART_SIM_HOST
+#include "uart_sim.h"
+#else
 #include <sys/platform.h>
 #include <services/int/adi_int.h>
+#include <sys/adi_core.h>
+#if defined(__ADSPARM__)
+#include <adi/cortex-a5/runtime/cache/adi_cache.h>
+#else
+#include <sys/cache.h>
+#endif
+#endif
 
 #ifdef FREE_RTOS
     #include "FreeRTOS.h"
@@ -28,6 +40,16 @@
     #include "task.h"
     #define UART_ENTER_CRITICAL()  taskENTER_CRITICAL()
     #define UART_EXIT_CRITICAL()   taskEXIT_CRITICAL()
+#elif defined (__ADSPARM__)
+    #define UART_ENTER_CRITICAL()  __builtin_disable_interrupts()
+    #define UART_EXIT_CRITICAL()   __builtin_enable_interrupts()
+#elif defined(__ADSP21000__)
+    #include "interrupt.h"
+    #define UART_ENTER_CRITICAL()  adi_rtl_disable_interrupts()
+    #define UART_EXIT_CRITICAL()   adi_rtl_reenable_interrupts()
+#elif defined(UART_SIM_HOST)
+    #define UART_ENTER_CRITICAL()  uart_sim_enter_critical()
+    #define UART_EXIT_CRITICAL()   uart_sim_exit_critical()
 #else
     #define UART_ENTER_CRITICAL()
     #define UART_EXIT_CRITICAL()
@@ -47,8 +69,47 @@
 #define UART_SIMPLE_CHECK_TX_STATUS(x) \
     ((*(x->pREG_UART_STAT)) & BITM_UART_STAT_THRE)
 
-// Size of the UART TX and RX buffers / FIFOs
-#define UART_BUFFER_SIZE        (1024)
+/*
+ * Size of the UART TX and RX ring buffers.  These can be set per port.
+ * In DMA mode the receive ring is filled directly by the DMA so it must
+ * be large enough to hold everything that arrives between reads.
+ */
+#ifndef UART0_RX_BUFFER_SIZE
+#define UART0_RX_BUFFER_SIZE    (1024)
+#endif
+#ifndef UART0_TX_BUFFER_SIZE
+#define UART0_TX_BUFFER_SIZE    (1024)
+#endif
+#ifndef UART1_RX_BUFFER_SIZE
+#define UART1_RX_BUFFER_SIZE    (1024)
+#endif
+#ifndef UART1_TX_BUFFER_SIZE
+#define UART1_TX_BUFFER_SIZE    (1024)
+#endif
+#ifndef UART2_RX_BUFFER_SIZE
+#define UART2_RX_BUFFER_SIZE    (1024)
+#endif
+#ifndef UART2_TX_BUFFER_SIZE
+#define UART2_TX_BUFFER_SIZE    (1024)
+#endif
+
+/*
+ * The UART has no receive idle-line interrupt so a blocked reader in
+ * DMA mode checks the receive DMA position at this interval (mS).
+ */
+#ifndef UART_SIMPLE_DMA_POLL_MS
+#define UART_SIMPLE_DMA_POLL_MS (2)
+#endif
+
+/* Cache line aligned so DMA cache maintenance stays within the rings */
+#define UART_BUFFER_ALIGN __attribute__((aligned(64)))
+
+static uint8_t uart0RxBuffer[UART0_RX_BUFFER_SIZE] UART_BUFFER_ALIGN;
+static uint8_t uart0TxBuffer[UART0_TX_BUFFER_SIZE] UART_BUFFER_ALIGN;
+static uint8_t uart1RxBuffer[UART1_RX_BUFFER_SIZE] UART_BUFFER_ALIGN;
+static uint8_t uart1TxBuffer[UART1_TX_BUFFER_SIZE] UART_BUFFER_ALIGN;
+static uint8_t uart2RxBuffer[UART2_RX_BUFFER_SIZE] UART_BUFFER_ALIGN;
+static uint8_t uart2TxBuffer[UART2_TX_BUFFER_SIZE] UART_BUFFER_ALIGN;
 
 typedef struct _SPI_SIMPLE_BAUD_RATES {
     uint8_t baudRateEnum;
@@ -96,22 +157,47 @@ struct sUART {
 
     uint16_t UART_STATUS_IRQ_ID;
 
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+    // pointers into the DMA registers
+    volatile uint32_t * pREG_TX_DMA_CFG;
+    volatile uint32_t * pREG_TX_DMA_ADDRSTART;
+    volatile uint32_t * pREG_TX_DMA_XCNT;
+    volatile uint32_t * pREG_TX_DMA_XMOD;
+    volatile uint32_t * pREG_TX_DMA_STAT;
+
+    volatile uint32_t * pREG_RX_DMA_CFG;
+    volatile uint32_t * pREG_RX_DMA_ADDRSTART;
+    volatile uint32_t * pREG_RX_DMA_ADDR_CUR;
+    volatile uint32_t * pREG_RX_DMA_XCNT;
+    volatile uint32_t * pREG_RX_DMA_XMOD;
+    volatile uint32_t * pREG_RX_DMA_STAT;
+
+    uint16_t UART_TX_DMA_IRQ_ID;
+
+    // DMA state
+    uint32_t rxDmaStart;
+    uint32_t txDmaLen;
+#endif
+    bool dma;
+
     // UART receive buffer
-    uint8_t rx_buffer[UART_BUFFER_SIZE];
-    uint16_t rx_buffer_readptr;
-    volatile uint16_t rx_buffer_writeptr;
+    uint8_t *rx_buffer;
+    uint32_t rx_buffer_size;
+    uint32_t rx_buffer_readptr;
+    volatile uint32_t rx_buffer_writeptr;
 
     // UART transmit buffer
-    uint8_t tx_buffer[UART_BUFFER_SIZE];
-    volatile uint16_t tx_buffer_readptr;
-    uint16_t tx_buffer_writeptr;
+    uint8_t *tx_buffer;
+    uint32_t tx_buffer_size;
+    volatile uint32_t tx_buffer_readptr;
+    uint32_t tx_buffer_writeptr;
 
     // read/write timeouts mode
     int32_t readTimeout;
     int32_t writeTimeout;
 
     // misc
-    bool transmitting;
+    volatile bool transmitting;
     bool open;
     bool rxSleeping;
     bool txSleeping;
@@ -138,7 +224,7 @@ static UART_SIMPLE_RESULT _uart_isr_writeToRXBuffer(sUART *uart, uint8_t val)
 {
 
     // First check if RX buffer is full
-    if (((uart->rx_buffer_writeptr+1) % UART_BUFFER_SIZE) == uart->rx_buffer_readptr) {
+    if (((uart->rx_buffer_writeptr+1) % uart->rx_buffer_size) == uart->rx_buffer_readptr) {
         return UART_SIMPLE_RX_FIFO_FULL;
     }
 
@@ -147,7 +233,7 @@ static UART_SIMPLE_RESULT _uart_isr_writeToRXBuffer(sUART *uart, uint8_t val)
     uart->rx_buffer_writeptr++;
 
     // wrap pointer if necessary
-    if (uart->rx_buffer_writeptr >= UART_BUFFER_SIZE) {
+    if (uart->rx_buffer_writeptr >= uart->rx_buffer_size) {
         uart->rx_buffer_writeptr = 0;
     }
 
@@ -166,7 +252,7 @@ UART_SIMPLE_RESULT _uart_isr_readFromTXBuffer(sUART *uart, uint8_t *val)
     *val = uart->tx_buffer[uart->tx_buffer_readptr++];
 
     // wrap pointer
-    if (uart->tx_buffer_readptr >= UART_BUFFER_SIZE) {
+    if (uart->tx_buffer_readptr >= uart->tx_buffer_size) {
         uart->tx_buffer_readptr = 0;
     }
 
@@ -179,12 +265,22 @@ static void uart_status_irq(uint32_t id, void *usrPtr)
     sUART *uart = (sUART *)usrPtr;
     UART_SIMPLE_RESULT result;
     uint8_t byte;
-    uint8_t rxCount;
+    uint32_t rxCount;
 #ifdef FREE_RTOS
     BaseType_t rtosResult;
     BaseType_t contextSwitch = pdFALSE;
 #endif
 
+    /*
+     * In DMA mode the data requests are serviced by the DMA channels,
+     * only the line status is handled here.
+     */
+    if (uart->dma) {
+        *uart->pREG_UART_STAT = ( BITM_UART_STAT_OE | BITM_UART_STAT_PE |
+            BITM_UART_STAT_FE | BITM_UART_STAT_BI );
+        return;
+    }
+
     /*
      ********************************************************************************
      * RX - Check if data is ready that has been received
@@ -256,14 +352,215 @@ static void uart_status_irq(uint32_t id, void *usrPtr)
 
 }
 
-UART_SIMPLE_RESULT uart_read(sUART *uart, uint8_t *in, uint8_t *inLen)
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+static void uart_dma_flush(void *buf, uint32_t len, bool invalidate)
+{
+#if defined(__ADSPARM__)
+    uint8_t *flushStart = (uint8_t *)buf;
+    uint8_t *flushEnd = flushStart + len;
+
+    flush_data_buffer(flushStart, flushEnd,
+        invalidate ? ADI_FLUSH_DATA_INV : ADI_FLUSH_DATA_NOINV);
+#else
+    /*
+     * flush_data_buffers() causes invalid instruction crashes on the SHARC+
+     * core so use dcache_invalidate_both() instead.  See spi_simple.c.
+     */
+    dcache_invalidate_both(ADI_DCACHE_INV_WB);
+#endif
+}
+
+/*
+ * Send the contiguous ring data following the read pointer.  Must be
+ * called from the TX DMA ISR or from within a critical section with
+ * 'transmitting' set.
+ */
+static void uart_tx_dma_start(sUART *uart)
+{
+    uint32_t readptr = uart->tx_buffer_readptr;
+    uint32_t writeptr = uart->tx_buffer_writeptr;
+    uint32_t len;
+    void *tx;
+
+    if (writeptr >= readptr) {
+        len = writeptr - readptr;
+    } else {
+        len = uart->tx_buffer_size - readptr;
+    }
+
+    if (len == 0) {
+        *uart->pREG_UART_IMSK_CLR = BITM_UART_IMSK_SET_ETBEI;
+        uart->transmitting = false;
+        return;
+    }
+
+    uart->txDmaLen = len;
+    tx = local_to_system_addr(&uart->tx_buffer[readptr]);
+
+    *uart->pREG_TX_DMA_CFG = 0x00000000u;
+    *uart->pREG_TX_DMA_STAT = ENUM_DMA_STAT_PIRQ | ENUM_DMA_STAT_IRQERR | ENUM_DMA_STAT_IRQDONE;
+    *uart->pREG_TX_DMA_ADDRSTART = (uint32_t)(uintptr_t)tx;
+    *uart->pREG_TX_DMA_XCNT = len;
+    *uart->pREG_TX_DMA_XMOD = sizeof(uint8_t);
+    *uart->pREG_TX_DMA_CFG =
+        ENUM_DMA_CFG_MSIZE01 | ENUM_DMA_CFG_PSIZE01 | ENUM_DMA_CFG_SYNC |
+        ENUM_DMA_CFG_STOP | ENUM_DMA_CFG_XCNT_INT | ENUM_DMA_CFG_READ |
+        ENUM_DMA_CFG_EN;
+
+    *uart->pREG_UART_IMSK_SET = BITM_UART_IMSK_SET_ETBEI;
+}
+
+static void uart_tx_dma_irq(uint32_t id, void *usrPtr)
+{
+    sUART *uart = (sUART *)usrPtr;
+    uint32_t readptr;
+#ifdef FREE_RTOS
+    BaseType_t rtosResult;
+    BaseType_t contextSwitch = pdFALSE;
+#endif
+
+    *uart->pREG_TX_DMA_STAT = ENUM_DMA_STAT_IRQERR | ENUM_DMA_STAT_IRQDONE;
+
+    // release the sent data and start on the next piece
+    readptr = uart->tx_buffer_readptr + uart->txDmaLen;
+    if (readptr >= uart->tx_buffer_size) {
+        readptr = 0;
+    }
+    uart->tx_buffer_readptr = readptr;
+    uart->txDmaLen = 0;
+
+    uart_tx_dma_start(uart);
+
+    // Wake any task waiting to send data
+#ifdef FREE_RTOS
+    if (uart->txSleeping) {
+        rtosResult = xSemaphoreGiveFromISR(uart->portTxBlock, &contextSwitch);
+        uart->txSleeping = false;
+        portYIELD_FROM_ISR(contextSwitch);
+    }
+#endif
+}
+
+/*
+ * Receive continuously into the whole rx ring.  The write pointer is
+ * derived from the DMA's current address.  Unread data is overwritten
+ * if the reader falls a full ring behind.
+ */
+static void uart_rx_dma_start(sUART *uart)
+{
+    void *rx;
+
+    uart_dma_flush(uart->rx_buffer, uart->rx_buffer_size, true);
+
+    rx = local_to_system_addr(uart->rx_buffer);
+    uart->rxDmaStart = (uint32_t)(uintptr_t)rx;
+
+    *uart->pREG_RX_DMA_CFG = 0x00000000u;
+    *uart->pREG_RX_DMA_STAT = ENUM_DMA_STAT_PIRQ | ENUM_DMA_STAT_IRQERR | ENUM_DMA_STAT_IRQDONE;
+    *uart->pREG_RX_DMA_ADDRSTART = (uint32_t)(uintptr_t)rx;
+    *uart->pREG_RX_DMA_XCNT = uart->rx_buffer_size;
+    *uart->pREG_RX_DMA_XMOD = sizeof(uint8_t);
+    *uart->pREG_RX_DMA_CFG =
+        ENUM_DMA_CFG_MSIZE01 | ENUM_DMA_CFG_PSIZE01 | ENUM_DMA_CFG_AUTO |
+        ENUM_DMA_CFG_WRITE | ENUM_DMA_CFG_EN;
+}
+
+static void uart_dma_stop(sUART *uart)
+{
+    *uart->pREG_TX_DMA_CFG = 0x00000000u;
+    *uart->pREG_RX_DMA_CFG = 0x00000000u;
+    *uart->pREG_TX_DMA_STAT = ENUM_DMA_STAT_PIRQ | ENUM_DMA_STAT_IRQERR | ENUM_DMA_STAT_IRQDONE;
+    *uart->pREG_RX_DMA_STAT = ENUM_DMA_STAT_PIRQ | ENUM_DMA_STAT_IRQERR | ENUM_DMA_STAT_IRQDONE;
+    uart->txDmaLen = 0;
+}
+#endif
+
+static bool uart_rx_empty(sUART *uart)
+{
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+    uint32_t ptr;
+
+    // In DMA mode the write pointer follows the receive DMA
+    if (uart->dma) {
+        ptr = *uart->pREG_RX_DMA_ADDR_CUR - uart->rxDmaStart;
+        if (ptr >= uart->rx_buffer_size) {
+            ptr = 0;
+        }
+        uart->rx_buffer_writeptr = ptr;
+    }
+#endif
+    return(uart->rx_buffer_writeptr == uart->rx_buffer_readptr);
+}
+
+static uint32_t uart_rx_copy(sUART *uart, uint8_t *in, uint32_t len)
+{
+    uint32_t readptr = uart->rx_buffer_readptr;
+    uint32_t writeptr = uart->rx_buffer_writeptr;
+    uint32_t total = 0;
+    uint32_t chunk;
+
+    while ((total < len) && (readptr != writeptr)) {
+
+        // copy the contiguous data up to the write pointer or ring end
+        if (writeptr > readptr) {
+            chunk = writeptr - readptr;
+        } else {
+            chunk = uart->rx_buffer_size - readptr;
+        }
+        if (chunk > (len - total)) {
+            chunk = len - total;
+        }
+
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+        if (uart->dma) {
+            uart_dma_flush(&uart->rx_buffer[readptr], chunk, true);
+        }
+#endif
+        memcpy(&in[total], &uart->rx_buffer[readptr], chunk);
+
+        total += chunk;
+        readptr += chunk;
+        if (readptr >= uart->rx_buffer_size) {
+            readptr = 0;
+        }
+    }
+
+    uart->rx_buffer_readptr = readptr;
+
+    return(total);
+}
+
+static bool uart_tx_full(sUART *uart)
+{
+    return(((uart->tx_buffer_writeptr+1) % uart->tx_buffer_size) == uart->tx_buffer_readptr);
+}
+
+static void uart_tx_kick(sUART *uart)
+{
+    UART_ENTER_CRITICAL();
+    if (!uart->transmitting) {
+        uart->transmitting = true;
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+        if (uart->dma) {
+            uart_tx_dma_start(uart);
+        }
+#endif
+        if (!uart->dma) {
+            *uart->pREG_UART_IMSK_SET = BITM_UART_IMSK_SET_ETBEI;
+        }
+    }
+    UART_EXIT_CRITICAL();
+}
+
+UART_SIMPLE_RESULT uart_read(sUART *uart, uint8_t *in, uint32_t *inLen)
 {
     UART_SIMPLE_RESULT result = UART_SIMPLE_SUCCESS;
     bool empty;
-    int i;
 
 #ifdef FREE_RTOS
     BaseType_t rtosResult;
+    TickType_t poll;
+    TickType_t waited;
 #endif
 
 #ifdef FREE_RTOS
@@ -274,38 +571,45 @@ UART_SIMPLE_RESULT uart_read(sUART *uart, uint8_t *in, uint8_t *inLen)
 #endif
 
 #ifdef FREE_RTOS
-    UART_ENTER_CRITICAL();
-    empty = (uart->rx_buffer_writeptr == uart->rx_buffer_readptr);
-    if (empty) {
-        uart->rxSleeping = true;
-    }
-    UART_EXIT_CRITICAL();
-    if (empty) {
-        rtosResult = xSemaphoreTake(uart->portRxBlock, uart->readTimeout);
-        if (rtosResult == pdFALSE) {
-            UART_ENTER_CRITICAL();
-            if (uart->rxSleeping) {
-                uart->rxSleeping = false;
+    if (uart->dma) {
+        // No idle-line interrupt so poll the receive DMA position
+        poll = pdMS_TO_TICKS(UART_SIMPLE_DMA_POLL_MS);
+        if (poll == 0) {
+            poll = 1;
+        }
+        waited = 0;
+        while (uart_rx_empty(uart) && (waited < uart->rtosReadTimeout)) {
+            vTaskDelay(poll);
+            waited += poll;
+        }
+    } else {
+        UART_ENTER_CRITICAL();
+        empty = uart_rx_empty(uart);
+        if (empty) {
+            uart->rxSleeping = true;
+        }
+        UART_EXIT_CRITICAL();
+        if (empty) {
+            rtosResult = xSemaphoreTake(uart->portRxBlock, uart->rtosReadTimeout);
+            if (rtosResult == pdFALSE) {
+                UART_ENTER_CRITICAL();
+                if (uart->rxSleeping) {
+                    uart->rxSleeping = false;
+                }
+                UART_EXIT_CRITICAL();
             }
-            UART_EXIT_CRITICAL();
         }
     }
 #else
     if (uart->readTimeout == UART_SIMPLE_TIMEOUT_INF) {
         do {
-            empty = (uart->rx_buffer_writeptr == uart->rx_buffer_readptr);
+            empty = uart_rx_empty(uart);
         } while (empty);
     }
 #endif
 
-    empty = (uart->rx_buffer_writeptr == uart->rx_buffer_readptr);
-    for (i = 0; (i < *inLen) && !empty; i++) {
-        in[i] = uart->rx_buffer[uart->rx_buffer_readptr++];
-        if (uart->rx_buffer_readptr >= UART_BUFFER_SIZE) {
-            uart->rx_buffer_readptr = 0;
-        }
-        empty = (uart->rx_buffer_writeptr == uart->rx_buffer_readptr);
-    }
+    empty = uart_rx_empty(uart);
+    *inLen = empty ? 0 : uart_rx_copy(uart, in, *inLen);
 
 #ifdef FREE_RTOS
     rtosResult = xSemaphoreGive(uart->portRxLock);
@@ -314,16 +618,17 @@ UART_SIMPLE_RESULT uart_read(sUART *uart, uint8_t *in, uint8_t *inLen)
     }
 #endif
 
-    *inLen = i;
-
     return(result);
 }
 
 
-UART_SIMPLE_RESULT uart_write(sUART *uart, uint8_t *out, uint8_t *outLen)
+UART_SIMPLE_RESULT uart_write(sUART *uart, uint8_t *out, uint32_t *outLen)
 {
     UART_SIMPLE_RESULT result = UART_SIMPLE_SUCCESS;
-    int i;
+    uint32_t readptr;
+    uint32_t writeptr;
+    uint32_t chunk;
+    uint32_t total;
     bool full;
 #ifdef FREE_RTOS
     BaseType_t rtosResult;
@@ -336,11 +641,12 @@ UART_SIMPLE_RESULT uart_write(sUART *uart, uint8_t *out, uint8_t *outLen)
     }
 #endif
 
-    for (i = 0; i < *outLen; i++) {
+    total = 0;
+    while (total < *outLen) {
 
 #ifdef FREE_RTOS
         UART_ENTER_CRITICAL();
-        full = ((uart->tx_buffer_writeptr+1) % UART_BUFFER_SIZE) == uart->tx_buffer_readptr;
+        full = uart_tx_full(uart);
         if (full) {
             uart->txSleeping = true;
         }
@@ -350,29 +656,51 @@ UART_SIMPLE_RESULT uart_write(sUART *uart, uint8_t *out, uint8_t *outLen)
             if (rtosResult != pdTRUE) {
                 result = UART_SIMPLE_ERROR;
             }
+            continue;
         }
 #else
         do {
-            full = ((uart->tx_buffer_writeptr+1) % UART_BUFFER_SIZE) == uart->tx_buffer_readptr;
+            full = uart_tx_full(uart);
         } while (full);
 #endif
 
-        uart->tx_buffer[uart->tx_buffer_writeptr++] = out[i];
+        // copy as much as fits contiguously into the ring
+        readptr = uart->tx_buffer_readptr;
+        writeptr = uart->tx_buffer_writeptr;
+        if (writeptr >= readptr) {
+            chunk = uart->tx_buffer_size - writeptr;
+            if (readptr == 0) {
+                chunk--;
+            }
+        } else {
+            chunk = readptr - writeptr - 1;
+        }
+        if (chunk > (*outLen - total)) {
+            chunk = *outLen - total;
+        }
 
-        if (uart->tx_buffer_writeptr >= UART_BUFFER_SIZE) {
-            uart->tx_buffer_writeptr = 0;
+        memcpy(&uart->tx_buffer[writeptr], &out[total], chunk);
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+        if (uart->dma) {
+            uart_dma_flush(&uart->tx_buffer[writeptr], chunk, false);
         }
+#endif
+
+        total += chunk;
+        writeptr += chunk;
+        if (writeptr >= uart->tx_buffer_size) {
+            writeptr = 0;
+        }
+        uart->tx_buffer_writeptr = writeptr;
+
+        /*
+         * Kick off a write if needed.  Done per chunk so writes larger
+         * than the ring keep the transmitter busy.
+         */
+        uart_tx_kick(uart);
     }
 
-    /*
-     * Kick off a write if needed
-     */
-     UART_ENTER_CRITICAL();
-     if (!uart->transmitting) {
-        *uart->pREG_UART_IMSK_SET = BITM_UART_IMSK_SET_ETBEI;
-        uart->transmitting = true;
-     }
-     UART_EXIT_CRITICAL();
+    *outLen = total;
 
 #ifdef FREE_RTOS
     rtosResult = xSemaphoreGive(uart->portTxLock);
@@ -536,6 +864,98 @@ UART_SIMPLE_RESULT uart_setTimeouts(sUART *uartHandle,
     return(result);
 }
 
+UART_SIMPLE_RESULT uart_setMode(sUART *uartHandle, UART_SIMPLE_MODE mode)
+{
+    UART_SIMPLE_RESULT result = UART_SIMPLE_SUCCESS;
+    sUART *uart = uartHandle;
+    bool dma = (mode == UART_SIMPLE_MODE_DMA);
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+    ADI_INT_STATUS status;
+#endif
+#ifdef FREE_RTOS
+    BaseType_t rtosResult;
+#endif
+
+#ifndef UART_SIMPLE_DMA_SUPPORTED
+    if (dma) {
+        return(UART_SIMPLE_ERROR);
+    }
+#endif
+
+#ifdef FREE_RTOS
+    rtosResult = xSemaphoreTake(uart->portLock, portMAX_DELAY);
+    if (rtosResult != pdTRUE) {
+        result = UART_SIMPLE_ERROR;
+    }
+    rtosResult = xSemaphoreTake(uart->portRxLock, portMAX_DELAY);
+    if (rtosResult != pdTRUE) {
+        result = UART_SIMPLE_ERROR;
+    }
+    rtosResult = xSemaphoreTake(uart->portTxLock, portMAX_DELAY);
+    if (rtosResult != pdTRUE) {
+        result = UART_SIMPLE_ERROR;
+    }
+#endif
+
+    if ((result == UART_SIMPLE_SUCCESS) && (dma != uart->dma)) {
+
+        /* Let any queued transmit data drain */
+        while (uart->transmitting) {
+#ifdef FREE_RTOS
+            vTaskDelay(1);
+#endif
+        }
+
+        *uart->pREG_UART_IMSK_CLR =
+            BITM_UART_IMSK_SET_ERBFI | BITM_UART_IMSK_SET_ETBEI;
+
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+        if (uart->dma) {
+            uart_dma_stop(uart);
+            adi_int_UninstallHandler(uart->UART_TX_DMA_IRQ_ID);
+        }
+#endif
+
+        /* Unread receive data is discarded */
+        uart->dma = false;
+        uart->rx_buffer_readptr = 0;
+        uart->rx_buffer_writeptr = 0;
+
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+        if (dma) {
+            status = adi_int_InstallHandler(uart->UART_TX_DMA_IRQ_ID,
+                uart_tx_dma_irq, uart, true);
+            if (status == ADI_INT_SUCCESS) {
+                uart->dma = true;
+                uart_rx_dma_start(uart);
+            } else {
+                result = UART_SIMPLE_ERROR;
+            }
+        }
+#endif
+
+        /* In DMA mode this is the receive DMA request enable */
+        *uart->pREG_UART_IMSK_SET = BITM_UART_IMSK_SET_ERBFI;
+    }
+
+#ifdef FREE_RTOS
+    rtosResult = xSemaphoreGive(uart->portTxLock);
+    if (rtosResult != pdTRUE) {
+        result = UART_SIMPLE_ERROR;
+    }
+    rtosResult = xSemaphoreGive(uart->portRxLock);
+    if (rtosResult != pdTRUE) {
+        result = UART_SIMPLE_ERROR;
+    }
+    rtosResult = xSemaphoreGive(uart->portLock);
+    if (rtosResult != pdTRUE) {
+        result = UART_SIMPLE_ERROR;
+    }
+#endif
+
+    return(result);
+}
+
 UART_SIMPLE_RESULT uart_open(UART_SIMPLE_PORT port, sUART **uartHandle)
 {
     UART_SIMPLE_RESULT result = UART_SIMPLE_SUCCESS;
@@ -573,14 +993,17 @@ UART_SIMPLE_RESULT uart_open(UART_SIMPLE_PORT port, sUART **uartHandle)
 
         if (status == ADI_INT_SUCCESS) {
 
-            memset(uart->rx_buffer, 0, sizeof(uart->rx_buffer));
+            memset(uart->rx_buffer, 0, uart->rx_buffer_size);
             uart->rx_buffer_readptr = 0;
             uart->rx_buffer_writeptr = 0;
 
-            memset(uart->tx_buffer, 0, sizeof(uart->tx_buffer));
+            memset(uart->tx_buffer, 0, uart->tx_buffer_size);
             uart->tx_buffer_readptr = 0;
             uart->tx_buffer_writeptr = 0;
 
+            uart->transmitting = false;
+            uart->dma = false;
+
             _uart_setProtocol(uart,
                 UART_SIMPLE_BAUD_9600, UART_SIMPLE_8BIT,
                 UART_SIMPLE_PARITY_DISABLE, UART_SIMPLE_STOP_BITS1
@@ -641,6 +1064,18 @@ UART_SIMPLE_RESULT uart_close(sUART **uartHandle)
     uart->open = false;
     uart_initRegs(uart);
 
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+    if (uart->dma) {
+        uart_dma_stop(uart);
+        status = adi_int_UninstallHandler(uart->UART_TX_DMA_IRQ_ID);
+        if (status != ADI_INT_SUCCESS) {
+            result = UART_SIMPLE_ERROR;
+        }
+    }
+#endif
+    uart->dma = false;
+    uart->transmitting = false;
+
     status = adi_int_EnableInt(uart->UART_STATUS_IRQ_ID, false);
     if (status != ADI_INT_SUCCESS) {
         result = UART_SIMPLE_ERROR;
@@ -690,6 +1125,28 @@ UART_SIMPLE_RESULT uart_init(void)
             uart->pREG_UART_STAT      = (volatile uint32_t *) pREG_UART0_STAT;
 
             uart->UART_STATUS_IRQ_ID    = INTR_UART0_STAT;
+
+            uart->rx_buffer           = uart0RxBuffer;
+            uart->rx_buffer_size      = UART0_RX_BUFFER_SIZE;
+            uart->tx_buffer           = uart0TxBuffer;
+            uart->tx_buffer_size      = UART0_TX_BUFFER_SIZE;
+
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+            uart->pREG_TX_DMA_CFG       = (volatile uint32_t *) pREG_DMA20_CFG;
+            uart->pREG_TX_DMA_ADDRSTART = (volatile uint32_t *) pREG_DMA20_ADDRSTART;
+            uart->pREG_TX_DMA_XCNT      = (volatile uint32_t *) pREG_DMA20_XCNT;
+            uart->pREG_TX_DMA_XMOD      = (volatile uint32_t *) pREG_DMA20_XMOD;
+            uart->pREG_TX_DMA_STAT      = (volatile uint32_t *) pREG_DMA20_STAT;
+
+            uart->pREG_RX_DMA_CFG       = (volatile uint32_t *) pREG_DMA21_CFG;
+            uart->pREG_RX_DMA_ADDRSTART = (volatile uint32_t *) pREG_DMA21_ADDRSTART;
+            uart->pREG_RX_DMA_ADDR_CUR  = (volatile uint32_t *) pREG_DMA21_ADDR_CUR;
+            uart->pREG_RX_DMA_XCNT      = (volatile uint32_t *) pREG_DMA21_XCNT;
+            uart->pREG_RX_DMA_XMOD      = (volatile uint32_t *) pREG_DMA21_XMOD;
+            uart->pREG_RX_DMA_STAT      = (volatile uint32_t *) pREG_DMA21_STAT;
+
+            uart->UART_TX_DMA_IRQ_ID    = INTR_UART0_TXDMA;
+#endif
         }
         else if (port == UART1) {
             uart->pREG_UART_CTL       = (volatile uint32_t *) pREG_UART1_CTL;
@@ -702,6 +1159,28 @@ UART_SIMPLE_RESULT uart_init(void)
             uart->pREG_UART_STAT      = (volatile uint32_t *) pREG_UART1_STAT;
 
             uart->UART_STATUS_IRQ_ID    = INTR_UART1_STAT;
+
+            uart->rx_buffer           = uart1RxBuffer;
+            uart->rx_buffer_size      = UART1_RX_BUFFER_SIZE;
+            uart->tx_buffer           = uart1TxBuffer;
+            uart->tx_buffer_size      = UART1_TX_BUFFER_SIZE;
+
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+            uart->pREG_TX_DMA_CFG       = (volatile uint32_t *) pREG_DMA34_CFG;
+            uart->pREG_TX_DMA_ADDRSTART = (volatile uint32_t *) pREG_DMA34_ADDRSTART;
+            uart->pREG_TX_DMA_XCNT      = (volatile uint32_t *) pREG_DMA34_XCNT;
+            uart->pREG_TX_DMA_XMOD      = (volatile uint32_t *) pREG_DMA34_XMOD;
+            uart->pREG_TX_DMA_STAT      = (volatile uint32_t *) pREG_DMA34_STAT;
+
+            uart->pREG_RX_DMA_CFG       = (volatile uint32_t *) pREG_DMA35_CFG;
+            uart->pREG_RX_DMA_ADDRSTART = (volatile uint32_t *) pREG_DMA35_ADDRSTART;
+            uart->pREG_RX_DMA_ADDR_CUR  = (volatile uint32_t *) pREG_DMA35_ADDR_CUR;
+            uart->pREG_RX_DMA_XCNT      = (volatile uint32_t *) pREG_DMA35_XCNT;
+            uart->pREG_RX_DMA_XMOD      = (volatile uint32_t *) pREG_DMA35_XMOD;
+            uart->pREG_RX_DMA_STAT      = (volatile uint32_t *) pREG_DMA35_STAT;
+
+            uart->UART_TX_DMA_IRQ_ID    = INTR_UART1_TXDMA;
+#endif
         }
         else if (port == UART2) {
             uart->pREG_UART_CTL       = (volatile uint32_t *) pREG_UART2_CTL;
@@ -714,6 +1193,28 @@ UART_SIMPLE_RESULT uart_init(void)
             uart->pREG_UART_STAT      = (volatile uint32_t *) pREG_UART2_STAT;
 
             uart->UART_STATUS_IRQ_ID    = INTR_UART2_STAT;
+
+            uart->rx_buffer           = uart2RxBuffer;
+            uart->rx_buffer_size      = UART2_RX_BUFFER_SIZE;
+            uart->tx_buffer           = uart2TxBuffer;
+            uart->tx_buffer_size      = UART2_TX_BUFFER_SIZE;
+
+#ifdef UART_SIMPLE_DMA_SUPPORTED
+            uart->pREG_TX_DMA_CFG       = (volatile uint32_t *) pREG_DMA37_CFG;
+            uart->pREG_TX_DMA_ADDRSTART = (volatile uint32_t *) pREG_DMA37_ADDRSTART;
+            uart->pREG_TX_DMA_XCNT      = (volatile uint32_t *) pREG_DMA37_XCNT;
+            uart->pREG_TX_DMA_XMOD      = (volatile uint32_t *) pREG_DMA37_XMOD;
+            uart->pREG_TX_DMA_STAT      = (volatile uint32_t *) pREG_DMA37_STAT;
+
+            uart->pREG_RX_DMA_CFG       = (volatile uint32_t *) pREG_DMA38_CFG;
+            uart->pREG_RX_DMA_ADDRSTART = (volatile uint32_t *) pREG_DMA38_ADDRSTART;
+            uart->pREG_RX_DMA_ADDR_CUR  = (volatile uint32_t *) pREG_DMA38_ADDR_CUR;
+            uart->pREG_RX_DMA_XCNT      = (volatile uint32_t *) pREG_DMA38_XCNT;
+            uart->pREG_RX_DMA_XMOD      = (volatile uint32_t *) pREG_DMA38_XMOD;
+            uart->pREG_RX_DMA_STAT      = (volatile uint32_t *) pREG_DMA38_STAT;
+
+            uart->UART_TX_DMA_IRQ_ID    = INTR_UART2_TXDMA;
+#endif
         }
 
 #ifdef FREE_RTOS
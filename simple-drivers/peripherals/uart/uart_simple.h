@@ -16,6 +16,11 @@
  *     - FreeRTOS or no RTOS main-loop modes
  *     - Fully protected multi-threaded device transfers
  *     - Blocking transfers
+ *     - Per-port ring buffer sizes
+ *     - Optional DMA to and from the ring buffers
+ *
+ *   The ring buffer sizes default to 1024 bytes and can be set per port
+ *   with UARTn_RX_BUFFER_SIZE and UARTn_TX_BUFFER_SIZE.
  *
  * @file      uart_simple.h
  * @version   1.0.0
@@ -130,6 +135,21 @@ typedef enum UART_SIMPLE_RESULT
     UART_SIMPLE_TX_FIFO_FULL,        /**< Internal driver error, not returned */
 } UART_SIMPLE_RESULT;
 
+/*!****************************************************************
+ * @brief Simple UART driver transfer modes.
+ ******************************************************************/
+typedef enum UART_SIMPLE_MODE {
+    UART_SIMPLE_MODE_IRQ = 0,   /**< Interrupt per byte (default) */
+    UART_SIMPLE_MODE_DMA        /**< DMA to and from the ring buffers */
+} UART_SIMPLE_MODE;
+
+/*!****************************************************************
+ * @brief Defined when UART_SIMPLE_MODE_DMA is available
+ ******************************************************************/
+#if defined(__ADSPSC589_FAMILY__) || defined(UART_SIM_HOST)
+#define UART_SIMPLE_DMA_SUPPORTED
+#endif
+
 /*!****************************************************************
  * @brief Opaque Simple UART driver handle type.
  ******************************************************************/
@@ -255,6 +275,37 @@ UART_SIMPLE_RESULT uart_setProtocol(sUART *uartHandle,
 UART_SIMPLE_RESULT uart_setTimeouts(sUART *uartHandle,
     int32_t readTimeout, int32_t writeTimeout);
 
+/*!****************************************************************
+ * @brief Simple UART device set transfer mode.
+ *
+ * This function selects interrupt or DMA driven transfers.  Ports
+ * open in interrupt mode.
+ *
+ * In DMA mode the receive DMA runs continuously around the receive
+ * ring, and the data written to the transmit ring is sent by DMA in
+ * contiguous pieces.  The UART has no receive idle-line interrupt so
+ * a blocked reader polls the receive DMA position every
+ * UART_SIMPLE_DMA_POLL_MS mS.  Data is overwritten if a reader falls
+ * a full receive ring behind so size the ring for the data rate.
+ * The rings are not accessible to DMA from SHARC L1 memory.
+ *
+ * Pending transmit data is sent and unread receive data is discarded
+ * when the mode changes.
+ *
+ * If using the UART driver under FreeRTOS, this function must be
+ * called after the RTOS has been started.
+ *
+ * This function is thread safe.
+ *
+ * @param [in] uartHandle   A handle to a UART device
+ * @param [in] mode         The transfer mode
+ *
+ * @return Returns UART_SIMPLE_SUCCESS if successful, otherwise
+ *         an error.  UART_SIMPLE_MODE_DMA fails unless
+ *         UART_SIMPLE_DMA_SUPPORTED is defined.
+ ******************************************************************/
+UART_SIMPLE_RESULT uart_setMode(sUART *uartHandle, UART_SIMPLE_MODE mode);
+
 /*!****************************************************************
  * @brief Simple UART read.
  *
@@ -275,7 +326,7 @@ UART_SIMPLE_RESULT uart_setTimeouts(sUART *uartHandle,
  * @return Returns UART_SIMPLE_SUCCESS if successful, otherwise
  *         an error.
  ******************************************************************/
-UART_SIMPLE_RESULT uart_read(sUART *uartHandle, uint8_t *in, uint8_t *inLen);
+UART_SIMPLE_RESULT uart_read(sUART *uartHandle, uint8_t *in, uint32_t *inLen);
 
 /*!****************************************************************
  * @brief Simple UART write.
@@ -297,7 +348,7 @@ UART_SIMPLE_RESULT uart_read(sUART *uartHandle, uint8_t *in, uint8_t *inLen);
  * @return Returns UART_SIMPLE_SUCCESS if successful, otherwise
  *         an error.
  ******************************************************************/
-UART_SIMPLE_RESULT uart_write(sUART *uartHandle, uint8_t *out, uint8_t *outLen);
+UART_SIMPLE_RESULT uart_write(sUART *uartHandle, uint8_t *out, uint32_t *outLen);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -17,7 +17,7 @@
  *     - Fully protected multi-threaded device transfers
  *
  * @file      sdcard_simple.h
- * @version   1.0.1
+ * @version   1.1.0
  * @copyright 2021 Analog Devices, Inc.  All rights reserved.
  *
 */
@@ -42,6 +42,28 @@
     #define SDCARD_UNLOCK()
 #endif
 
+/* Sectors per bounce buffer for unaligned transfers (two buffers) */
+#ifndef SDCARD_BOUNCE_SECTORS
+#define SDCARD_BOUNCE_SECTORS       16
+#endif
+
+/* Asynchronous request queue depth and service task settings */
+#ifndef SDCARD_ASYNC_QUEUE_DEPTH
+#define SDCARD_ASYNC_QUEUE_DEPTH    8
+#endif
+
+#ifndef SDCARD_ASYNC_MERGE
+#define SDCARD_ASYNC_MERGE          4
+#endif
+
+#ifndef SDCARD_ASYNC_TASK_PRIORITY
+#define SDCARD_ASYNC_TASK_PRIORITY  (tskIDLE_PRIORITY + 2)
+#endif
+
+#ifndef SDCARD_ASYNC_STACK_SIZE
+#define SDCARD_ASYNC_STACK_SIZE     (configMINIMAL_STACK_SIZE * 4)
+#endif
+
 
 /* define shorter forms of the ADI transfer types */
 #define TRANS_READ   (ADI_RSI_TRANSFER_DMA_BLCK_READ)
@@ -74,6 +96,7 @@
 #define SD_MMC_CMD12   12
 #define SD_MMC_CMD17   17
 #define SD_MMC_CMD18   18
+#define SD_MMC_CMD23   23
 #define SD_MMC_CMD24   24
 #define SD_MMC_CMD25   25
 #define SD_MMC_CMD55   55
@@ -81,6 +104,7 @@
 #define SD_ACMD41      41
 #define SD_ACMD42      42
 #define SD_ACMD13      13
+#define SD_ACMD51      51
 
 #define SD_MMC_CMD_GO_IDLE_STATE        (SD_MMC_CMD0 | NO_RESPONSE)
 #define SD_MMC_CMD_ALL_SEND_CID         (SD_MMC_CMD2 | R2_RESPONSE)
@@ -91,6 +115,7 @@
 #define SD_MMC_CMD_STOP_TRANSMISSION    (SD_MMC_CMD12 | R1B_RESPONSE)
 #define SD_MMC_CMD_READ_BLOCK           (SD_MMC_CMD17 | R1_RESPONSE)
 #define SD_MMC_CMD_READ_MULTIPLE_BLOCK  (SD_MMC_CMD18 | R1_RESPONSE)
+#define SD_MMC_CMD_SET_BLOCK_COUNT      (SD_MMC_CMD23 | R1_RESPONSE)
 #define SD_MMC_CMD_WRITE_BLOCK          (SD_MMC_CMD24 | R1_RESPONSE)
 #define SD_MMC_CMD_WRITE_MULTIPLE_BLOCK (SD_MMC_CMD25 | R1_RESPONSE)
 #define SD_MMC_CMD_APP_CMD              (SD_MMC_CMD55 | R1_RESPONSE)
@@ -98,6 +123,7 @@
 #define SD_CMD_DISCONNECT_DAT3_PULLUP   (SD_ACMD42 | R1_RESPONSE)
 #define SD_CMD_GET_OCR_VALUE            (SD_ACMD41 | R3_RESPONSE)
 #define SD_CMD_GET_MEMORY_STATUS        (SD_ACMD13 | R1_RESPONSE)
+#define SD_CMD_SEND_SCR                 (SD_ACMD51 | R1_RESPONSE)
 
 /****************************************************
  *  SD OCR Register Bit Masks                       *
@@ -107,6 +133,11 @@
 
 #define CARD_STATUS_READY_FOR_DATA  (1 << 8)
 
+/****************************************************
+ *  SD SCR Register Bit Masks (byte 3, big endian)  *
+ ****************************************************/
+#define SD_SCR_CMD23_SUPPORT        (1 << 1)
+
 typedef enum _SDCARD_CSD_STRUCTURE {
     SDCARD_CSD_STRUCTURE_VERSION_1_0          = 0,
     SDCARD_CSD_STRUCTURE_VERSION_2_0          = 1,
@@ -122,8 +153,20 @@ const unsigned long SDCARD_TRANSFER_MULTIPLIER[16] = {
     0, 10, 12, 13, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 70, 80
 };
 
+#ifdef FREE_RTOS
+typedef struct _SDCARD_ASYNC_REQ {
+    bool read;
+    uint8_t *data;
+    uint32_t sector;
+    uint32_t count;
+    SDCARD_SIMPLE_CALLBACK cb;
+    void *usrPtr;
+} SDCARD_ASYNC_REQ;
+#endif
+
 struct sSDCARD {
-    uint8_t alignedData[512];
+    /* Cache line aligned bounce buffers for unaligned transfers */
+    uint8_t bounce[2][SDCARD_BOUNCE_SECTORS * 512] __attribute__((aligned(64)));
 
     bool open;
 
@@ -132,6 +175,8 @@ struct sSDCARD {
 #ifdef FREE_RTOS
     SemaphoreHandle_t portLock;
     SemaphoreHandle_t cmdBlock;
+    QueueHandle_t asyncQueue;
+    TaskHandle_t asyncTask;
 #else
     volatile bool sdcardDone;
 #endif
@@ -141,13 +186,18 @@ struct sSDCARD {
     uint64_t capacity;
 
     SDCARD_CSD_STRUCTURE csdStruct;
+    bool cmd23;
 
-} __attribute__((aligned(4)));
+} __attribute__((aligned(64)));
 
 
 /* SDCARD port context containers */
 static sSDCARD sdcardContext[SDCARD_END];
 
+#ifdef FREE_RTOS
+static portTASK_FUNCTION_PROTO(sdcard_asyncTask, pvParameters);
+#endif
+
 SDCARD_SIMPLE_RESULT sdcard_init(void)
 {
     SDCARD_SIMPLE_RESULT result = SDCARD_SIMPLE_SUCCESS;
@@ -169,6 +219,18 @@ SDCARD_SIMPLE_RESULT sdcard_init(void)
         if (sdcard->cmdBlock == NULL) {
             result = SDCARD_SIMPLE_ERROR;
         }
+        sdcard->asyncQueue = xQueueCreate(SDCARD_ASYNC_QUEUE_DEPTH,
+            sizeof(SDCARD_ASYNC_REQ));
+        if (sdcard->asyncQueue == NULL) {
+            result = SDCARD_SIMPLE_ERROR;
+        } else {
+            if (xTaskCreate(sdcard_asyncTask, "SDCardAsync",
+                    SDCARD_ASYNC_STACK_SIZE, sdcard,
+                    SDCARD_ASYNC_TASK_PRIORITY, &sdcard->asyncTask) != pdPASS) {
+                sdcard->asyncTask = NULL;
+                result = SDCARD_SIMPLE_ERROR;
+            }
+        }
 #endif
 
         sdcard->open = false;
@@ -189,6 +251,14 @@ SDCARD_SIMPLE_RESULT sdcard_deinit(void)
         sdcard = &sdcardContext[port];
 
 #ifdef FREE_RTOS
+        if (sdcard->asyncTask) {
+            vTaskDelete(sdcard->asyncTask);
+            sdcard->asyncTask = NULL;
+        }
+        if (sdcard->asyncQueue) {
+            vQueueDelete(sdcard->asyncQueue);
+            sdcard->asyncQueue = NULL;
+        }
         if (sdcard->cmdBlock) {
             vSemaphoreDelete(sdcard->cmdBlock);
             sdcard->cmdBlock = NULL;
@@ -387,33 +457,61 @@ abort:
 }
 
 /***********************************************************************
- * Write
+ * Data transfers
  ***********************************************************************/
+#define MAX_RSI_TRANSFER_COUNT (ADI_RSI_MAX_TRANSFER_BYTES / 512)
+
+/*
+ * Starts a single or multi-block transfer.  Multi-block transfers use a
+ * pre-defined block count (CMD23) if the card supports it, otherwise they
+ * must be terminated by sdcard_finishDataTransfer() with a STOP command.
+ *
+ * The data phase runs in the background once this function returns.
+ */
 static SDCARD_SIMPLE_RESULT
-sdcard_submitDataTransfer(sSDCARD *sdcard,
-    uint16_t cmd, bool read, void *data, uint32_t sector, uint32_t count)
+sdcard_startDataTransfer(sSDCARD *sdcard,
+    bool read, void *data, uint32_t sector, uint32_t count)
 {
     SDCARD_SIMPLE_RESULT result = SDCARD_SIMPLE_SUCCESS;
     ADI_RSI_HANDLE rsiHandle = sdcard->rsiHandle;
     ADI_RSI_RESULT rsiResult = ADI_RSI_SUCCESS;
     ADI_RSI_TRANSFER transfer;
+    uint32_t address;
+    uint16_t cmd;
+
+    /* Standard capacity cards are byte addressed */
+    address = sector;
+    if (sdcard->type != SDCARD_TYPE_SD_V2X_HIGH_CAPACITY) {
+        address *= 512;
+    }
 
     result = sdcard_readyForData(sdcard);
     if (result != SDCARD_SIMPLE_SUCCESS) {
         goto abort;
     }
 
+    if ((count > 1) && sdcard->cmd23) {
+        rsiResult = sdcard_SendCommand(sdcard,
+            SD_MMC_CMD_SET_BLOCK_COUNT, count, RESPONSE_SHORT, TRANS_NONE, CRCDIS
+        );
+        if (rsiResult != ADI_RSI_SUCCESS) { goto abort; };
+    }
+
     rsiResult = adi_rsi_SetBlockCntAndLen(rsiHandle, count, 512);
     if (rsiResult != ADI_RSI_SUCCESS) { goto abort; };
     if (read) {
         rsiResult = adi_rsi_SubmitRxBuffer(rsiHandle, data, 512, count);
         transfer = TRANS_READ;
+        cmd = (count > 1) ?
+            SD_MMC_CMD_READ_MULTIPLE_BLOCK : SD_MMC_CMD_READ_BLOCK;
     } else {
         rsiResult = adi_rsi_SubmitTxBuffer(rsiHandle, data, 512, count);
         transfer = TRANS_WRITE;
+        cmd = (count > 1) ?
+            SD_MMC_CMD_WRITE_MULTIPLE_BLOCK : SD_MMC_CMD_WRITE_BLOCK;
     }
     rsiResult = sdcard_SendCommand(sdcard,
-        cmd, sector, RESPONSE_SHORT, transfer, CRCDIS
+        cmd, address, RESPONSE_SHORT, transfer, CRCDIS
     );
 
 abort:
@@ -424,221 +522,294 @@ abort:
     return(result);
 }
 
+/*
+ * Waits for the data phase of a transfer started by
+ * sdcard_startDataTransfer() to complete.
+ */
 static SDCARD_SIMPLE_RESULT
-sdcard_writeUnaligned(sSDCARD *sdcard, void *data, uint32_t sector, uint32_t count)
+sdcard_finishDataTransfer(sSDCARD *sdcard, bool read, uint32_t count)
 {
     SDCARD_SIMPLE_RESULT result = SDCARD_SIMPLE_SUCCESS;
     ADI_RSI_HANDLE rsiHandle = sdcard->rsiHandle;
-    ADI_RSI_RESULT rsiResult = ADI_RSI_SUCCESS;
-    void *txBuf = NULL;
-    uint8_t *inData;
-    unsigned i;
-
-    i = 0;
-    inData = (uint8_t *)data;
-
-    SDCARD_LOCK();
+    ADI_RSI_RESULT rsiResult;
+    void *buf = NULL;
 
-    do {
+    /* This call blocks until complete */
+    if (read) {
+        rsiResult = adi_rsi_GetRxBuffer(rsiHandle, &buf);
+    } else {
+        rsiResult = adi_rsi_GetTxBuffer(rsiHandle, &buf);
+    }
+    if (rsiResult != ADI_RSI_SUCCESS) { goto abort; };
 
-        memcpy(sdcard->alignedData, inData, 512);
-        result = sdcard_submitDataTransfer(sdcard,
-            SD_MMC_CMD_WRITE_BLOCK, false, sdcard->alignedData, sector, 1
+    if ((count > 1) && !sdcard->cmd23) {
+        rsiResult = sdcard_SendCommand(sdcard,
+            SD_MMC_CMD_STOP_TRANSMISSION, 0, RESPONSE_SHORT, TRANS_NONE, CRCDIS
         );
-        if (result != SDCARD_SIMPLE_SUCCESS) { goto abort; };
-
-        /* This call blocks until complete */
-        rsiResult = adi_rsi_GetTxBuffer(rsiHandle, &txBuf);
-        if (rsiResult != ADI_RSI_SUCCESS) { goto abort; };
-
-        count--; sector++; i++; inData += 512;
-
-    } while (count);
+    }
 
 abort:
-    SDCARD_UNLOCK();
     if (rsiResult != ADI_RSI_SUCCESS) {
         result = SDCARD_SIMPLE_ERROR;
     }
 
     return(result);
-
 }
 
-#define MAX_RSI_TRANSFER_COUNT (ADI_RSI_MAX_TRANSFER_BYTES / 512)
-
-SDCARD_SIMPLE_RESULT sdcard_write(sSDCARD *sdcard, void *data, uint32_t sector, uint32_t count)
+/*
+ * Transfers aligned data directly in chunks of up to the maximum
+ * RSI transfer size.
+ */
+static SDCARD_SIMPLE_RESULT
+sdcard_transferAligned(sSDCARD *sdcard,
+    bool read, uint8_t *data, uint32_t sector, uint32_t count)
 {
     SDCARD_SIMPLE_RESULT result = SDCARD_SIMPLE_SUCCESS;
-    ADI_RSI_HANDLE rsiHandle = sdcard->rsiHandle;
-    ADI_RSI_RESULT rsiResult = ADI_RSI_SUCCESS;
     uint32_t transferCount;
-    void *txBuf = NULL;
-    uint16_t cmd;
-
-    if ((sdcard == NULL) || (sdcard->type == SDCARD_UNUSABLE_CARD)) {
-        return(SDCARD_SIMPLE_ERROR);
-    }
-
-    if (sdcard->type != SDCARD_TYPE_SD_V2X_HIGH_CAPACITY) {
-        sector *= 512;
-    }
-
-    /* Must send unaligned data through an aligned DMA buffer */
-    if ((uintptr_t)data & 0x3) {
-        result = sdcard_writeUnaligned(sdcard, data, sector, count);
-        return(result);
-    }
-
-    SDCARD_LOCK();
 
     do {
 
         transferCount = (count > MAX_RSI_TRANSFER_COUNT) ?
             MAX_RSI_TRANSFER_COUNT : count;
 
-        cmd = (transferCount > 1) ?
-            SD_MMC_CMD_WRITE_MULTIPLE_BLOCK : SD_MMC_CMD_WRITE_BLOCK;
-
-        result = sdcard_submitDataTransfer(sdcard,
-            cmd, false, data, sector, transferCount
+        result = sdcard_startDataTransfer(sdcard,
+            read, data, sector, transferCount
         );
-        if (result != SDCARD_SIMPLE_SUCCESS) { goto abort; };
+        if (result != SDCARD_SIMPLE_SUCCESS) { break; };
 
-        /* This call blocks until complete */
-        rsiResult = adi_rsi_GetTxBuffer(rsiHandle, &txBuf);
-        if (rsiResult != ADI_RSI_SUCCESS) { goto abort; };
-
-        if (transferCount > 1) {
-            rsiResult = sdcard_SendCommand(sdcard,
-                SD_MMC_CMD_STOP_TRANSMISSION, 0, RESPONSE_SHORT, TRANS_NONE, CRCDIS
-            );
-            if (rsiResult != ADI_RSI_SUCCESS) { goto abort; };
-        }
+        result = sdcard_finishDataTransfer(sdcard, read, transferCount);
+        if (result != SDCARD_SIMPLE_SUCCESS) { break; };
 
         count -= transferCount; sector += transferCount;
+        data += transferCount * 512;
 
     } while (count);
 
-abort:
-    SDCARD_UNLOCK();
-    if (rsiResult != ADI_RSI_SUCCESS) {
-        result = SDCARD_SIMPLE_ERROR;
-    }
-
     return(result);
 }
 
-/***********************************************************************
- * Read
- ***********************************************************************/
+/*
+ * Transfers unaligned data through the two multi-sector bounce
+ * buffers.  The copy into (write) or out of (read) one bounce buffer
+ * overlaps the DMA transfer of the other.
+ */
 static SDCARD_SIMPLE_RESULT
-sdcard_readUnaligned(sSDCARD *sdcard, void *data, uint32_t sector, uint32_t count)
+sdcard_transferUnaligned(sSDCARD *sdcard,
+    bool read, uint8_t *data, uint32_t sector, uint32_t count)
 {
     SDCARD_SIMPLE_RESULT result = SDCARD_SIMPLE_SUCCESS;
-    ADI_RSI_HANDLE rsiHandle = sdcard->rsiHandle;
-    ADI_RSI_RESULT rsiResult = ADI_RSI_SUCCESS;
-    void *txBuf = NULL;
-    uint8_t *inData;
-    unsigned i;
-
-    i = 0;
-    inData = (uint8_t *)data;
+    uint8_t *prevData = NULL;
+    uint32_t prevCount = 0;
+    uint32_t transferCount;
+    uint32_t nextCount;
+    unsigned b = 0;
 
-    SDCARD_LOCK();
+    transferCount = (count > SDCARD_BOUNCE_SECTORS) ?
+        SDCARD_BOUNCE_SECTORS : count;
+    if (!read) {
+        memcpy(sdcard->bounce[b], data, transferCount * 512);
+    }
 
     do {
 
-        result = sdcard_submitDataTransfer(sdcard,
-            SD_MMC_CMD_READ_BLOCK, true, sdcard->alignedData, sector, 1
+        result = sdcard_startDataTransfer(sdcard,
+            read, sdcard->bounce[b], sector, transferCount
         );
-        if (result != SDCARD_SIMPLE_SUCCESS) { goto abort; };
+        if (result != SDCARD_SIMPLE_SUCCESS) { break; };
 
-        /* This call blocks until complete */
-        rsiResult = adi_rsi_GetRxBuffer(rsiHandle, &txBuf);
-        if (rsiResult != ADI_RSI_SUCCESS) { goto abort; };
+        count -= transferCount; sector += transferCount;
+        nextCount = (count > SDCARD_BOUNCE_SECTORS) ?
+            SDCARD_BOUNCE_SECTORS : count;
+
+        /* Overlap the bounce copies with the transfer in flight */
+        if (read) {
+            if (prevData) {
+                memcpy(prevData, sdcard->bounce[b ^ 1], prevCount * 512);
+            }
+            prevData = data; prevCount = transferCount;
+        } else if (nextCount) {
+            memcpy(sdcard->bounce[b ^ 1], data + transferCount * 512,
+                nextCount * 512);
+        }
 
-        memcpy(inData, sdcard->alignedData, 512);
+        result = sdcard_finishDataTransfer(sdcard, read, transferCount);
+        if (result != SDCARD_SIMPLE_SUCCESS) { break; };
 
-        count--; sector++; i++; inData += 512;
+        data += transferCount * 512;
+        transferCount = nextCount;
+        b ^= 1;
 
     } while (count);
 
-abort:
-    SDCARD_UNLOCK();
-    if (rsiResult != ADI_RSI_SUCCESS) {
-        result = SDCARD_SIMPLE_ERROR;
+    if ((result == SDCARD_SIMPLE_SUCCESS) && prevData) {
+        memcpy(prevData, sdcard->bounce[b ^ 1], prevCount * 512);
     }
 
     return(result);
-
 }
 
-SDCARD_SIMPLE_RESULT sdcard_read(sSDCARD *sdcard, void *data, uint32_t sector, uint32_t count)
+static SDCARD_SIMPLE_RESULT sdcard_transfer(sSDCARD *sdcard,
+    bool read, void *data, uint32_t sector, uint32_t count)
 {
-    SDCARD_SIMPLE_RESULT result = SDCARD_SIMPLE_SUCCESS;
-    ADI_RSI_HANDLE rsiHandle = sdcard->rsiHandle;
-    ADI_RSI_RESULT rsiResult = ADI_RSI_SUCCESS;
-    uint32_t transferCount;
-    void *rxBuf = NULL;
-    uint16_t cmd;
+    SDCARD_SIMPLE_RESULT result;
 
     if ((sdcard == NULL) || (sdcard->type == SDCARD_UNUSABLE_CARD)) {
         return(SDCARD_SIMPLE_ERROR);
     }
 
-    if (sdcard->type != SDCARD_TYPE_SD_V2X_HIGH_CAPACITY) {
-        sector *= 512;
+    if (count == 0) {
+        return(SDCARD_SIMPLE_SUCCESS);
     }
 
-    /* Must send unaligned data through an aligned buffer */
+    SDCARD_LOCK();
+
+    /* Must send unaligned data through an aligned DMA buffer */
     if ((uintptr_t)data & 0x3) {
-        result = sdcard_readUnaligned(sdcard, data, sector, count);
-        return(result);
+        result = sdcard_transferUnaligned(sdcard, read, data, sector, count);
+    } else {
+        result = sdcard_transferAligned(sdcard, read, data, sector, count);
     }
 
-    SDCARD_LOCK();
+    SDCARD_UNLOCK();
 
-    do {
+    return(result);
+}
 
-        transferCount = (count > MAX_RSI_TRANSFER_COUNT) ?
-            MAX_RSI_TRANSFER_COUNT : count;
+/***********************************************************************
+ * Write
+ ***********************************************************************/
+SDCARD_SIMPLE_RESULT sdcard_write(sSDCARD *sdcard, void *data, uint32_t sector, uint32_t count)
+{
+    return(sdcard_transfer(sdcard, false, data, sector, count));
+}
 
-        cmd = (transferCount > 1) ?
-            SD_MMC_CMD_READ_MULTIPLE_BLOCK : SD_MMC_CMD_READ_BLOCK;
+/***********************************************************************
+ * Read
+ ***********************************************************************/
+SDCARD_SIMPLE_RESULT sdcard_read(sSDCARD *sdcard, void *data, uint32_t sector, uint32_t count)
+{
+    return(sdcard_transfer(sdcard, true, data, sector, count));
+}
 
-        result = sdcard_submitDataTransfer(sdcard,
-            cmd, true, data, sector, transferCount
-        );
-        if (result != SDCARD_SIMPLE_SUCCESS) { goto abort; };
+/***********************************************************************
+ * Asynchronous transfers
+ ***********************************************************************/
+#ifdef FREE_RTOS
 
-        /* This call blocks until complete */
-        rsiResult = adi_rsi_GetRxBuffer(rsiHandle, &rxBuf);
+/*
+ * Services queued requests in order.  Back-to-back requests in the same
+ * direction which are contiguous both on the card and in memory are
+ * merged into a single transfer.
+ */
+static portTASK_FUNCTION(sdcard_asyncTask, pvParameters)
+{
+    sSDCARD *sdcard = (sSDCARD *)pvParameters;
+    SDCARD_ASYNC_REQ req[SDCARD_ASYNC_MERGE];
+    SDCARD_ASYNC_REQ next;
+    SDCARD_SIMPLE_RESULT result;
+    uint32_t count;
+    unsigned n, i;
 
-        if (transferCount > 1) {
-            rsiResult = sdcard_SendCommand(sdcard,
-                SD_MMC_CMD_STOP_TRANSMISSION, 0, RESPONSE_SHORT, TRANS_NONE, CRCDIS
-            );
-            if (rsiResult != ADI_RSI_SUCCESS) { goto abort; };
+    while (1) {
+
+        xQueueReceive(sdcard->asyncQueue, &req[0], portMAX_DELAY);
+        count = req[0].count;
+
+        for (n = 1; n < SDCARD_ASYNC_MERGE; n++) {
+            if (xQueuePeek(sdcard->asyncQueue, &next, 0) != pdTRUE) {
+                break;
+            }
+            if ((next.read != req[0].read) ||
+                (next.sector != req[0].sector + count) ||
+                (next.data != req[0].data + count * 512)) {
+                break;
+            }
+            xQueueReceive(sdcard->asyncQueue, &req[n], 0);
+            count += req[n].count;
         }
 
-        count -= transferCount; sector += transferCount;
+        result = sdcard_transfer(sdcard,
+            req[0].read, req[0].data, req[0].sector, count
+        );
 
-    } while (count);
+        for (i = 0; i < n; i++) {
+            if (req[i].cb) {
+                req[i].cb(sdcard, result, req[i].usrPtr);
+            }
+        }
+    }
+}
 
-abort:
-    SDCARD_UNLOCK();
+static SDCARD_SIMPLE_RESULT sdcard_submitAsync(sSDCARD *sdcard,
+    bool read, void *data, uint32_t sector, uint32_t count,
+    SDCARD_SIMPLE_CALLBACK cb, void *usrPtr)
+{
+    SDCARD_ASYNC_REQ req;
 
-    if (rsiResult != ADI_RSI_SUCCESS) {
-        result = SDCARD_SIMPLE_ERROR;
+    if ((sdcard == NULL) || (sdcard->asyncQueue == NULL)) {
+        return(SDCARD_SIMPLE_ERROR);
     }
 
-    return(result);
+    req.read = read;
+    req.data = (uint8_t *)data;
+    req.sector = sector;
+    req.count = count;
+    req.cb = cb;
+    req.usrPtr = usrPtr;
+
+    /* Blocks while the queue is full */
+    xQueueSend(sdcard->asyncQueue, &req, portMAX_DELAY);
+
+    return(SDCARD_SIMPLE_SUCCESS);
 }
 
+SDCARD_SIMPLE_RESULT sdcard_writeAsync(sSDCARD *sdcard, void *data,
+    uint32_t sector, uint32_t count, SDCARD_SIMPLE_CALLBACK cb, void *usrPtr)
+{
+    return(sdcard_submitAsync(sdcard, false, data, sector, count, cb, usrPtr));
+}
+
+SDCARD_SIMPLE_RESULT sdcard_readAsync(sSDCARD *sdcard, void *data,
+    uint32_t sector, uint32_t count, SDCARD_SIMPLE_CALLBACK cb, void *usrPtr)
+{
+    return(sdcard_submitAsync(sdcard, true, data, sector, count, cb, usrPtr));
+}
+
+#endif
+
 /***********************************************************************
  * Identify / Init
  ***********************************************************************/
+
+/*
+ * Reads the SCR register and returns true if the card supports
+ * SET_BLOCK_COUNT (CMD23).  Failures just disable CMD23.
+ */
+static bool sdcard_cmd23Supported(sSDCARD *sdcard)
+{
+    ADI_RSI_HANDLE rsiHandle = sdcard->rsiHandle;
+    ADI_RSI_RESULT rsiResult;
+    uint8_t *scr = sdcard->bounce[0];
+    void *rxBuf = NULL;
+
+    rsiResult = sdcard_SendCommand(sdcard,
+        SD_MMC_CMD_APP_CMD, sdcard->rca, RESPONSE_SHORT, TRANS_NONE, CRCDIS
+    );
+    if (rsiResult != ADI_RSI_SUCCESS) { return(false); }
+
+    rsiResult = adi_rsi_SetBlockCntAndLen(rsiHandle, 1, 8);
+    if (rsiResult != ADI_RSI_SUCCESS) { return(false); }
+    rsiResult = adi_rsi_SubmitRxBuffer(rsiHandle, scr, 8, 1);
+    if (rsiResult != ADI_RSI_SUCCESS) { return(false); }
+    rsiResult = sdcard_SendCommand(sdcard,
+        SD_CMD_SEND_SCR, 0, RESPONSE_SHORT, TRANS_READ, CRCDIS
+    );
+    if (rsiResult != ADI_RSI_SUCCESS) { return(false); }
+    rsiResult = adi_rsi_GetRxBuffer(rsiHandle, &rxBuf);
+    if (rsiResult != ADI_RSI_SUCCESS) { return(false); }
+
+    return((scr[3] & SD_SCR_CMD23_SUPPORT) != 0);
+}
 static void sdcard_SetSpeed(sSDCARD *sdcard,
     uint32_t sclk, uint32_t cardSpeed)
 {
@@ -704,6 +875,7 @@ static SDCARD_SIMPLE_RESULT sdcard_Start(sSDCARD *sdcard)
     /* Reset card info */
     sdcard->type = SDCARD_UNUSABLE_CARD;
     sdcard->capacity = 0;
+    sdcard->cmd23 = false;
 
     /* Set speed to 400KHz for identification */
     sdcard_SetSpeed(sdcard, SDCLK, 400000);
@@ -806,6 +978,10 @@ static SDCARD_SIMPLE_RESULT sdcard_Start(sSDCARD *sdcard)
     );
     if (rsiResult != ADI_RSI_SUCCESS) { goto abort; }
     rsiResult = adi_rsi_SetBusWidth(rsiHandle, 4);
+    if (rsiResult != ADI_RSI_SUCCESS) { goto abort; }
+
+    /* Check for pre-defined multi-block transfer (CMD23) support */
+    sdcard->cmd23 = sdcard_cmd23Supported(sdcard);
 
 abort:
     if (rsiResult != ADI_RSI_SUCCESS) {
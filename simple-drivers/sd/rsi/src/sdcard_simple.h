@@ -17,7 +17,7 @@
  *     - Fully protected multi-threaded device transfers
  *
  * @file      sdcard_simple.h
- * @version   1.0.0
+ * @version   1.1.0
  * @copyright 2021 Analog Devices, Inc.  All rights reserved.
  *
 */
@@ -89,6 +89,14 @@ typedef struct _SDCARD_SIMPLE_INFO {
  ******************************************************************/
 typedef struct sSDCARD sSDCARD;
 
+/*!****************************************************************
+ * @brief Asynchronous transfer completion callback.
+ *
+ * Called from the SDCARD service task once the transfer completes.
+ ******************************************************************/
+typedef void (*SDCARD_SIMPLE_CALLBACK)(sSDCARD *sdcard,
+    SDCARD_SIMPLE_RESULT result, void *usrPtr);
+
 #ifdef __cplusplus
 extern "C"{
 #endif
@@ -172,6 +180,33 @@ SDCARD_SIMPLE_RESULT sdcard_read(sSDCARD *sdcard, void *data, uint32_t sector, u
 
 SDCARD_SIMPLE_RESULT sdcard_readyForData(sSDCARD *sdcard);
 
+/*!****************************************************************
+ * @brief Simple SDCARD driver asynchronous block transfers.
+ *
+ * These functions queue a transfer to the per-port SDCARD service
+ * task and return immediately.  The data buffer must remain valid
+ * until 'cb' is called.  Queued requests are serviced in order and
+ * requests contiguous on the card and in memory are merged into one
+ * multi-block transfer.  These functions block while the request
+ * queue is full.
+ *
+ * Only available with FreeRTOS.
+ *
+ * @param [in]  sdcard     SDCARD handle
+ * @param [in]  data       Data buffer (any alignment)
+ * @param [in]  sector     Start sector
+ * @param [in]  count      Number of sectors
+ * @param [in]  cb         Completion callback (may be NULL)
+ * @param [in]  usrPtr     User pointer passed to the callback
+ *
+ * @return Returns SDCARD_SIMPLE_SUCCESS if queued, otherwise
+ *         an error.
+ ******************************************************************/
+SDCARD_SIMPLE_RESULT sdcard_writeAsync(sSDCARD *sdcard, void *data,
+    uint32_t sector, uint32_t count, SDCARD_SIMPLE_CALLBACK cb, void *usrPtr);
+SDCARD_SIMPLE_RESULT sdcard_readAsync(sSDCARD *sdcard, void *data,
+    uint32_t sector, uint32_t count, SDCARD_SIMPLE_CALLBACK cb, void *usrPtr);
+
 
 #ifdef __cplusplus
 } // extern "C"
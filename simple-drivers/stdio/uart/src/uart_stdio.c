@@ -56,7 +56,7 @@ static int uart_stdio_dev_write(int fh, unsigned char *ptr, int len)
 {
     UART_SIMPLE_RESULT uartResult;
     unsigned char buf[20];
-    uint8_t b;
+    uint32_t b;
     int i;
 
     if (!stdioUartHandle) {
@@ -87,14 +87,13 @@ static int uart_stdio_dev_write(int fh, unsigned char *ptr, int len)
 
 static int uart_stdio_dev_read(int fh, unsigned char *buffer, int len)
 {
-    uint8_t readLen = len;
+    uint32_t readLen = len;
     UART_SIMPLE_RESULT uartResult;
 
     if (!stdioUartHandle) {
         return(-1);
     }
 
-    readLen = (len > 255) ? 255 : len;
     uartResult = uart_read(stdioUartHandle, buffer, &readLen);
 
     if (readLen == 0) {
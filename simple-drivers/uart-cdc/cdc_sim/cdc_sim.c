@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#include <string.h>
+
+#include "cdc_sim.h"
+
+#define CDC_SIM_MAX_PACKET      (512)
+
+CDC_SIM_STATS cdc_sim_stats;
+
+static CDC_TX_COMPLETE_CALLBACK txCB = NULL;
+static void *txUsrPtr = NULL;
+static CDC_RX_COMPLETE_CALLBACK rxCB = NULL;
+static void *rxUsrPtr = NULL;
+static CDC_RX_BUFFER_CALLBACK rxBufferCB = NULL;
+static void *rxBufferUsrPtr = NULL;
+
+static bool txBusy = false;
+static bool rxPaused = false;
+static uint8_t rxPending[CDC_SIM_MAX_PACKET];
+static unsigned short rxPendingLen;
+
+void cdc_sim_reset(void)
+{
+    memset(&cdc_sim_stats, 0, sizeof(cdc_sim_stats));
+    txBusy = false;
+    rxPaused = false;
+}
+
+/* As cdc_serial_data_received() and its completion */
+static bool cdc_sim_rx_transfer(const uint8_t *data, unsigned short length)
+{
+    unsigned char *buf;
+
+    buf = rxBufferCB ? rxBufferCB(length, rxBufferUsrPtr) : NULL;
+    if (buf == NULL) {
+        return(false);
+    }
+    memcpy(buf, data, length);
+    cdc_sim_stats.rxPackets++;
+    if (rxCB) {
+        rxCB(buf, length, rxUsrPtr);
+    }
+
+    return(true);
+}
+
+bool cdc_sim_rx(const uint8_t *data, unsigned short length)
+{
+    if (rxPaused || (length > CDC_SIM_MAX_PACKET)) {
+        return(false);
+    }
+
+    if (!cdc_sim_rx_transfer(data, length)) {
+        memcpy(rxPending, data, length);
+        rxPendingLen = length;
+        rxPaused = true;
+        cdc_sim_stats.rxPauses++;
+        return(false);
+    }
+
+    return(true);
+}
+
+bool cdc_sim_rx_paused(void)
+{
+    return(rxPaused);
+}
+
+void cdc_rx_resume(void)
+{
+    /* The library offers the paused transfer again */
+    if (rxPaused) {
+        rxPaused = false;
+        cdc_sim_stats.rxResumes++;
+        if (!cdc_sim_rx_transfer(rxPending, rxPendingLen)) {
+            rxPaused = true;
+            cdc_sim_stats.rxPauses++;
+        }
+    }
+}
+
+CLD_USB_Data_Transmit_Return_Type cdc_tx_serial_data(unsigned short length,
+    unsigned char *p_buffer, unsigned timeout)
+{
+    CDC_SIM_STATS *s = &cdc_sim_stats;
+
+    if (txBusy) {
+        s->txBusy++;
+        return(CLD_USB_TRANSMIT_FAILED);
+    }
+    if ((length > CDC_SIM_MAX_PACKET) || (s->txTransfers >= CDC_SIM_MAX_TX) ||
+        (s->txBytes + length > CDC_SIM_MAX_TX_BYTES)) {
+        return(CLD_USB_TRANSMIT_FAILED);
+    }
+
+    s->txLen[s->txTransfers++] = length;
+    if (length == 0) {
+        s->txZlps++;
+    }
+    memcpy(s->txData + s->txBytes, p_buffer, length);
+    s->txBytes += length;
+    txBusy = true;
+
+    return(CLD_USB_TRANSMIT_SUCCESSFUL);
+}
+
+bool cdc_sim_tx_done(void)
+{
+    if (!txBusy) {
+        return(false);
+    }
+
+    txBusy = false;
+    if (txCB) {
+        txCB(CDC_TX_STATUS_OK, txUsrPtr);
+    }
+
+    return(true);
+}
+
+bool cdc_sim_tx_busy(void)
+{
+    return(txBusy);
+}
+
+void cdc_register_tx_callback(CDC_TX_COMPLETE_CALLBACK cb, void *usrPtr)
+{
+    txCB = cb;
+    txUsrPtr = usrPtr;
+}
+
+void cdc_register_rx_callback(CDC_RX_COMPLETE_CALLBACK cb, void *usrPtr)
+{
+    rxCB = cb;
+    rxUsrPtr = usrPtr;
+}
+
+void cdc_register_rx_buffer_callback(CDC_RX_BUFFER_CALLBACK cb, void *usrPtr)
+{
+    rxBufferCB = cb;
+    rxBufferUsrPtr = usrPtr;
+}
@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host (Linux) stand-in for the cdc.c interface of the CLD UAC+CDC
+ * library so uart_simple_cdc.c can be tested without hardware.  The
+ * test plays the part of the USB host and interrupt: cdc_sim_rx()
+ * offers an OUT packet the way cdc_serial_data_received() does and is
+ * paused (NAKed) while the driver has no buffer, and cdc_sim_tx_done()
+ * completes the IN transfer in progress.  Every IN transfer is
+ * recorded.
+ *
+ * Build uart_simple_cdc.c with CDC_SIM_HOST defined.
+ */
+
+#ifndef _cdc_sim_h
+#define _cdc_sim_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Maximum recorded IN transfers and bytes */
+#define CDC_SIM_MAX_TX          (4096)
+#define CDC_SIM_MAX_TX_BYTES    (1024 * 1024)
+
+/* CLD library stand-ins */
+typedef enum {
+    CLD_USB_TRANSMIT_SUCCESSFUL = 0,
+    CLD_USB_TRANSMIT_FAILED,
+} CLD_USB_Data_Transmit_Return_Type;
+
+/* cdc.h interface */
+typedef enum _CDC_TX_STATUS {
+    CDC_TX_STATUS_UNKNOWN = 0,
+    CDC_TX_STATUS_OK,
+    CDC_TX_STATUS_TIMEOUT
+} CDC_TX_STATUS;
+
+typedef void (*CDC_TX_COMPLETE_CALLBACK)(CDC_TX_STATUS status, void *usrPtr);
+typedef void (*CDC_RX_COMPLETE_CALLBACK)(unsigned char *p_buffer,
+    unsigned short length, void *usrPtr);
+typedef unsigned char *(*CDC_RX_BUFFER_CALLBACK)(unsigned short length,
+    void *usrPtr);
+
+CLD_USB_Data_Transmit_Return_Type cdc_tx_serial_data(unsigned short length,
+    unsigned char *p_buffer, unsigned timeout);
+
+void cdc_register_tx_callback(CDC_TX_COMPLETE_CALLBACK cb, void *usrPtr);
+void cdc_register_rx_callback(CDC_RX_COMPLETE_CALLBACK cb, void *usrPtr);
+void cdc_register_rx_buffer_callback(CDC_RX_BUFFER_CALLBACK cb, void *usrPtr);
+void cdc_rx_resume(void);
+
+/* Simulator state */
+typedef struct _CDC_SIM_STATS {
+    uint32_t rxPackets;             /* OUT packets accepted */
+    uint32_t rxPauses;              /* OUT packets NAKed */
+    uint32_t rxResumes;             /* Paused transfers resumed */
+    uint32_t txTransfers;           /* IN transfers, ZLPs included */
+    uint32_t txZlps;                /* Zero length IN transfers */
+    uint32_t txBusy;                /* IN transfers started while busy */
+    uint16_t txLen[CDC_SIM_MAX_TX]; /* Length of each IN transfer */
+    uint32_t txBytes;               /* IN bytes */
+    uint8_t txData[CDC_SIM_MAX_TX_BYTES];
+} CDC_SIM_STATS;
+
+extern CDC_SIM_STATS cdc_sim_stats;
+
+/* Reset the statistics and any paused or in progress transfer */
+void cdc_sim_reset(void);
+
+/*
+ * Offer an OUT packet.  Returns true if it was received, false if the
+ * transfer was paused.  A paused packet is received by the
+ * cdc_rx_resume() which frees a buffer, and no other may be offered
+ * meanwhile.
+ */
+bool cdc_sim_rx(const uint8_t *data, unsigned short length);
+
+/* True while an OUT packet is paused */
+bool cdc_sim_rx_paused(void);
+
+/*
+ * Complete the IN transfer in progress, which may start the next one
+ * from the callback.  Returns false if none was in progress.
+ */
+bool cdc_sim_tx_done(void);
+
+/* True while an IN transfer is in progress */
+bool cdc_sim_tx_busy(void);
+
+#endif
@@ -0,0 +1,407 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host test of the uart_simple_cdc packet queues against cdc_sim.
+ *
+ * Receive: once every receive packet is full the next OUT packet must
+ * be paused, stay paused while the reader only consumes part of a
+ * packet and be received by the release of a packet.  A random stream
+ * of OUT packets, zero length ones included, is then read back in
+ * random sizes through uart_cdc_read() and uart_cdc_rxAcquire() and
+ * must arrive intact, with the host paused along the way.
+ *
+ * Transmit: writes of fixed sizes must be sent in 512 byte transfers
+ * followed by a zero length packet exactly when the last transfer is a
+ * multiple of 64 bytes, 512 included.  A random stream of writes and
+ * transfer completions must arrive intact and follow the same rule,
+ * and a transfer must never be started while one is in progress.
+ *
+ * All reads and writes are non-blocking, the test completes the
+ * transfers itself.  It exits with 2 on a failure.
+ *
+ * Build from the 'uart-cdc' directory with:
+ *   gcc -O2 -DCDC_SIM_HOST -I. -Icdc_sim -I../peripherals/inc \
+ *       -o uart_cdc_test cdc_sim/uart_cdc_test.c cdc_sim/cdc_sim.c \
+ *       uart_simple_cdc.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "uart_simple_cdc.h"
+#include "cdc_sim.h"
+
+#define TEST_PACKET         (512)
+#define TEST_ZLP_MULTIPLE   (64)
+#define TEST_MAX_STREAM     (CDC_SIM_MAX_TX_BYTES / 2)
+
+typedef struct {
+    uint32_t len;
+    uint32_t transfers;
+    uint16_t expect[8];
+} TEST_TX_CASE;
+
+/* Write length, then the transfers it must be sent in */
+static const TEST_TX_CASE txCases[] = {
+    {  512, 2, { 512, 0 } },
+    {  511, 1, { 511 } },
+    {  100, 1, { 100 } },
+    {   64, 2, { 64, 0 } },
+    {  128, 2, { 128, 0 } },
+    { 1000, 2, { 512, 488 } },
+    { 1024, 3, { 512, 512, 0 } },
+    { 1088, 4, { 512, 512, 64, 0 } },
+    { 2048, 5, { 512, 512, 512, 512, 0 } },
+};
+
+static uint8_t sent[TEST_MAX_STREAM];
+static uint8_t received[TEST_MAX_STREAM];
+static uint8_t buf[4 * TEST_PACKET];
+
+static uint32_t rngState;
+
+static uint32_t test_rand(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return(rngState);
+}
+
+static void test_fill(uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        data[i] = test_rand();
+    }
+}
+
+/* Read whatever is queued, up to 'max' bytes */
+static uint32_t test_read(sUART *uart, uint8_t *data, uint32_t max)
+{
+    uint32_t len = max;
+
+    uart_cdc_read(uart, data, &len);
+    return(len);
+}
+
+static int test_rx_pause(sUART *uart)
+{
+    uint32_t n, got;
+    int fails = 0;
+
+    cdc_sim_reset();
+    test_fill(sent, (UART_CDC_RX_PACKETS + 1) * TEST_PACKET);
+
+    /* Fill every packet */
+    for (n = 0; n < UART_CDC_RX_PACKETS; n++) {
+        if (!cdc_sim_rx(sent + n * TEST_PACKET, TEST_PACKET)) {
+            printf("rx pause: packet %u not received\n", n);
+            return(1);
+        }
+    }
+    if (cdc_sim_rx(sent + n * TEST_PACKET, TEST_PACKET) ||
+        !cdc_sim_rx_paused() || (cdc_sim_stats.rxPauses != 1)) {
+        printf("rx pause: not paused with every packet full\n");
+        return(1);
+    }
+
+    /* Part of a packet does not free it */
+    got = test_read(uart, received, 100);
+    if ((got != 100) || !cdc_sim_rx_paused()) {
+        printf("rx pause: resumed by a partial read\n");
+        fails++;
+    }
+    got += test_read(uart, received + got, TEST_PACKET - got);
+    if ((got != TEST_PACKET) || cdc_sim_rx_paused() ||
+        (cdc_sim_stats.rxResumes != 1) ||
+        (cdc_sim_stats.rxPackets != UART_CDC_RX_PACKETS + 1)) {
+        printf("rx pause: not resumed by the release\n");
+        fails++;
+    }
+
+    /* Everything arrives in order */
+    got += test_read(uart, received + got, sizeof(received) - got);
+    if ((got != (UART_CDC_RX_PACKETS + 1) * TEST_PACKET) ||
+        (memcmp(sent, received, got) != 0)) {
+        printf("rx pause: %u bytes read, contents %s\n", got,
+            memcmp(sent, received, got) ? "wrong" : "ok");
+        fails++;
+    }
+    if (test_read(uart, received, sizeof(received)) != 0) {
+        printf("rx pause: data left over\n");
+        fails++;
+    }
+
+    return(fails);
+}
+
+static int test_rx_stream(sUART *uart, uint32_t bytes)
+{
+    uint32_t nsent = 0, ngot = 0;
+    uint32_t len, k, done, idle = 0;
+    uint8_t *data;
+
+    cdc_sim_reset();
+    while (((nsent < bytes) || (ngot < nsent)) && (idle < 1000)) {
+        done = nsent + ngot;
+        if ((nsent < bytes) && !cdc_sim_rx_paused() &&
+            (test_rand() % 3 != 0)) {
+            /* Mostly full packets, some short and some empty */
+            k = test_rand() % 8;
+            len = (k < 5) ? TEST_PACKET : test_rand() % TEST_PACKET;
+            if (k == 7) {
+                len = 0;
+            }
+            if (len > bytes - nsent) {
+                len = bytes - nsent;
+            }
+            test_fill(sent + nsent, len);
+            cdc_sim_rx(sent + nsent, len);
+            nsent += len;
+        } else if (test_rand() % 2) {
+            ngot += test_read(uart, received + ngot,
+                1 + test_rand() % (2 * TEST_PACKET));
+        } else {
+            uart_cdc_rxAcquire(uart, &data, &len);
+            if (data) {
+                memcpy(received + ngot, data, len);
+                ngot += len;
+                uart_cdc_rxRelease(uart);
+            }
+        }
+        if (ngot > nsent) {
+            break;
+        }
+        /* A host left paused stalls the stream */
+        idle = (nsent + ngot == done) ? idle + 1 : 0;
+    }
+
+    if ((ngot != nsent) || (memcmp(sent, received, nsent) != 0)) {
+        printf("rx stream: %u bytes sent, %u read, contents %s\n", nsent,
+            ngot, memcmp(sent, received, nsent) ? "wrong" : "ok");
+        return(1);
+    }
+    if ((cdc_sim_stats.rxPauses == 0) ||
+        (cdc_sim_stats.rxResumes != cdc_sim_stats.rxPauses)) {
+        printf("rx stream: %u pauses, %u resumes\n",
+            cdc_sim_stats.rxPauses, cdc_sim_stats.rxResumes);
+        return(1);
+    }
+
+    printf("rx: %u bytes in %u packets, %u pauses\n", nsent,
+        cdc_sim_stats.rxPackets, cdc_sim_stats.rxPauses);
+
+    return(0);
+}
+
+/* Complete every queued transfer */
+static void test_tx_drain(void)
+{
+    while (cdc_sim_tx_done());
+}
+
+/* Zero length packets only follow a transfer of a multiple of 64 bytes */
+static int test_tx_zlps(const char *what)
+{
+    const CDC_SIM_STATS *s = &cdc_sim_stats;
+    uint32_t i;
+
+    for (i = 0; i < s->txTransfers; i++) {
+        if ((s->txLen[i] == 0) &&
+            ((i == 0) || (s->txLen[i - 1] == 0) ||
+            ((s->txLen[i - 1] % TEST_ZLP_MULTIPLE) != 0))) {
+            printf("%s: stray zero length packet %u\n", what, i);
+            return(1);
+        }
+    }
+    if (s->txBusy) {
+        printf("%s: %u transfers started while busy\n", what, s->txBusy);
+        return(1);
+    }
+
+    return(0);
+}
+
+static int test_tx_cases(sUART *uart)
+{
+    const TEST_TX_CASE *c;
+    uint32_t i, len;
+    int fails = 0;
+
+    for (i = 0; i < sizeof(txCases) / sizeof(txCases[0]); i++) {
+        c = &txCases[i];
+        cdc_sim_reset();
+        test_fill(sent, c->len);
+        len = c->len;
+        if ((uart_cdc_write(uart, sent, &len) != UART_SIMPLE_SUCCESS) ||
+            (len != c->len)) {
+            printf("tx %u: write failed\n", c->len);
+            fails++;
+            continue;
+        }
+        test_tx_drain();
+        if ((cdc_sim_stats.txTransfers != c->transfers) ||
+            (memcmp(cdc_sim_stats.txLen, c->expect,
+                c->transfers * sizeof(c->expect[0])) != 0) ||
+            (cdc_sim_stats.txBytes != c->len) ||
+            (memcmp(cdc_sim_stats.txData, sent, c->len) != 0)) {
+            printf("tx %u: sent as %u transfers, contents %s\n", c->len,
+                cdc_sim_stats.txTransfers,
+                memcmp(cdc_sim_stats.txData, sent, c->len) ? "wrong" : "ok");
+            fails++;
+        }
+        fails += test_tx_zlps("tx case");
+    }
+
+    /* A write during the zero length packet follows it */
+    cdc_sim_reset();
+    test_fill(sent, TEST_PACKET + 100);
+    len = TEST_PACKET;
+    uart_cdc_write(uart, sent, &len);
+    cdc_sim_tx_done();
+    len = 100;
+    uart_cdc_write(uart, sent + TEST_PACKET, &len);
+    test_tx_drain();
+    if ((cdc_sim_stats.txTransfers != 3) || (cdc_sim_stats.txLen[1] != 0) ||
+        (cdc_sim_stats.txLen[2] != 100) ||
+        (memcmp(cdc_sim_stats.txData, sent, TEST_PACKET + 100) != 0)) {
+        printf("tx: write during the zero length packet lost\n");
+        fails++;
+    }
+
+    /* A full queue refuses the rest of a non-blocking write */
+    cdc_sim_reset();
+    test_fill(sent, (UART_CDC_TX_PACKETS + 1) * TEST_PACKET);
+    len = (UART_CDC_TX_PACKETS + 1) * TEST_PACKET;
+    if ((uart_cdc_write(uart, sent, &len) == UART_SIMPLE_SUCCESS) ||
+        (len != UART_CDC_TX_PACKETS * TEST_PACKET)) {
+        printf("tx: full queue wrote %u bytes\n", len);
+        fails++;
+    }
+    test_tx_drain();
+    if (cdc_sim_stats.txZlps != 1) {
+        printf("tx: full queue sent %u zero length packets\n",
+            cdc_sim_stats.txZlps);
+        fails++;
+    }
+
+    return(fails);
+}
+
+static int test_tx_stream(sUART *uart, uint32_t bytes)
+{
+    uint32_t nsent = 0;
+    uint32_t len, k, last;
+
+    cdc_sim_reset();
+    while (nsent < bytes) {
+        if (test_rand() % 3 == 0) {
+            cdc_sim_tx_done();
+            continue;
+        }
+        /* Mostly packet and ZLP multiples, some odd sizes */
+        k = test_rand() % 4;
+        if (k == 0) {
+            len = TEST_PACKET;
+        } else if (k == 1) {
+            len = TEST_ZLP_MULTIPLE * (1 + test_rand() % 16);
+        } else {
+            len = 1 + test_rand() % sizeof(buf);
+        }
+        if (len > bytes - nsent) {
+            len = bytes - nsent;
+        }
+        test_fill(sent + nsent, len);
+        uart_cdc_write(uart, sent + nsent, &len);
+        nsent += len;
+    }
+    test_tx_drain();
+
+    if ((cdc_sim_stats.txBytes != nsent) ||
+        (memcmp(cdc_sim_stats.txData, sent, nsent) != 0)) {
+        printf("tx stream: %u bytes written, %u sent, contents %s\n", nsent,
+            cdc_sim_stats.txBytes,
+            memcmp(cdc_sim_stats.txData, sent, nsent) ? "wrong" : "ok");
+        return(1);
+    }
+    if (test_tx_zlps("tx stream")) {
+        return(1);
+    }
+
+    /* The stream ends with a zero length packet if it must */
+    k = cdc_sim_stats.txTransfers;
+    last = cdc_sim_stats.txLen[k - 1];
+    if ((last != 0) && ((last % TEST_ZLP_MULTIPLE) == 0)) {
+        printf("tx stream: no final zero length packet\n");
+        return(1);
+    }
+
+    printf("tx: %u bytes in %u transfers, %u zero length\n", nsent,
+        cdc_sim_stats.txTransfers, cdc_sim_stats.txZlps);
+
+    return(0);
+}
+
+static void usage(void)
+{
+    printf("uart_cdc_test [options]\n");
+    printf("  -n <bytes>   Bytes per random stream (262144, max %u)\n",
+        TEST_MAX_STREAM);
+    printf("  -s <seed>    Random seed (1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t bytes = 256 * 1024, seed = 1;
+    sUART *uart;
+    int fails = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (c) {
+            case 'n': bytes = strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            default: usage(); return(1);
+        }
+    }
+    if ((bytes == 0) || (bytes > TEST_MAX_STREAM)) {
+        usage();
+        return(1);
+    }
+    rngState = seed ? seed : 1;
+
+    if ((uart_cdc_init() != UART_SIMPLE_SUCCESS) ||
+        (uart_cdc_open(UART0, &uart) != UART_SIMPLE_SUCCESS) ||
+        (uart_cdc_setTimeouts(uart, UART_SIMPLE_TIMEOUT_NONE,
+            UART_SIMPLE_TIMEOUT_NONE) != UART_SIMPLE_SUCCESS)) {
+        printf("uart_cdc_open failed\n");
+        return(1);
+    }
+
+    fails += test_rx_pause(uart);
+    fails += test_rx_stream(uart, bytes);
+    fails += test_tx_cases(uart);
+    fails += test_tx_stream(uart, bytes);
+
+    uart_cdc_close(&uart);
+    uart_cdc_deinit();
+
+    printf("%d failed\n", fails);
+
+    return(fails ? 2 : 0);
+}
@@ -275,7 +275,7 @@ UART_SIMPLE_RESULT uart_setTimeouts(sUART *uartHandle,
  * @return Returns UART_SIMPLE_SUCCESS if successful, otherwise
  *         an error.
  ******************************************************************/
-UART_SIMPLE_RESULT uart_read(sUART *uartHandle, uint8_t *in, uint8_t *inLen);
+UART_SIMPLE_RESULT uart_read(sUART *uartHandle, uint8_t *in, uint32_t *inLen);
 
 /*!****************************************************************
  * @brief Simple UART write.
@@ -297,7 +297,7 @@ UART_SIMPLE_RESULT uart_read(sUART *uartHandle, uint8_t *in, uint8_t *inLen);
  * @return Returns UART_SIMPLE_SUCCESS if successful, otherwise
  *         an error.
  ******************************************************************/
-UART_SIMPLE_RESULT uart_write(sUART *uartHandle, uint8_t *out, uint8_t *outLen);
+UART_SIMPLE_RESULT uart_write(sUART *uartHandle, uint8_t *out, uint32_t *outLen);
 
 #ifdef __cplusplus
 } // extern "C"
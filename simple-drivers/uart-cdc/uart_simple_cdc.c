@@ -17,6 +17,7 @@
  *     - FreeRTOS or no RTOS main-loop modes
  *     - Fully protected multi-threaded device transfers
  *     - Blocking transfers
+ *     - Queued bulk packets with zero-copy access
  *
  * Copyright 2020 Analog Devices, Inc.  All rights reserved.
  *
@@ -35,41 +36,55 @@
 #endif
 
 #include "uart_simple_cdc.h"
+#ifdef CDC_SIM_HOST
+#include "cdc_sim.h"
+#else
 #include "cdc.h"
+#endif
 
-#define UART_BUFFER_SIZE        (1024)
 #define UART_END_CDC            (UART1)
 
-typedef enum UART_SIMPLE_INT_RESULT
-{
-    UART_SIMPLE_TX_OK,
-    UART_SIMPLE_TX_ERROR,
-    UART_SIMPLE_TX_FIFO_EMPTY,
-    UART_SIMPLE_RX_OK,
-    UART_SIMPLE_RX_FIFO_FULL_INT
-} UART_SIMPLE_INT_RESULT;
+/* Transfers ending on a full packet are followed by a zero length
+ * packet so the host does not wait for more.  64 covers both full
+ * and high speed.
+ */
+#define UART_CDC_ZLP_MULTIPLE   (64)
 
-struct sUART {
+#if (UART_CDC_PACKET_SIZE < 512)
+#error "UART_CDC_PACKET_SIZE must hold a high speed bulk packet (512)"
+#endif
 
-    // UART receive buffer
-    uint8_t rx_buffer[UART_BUFFER_SIZE];
-    uint16_t rx_buffer_readptr;
-    volatile uint16_t rx_buffer_writeptr;
+typedef struct UART_CDC_PACKET {
+    uint8_t data[UART_CDC_PACKET_SIZE];
+    uint32_t len;
+} UART_CDC_PACKET;
 
-    // UART transmit buffer
-    uint8_t tx_buffer[UART_BUFFER_SIZE];
-    volatile uint16_t tx_buffer_readptr;
-    uint16_t tx_buffer_writeptr;
+struct sUART {
+
+    // Received packets.  The USB fills rx[rxHead], the reader
+    // empties rx[rxTail] from rxOffset.
+    UART_CDC_PACKET rx[UART_CDC_RX_PACKETS];
+    volatile uint32_t rxHead;
+    volatile uint32_t rxTail;
+    uint32_t rxOffset;
+
+    // Transmit packets.  The writer fills tx[txHead], the USB
+    // sends tx[txTail].
+    UART_CDC_PACKET tx[UART_CDC_TX_PACKETS];
+    volatile uint32_t txHead;
+    volatile uint32_t txTail;
+    bool zlpPending;
+    bool zlpSending;
 
     // read/write timeouts mode
     int32_t readTimeout;
     int32_t writeTimeout;
 
     // misc
-    bool transmitting;
+    volatile bool transmitting;
     bool open;
-    bool rxSleeping;
-    bool txSleeping;
+    volatile bool rxSleeping;
+    volatile bool txSleeping;
 
 #ifdef FREE_RTOS
     SemaphoreHandle_t portLock;
@@ -95,162 +110,297 @@ __attribute__ ((section(".l3_uncached_data")))
 
 static bool uart_cdc_initialized = false;
 
-static UART_SIMPLE_INT_RESULT _uart_cdc_isr_writeToRXBuffer(sUART *uart, uint8_t val)
-{
-    // First check if RX buffer is full
-    if (((uart->rx_buffer_writeptr+1) % UART_BUFFER_SIZE) == uart->rx_buffer_readptr) {
-        return UART_SIMPLE_RX_FIFO_FULL_INT;
-    }
-
-    // Write value into FIFO
-    uart->rx_buffer[uart->rx_buffer_writeptr] = val;
-    uart->rx_buffer_writeptr++;
-
-    // wrap pointer if necessary
-    if (uart->rx_buffer_writeptr >= UART_BUFFER_SIZE) {
-        uart->rx_buffer_writeptr = 0;
-    }
-
-    return UART_SIMPLE_RX_OK;
-}
-
-/*
- * FIXME: Send out chunks of data instead of char by char
- */
-UART_SIMPLE_INT_RESULT _uart_cdc_isr_readFromTXBuffer(sUART *uart, uint8_t *val)
+/* Starts sending tx[txTail], called with the transmitter idle */
+static bool _uart_cdc_tx_start(sUART *uart)
 {
-    uint8_t *c;
+    UART_CDC_PACKET *pkt;
     CLD_USB_Data_Transmit_Return_Type ok;
-    UART_SIMPLE_INT_RESULT ret;
-
-    // First check if write buffer is empty
-    if (uart->tx_buffer_writeptr == uart->tx_buffer_readptr) {
-        return UART_SIMPLE_TX_FIFO_EMPTY;
-    }
-
-    // fetch latest value from TX buffer
-    c = &uart->tx_buffer[uart->tx_buffer_readptr];
 
-    /* Send out the byte */
-    ok = cdc_tx_serial_data(1, c, 10);
+    pkt = &uart->tx[uart->txTail % UART_CDC_TX_PACKETS];
+    ok = cdc_tx_serial_data(pkt->len, pkt->data, 10);
+    uart->zlpPending = (pkt->len % UART_CDC_ZLP_MULTIPLE) == 0;
 
-    /* Return the result */
-    ret = (ok == CLD_USB_TRANSMIT_SUCCESSFUL) ?
-        UART_SIMPLE_TX_OK : UART_SIMPLE_TX_ERROR;
-
-    return ret;
+    return(ok == CLD_USB_TRANSMIT_SUCCESSFUL);
 }
 
 void _uart_cdc_tx_complete(CDC_TX_STATUS status, void *usrPtr)
 {
     sUART *uart = (sUART *)usrPtr;
-    UART_SIMPLE_INT_RESULT result;
+    CLD_USB_Data_Transmit_Return_Type ok;
+    bool sending;
 #ifdef FREE_RTOS
     BaseType_t rtosResult;
     BaseType_t contextSwitch = pdFALSE;
 #endif
 
-    /* Increment the TX read pointer upon completion */
-    uart->tx_buffer_readptr++;
-    if (uart->tx_buffer_readptr >= UART_BUFFER_SIZE) {
-        uart->tx_buffer_readptr = 0;
+    /* Retire the packet just sent (a timed out packet is dropped) */
+    if (uart->zlpSending) {
+        uart->zlpSending = false;
+    } else {
+        uart->txTail++;
     }
 
-    /* Send the next chunk and update the transmitting status */
-    result = _uart_cdc_isr_readFromTXBuffer(uart, NULL);
-    if (result == UART_SIMPLE_TX_FIFO_EMPTY) {
-        uart->transmitting = false;
+    /* Chain the next queued packet straight from the interrupt */
+    sending = false;
+    if (uart->txHead != uart->txTail) {
+        sending = _uart_cdc_tx_start(uart);
+    } else if (uart->zlpPending) {
+        uart->zlpPending = false;
+        ok = cdc_tx_serial_data(0, uart->tx[0].data, 10);
+        sending = (ok == CLD_USB_TRANSMIT_SUCCESSFUL);
+        uart->zlpSending = sending;
     }
+    uart->transmitting = sending;
 
 #ifdef FREE_RTOS
     /* Wake any blocked threads */
     if (uart->txSleeping) {
+        uart->txSleeping = false;
         rtosResult = xSemaphoreGiveFromISR(uart->portTxBlock, &contextSwitch);
         portYIELD_FROM_ISR(contextSwitch);
-        uart->txSleeping = 0;
     }
 #endif
 }
 
+unsigned char *_uart_cdc_rx_buffer(unsigned short length, void *usrPtr)
+{
+    sUART *uart = (sUART *)usrPtr;
+
+    /* Pause the host while every packet is full */
+    if ((uart->rxHead - uart->rxTail) >= UART_CDC_RX_PACKETS) {
+        return(NULL);
+    }
+
+    return(uart->rx[uart->rxHead % UART_CDC_RX_PACKETS].data);
+}
+
 void _uart_cdc_rx_complete(unsigned char *buffer,
     unsigned short length, void *usrPtr)
 {
     sUART *uart = (sUART *)usrPtr;
-    UART_SIMPLE_INT_RESULT result;
-    unsigned short i;
 #ifdef FREE_RTOS
     BaseType_t rtosResult;
     BaseType_t contextSwitch = pdFALSE;
 #endif
 
-    /* Put received bytes into the RX buffer */
-    for (i = 0; i < length; i++) {
-        result = _uart_cdc_isr_writeToRXBuffer(uart, buffer[i]);
-        if (result != UART_SIMPLE_RX_OK) {
-            break;
-        }
+    /* Zero length packets carry nothing, reuse the slot */
+    if (length == 0) {
+        return;
     }
 
+    uart->rx[uart->rxHead % UART_CDC_RX_PACKETS].len = length;
+    uart->rxHead++;
+
 #ifdef FREE_RTOS
-    /* Wake any blocked threads if new data is available */
-    if ((i > 0) && (uart->rxSleeping)) {
+    /* Wake any blocked threads */
+    if (uart->rxSleeping) {
+        uart->rxSleeping = false;
         rtosResult = xSemaphoreGiveFromISR(uart->portRxBlock, &contextSwitch);
         portYIELD_FROM_ISR(contextSwitch);
-        uart->rxSleeping = false;
     }
 #endif
-
 }
 
-UART_SIMPLE_RESULT uart_cdc_read(sUART *uart, uint8_t *in, uint8_t *inLen)
+/*
+ * Waits for a received packet according to the read timeout.  Returns
+ * true if one is available.
+ */
+static bool _uart_cdc_rx_wait(sUART *uart)
 {
-    UART_SIMPLE_RESULT result = UART_SIMPLE_SUCCESS;
     bool empty;
-    int i;
-
 #ifdef FREE_RTOS
     BaseType_t rtosResult;
 #endif
 
-#ifdef FREE_RTOS
-    rtosResult = xSemaphoreTake(uart->portRxLock, portMAX_DELAY);
-    if (rtosResult != pdTRUE) {
-        result = UART_SIMPLE_ERROR;
+    empty = (uart->rxHead == uart->rxTail);
+    if (!empty) {
+        return(true);
     }
-#endif
 
 #ifdef FREE_RTOS
     UART_ENTER_CRITICAL();
-    empty = (uart->rx_buffer_writeptr == uart->rx_buffer_readptr);
+    empty = (uart->rxHead == uart->rxTail);
     if (empty) {
         uart->rxSleeping = true;
     }
     UART_EXIT_CRITICAL();
     if (empty) {
-        rtosResult = xSemaphoreTake(uart->portRxBlock, uart->readTimeout);
-        if (rtosResult == pdFALSE) {
+        rtosResult = xSemaphoreTake(uart->portRxBlock, uart->rtosReadTimeout);
+        if (rtosResult != pdTRUE) {
             UART_ENTER_CRITICAL();
-            if (uart->rxSleeping) {
-                uart->rxSleeping = false;
-            }
+            uart->rxSleeping = false;
             UART_EXIT_CRITICAL();
         }
     }
 #else
     if (uart->readTimeout == UART_SIMPLE_TIMEOUT_INF) {
         do {
-            empty = (uart->rx_buffer_writeptr == uart->rx_buffer_readptr);
+            empty = (uart->rxHead == uart->rxTail);
         } while (empty);
     }
 #endif
 
-    empty = (uart->rx_buffer_writeptr == uart->rx_buffer_readptr);
-    for (i = 0; (i < *inLen) && !empty; i++) {
-        in[i] = uart->rx_buffer[uart->rx_buffer_readptr++];
-        if (uart->rx_buffer_readptr >= UART_BUFFER_SIZE) {
-            uart->rx_buffer_readptr = 0;
+    return(uart->rxHead != uart->rxTail);
+}
+
+/*
+ * Waits for a free transmit packet according to the write timeout.
+ * Returns true if one is available.  Gives up straight away if the
+ * queue is full and nothing is being sent (no host).
+ */
+static bool _uart_cdc_tx_wait(sUART *uart)
+{
+    bool full;
+    bool transmitting;
+#ifdef FREE_RTOS
+    BaseType_t rtosResult;
+#endif
+
+    do {
+        UART_ENTER_CRITICAL();
+        full = (uart->txHead - uart->txTail) >= UART_CDC_TX_PACKETS;
+        if (full && !uart->transmitting) {
+            uart->transmitting = _uart_cdc_tx_start(uart);
+        }
+        transmitting = uart->transmitting;
+#ifdef FREE_RTOS
+        if (full && transmitting) {
+            uart->txSleeping = true;
+        }
+#endif
+        UART_EXIT_CRITICAL();
+
+        if (!full) {
+            return(true);
+        }
+        if (!transmitting) {
+            return(false);
+        }
+
+#ifdef FREE_RTOS
+        rtosResult = xSemaphoreTake(uart->portTxBlock, uart->rtosWriteTimeout);
+        if (rtosResult != pdTRUE) {
+            UART_ENTER_CRITICAL();
+            uart->txSleeping = false;
+            UART_EXIT_CRITICAL();
+            return((uart->txHead - uart->txTail) < UART_CDC_TX_PACKETS);
+        }
+#else
+        if (uart->writeTimeout == UART_SIMPLE_TIMEOUT_NONE) {
+            return(false);
+        }
+#endif
+    } while (1);
+}
+
+UART_SIMPLE_RESULT uart_cdc_rxAcquire(sUART *uart, uint8_t **buf,
+    uint32_t *len)
+{
+    UART_CDC_PACKET *pkt;
+
+    if (!_uart_cdc_rx_wait(uart)) {
+        *buf = NULL;
+        *len = 0;
+        return(UART_SIMPLE_SUCCESS);
+    }
+
+    pkt = &uart->rx[uart->rxTail % UART_CDC_RX_PACKETS];
+    *buf = pkt->data + uart->rxOffset;
+    *len = pkt->len - uart->rxOffset;
+
+    return(UART_SIMPLE_SUCCESS);
+}
+
+UART_SIMPLE_RESULT uart_cdc_rxRelease(sUART *uart)
+{
+    if (uart->rxHead == uart->rxTail) {
+        return(UART_SIMPLE_ERROR);
+    }
+
+    uart->rxOffset = 0;
+    uart->rxTail++;
+
+    /* Let a paused host send again */
+    cdc_rx_resume();
+
+    return(UART_SIMPLE_SUCCESS);
+}
+
+UART_SIMPLE_RESULT uart_cdc_txAcquire(sUART *uart, uint8_t **buf,
+    uint32_t *size)
+{
+    if (!_uart_cdc_tx_wait(uart)) {
+        *buf = NULL;
+        *size = 0;
+        return(UART_SIMPLE_ERROR);
+    }
+
+    *buf = uart->tx[uart->txHead % UART_CDC_TX_PACKETS].data;
+    *size = UART_CDC_PACKET_SIZE;
+
+    return(UART_SIMPLE_SUCCESS);
+}
+
+UART_SIMPLE_RESULT uart_cdc_txCommit(sUART *uart, uint32_t len)
+{
+    UART_SIMPLE_RESULT result = UART_SIMPLE_SUCCESS;
+
+    if ((len == 0) || (len > UART_CDC_PACKET_SIZE) ||
+        ((uart->txHead - uart->txTail) >= UART_CDC_TX_PACKETS)) {
+        return(UART_SIMPLE_ERROR);
+    }
+
+    uart->tx[uart->txHead % UART_CDC_TX_PACKETS].len = len;
+
+    /*
+     * Queue the packet and kick off a transfer if needed
+     */
+    UART_ENTER_CRITICAL();
+    uart->txHead++;
+    if (!uart->transmitting) {
+        uart->transmitting = _uart_cdc_tx_start(uart);
+        if (!uart->transmitting) {
+            result = UART_SIMPLE_ERROR;
+        }
+    }
+    UART_EXIT_CRITICAL();
+
+    return(result);
+}
+
+UART_SIMPLE_RESULT uart_cdc_read(sUART *uart, uint8_t *in, uint32_t *inLen)
+{
+    UART_SIMPLE_RESULT result = UART_SIMPLE_SUCCESS;
+    UART_CDC_PACKET *pkt;
+    uint32_t i, len;
+
+#ifdef FREE_RTOS
+    BaseType_t rtosResult;
+#endif
+
+#ifdef FREE_RTOS
+    rtosResult = xSemaphoreTake(uart->portRxLock, portMAX_DELAY);
+    if (rtosResult != pdTRUE) {
+        result = UART_SIMPLE_ERROR;
+    }
+#endif
+
+    /* Wait for the first packet, then take what is there */
+    i = 0;
+    if (_uart_cdc_rx_wait(uart)) {
+        while ((i < *inLen) && (uart->rxHead != uart->rxTail)) {
+            pkt = &uart->rx[uart->rxTail % UART_CDC_RX_PACKETS];
+            len = pkt->len - uart->rxOffset;
+            if (len > (*inLen - i)) {
+                len = *inLen - i;
+            }
+            memcpy(in + i, pkt->data + uart->rxOffset, len);
+            uart->rxOffset += len;
+            i += len;
+            if (uart->rxOffset == pkt->len) {
+                uart_cdc_rxRelease(uart);
+            }
         }
-        empty = (uart->rx_buffer_writeptr == uart->rx_buffer_readptr);
     }
 
 #ifdef FREE_RTOS
@@ -266,14 +416,11 @@ UART_SIMPLE_RESULT uart_cdc_read(sUART *uart, uint8_t *in, uint8_t *inLen)
 }
 
 
-UART_SIMPLE_RESULT uart_cdc_write(sUART *uart, uint8_t *out, uint8_t *outLen)
+UART_SIMPLE_RESULT uart_cdc_write(sUART *uart, uint8_t *out, uint32_t *outLen)
 {
     UART_SIMPLE_RESULT result = UART_SIMPLE_SUCCESS;
-    UART_SIMPLE_INT_RESULT intResult;
-    int i;
-    bool full;
-    bool goToSleep;
-    bool transmitting;
+    uint8_t *buf;
+    uint32_t i, len, size;
 #ifdef FREE_RTOS
     BaseType_t rtosResult;
 #endif
@@ -285,57 +432,27 @@ UART_SIMPLE_RESULT uart_cdc_write(sUART *uart, uint8_t *out, uint8_t *outLen)
     }
 #endif
 
-    for (i = 0; i < *outLen; i++) {
-
-#ifdef FREE_RTOS
-        UART_ENTER_CRITICAL();
-        full = ((uart->tx_buffer_writeptr+1) % UART_BUFFER_SIZE) == uart->tx_buffer_readptr;
-        transmitting = uart->transmitting;
-        goToSleep = full & transmitting;
-        if (goToSleep) {
-            uart->txSleeping = true;
+    /* Send in whole packets */
+    for (i = 0; i < *outLen; i += len) {
+        result = uart_cdc_txAcquire(uart, &buf, &size);
+        if (result != UART_SIMPLE_SUCCESS) {
+            break;
         }
-        UART_EXIT_CRITICAL();
-        if (goToSleep) {
-            rtosResult = xSemaphoreTake(uart->portTxBlock, portMAX_DELAY);
-            if (rtosResult != pdTRUE) {
-                result = UART_SIMPLE_ERROR;
-            }
-        } else {
-            if (full & !transmitting) {
-                break;
-            }
+        len = *outLen - i;
+        if (len > size) {
+            len = size;
         }
-#else
-        do {
-            full = ((uart->tx_buffer_writeptr+1) % UART_BUFFER_SIZE) == uart->tx_buffer_readptr;
-        } while (full);
-#endif
-
-        uart->tx_buffer[uart->tx_buffer_writeptr++] = out[i];
-
-        if (uart->tx_buffer_writeptr >= UART_BUFFER_SIZE) {
-            uart->tx_buffer_writeptr = 0;
+        memcpy(buf, out + i, len);
+        result = uart_cdc_txCommit(uart, len);
+        if (result != UART_SIMPLE_SUCCESS) {
+            i += len;
+            break;
         }
     }
 
     /* Report back the bytes written */
     *outLen = i;
 
-    /*
-     * Kick off a write if needed
-     */
-     UART_ENTER_CRITICAL();
-     if (!uart->transmitting) {
-        intResult = _uart_cdc_isr_readFromTXBuffer(uart, NULL);
-        if (intResult == UART_SIMPLE_TX_OK) {
-            uart->transmitting = true;
-        } else {
-            result = UART_SIMPLE_ERROR;
-        }
-     }
-     UART_EXIT_CRITICAL();
-
 #ifdef FREE_RTOS
     rtosResult = xSemaphoreGive(uart->portTxLock);
     if (rtosResult != pdTRUE) {
@@ -393,7 +510,7 @@ UART_SIMPLE_RESULT uart_cdc_setTimeouts(sUART *uartHandle,
         } else if (uart->writeTimeout == UART_SIMPLE_TIMEOUT_NONE) {
             uart->rtosWriteTimeout = 0;
         } else {
-            uart->rtosWriteTimeout = pdMS_TO_TICKS(uart->readTimeout);
+            uart->rtosWriteTimeout = pdMS_TO_TICKS(uart->writeTimeout);
         }
 #endif
     }
@@ -435,16 +552,19 @@ UART_SIMPLE_RESULT uart_cdc_open(UART_SIMPLE_PORT port, sUART **uartHandle)
 
     if (result == UART_SIMPLE_SUCCESS) {
 
-        cdc_register_tx_callback(_uart_cdc_tx_complete, uart);
-        cdc_register_rx_callback(_uart_cdc_rx_complete, uart);
+        uart->rxHead = 0;
+        uart->rxTail = 0;
+        uart->rxOffset = 0;
 
-        memset(uart->rx_buffer, 0, sizeof(uart->rx_buffer));
-        uart->rx_buffer_readptr = 0;
-        uart->rx_buffer_writeptr = 0;
+        uart->txHead = 0;
+        uart->txTail = 0;
+        uart->zlpPending = false;
+        uart->zlpSending = false;
+        uart->transmitting = false;
 
-        memset(uart->tx_buffer, 0, sizeof(uart->tx_buffer));
-        uart->tx_buffer_readptr = 0;
-        uart->tx_buffer_writeptr = 0;
+        cdc_register_tx_callback(_uart_cdc_tx_complete, uart);
+        cdc_register_rx_callback(_uart_cdc_rx_complete, uart);
+        cdc_register_rx_buffer_callback(_uart_cdc_rx_buffer, uart);
 
         uart->readTimeout = UART_SIMPLE_TIMEOUT_INF;
         uart->writeTimeout = UART_SIMPLE_TIMEOUT_INF;
@@ -496,6 +616,8 @@ UART_SIMPLE_RESULT uart_cdc_close(sUART **uartHandle)
 
     cdc_register_tx_callback(NULL, NULL);
     cdc_register_rx_callback(NULL, NULL);
+    cdc_register_rx_buffer_callback(NULL, NULL);
+    cdc_rx_resume();
 
     *uartHandle = NULL;
 
@@ -590,12 +712,12 @@ UART_SIMPLE_RESULT uart_cdc_deinit(void)
 
         if (uart->portRxLock) {
             vSemaphoreDelete(uart->portRxLock);
-            uart->portLock = NULL;
+            uart->portRxLock = NULL;
         }
 
-        if (uart->portRxLock) {
-            vSemaphoreDelete(uart->portRxLock);
-            uart->portLock = NULL;
+        if (uart->portTxLock) {
+            vSemaphoreDelete(uart->portTxLock);
+            uart->portTxLock = NULL;
         }
 #endif
 
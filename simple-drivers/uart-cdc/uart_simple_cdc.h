@@ -17,6 +17,7 @@
  *     - FreeRTOS or no RTOS main-loop modes
  *     - Fully protected multi-threaded device transfers
  *     - Blocking transfers
+ *     - Queued bulk packets with zero-copy access
  *
  * @file      uart_simple_cdc.h
  * @version   1.0.0
@@ -38,6 +39,31 @@
 #define UART_SIMPLE_DEFINES_ONLY
 #include "uart_simple.h"
 
+/*!****************************************************************
+ * @brief Bulk packet buffer size.  Must hold a high speed bulk
+ *        packet (512).  Each transmit packet is sent as one USB
+ *        transfer.
+ ******************************************************************/
+#ifndef UART_CDC_PACKET_SIZE
+#define UART_CDC_PACKET_SIZE    (512)
+#endif
+
+/*!****************************************************************
+ * @brief Number of receive packets.  The host is held off (NAK)
+ *        while they are all full.
+ ******************************************************************/
+#ifndef UART_CDC_RX_PACKETS
+#define UART_CDC_RX_PACKETS     (4)
+#endif
+
+/*!****************************************************************
+ * @brief Number of transmit packets.  Queued packets are sent back
+ *        to back from the USB interrupt.
+ ******************************************************************/
+#ifndef UART_CDC_TX_PACKETS
+#define UART_CDC_TX_PACKETS     (4)
+#endif
+
 /*!****************************************************************
  * @brief Opaque Simple UART driver handle type.
  ******************************************************************/
@@ -182,7 +208,7 @@ UART_SIMPLE_RESULT uart_cdc_setTimeouts(sUART *uartHandle,
  *         an error.
  ******************************************************************/
 UART_SIMPLE_RESULT uart_cdc_read(sUART *uartHandle, uint8_t *in,
-    uint8_t *inLen);
+    uint32_t *inLen);
 
 /*!****************************************************************
  * @brief Simple UART write.
@@ -205,7 +231,84 @@ UART_SIMPLE_RESULT uart_cdc_read(sUART *uartHandle, uint8_t *in,
  *         an error.
  ******************************************************************/
 UART_SIMPLE_RESULT uart_cdc_write(sUART *uartHandle, uint8_t *out,
-    uint8_t *outLen);
+    uint32_t *outLen);
+
+/*!****************************************************************
+ * @brief Simple UART acquire received packet.
+ *
+ * This function returns the oldest received packet in place,
+ * waiting for one according to the read timeout.  The packet stays
+ * owned by the caller until uart_cdc_rxRelease() is called.  If the
+ * packet was partially consumed by uart_cdc_read(), only the unread
+ * part is returned.
+ *
+ * If using the UART driver under FreeRTOS, this function must be
+ * called after the RTOS has been started.
+ *
+ * This function is not thread safe.  Use either this function or
+ * uart_cdc_read() from a single thread.
+ *
+ * @param [in]  uartHandle  A handle to a UART port
+ * @param [out] buf         Pointer to the packet data (NULL if none)
+ * @param [out] len         Number of bytes in the packet (0 if none)
+ *
+ * @return Returns UART_SIMPLE_SUCCESS if successful, otherwise
+ *         an error.
+ ******************************************************************/
+UART_SIMPLE_RESULT uart_cdc_rxAcquire(sUART *uartHandle, uint8_t **buf,
+    uint32_t *len);
+
+/*!****************************************************************
+ * @brief Simple UART release received packet.
+ *
+ * This function returns the packet from uart_cdc_rxAcquire() to the
+ * driver for the next transfer from the host.
+ *
+ * @param [in]  uartHandle  A handle to a UART port
+ *
+ * @return Returns UART_SIMPLE_SUCCESS if successful, otherwise
+ *         an error.
+ ******************************************************************/
+UART_SIMPLE_RESULT uart_cdc_rxRelease(sUART *uartHandle);
+
+/*!****************************************************************
+ * @brief Simple UART acquire transmit packet.
+ *
+ * This function returns a free transmit packet to fill in place,
+ * waiting for one according to the write timeout.  Fill it and
+ * queue it with uart_cdc_txCommit().
+ *
+ * If using the UART driver under FreeRTOS, this function must be
+ * called after the RTOS has been started.
+ *
+ * This function is not thread safe.  Use either this function or
+ * uart_cdc_write() from a single thread.
+ *
+ * @param [in]  uartHandle  A handle to a UART port
+ * @param [out] buf         Pointer to the packet data (NULL if none)
+ * @param [out] size        Packet size in bytes (0 if none)
+ *
+ * @return Returns UART_SIMPLE_SUCCESS if successful, otherwise
+ *         an error.  Fails if no packet is free and nothing is
+ *         being sent (no host connected).
+ ******************************************************************/
+UART_SIMPLE_RESULT uart_cdc_txAcquire(sUART *uartHandle, uint8_t **buf,
+    uint32_t *size);
+
+/*!****************************************************************
+ * @brief Simple UART commit transmit packet.
+ *
+ * This function queues the packet from uart_cdc_txAcquire() for
+ * transmission as a single USB transfer.
+ *
+ * @param [in]  uartHandle  A handle to a UART port
+ * @param [in]  len         Number of bytes filled in (1 to size)
+ *
+ * @return Returns UART_SIMPLE_SUCCESS if successful, otherwise
+ *         an error.  The packet stays queued if the transfer could
+ *         not be started.
+ ******************************************************************/
+UART_SIMPLE_RESULT uart_cdc_txCommit(sUART *uartHandle, uint32_t len);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -11,6 +11,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include <runtime/int/interrupt.h>
 
@@ -33,6 +34,135 @@ static uint32_t cyclesTotal = 0;
 static uint32_t cpuLoad = 0;
 static uint32_t maxCpuLoad = 0;
 
+/* Per-task and per-ISR cycle buckets */
+typedef struct _CPU_LOAD_ENTRY {
+    void *handle;
+    char name[CPU_LOAD_NAME_LEN];
+    uint32_t accumCycles;
+    uint32_t windowCycles;
+    uint32_t peakWindowCycles;
+    uint32_t maxBurstCycles;
+} CPU_LOAD_ENTRY;
+
+#if (CPU_LOAD_MAX_TASKS > 0)
+
+#if (CPU_LOAD_MAX_TASKS & (CPU_LOAD_MAX_TASKS - 1))
+#error "CPU_LOAD_MAX_TASKS must be a power of two"
+#endif
+
+/* Marks a task slot released by cpuLoadTaskDeleteHook() */
+#define CPU_LOAD_TASK_DELETED  ((void *)1)
+
+/* TCBs are heap allocated so the low bits carry little information */
+#define CPU_LOAD_TASK_HASH(h) \
+    ((((uintptr_t)(h) >> 3) ^ ((uintptr_t)(h) >> 9)) & (CPU_LOAD_MAX_TASKS - 1))
+
+static CPU_LOAD_ENTRY taskEntries[CPU_LOAD_MAX_TASKS];
+static CPU_LOAD_ENTRY otherEntry = { .name = "other" };
+static CPU_LOAD_ENTRY *currentEntry = NULL;
+static uint32_t sliceInCycles = 0;
+static uint32_t sliceIsrCycles = 0;
+static uint32_t burstCycles = 0;
+#endif
+
+static CPU_LOAD_ENTRY isrEntries[CPU_LOAD_MAX_ISRS];
+static unsigned numIsrs = 0;
+static uint32_t windowTotal = 0;
+
+#if (CPU_LOAD_MAX_TASKS > 0)
+static CPU_LOAD_ENTRY *cpuLoadTaskEntry(void *taskHandle)
+{
+    CPU_LOAD_ENTRY *entry;
+    CPU_LOAD_ENTRY *freeEntry;
+    unsigned idx;
+    unsigned i;
+
+    idx = CPU_LOAD_TASK_HASH(taskHandle);
+    freeEntry = NULL;
+
+    /* Probe a bounded number of slots for the task */
+    for (i = 0; i < CPU_LOAD_TASK_PROBES; i++) {
+        entry = &taskEntries[(idx + i) & (CPU_LOAD_MAX_TASKS - 1)];
+        if (entry->handle == taskHandle) {
+            return(entry);
+        }
+        if (entry->handle == CPU_LOAD_TASK_DELETED) {
+            if (freeEntry == NULL) {
+                freeEntry = entry;
+            }
+        } else if (entry->handle == NULL) {
+            if (freeEntry == NULL) {
+                freeEntry = entry;
+            }
+            break;
+        }
+    }
+
+    /* First time this task has been seen so claim a slot */
+    if (freeEntry) {
+        freeEntry->handle = taskHandle;
+        strncpy(freeEntry->name, pcTaskGetName((TaskHandle_t)taskHandle),
+            CPU_LOAD_NAME_LEN - 1);
+        freeEntry->name[CPU_LOAD_NAME_LEN - 1] = '\0';
+        freeEntry->accumCycles = 0;
+        freeEntry->windowCycles = 0;
+        freeEntry->peakWindowCycles = 0;
+        freeEntry->maxBurstCycles = 0;
+        return(freeEntry);
+    }
+
+    return(&otherEntry);
+}
+
+static uint32_t cpuLoadCloseSlice(uint32_t now)
+{
+    uint32_t elapsed;
+
+    /* Charge the slice less any ISR cycles which occurred during it */
+    elapsed = now - sliceInCycles;
+    elapsed = (elapsed > sliceIsrCycles) ? elapsed - sliceIsrCycles : 0;
+
+    currentEntry->accumCycles += elapsed;
+    burstCycles += elapsed;
+
+    sliceInCycles = now;
+    sliceIsrCycles = 0;
+
+    return(burstCycles);
+}
+#endif
+
+static void cpuLoadRollEntry(CPU_LOAD_ENTRY *entry)
+{
+    entry->windowCycles = entry->accumCycles;
+    entry->accumCycles = 0;
+    if (entry->windowCycles > entry->peakWindowCycles) {
+        entry->peakWindowCycles = entry->windowCycles;
+    }
+}
+
+static void cpuLoadFillStats(CPU_LOAD_STATS *stats, CPU_LOAD_ENTRY *entry,
+    CPU_LOAD_STATS_TYPE type, bool clearMax)
+{
+    memcpy(stats->name, entry->name, CPU_LOAD_NAME_LEN);
+    stats->type = type;
+    stats->windowCycles = entry->windowCycles;
+    stats->peakWindowCycles = entry->peakWindowCycles;
+    stats->maxBurstCycles = entry->maxBurstCycles;
+    stats->load = 0;
+    stats->peakLoad = 0;
+    if (windowTotal) {
+        stats->load = (uint32_t)
+            ((10000ULL * entry->windowCycles) / windowTotal);
+        stats->peakLoad = (uint32_t)
+            ((10000ULL * entry->peakWindowCycles) / windowTotal);
+    }
+    if (clearMax) {
+        entry->peakWindowCycles = 0;
+        entry->maxBurstCycles = 0;
+    }
+}
+
 void cpuLoadInit(CPU_LOAD_GET_TIME _getTime, uint32_t _ticksPerSecond)
 {
     /* Get the idle task handle */
@@ -53,17 +183,57 @@ void cpuLoadBackgroundTask(void *taskHandle)
 void cpuLoadtaskSwitchHook(void *taskHandle)
 {
     static uint32_t idleInCycles;
+    uint32_t now;
+
+    now = getTime();
 
     if ( (taskHandle == idleTaskHandle) ||
          (taskHandle == backgroundTaskHandle) ) {
-        idleInCycles = getTime();
+        idleInCycles = now;
         inIdleTask = true;
     } else {
         if (inIdleTask) {
-            idleCyclesTotal += getTime() - idleInCycles;
+            idleCyclesTotal += now - idleInCycles;
             inIdleTask = false;
         }
     }
+
+#if (CPU_LOAD_MAX_TASKS > 0)
+    /* Nothing to do if the scheduler selected the same task */
+    if (currentEntry && (currentEntry->handle == taskHandle)) {
+        return;
+    }
+
+    /* Charge the outgoing task and track its longest run */
+    if (currentEntry) {
+        if (cpuLoadCloseSlice(now) > currentEntry->maxBurstCycles) {
+            currentEntry->maxBurstCycles = burstCycles;
+        }
+        burstCycles = 0;
+    }
+
+    /* Start a new slice for the incoming task */
+    currentEntry = cpuLoadTaskEntry(taskHandle);
+    sliceInCycles = now;
+    sliceIsrCycles = 0;
+#endif
+}
+
+void cpuLoadTaskDeleteHook(void *taskHandle)
+{
+#if (CPU_LOAD_MAX_TASKS > 0)
+    unsigned idx;
+    unsigned i;
+
+    idx = CPU_LOAD_TASK_HASH(taskHandle);
+    for (i = 0; i < CPU_LOAD_TASK_PROBES; i++) {
+        if (taskEntries[(idx + i) & (CPU_LOAD_MAX_TASKS - 1)].handle == taskHandle) {
+            taskEntries[(idx + i) & (CPU_LOAD_MAX_TASKS - 1)].handle =
+                CPU_LOAD_TASK_DELETED;
+            break;
+        }
+    }
+#endif
 }
 
 void cpuLoadIsrCycles(uint32_t isrCycles)
@@ -72,11 +242,49 @@ void cpuLoadIsrCycles(uint32_t isrCycles)
     if (inIdleTask) {
         isrCyclesTotal += isrCycles;
     }
+
+#if (CPU_LOAD_MAX_TASKS > 0)
+    /* Don't charge ISR cycles to the interrupted task */
+    sliceIsrCycles += isrCycles;
+#endif
+}
+
+int cpuLoadIsrRegister(const char *name)
+{
+    CPU_LOAD_ENTRY *entry;
+
+    if (numIsrs >= CPU_LOAD_MAX_ISRS) {
+        return(-1);
+    }
+
+    entry = &isrEntries[numIsrs];
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->name, name, CPU_LOAD_NAME_LEN - 1);
+
+    return((int)numIsrs++);
+}
+
+void cpuLoadIsrIdCycles(int isrId, uint32_t isrCycles)
+{
+    CPU_LOAD_ENTRY *entry;
+
+    cpuLoadIsrCycles(isrCycles);
+
+    if ((isrId < 0) || ((unsigned)isrId >= numIsrs)) {
+        return;
+    }
+
+    entry = &isrEntries[isrId];
+    entry->accumCycles += isrCycles;
+    if (isrCycles > entry->maxBurstCycles) {
+        entry->maxBurstCycles = isrCycles;
+    }
 }
 
 uint32_t cpuLoadCalculateLoad(uint32_t *maxLoad)
 {
     uint32_t now;
+    unsigned i;
 
     taskENTER_CRITICAL();
 
@@ -95,6 +303,21 @@ uint32_t cpuLoadCalculateLoad(uint32_t *maxLoad)
         maxCpuLoad = cpuLoad;
     }
 
+    /* Roll the per-task and per-ISR windows */
+    windowTotal = cyclesTotal;
+#if (CPU_LOAD_MAX_TASKS > 0)
+    if (currentEntry) {
+        cpuLoadCloseSlice(now);
+    }
+    for (i = 0; i < CPU_LOAD_MAX_TASKS; i++) {
+        cpuLoadRollEntry(&taskEntries[i]);
+    }
+    cpuLoadRollEntry(&otherEntry);
+#endif
+    for (i = 0; i < numIsrs; i++) {
+        cpuLoadRollEntry(&isrEntries[i]);
+    }
+
     /* Reset all counters */
     idleCyclesTotal = 0;
     isrCyclesTotal = 0;
@@ -121,6 +344,41 @@ uint32_t cpuLoadGetLoad(uint32_t *maxLoad, bool clearMax)
     return(cpuLoad);
 }
 
+unsigned cpuLoadGetStats(CPU_LOAD_STATS *stats, unsigned maxStats,
+    bool clearMax)
+{
+    unsigned n;
+    unsigned i;
+
+    n = 0;
+
+    taskENTER_CRITICAL();
+
+#if (CPU_LOAD_MAX_TASKS > 0)
+    for (i = 0; (i < CPU_LOAD_MAX_TASKS) && (n < maxStats); i++) {
+        if ((taskEntries[i].handle == NULL) ||
+            (taskEntries[i].handle == CPU_LOAD_TASK_DELETED)) {
+            continue;
+        }
+        cpuLoadFillStats(&stats[n++], &taskEntries[i],
+            CPU_LOAD_STATS_TASK, clearMax);
+    }
+    if ((n < maxStats) &&
+        (otherEntry.windowCycles || otherEntry.peakWindowCycles)) {
+        cpuLoadFillStats(&stats[n++], &otherEntry,
+            CPU_LOAD_STATS_OTHER, clearMax);
+    }
+#endif
+    for (i = 0; (i < numIsrs) && (n < maxStats); i++) {
+        cpuLoadFillStats(&stats[n++], &isrEntries[i],
+            CPU_LOAD_STATS_ISR, clearMax);
+    }
+
+    taskEXIT_CRITICAL();
+
+    return(n);
+}
+
 uint32_t cpuLoadGetTimeStamp(void)
 {
     return(getTime());
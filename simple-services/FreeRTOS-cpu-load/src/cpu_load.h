@@ -27,6 +27,71 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/*!****************************************************************
+ * @brief  Maximum number of tasks tracked individually
+ *
+ * Must be a power of two.  Tasks which cannot be placed into the
+ * tracking table are accumulated in a single "other" entry.  Set
+ * to zero to disable per-task accounting.
+ ******************************************************************/
+#ifndef CPU_LOAD_MAX_TASKS
+#define CPU_LOAD_MAX_TASKS      (32)
+#endif
+
+/*!****************************************************************
+ * @brief  Maximum number of table slots probed per task lookup
+ *
+ * Bounds the cost of the task switch hook.  Tasks which cannot be
+ * located within this many probes are accumulated in the "other"
+ * entry.
+ ******************************************************************/
+#ifndef CPU_LOAD_TASK_PROBES
+#define CPU_LOAD_TASK_PROBES    (4)
+#endif
+
+/*!****************************************************************
+ * @brief  Maximum number of ISRs which can be registered with
+ *         cpuLoadIsrRegister().
+ ******************************************************************/
+#ifndef CPU_LOAD_MAX_ISRS
+#define CPU_LOAD_MAX_ISRS       (8)
+#endif
+
+/*!****************************************************************
+ * @brief  Maximum length of a task or ISR name including the
+ *         terminating NULL.
+ ******************************************************************/
+#ifndef CPU_LOAD_NAME_LEN
+#define CPU_LOAD_NAME_LEN       (16)
+#endif
+
+/*!****************************************************************
+ * @brief  CPU load statistics entry types
+ ******************************************************************/
+typedef enum _CPU_LOAD_STATS_TYPE {
+    CPU_LOAD_STATS_TASK = 0,    /**< Entry is a FreeRTOS task */
+    CPU_LOAD_STATS_ISR,         /**< Entry is a registered ISR */
+    CPU_LOAD_STATS_OTHER        /**< Entry is the untracked task bucket */
+} CPU_LOAD_STATS_TYPE;
+
+/*!****************************************************************
+ * @brief  CPU load statistics entry
+ *
+ * All cycle counts are in the same unit of measure as the
+ * CPU_LOAD_GET_TIME routine passed into cpuLoadInit().  "Window"
+ * values refer to the period between the two most recent calls to
+ * cpuLoadCalculateLoad().
+ ******************************************************************/
+typedef struct _CPU_LOAD_STATS {
+    char name[CPU_LOAD_NAME_LEN];   /**< Task or ISR name */
+    CPU_LOAD_STATS_TYPE type;       /**< Entry type */
+    uint32_t windowCycles;          /**< Cycles consumed in the last window */
+    uint32_t peakWindowCycles;      /**< Max cycles consumed in any window */
+    uint32_t maxBurstCycles;        /**< Longest single run or ISR call */
+    uint32_t load;                  /**< Load in the last window (0.01% units) */
+    uint32_t peakLoad;              /**< Max load in any window (0.01% units) */
+} CPU_LOAD_STATS;
+
 /*!****************************************************************
  * @brief  Function called to track time
  *
@@ -68,6 +133,18 @@ void cpuLoadInit(CPU_LOAD_GET_TIME getTime, uint32_t ticksPerSecond);
  ******************************************************************/
 void cpuLoadtaskSwitchHook(void *taskHandle);
 
+/*!****************************************************************
+ * @brief  FreeRTOS task delete hook
+ *
+ * This function should be called from the FreeRTOS task delete
+ * hook so the per-task tracking slot can be reused.  It is only
+ * required if tasks are deleted at run-time.
+ *
+ * @param [in]  taskHandle  Task handle as given by the FreeRTOS task
+ *                          delete hook.
+ ******************************************************************/
+void cpuLoadTaskDeleteHook(void *taskHandle);
+
 /*!****************************************************************
  * @brief  Accumulates CPU cycles in ISR routines
  *
@@ -83,6 +160,30 @@ void cpuLoadtaskSwitchHook(void *taskHandle);
  ******************************************************************/
 void cpuLoadIsrCycles(uint32_t isrCycles);
 
+/*!****************************************************************
+ * @brief  Register an ISR for individual cycle accounting
+ *
+ * This function is not thread safe and should be called during
+ * system initialization.
+ *
+ * @param [in]  name  ISR name to report in the statistics
+ *
+ * @return  ISR id to pass to cpuLoadIsrIdCycles() or -1 if no more
+ *          ISRs can be registered.
+ ******************************************************************/
+int cpuLoadIsrRegister(const char *name);
+
+/*!****************************************************************
+ * @brief  Accumulates CPU cycles for a registered ISR
+ *
+ * This function performs the same accounting as cpuLoadIsrCycles()
+ * and additionally charges the cycles to the ISR's own entry.
+ *
+ * @param [in]  isrId      ISR id returned by cpuLoadIsrRegister()
+ * @param [in]  isrCycles  Cycles spent in the ISR
+ ******************************************************************/
+void cpuLoadIsrIdCycles(int isrId, uint32_t isrCycles);
+
 /*!****************************************************************
  * @brief  Assign a background task
  *
@@ -117,6 +218,23 @@ uint32_t cpuLoadCalculateLoad(uint32_t *maxLoad);
  ******************************************************************/
 uint32_t cpuLoadGetLoad(uint32_t *maxLoad, bool clearMax);
 
+/*!****************************************************************
+ * @brief  Return a snapshot of the per-task and per-ISR statistics
+ *
+ * Copies the statistics for the last window as computed by
+ * cpuLoadCalculateLoad() into the caller's array.  Tasks are
+ * reported first, followed by the "other" entry (if it has been
+ * used) and registered ISRs.
+ *
+ * @param [out]  stats     Array to receive the statistics
+ * @param [in]   maxStats  Number of entries in 'stats'
+ * @param [in]   clearMax  Clear the max burst and peak values
+ *
+ * @return  Number of entries filled in
+ ******************************************************************/
+unsigned cpuLoadGetStats(CPU_LOAD_STATS *stats, unsigned maxStats,
+    bool clearMax);
+
 /*!****************************************************************
  * @brief  Return a CPU timestamp suitable for use in
  *         cpuLoadIsrCycles()
@@ -25,7 +25,9 @@
 
 #include "ad2425w_cfg.h"
 #include "ad2425w.h"
+#ifndef AD2425W_SIM_HOST
 #include "util.h"
+#endif
 
 #ifndef AD2425_MALLOC
 #define AD2425_MALLOC malloc
@@ -88,6 +90,17 @@ static BM_AD2425W_RESULT ad2425w_read_ctrl_reg_block(BM_AD2425W_CONTROLLER *ad24
     uint8_t reg, uint16_t len, uint8_t *values,
     uint8_t i2c_addr);
 
+// Writes a control register through the shadow cache
+static BM_AD2425W_RESULT ad2425w_cache_write(BM_AD2425W_CONTROLLER *ad2425w,
+    uint8_t reg, uint8_t value, uint8_t i2c_addr);
+
+// Reads a control register through the shadow cache
+static BM_AD2425W_RESULT ad2425w_cache_read(BM_AD2425W_CONTROLLER *ad2425w,
+    uint8_t reg, uint8_t *value, uint8_t i2c_addr);
+
+// Writes out any pending burst
+static BM_AD2425W_RESULT ad2425w_cache_flush(BM_AD2425W_CONTROLLER *ad2425w);
+
 // A2B Result strings
 const struct RESULT_STRING RESULT_STRINGS[] =  {
     { AD2425W_SIMPLE_SUCCESS, "SUCCESS" },
@@ -146,6 +159,11 @@ static void ad2425w_reset(BM_AD2425W_CONTROLLER *ad2425w)
     AD2425_MEMSET(ad2425w->nodes, 0, sizeof(ad2425w->nodes));
     ad2425w->I2SGCFG = 0x00;
     ad2425w->I2SCFG = 0x00;
+    AD2425_MEMSET(&ad2425w->cache_stats, 0, sizeof(ad2425w->cache_stats));
+
+    /* The AD2425W is reset, nothing is known about its registers */
+    AD2425_MEMSET(ad2425w->_shadow_valid, 0, sizeof(ad2425w->_shadow_valid));
+    ad2425w->_burst_len = 0;
 }
 
 
@@ -289,6 +307,7 @@ BM_AD2425W_RESULT ad2425w_new_master_addr(
     // Rewrite addresses in controller
     ad2425w->_twi_master_addr = new_addr;
     ad2425w->_twi_slave_addr = new_addr + 1;
+    AD2425_MEMSET(ad2425w->_shadow_valid, 0, sizeof(ad2425w->_shadow_valid));
 
     return(result);
 }
@@ -514,15 +533,24 @@ BM_AD2425W_RESULT ad2425w_load_init_sequence(
 
                 /* Optimize the single register write case */
                 if (single_reg) {
-                    result = ad2425w_write_ctrl_reg(ad2425w,
+                    result = ad2425w_cache_write(ad2425w,
                         reg, val, row->i2c_addr
                     );
                 }
                 else {
+                    result = ad2425w_cache_flush(ad2425w);
+                    if (result != AD2425W_SIMPLE_SUCCESS) {
+                        return(result);
+                    }
                     result = ad2425w_write_ctrl_reg_block(ad2425w,
                         row->addr, row->addr_width,
                         row->data_count, row->config_data, row->i2c_addr
                     );
+                    if ((row->i2c_addr == ad2425w->_twi_master_addr) &&
+                        (row->addr_width == 1)) {
+                        AD2425_MEMSET(ad2425w->_shadow_valid, 0,
+                            sizeof(ad2425w->_shadow_valid));
+                    }
                 }
                 if (result != AD2425W_SIMPLE_SUCCESS) {
                     return(result);
@@ -536,7 +564,7 @@ BM_AD2425W_RESULT ad2425w_load_init_sequence(
 
                 /* Can only process single register reads */
                 if (single_reg) {
-                    result = ad2425w_read_ctrl_reg(ad2425w, reg, &read_val, row->i2c_addr);
+                    result = ad2425w_cache_read(ad2425w, reg, &read_val, row->i2c_addr);
                     if (result != AD2425W_SIMPLE_SUCCESS) {
                         return(result);
                     }
@@ -554,6 +582,12 @@ BM_AD2425W_RESULT ad2425w_load_init_sequence(
                     return(AD2425W_UNSUPPORTED_DATA_WIDTH);
                 }
 
+                /* Everything written so far must land before waiting */
+                result = ad2425w_cache_flush(ad2425w);
+                if (result != AD2425W_SIMPLE_SUCCESS) {
+                    return(result);
+                }
+
                 /* Calculate the delay */
                 delay_ms = row->config_data[0];
                 if (row->data_count == 2) {
@@ -637,7 +671,241 @@ next_row:
         row++;
     }
 
-    return AD2425W_SIMPLE_SUCCESS;
+    return(ad2425w_cache_flush(ad2425w));
+}
+
+/***********************************************************************
+ * Shadow register cache
+ *
+ * Master register writes are remembered in a shadow copy so a write
+ * which would not change a register is skipped, and reads of
+ * registers written or read earlier are answered without a TWI
+ * transfer.  Writes to consecutive registers of the same I2C address
+ * are held back and sent as one auto-incrementing TWI write.  The
+ * pending burst is flushed before any other access, before every delay
+ * and IRQ poll, and at the end of the init sequence so the device
+ * sees the writes in their original order.
+ ***********************************************************************/
+
+/*
+ * Registers which change on their own or have side effects when
+ * written.  These are always read from the device, and writes to them
+ * are never skipped or merged into a burst.
+ */
+static bool ad2425w_reg_volatile(uint8_t reg)
+{
+    switch (reg) {
+        case AD2425W_REG_CHIP:
+        case AD2425W_REG_SWCTL:
+        case AD2425W_REG_CONTROL:
+        case AD2425W_REG_DISCVRY:
+        case AD2425W_REG_SWSTAT:
+        case AD2425W_REG_INTSTAT:
+        case AD2425W_REG_INTSRC:
+        case AD2425W_REG_INTTYPE:
+        case AD2425W_REG_INTPND0:
+        case AD2425W_REG_INTPND1:
+        case AD2425W_REG_INTPND2:
+        case AD2425W_REG_BECCNT:
+        case AD2425W_REG_ERRCNT0:
+        case AD2425W_REG_ERRCNT1:
+        case AD2425W_REG_ERRCNT2:
+        case AD2425W_REG_ERRCNT3:
+        case AD2425W_REG_NODE:
+        case AD2425W_REG_DISCSTAT:
+        case AD2425W_REG_LINTTYPE:
+        case AD2425W_REG_GPIODAT:
+        case AD2425W_REG_GPIODATSET:
+        case AD2425W_REG_GPIODATCLR:
+        case AD2425W_REG_GPIOIN:
+        case AD2425W_REG_RAISE:
+        case AD2425W_REG_GENERR:
+            return(true);
+        default:
+            break;
+    }
+
+    /* Mailboxes and anything unknown above them */
+    return(reg >= AD2425W_REG_MBOX0_CTL);
+}
+
+static bool ad2425w_shadow_valid(BM_AD2425W_CONTROLLER *ad2425w, uint8_t reg)
+{
+    return((ad2425w->_shadow_valid[reg >> 3] & (1 << (reg & 7))) != 0);
+}
+
+static void ad2425w_shadow_set(BM_AD2425W_CONTROLLER *ad2425w,
+    uint8_t reg, uint8_t value)
+{
+    ad2425w->_shadow[reg] = value;
+    ad2425w->_shadow_valid[reg >> 3] |= (1 << (reg & 7));
+}
+
+/*
+ * Writes through the slave address go to the node selected by NODEADDR.
+ * Only merge them while it is known that NODEADDR selects node
+ * registers rather than a remote peripheral, which may not
+ * auto-increment.
+ */
+static bool ad2425w_burst_ok(BM_AD2425W_CONTROLLER *ad2425w,
+    uint8_t reg, uint8_t i2cAddr)
+{
+    if (ad2425w_reg_volatile(reg)) {
+        return(false);
+    }
+    if (i2cAddr == ad2425w->_twi_master_addr) {
+        return(true);
+    }
+    if (i2cAddr == ad2425w->_twi_slave_addr) {
+        return(ad2425w_shadow_valid(ad2425w, AD2425W_REG_NODEADDR) &&
+            !(ad2425w->_shadow[AD2425W_REG_NODEADDR] &
+                AD2425W_BITM_NODEADDR_PERI));
+    }
+    return(false);
+}
+
+/**
+ * @brief      Writes out the pending burst, if any
+ *
+ * @param      ad2425w  The instance of the driver
+ */
+static BM_AD2425W_RESULT ad2425w_cache_flush(BM_AD2425W_CONTROLLER *ad2425w)
+{
+    TWI_SIMPLE_RESULT twiResult;
+    uint16_t len;
+
+    len = ad2425w->_burst_len;
+    if (len == 0) {
+        return(AD2425W_SIMPLE_SUCCESS);
+    }
+    ad2425w->_burst_len = 0;
+
+    // Write start register followed by the data
+    twiResult = twi_write(ad2425w->_twi, ad2425w->_burst_i2c_addr,
+        ad2425w->_burst, len + 1);
+    ad2425w->cache_stats.twi_writes++;
+
+    // The device state is unknown after a failure
+    if (twiResult != TWI_SIMPLE_SUCCESS) {
+        AD2425_MEMSET(ad2425w->_shadow_valid, 0,
+            sizeof(ad2425w->_shadow_valid));
+        return(AD2425W_A2B_I2C_WRITE_ERROR);
+    }
+
+    return(AD2425W_SIMPLE_SUCCESS);
+}
+
+/**
+ * @brief      Writes a control register through the shadow cache
+ *
+ * @param      ad2425w  The instance of the driver
+ * @param[in]  reg      The register address
+ * @param[in]  value    The value
+ * @param[in]  i2cAddr  I2C address
+ */
+static BM_AD2425W_RESULT ad2425w_cache_write(BM_AD2425W_CONTROLLER *ad2425w,
+    uint8_t reg, uint8_t value, uint8_t i2cAddr)
+{
+    BM_AD2425W_RESULT result;
+    bool master, follows;
+
+    ad2425w->cache_stats.reg_writes++;
+
+#if (AD2425W_CACHE == 0)
+    return(ad2425w_write_ctrl_reg(ad2425w, reg, value, i2cAddr));
+#endif
+
+    master = (i2cAddr == ad2425w->_twi_master_addr);
+
+    // Volatile registers and remote peripherals are written directly
+    if (!ad2425w_burst_ok(ad2425w, reg, i2cAddr)) {
+        result = ad2425w_cache_flush(ad2425w);
+        if (result != AD2425W_SIMPLE_SUCCESS) {
+            return(result);
+        }
+        result = ad2425w_write_ctrl_reg(ad2425w, reg, value, i2cAddr);
+
+        // A soft reset returns every register to its default
+        if (master && (reg == AD2425W_REG_CONTROL) &&
+            (value & AD2425W_BITM_CONTROL_SOFTRST)) {
+            AD2425_MEMSET(ad2425w->_shadow_valid, 0,
+                sizeof(ad2425w->_shadow_valid));
+        }
+        return(result);
+    }
+
+    follows = (ad2425w->_burst_len > 0) &&
+        (ad2425w->_burst_len < AD2425W_CACHE_BURST) &&
+        (ad2425w->_burst_i2c_addr == i2cAddr) &&
+        ((ad2425w->_burst[0] + ad2425w->_burst_len) == reg);
+
+    // Skip a write which would not change the register, unless
+    // it is cheaper to carry it along in the pending burst
+    if (master && !follows && ad2425w_shadow_valid(ad2425w, reg) &&
+        (ad2425w->_shadow[reg] == value)) {
+        ad2425w->cache_stats.writes_elided++;
+        return(AD2425W_SIMPLE_SUCCESS);
+    }
+
+    if (master) {
+        ad2425w_shadow_set(ad2425w, reg, value);
+    }
+
+    // Extend the pending burst
+    if (follows) {
+        ad2425w->_burst[1 + ad2425w->_burst_len] = value;
+        ad2425w->_burst_len++;
+        ad2425w->cache_stats.writes_coalesced++;
+        return(AD2425W_SIMPLE_SUCCESS);
+    }
+
+    // Or start a new one
+    result = ad2425w_cache_flush(ad2425w);
+    if (result != AD2425W_SIMPLE_SUCCESS) {
+        return(result);
+    }
+    ad2425w->_burst_i2c_addr = i2cAddr;
+    ad2425w->_burst[0] = reg;
+    ad2425w->_burst[1] = value;
+    ad2425w->_burst_len = 1;
+
+    return(AD2425W_SIMPLE_SUCCESS);
+}
+
+/**
+ * @brief      Reads a control register through the shadow cache
+ *
+ * @param      ad2425w  The instance of the driver
+ * @param[in]  reg      The register address
+ * @param[out] value    The value
+ * @param[in]  i2cAddr  I2C address
+ */
+static BM_AD2425W_RESULT ad2425w_cache_read(BM_AD2425W_CONTROLLER *ad2425w,
+    uint8_t reg, uint8_t *value, uint8_t i2cAddr)
+{
+    BM_AD2425W_RESULT result;
+    bool cacheable;
+
+    cacheable = AD2425W_CACHE &&
+        (i2cAddr == ad2425w->_twi_master_addr) && !ad2425w_reg_volatile(reg);
+
+    if (cacheable && ad2425w_shadow_valid(ad2425w, reg)) {
+        *value = ad2425w->_shadow[reg];
+        ad2425w->cache_stats.reads_cached++;
+        return(AD2425W_SIMPLE_SUCCESS);
+    }
+
+    result = ad2425w_cache_flush(ad2425w);
+    if (result != AD2425W_SIMPLE_SUCCESS) {
+        return(result);
+    }
+
+    result = ad2425w_read_ctrl_reg(ad2425w, reg, value, i2cAddr);
+    if ((result == AD2425W_SIMPLE_SUCCESS) && cacheable) {
+        ad2425w_shadow_set(ad2425w, reg, *value);
+    }
+
+    return(result);
 }
 
 /**
@@ -658,6 +926,7 @@ static BM_AD2425W_RESULT ad2425w_write_ctrl_reg(BM_AD2425W_CONTROLLER *ad2425w,
     uint8_t seq[2] = {reg, value};
 
     twiResult = twi_write(ad2425w->_twi, i2cAddr, seq, 2);
+    ad2425w->cache_stats.twi_writes++;
 
     return (twiResult == TWI_SIMPLE_SUCCESS ?
         AD2425W_SIMPLE_SUCCESS : AD2425W_A2B_I2C_WRITE_ERROR);
@@ -706,6 +975,7 @@ static BM_AD2425W_RESULT ad2425w_write_ctrl_reg_block(BM_AD2425W_CONTROLLER *ad2
     // Write address followed by block of data
     twiResult = twi_write(ad2425w->_twi, i2cAddr,
         seq, addr_bytes + len);
+    ad2425w->cache_stats.twi_writes++;
 
     // Free addr+data buffer
     if (seq) {
@@ -732,6 +1002,7 @@ static BM_AD2425W_RESULT ad2425w_read_ctrl_reg(BM_AD2425W_CONTROLLER *ad2425w,
     TWI_SIMPLE_RESULT twiResult;
 
     twiResult = twi_writeRead(ad2425w->_twi, i2cAddr, &reg, 1, value, 1);
+    ad2425w->cache_stats.twi_reads++;
 
     return (twiResult == TWI_SIMPLE_SUCCESS ?
         AD2425W_SIMPLE_SUCCESS : AD2425W_A2B_I2C_READ_ERROR);
@@ -755,6 +1026,7 @@ static BM_AD2425W_RESULT ad2425w_read_ctrl_reg_block(BM_AD2425W_CONTROLLER *ad24
     TWI_SIMPLE_RESULT twiResult;
 
     twiResult = twi_writeRead(ad2425w->_twi, i2cAddr, &reg, 1, values, len);
+    ad2425w->cache_stats.twi_reads++;
 
     return (twiResult == TWI_SIMPLE_SUCCESS ?
         AD2425W_SIMPLE_SUCCESS : AD2425W_A2B_I2C_READ_ERROR);
@@ -20,7 +20,24 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "ad2425w_cfg.h"
+
+/* Host builds (ad2425w_sim) have no TWI driver */
+#ifdef AD2425W_SIM_HOST
+#include "ad2425w_sim.h"
+#else
 #include "twi_simple.h"
+#endif
+
+/* Shadow register cache (1 = enabled, 0 = every access goes to the TWI) */
+#ifndef AD2425W_CACHE
+#define AD2425W_CACHE       (1)
+#endif
+
+/* Largest number of consecutive register writes merged into one TWI write */
+#ifndef AD2425W_CACHE_BURST
+#define AD2425W_CACHE_BURST (32)
+#endif
 
 // Used to read A2BConfig files generated by SigmaStudio
 #define     A2B_WRITE   ((unsigned char)0x00u)
@@ -155,6 +172,7 @@
 #define     AD2425W_BITM_CONTROL_MSTR           0x80
 #define     AD2425W_BITM_CONTROL_SOFTRST        0x04
 #define     AD2425W_BITM_INTSRC_MSTINT          0x80
+#define     AD2425W_BITM_NODEADDR_PERI          0x20
 
 typedef enum
 {
@@ -196,6 +214,16 @@ typedef struct
     uint8_t version;
 } BM_AD2425W_A2B_BUS_NODE;
 
+typedef struct
+{
+    uint32_t reg_writes;                // Single register writes requested
+    uint32_t writes_elided;             // Writes matching the shadow, skipped
+    uint32_t writes_coalesced;          // Writes merged into a burst
+    uint32_t reads_cached;              // Reads served from the shadow
+    uint32_t twi_writes;                // TWI write transactions
+    uint32_t twi_reads;                 // TWI read transactions
+} BM_AD2425W_CACHE_STATS;
+
 typedef struct
 {
     /* These elements are used by the application */
@@ -204,6 +232,7 @@ typedef struct
     uint16_t init_line;
     uint8_t I2SGCFG;
     uint8_t I2SCFG;
+    BM_AD2425W_CACHE_STATS cache_stats;
 
     /* These structure elements are used exclusively by the driver */
     sTWI *_twi;                        // Simple TWI driver
@@ -211,6 +240,13 @@ typedef struct
     uint8_t _twi_slave_addr;           // Slave address of A2B controller
     BM_AD2425W_MODE _mode;
 
+    /* Shadow register cache */
+    uint8_t _shadow[256];              // Master register shadow
+    uint8_t _shadow_valid[256 / 8];    // Shadow valid bits
+    uint8_t _burst[AD2425W_CACHE_BURST + 1]; // Pending write (reg + data)
+    uint16_t _burst_len;               // Pending data bytes
+    uint8_t _burst_i2c_addr;           // Pending write I2C address
+
 } BM_AD2425W_CONTROLLER;
 
 #ifdef __cplusplus
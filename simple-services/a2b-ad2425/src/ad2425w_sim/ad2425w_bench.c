@@ -0,0 +1,332 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host discovery and init benchmark of the a2b-ad2425 service.
+ *
+ * A SigmaStudio style init sequence is built for chains of 1 to n
+ * slave nodes and run with ad2425w_load_init_sequence() against
+ * ad2425w_sim.  The simulated init time, TWI bus time and transfers
+ * and the shadow register cache statistics are reported for each
+ * chain, and the discovered nodes and a few of the registers written
+ * are checked.  The registers of the longest chain can be saved to
+ * compare a build with and without the cache.
+ *
+ * Build from the 'a2b-ad2425' directory with:
+ *   gcc -O2 -DAD2425W_SIM_HOST -Isrc/ad2425w_sim -Isrc -o ad2425w_bench \
+ *       src/ad2425w_sim/ad2425w_bench.c src/ad2425w.c \
+ *       src/ad2425w_sim/ad2425w_sim.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ad2425w.h"
+#include "ad2425w_sim.h"
+
+#define BENCH_I2C_ADDR      (0x68)
+#define BENCH_MAX_ROWS      (1024)
+#define BENCH_MAX_DATA      (4096)
+
+/* Line structure - must match ADI_A2B_DISCOVERY_CONFIG in ad2425w.c */
+typedef struct {
+    unsigned char i2c_addr;
+    unsigned char cmd;
+    unsigned char addr_width;
+    unsigned int addr;
+    unsigned char data_width;
+    unsigned short data_count;
+    unsigned char *config_data;
+} BENCH_ROW;
+
+typedef struct {
+    BENCH_ROW rows[BENCH_MAX_ROWS];
+    uint8_t data[BENCH_MAX_DATA];
+    unsigned numRows;
+    unsigned numData;
+} BENCH_SEQ;
+
+static BENCH_SEQ seq;
+
+static void bench_add(uint8_t i2cAddr, uint8_t cmd, unsigned addr,
+    uint8_t addrWidth, const uint8_t *data, unsigned len)
+{
+    BENCH_ROW *row = &seq.rows[seq.numRows++];
+
+    row->i2c_addr = i2cAddr;
+    row->cmd = cmd;
+    row->addr_width = addrWidth;
+    row->addr = addr;
+    row->data_width = 1;
+    row->data_count = len;
+    row->config_data = &seq.data[seq.numData];
+    memcpy(&seq.data[seq.numData], data, len);
+    seq.numData += len;
+}
+
+static void bench_write(uint8_t i2cAddr, unsigned reg, uint8_t value)
+{
+    bench_add(i2cAddr, A2B_WRITE, reg, 1, &value, 1);
+}
+
+static void bench_read(uint8_t i2cAddr, unsigned reg)
+{
+    uint8_t value = 0;
+    bench_add(i2cAddr, A2B_READ, reg, 1, &value, 1);
+}
+
+static void bench_delay(uint8_t ms)
+{
+    bench_add(0x00, A2B_DELAY, 0, 1, &ms, 1);
+}
+
+static uint8_t bench_respcycs(int node)
+{
+    return(0x78 - node * 4);
+}
+
+/* Discovery and configuration of the master and 'nodes' slave nodes */
+static void bench_sequence(int nodes)
+{
+    const uint8_t m = BENCH_I2C_ADDR;
+    const uint8_t s = BENCH_I2C_ADDR + 1;
+    const uint8_t periph[] = { 0x10, 0x00, 0x01 };
+    unsigned reg;
+    int n;
+
+    seq.numRows = 0;
+    seq.numData = 0;
+
+    bench_write(m, AD2425W_REG_CONTROL, 0x84);
+    bench_delay(25);
+    bench_read(m, AD2425W_REG_VENDOR);
+    bench_read(m, AD2425W_REG_PRODUCT);
+    bench_read(m, AD2425W_REG_VERSION);
+    bench_write(m, AD2425W_REG_INTMSK0, 0x10);
+    bench_write(m, AD2425W_REG_INTMSK1, 0x00);
+    bench_write(m, AD2425W_REG_INTMSK2, 0x0F);
+    bench_write(m, AD2425W_REG_RESPCYCS, 0x7C);
+    bench_write(m, AD2425W_REG_CONTROL, 0x81);
+    bench_write(m, AD2425W_REG_I2CCFG, 0x01);
+    bench_write(m, AD2425W_REG_PLLCTL, 0x00);
+    bench_write(m, AD2425W_REG_I2SGCFG, 0x12);
+    bench_write(m, AD2425W_REG_I2SCFG, 0x11);
+    bench_write(m, AD2425W_REG_I2SRATE, 0x00);
+    bench_write(m, AD2425W_REG_I2STXOFFSET, 0x00);
+    bench_write(m, AD2425W_REG_I2SRXOFFSET, 0x00);
+    bench_write(m, AD2425W_REG_SYNCOFFSET, 0x00);
+    bench_write(m, AD2425W_REG_PDMCTL, 0x00);
+    bench_write(m, AD2425W_REG_ERRMGMT, 0x00);
+
+    for (n = 0; n < nodes; n++) {
+        bench_write(m, AD2425W_REG_NODEADDR, 0x00);
+        bench_write(m, AD2425W_REG_SWCTL, 0x01);
+        bench_write(m, AD2425W_REG_DISCVRY, 0x7C);
+        bench_delay(35);
+        bench_write(m, AD2425W_REG_NODEADDR, n);
+        bench_read(s, AD2425W_REG_VENDOR);
+        bench_read(s, AD2425W_REG_PRODUCT);
+        bench_read(s, AD2425W_REG_VERSION);
+        bench_read(s, AD2425W_REG_CAPABILITY);
+        bench_write(m, AD2425W_REG_INTMSK0, 0x10);
+        bench_write(m, AD2425W_REG_INTMSK1, 0x00);
+        bench_write(m, AD2425W_REG_INTMSK2, 0x0F);
+        bench_write(m, AD2425W_REG_NODEADDR, n);
+        bench_write(s, AD2425W_REG_LDNSLOTS, 0x02);
+        bench_write(s, AD2425W_REG_LUPSLOTS, 0x02);
+        bench_write(s, AD2425W_REG_DNSLOTS, 0x00);
+        bench_write(s, AD2425W_REG_UPSLOTS, 0x02);
+        bench_write(s, AD2425W_REG_RESPCYCS, bench_respcycs(n));
+        bench_write(s, AD2425W_REG_SLOTFMT, 0x00);
+        bench_write(s, AD2425W_REG_DATCTL, 0x03);
+        for (reg = AD2425W_REG_I2CCFG; reg <= AD2425W_REG_CLKCFG; reg++) {
+            bench_write(s, reg, 0x00);
+        }
+        bench_write(s, AD2425W_REG_GPIOOEN, 0x00);
+        bench_write(s, AD2425W_REG_GPIOIEN, 0x00);
+        bench_write(s, AD2425W_REG_PINTEN, 0x00);
+        bench_write(s, AD2425W_REG_PINTINV, 0x00);
+        bench_write(s, AD2425W_REG_PINCFG, 0x01);
+        /* A remote peripheral on the node */
+        bench_write(m, AD2425W_REG_NODEADDR, AD2425W_BITM_NODEADDR_PERI | n);
+        bench_add(s, A2B_WRITE, 0x4000, 2, periph, sizeof(periph));
+        bench_write(m, AD2425W_REG_NODEADDR, n);
+        bench_write(s, AD2425W_REG_INTMSK0, 0x10);
+        bench_write(s, AD2425W_REG_INTMSK1, 0x00);
+        bench_write(s, AD2425W_REG_INTMSK2, 0x0F);
+    }
+
+    bench_write(m, AD2425W_REG_NODEADDR, 0x00);
+    bench_write(m, AD2425W_REG_DNSLOTS, 0x04);
+    bench_write(m, AD2425W_REG_UPSLOTS, 0x04);
+    bench_write(m, AD2425W_REG_SLOTFMT, 0x44);
+    bench_write(m, AD2425W_REG_DATCTL, 0x03);
+    bench_write(m, AD2425W_REG_CONTROL, 0x81);
+    bench_delay(1);
+    bench_write(m, AD2425W_REG_SWCTL, 0x01);
+    bench_read(m, AD2425W_REG_I2SGCFG);
+    bench_read(m, AD2425W_REG_NODEADDR);
+}
+
+static int bench_check(sTWI *twi, const AD2425W_SIM_CONFIG *cfg,
+    BM_AD2425W_CONTROLLER *ad2425w, BM_AD2425W_RESULT result)
+{
+    uint8_t *regs;
+    int n;
+
+    if (result != AD2425W_SIMPLE_SUCCESS) {
+        printf("  result %s at line %u\n",
+            ad2425w_result_str(result), ad2425w->init_line);
+        return(1);
+    }
+    if ((ad2425w->nodes_discovered != cfg->numNodes) ||
+        (ad2425w_sim_discovered(twi) != cfg->numNodes)) {
+        printf("  %u nodes discovered\n", ad2425w->nodes_discovered);
+        return(1);
+    }
+    for (n = 0; n < cfg->numNodes; n++) {
+        regs = ad2425w_sim_regs(twi, n);
+        if ((ad2425w->nodes[n].vendor != cfg->nodes[n].vendor) ||
+            (ad2425w->nodes[n].product != cfg->nodes[n].product) ||
+            (ad2425w->nodes[n].version != cfg->nodes[n].version)) {
+            printf("  node %d identity mismatch\n", n);
+            return(1);
+        }
+        if ((regs[AD2425W_REG_RESPCYCS] != bench_respcycs(n)) ||
+            (regs[AD2425W_REG_DATCTL] != 0x03) ||
+            (regs[AD2425W_REG_PINCFG] != 0x01)) {
+            printf("  node %d registers not written\n", n);
+            return(1);
+        }
+    }
+    regs = ad2425w_sim_regs(twi, -1);
+    if ((regs[AD2425W_REG_SLOTFMT] != 0x44) ||
+        (regs[AD2425W_REG_I2SGCFG] != 0x12)) {
+        printf("  master registers not written\n");
+        return(1);
+    }
+
+    return(0);
+}
+
+static bool bench_save(sTWI *twi, int nodes, const char *path)
+{
+    FILE *f;
+    bool ok;
+    int n;
+
+    f = fopen(path, "wb");
+    if (f == NULL) {
+        return(false);
+    }
+    ok = (fwrite(ad2425w_sim_regs(twi, -1), 256, 1, f) == 1);
+    for (n = 0; n < nodes; n++) {
+        ok = ok && (fwrite(ad2425w_sim_regs(twi, n), 256, 1, f) == 1);
+    }
+    fclose(f);
+
+    return(ok);
+}
+
+static void usage(void)
+{
+    printf("ad2425w_bench [options]\n");
+    printf("  -n <nodes>   Longest chain, runs 1 to n nodes (4, max %d)\n",
+        AD2425W_SIM_MAX_NODES);
+    printf("  -s <kHz>     TWI speed (400)\n");
+    printf("  -x <nS>      Fixed cost of each TWI transfer (20000)\n");
+    printf("  -p <uS>      Soft reset to PLL lock (2000)\n");
+    printf("  -d <uS>      DISCVRY write to node discovery (10000)\n");
+    printf("  -o <file>    Save the registers of the longest chain\n");
+}
+
+int main(int argc, char **argv)
+{
+    AD2425W_SIM_CONFIG cfg = {
+        .i2cAddr = BENCH_I2C_ADDR,
+        .twiBitNs = 2500,
+        .twiXferNs = 20000,
+        .pllLockNs = 2000000,
+        .discoveryNs = 10000000
+    };
+    static BM_AD2425W_CONTROLLER ad2425w;
+    BM_AD2425W_RESULT result;
+    AD2425W_SIM_STATS stats;
+    const char *path = NULL;
+    unsigned khz = 400;
+    int maxNodes = 4;
+    int fails = 0;
+    sTWI *twi;
+    int n, c;
+
+    while ((c = getopt(argc, argv, "n:s:x:p:d:o:h")) != -1) {
+        switch (c) {
+            case 'n': maxNodes = atoi(optarg); break;
+            case 's': khz = strtoul(optarg, NULL, 0); break;
+            case 'x': cfg.twiXferNs = strtoul(optarg, NULL, 0); break;
+            case 'p': cfg.pllLockNs = strtoul(optarg, NULL, 0) * 1000; break;
+            case 'd': cfg.discoveryNs = strtoul(optarg, NULL, 0) * 1000; break;
+            case 'o': path = optarg; break;
+            default: usage(); return(1);
+        }
+    }
+    if ((maxNodes < 1) || (maxNodes > AD2425W_SIM_MAX_NODES) ||
+        (khz == 0) || (khz > 1000)) {
+        usage();
+        return(1);
+    }
+    cfg.twiBitNs = 1000000 / khz;
+    for (n = 0; n < AD2425W_SIM_MAX_NODES; n++) {
+        cfg.nodes[n].vendor = 0xAD;
+        cfg.nodes[n].product = 0x26;
+        cfg.nodes[n].version = 0x10 + n;
+    }
+
+    printf("Cache %s, TWI %ukHz, %u nS per transfer\n\n",
+        AD2425W_CACHE ? "enabled" : "disabled", khz, cfg.twiXferNs);
+    printf("%-5s %5s %9s %9s %9s %6s %7s %7s %7s %7s\n", "nodes", "rows",
+        "init ms", "bus ms", "delay ms", "xfers", "bytes", "skipped",
+        "merged", "cached");
+
+    for (n = 1; n <= maxNodes; n++) {
+        cfg.numNodes = n;
+        bench_sequence(n);
+        twi = ad2425w_sim_open(&cfg);
+        if (twi == NULL) {
+            printf("ad2425w_sim_open failed\n");
+            return(1);
+        }
+        ad2425w_initialize(&ad2425w, AD2425W_SIMPLE_MASTER,
+            BENCH_I2C_ADDR, twi);
+        result = ad2425w_load_init_sequence(&ad2425w,
+            seq.rows, seq.numRows * sizeof(BENCH_ROW));
+        ad2425w_sim_stats(twi, &stats, false);
+        printf("%-5d %5u %9.3f %9.3f %9.3f %6u %7llu %7u %7u %7u\n",
+            n, seq.numRows, ad2425w_sim_time() / 1e6, stats.busNs / 1e6,
+            stats.delayNs / 1e6, stats.writes + stats.writeReads,
+            (unsigned long long)stats.bytes,
+            ad2425w.cache_stats.writes_elided,
+            ad2425w.cache_stats.writes_coalesced,
+            ad2425w.cache_stats.reads_cached);
+        fails += bench_check(twi, &cfg, &ad2425w, result);
+        if ((n == maxNodes) && path && !bench_save(twi, n, path)) {
+            printf("Cannot save '%s'\n", path);
+            fails++;
+        }
+        ad2425w_sim_close(twi);
+    }
+
+    return(fails ? 2 : 0);
+}
@@ -0,0 +1,19 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host (ad2425w_sim) configuration, the init sequence buffers come
+ * from the C library heap.  Use in place of 'inc/ad2425w_cfg.h'.
+ */
+#ifndef _ad2425w_cfg_h
+#define _ad2425w_cfg_h
+
+#endif
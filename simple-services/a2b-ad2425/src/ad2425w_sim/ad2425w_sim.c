@@ -0,0 +1,335 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ad2425w.h"
+#include "ad2425w_sim.h"
+
+/* Interrupt types raised by the simulator */
+#define AD2425W_SIM_INT_DISCOVERY   (24)
+#define AD2425W_SIM_INT_PLL_LOCK    (255)
+
+/* Node address field of NODEADDR */
+#define AD2425W_SIM_NODEADDR_NODE   (0x0F)
+
+/* Master identity */
+#define AD2425W_SIM_VENDOR          (0xAD)
+#define AD2425W_SIM_PRODUCT         (0x25)
+#define AD2425W_SIM_VERSION         (0x10)
+
+struct sTWI {
+    AD2425W_SIM_CONFIG cfg;
+    uint8_t master[256];
+    uint8_t nodes[AD2425W_SIM_MAX_NODES][256];
+    uint8_t discovered;             /* Nodes reachable */
+    bool irqPending;                /* Interrupt scheduled */
+    uint8_t irqType;                /* Scheduled interrupt type */
+    uint64_t irqAt;                 /* Scheduled interrupt time */
+    AD2425W_SIM_STATS stats;
+};
+
+static sTWI *sim = NULL;
+static uint64_t simNow = 0;
+
+static void ad2425w_sim_advance(uint64_t ns)
+{
+    struct timespec ts;
+
+    simNow += ns;
+
+    if (sim && sim->cfg.realTime && ns) {
+        ts.tv_sec = ns / 1000000000ull;
+        ts.tv_nsec = ns % 1000000000ull;
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void ad2425w_sim_bus(sTWI *twi, uint32_t bytes, uint32_t xfers)
+{
+    uint64_t ns;
+
+    ns = (uint64_t)bytes * 9 * twi->cfg.twiBitNs +
+        (uint64_t)xfers * twi->cfg.twiXferNs;
+    twi->stats.bytes += bytes;
+    twi->stats.busNs += ns;
+    ad2425w_sim_advance(ns);
+}
+
+static void ad2425w_sim_identity(uint8_t *regs, const AD2425W_SIM_NODE *id)
+{
+    regs[AD2425W_REG_VENDOR] = id->vendor;
+    regs[AD2425W_REG_PRODUCT] = id->product;
+    regs[AD2425W_REG_VERSION] = id->version;
+}
+
+static void ad2425w_sim_reset(sTWI *twi)
+{
+    AD2425W_SIM_NODE id = {
+        AD2425W_SIM_VENDOR, AD2425W_SIM_PRODUCT, AD2425W_SIM_VERSION
+    };
+    int i;
+
+    memset(twi->master, 0, sizeof(twi->master));
+    ad2425w_sim_identity(twi->master, &id);
+
+    memset(twi->nodes, 0, sizeof(twi->nodes));
+    for (i = 0; i < AD2425W_SIM_MAX_NODES; i++) {
+        ad2425w_sim_identity(twi->nodes[i], &twi->cfg.nodes[i]);
+    }
+
+    twi->discovered = 0;
+    twi->irqPending = false;
+}
+
+static void ad2425w_sim_irq(sTWI *twi, uint8_t type, uint32_t ns)
+{
+    twi->irqPending = true;
+    twi->irqType = type;
+    twi->irqAt = simNow + ns;
+}
+
+static bool ad2425w_sim_irq_active(sTWI *twi)
+{
+    return(twi->irqPending && (simNow >= twi->irqAt));
+}
+
+static bool ad2425w_sim_read_only(uint8_t reg)
+{
+    return((reg >= AD2425W_REG_VENDOR) && (reg <= AD2425W_REG_CAPABILITY));
+}
+
+/*
+ * Returns the registers addressed through 'address', or NULL if the
+ * address or the node selected by NODEADDR is not there.  Remote
+ * peripheral accesses are acknowledged and land in 'peri'.
+ */
+static uint8_t *ad2425w_sim_target(sTWI *twi, uint8_t address, bool *peri)
+{
+    uint8_t node;
+
+    *peri = false;
+    if (address == twi->cfg.i2cAddr) {
+        return(twi->master);
+    }
+    if (address != (twi->cfg.i2cAddr + 1)) {
+        return(NULL);
+    }
+    node = twi->master[AD2425W_REG_NODEADDR] & AD2425W_SIM_NODEADDR_NODE;
+    if (node >= twi->discovered) {
+        return(NULL);
+    }
+    *peri = (twi->master[AD2425W_REG_NODEADDR] & AD2425W_BITM_NODEADDR_PERI);
+    return(twi->nodes[node]);
+}
+
+static void ad2425w_sim_master_write(sTWI *twi, uint8_t reg, uint8_t value)
+{
+    if (ad2425w_sim_read_only(reg)) {
+        return;
+    }
+    twi->master[reg] = value;
+
+    if ((reg == AD2425W_REG_CONTROL) &&
+        (value & AD2425W_BITM_CONTROL_SOFTRST)) {
+        ad2425w_sim_reset(twi);
+        ad2425w_sim_irq(twi, AD2425W_SIM_INT_PLL_LOCK, twi->cfg.pllLockNs);
+    } else if (reg == AD2425W_REG_DISCVRY) {
+        if (twi->discovered < twi->cfg.numNodes) {
+            ad2425w_sim_irq(twi, AD2425W_SIM_INT_DISCOVERY,
+                twi->cfg.discoveryNs);
+        }
+    }
+}
+
+static uint8_t ad2425w_sim_master_read(sTWI *twi, uint8_t reg)
+{
+    uint8_t value;
+
+    switch (reg) {
+        case AD2425W_REG_INTSRC:
+            value = ad2425w_sim_irq_active(twi) ?
+                AD2425W_BITM_INTSRC_MSTINT : 0x00;
+            break;
+        case AD2425W_REG_INTTYPE:
+            /* Reading the type clears the interrupt */
+            value = 0x00;
+            if (ad2425w_sim_irq_active(twi)) {
+                value = twi->irqType;
+                if (value == AD2425W_SIM_INT_DISCOVERY) {
+                    twi->discovered++;
+                }
+                twi->irqPending = false;
+            }
+            break;
+        default:
+            value = twi->master[reg];
+            break;
+    }
+
+    return(value);
+}
+
+TWI_SIMPLE_RESULT twi_write(sTWI *twi, uint8_t address,
+    uint8_t *out, uint16_t outLen)
+{
+    uint8_t *regs;
+    uint8_t reg;
+    bool peri;
+    int i;
+
+    twi->stats.writes++;
+    ad2425w_sim_bus(twi, 1 + outLen, 1);
+
+    regs = ad2425w_sim_target(twi, address, &peri);
+    if (regs == NULL) {
+        twi->stats.naks++;
+        return(TWI_SIMPLE_ERROR);
+    }
+    if (peri || (outLen < 1)) {
+        return(TWI_SIMPLE_SUCCESS);
+    }
+
+    /* Register address followed by auto-incrementing data */
+    reg = out[0];
+    for (i = 1; i < outLen; i++) {
+        if (regs == twi->master) {
+            ad2425w_sim_master_write(twi, reg, out[i]);
+        } else if (!ad2425w_sim_read_only(reg)) {
+            regs[reg] = out[i];
+        }
+        twi->stats.regWrites++;
+        reg++;
+    }
+
+    return(TWI_SIMPLE_SUCCESS);
+}
+
+TWI_SIMPLE_RESULT twi_writeRead(sTWI *twi, uint8_t address,
+    uint8_t *out, uint16_t outLen, uint8_t *in, uint16_t inLen)
+{
+    uint8_t *regs;
+    uint8_t reg;
+    bool peri;
+    int i;
+
+    twi->stats.writeReads++;
+    ad2425w_sim_bus(twi, 2 + outLen + inLen, 1);
+
+    regs = ad2425w_sim_target(twi, address, &peri);
+    if (regs == NULL) {
+        twi->stats.naks++;
+        return(TWI_SIMPLE_ERROR);
+    }
+    if (peri || (outLen < 1)) {
+        memset(in, 0, inLen);
+        return(TWI_SIMPLE_SUCCESS);
+    }
+
+    reg = out[0];
+    for (i = 0; i < inLen; i++) {
+        if (regs == twi->master) {
+            in[i] = ad2425w_sim_master_read(twi, reg);
+        } else {
+            in[i] = regs[reg];
+        }
+        twi->stats.regReads++;
+        reg++;
+    }
+
+    return(TWI_SIMPLE_SUCCESS);
+}
+
+uint32_t getTimeStamp(void)
+{
+    return((uint32_t)(simNow / 1000));
+}
+
+uint32_t elapsedTimeMs(uint32_t elapsed)
+{
+    return(elapsed / 1000);
+}
+
+void delay(unsigned ms)
+{
+    uint64_t ns = (uint64_t)ms * 1000000;
+
+    if (sim) {
+        sim->stats.delayNs += ns;
+    }
+    ad2425w_sim_advance(ns);
+}
+
+sTWI *ad2425w_sim_open(const AD2425W_SIM_CONFIG *cfg)
+{
+    sTWI *twi;
+
+    if ((sim != NULL) || (cfg == NULL) || (cfg->i2cAddr & 0x1) ||
+        (cfg->numNodes > AD2425W_SIM_MAX_NODES)) {
+        return(NULL);
+    }
+
+    twi = calloc(1, sizeof(*twi));
+    if (twi == NULL) {
+        return(NULL);
+    }
+    twi->cfg = *cfg;
+    ad2425w_sim_reset(twi);
+
+    simNow = 0;
+    sim = twi;
+
+    return(twi);
+}
+
+void ad2425w_sim_close(sTWI *twi)
+{
+    if (twi == NULL) {
+        return;
+    }
+    if (sim == twi) {
+        sim = NULL;
+    }
+    free(twi);
+}
+
+void ad2425w_sim_stats(sTWI *twi, AD2425W_SIM_STATS *stats, bool reset)
+{
+    if (stats) {
+        *stats = twi->stats;
+    }
+    if (reset) {
+        memset(&twi->stats, 0, sizeof(twi->stats));
+    }
+}
+
+uint64_t ad2425w_sim_time(void)
+{
+    return(simNow);
+}
+
+uint8_t ad2425w_sim_discovered(sTWI *twi)
+{
+    return(twi->discovered);
+}
+
+uint8_t *ad2425w_sim_regs(sTWI *twi, int node)
+{
+    if (node < 0) {
+        return(twi->master);
+    }
+    if (node >= AD2425W_SIM_MAX_NODES) {
+        return(NULL);
+    }
+    return(twi->nodes[node]);
+}
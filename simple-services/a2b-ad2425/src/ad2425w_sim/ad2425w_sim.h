@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*!
+ * @brief  Host (Linux) AD2425W register simulator for use with the
+ *         a2b-ad2425 service.
+ *
+ * Simulates the TWI register interface of an AD2425W master and a
+ * chain of slave nodes so discovery and init sequences can be run and
+ * timed without hardware.  Soft reset raises the PLL lock interrupt
+ * and each DISCVRY write discovers the next node after a configurable
+ * time.  TWI transfers are timed from their length at the configured
+ * bus speed on a simulated clock which also drives the delay and time
+ * stamp functions normally supplied by the application's util.h.
+ *
+ * Build with AD2425W_SIM_HOST defined.
+ *
+ * @file       ad2425w_sim.h
+ * @version    1.0.0
+ * @copyright  2022 Analog Devices, Inc.  All rights reserved.
+ *
+*/
+
+#ifndef _ad2425w_sim_h
+#define _ad2425w_sim_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!****************************************************************
+ * @brief   Maximum number of simulated slave nodes
+ ******************************************************************/
+#define AD2425W_SIM_MAX_NODES   (8)
+
+/*!****************************************************************
+ * @brief   Subset of the twi_simple API implemented by the simulator
+ ******************************************************************/
+typedef enum TWI_SIMPLE_RESULT {
+    TWI_SIMPLE_SUCCESS,          /**< No error */
+    TWI_SIMPLE_INVALID_PORT,     /**< Invalid TWI port open */
+    TWI_SIMPLE_PORT_BUSY,        /**< TWI port is already opened */
+    TWI_SIMPLE_ERROR,            /**< Generic error (NAK) */
+    TWI_SIMPLE_BAD_LENGTH        /**< Transfer length is too long */
+} TWI_SIMPLE_RESULT;
+
+typedef struct sTWI sTWI;
+
+TWI_SIMPLE_RESULT twi_write(sTWI *twiHandle, uint8_t address,
+    uint8_t *out, uint16_t outLen);
+TWI_SIMPLE_RESULT twi_writeRead(sTWI *twiHandle, uint8_t address,
+    uint8_t *out, uint16_t outLen, uint8_t *in, uint16_t inLen);
+
+/*!****************************************************************
+ * @brief   util.h functions implemented by the simulator.  Time
+ *          stamps are in uS of simulated time.
+ ******************************************************************/
+uint32_t getTimeStamp(void);
+uint32_t elapsedTimeMs(uint32_t elapsed);
+void delay(unsigned ms);
+
+/*!****************************************************************
+ * @brief   Simulated slave node identity
+ ******************************************************************/
+typedef struct _AD2425W_SIM_NODE {
+    uint8_t vendor;
+    uint8_t product;
+    uint8_t version;
+} AD2425W_SIM_NODE;
+
+/*!****************************************************************
+ * @brief   AD2425W simulator configuration
+ ******************************************************************/
+typedef struct _AD2425W_SIM_CONFIG {
+    /** Master I2C address, the slave address is one above */
+    uint8_t i2cAddr;
+    /** Number of slave nodes on the bus */
+    uint8_t numNodes;
+    /** Slave node identities */
+    AD2425W_SIM_NODE nodes[AD2425W_SIM_MAX_NODES];
+    /** TWI bit time in ns (2500 = 400KHz) */
+    uint32_t twiBitNs;
+    /** Fixed cost of each TWI transfer in ns (start, stop, driver) */
+    uint32_t twiXferNs;
+    /** Time from soft reset to the PLL lock interrupt in ns */
+    uint32_t pllLockNs;
+    /** Time from a DISCVRY write to the discovery interrupt in ns */
+    uint32_t discoveryNs;
+    /** Sleep for the simulated time instead of only accounting for it */
+    bool realTime;
+} AD2425W_SIM_CONFIG;
+
+/*!****************************************************************
+ * @brief   AD2425W simulator statistics
+ ******************************************************************/
+typedef struct _AD2425W_SIM_STATS {
+    uint32_t writes;                /**< twi_write() transfers */
+    uint32_t writeReads;            /**< twi_writeRead() transfers */
+    uint64_t bytes;                 /**< Bytes on the bus incl. addresses */
+    uint32_t regWrites;             /**< Registers written */
+    uint32_t regReads;              /**< Registers read */
+    uint32_t naks;                  /**< Transfers not acknowledged */
+    uint64_t busNs;                 /**< Simulated TWI bus time */
+    uint64_t delayNs;               /**< Simulated time spent in delay() */
+} AD2425W_SIM_STATS;
+
+/*!****************************************************************
+ * @brief  AD2425W simulator open.
+ *
+ * Returns a TWI handle for ad2425w_initialize().  The simulated
+ * clock starts at zero.  Only one simulator can be open at a time.
+ *
+ * @param [in]   cfg    The simulated network configuration
+ *
+ * @return Returns a TWI handle or NULL on error.
+ ******************************************************************/
+sTWI *ad2425w_sim_open(const AD2425W_SIM_CONFIG *cfg);
+
+/*!****************************************************************
+ * @brief  AD2425W simulator close.
+ ******************************************************************/
+void ad2425w_sim_close(sTWI *twi);
+
+/*!****************************************************************
+ * @brief  AD2425W simulator statistics.
+ *
+ * @param [in]   twi     A simulator handle
+ * @param [out]  stats   The statistics (optional)
+ * @param [in]   reset   Clear the statistics afterwards
+ ******************************************************************/
+void ad2425w_sim_stats(sTWI *twi, AD2425W_SIM_STATS *stats, bool reset);
+
+/*!****************************************************************
+ * @brief  Returns the simulated time in ns since open
+ ******************************************************************/
+uint64_t ad2425w_sim_time(void);
+
+/*!****************************************************************
+ * @brief  Returns the number of nodes discovered since the last
+ *         soft reset
+ ******************************************************************/
+uint8_t ad2425w_sim_discovered(sTWI *twi);
+
+/*!****************************************************************
+ * @brief  Returns the simulated registers of the master (node -1)
+ *         or a slave node for inspection
+ ******************************************************************/
+uint8_t *ad2425w_sim_regs(sTWI *twi, int node);
+
+#endif
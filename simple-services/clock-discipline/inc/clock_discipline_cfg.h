@@ -0,0 +1,17 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#ifndef _clock_discipline_cfg_h
+#define _clock_discipline_cfg_h
+
+#define CLOCK_DISCIPLINE_LOOPS  (1)
+
+#endif
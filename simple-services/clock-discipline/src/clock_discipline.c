@@ -0,0 +1,418 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#include "clock_discipline.h"
+
+/*
+ * The audio and reference ISRs share state without locking.  Each
+ * record is guarded by a sequence count which is odd while the record
+ * is being written.  An ISR reading a torn record drops its event, a
+ * task reading a torn record tries again.
+ */
+typedef struct _CLOCK_DISCIPLINE_FRAMES {
+    uint32_t seq;
+    uint64_t frames;            /* Frames counted up to the last block */
+    uint32_t lastFrames;        /* Frames in the last block */
+    uint32_t lastTs;            /* Time of the last block */
+    uint32_t blockTicks;        /* Time between the last two blocks */
+    unsigned blocks;            /* Blocks seen, saturates at 2 */
+} CLOCK_DISCIPLINE_FRAMES;
+
+/*
+ * Audio positions and phases are in 1/65536 frames and times in nS,
+ * all integers relative to the update interval, so the precision does
+ * not depend on the run time or on a 64-bit double (SHARC builds
+ * default to a 32-bit double).
+ */
+#define CLOCK_DISCIPLINE_FRAC_BITS      (16)
+
+/* Limits keeping the nominal frame count of two intervals in range */
+#define CLOCK_DISCIPLINE_MAX_INTERVAL_MS    (10000)
+#define CLOCK_DISCIPLINE_MAX_SAMPLE_RATE    (384000)
+
+/*
+ * Each reference event yields the audio phase (frames ahead of the
+ * nominal rate since the first event of the update interval).  The
+ * reference ISR sums the phases and times of the events and, when the
+ * interval ends, publishes the sums along with the phase and time of
+ * the interval's first event relative to the previous interval's.
+ * The task averages each interval by dividing the sums, which averages
+ * out the ISR latency jitter of the individual events.
+ */
+typedef struct _CLOCK_DISCIPLINE_SAMPLE {
+    bool started;
+    uint64_t baseNs;            /* Reference time of the first event */
+    uint64_t basePosition;      /* Audio position at the first event */
+    uint32_t count;             /* Events accumulated */
+    int64_t phaseSum;           /* Sum of the event phases */
+    uint64_t timeSum;           /* Sum of the event times since baseNs */
+    int64_t linkPhase;          /* Phase of the first event and its time */
+    uint64_t linkNs;            /* from the last interval's, 0 = unknown */
+} CLOCK_DISCIPLINE_SAMPLE;
+
+typedef struct _CLOCK_DISCIPLINE_INTERVAL {
+    uint32_t seq;
+    uint32_t index;             /* Intervals published */
+    uint32_t count;
+    int64_t phaseSum;
+    uint64_t timeSum;
+    int64_t linkPhase;
+    uint64_t linkNs;
+} CLOCK_DISCIPLINE_INTERVAL;
+
+typedef struct _CLOCK_DISCIPLINE_LOOP {
+    CLOCK_DISCIPLINE_CFG cfg;
+    volatile CLOCK_DISCIPLINE_FRAMES frames;
+    CLOCK_DISCIPLINE_SAMPLE sample;
+    volatile CLOCK_DISCIPLINE_INTERVAL interval;
+    volatile uint32_t missed;
+    bool configured;
+
+    /* Control loop state, task context only */
+    uint32_t index;
+    bool averaged;
+    int64_t avgPhase;
+    uint64_t avgTime;
+    int64_t phase;
+    double integral;
+    double correctionPpm;
+    double errorPpm;
+    double ratio;
+    uint32_t updates;
+    bool locked;
+} CLOCK_DISCIPLINE_LOOP;
+
+static CLOCK_DISCIPLINE_LOOP clockDisciplineLoops[CLOCK_DISCIPLINE_LOOPS];
+static CLOCK_DISCIPLINE_GET_TIME getTime = NULL;
+
+static CLOCK_DISCIPLINE_LOOP *clockDisciplineLoop(int index)
+{
+    if ((index < 0) || (index >= CLOCK_DISCIPLINE_LOOPS)) {
+        return(NULL);
+    }
+    if (!clockDisciplineLoops[index].configured) {
+        return(NULL);
+    }
+    return(&clockDisciplineLoops[index]);
+}
+
+static double clockDisciplineClamp(double x, double limit)
+{
+    if (x > limit) {
+        x = limit;
+    } else if (x < -limit) {
+        x = -limit;
+    }
+    return(x);
+}
+
+/*
+ * Nominal audio frames in 'ns' in 1/65536 frames.  65536 / 1e9 is
+ * 128 / 1953125, which stays within 64 bits for two intervals.
+ */
+static int64_t clockDisciplineNominal(CLOCK_DISCIPLINE_LOOP *l, uint64_t ns)
+{
+    return((int64_t)((ns * l->cfg.sampleRate * 128ull) / 1953125ull));
+}
+
+static bool clockDisciplineApply(CLOCK_DISCIPLINE_LOOP *l, double ppm)
+{
+    double ratio;
+    bool ok;
+
+    ratio = l->cfg.ratio + (l->cfg.ratio * (ppm / 1000000.0));
+    if (l->cfg.ratioStep > 0.0) {
+        ratio = floor((ratio / l->cfg.ratioStep) + 0.5) * l->cfg.ratioStep;
+    }
+
+    /* Only touch the PLL when the quantized ratio changes */
+    if (ratio == l->ratio) {
+        return(true);
+    }
+
+    ok = true;
+    if (l->cfg.setRatio) {
+        ok = l->cfg.setRatio(l->cfg.usr, ratio);
+    }
+    if (ok) {
+        l->ratio = ratio;
+    }
+
+    return(ok);
+}
+
+void clockDisciplineInit(CLOCK_DISCIPLINE_GET_TIME _getTime)
+{
+    getTime = _getTime;
+    memset(clockDisciplineLoops, 0, sizeof(clockDisciplineLoops));
+}
+
+bool clockDisciplineConfig(int index, const CLOCK_DISCIPLINE_CFG *cfg)
+{
+    CLOCK_DISCIPLINE_LOOP *l;
+
+    if ((index < 0) || (index >= CLOCK_DISCIPLINE_LOOPS)) {
+        return(false);
+    }
+    if ((cfg == NULL) || (cfg->sampleRate == 0) ||
+        (cfg->sampleRate > CLOCK_DISCIPLINE_MAX_SAMPLE_RATE) ||
+        (cfg->ratio <= 0.0) || (cfg->intervalMs == 0) ||
+        (cfg->intervalMs > CLOCK_DISCIPLINE_MAX_INTERVAL_MS)) {
+        return(false);
+    }
+
+    l = &clockDisciplineLoops[index];
+    memset(l, 0, sizeof(*l));
+    l->cfg = *cfg;
+    l->configured = true;
+
+    /* Start from the nominal ratio */
+    l->ratio = 0.0;
+    return(clockDisciplineApply(l, 0.0));
+}
+
+void clockDisciplineReset(int index)
+{
+    CLOCK_DISCIPLINE_LOOP *l = clockDisciplineLoop(index);
+
+    if (l == NULL) {
+        return;
+    }
+
+    l->frames.seq++;
+    l->frames.frames = 0;
+    l->frames.blocks = 0;
+    l->frames.seq++;
+
+    l->sample.started = false;
+
+    l->averaged = false;
+    l->locked = false;
+}
+
+void clockDisciplineFramesTs(int index, uint32_t frames, uint32_t timeStamp)
+{
+    CLOCK_DISCIPLINE_LOOP *l = clockDisciplineLoop(index);
+    volatile CLOCK_DISCIPLINE_FRAMES *f;
+
+    if (l == NULL) {
+        return;
+    }
+
+    f = &l->frames;
+
+    f->seq++;
+    if (f->blocks > 0) {
+        f->frames += f->lastFrames;
+        f->blockTicks = timeStamp - f->lastTs;
+    }
+    if (f->blocks < 2) {
+        f->blocks++;
+    }
+    f->lastFrames = frames;
+    f->lastTs = timeStamp;
+    f->seq++;
+}
+
+void clockDisciplineFrames(int index, uint32_t frames)
+{
+    clockDisciplineFramesTs(index, frames, getTime());
+}
+
+void clockDisciplineReferenceTs(int index, uint64_t refNs,
+    uint32_t timeStamp)
+{
+    CLOCK_DISCIPLINE_LOOP *l = clockDisciplineLoop(index);
+    volatile CLOCK_DISCIPLINE_INTERVAL *interval;
+    CLOCK_DISCIPLINE_SAMPLE *sample;
+    CLOCK_DISCIPLINE_FRAMES f;
+    uint32_t seq;
+    uint32_t elapsed;
+    uint64_t position;
+    uint64_t intervalNs;
+    uint64_t ns;
+
+    if (l == NULL) {
+        return;
+    }
+
+    /* Snapshot the frame count, dropping the event if it is torn */
+    seq = l->frames.seq;
+    f = l->frames;
+    if ((seq & 1) || (seq != l->frames.seq)) {
+        l->missed++;
+        return;
+    }
+
+    /* Need a block period, and the audio must still be running */
+    elapsed = timeStamp - f.lastTs;
+    if ((f.blocks < 2) || (f.blockTicks == 0) ||
+        (elapsed > (2 * f.blockTicks))) {
+        l->missed++;
+        return;
+    }
+
+    /*
+     * The frames counted so far plus the fraction of the last block
+     * which has passed at the time of the event.
+     */
+    position = (f.frames << CLOCK_DISCIPLINE_FRAC_BITS) +
+        ((((uint64_t)f.lastFrames * elapsed) << CLOCK_DISCIPLINE_FRAC_BITS) /
+            f.blockTicks);
+
+    sample = &l->sample;
+    intervalNs = (uint64_t)l->cfg.intervalMs * 1000000ull;
+
+    /* Publish a finished interval, this event starts the next one */
+    if (sample->started) {
+        ns = refNs - sample->baseNs;
+        if (ns >= intervalNs) {
+            interval = &l->interval;
+            interval->seq++;
+            interval->index++;
+            interval->count = sample->count;
+            interval->phaseSum = sample->phaseSum;
+            interval->timeSum = sample->timeSum;
+            interval->linkPhase = sample->linkPhase;
+            interval->linkNs = sample->linkNs;
+            interval->seq++;
+
+            if (ns <= (2 * intervalNs)) {
+                sample->linkPhase = (int64_t)(position - sample->basePosition) -
+                    clockDisciplineNominal(l, ns);
+                sample->linkNs = ns;
+            } else {
+                sample->linkNs = 0;
+            }
+            sample->started = false;
+        }
+    } else {
+        sample->linkNs = 0;
+    }
+    if (!sample->started) {
+        sample->baseNs = refNs;
+        sample->basePosition = position;
+        sample->count = 0;
+        sample->phaseSum = 0;
+        sample->timeSum = 0;
+        sample->started = true;
+    }
+
+    ns = refNs - sample->baseNs;
+    sample->phaseSum += (int64_t)(position - sample->basePosition) -
+        clockDisciplineNominal(l, ns);
+    sample->timeSum += ns;
+    sample->count++;
+}
+
+void clockDisciplineReference(int index, uint64_t refNs)
+{
+    clockDisciplineReferenceTs(index, refNs, getTime());
+}
+
+bool clockDisciplineUpdate(int index)
+{
+    CLOCK_DISCIPLINE_LOOP *l = clockDisciplineLoop(index);
+    CLOCK_DISCIPLINE_INTERVAL interval;
+    uint32_t seq;
+    int64_t avgPhase;
+    uint64_t avgTime;
+    int64_t phase;
+    int64_t ns;
+    bool linked;
+    double ppm;
+    double maxIntegral;
+
+    if (l == NULL) {
+        return(false);
+    }
+
+    /* Snapshot the last finished interval */
+    do {
+        seq = l->interval.seq;
+        interval = l->interval;
+    } while ((seq & 1) || (seq != l->interval.seq));
+
+    if ((interval.index == l->index) || (interval.count == 0)) {
+        return(false);
+    }
+
+    /* Average phase and time of the events in the interval */
+    avgPhase = interval.phaseSum / (int64_t)interval.count;
+    avgTime = interval.timeSum / interval.count;
+
+    /* Only an interval following on from the last one can be compared */
+    linked = l->averaged && (interval.linkNs != 0) &&
+        (interval.index == (l->index + 1));
+    l->index = interval.index;
+
+    /* Frame rate error from the phase change since the last interval */
+    phase = interval.linkPhase + avgPhase - l->avgPhase;
+    ns = (int64_t)(interval.linkNs + avgTime - l->avgTime);
+    l->avgPhase = avgPhase;
+    l->avgTime = avgTime;
+    l->averaged = true;
+    if (!linked || (ns <= 0)) {
+        return(false);
+    }
+    l->phase += phase;
+    l->errorPpm = ((double)phase * (1e15 / 65536.0)) /
+        ((double)ns * (double)l->cfg.sampleRate);
+
+    /* PI loop, the integral is limited to the correction range */
+    l->integral += l->errorPpm;
+    if (l->cfg.ki > 0.0) {
+        maxIntegral = l->cfg.maxPpm / l->cfg.ki;
+        l->integral = clockDisciplineClamp(l->integral, maxIntegral);
+    }
+    ppm = -((l->cfg.kp * l->errorPpm) + (l->cfg.ki * l->integral));
+
+    /* Steer in limited steps within the correction range */
+    if (l->cfg.maxStepPpm > 0.0) {
+        ppm = l->correctionPpm +
+            clockDisciplineClamp(ppm - l->correctionPpm, l->cfg.maxStepPpm);
+    }
+    ppm = clockDisciplineClamp(ppm, l->cfg.maxPpm);
+
+    if (clockDisciplineApply(l, ppm)) {
+        l->correctionPpm = ppm;
+    }
+
+    l->locked = (fabs(l->errorPpm) < l->cfg.lockPpm);
+    l->updates++;
+
+    return(true);
+}
+
+bool clockDisciplineGetStatus(int index, CLOCK_DISCIPLINE_STATUS *status)
+{
+    CLOCK_DISCIPLINE_LOOP *l = clockDisciplineLoop(index);
+
+    if ((l == NULL) || (status == NULL)) {
+        return(false);
+    }
+
+    status->ratio = l->ratio;
+    status->errorPpm = l->errorPpm;
+    status->correctionPpm = l->correctionPpm;
+    status->phaseFrames = (double)l->phase / 65536.0;
+    status->updates = l->updates;
+    status->missed = l->missed;
+    status->locked = l->locked;
+
+    return(true);
+}
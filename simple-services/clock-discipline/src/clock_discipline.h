@@ -0,0 +1,204 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*!
+ * @brief  Audio clock discipline
+ *
+ * This module measures the audio frame rate against an external
+ * timing reference (PTP, USB SOF, etc.) and steers the audio PLL
+ * (normally a CS2100) with a PI loop so the audio clocks lock to
+ * the reference.
+ *
+ * @file      clock_discipline.h
+ * @version   1.0.0
+ * @copyright 2022 Analog Devices, Inc.  All rights reserved.
+ *
+*/
+
+#ifndef _clock_discipline_h
+#define _clock_discipline_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "clock_discipline_cfg.h"
+
+/*!****************************************************************
+ * @brief  Number of independent clock discipline loops
+ ******************************************************************/
+#ifndef CLOCK_DISCIPLINE_LOOPS
+#define CLOCK_DISCIPLINE_LOOPS  (1)
+#endif
+
+/*!****************************************************************
+ * @brief  Function called to track time
+ *
+ * The application must pass in a function which returns a
+ * monotonically increasing high-resolution time (normally
+ * cpuLoadGetTimeStamp()).  It is only used to place reference
+ * events between audio blocks so its own accuracy is not critical,
+ * but it must run much faster than the block rate.  It is OK if the
+ * timer rolls over zero.
+ *
+ * This function will be called from the audio and reference ISRs.
+ ******************************************************************/
+typedef uint32_t (*CLOCK_DISCIPLINE_GET_TIME)(void);
+
+/*!****************************************************************
+ * @brief  Function called to apply a new PLL ratio
+ *
+ * Normally calls cs2100_set_ratio().  Called from
+ * clockDisciplineUpdate().
+ *
+ * @return  true if successful, false otherwise
+ ******************************************************************/
+typedef bool (*CLOCK_DISCIPLINE_SET_RATIO)(void *usr, double ratio);
+
+/*!****************************************************************
+ * @brief  Clock discipline loop configuration
+ ******************************************************************/
+typedef struct _CLOCK_DISCIPLINE_CFG {
+    uint32_t sampleRate;        /**< Nominal audio frame rate in Hz */
+    double ratio;               /**< Nominal PLL ratio */
+    double ratioStep;           /**< PLL ratio resolution (0 = none) */
+    uint32_t intervalMs;        /**< Loop update interval (reference time) */
+    double kp;                  /**< Proportional gain (ppm per ppm) */
+    double ki;                  /**< Integral gain (ppm per ppm*interval) */
+    double maxStepPpm;          /**< Max correction change per update */
+    double maxPpm;              /**< Max total correction */
+    double lockPpm;             /**< Locked while |error| is below this */
+    CLOCK_DISCIPLINE_SET_RATIO setRatio;    /**< Apply a ratio */
+    void *usr;                  /**< User pointer passed to setRatio */
+} CLOCK_DISCIPLINE_CFG;
+
+/*!****************************************************************
+ * @brief  Clock discipline loop status
+ ******************************************************************/
+typedef struct _CLOCK_DISCIPLINE_STATUS {
+    double ratio;               /**< Current PLL ratio */
+    double errorPpm;            /**< Last measured frame rate error */
+    double correctionPpm;       /**< Current correction */
+    double phaseFrames;         /**< Accumulated frame offset */
+    uint32_t updates;           /**< Loop updates since reset */
+    uint32_t missed;            /**< Reference events not measured */
+    bool locked;                /**< Error within lockPpm */
+} CLOCK_DISCIPLINE_STATUS;
+
+/*!****************************************************************
+ * @brief  Initializes the clock discipline module
+ *
+ * This function is not thread safe.
+ *
+ * @param [in]  getTime  Pointer to a function to call to get the
+ *                       current time.
+ ******************************************************************/
+void clockDisciplineInit(CLOCK_DISCIPLINE_GET_TIME getTime);
+
+/*!****************************************************************
+ * @brief  Configures a clock discipline loop
+ *
+ * Resets the loop and applies the nominal ratio.  Call again when
+ * the sample rate changes.
+ *
+ * This function is not thread safe.
+ *
+ * @param [in]  index   Loop index
+ * @param [in]  cfg     Loop configuration
+ *
+ * @return  true if successful, false otherwise
+ ******************************************************************/
+bool clockDisciplineConfig(int index, const CLOCK_DISCIPLINE_CFG *cfg);
+
+/*!****************************************************************
+ * @brief  Restarts the measurement
+ *
+ * Call when the audio or the reference restarts.  The current
+ * correction is kept.
+ *
+ * This function is not thread safe.
+ *
+ * @param [in]  index   Loop index
+ ******************************************************************/
+void clockDisciplineReset(int index);
+
+/*!****************************************************************
+ * @brief  Count audio frames
+ *
+ * Call from the audio (SPORT) callback, as early as possible, with
+ * the number of frames in the block.
+ *
+ * @param [in]  index   Loop index
+ * @param [in]  frames  Frames in the block
+ ******************************************************************/
+void clockDisciplineFrames(int index, uint32_t frames);
+
+/*!****************************************************************
+ * @brief  Count audio frames with a given time
+ *
+ * Same as clockDisciplineFrames() but with an explicit timestamp in
+ * getTime units.  Useful for off-target testing.
+ *
+ * @param [in]  index      Loop index
+ * @param [in]  frames     Frames in the block
+ * @param [in]  timeStamp  Block time
+ ******************************************************************/
+void clockDisciplineFramesTs(int index, uint32_t frames, uint32_t timeStamp);
+
+/*!****************************************************************
+ * @brief  Record a reference timing event
+ *
+ * Call from the reference event ISR (PTP timestamp, USB SOF, etc.)
+ * with the reference time of the event.  The audio frame position at
+ * the event is interpolated from the last audio blocks.  Events need
+ * not be regular.
+ *
+ * @param [in]  index   Loop index
+ * @param [in]  refNs   Reference time in nS
+ ******************************************************************/
+void clockDisciplineReference(int index, uint64_t refNs);
+
+/*!****************************************************************
+ * @brief  Record a reference timing event with a given time
+ *
+ * Same as clockDisciplineReference() but with an explicit timestamp
+ * in getTime units.  Useful for off-target testing.
+ *
+ * @param [in]  index      Loop index
+ * @param [in]  refNs      Reference time in nS
+ * @param [in]  timeStamp  Event time
+ ******************************************************************/
+void clockDisciplineReferenceTs(int index, uint64_t refNs,
+    uint32_t timeStamp);
+
+/*!****************************************************************
+ * @brief  Run the control loop
+ *
+ * Measures the frame rate error once per update interval of
+ * reference time and steers the PLL ratio.  Call regularly from a
+ * task, not an ISR, since setRatio is normally a TWI transfer.
+ *
+ * @param [in]  index   Loop index
+ *
+ * @return  true if the loop updated, false otherwise
+ ******************************************************************/
+bool clockDisciplineUpdate(int index);
+
+/*!****************************************************************
+ * @brief  Return the loop status
+ *
+ * @param [in]   index   Loop index
+ * @param [out]  status  Loop status
+ *
+ * @return  true if successful, false otherwise
+ ******************************************************************/
+bool clockDisciplineGetStatus(int index, CLOCK_DISCIPLINE_STATUS *status);
+
+#endif
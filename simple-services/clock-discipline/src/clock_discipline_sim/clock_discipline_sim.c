@@ -0,0 +1,243 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host closed loop simulation of the clock discipline service.
+ *
+ * An audio clock running a given ppm off nominal delivers 32 frame
+ * blocks at 48kHz through clockDisciplineFramesTs() and a 1mS
+ * reference (USB SOF style) reports through clockDisciplineReferenceTs().
+ * The setRatio callback steers the simulated audio clock.  Both ISRs
+ * see uniformly distributed latency jitter and the local timer, a
+ * 100MHz 32-bit counter which rolls over every 43 seconds, runs
+ * 'timer ppm' off true time.
+ *
+ * Each scenario must report locked within the lock time limit and
+ * finish locked with the correction within lockPpm of the one which
+ * cancels the clock offset.  The lock time, final error and
+ * correction and the updates spent unlocked after the first lock are
+ * printed.  It exits with 2 on a failure.
+ *
+ * Build from the 'clock-discipline' directory with:
+ *   gcc -O2 -Iinc -Isrc -o clock_discipline_sim \
+ *       src/clock_discipline_sim/clock_discipline_sim.c \
+ *       src/clock_discipline.c -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "clock_discipline.h"
+
+#define SIM_SAMPLE_RATE     (48000)
+#define SIM_BLOCK_FRAMES    (32)
+#define SIM_RATIO           (256.0)
+#define SIM_REF_NS          (1000000)
+#define SIM_TIMER_NS        (10.0L)
+
+typedef struct {
+    double offsetPpm;
+    uint32_t jitterNs;
+} SIM_SCENARIO;
+
+typedef struct {
+    double lockS;
+    double errorPpm;
+    double correctionPpm;
+    uint32_t updates;
+    uint32_t unlocked;
+    uint32_t missed;
+    bool locked;
+} SIM_RESULT;
+
+static const SIM_SCENARIO scenarios[] = {
+    {    0.0,     0 },
+    {   80.0,     0 },
+    {   80.0,  5000 },
+    {  -80.0,  5000 },
+    {  200.0, 20000 },
+    { -200.0, 20000 },
+    {  450.0,  5000 },
+    { -450.0, 50000 },
+};
+
+static CLOCK_DISCIPLINE_CFG cfg = {
+    .sampleRate = SIM_SAMPLE_RATE,
+    .ratio = SIM_RATIO,
+    .ratioStep = 1.0 / 1048576.0,
+    .intervalMs = 1000,
+    .kp = 0.5,
+    .ki = 0.2,
+    .maxStepPpm = 20.0,
+    .maxPpm = 500.0,
+    .lockPpm = 1.0,
+};
+
+static double simRatio;
+static uint32_t simRand = 1;
+
+static bool sim_set_ratio(void *usr, double ratio)
+{
+    simRatio = ratio;
+    return(true);
+}
+
+/* The simulation passes its own timestamps */
+static uint32_t sim_get_time(void)
+{
+    return(0);
+}
+
+static uint32_t sim_rand(void)
+{
+    simRand ^= simRand << 13;
+    simRand ^= simRand >> 17;
+    simRand ^= simRand << 5;
+    return(simRand);
+}
+
+/* Local timer reading at true time 't' nS plus ISR latency */
+static uint32_t sim_timestamp(long double t, uint32_t jitterNs,
+    double timerPpm)
+{
+    if (jitterNs) {
+        t += sim_rand() % jitterNs;
+    }
+    t *= 1.0L + timerPpm / 1000000.0L;
+    return((uint32_t)(uint64_t)(t / SIM_TIMER_NS));
+}
+
+static void sim_run(const SIM_SCENARIO *s, uint32_t seconds,
+    double timerPpm, SIM_RESULT *r)
+{
+    CLOCK_DISCIPLINE_STATUS status;
+    long double t, nextBlock, nextRef, end, rate;
+    uint64_t refNs;
+    bool wasLocked;
+
+    memset(r, 0, sizeof(*r));
+    r->lockS = -1.0;
+
+    clockDisciplineConfig(0, &cfg);
+
+    t = 0.0L;
+    nextBlock = 0.0L;
+    nextRef = SIM_REF_NS;
+    refNs = 0;
+    end = (long double)seconds * 1e9L;
+    wasLocked = false;
+
+    while (t < end) {
+        if (nextBlock <= nextRef) {
+            t = nextBlock;
+            clockDisciplineFramesTs(0, SIM_BLOCK_FRAMES,
+                sim_timestamp(t, s->jitterNs, timerPpm));
+            rate = SIM_SAMPLE_RATE * (1.0L + s->offsetPpm / 1000000.0L) *
+                (simRatio / SIM_RATIO);
+            nextBlock += SIM_BLOCK_FRAMES * 1e9L / rate;
+        } else {
+            t = nextRef;
+            refNs += SIM_REF_NS;
+            clockDisciplineReferenceTs(0, refNs,
+                sim_timestamp(t, s->jitterNs, timerPpm));
+            nextRef += SIM_REF_NS;
+            if (clockDisciplineUpdate(0)) {
+                clockDisciplineGetStatus(0, &status);
+                if (status.locked && !wasLocked) {
+                    r->lockS = (double)(t / 1e9L);
+                    wasLocked = true;
+                } else if (!status.locked && wasLocked) {
+                    r->unlocked++;
+                }
+            }
+        }
+    }
+
+    clockDisciplineGetStatus(0, &status);
+    r->errorPpm = status.errorPpm;
+    r->correctionPpm = status.correctionPpm;
+    r->updates = status.updates;
+    r->missed = status.missed;
+    r->locked = status.locked;
+}
+
+static void usage(void)
+{
+    printf("clock_discipline_sim [options]\n");
+    printf("  -s <seconds>   Simulated time per scenario (600)\n");
+    printf("  -l <seconds>   Lock time limit (120)\n");
+    printf("  -t <ppm>       Local timer offset (50)\n");
+    printf("  -o <ppm>       Run one scenario with this clock offset\n");
+    printf("  -j <nS>        ISR jitter of the -o scenario (5000)\n");
+    printf("  -r <seed>      Random seed (1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    SIM_SCENARIO one = { 0.0, 5000 };
+    const SIM_SCENARIO *s;
+    uint32_t seconds = 600;
+    uint32_t lockLimit = 120;
+    double timerPpm = 50.0;
+    bool single = false;
+    double expectPpm;
+    SIM_RESULT r;
+    int count, i;
+    int fails = 0;
+    bool ok;
+    int c;
+
+    while ((c = getopt(argc, argv, "s:l:t:o:j:r:h")) != -1) {
+        switch (c) {
+            case 's': seconds = strtoul(optarg, NULL, 0); break;
+            case 'l': lockLimit = strtoul(optarg, NULL, 0); break;
+            case 't': timerPpm = atof(optarg); break;
+            case 'o': one.offsetPpm = atof(optarg); single = true; break;
+            case 'j': one.jitterNs = strtoul(optarg, NULL, 0); break;
+            case 'r': simRand = strtoul(optarg, NULL, 0); break;
+            default: usage(); return(1);
+        }
+    }
+    if ((seconds <= lockLimit) || (simRand == 0)) {
+        usage();
+        return(1);
+    }
+
+    cfg.setRatio = sim_set_ratio;
+    clockDisciplineInit(sim_get_time);
+
+    printf("%uHz, %u frame blocks, 1mS reference, timer %+.0f ppm, "
+        "%u seconds, lock limit %u seconds\n\n", SIM_SAMPLE_RATE,
+        SIM_BLOCK_FRAMES, timerPpm, seconds, lockLimit);
+    printf("%9s %9s %8s %10s %12s %12s %9s %7s\n", "offset", "jitter",
+        "lock s", "error", "correction", "expected", "unlocked", "missed");
+
+    s = single ? &one : scenarios;
+    count = single ? 1 : sizeof(scenarios) / sizeof(scenarios[0]);
+    for (i = 0; i < count; i++, s++) {
+        sim_run(s, seconds, timerPpm, &r);
+        expectPpm = -s->offsetPpm / (1.0 + s->offsetPpm / 1000000.0);
+        ok = r.locked && (r.lockS >= 0.0) && (r.lockS <= lockLimit) &&
+            (fabs(r.correctionPpm - expectPpm) < cfg.lockPpm);
+        printf("%+9.1f %7unS %8.0f %+10.4f %+12.4f %+12.4f %9u %7u  %s\n",
+            s->offsetPpm, s->jitterNs, r.lockS, r.errorPpm,
+            r.correctionPpm, expectPpm, r.unlocked, r.missed,
+            ok ? "ok" : "FAIL");
+        fails += !ok;
+    }
+
+    return(fails ? 2 : 0);
+}
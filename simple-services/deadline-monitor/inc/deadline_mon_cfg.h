@@ -0,0 +1,19 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#ifndef _deadline_mon_cfg_h
+#define _deadline_mon_cfg_h
+
+#define DEADLINE_MON_STREAMS        (4)
+#define DEADLINE_MON_HIST_BIN_PCT   (10)
+#define DEADLINE_MON_HISTORY        (16)
+
+#endif
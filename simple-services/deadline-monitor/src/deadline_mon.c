@@ -0,0 +1,291 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "deadline_mon.h"
+
+/* Minimal ARM and SHARC global interrupt disable/enable. */
+#if defined (__ADSPARM__)
+    #define DEADLINE_MON_ENTER_CRITICAL()  __builtin_disable_interrupts()
+    #define DEADLINE_MON_EXIT_CRITICAL()   __builtin_enable_interrupts()
+#elif defined(__ADSP21000__)
+    #include "interrupt.h"
+    #define DEADLINE_MON_ENTER_CRITICAL()  adi_rtl_disable_interrupts()
+    #define DEADLINE_MON_EXIT_CRITICAL()   adi_rtl_reenable_interrupts()
+#else
+    #define DEADLINE_MON_ENTER_CRITICAL()
+    #define DEADLINE_MON_EXIT_CRITICAL()
+#endif
+
+#if ((100 % DEADLINE_MON_HIST_BIN_PCT) != 0)
+#error "DEADLINE_MON_HIST_BIN_PCT must evenly divide 100"
+#endif
+
+typedef struct _DEADLINE_MON_STREAM {
+    DEADLINE_MON_STATS stats;
+    uint32_t startTime;
+    bool started;
+} DEADLINE_MON_STREAM;
+
+static DEADLINE_MON_STREAM deadlineMonStreams[DEADLINE_MON_STREAMS];
+static DEADLINE_MON_EVENT deadlineMonEvents[DEADLINE_MON_HISTORY];
+static unsigned eventIdx = 0;
+static unsigned eventCount = 0;
+static DEADLINE_MON_GET_TIME getTime = NULL;
+static uint32_t ticksPerSecond = 0;
+
+/*
+ * Stamps from ISRs of different priorities share the history so each
+ * event is recorded with interrupts disabled.
+ */
+static void deadlineMonEvent(int stream, DEADLINE_MON_EVENT_TYPE type,
+    uint32_t timeStamp)
+{
+    DEADLINE_MON_EVENT *e;
+
+    DEADLINE_MON_ENTER_CRITICAL();
+
+    e = &deadlineMonEvents[eventIdx];
+    e->timeStamp = timeStamp;
+    e->stream = (uint8_t)stream;
+    e->type = (uint8_t)type;
+
+    eventIdx++;
+    if (eventIdx == DEADLINE_MON_HISTORY) {
+        eventIdx = 0;
+    }
+    if (eventCount < DEADLINE_MON_HISTORY) {
+        eventCount++;
+    }
+
+    DEADLINE_MON_EXIT_CRITICAL();
+}
+
+static void deadlineMonSaveTrace(DEADLINE_MON_STATS *s)
+{
+    unsigned idx;
+    unsigned i;
+
+    /* Copy the event history, oldest first */
+    DEADLINE_MON_ENTER_CRITICAL();
+    idx = (eventIdx + DEADLINE_MON_HISTORY - eventCount) % DEADLINE_MON_HISTORY;
+    for (i = 0; i < eventCount; i++) {
+        s->trace[i] = deadlineMonEvents[idx];
+        idx++;
+        if (idx == DEADLINE_MON_HISTORY) {
+            idx = 0;
+        }
+    }
+    s->traceLen = eventCount;
+    DEADLINE_MON_EXIT_CRITICAL();
+}
+
+static void deadlineMonClear(DEADLINE_MON_STATS *s)
+{
+    s->blocks = 0;
+    s->misses = 0;
+    s->lastTicks = 0;
+    s->maxTicks = 0;
+    s->traceLen = 0;
+    memset(s->hist, 0, sizeof(s->hist));
+}
+
+static uint32_t deadlineMonTicksToUs(uint32_t ticks)
+{
+    uint32_t uS = 0;
+
+    if (ticksPerSecond) {
+        uS = (uint32_t)((1000000ULL * (uint64_t)ticks) / ticksPerSecond);
+    }
+
+    return(uS);
+}
+
+void deadlineMonInit(DEADLINE_MON_GET_TIME _getTime, uint32_t _ticksPerSecond)
+{
+    getTime = _getTime;
+    ticksPerSecond = _ticksPerSecond;
+    eventIdx = 0;
+    eventCount = 0;
+    memset(deadlineMonStreams, 0, sizeof(deadlineMonStreams));
+}
+
+bool deadlineMonConfig(int stream, const char *name,
+    uint32_t frames, uint32_t sampleRate)
+{
+    DEADLINE_MON_STREAM *d;
+
+    if ((stream < 0) || (stream >= DEADLINE_MON_STREAMS) ||
+        (sampleRate == 0)) {
+        return(false);
+    }
+
+    d = &deadlineMonStreams[stream];
+
+    d->started = false;
+    d->stats.periodTicks = (uint32_t)
+        (((uint64_t)ticksPerSecond * frames) / sampleRate);
+    strncpy(d->stats.name, name ? name : "", DEADLINE_MON_NAME_LEN - 1);
+    d->stats.name[DEADLINE_MON_NAME_LEN - 1] = '\0';
+    deadlineMonClear(&d->stats);
+
+    return(d->stats.periodTicks > 0);
+}
+
+void deadlineMonStartTs(int stream, uint32_t timeStamp)
+{
+    DEADLINE_MON_STREAM *d;
+
+    if ((stream < 0) || (stream >= DEADLINE_MON_STREAMS)) {
+        return;
+    }
+
+    d = &deadlineMonStreams[stream];
+    d->startTime = timeStamp;
+    d->started = true;
+
+    deadlineMonEvent(stream, DEADLINE_MON_EVENT_START, timeStamp);
+}
+
+void deadlineMonEndTs(int stream, uint32_t timeStamp)
+{
+    DEADLINE_MON_STREAM *d;
+    DEADLINE_MON_STATS *s;
+    uint32_t ticks;
+    uint32_t pct;
+    unsigned bin;
+
+    if ((stream < 0) || (stream >= DEADLINE_MON_STREAMS)) {
+        return;
+    }
+
+    d = &deadlineMonStreams[stream];
+    s = &d->stats;
+
+    deadlineMonEvent(stream, DEADLINE_MON_EVENT_END, timeStamp);
+
+    /* Ignore unmatched or unconfigured blocks */
+    if (!d->started || (s->periodTicks == 0)) {
+        return;
+    }
+    d->started = false;
+
+    /* Processing time as a percentage of the block period */
+    ticks = timeStamp - d->startTime;
+    pct = (uint32_t)((100ULL * ticks) / s->periodTicks);
+
+    if (pct >= 100) {
+        bin = DEADLINE_MON_HIST_BINS - 1;
+        s->misses++;
+    } else {
+        bin = pct / DEADLINE_MON_HIST_BIN_PCT;
+    }
+    s->hist[bin]++;
+    s->blocks++;
+    s->lastTicks = ticks;
+
+    /* Capture the events leading up to a new worst case */
+    if (ticks > s->maxTicks) {
+        s->maxTicks = ticks;
+        deadlineMonSaveTrace(s);
+    }
+}
+
+void deadlineMonStart(int stream)
+{
+    deadlineMonStartTs(stream, getTime());
+}
+
+void deadlineMonEnd(int stream)
+{
+    deadlineMonEndTs(stream, getTime());
+}
+
+bool deadlineMonGetStats(int stream, DEADLINE_MON_STATS *stats, bool clear)
+{
+    DEADLINE_MON_STATS *s;
+
+    if ((stream < 0) || (stream >= DEADLINE_MON_STREAMS)) {
+        return(false);
+    }
+
+    s = &deadlineMonStreams[stream].stats;
+
+    if (stats) {
+        memcpy(stats, s, sizeof(*stats));
+    }
+    if (clear) {
+        deadlineMonClear(s);
+    }
+
+    return(true);
+}
+
+void deadlineMonReport(DEADLINE_MON_PRINT print, void *usr, bool trace)
+{
+    DEADLINE_MON_STATS s;
+    char line[128];
+    uint32_t maxPct;
+    unsigned stream;
+    unsigned len;
+    unsigned i;
+
+    if (print == NULL) {
+        return;
+    }
+
+    for (stream = 0; stream < DEADLINE_MON_STREAMS; stream++) {
+
+        deadlineMonGetStats(stream, &s, false);
+        if (s.periodTicks == 0) {
+            continue;
+        }
+
+        maxPct = (uint32_t)((100ULL * s.maxTicks) / s.periodTicks);
+        snprintf(line, sizeof(line),
+            "%s: period %luuS, blocks %lu, misses %lu, worst %luuS (%lu%%)\n",
+            s.name,
+            (unsigned long)deadlineMonTicksToUs(s.periodTicks),
+            (unsigned long)s.blocks, (unsigned long)s.misses,
+            (unsigned long)deadlineMonTicksToUs(s.maxTicks),
+            (unsigned long)maxPct);
+        print(usr, line);
+
+        /* Histogram, one column per bin */
+        len = snprintf(line, sizeof(line), "  hist:");
+        for (i = 0; (i < DEADLINE_MON_HIST_BINS) &&
+                    (len < sizeof(line) - 12); i++) {
+            len += snprintf(line + len, sizeof(line) - len, " %lu",
+                (unsigned long)s.hist[i]);
+        }
+        snprintf(line + len, sizeof(line) - len, "\n");
+        print(usr, line);
+
+        if (!trace) {
+            continue;
+        }
+
+        /* Worst-case trace relative to the first event */
+        for (i = 0; i < s.traceLen; i++) {
+            snprintf(line, sizeof(line), "  %10luuS %-16s %s\n",
+                (unsigned long)deadlineMonTicksToUs(
+                    s.trace[i].timeStamp - s.trace[0].timeStamp),
+                deadlineMonStreams[s.trace[i].stream].stats.name,
+                s.trace[i].type == DEADLINE_MON_EVENT_START ? "start" : "end");
+            print(usr, line);
+        }
+    }
+}
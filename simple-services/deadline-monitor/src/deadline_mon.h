@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*!
+ * @brief  Audio block deadline monitor
+ *
+ * This module tracks how close each audio block callback comes to
+ * its deadline (the block period) and records the events leading
+ * up to the worst case.
+ *
+ * @file      deadline_mon.h
+ * @version   1.0.0
+ * @copyright 2023 Analog Devices, Inc.  All rights reserved.
+ *
+*/
+
+#ifndef _deadline_mon_h
+#define _deadline_mon_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "deadline_mon_cfg.h"
+
+/*!****************************************************************
+ * @brief  Number of audio streams which can be monitored
+ ******************************************************************/
+#ifndef DEADLINE_MON_STREAMS
+#define DEADLINE_MON_STREAMS        (4)
+#endif
+
+/*!****************************************************************
+ * @brief  Width of each histogram bin in percent of block period
+ *
+ * Must evenly divide 100.  One additional bin collects all blocks
+ * which exceeded the block period.
+ ******************************************************************/
+#ifndef DEADLINE_MON_HIST_BIN_PCT
+#define DEADLINE_MON_HIST_BIN_PCT   (10)
+#endif
+
+/*!****************************************************************
+ * @brief  Number of events saved with each worst-case trace
+ ******************************************************************/
+#ifndef DEADLINE_MON_HISTORY
+#define DEADLINE_MON_HISTORY        (16)
+#endif
+
+/*!****************************************************************
+ * @brief  Maximum length of a stream name including the
+ *         terminating NULL.
+ ******************************************************************/
+#ifndef DEADLINE_MON_NAME_LEN
+#define DEADLINE_MON_NAME_LEN       (16)
+#endif
+
+/*!****************************************************************
+ * @brief  Total number of histogram bins
+ ******************************************************************/
+#define DEADLINE_MON_HIST_BINS \
+    ((100 / DEADLINE_MON_HIST_BIN_PCT) + 1)
+
+/*!****************************************************************
+ * @brief  Function called to track time
+ *
+ * The application must pass in a function which returns a
+ * monotonically increasing high-resolution time.  Normally this
+ * is cpuLoadGetTimeStamp() so all timing shares the CPU load
+ * time base.
+ *
+ * This function will be called from the audio callback context.
+ ******************************************************************/
+typedef uint32_t (*DEADLINE_MON_GET_TIME)(void);
+
+/*!****************************************************************
+ * @brief  Function called to output one line of a report
+ *
+ * The line is NULL terminated and ends with a newline.
+ ******************************************************************/
+typedef void (*DEADLINE_MON_PRINT)(void *usr, const char *line);
+
+/*!****************************************************************
+ * @brief  Trace event types
+ ******************************************************************/
+typedef enum _DEADLINE_MON_EVENT_TYPE {
+    DEADLINE_MON_EVENT_START = 0,   /**< Block processing started */
+    DEADLINE_MON_EVENT_END          /**< Block processing ended */
+} DEADLINE_MON_EVENT_TYPE;
+
+/*!****************************************************************
+ * @brief  Trace event
+ ******************************************************************/
+typedef struct _DEADLINE_MON_EVENT {
+    uint32_t timeStamp;             /**< Event time */
+    uint8_t stream;                 /**< Stream index */
+    uint8_t type;                   /**< DEADLINE_MON_EVENT_TYPE */
+} DEADLINE_MON_EVENT;
+
+/*!****************************************************************
+ * @brief  Per-stream deadline statistics
+ ******************************************************************/
+typedef struct _DEADLINE_MON_STATS {
+    char name[DEADLINE_MON_NAME_LEN];           /**< Stream name */
+    uint32_t periodTicks;                       /**< Block period */
+    uint32_t blocks;                            /**< Blocks processed */
+    uint32_t misses;                            /**< Blocks over period */
+    uint32_t lastTicks;                         /**< Last processing time */
+    uint32_t maxTicks;                          /**< Worst processing time */
+    uint32_t hist[DEADLINE_MON_HIST_BINS];      /**< Processing time histogram */
+    unsigned traceLen;                          /**< Valid events in 'trace' */
+    DEADLINE_MON_EVENT trace[DEADLINE_MON_HISTORY]; /**< Events up to the
+                                                     worst case, oldest first */
+} DEADLINE_MON_STATS;
+
+/*!****************************************************************
+ * @brief  Initializes the deadline monitor
+ *
+ * This function is not thread safe.
+ *
+ * @param [in]  getTime         Pointer to a function to call to get
+ *                              the current time.
+ * @param [in]  ticksPerSecond  Number of clock ticks per second as
+ *                              returned by getTime.
+ ******************************************************************/
+void deadlineMonInit(DEADLINE_MON_GET_TIME getTime, uint32_t ticksPerSecond);
+
+/*!****************************************************************
+ * @brief  Configures a stream to monitor
+ *
+ * Sets the stream's deadline to the period of one block and clears
+ * all statistics for the stream.  Call again whenever the block
+ * size or sample rate changes.
+ *
+ * @param [in]  stream      Stream index
+ * @param [in]  name        Stream name for reports
+ * @param [in]  frames      Frames per block
+ * @param [in]  sampleRate  Stream sample rate in Hz
+ *
+ * @return  true if successful, false otherwise
+ ******************************************************************/
+bool deadlineMonConfig(int stream, const char *name,
+    uint32_t frames, uint32_t sampleRate);
+
+/*!****************************************************************
+ * @brief  Stamp the start of block processing
+ *
+ * @param [in]  stream      Stream index
+ ******************************************************************/
+void deadlineMonStart(int stream);
+
+/*!****************************************************************
+ * @brief  Stamp the end of block processing
+ *
+ * @param [in]  stream      Stream index
+ ******************************************************************/
+void deadlineMonEnd(int stream);
+
+/*!****************************************************************
+ * @brief  Stamp the start of block processing with a given time
+ *
+ * Same as deadlineMonStart() but with an explicit timestamp in
+ * getTime units.  Useful when the caller already has a timestamp
+ * or for off-target testing.
+ *
+ * @param [in]  stream      Stream index
+ * @param [in]  timeStamp   Start time
+ ******************************************************************/
+void deadlineMonStartTs(int stream, uint32_t timeStamp);
+
+/*!****************************************************************
+ * @brief  Stamp the end of block processing with a given time
+ *
+ * @param [in]  stream      Stream index
+ * @param [in]  timeStamp   End time
+ ******************************************************************/
+void deadlineMonEndTs(int stream, uint32_t timeStamp);
+
+/*!****************************************************************
+ * @brief  Return a snapshot of a stream's statistics
+ *
+ * @param [in]   stream  Stream index
+ * @param [out]  stats   Statistics for the stream
+ * @param [in]   clear   Clear the stream's statistics after copying
+ *
+ * @return  true if successful, false otherwise
+ ******************************************************************/
+bool deadlineMonGetStats(int stream, DEADLINE_MON_STATS *stats, bool clear);
+
+/*!****************************************************************
+ * @brief  Report all configured streams
+ *
+ * Formats a report one line at a time and passes each line to
+ * 'print'.  Suitable for the shell or syslog_print().
+ *
+ * @param [in]  print  Line output function
+ * @param [in]  usr    User pointer passed to 'print'
+ * @param [in]  trace  Include the worst-case trace
+ ******************************************************************/
+void deadlineMonReport(DEADLINE_MON_PRINT print, void *usr, bool trace);
+
+#endif
@@ -19,5 +19,7 @@
 
 //#define FS_DEVMAN_ENABLE_ROMFS
 //#define FS_DEVMAN_ENABLE_FATFS
+//#define FS_DEVMAN_ENABLE_SPIFFS
+//#define FS_DEVMAN_ENABLE_RAMFS
 
 #endif
@@ -26,13 +26,37 @@
 #define FS_DEVIO_MAX_FATFS_FD    16
 #endif
 
+/* Number of pending streaming open requests */
+#ifndef FS_DEV_FATFS_MAX_STREAMS
+#define FS_DEV_FATFS_MAX_STREAMS  4
+#endif
+
+/* Initial cluster link map size in DWORDs (grown as needed at open) */
+#ifndef FS_DEV_FATFS_CLMT_SIZE
+#define FS_DEV_FATFS_CLMT_SIZE    32
+#endif
+
 typedef struct _FSIO_FATFS_FD {
     FIL f;
     bool open;
+#if FF_USE_FASTSEEK
+    DWORD *clmt;
+    FSIZE_t end;
+    bool prealloc;
+#endif
 } FSIO_FATFS_FD;
 
 static FSIO_FATFS_FD fatfsFd[FS_DEVIO_MAX_FATFS_FD];
 
+#if FF_USE_FASTSEEK
+typedef struct _FSIO_FATFS_STREAM {
+    char *path;
+    FSIZE_t prealloc;
+} FSIO_FATFS_STREAM;
+
+static FSIO_FATFS_STREAM fatfsStream[FS_DEV_FATFS_MAX_STREAMS];
+#endif
+
 static char *fullPath(const char *path, void *pdata)
 {
     FS_DEVMAN_DEVICE_INFO *devInfo = (FS_DEVMAN_DEVICE_INFO *)pdata;
@@ -48,6 +72,112 @@ static char *fullPath(const char *path, void *pdata)
     return(p);
 }
 
+#if FF_USE_FASTSEEK
+/***********************************************************************
+ * Streaming mode
+ *
+ * A file opened in streaming mode caches its cluster link map (CLMT) so
+ * seeks and transfers never walk the FAT chain.  Files created for
+ * writing can be preallocated as a single contiguous run with f_expand().
+ * All transfers go through f_read() / f_write() under the volume lock;
+ * FatFs sends the whole sectors of a transfer straight to the disk.
+ ***********************************************************************/
+static bool fatfsStreamClaim(const char *path, FSIZE_t *prealloc)
+{
+    FSIO_FATFS_STREAM *stream;
+    int i;
+
+    for (i = 0; i < FS_DEV_FATFS_MAX_STREAMS; i++) {
+        stream = &fatfsStream[i];
+        if (stream->path && (strcmp(stream->path, path) == 0)) {
+            *prealloc = stream->prealloc;
+            FS_DEVMAN_FREE(stream->path);
+            stream->path = NULL;
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+static void fatfsBuildClmt(FSIO_FATFS_FD *f)
+{
+    FRESULT result;
+    DWORD size;
+
+    if (f_size(&f->f) == 0) {
+        return;
+    }
+
+    size = FS_DEV_FATFS_CLMT_SIZE;
+    do {
+        f->clmt = FS_DEVMAN_CALLOC(size, sizeof(*f->clmt));
+        if (f->clmt == NULL) {
+            break;
+        }
+        f->clmt[0] = size;
+        f->f.cltbl = f->clmt;
+        result = f_lseek(&f->f, CREATE_LINKMAP);
+        if (result != FR_OK) {
+            /* The required table size is returned in the first item */
+            size = f->clmt[0];
+            f->f.cltbl = NULL;
+            FS_DEVMAN_FREE(f->clmt);
+            f->clmt = NULL;
+        }
+    } while (result == FR_NOT_ENOUGH_CORE);
+}
+
+static FRESULT fatfsStreamXfer(FSIO_FATFS_FD *f, void *ptr, UINT len,
+    UINT *xfer, bool write)
+{
+    FIL *fp = &f->f;
+    FRESULT result;
+    UINT done;
+
+    if (!write) {
+        return(f_read(fp, ptr, len, xfer));
+    }
+
+    result = f_write(fp, ptr, len, xfer);
+    if ((result == FR_OK) && (*xfer < len) && fp->cltbl) {
+        /* Past the preallocated space, drop to normal mode so FatFs
+         * can stretch the chain.
+         */
+        fp->cltbl = NULL;
+        result = f_write(fp, (BYTE *)ptr + *xfer, len - *xfer, &done);
+        *xfer += done;
+    }
+    if (f_tell(fp) > f->end) {
+        f->end = f_tell(fp);
+    }
+
+    return(result);
+}
+
+static FRESULT fatfsStreamClose(FSIO_FATFS_FD *f)
+{
+    FRESULT result = FR_OK;
+
+    /* Release unused preallocated space */
+    if (f->prealloc && (f->end < f_size(&f->f))) {
+        result = f_lseek(&f->f, f->end);
+        if (result == FR_OK) {
+            f->f.cltbl = NULL;
+            result = f_truncate(&f->f);
+        }
+    }
+
+    f->f.cltbl = NULL;
+    if (f->clmt) {
+        FS_DEVMAN_FREE(f->clmt);
+        f->clmt = NULL;
+    }
+
+    return(result);
+}
+#endif
+
 /*
  * Helpful fopen() mode cheat sheet
  *
@@ -80,6 +210,9 @@ static int dev_fatfs_open(const char *path, int flags, int mode, void *pdata)
     FIL *f;
     int fd;
     int i;
+#if FF_USE_FASTSEEK
+    FSIZE_t prealloc;
+#endif
 
     fatfsFlags = 0;
 
@@ -136,11 +269,34 @@ static int dev_fatfs_open(const char *path, int flags, int mode, void *pdata)
         result = f_open(f, fp, fatfsFlags);
         if (result == FR_OK) {
             fd  = i;
+#if FF_USE_FASTSEEK
+            fatfsFd[i].clmt = NULL;
+            fatfsFd[i].prealloc = false;
+            fatfsFd[i].end = f_size(f);
+            if (fatfsStreamClaim(fp, &prealloc)) {
+#if FF_USE_EXPAND
+                if (prealloc && (fatfsFlags & FA_WRITE) && (f_size(f) == 0)) {
+                    result = f_expand(f, prealloc, 1);
+                    fatfsFd[i].prealloc = (result == FR_OK);
+                }
+#endif
+                fatfsBuildClmt(&fatfsFd[i]);
+            }
+#endif
         } else {
             fatfsFd[i].open = false;
         }
+    } else if (f) {
+        fatfsFd[i].open = false;
     }
 
+#if FF_USE_FASTSEEK
+    /* Drop a streaming request for a file which failed to open */
+    if ((fd < 0) && fp) {
+        fatfsStreamClaim(fp, &prealloc);
+    }
+#endif
+
     FS_DEVMAN_FREE(fp);
 
     return(fd);
@@ -155,7 +311,16 @@ static int dev_fatfs_close(int fd, void *pdata)
     if (fd < FS_DEVIO_MAX_FATFS_FD) {
         f = &fatfsFd[fd];
         if (f->open) {
+#if FF_USE_FASTSEEK
+            fresult = fatfsStreamClose(f);
+            if (fresult == FR_OK) {
+                fresult = f_close(&f->f);
+            } else {
+                f_close(&f->f);
+            }
+#else
             fresult = f_close(&f->f);
+#endif
             result = (fresult == FR_OK) ? 0 : -1;
             f->open = false;
         }
@@ -171,6 +336,11 @@ static ssize_t dev_fatfs_read(int fd, void *ptr, size_t len, void *pdata)
     UINT readSize;
 
     f = &fatfsFd[fd];
+#if FF_USE_FASTSEEK
+    if (f->clmt) {
+        result = fatfsStreamXfer(f, ptr, (UINT)len, &readSize, false);
+    } else
+#endif
     result = f_read(&f->f, ptr, (UINT)len, &readSize);
     if (result != FR_OK) {
 #if defined(__ADSPARM__)
@@ -190,6 +360,11 @@ static ssize_t dev_fatfs_write(int fd, const void *ptr, size_t len, void *pdata)
     UINT writeSize;
 
     f = &fatfsFd[fd];
+#if FF_USE_FASTSEEK
+    if (f->clmt) {
+        result = fatfsStreamXfer(f, (void *)ptr, (UINT)len, &writeSize, true);
+    } else
+#endif
     result = f_write(&f->f, ptr, (UINT)len, &writeSize);
     if (result != FR_OK) {
 #if defined(__ADSPARM__)
@@ -348,4 +523,31 @@ FS_DEVMAN_DEVICE *fs_dev_fatfs_device(void)
     return(&FS_DEV_ROMFS);
 }
 
+bool fs_dev_fatfs_stream(const char *name, uint32_t preallocBytes)
+{
+#if FF_USE_FASTSEEK
+    FS_DEVMAN_DEVICE_INFO *devInfo;
+    FS_DEVMAN_RESULT result;
+    FSIO_FATFS_STREAM *stream;
+    const char *fname;
+    int i;
+
+    devInfo = fs_devman_getInfo(name, &fname, &result);
+    if (!devInfo || (devInfo->dev != &FS_DEV_ROMFS)) {
+        return(false);
+    }
+
+    for (i = 0; i < FS_DEV_FATFS_MAX_STREAMS; i++) {
+        stream = &fatfsStream[i];
+        if (stream->path == NULL) {
+            stream->path = fullPath(fname, devInfo);
+            stream->prealloc = preallocBytes;
+            return(stream->path != NULL);
+        }
+    }
+#endif
+
+    return(false);
+}
+
 #endif
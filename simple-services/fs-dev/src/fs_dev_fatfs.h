@@ -12,11 +12,25 @@
 #ifndef _fs_dev_fatfs_h
 #define _fs_dev_fatfs_h
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "fs_devman_cfg.h"
 #include "fs_devman.h"
 
 #ifdef FS_DEVMAN_ENABLE_FATFS
 FS_DEVMAN_DEVICE *fs_dev_fatfs_device(void);
+
+/*
+ * Requests streaming mode for the next open of 'name'.  The file's
+ * cluster link map is cached at open so seeks and transfers never walk
+ * the FAT chain.  A file created for writing is
+ * preallocated contiguously with 'preallocBytes' (0 = none) and any
+ * unused space is released at close.
+ *
+ * Requires FF_USE_FASTSEEK (and FF_USE_EXPAND for preallocation).
+ */
+bool fs_dev_fatfs_stream(const char *name, uint32_t preallocBytes);
 #endif
 
 #endif
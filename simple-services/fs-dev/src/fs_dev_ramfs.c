@@ -0,0 +1,907 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fs_dev_adi_modes.h"
+
+#include "fs_devman_cfg.h"
+#include "fs_devman_priv.h"
+#include "fs_devman.h"
+
+#ifdef FS_DEVMAN_ENABLE_RAMFS
+
+#ifdef FREE_RTOS
+#include "FreeRTOS.h"
+#include "semphr.h"
+#endif
+
+#include "fs_dev_ramfs.h"
+
+/*
+ * All RAM filesystem memory comes from these functions.  Point them at
+ * an SDRAM heap to keep large files out of L2, i.e.
+ *
+ *   #define FS_DEV_RAMFS_MALLOC(x)  umm_malloc_heap(UMM_SDRAM_HEAP, x)
+ *   #define FS_DEV_RAMFS_FREE(x)    umm_free_heap(UMM_SDRAM_HEAP, x)
+ */
+#ifndef FS_DEV_RAMFS_MALLOC
+#define FS_DEV_RAMFS_MALLOC(x)      FS_DEVMAN_CALLOC(1, x)
+#endif
+
+#ifndef FS_DEV_RAMFS_FREE
+#define FS_DEV_RAMFS_FREE(x)        FS_DEVMAN_FREE(x)
+#endif
+
+/* File data allocation unit */
+#ifndef FS_DEV_RAMFS_CHUNK_SIZE
+#define FS_DEV_RAMFS_CHUNK_SIZE     1024
+#endif
+
+/* Maximum open files per volume */
+#ifndef FS_DEV_RAMFS_MAX_FDS
+#define FS_DEV_RAMFS_MAX_FDS        8
+#endif
+
+/* Maximum file or directory name length */
+#ifndef FS_DEV_RAMFS_MAX_NAME
+#define FS_DEV_RAMFS_MAX_NAME       64
+#endif
+
+enum {
+    RAMFS_O_READ   = 0x01,
+    RAMFS_O_WRITE  = 0x02,
+    RAMFS_O_APPEND = 0x04,
+    RAMFS_O_CREAT  = 0x08,
+    RAMFS_O_TRUNC  = 0x10
+};
+
+typedef struct _RAMFS_CHUNK {
+    struct _RAMFS_CHUNK *next;
+    uint8_t data[FS_DEV_RAMFS_CHUNK_SIZE];
+} RAMFS_CHUNK;
+
+typedef struct _RAMFS_NODE {
+    struct _RAMFS_NODE *parent;
+    struct _RAMFS_NODE *next;       /* Next entry in the parent directory */
+    struct _RAMFS_NODE *child;      /* First entry of a directory */
+    RAMFS_CHUNK *head;              /* File data */
+    RAMFS_CHUNK *tail;
+    size_t nchunks;
+    size_t size;
+    unsigned openCount;             /* Open files and directory readers */
+    bool isDir;
+    bool unlinked;                  /* Freed on the last close */
+    char *name;
+} RAMFS_NODE;
+
+typedef struct _RAMFS_FD {
+    RAMFS_NODE *node;
+    size_t pos;
+    RAMFS_CHUNK *chunk;             /* Cached chunk starting at chunkBase */
+    size_t chunkBase;
+    int flags;
+} RAMFS_FD;
+
+typedef struct _RAMFS_DIR {
+    RAMFS_NODE *dir;
+    unsigned index;
+} RAMFS_DIR;
+
+struct _FS_DEV_RAMFS {
+#ifdef FREE_RTOS
+    SemaphoreHandle_t lock;
+#endif
+    RAMFS_NODE *root;
+    size_t used;
+    size_t maxBytes;
+    RAMFS_FD fds[FS_DEV_RAMFS_MAX_FDS];
+};
+
+/***********************************************************************
+ * Helpers
+ **********************************************************************/
+static void ramfs_lock(FS_DEV_RAMFS *fs)
+{
+#ifdef FREE_RTOS
+    xSemaphoreTake(fs->lock, portMAX_DELAY);
+#endif
+}
+
+static void ramfs_unlock(FS_DEV_RAMFS *fs)
+{
+#ifdef FREE_RTOS
+    xSemaphoreGive(fs->lock);
+#endif
+}
+
+static FS_DEV_RAMFS *ramfs_fs(void *pdata)
+{
+    FS_DEVMAN_DEVICE_INFO *devInfo = (FS_DEVMAN_DEVICE_INFO *)pdata;
+    return((FS_DEV_RAMFS *)devInfo->usr);
+}
+
+static RAMFS_NODE *ramfs_node_alloc(const char *name, size_t len, bool isDir)
+{
+    RAMFS_NODE *node;
+
+    node = FS_DEV_RAMFS_MALLOC(sizeof(*node));
+    if (node == NULL) {
+        return(NULL);
+    }
+    memset(node, 0, sizeof(*node));
+
+    node->name = FS_DEV_RAMFS_MALLOC(len + 1);
+    if (node->name == NULL) {
+        FS_DEV_RAMFS_FREE(node);
+        return(NULL);
+    }
+    memcpy(node->name, name, len);
+    node->name[len] = '\0';
+    node->isDir = isDir;
+
+    return(node);
+}
+
+static void ramfs_truncate(FS_DEV_RAMFS *fs, RAMFS_NODE *node)
+{
+    RAMFS_CHUNK *chunk, *next;
+    unsigned i;
+
+    for (chunk = node->head; chunk; chunk = next) {
+        next = chunk->next;
+        FS_DEV_RAMFS_FREE(chunk);
+    }
+    fs->used -= node->nchunks * FS_DEV_RAMFS_CHUNK_SIZE;
+    node->head = node->tail = NULL;
+    node->nchunks = 0;
+    node->size = 0;
+
+    /* Drop cached chunks of other open files */
+    for (i = 0; i < FS_DEV_RAMFS_MAX_FDS; i++) {
+        if (fs->fds[i].node == node) {
+            fs->fds[i].chunk = NULL;
+        }
+    }
+}
+
+static void ramfs_node_free(FS_DEV_RAMFS *fs, RAMFS_NODE *node)
+{
+    RAMFS_NODE *child, *next;
+
+    for (child = node->child; child; child = next) {
+        next = child->next;
+        ramfs_node_free(fs, child);
+    }
+    ramfs_truncate(fs, node);
+    FS_DEV_RAMFS_FREE(node->name);
+    FS_DEV_RAMFS_FREE(node);
+}
+
+static void ramfs_detach(RAMFS_NODE *node)
+{
+    RAMFS_NODE **pp;
+
+    for (pp = &node->parent->child; *pp; pp = &(*pp)->next) {
+        if (*pp == node) {
+            *pp = node->next;
+            break;
+        }
+    }
+    node->next = NULL;
+    node->parent = NULL;
+}
+
+static void ramfs_attach(RAMFS_NODE *dir, RAMFS_NODE *node)
+{
+    node->parent = dir;
+    node->next = dir->child;
+    dir->child = node;
+}
+
+static RAMFS_NODE *ramfs_child(RAMFS_NODE *dir, const char *name, size_t len)
+{
+    RAMFS_NODE *node;
+
+    for (node = dir->child; node; node = node->next) {
+        if ((strncmp(node->name, name, len) == 0) && (node->name[len] == '\0')) {
+            return(node);
+        }
+    }
+
+    return(NULL);
+}
+
+/*
+ * Find 'path'.  If the parent directory of the last path component
+ * exists it is returned in 'parent' along with the component so a missing
+ * file can be created.
+ */
+static RAMFS_NODE *ramfs_find(FS_DEV_RAMFS *fs, const char *path,
+    RAMFS_NODE **parent, const char **leaf, size_t *leafLen)
+{
+    RAMFS_NODE *dir, *child;
+    const char *next;
+    size_t len;
+
+    if (parent) {
+        *parent = NULL;
+    }
+
+    /* Lua looks for modules starting with a './' path */
+    if (strncmp(path, "./", 2) == 0) {
+        path += 2;
+    }
+
+    dir = fs->root;
+    while (1) {
+        while (*path == '/') {
+            path++;
+        }
+        if (*path == '\0') {
+            return(dir);
+        }
+
+        len = strcspn(path, "/");
+        next = path + len;
+        while (*next == '/') {
+            next++;
+        }
+
+        child = ramfs_child(dir, path, len);
+        if (*next == '\0') {
+            if (parent) {
+                *parent = dir;
+                *leaf = path;
+                *leafLen = len;
+            }
+            return(child);
+        }
+        if ((child == NULL) || !child->isDir) {
+            return(NULL);
+        }
+
+        dir = child;
+        path = next;
+    }
+}
+
+/* Returns the chunk holding 'pos', which must be below the capacity */
+static RAMFS_CHUNK *ramfs_chunk(RAMFS_NODE *node, RAMFS_FD *f, size_t pos)
+{
+    RAMFS_CHUNK *chunk;
+    size_t base;
+
+    base = (node->nchunks - 1) * FS_DEV_RAMFS_CHUNK_SIZE;
+    if (pos >= base) {
+        chunk = node->tail;
+    } else {
+        if (f && f->chunk && (f->chunkBase <= pos)) {
+            chunk = f->chunk;
+            base = f->chunkBase;
+        } else {
+            chunk = node->head;
+            base = 0;
+        }
+        while (pos >= base + FS_DEV_RAMFS_CHUNK_SIZE) {
+            chunk = chunk->next;
+            base += FS_DEV_RAMFS_CHUNK_SIZE;
+        }
+    }
+
+    if (f) {
+        f->chunk = chunk;
+        f->chunkBase = base;
+    }
+
+    return(chunk);
+}
+
+/* Write 'len' bytes of 'src' (zeros if NULL) at 'pos' */
+static size_t ramfs_write_at(FS_DEV_RAMFS *fs, RAMFS_FD *f,
+    size_t pos, const uint8_t *src, size_t len)
+{
+    RAMFS_NODE *node = f->node;
+    RAMFS_CHUNK *chunk;
+    size_t done, off, n;
+
+    done = 0;
+    while (done < len) {
+        /* Grow by one chunk at the end of the file */
+        if (pos == node->nchunks * FS_DEV_RAMFS_CHUNK_SIZE) {
+            if (fs->maxBytes &&
+                (fs->used + FS_DEV_RAMFS_CHUNK_SIZE > fs->maxBytes)) {
+                break;
+            }
+            chunk = FS_DEV_RAMFS_MALLOC(sizeof(*chunk));
+            if (chunk == NULL) {
+                break;
+            }
+            chunk->next = NULL;
+            if (node->tail) {
+                node->tail->next = chunk;
+            } else {
+                node->head = chunk;
+            }
+            node->tail = chunk;
+            node->nchunks++;
+            fs->used += FS_DEV_RAMFS_CHUNK_SIZE;
+        }
+
+        chunk = ramfs_chunk(node, f, pos);
+        off = pos - f->chunkBase;
+        n = FS_DEV_RAMFS_CHUNK_SIZE - off;
+        if (n > len - done) {
+            n = len - done;
+        }
+        if (src) {
+            memcpy(&chunk->data[off], src + done, n);
+        } else {
+            memset(&chunk->data[off], 0, n);
+        }
+        pos += n;
+        done += n;
+        if (pos > node->size) {
+            node->size = pos;
+        }
+    }
+
+    return(done);
+}
+
+static RAMFS_FD *ramfs_fd(FS_DEV_RAMFS *fs, int fd)
+{
+    if ((fd < 0) || (fd >= FS_DEV_RAMFS_MAX_FDS) || !fs->fds[fd].node) {
+        return(NULL);
+    }
+    return(&fs->fds[fd]);
+}
+
+static void ramfs_release(RAMFS_NODE *node, FS_DEV_RAMFS *fs)
+{
+    node->openCount--;
+    if (node->unlinked && (node->openCount == 0)) {
+        ramfs_node_free(fs, node);
+    }
+}
+
+/***********************************************************************
+ * Device functions
+ **********************************************************************/
+static int dev_ramfs_open(const char *path, int flags, int mode, void *pdata)
+{
+    FS_DEV_RAMFS *fs = ramfs_fs(pdata);
+    RAMFS_NODE *node, *parent;
+    RAMFS_FD *f;
+    const char *leaf;
+    size_t leafLen;
+    int ramfsFlags;
+    int fd;
+
+    ramfsFlags = 0;
+
+#if defined(__ADSPARM__)
+    if (mode & ADI_RW) {
+        ramfsFlags |= RAMFS_O_READ | RAMFS_O_WRITE;
+    }
+    if (mode & ADI_WRITE) {
+        ramfsFlags |= RAMFS_O_WRITE | RAMFS_O_CREAT | RAMFS_O_TRUNC;
+    } else if (mode & ADI_APPEND) {
+        ramfsFlags |= RAMFS_O_WRITE | RAMFS_O_CREAT | RAMFS_O_APPEND;
+    } else {
+        ramfsFlags |= RAMFS_O_READ;
+    }
+#else
+    if (mode & ADI_READ) ramfsFlags |= RAMFS_O_READ;
+    if (mode & ADI_WRITE) ramfsFlags |= RAMFS_O_WRITE;
+    if (mode & ADI_APPEND) ramfsFlags |= RAMFS_O_WRITE | RAMFS_O_APPEND;
+    if (mode & ADI_CREAT) ramfsFlags |= RAMFS_O_CREAT;
+    if (mode & ADI_TRUNC) ramfsFlags |= RAMFS_O_TRUNC;
+#endif
+
+    ramfs_lock(fs);
+
+    for (fd = 0; fd < FS_DEV_RAMFS_MAX_FDS; fd++) {
+        if (fs->fds[fd].node == NULL) {
+            break;
+        }
+    }
+    if (fd == FS_DEV_RAMFS_MAX_FDS) {
+        ramfs_unlock(fs);
+        return(-1);
+    }
+
+    node = ramfs_find(fs, path, &parent, &leaf, &leafLen);
+    if (node == NULL) {
+        if (!(ramfsFlags & RAMFS_O_CREAT) || (parent == NULL) ||
+            (leafLen > FS_DEV_RAMFS_MAX_NAME)) {
+            ramfs_unlock(fs);
+            return(-1);
+        }
+        node = ramfs_node_alloc(leaf, leafLen, false);
+        if (node == NULL) {
+            ramfs_unlock(fs);
+            return(-1);
+        }
+        ramfs_attach(parent, node);
+    }
+
+    if (node->isDir) {
+        ramfs_unlock(fs);
+        return(-1);
+    }
+
+    if ((ramfsFlags & RAMFS_O_TRUNC) && (ramfsFlags & RAMFS_O_WRITE)) {
+        ramfs_truncate(fs, node);
+    }
+
+    f = &fs->fds[fd];
+    memset(f, 0, sizeof(*f));
+    f->node = node;
+    f->flags = ramfsFlags;
+    node->openCount++;
+
+    ramfs_unlock(fs);
+
+    return(fd);
+}
+
+static int dev_ramfs_close(int fd, void *pdata)
+{
+    FS_DEV_RAMFS *fs = ramfs_fs(pdata);
+    RAMFS_NODE *node;
+    RAMFS_FD *f;
+
+    ramfs_lock(fs);
+
+    f = ramfs_fd(fs, fd);
+    if (f == NULL) {
+        ramfs_unlock(fs);
+        return(-1);
+    }
+
+    node = f->node;
+    memset(f, 0, sizeof(*f));
+    ramfs_release(node, fs);
+
+    ramfs_unlock(fs);
+
+    return(0);
+}
+
+static ssize_t dev_ramfs_read(int fd, void *ptr, size_t len, void *pdata)
+{
+    FS_DEV_RAMFS *fs = ramfs_fs(pdata);
+    RAMFS_CHUNK *chunk;
+    RAMFS_NODE *node;
+    RAMFS_FD *f;
+    size_t done, off, n;
+
+    ramfs_lock(fs);
+
+    f = ramfs_fd(fs, fd);
+    if ((f == NULL) || !(f->flags & RAMFS_O_READ)) {
+        ramfs_unlock(fs);
+#if defined(__ADSPARM__)
+        return(0);
+#else
+        return(-1);
+#endif
+    }
+
+    node = f->node;
+    if (f->pos >= node->size) {
+        len = 0;
+    } else if (len > node->size - f->pos) {
+        len = node->size - f->pos;
+    }
+
+    done = 0;
+    while (done < len) {
+        chunk = ramfs_chunk(node, f, f->pos);
+        off = f->pos - f->chunkBase;
+        n = FS_DEV_RAMFS_CHUNK_SIZE - off;
+        if (n > len - done) {
+            n = len - done;
+        }
+        memcpy((uint8_t *)ptr + done, &chunk->data[off], n);
+        f->pos += n;
+        done += n;
+    }
+
+    ramfs_unlock(fs);
+
+    return((ssize_t)done);
+}
+
+static ssize_t dev_ramfs_write(int fd, const void *ptr, size_t len, void *pdata)
+{
+    FS_DEV_RAMFS *fs = ramfs_fs(pdata);
+    RAMFS_NODE *node;
+    RAMFS_FD *f;
+    size_t done;
+
+    ramfs_lock(fs);
+
+    f = ramfs_fd(fs, fd);
+    if ((f == NULL) || !(f->flags & RAMFS_O_WRITE)) {
+        ramfs_unlock(fs);
+#if defined(__ADSPARM__)
+        return(0);
+#else
+        return(-1);
+#endif
+    }
+
+    node = f->node;
+    if (f->flags & RAMFS_O_APPEND) {
+        f->pos = node->size;
+    }
+
+    /* Fill any gap left by a seek past the end */
+    if (f->pos > node->size) {
+        ramfs_write_at(fs, f, node->size, NULL, f->pos - node->size);
+        if (node->size < f->pos) {
+            ramfs_unlock(fs);
+            return(0);
+        }
+    }
+
+    done = ramfs_write_at(fs, f, f->pos, (const uint8_t *)ptr, len);
+    f->pos += done;
+
+    ramfs_unlock(fs);
+
+    return((ssize_t)done);
+}
+
+static off_t dev_ramfs_lseek(int fd, off_t off, int whence, void *pdata)
+{
+    FS_DEV_RAMFS *fs = ramfs_fs(pdata);
+    RAMFS_FD *f;
+    off_t pos;
+
+    ramfs_lock(fs);
+
+    f = ramfs_fd(fs, fd);
+    if (f == NULL) {
+        ramfs_unlock(fs);
+        return(-1);
+    }
+
+    switch (whence)
+    {
+        case SEEK_SET:
+            pos = off;
+            break;
+        case SEEK_CUR:
+            pos = (off_t)f->pos + off;
+            break;
+        case SEEK_END:
+            pos = (off_t)f->node->size + off;
+            break;
+        default:
+            pos = -1;
+            break;
+    }
+
+    if (pos >= 0) {
+        f->pos = (size_t)pos;
+    } else {
+        pos = -1;
+    }
+
+    ramfs_unlock(fs);
+
+    return(pos);
+}
+
+static void *dev_ramfs_opendir(const char *name, void *pdata)
+{
+    FS_DEV_RAMFS *fs = ramfs_fs(pdata);
+    FS_DEVMAN_DIR *ddir = NULL;
+    RAMFS_DIR *rdir = NULL;
+    RAMFS_NODE *node;
+
+    ramfs_lock(fs);
+
+    node = ramfs_find(fs, name, NULL, NULL, NULL);
+    if (node && node->isDir) {
+        rdir = FS_DEVMAN_CALLOC(1, sizeof(*rdir));
+        ddir = FS_DEVMAN_CALLOC(1, sizeof(*ddir));
+        if (rdir && ddir) {
+            rdir->dir = node;
+            ddir->dir = rdir;
+            node->openCount++;
+        } else {
+            if (rdir) {
+                FS_DEVMAN_FREE(rdir);
+            }
+            if (ddir) {
+                FS_DEVMAN_FREE(ddir);
+                ddir = NULL;
+            }
+        }
+    }
+
+    ramfs_unlock(fs);
+
+    return(ddir);
+}
+
+static FS_DEVMAN_DIRENT *dev_ramfs_readdir(void *dir, void *pdata)
+{
+    FS_DEV_RAMFS *fs = ramfs_fs(pdata);
+    FS_DEVMAN_DIR *ddir = (FS_DEVMAN_DIR *)dir;
+    RAMFS_DIR *rdir = (RAMFS_DIR *)ddir->dir;
+    FS_DEVMAN_DIRENT *dirent = NULL;
+    RAMFS_NODE *node;
+    unsigned i;
+    size_t size;
+
+    ramfs_lock(fs);
+
+    /* Entries are counted rather than held so they can be removed */
+    node = rdir->dir->child;
+    for (i = 0; node && (i < rdir->index); i++) {
+        node = node->next;
+    }
+
+    if (node) {
+        rdir->index++;
+        dirent = &ddir->dirent;
+        dirent->fsize = node->size;
+        dirent->ftime = 0;
+        dirent->fdate = 0;
+        dirent->flags = node->isDir ? FS_DEVMAN_DIRENT_FLAG_DIR : 0;
+        size = strlen(node->name) + 1;
+        if (dirent->fname) {
+            FS_DEVMAN_FREE((void *)dirent->fname);
+        }
+        dirent->fname = FS_DEVMAN_CALLOC(size, sizeof(*dirent->fname));
+        if (dirent->fname) {
+            memcpy((void *)dirent->fname, node->name, size);
+        } else {
+            dirent = NULL;
+        }
+    }
+
+    ramfs_unlock(fs);
+
+    return(dirent);
+}
+
+static int dev_ramfs_closedir(void *dir, void *pdata)
+{
+    FS_DEV_RAMFS *fs = ramfs_fs(pdata);
+    FS_DEVMAN_DIR *ddir = (FS_DEVMAN_DIR *)dir;
+    RAMFS_DIR *rdir = (RAMFS_DIR *)ddir->dir;
+
+    ramfs_lock(fs);
+    ramfs_release(rdir->dir, fs);
+    ramfs_unlock(fs);
+
+    if (ddir->dirent.fname) {
+        FS_DEVMAN_FREE((void *)ddir->dirent.fname);
+    }
+    FS_DEVMAN_FREE(rdir);
+    FS_DEVMAN_FREE(ddir);
+
+    return(0);
+}
+
+static void ramfs_remove(FS_DEV_RAMFS *fs, RAMFS_NODE *node)
+{
+    ramfs_detach(node);
+    if (node->openCount) {
+        node->unlinked = true;
+    } else {
+        ramfs_node_free(fs, node);
+    }
+}
+
+static int dev_ramfs_unlink(const char *fname, void *pdata)
+{
+    FS_DEV_RAMFS *fs = ramfs_fs(pdata);
+    RAMFS_NODE *node;
+    int result = -1;
+
+    ramfs_lock(fs);
+
+    node = ramfs_find(fs, fname, NULL, NULL, NULL);
+    if (node && (node != fs->root) && (node->child == NULL)) {
+        ramfs_remove(fs, node);
+        result = 0;
+    }
+
+    ramfs_unlock(fs);
+
+    return(result);
+}
+
+static int dev_ramfs_rename(const char *oldname, const char *newname, void *pdata)
+{
+    FS_DEV_RAMFS *fs = ramfs_fs(pdata);
+    RAMFS_NODE *node, *target, *parent, *p;
+    const char *leaf;
+    size_t leafLen;
+    char *name;
+    int result = -1;
+
+    ramfs_lock(fs);
+
+    node = ramfs_find(fs, oldname, NULL, NULL, NULL);
+    target = ramfs_find(fs, newname, &parent, &leaf, &leafLen);
+    if ((node == NULL) || (node == fs->root) || (parent == NULL) ||
+        (leafLen > FS_DEV_RAMFS_MAX_NAME) || (target == node)) {
+        goto abort;
+    }
+
+    /* A directory can't be moved below itself */
+    for (p = parent; p; p = p->parent) {
+        if (p == node) {
+            goto abort;
+        }
+    }
+
+    /* Replace an existing file */
+    if (target) {
+        if (target->isDir || node->isDir) {
+            goto abort;
+        }
+    }
+
+    name = FS_DEV_RAMFS_MALLOC(leafLen + 1);
+    if (name == NULL) {
+        goto abort;
+    }
+    memcpy(name, leaf, leafLen);
+    name[leafLen] = '\0';
+
+    if (target) {
+        ramfs_remove(fs, target);
+    }
+
+    ramfs_detach(node);
+    FS_DEV_RAMFS_FREE(node->name);
+    node->name = name;
+    ramfs_attach(parent, node);
+    result = 0;
+
+abort:
+    ramfs_unlock(fs);
+
+    return(result);
+}
+
+static FS_DEVMAN_DEVICE FS_DEV_RAMFS_DEVICE = {
+  .fsd_open = dev_ramfs_open,
+  .fsd_close = dev_ramfs_close,
+  .fsd_read = dev_ramfs_read,
+  .fsd_write = dev_ramfs_write,
+  .fsd_lseek = dev_ramfs_lseek,
+  .fsd_opendir = dev_ramfs_opendir,
+  .fsd_readdir = dev_ramfs_readdir,
+  .fsd_closedir = dev_ramfs_closedir,
+  .fsd_unlink = dev_ramfs_unlink,
+  .fsd_rename = dev_ramfs_rename
+};
+
+/***********************************************************************
+ * Public functions
+ **********************************************************************/
+FS_DEV_RAMFS *fs_dev_ramfs_create(size_t maxBytes)
+{
+    FS_DEV_RAMFS *fs;
+
+    fs = FS_DEV_RAMFS_MALLOC(sizeof(*fs));
+    if (fs == NULL) {
+        return(NULL);
+    }
+    memset(fs, 0, sizeof(*fs));
+
+    fs->root = ramfs_node_alloc("", 0, true);
+    if (fs->root == NULL) {
+        FS_DEV_RAMFS_FREE(fs);
+        return(NULL);
+    }
+    fs->maxBytes = maxBytes;
+
+#ifdef FREE_RTOS
+    fs->lock = xSemaphoreCreateMutex();
+#endif
+
+    return(fs);
+}
+
+void fs_dev_ramfs_destroy(FS_DEV_RAMFS *fs)
+{
+    if (fs == NULL) {
+        return;
+    }
+
+    ramfs_node_free(fs, fs->root);
+
+#ifdef FREE_RTOS
+    if (fs->lock) {
+        vSemaphoreDelete(fs->lock);
+    }
+#endif
+
+    FS_DEV_RAMFS_FREE(fs);
+}
+
+int fs_dev_ramfs_mkdir(FS_DEV_RAMFS *fs, const char *path)
+{
+    RAMFS_NODE *node, *parent;
+    const char *leaf;
+    size_t leafLen;
+    int result = -1;
+
+    ramfs_lock(fs);
+
+    node = ramfs_find(fs, path, &parent, &leaf, &leafLen);
+    if ((node == NULL) && parent && (leafLen <= FS_DEV_RAMFS_MAX_NAME)) {
+        node = ramfs_node_alloc(leaf, leafLen, true);
+        if (node) {
+            ramfs_attach(parent, node);
+            result = 0;
+        }
+    }
+
+    ramfs_unlock(fs);
+
+    return(result);
+}
+
+const void *fs_dev_ramfs_peek(FS_DEV_RAMFS *fs, const char *path,
+    size_t offset, size_t *len)
+{
+    RAMFS_CHUNK *chunk;
+    RAMFS_NODE *node;
+    const void *ptr = NULL;
+    size_t n = 0;
+
+    ramfs_lock(fs);
+
+    node = ramfs_find(fs, path, NULL, NULL, NULL);
+    if (node && !node->isDir && (offset < node->size)) {
+        chunk = ramfs_chunk(node, NULL, offset);
+        ptr = &chunk->data[offset % FS_DEV_RAMFS_CHUNK_SIZE];
+        n = FS_DEV_RAMFS_CHUNK_SIZE - (offset % FS_DEV_RAMFS_CHUNK_SIZE);
+        if (n > node->size - offset) {
+            n = node->size - offset;
+        }
+    }
+
+    ramfs_unlock(fs);
+
+    if (len) {
+        *len = n;
+    }
+
+    return(ptr);
+}
+
+size_t fs_dev_ramfs_used(FS_DEV_RAMFS *fs)
+{
+    return(fs->used);
+}
+
+FS_DEVMAN_DEVICE *fs_dev_ramfs_device(void)
+{
+    return(&FS_DEV_RAMFS_DEVICE);
+}
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#ifndef _fs_dev_ramfs_h
+#define _fs_dev_ramfs_h
+
+#include <stddef.h>
+
+#include "fs_devman_cfg.h"
+#include "fs_devman.h"
+
+#ifdef FS_DEVMAN_ENABLE_RAMFS
+
+typedef struct _FS_DEV_RAMFS FS_DEV_RAMFS;
+
+/*
+ * Create an empty RAM filesystem.  'maxBytes' limits the memory used
+ * for file data (0 = limited by the heap only).  Register the returned
+ * handle as the 'usr' argument of fs_devman_register().
+ */
+FS_DEV_RAMFS *fs_dev_ramfs_create(size_t maxBytes);
+
+/*
+ * Free a RAM filesystem and all of its files.  The volume must be
+ * unregistered and have no open files.
+ */
+void fs_dev_ramfs_destroy(FS_DEV_RAMFS *fs);
+
+/* Create a directory.  The parent directory must exist. */
+int fs_dev_ramfs_mkdir(FS_DEV_RAMFS *fs, const char *path);
+
+/*
+ * Zero-copy read access.  Returns a pointer to the file data at
+ * 'offset' and the number of contiguous bytes available there in 'len',
+ * or NULL if the file does not exist or 'offset' is at or past the end.
+ * The pointer remains valid until the file is truncated or removed.
+ */
+const void *fs_dev_ramfs_peek(FS_DEV_RAMFS *fs, const char *path,
+    size_t offset, size_t *len);
+
+/* Returns the number of bytes of file data held by the filesystem */
+size_t fs_dev_ramfs_used(FS_DEV_RAMFS *fs);
+
+FS_DEVMAN_DEVICE *fs_dev_ramfs_device(void);
+
+#endif
+
+#endif
@@ -0,0 +1,665 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host test for the fs-dev RAM filesystem.
+ *
+ * The volume is registered with the device manager and driven through
+ * its device functions, exactly as fs_devio calls them, by a random mix
+ * of opens, closes, reads, writes, seeks past the end, appends,
+ * truncates, unlinks of open files, renames, directory listings and
+ * zero-copy peeks.  Every result is checked against a simple model of
+ * the files, as is the memory accounting.  The volume size limit is
+ * then checked, and the cost of an append is measured at increasing
+ * file sizes to show it does not grow with the file.
+ *
+ * Build from the 'fs-dev' directory with:
+ *   gcc -O2 -DFS_DEVMAN_ENABLE_RAMFS -Iinc -Isrc \
+ *       -o fs_dev_ramfs_sim src/fs_dev_ramfs_sim/fs_dev_ramfs_sim.c \
+ *       src/fs_devman.c src/fs_dev_ramfs.c
+ *
+ * Add -fsanitize=address to also check for leaks and overruns.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "fs_dev_adi_modes.h"
+#include "fs_devman_cfg.h"
+#include "fs_devman_priv.h"
+#include "fs_devman.h"
+#include "fs_dev_ramfs.h"
+
+#ifndef FS_DEV_RAMFS_CHUNK_SIZE
+#define FS_DEV_RAMFS_CHUNK_SIZE     1024
+#endif
+
+#ifndef FS_DEV_RAMFS_MAX_FDS
+#define FS_DEV_RAMFS_MAX_FDS        8
+#endif
+
+#define SIM_DIRS        4
+#define SIM_NAMES       6
+#define SIM_PATHS       (SIM_DIRS * SIM_NAMES)
+#define SIM_MAX_IO      3000
+
+/* Model of a file, kept after an unlink while it is open */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t cap;
+    unsigned openCount;
+    bool linked;
+} SIM_FILE;
+
+typedef struct {
+    SIM_FILE *file;
+    size_t pos;
+    int mode;
+} SIM_FD;
+
+typedef struct {
+    FS_DEV_RAMFS *fs;
+    FS_DEVMAN_DEVICE_INFO *info;
+    const FS_DEVMAN_DEVICE *dev;
+    SIM_FILE *path[SIM_PATHS];
+    SIM_FD fd[FS_DEV_RAMFS_MAX_FDS];
+    uint8_t buf[SIM_MAX_IO];
+    uint8_t ref[SIM_MAX_IO];
+    uint32_t step;
+    int fails;
+} SIM_STATE;
+
+static SIM_STATE sim;
+
+static const char *simDirs[SIM_DIRS] = { "", "/tmp", "/lua", "/tmp/log" };
+
+static uint32_t rngState;
+
+static uint32_t sim_rand(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return(rngState);
+}
+
+static void sim_fail(const char *what)
+{
+    if (sim.fails < 20) {
+        printf("step %u: %s\n", sim.step, what);
+    }
+    sim.fails++;
+}
+
+static void sim_path(char *path, int p)
+{
+    /* Lua opens its modules with a "./" prefix */
+    sprintf(path, "%s%s/f%d.dat", (p % 7 == 3) ? "./" : "",
+        simDirs[p / SIM_NAMES], p % SIM_NAMES);
+}
+
+static void sim_file_put(SIM_FILE *f)
+{
+    if (!f->linked && (f->openCount == 0)) {
+        free(f->data);
+        free(f);
+    }
+}
+
+static void sim_file_write(SIM_FILE *f, size_t pos, const uint8_t *src,
+    size_t len)
+{
+    size_t end = pos + len;
+
+    if ((end > f->cap) || (f->data == NULL)) {
+        f->cap = end * 2 + 1;
+        f->data = realloc(f->data, f->cap);
+    }
+    if (pos > f->size) {
+        memset(f->data + f->size, 0, pos - f->size);
+    }
+    memcpy(f->data + pos, src, len);
+    if (end > f->size) {
+        f->size = end;
+    }
+}
+
+static size_t sim_used(void)
+{
+    size_t used = 0;
+    int i, j;
+    bool dup;
+
+    for (i = 0; i < SIM_PATHS; i++) {
+        if (sim.path[i]) {
+            used += (sim.path[i]->size + FS_DEV_RAMFS_CHUNK_SIZE - 1) /
+                FS_DEV_RAMFS_CHUNK_SIZE * FS_DEV_RAMFS_CHUNK_SIZE;
+        }
+    }
+    /* Unlinked files still open */
+    for (i = 0; i < FS_DEV_RAMFS_MAX_FDS; i++) {
+        if (sim.fd[i].file && !sim.fd[i].file->linked) {
+            dup = false;
+            for (j = 0; j < i; j++) {
+                if (sim.fd[j].file == sim.fd[i].file) {
+                    dup = true;
+                }
+            }
+            if (!dup) {
+                used += (sim.fd[i].file->size + FS_DEV_RAMFS_CHUNK_SIZE - 1) /
+                    FS_DEV_RAMFS_CHUNK_SIZE * FS_DEV_RAMFS_CHUNK_SIZE;
+            }
+        }
+    }
+    return(used);
+}
+
+static void sim_open(void)
+{
+    static const int modes[] = {
+        ADI_READ,
+        ADI_WRITE | ADI_CREAT | ADI_TRUNC,
+        ADI_READ | ADI_WRITE,
+        ADI_READ | ADI_WRITE | ADI_CREAT,
+        ADI_APPEND | ADI_CREAT,
+        ADI_READ | ADI_APPEND | ADI_CREAT,
+    };
+    char path[32];
+    SIM_FILE *f;
+    int p, mode, fd, i;
+    bool full;
+
+    p = sim_rand() % SIM_PATHS;
+    mode = modes[sim_rand() % (sizeof(modes) / sizeof(modes[0]))];
+    sim_path(path, p);
+
+    full = true;
+    for (i = 0; i < FS_DEV_RAMFS_MAX_FDS; i++) {
+        if (sim.fd[i].file == NULL) {
+            full = false;
+        }
+    }
+
+    fd = sim.dev->fsd_open(path, 0, mode, sim.info);
+    if (full || ((sim.path[p] == NULL) && !(mode & ADI_CREAT))) {
+        if (fd >= 0) {
+            sim_fail("open should have failed");
+        }
+        return;
+    }
+    if ((fd < 0) || (fd >= FS_DEV_RAMFS_MAX_FDS) || sim.fd[fd].file) {
+        sim_fail("open failed");
+        return;
+    }
+
+    f = sim.path[p];
+    if (f == NULL) {
+        f = calloc(1, sizeof(*f));
+        f->linked = true;
+        sim.path[p] = f;
+    }
+    if ((mode & ADI_TRUNC) && (mode & ADI_WRITE)) {
+        f->size = 0;
+    }
+    f->openCount++;
+    sim.fd[fd].file = f;
+    sim.fd[fd].pos = 0;
+    sim.fd[fd].mode = mode;
+}
+
+static int sim_pick_fd(void)
+{
+    int fd, i;
+
+    fd = sim_rand() % FS_DEV_RAMFS_MAX_FDS;
+    for (i = 0; i < FS_DEV_RAMFS_MAX_FDS; i++) {
+        if (sim.fd[(fd + i) % FS_DEV_RAMFS_MAX_FDS].file) {
+            return((fd + i) % FS_DEV_RAMFS_MAX_FDS);
+        }
+    }
+    return(-1);
+}
+
+static void sim_close(void)
+{
+    SIM_FILE *f;
+    int fd;
+
+    fd = sim_pick_fd();
+    if (fd < 0) {
+        if (sim.dev->fsd_close(sim_rand() % FS_DEV_RAMFS_MAX_FDS,
+                sim.info) == 0) {
+            sim_fail("close of a closed fd succeeded");
+        }
+        return;
+    }
+    if (sim.dev->fsd_close(fd, sim.info) != 0) {
+        sim_fail("close failed");
+    }
+    f = sim.fd[fd].file;
+    sim.fd[fd].file = NULL;
+    f->openCount--;
+    sim_file_put(f);
+}
+
+static void sim_write(void)
+{
+    SIM_FD *s;
+    ssize_t n;
+    size_t len, i;
+    int fd;
+
+    fd = sim_pick_fd();
+    if (fd < 0) {
+        return;
+    }
+    s = &sim.fd[fd];
+    len = sim_rand() % SIM_MAX_IO;
+    for (i = 0; i < len; i++) {
+        sim.buf[i] = (uint8_t)sim_rand();
+    }
+
+    n = sim.dev->fsd_write(fd, sim.buf, len, sim.info);
+    if (!(s->mode & (ADI_WRITE | ADI_APPEND))) {
+        if (n >= 0) {
+            sim_fail("write on a read only fd succeeded");
+        }
+        return;
+    }
+    if (n != (ssize_t)len) {
+        sim_fail("short write");
+        return;
+    }
+    if (s->mode & ADI_APPEND) {
+        s->pos = s->file->size;
+    }
+    sim_file_write(s->file, s->pos, sim.buf, len);
+    s->pos += len;
+}
+
+static void sim_read(void)
+{
+    SIM_FD *s;
+    ssize_t n;
+    size_t len;
+    int fd;
+
+    fd = sim_pick_fd();
+    if (fd < 0) {
+        return;
+    }
+    s = &sim.fd[fd];
+    len = sim_rand() % SIM_MAX_IO;
+
+    n = sim.dev->fsd_read(fd, sim.buf, len, sim.info);
+    if (!(s->mode & ADI_READ)) {
+        if (n >= 0) {
+            sim_fail("read on a write only fd succeeded");
+        }
+        return;
+    }
+    if (s->pos >= s->file->size) {
+        len = 0;
+    } else if (len > s->file->size - s->pos) {
+        len = s->file->size - s->pos;
+    }
+    if (n != (ssize_t)len) {
+        sim_fail("read length");
+        return;
+    }
+    if (len && (memcmp(sim.buf, s->file->data + s->pos, len) != 0)) {
+        sim_fail("read data");
+    }
+    s->pos += len;
+}
+
+static void sim_seek(void)
+{
+    SIM_FD *s;
+    off_t off, pos, expect;
+    int fd, whence;
+
+    fd = sim_pick_fd();
+    if (fd < 0) {
+        return;
+    }
+    s = &sim.fd[fd];
+    off = (off_t)(sim_rand() % 4000) - 1000;
+    whence = sim_rand() % 3;
+    switch (whence) {
+        case 0: whence = SEEK_SET; expect = off; break;
+        case 1: whence = SEEK_CUR; expect = (off_t)s->pos + off; break;
+        default: whence = SEEK_END; expect = (off_t)s->file->size + off; break;
+    }
+    pos = sim.dev->fsd_lseek(fd, off, whence, sim.info);
+    if (expect < 0) {
+        if (pos != -1) {
+            sim_fail("seek before the start succeeded");
+        }
+        return;
+    }
+    if (pos != expect) {
+        sim_fail("seek position");
+        return;
+    }
+    s->pos = (size_t)pos;
+}
+
+static void sim_unlink(void)
+{
+    char path[32];
+    int p, r;
+
+    p = sim_rand() % SIM_PATHS;
+    sim_path(path, p);
+    r = sim.dev->fsd_unlink(path, sim.info);
+    if (sim.path[p] == NULL) {
+        if (r == 0) {
+            sim_fail("unlink of a missing file succeeded");
+        }
+        return;
+    }
+    if (r != 0) {
+        sim_fail("unlink failed");
+        return;
+    }
+    sim.path[p]->linked = false;
+    sim_file_put(sim.path[p]);
+    sim.path[p] = NULL;
+}
+
+static void sim_rename(void)
+{
+    char from[32], to[32];
+    int a, b, r;
+
+    a = sim_rand() % SIM_PATHS;
+    b = sim_rand() % SIM_PATHS;
+    sim_path(from, a);
+    sim_path(to, b);
+    r = sim.dev->fsd_rename(from, to, sim.info);
+    if ((sim.path[a] == NULL) || (a == b)) {
+        if (r == 0) {
+            sim_fail("rename should have failed");
+        }
+        return;
+    }
+    if (r != 0) {
+        sim_fail("rename failed");
+        return;
+    }
+    if (sim.path[b]) {
+        sim.path[b]->linked = false;
+        sim_file_put(sim.path[b]);
+    }
+    sim.path[b] = sim.path[a];
+    sim.path[a] = NULL;
+}
+
+static void sim_list(void)
+{
+    FS_DEVMAN_DIRENT *ent;
+    char dir[16];
+    bool seen[SIM_NAMES];
+    void *d;
+    int dn, i, n;
+
+    dn = sim_rand() % SIM_DIRS;
+    sprintf(dir, "ram:%s/", simDirs[dn]);
+    d = fs_devman_opendir(dir);
+    if (d == NULL) {
+        sim_fail("opendir failed");
+        return;
+    }
+    memset(seen, 0, sizeof(seen));
+    while ((ent = fs_devman_readdir(d)) != NULL) {
+        if (ent->flags & FS_DEVMAN_DIRENT_FLAG_DIR) {
+            continue;
+        }
+        if ((sscanf(ent->fname, "f%d.dat", &n) != 1) || (n < 0) ||
+            (n >= SIM_NAMES) || seen[n]) {
+            sim_fail("unexpected directory entry");
+            continue;
+        }
+        seen[n] = true;
+        i = dn * SIM_NAMES + n;
+        if ((sim.path[i] == NULL) || (ent->fsize != sim.path[i]->size)) {
+            sim_fail("directory entry");
+        }
+    }
+    fs_devman_closedir(d);
+    for (n = 0; n < SIM_NAMES; n++) {
+        if (sim.path[dn * SIM_NAMES + n] && !seen[n]) {
+            sim_fail("file missing from the directory");
+        }
+    }
+}
+
+static void sim_peek(void)
+{
+    char path[32];
+    const uint8_t *ptr;
+    size_t off, len;
+    int p;
+
+    p = sim_rand() % SIM_PATHS;
+    sim_path(path, p);
+    off = 0;
+    while (1) {
+        ptr = fs_dev_ramfs_peek(sim.fs, path, off, &len);
+        if (ptr == NULL) {
+            break;
+        }
+        if ((sim.path[p] == NULL) || (off + len > sim.path[p]->size) ||
+            memcmp(ptr, sim.path[p]->data + off, len)) {
+            sim_fail("peek data");
+            return;
+        }
+        off += len;
+    }
+    if (sim.path[p] && (off != sim.path[p]->size)) {
+        sim_fail("peek length");
+    }
+}
+
+static void sim_limit(void)
+{
+    FS_DEV_RAMFS *fs;
+    FS_DEVMAN_DEVICE_INFO *info;
+    const char *fname;
+    ssize_t n;
+    int fd;
+
+    fs = fs_dev_ramfs_create(8 * FS_DEV_RAMFS_CHUNK_SIZE);
+    fs_devman_register("lim:", fs_dev_ramfs_device(), fs);
+    info = fs_devman_getInfo("lim:/a", &fname, NULL);
+
+    fd = info->dev->fsd_open(fname, 0, ADI_WRITE | ADI_CREAT, info);
+    n = info->dev->fsd_write(fd, sim.buf, SIM_MAX_IO, info);
+    n += info->dev->fsd_write(fd, sim.buf, SIM_MAX_IO, info);
+    n += info->dev->fsd_write(fd, sim.buf, SIM_MAX_IO, info);
+    if ((n != 8 * FS_DEV_RAMFS_CHUNK_SIZE) ||
+        (fs_dev_ramfs_used(fs) != 8 * FS_DEV_RAMFS_CHUNK_SIZE)) {
+        sim_fail("volume limit");
+    }
+    info->dev->fsd_close(fd, info);
+    if ((info->dev->fsd_unlink(fname, info) != 0) ||
+        (fs_dev_ramfs_used(fs) != 0)) {
+        sim_fail("volume limit release");
+    }
+
+    fs_devman_unregister("lim:");
+    fs_dev_ramfs_destroy(fs);
+}
+
+static double sim_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((double)ts.tv_sec + (double)ts.tv_nsec * 1e-9);
+}
+
+/* Time 64 byte appends, with a read back through a second fd, as the
+ * file grows to 'mb' MB */
+static void sim_append_bench(unsigned mb)
+{
+    const char *fname;
+    FS_DEVMAN_DEVICE_INFO *info;
+    FS_DEV_RAMFS *fs;
+    size_t i, per;
+    double start, writeNs, readNs;
+    int wfd, rfd;
+    unsigned m;
+
+    fs = fs_dev_ramfs_create(0);
+    fs_devman_register("bench:", fs_dev_ramfs_device(), fs);
+    info = fs_devman_getInfo("bench:/log", &fname, NULL);
+    wfd = info->dev->fsd_open(fname, 0, ADI_APPEND | ADI_CREAT, info);
+    rfd = info->dev->fsd_open(fname, 0, ADI_READ, info);
+
+    per = (1024 * 1024) / 64;
+    printf("\n%-8s %12s %12s\n", "size MB", "append nS", "read nS");
+    for (m = 1; m <= mb; m++) {
+        start = sim_now();
+        for (i = 0; i < per; i++) {
+            info->dev->fsd_write(wfd, sim.buf, 64, info);
+        }
+        writeNs = (sim_now() - start) * 1e9 / per;
+        start = sim_now();
+        for (i = 0; i < per; i++) {
+            info->dev->fsd_read(rfd, sim.ref, 64, info);
+        }
+        readNs = (sim_now() - start) * 1e9 / per;
+        if ((m & (m - 1)) == 0) {
+            printf("%-8u %12.1f %12.1f\n", m, writeNs, readNs);
+        }
+    }
+
+    info->dev->fsd_close(rfd, info);
+    info->dev->fsd_close(wfd, info);
+    fs_devman_unregister("bench:");
+    fs_dev_ramfs_destroy(fs);
+}
+
+static void usage(void)
+{
+    printf("fs_dev_ramfs_sim [options]\n");
+    printf("  -n <steps>   Random operations (200000)\n");
+    printf("  -s <seed>    Random seed (1)\n");
+    printf("  -b <MB>      Append benchmark file size (64, 0 = skip)\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *fname;
+    uint32_t steps = 200000, seed = 1;
+    unsigned benchMb = 64;
+    unsigned op;
+    int c, i;
+
+    while ((c = getopt(argc, argv, "n:s:b:h")) != -1) {
+        switch (c) {
+            case 'n': steps = strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            case 'b': benchMb = strtoul(optarg, NULL, 0); break;
+            default: usage(); return(1);
+        }
+    }
+    rngState = seed ? seed : 1;
+
+    fs_devman_init();
+    sim.fs = fs_dev_ramfs_create(0);
+    fs_devman_register("ram:", fs_dev_ramfs_device(), sim.fs);
+    sim.info = fs_devman_getInfo("ram:/", &fname, NULL);
+    sim.dev = sim.info->dev;
+    for (i = 1; i < SIM_DIRS; i++) {
+        if (fs_dev_ramfs_mkdir(sim.fs, simDirs[i]) != 0) {
+            sim_fail("mkdir failed");
+        }
+    }
+    if (fs_dev_ramfs_mkdir(sim.fs, "/none/x") == 0) {
+        sim_fail("mkdir without a parent succeeded");
+    }
+
+    for (sim.step = 0; sim.step < steps; sim.step++) {
+        op = sim_rand() % 100;
+        if (op < 12) {
+            sim_open();
+        } else if (op < 22) {
+            sim_close();
+        } else if (op < 47) {
+            sim_write();
+        } else if (op < 72) {
+            sim_read();
+        } else if (op < 84) {
+            sim_seek();
+        } else if (op < 88) {
+            sim_unlink();
+        } else if (op < 92) {
+            sim_rename();
+        } else if (op < 96) {
+            sim_list();
+        } else {
+            sim_peek();
+        }
+        if (fs_dev_ramfs_used(sim.fs) != sim_used()) {
+            sim_fail("used bytes");
+            break;
+        }
+    }
+
+    /* Non-empty directories stay, empty ones go */
+    if (sim.dev->fsd_unlink("/tmp", sim.info) == 0) {
+        bool empty = true;
+        for (i = 0; i < SIM_NAMES; i++) {
+            if (sim.path[1 * SIM_NAMES + i]) {
+                empty = false;
+            }
+        }
+        if (!empty) {
+            sim_fail("unlink of a non-empty directory succeeded");
+        }
+    }
+
+    for (i = 0; i < FS_DEV_RAMFS_MAX_FDS; i++) {
+        if (sim.fd[i].file) {
+            sim.dev->fsd_close(i, sim.info);
+            sim.fd[i].file->openCount--;
+            sim_file_put(sim.fd[i].file);
+            sim.fd[i].file = NULL;
+        }
+    }
+    for (i = 0; i < SIM_PATHS; i++) {
+        if (sim.path[i]) {
+            sim.path[i]->linked = false;
+            sim_file_put(sim.path[i]);
+        }
+    }
+    fs_devman_unregister("ram:");
+    fs_dev_ramfs_destroy(sim.fs);
+
+    sim_limit();
+
+    printf("%u operations, %d failures\n", steps, sim.fails);
+
+    if (benchMb) {
+        sim_append_bench(benchMb);
+    }
+
+    return(sim.fails ? 2 : 0);
+}
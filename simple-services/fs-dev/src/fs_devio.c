@@ -9,7 +9,6 @@
  * software may not be used except as expressly authorized under the license.
  */
 
-#include <stdio.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
@@ -27,6 +26,7 @@
 #include "fs_devman_cfg.h"
 #include "fs_devman_priv.h"
 #include "fs_devman.h"
+#include "fs_devio.h"
 
 #ifndef FS_DEVIO_DEVICE
 #define FS_DEVIO_DEVICE     2000
@@ -40,14 +40,30 @@
 #define FS_DEVIO_FD_OFFSET  100
 #endif
 
+/* Dispatch record resolved once at open */
 typedef struct _FS_DEVIO_FD {
     bool open;
     int baseFd;
-    FS_DEVMAN_DEVICE_INFO *devInfo;
+    void *pdata;
+    int (*close)(int fd, void *pdata);
+    ssize_t (*read)(int fd, void *ptr, size_t len, void *pdata);
+    ssize_t (*write) (int fd, const void *ptr, size_t len, void *pdata);
+    off_t (*lseek)(int fd, off_t off, int whence, void *pdata);
 } FS_DEVIO_FD;
 
 static FS_DEVIO_FD DEVIO_FD[FS_DEVIO_MAX_FDS];
 
+static FS_DEVIO_FD *fs_devio_fd(int fd)
+{
+    fd -= FS_DEVIO_FD_OFFSET;
+
+    if ((fd < 0) || (fd >= FS_DEVIO_MAX_FDS) || !DEVIO_FD[fd].open) {
+        return(NULL);
+    }
+
+    return(&DEVIO_FD[fd]);
+}
+
 /***********************************************************************
  * Init
  ***********************************************************************/
@@ -64,6 +80,7 @@ static int _fs_devio_open(const char *name, int mode)
 {
     FS_DEVMAN_DEVICE_INFO *devInfo;
     FS_DEVMAN_RESULT result;
+    const FS_DEVMAN_DEVICE *dev;
     FS_DEVIO_FD *fdf;
     const char *fname;
     int baseFd;
@@ -74,6 +91,7 @@ static int _fs_devio_open(const char *name, int mode)
     if (!devInfo || !devInfo->dev->fsd_open) {
         return(-1);
     }
+    dev = devInfo->dev;
 
     fd = -1; fdf = NULL;
     for (i = 0; i < FS_DEVIO_MAX_FDS; i++) {
@@ -86,14 +104,18 @@ static int _fs_devio_open(const char *name, int mode)
         return(-1);
     }
 
-    baseFd = devInfo->dev->fsd_open(fname, 0, mode, devInfo);
+    baseFd = dev->fsd_open(fname, 0, mode, devInfo);
     if (baseFd < 0) {
         return(-1);
     }
 
-    fdf->open = true;
     fdf->baseFd = baseFd;
-    fdf->devInfo = devInfo;
+    fdf->pdata = devInfo;
+    fdf->close = dev->fsd_close;
+    fdf->read = dev->fsd_read;
+    fdf->write = dev->fsd_write;
+    fdf->lseek = dev->fsd_lseek;
+    fdf->open = true;
 
     return(fd + FS_DEVIO_FD_OFFSET);
 }
@@ -104,23 +126,15 @@ static int _fs_devio_open(const char *name, int mode)
 static int _fs_devio_close(int fd)
 {
     FS_DEVIO_FD *fdf;
-    FS_DEVMAN_DEVICE_INFO *devInfo;
-
-    fd -= FS_DEVIO_FD_OFFSET;
-
-    if ((fd < 0 || fd > FS_DEVIO_MAX_FDS)) {
-        return(-1);
-    }
 
-    fdf = &DEVIO_FD[fd];
-    devInfo = fdf->devInfo;
-    if (!devInfo->dev->fsd_close) {
+    fdf = fs_devio_fd(fd);
+    if (!fdf || !fdf->close) {
         return(-1);
     }
 
     fdf->open = false;
 
-    devInfo->dev->fsd_close(fdf->baseFd, devInfo);
+    fdf->close(fdf->baseFd, fdf->pdata);
 
     return(0);
 }
@@ -128,27 +142,60 @@ static int _fs_devio_close(int fd)
 /***********************************************************************
  * Read / Write
  ***********************************************************************/
-static int _fs_devio_read(int fd, unsigned char *buf, int size)
+static int fs_devio_xfer(FS_DEVIO_FD *fdf, bool write, void *buf, int size)
 {
-    FS_DEVIO_FD *fdf;
-    FS_DEVMAN_DEVICE_INFO *devInfo;
-    int readSize;
+    if (write) {
+        return(fdf->write(fdf->baseFd, buf, size, fdf->pdata));
+    }
+    return(fdf->read(fdf->baseFd, buf, size, fdf->pdata));
+}
 
-    fd -= FS_DEVIO_FD_OFFSET;
+static int fs_devio_xferv(int fd, bool write,
+    const FS_DEVIO_IOVEC *iov, int iovcnt)
+{
+    FS_DEVIO_FD *fdf;
+    int total;
+    int size;
+    int i;
 
-    if ((fd < 0 || fd > FS_DEVIO_MAX_FDS)) {
+    fdf = fs_devio_fd(fd);
+    if (!fdf || (write && !fdf->write) || (!write && !fdf->read)) {
         return(-1);
     }
 
-    fdf = &DEVIO_FD[fd];
-    devInfo = fdf->devInfo;
-    if (!devInfo->dev->fsd_read) {
-        return(-1);
+    /* Stop at the first error or short transfer */
+    total = 0;
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].len == 0) {
+            continue;
+        }
+        size = fs_devio_xfer(fdf, write, iov[i].base, iov[i].len);
+        if (size < 0) {
+            return((total > 0) ? total : -1);
+        }
+        total += size;
+        if (size < (int)iov[i].len) {
+            break;
+        }
     }
 
-    readSize = devInfo->dev->fsd_read(fdf->baseFd, buf, size, devInfo);
+    return(total);
+}
+
+/*
+ * The ARM libio device interface returns the number of bytes not
+ * transferred
+ */
+static int _fs_devio_read(int fd, unsigned char *buf, int size)
+{
+    FS_DEVIO_IOVEC iov = { buf, size };
+    int readSize;
+
+    readSize = fs_devio_xferv(fd, false, &iov, 1);
 #if defined(__ADSPARM__)
-    readSize = size - readSize;
+    if (readSize >= 0) {
+        readSize = size - readSize;
+    }
 #endif
 
     return(readSize);
@@ -156,25 +203,14 @@ static int _fs_devio_read(int fd, unsigned char *buf, int size)
 
 static int _fs_devio_write(int fd, unsigned char *buf, int size)
 {
-    FS_DEVIO_FD *fdf;
-    FS_DEVMAN_DEVICE_INFO *devInfo;
+    FS_DEVIO_IOVEC iov = { buf, size };
     int writeSize;
 
-    fd -= FS_DEVIO_FD_OFFSET;
-
-    if ((fd < 0 || fd > FS_DEVIO_MAX_FDS)) {
-        return(-1);
-    }
-
-    fdf = &DEVIO_FD[fd];
-    devInfo = fdf->devInfo;
-    if (!devInfo->dev->fsd_write) {
-        return(-1);
-    }
-
-    writeSize = devInfo->dev->fsd_write(fdf->baseFd, buf, size, devInfo);
+    writeSize = fs_devio_xferv(fd, true, &iov, 1);
 #if defined(__ADSPARM__)
-    writeSize = size - writeSize;
+    if (writeSize >= 0) {
+        writeSize = size - writeSize;
+    }
 #endif
 
     return(writeSize);
@@ -186,21 +222,13 @@ static int _fs_devio_write(int fd, unsigned char *buf, int size)
 static long _fs_devio_seek(int fd, long offset, int whence)
 {
     FS_DEVIO_FD *fdf;
-    FS_DEVMAN_DEVICE_INFO *devInfo;
-
-    fd -= FS_DEVIO_FD_OFFSET;
 
-    if ((fd < 0 || fd > FS_DEVIO_MAX_FDS)) {
+    fdf = fs_devio_fd(fd);
+    if (!fdf || !fdf->lseek) {
         return(-1);
     }
 
-    fdf = &DEVIO_FD[fd];
-    devInfo = fdf->devInfo;
-    if (!devInfo->dev->fsd_lseek) {
-        return(-1);
-    }
-
-    offset = devInfo->dev->fsd_lseek(fdf->baseFd, offset, whence, devInfo);
+    offset = fdf->lseek(fdf->baseFd, offset, whence, fdf->pdata);
 
     return(offset);
 }
@@ -355,3 +383,22 @@ void fs_devio_init(void)
     }
 }
 
+int fs_devio_open(const char *name, int mode)
+{
+    return(_fs_devio_open(name, mode));
+}
+
+int fs_devio_close(int fd)
+{
+    return(_fs_devio_close(fd));
+}
+
+int fs_devio_readv(int fd, const FS_DEVIO_IOVEC *iov, int iovcnt)
+{
+    return(fs_devio_xferv(fd, false, iov, iovcnt));
+}
+
+int fs_devio_writev(int fd, const FS_DEVIO_IOVEC *iov, int iovcnt)
+{
+    return(fs_devio_xferv(fd, true, iov, iovcnt));
+}
@@ -12,6 +12,29 @@
 #ifndef _fs_devio_h
 #define _fs_devio_h
 
+#include <stddef.h>
+
+typedef struct _FS_DEVIO_IOVEC {
+    void *base;
+    size_t len;
+} FS_DEVIO_IOVEC;
+
 void fs_devio_init(void);
 
+/*
+ * Direct file access bypassing stdio.  'mode' is a combination of the
+ * ADI_* flags in fs_dev_adi_modes.h.  The device and its handlers are
+ * resolved once at open.
+ */
+int fs_devio_open(const char *name, int mode);
+int fs_devio_close(int fd);
+
+/*
+ * Scatter/gather transfers.  Returns the total number of bytes
+ * transferred, stopping at the first short transfer, or -1 if nothing
+ * could be transferred.
+ */
+int fs_devio_readv(int fd, const FS_DEVIO_IOVEC *iov, int iovcnt);
+int fs_devio_writev(int fd, const FS_DEVIO_IOVEC *iov, int iovcnt);
+
 #endif
@@ -17,18 +17,67 @@
 #include "fs_devman_priv.h"
 #include "fs_devman.h"
 
+/* Volume hash table size, must be a power of 2 larger than the number
+ * of devices
+ */
+#ifndef FS_DEVMAN_HASH_SIZE
+#define FS_DEVMAN_HASH_SIZE   (2 * FS_DEVMAN_MAX_DEVICES)
+#endif
+
+#if (FS_DEVMAN_HASH_SIZE & (FS_DEVMAN_HASH_SIZE - 1)) || \
+    (FS_DEVMAN_HASH_SIZE <= FS_DEVMAN_MAX_DEVICES)
+#error FS_DEVMAN_HASH_SIZE must be a power of 2 larger than FS_DEVMAN_MAX_DEVICES
+#endif
+
 typedef struct _FS_DEVMAN_DEVICE_ENTRY {
     bool allocated;
     bool isDefault;
+    unsigned colonIdx;
+    uint32_t hash;
     FS_DEVMAN_DEVICE_INFO info;
 } FS_DEVMAN_DEVICE_ENTRY;
 
 static FS_DEVMAN_DEVICE_ENTRY deviceEntries[FS_DEVMAN_MAX_DEVICES];
 static unsigned numDevices;
 
+/* Open addressed table of deviceEntries index + 1, 0 = empty */
+static uint8_t deviceHash[FS_DEVMAN_HASH_SIZE];
+
+/* FNV-1a hash of a volume name up to, but not including, the ':' */
+static uint32_t fs_devman_hash(const char *name, unsigned len)
+{
+    uint32_t hash = 2166136261u;
+    while (len--) {
+        hash = (hash ^ (uint8_t)*name++) * 16777619u;
+    }
+    return(hash);
+}
+
+static void fs_devman_hash_insert(unsigned idx)
+{
+    unsigned slot = deviceEntries[idx].hash & (FS_DEVMAN_HASH_SIZE - 1);
+    while (deviceHash[slot]) {
+        slot = (slot + 1) & (FS_DEVMAN_HASH_SIZE - 1);
+    }
+    deviceHash[slot] = idx + 1;
+}
+
+static void fs_devman_hash_rebuild(void)
+{
+    unsigned i;
+
+    memset(deviceHash, 0, sizeof(deviceHash));
+    for (i = 0; i < FS_DEVMAN_MAX_DEVICES; i++) {
+        if (deviceEntries[i].allocated) {
+            fs_devman_hash_insert(i);
+        }
+    }
+}
+
 FS_DEVMAN_RESULT fs_devman_init(void)
 {
     memset(deviceEntries, 0, sizeof(deviceEntries));
+    memset(deviceHash, 0, sizeof(deviceHash));
     numDevices = 0;
     return(FS_DEVMAN_OK);
 }
@@ -58,6 +107,9 @@ FS_DEVMAN_RESULT fs_devman_register(const char *name,
 
     if (entry) {
         entry->allocated = true;
+        entry->colonIdx = strlen(name) - 1;
+        entry->hash = fs_devman_hash(name, entry->colonIdx);
+        fs_devman_hash_insert(entry - deviceEntries);
         entry->info.name = name;
         entry->info.dev = dev;
         entry->info.usr = usr;
@@ -76,6 +128,8 @@ static FS_DEVMAN_DEVICE_ENTRY *fs_devman_find(
 {
     FS_DEVMAN_DEVICE_ENTRY *entry = NULL;
     unsigned colonIdx;
+    unsigned slot;
+    uint32_t hash;
     int i;
 
     if (name == NULL) {
@@ -83,26 +137,27 @@ static FS_DEVMAN_DEVICE_ENTRY *fs_devman_find(
     }
 
     /* Find a matching device */
-    for (i = 0; i < FS_DEVMAN_MAX_DEVICES; i++) {
-        entry = &deviceEntries[i];
-        if (entry->allocated) {
-            colonIdx = strlen(entry->info.name) - 1;
-            if ( (strncmp(name, entry->info.name, colonIdx) == 0) &&
-                 (entry->info.name[colonIdx] == ':') ) {
+    colonIdx = strcspn(name, ":");
+    if (name[colonIdx] == ':') {
+        hash = fs_devman_hash(name, colonIdx);
+        slot = hash & (FS_DEVMAN_HASH_SIZE - 1);
+        while (deviceHash[slot]) {
+            entry = &deviceEntries[deviceHash[slot] - 1];
+            if ( (entry->hash == hash) && (entry->colonIdx == colonIdx) &&
+                 (strncmp(name, entry->info.name, colonIdx) == 0) ) {
                 if (fname) {
                     *fname = &name[colonIdx + 1];
                 }
                 return(entry);
             }
+            slot = (slot + 1) & (FS_DEVMAN_HASH_SIZE - 1);
         }
+        /* Must not have a volume prefix for the default device */
+        return(NULL);
     }
 
     /* Search for the default device if no match */
     if (defaultOk) {
-        /* Must not have a volume prefix at all */
-        if (strchr(name, ':') != NULL) {
-            return(NULL);
-        }
         /* Search for the default volume */
         for (i = 0; i < FS_DEVMAN_MAX_DEVICES; i++) {
             entry = &deviceEntries[i];
@@ -126,6 +181,7 @@ FS_DEVMAN_RESULT fs_devman_unregister(const char *name)
     entry = fs_devman_find(name, NULL, false);
     if (entry) {
         memset(entry, 0, sizeof(*entry));
+        fs_devman_hash_rebuild();
         numDevices--;
         result = FS_DEVMAN_OK;
     }
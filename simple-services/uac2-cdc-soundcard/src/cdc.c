@@ -10,6 +10,7 @@
  */
 
 #include <stddef.h>
+#include <stdbool.h>
 #include "cdc.h"
 
 CDC_TX_COMPLETE_CALLBACK txCB = NULL;
@@ -19,6 +20,11 @@ CDC_RX_COMPLETE_CALLBACK rxCB = NULL;
 void *rxUsrPtr = NULL;
 unsigned short cdc_rx_bytes;
 
+CDC_RX_BUFFER_CALLBACK rxBufferCB = NULL;
+void *rxBufferUsrPtr = NULL;
+unsigned char *cdc_rx_ptr;
+volatile bool cdc_rx_paused = false;
+
 /**
  * Buffer used to store the received serial data.
  */
@@ -68,7 +74,7 @@ CLD_USB_Data_Received_Return_Type
 cdc_serial_data_rx_transfer_complete(void)
 {
     if (rxCB) {
-        rxCB(cdc_rx_buffer, cdc_rx_bytes, rxUsrPtr);
+        rxCB(cdc_rx_ptr, cdc_rx_bytes, rxUsrPtr);
     }
     return CLD_USB_DATA_GOOD;
 }
@@ -76,7 +82,19 @@ cdc_serial_data_rx_transfer_complete(void)
 CLD_USB_Transfer_Request_Return_Type
 cdc_serial_data_received(CLD_USB_Transfer_Params *p_transfer_data)
 {
-    p_transfer_data->p_data_buffer = cdc_rx_buffer;
+    /* Receive straight into the user's buffer if one is offered,
+     * NAK the host until one is free otherwise.
+     */
+    if (rxBufferCB) {
+        cdc_rx_ptr = rxBufferCB(p_transfer_data->num_bytes, rxBufferUsrPtr);
+        if (cdc_rx_ptr == NULL) {
+            cdc_rx_paused = true;
+            return CLD_USB_TRANSFER_PAUSE;
+        }
+    } else {
+        cdc_rx_ptr = cdc_rx_buffer;
+    }
+    p_transfer_data->p_data_buffer = cdc_rx_ptr;
     p_transfer_data->callback.fp_usb_out_transfer_complete = cdc_serial_data_rx_transfer_complete;
     p_transfer_data->fp_transfer_aborted_callback = CLD_NULL;
     p_transfer_data->transfer_timeout_ms = 0;
@@ -164,3 +182,17 @@ void cdc_register_rx_callback(CDC_RX_COMPLETE_CALLBACK cb, void *usrPtr)
     rxCB = cb;
     rxUsrPtr = usrPtr;
 }
+
+void cdc_register_rx_buffer_callback(CDC_RX_BUFFER_CALLBACK cb, void *usrPtr)
+{
+    rxBufferCB = cb;
+    rxBufferUsrPtr = usrPtr;
+}
+
+void cdc_rx_resume(void)
+{
+    if (cdc_rx_paused) {
+        cdc_rx_paused = false;
+        cld_sc58x_audio_2_0_w_cdc_lib_resume_paused_serial_data_transfer();
+    }
+}
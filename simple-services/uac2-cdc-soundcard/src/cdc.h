@@ -70,11 +70,20 @@ typedef void (*CDC_TX_COMPLETE_CALLBACK)(CDC_TX_STATUS status, void *usrPtr);
 typedef void (*CDC_RX_COMPLETE_CALLBACK)(unsigned char *p_buffer,
     unsigned short length, void *usrPtr);
 
+/* Returns the buffer for the next 'length' byte OUT transfer, or NULL
+ * to NAK the host until cdc_rx_resume() is called.  Called from the
+ * USB interrupt.
+ */
+typedef unsigned char *(*CDC_RX_BUFFER_CALLBACK)(unsigned short length,
+    void *usrPtr);
+
 CLD_USB_Data_Transmit_Return_Type cdc_tx_serial_data(unsigned short length,
     unsigned char *p_buffer, unsigned timeout);
 
 void cdc_register_tx_callback(CDC_TX_COMPLETE_CALLBACK cb, void *usrPtr);
 void cdc_register_rx_callback(CDC_RX_COMPLETE_CALLBACK cb, void *usrPtr);
+void cdc_register_rx_buffer_callback(CDC_RX_BUFFER_CALLBACK cb, void *usrPtr);
+void cdc_rx_resume(void);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -34,6 +34,8 @@
         CLD_SC57x_CDC_LINE_CODING_PARITY_NONE
     #define cld_sc58x_cdc_lib_transmit_serial_data \
         cld_sc57x_cdc_lib_transmit_serial_data
+    #define cld_sc58x_audio_2_0_w_cdc_lib_resume_paused_serial_data_transfer \
+        cld_sc57x_audio_2_0_w_cdc_lib_resume_paused_serial_data_transfer
 
     /* UAC2 macros */
     #define CLD_SC58x_Audio_2_0_Audio_Stream_Data_Endpoint_Descriptor \
@@ -43,4 +43,23 @@
 #define UAC2_L2_FREE_ALIGNED(x)  \
     umm_free_heap_aligned(UAC2_L2_HEAP, x)
 
+/* Allocate the USB audio rings from the uncached SDRAM heap */
+#define UAC2_RING_MALLOC_ALIGNED(x)  \
+    umm_malloc_heap_aligned(UAC2_HEAP, x, sizeof(uint32_t))
+
+#define UAC2_RING_FREE_ALIGNED(x)  \
+    umm_free_heap_aligned(UAC2_HEAP, x)
+
+/* Maintain buffer-track fill levels for the USB audio rings */
+#ifndef UAC2_BUFFER_TRACK
+#define UAC2_BUFFER_TRACK  0
+#endif
+
+/* Internal rate feedback engine measurement gate and filter
+ * coefficient (1 / 2^shift).  SOFs are timestamped by a 125uS poll so
+ * each gate has up to 250uS of timing error which the filter averages.
+ */
+#define UAC2_FEEDBACK_GATE_MS       512
+#define UAC2_FEEDBACK_FILTER_SHIFT  5
+
 #endif
@@ -95,7 +95,7 @@ uac2_feature_unit_descriptor *newFeatureUnitDescriptor (
 }
 
 uac2_clock_source_descriptor *newClockSourceDescriptor (
-    uint8_t bClockID
+    uint8_t bClockID, bool programmable
 )
 {
     uac2_clock_source_descriptor *cs;
@@ -107,9 +107,16 @@ uac2_clock_source_descriptor *newClockSourceDescriptor (
     cs->bDescriptorSubtype = UAC_CLOCK_SOURCE;
     cs->bClockID = bClockID;
 
+    /* Let the host select the rate if more than one is supported */
+    if (programmable) {
+        cs->bmAttributes = UAC_CLOCK_SOURCE_TYPE_INT_PROG;
+        cs->bmControls = UAC_CLOCK_SOURCE_CONTROL_PROG;
+    } else {
+        cs->bmAttributes = UAC_CLOCK_SOURCE_TYPE_INT_FIXED;
+        cs->bmControls = UAC_CLOCK_SOURCE_CONTROL_READ_ONLY;
+    }
+
     /* Fixed / Unsuported values */
-    cs->bmAttributes = UAC_CLOCK_SOURCE_TYPE_INT_FIXED;
-    cs->bmControls = UAC_CLOCK_SOURCE_CONTROL_READ_ONLY;
     cs->bAssocTerminal = 0;
     cs->iClockSource = 0;
 
@@ -237,6 +244,52 @@ uint16_t calcMaxPktSize(uint16_t maxPktSize, uint16_t pktRate,
     return(pktSize);
 }
 
+/* Calculate the min/max packet sizes for a sample rate on an endpoint
+ * whose bInterval has already been fixed by calcMaxPktSize() at the
+ * highest supported sample rate.
+ */
+uint16_t calcPktSize(uint32_t sampleRate, uint16_t pktRate,
+    uint8_t bInterval, uint16_t frameSize, uint16_t *minPktSize)
+{
+    uint16_t pktSize;
+
+    if (bInterval == 0) {
+        bInterval = 1;
+    }
+
+    pktSize = (sampleRate / pktRate) * frameSize * (1 << (bInterval - 1));
+    pktSize += frameSize;
+
+    if (minPktSize) {
+        *minPktSize = pktSize - 2 * frameSize;
+    }
+
+    return(pktSize);
+}
+
+/* Fill in a clock source range response with one sub-range per rate.
+ * Returns the number of valid bytes in the response.
+ */
+uint16_t fillSampleRateRange(uac2_sample_rate_range_parameter_block *range,
+    const uint32_t *rates, uint8_t numRates)
+{
+    uint8_t i;
+
+    if (numRates > UAC2_MAX_SAMPLE_RATES) {
+        numRates = UAC2_MAX_SAMPLE_RATES;
+    }
+
+    range->wNumSubRanges = numRates;
+    for (i = 0; i < numRates; i++) {
+        range->sub_ranges[i].wMIN = rates[i];
+        range->sub_ranges[i].wMAX = rates[i];
+        range->sub_ranges[i].wRES = 0;
+    }
+
+    return(sizeof(range->wNumSubRanges) +
+        numRates * sizeof(range->sub_ranges[0]));
+}
+
 CLD_SC58x_Audio_2_0_Stream_Interface_Params *newStreamInterfaceParams(
     uint8_t endpointNumber, uint8_t bTerminalID,
     uint16_t *minPacketSizeFull, uint16_t *maxPacketSizeFull,
@@ -38,9 +38,19 @@
 
 /* Clock source types */
 #define UAC_CLOCK_SOURCE_TYPE_INT_FIXED     0x01
+#define UAC_CLOCK_SOURCE_TYPE_INT_PROG      0x03
 
 /* Clock source controls */
 #define UAC_CLOCK_SOURCE_CONTROL_READ_ONLY  0x01
+#define UAC_CLOCK_SOURCE_CONTROL_PROG       0x03
+
+/* Clock source control selectors */
+#define UAC_CS_SAM_FREQ_CONTROL             0x01
+
+/* Maximum number of discrete sample rates advertised by a clock source */
+#ifndef UAC2_MAX_SAMPLE_RATES
+#define UAC2_MAX_SAMPLE_RATES               8
+#endif
 
 /* Audio Class Specific Interface Descriptor Subtypes */
 #define UAC_FORMAT_TYPE                     0x02
@@ -123,6 +133,16 @@ typedef struct {
     } sub_ranges[1];
 } uac2_4_byte_control_range_parameter_block;
 
+/* Structure used to report a list of discrete sample rates */
+typedef struct {
+    uint16_t  wNumSubRanges;
+    struct {
+        uint32_t   wMIN;
+        uint32_t   wMAX;
+        uint32_t   wRES;
+    } sub_ranges[UAC2_MAX_SAMPLE_RATES];
+} uac2_sample_rate_range_parameter_block;
+
 /* Structure used to report 16-bit USB Audio 2.0 range values */
 typedef struct
 {
@@ -169,7 +189,7 @@ uac2_feature_unit_descriptor *newFeatureUnitDescriptor (
 );
 
 uac2_clock_source_descriptor *newClockSourceDescriptor (
-    uint8_t bClockID
+    uint8_t bClockID, bool programmable
 );
 
 uac2_format_type_i_descriptor *newFormatTypeIDescriptor (
@@ -194,6 +214,16 @@ CLD_SC58x_Audio_2_0_Rate_Feedback_Params *newRateFeedbackParams(
     uint32_t updateMs
 );
 
+uint16_t calcPktSize(
+    uint32_t sampleRate, uint16_t pktRate, uint8_t bInterval,
+    uint16_t frameSize, uint16_t *minPktSize
+);
+
+uint16_t fillSampleRateRange(
+    uac2_sample_rate_range_parameter_block *range,
+    const uint32_t *rates, uint8_t numRates
+);
+
 void freeStreamInterfaceParams(
     CLD_SC58x_Audio_2_0_Stream_Interface_Params *p
 );
@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#include <string.h>
+
+#include "uac2_feedback.h"
+
+#define UAC2_FEEDBACK_FRAME_MASK  (0x07FF)
+
+void uac2FeedbackReset(UAC2_FEEDBACK *fb)
+{
+    memset(fb->audio, 0, sizeof(fb->audio));
+    fb->audioIdx = 0;
+    fb->audioEvents = 0;
+    fb->audioFrames = 0;
+    fb->frameValid = false;
+    fb->frame = 0;
+    fb->gateValid = false;
+    fb->gateStartQ16 = 0;
+    fb->gateSofCount = 0;
+    fb->valid = false;
+    fb->measuredQ32 = fb->nominalQ32;
+    fb->filteredQ32 = fb->nominalQ32;
+}
+
+void uac2FeedbackInit(UAC2_FEEDBACK *fb, UAC2_FEEDBACK_GET_TIME getTime,
+    uint32_t sampleRate, bool highSpeed, uint32_t gateMs,
+    uint8_t filterShift)
+{
+    fb->getTime = getTime;
+    fb->sofRate = highSpeed ? 8000 : 1000;
+    fb->gateSofs = (gateMs * fb->sofRate) / 1000;
+    if (fb->gateSofs == 0) {
+        fb->gateSofs = 1;
+    }
+    fb->filterShift = filterShift;
+    fb->nominalQ32 = ((uint64_t)sampleRate << 32) / fb->sofRate;
+
+    uac2FeedbackReset(fb);
+}
+
+void uac2FeedbackAudioEventTs(UAC2_FEEDBACK *fb, uint32_t frames,
+    uint32_t timeStamp)
+{
+    UAC2_FEEDBACK_AUDIO *cur;
+    UAC2_FEEDBACK_AUDIO *next;
+    uint32_t elapsed;
+
+    cur = &fb->audio[fb->audioIdx];
+    next = &fb->audio[fb->audioIdx ^ 1];
+
+    fb->audioFrames += frames;
+    next->framesQ16 = (uint64_t)fb->audioFrames << 16;
+    next->time = timeStamp;
+    next->framesPerTickQ32 = cur->framesPerTickQ32;
+
+    /* Local audio rate, only used to interpolate between events */
+    elapsed = timeStamp - cur->time;
+    if ((fb->audioEvents > 0) && elapsed) {
+        next->framesPerTickQ32 = ((uint64_t)frames << 32) / elapsed;
+    }
+    if (fb->audioEvents < 2) {
+        fb->audioEvents++;
+    }
+
+    /* Publish the new snapshot to the reference side */
+    fb->audioIdx ^= 1;
+}
+
+void uac2FeedbackAudioEvent(UAC2_FEEDBACK *fb, uint32_t frames)
+{
+    uac2FeedbackAudioEventTs(fb, frames, fb->getTime());
+}
+
+void uac2FeedbackRefEventTs(UAC2_FEEDBACK *fb, uint32_t sofs,
+    uint32_t timeStamp)
+{
+    UAC2_FEEDBACK_AUDIO *a;
+    uint64_t framesQ16;
+    uint64_t measQ32;
+    uint32_t elapsed;
+
+    /* Need two audio events for a local rate */
+    if (fb->audioEvents < 2) {
+        return;
+    }
+
+    /* Audio frame count interpolated to this reference event.  An audio
+     * event may be published after the reference event was timestamped.
+     */
+    a = &fb->audio[fb->audioIdx];
+    elapsed = timeStamp - a->time;
+    if ((int32_t)elapsed >= 0) {
+        framesQ16 = a->framesQ16 +
+            (((uint64_t)elapsed * a->framesPerTickQ32) >> 16);
+    } else {
+        framesQ16 = a->framesQ16 -
+            (((uint64_t)(a->time - timeStamp) * a->framesPerTickQ32) >> 16);
+    }
+
+    if (!fb->gateValid) {
+        fb->gateStartQ16 = framesQ16;
+        fb->gateSofCount = 0;
+        fb->gateValid = true;
+        return;
+    }
+
+    fb->gateSofCount += sofs;
+    if (fb->gateSofCount < fb->gateSofs) {
+        return;
+    }
+
+    /* Frames per (micro)frame over the gate */
+    measQ32 = ((framesQ16 - fb->gateStartQ16) << 16) / fb->gateSofCount;
+    fb->measuredQ32 = measQ32;
+
+    if (fb->valid) {
+        if (measQ32 >= fb->filteredQ32) {
+            fb->filteredQ32 += (measQ32 - fb->filteredQ32) >> fb->filterShift;
+        } else {
+            fb->filteredQ32 -= (fb->filteredQ32 - measQ32) >> fb->filterShift;
+        }
+    } else {
+        fb->filteredQ32 = measQ32;
+        fb->valid = true;
+    }
+
+    fb->gateStartQ16 = framesQ16;
+    fb->gateSofCount = 0;
+}
+
+void uac2FeedbackRefEvent(UAC2_FEEDBACK *fb, uint32_t sofs)
+{
+    uac2FeedbackRefEventTs(fb, sofs, fb->getTime());
+}
+
+void uac2FeedbackSofFrameTs(UAC2_FEEDBACK *fb, uint16_t frame,
+    uint32_t timeStamp)
+{
+    uint16_t frames;
+
+    frame &= UAC2_FEEDBACK_FRAME_MASK;
+    if (!fb->frameValid) {
+        fb->frame = frame;
+        fb->frameValid = true;
+        return;
+    }
+
+    frames = (frame - fb->frame) & UAC2_FEEDBACK_FRAME_MASK;
+    if (frames == 0) {
+        return;
+    }
+    fb->frame = frame;
+
+    /* The frame number counts 1mS frames at both bus speeds */
+    uac2FeedbackRefEventTs(fb, frames * (fb->sofRate / 1000), timeStamp);
+}
+
+void uac2FeedbackSofFrame(UAC2_FEEDBACK *fb, uint16_t frame)
+{
+    uac2FeedbackSofFrameTs(fb, frame, fb->getTime());
+}
+
+bool uac2FeedbackValid(UAC2_FEEDBACK *fb)
+{
+    return(fb->valid);
+}
+
+float uac2FeedbackGetKHz(UAC2_FEEDBACK *fb)
+{
+    double hz;
+
+    hz = ((double)fb->filteredQ32 * (double)fb->sofRate) / 4294967296.0;
+
+    return((float)(hz / 1000.0));
+}
+
+uint32_t uac2FeedbackGetWire(UAC2_FEEDBACK *fb)
+{
+    uint32_t wire;
+
+    if (fb->sofRate == 8000) {
+        wire = (uint32_t)((fb->filteredQ32 + (1ULL << 15)) >> 16);
+    } else {
+        wire = (uint32_t)((fb->filteredQ32 + (1ULL << 17)) >> 18);
+    }
+
+    return(wire);
+}
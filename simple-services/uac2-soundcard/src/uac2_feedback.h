@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#ifndef _uac2_feedback_h
+#define _uac2_feedback_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * UAC2 asynchronous rate feedback engine.
+ *
+ * The engine measures the number of audio frames consumed per USB
+ * (micro)frame.  Audio clock events (frames consumed by the codec side)
+ * and USB reference events (changes of the USB frame number, which
+ * follow the host's SOF) are both timestamped with the same timer.  The audio frame count
+ * is interpolated to the instant of each reference event so the result
+ * is independent of the timer's accuracy and resolution.  Measurements
+ * are taken over a gate of 'gateSofs' (micro)frames and smoothed with a
+ * first order filter.
+ *
+ * The engine has no hardware dependencies.
+ */
+
+/* Function returning a free running timestamp shared by all events */
+typedef uint32_t (*UAC2_FEEDBACK_GET_TIME)(void);
+
+typedef struct {
+    uint64_t framesQ16;             /* Audio frame count (Q16) */
+    uint32_t time;                  /* Time of the last audio event */
+    uint64_t framesPerTickQ32;      /* Audio frames per timer tick (Q32) */
+} UAC2_FEEDBACK_AUDIO;
+
+typedef struct {
+    UAC2_FEEDBACK_GET_TIME getTime;
+    uint32_t sofRate;               /* (Micro)frames per second */
+    uint32_t gateSofs;              /* (Micro)frames per measurement */
+    uint8_t filterShift;            /* Filter coefficient (1 / 2^shift) */
+
+    /* Audio clock side (double buffered for the reference side) */
+    UAC2_FEEDBACK_AUDIO audio[2];
+    volatile uint8_t audioIdx;
+    uint8_t audioEvents;
+    uint32_t audioFrames;
+
+    /* Reference side */
+    bool frameValid;
+    uint16_t frame;                 /* Last USB frame number */
+    bool gateValid;
+    uint64_t gateStartQ16;
+    uint32_t gateSofCount;
+
+    /* Frames per (micro)frame (Q32) */
+    bool valid;
+    uint64_t nominalQ32;
+    uint64_t measuredQ32;
+    uint64_t filteredQ32;
+} UAC2_FEEDBACK;
+
+/* Initializes (or re-initializes) the feedback engine for a nominal
+ * sample rate and USB bus speed.
+ */
+void uac2FeedbackInit(UAC2_FEEDBACK *fb, UAC2_FEEDBACK_GET_TIME getTime,
+    uint32_t sampleRate, bool highSpeed, uint32_t gateMs,
+    uint8_t filterShift);
+
+/* Restarts the measurement, keeping the configuration */
+void uac2FeedbackReset(UAC2_FEEDBACK *fb);
+
+/* Called each time 'frames' audio frames have been consumed by the
+ * audio clock domain (i.e. every SPORT DMA block).
+ */
+void uac2FeedbackAudioEvent(UAC2_FEEDBACK *fb, uint32_t frames);
+void uac2FeedbackAudioEventTs(UAC2_FEEDBACK *fb, uint32_t frames,
+    uint32_t timeStamp);
+
+/* Called for each USB reference event spanning 'sofs' (micro)frames */
+void uac2FeedbackRefEvent(UAC2_FEEDBACK *fb, uint32_t sofs);
+void uac2FeedbackRefEventTs(UAC2_FEEDBACK *fb, uint32_t sofs,
+    uint32_t timeStamp);
+
+/* Called periodically (at least once per millisecond) with the 11-bit
+ * USB frame number.  Each change of the frame number is a reference
+ * event spanning the (micro)frames elapsed since the previous change.
+ */
+void uac2FeedbackSofFrame(UAC2_FEEDBACK *fb, uint16_t frame);
+void uac2FeedbackSofFrameTs(UAC2_FEEDBACK *fb, uint16_t frame,
+    uint32_t timeStamp);
+
+/* Returns true once a measured feedback value is available */
+bool uac2FeedbackValid(UAC2_FEEDBACK *fb);
+
+/* Returns the filtered feedback in the units required by the CLD
+ * library (kHz)
+ */
+float uac2FeedbackGetKHz(UAC2_FEEDBACK *fb);
+
+/* Returns the filtered feedback as frames per (micro)frame in the USB
+ * wire format (16.16 for high speed, 10.14 for full speed)
+ */
+uint32_t uac2FeedbackGetWire(UAC2_FEEDBACK *fb);
+
+#endif
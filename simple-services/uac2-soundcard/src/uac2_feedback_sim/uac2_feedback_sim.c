@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host convergence harness for the UAC2 rate feedback engine.
+ *
+ * Three clocks are modelled against the host's SOF clock: the audio clock
+ * ('-a' ppm), the local crystal driving the timestamp counter and the
+ * 125uS SOF poll timer ('-c' ppm), and the USB frame number which
+ * advances every 1mS of host time.  Audio block and timer interrupts are
+ * delayed by a random latency of up to '-j' uS.
+ *
+ * The feedback value is sampled every 10mS and compared against the true
+ * audio rate seen by the host.  The drift is the peak to peak number of
+ * frames the device buffer would wander over the second half of the run
+ * if the host followed the feedback exactly.
+ *
+ * Build from the 'src' directory with:
+ *   gcc -O2 -I. -o uac2_feedback_sim uac2_feedback_sim/uac2_feedback_sim.c \
+ *       uac2_feedback.c -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "uac2_feedback.h"
+
+#define SIM_TIMER_HZ        500000000.0
+#define SIM_POLL_PERIOD     125e-6
+#define SIM_SAMPLE_PERIOD   10e-3
+
+typedef struct {
+    uint32_t sampleRate;
+    bool highSpeed;
+    double audioPpm;
+    double cpuPpm;
+    double jitterUs;
+    uint32_t blockFrames;
+    double seconds;
+    uint32_t gateMs;
+    uint8_t filterShift;
+    double settlePpm;
+    uint32_t seed;
+    bool verbose;
+} SIM_CFG;
+
+static uint32_t rngState;
+
+static double sim_rand(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return((double)rngState / 4294967296.0);
+}
+
+static uint32_t sim_timestamp(SIM_CFG *cfg, double t)
+{
+    double ticks;
+
+    ticks = t * SIM_TIMER_HZ * (1.0 + cfg->cpuPpm * 1e-6);
+    return((uint32_t)(uint64_t)ticks);
+}
+
+static void usage(void)
+{
+    printf("uac2_feedback_sim [options]\n");
+    printf("  -r <rate>    Nominal sample rate (48000)\n");
+    printf("  -a <ppm>     Audio clock offset from the host (100)\n");
+    printf("  -c <ppm>     Local crystal offset from the host (-30)\n");
+    printf("  -j <uS>      Max interrupt latency (5)\n");
+    printf("  -b <frames>  Audio block size (32)\n");
+    printf("  -t <secs>    Simulated time (120)\n");
+    printf("  -g <mS>      Measurement gate (512)\n");
+    printf("  -k <shift>   Filter shift (5)\n");
+    printf("  -e <ppm>     Settling tolerance (10)\n");
+    printf("  -s <seed>    Random seed (1)\n");
+    printf("  -f           Full speed (default high speed)\n");
+    printf("  -v           Print every sample\n");
+}
+
+int main(int argc, char **argv)
+{
+    SIM_CFG cfg = {
+        .sampleRate = 48000, .highSpeed = true, .audioPpm = 100.0,
+        .cpuPpm = -30.0, .jitterUs = 5.0, .blockFrames = 32,
+        .seconds = 120.0, .gateMs = 512, .filterShift = 5,
+        .settlePpm = 10.0, .seed = 1, .verbose = false
+    };
+    UAC2_FEEDBACK fb;
+    double trueRate, audioPeriod, pollPeriod;
+    double tAudio, tPoll, tSample, t;
+    uint64_t audioBlock, poll;
+    double errPpm, drift, minDrift, maxDrift, sumSq, maxErr;
+    double settled, lastBad;
+    uint32_t samples;
+    uint32_t wire, trueWire;
+    int c;
+
+    while ((c = getopt(argc, argv, "r:a:c:j:b:t:g:k:e:s:fvh")) != -1) {
+        switch (c) {
+            case 'r': cfg.sampleRate = strtoul(optarg, NULL, 0); break;
+            case 'a': cfg.audioPpm = atof(optarg); break;
+            case 'c': cfg.cpuPpm = atof(optarg); break;
+            case 'j': cfg.jitterUs = atof(optarg); break;
+            case 'b': cfg.blockFrames = strtoul(optarg, NULL, 0); break;
+            case 't': cfg.seconds = atof(optarg); break;
+            case 'g': cfg.gateMs = strtoul(optarg, NULL, 0); break;
+            case 'k': cfg.filterShift = strtoul(optarg, NULL, 0); break;
+            case 'e': cfg.settlePpm = atof(optarg); break;
+            case 's': cfg.seed = strtoul(optarg, NULL, 0); break;
+            case 'f': cfg.highSpeed = false; break;
+            case 'v': cfg.verbose = true; break;
+            default: usage(); return(1);
+        }
+    }
+    if ((cfg.blockFrames == 0) || (cfg.sampleRate == 0)) {
+        usage();
+        return(1);
+    }
+
+    rngState = cfg.seed ? cfg.seed : 1;
+
+    /* All times are in seconds of host (SOF) time */
+    trueRate = cfg.sampleRate * (1.0 + cfg.audioPpm * 1e-6);
+    audioPeriod = cfg.blockFrames / trueRate;
+    pollPeriod = SIM_POLL_PERIOD / (1.0 + cfg.cpuPpm * 1e-6);
+
+    uac2FeedbackInit(&fb, NULL, cfg.sampleRate, cfg.highSpeed,
+        cfg.gateMs, cfg.filterShift);
+
+    audioBlock = 1;
+    poll = 1;
+    tSample = SIM_SAMPLE_PERIOD;
+    drift = 0.0; minDrift = 0.0; maxDrift = 0.0; sumSq = 0.0; maxErr = 0.0;
+    settled = -1.0; lastBad = 0.0; samples = 0;
+
+    while (tSample <= cfg.seconds) {
+
+        tAudio = audioBlock * audioPeriod + sim_rand() * cfg.jitterUs * 1e-6;
+        tPoll = poll * pollPeriod + sim_rand() * cfg.jitterUs * 1e-6;
+
+        if ((tAudio <= tPoll) && (tAudio <= tSample)) {
+            uac2FeedbackAudioEventTs(&fb, cfg.blockFrames,
+                sim_timestamp(&cfg, tAudio));
+            audioBlock++;
+        } else if (tPoll <= tSample) {
+            t = tPoll;
+            uac2FeedbackSofFrameTs(&fb, (uint16_t)(uint64_t)(t / 1e-3),
+                sim_timestamp(&cfg, t));
+            poll++;
+        } else {
+            t = tSample;
+            if (uac2FeedbackValid(&fb)) {
+                errPpm = ((uac2FeedbackGetKHz(&fb) * 1000.0) / trueRate
+                    - 1.0) * 1e6;
+                drift += (uac2FeedbackGetKHz(&fb) * 1000.0 - trueRate) *
+                    SIM_SAMPLE_PERIOD;
+                if (fabs(errPpm) > cfg.settlePpm) {
+                    lastBad = t;
+                    settled = -1.0;
+                } else if (settled < 0.0) {
+                    settled = t;
+                }
+                if (t >= cfg.seconds / 2.0) {
+                    if (samples == 0) {
+                        minDrift = drift;
+                        maxDrift = drift;
+                    }
+                    sumSq += errPpm * errPpm;
+                    samples++;
+                    if (fabs(errPpm) > maxErr) {
+                        maxErr = fabs(errPpm);
+                    }
+                    if (drift < minDrift) {
+                        minDrift = drift;
+                    }
+                    if (drift > maxDrift) {
+                        maxDrift = drift;
+                    }
+                }
+                if (cfg.verbose) {
+                    printf("%8.3f %12.4f Hz %+10.3f ppm %+9.2f frames\n",
+                        t, uac2FeedbackGetKHz(&fb) * 1000.0, errPpm, drift);
+                }
+            }
+            tSample += SIM_SAMPLE_PERIOD;
+        }
+    }
+
+    trueWire = cfg.highSpeed ?
+        (uint32_t)llround(trueRate / 8000.0 * 65536.0) :
+        (uint32_t)llround(trueRate / 1000.0 * 16384.0);
+    wire = uac2FeedbackGetWire(&fb);
+
+    printf("True rate:        %.4f Hz\n", trueRate);
+    printf("Feedback:         %.4f Hz (wire 0x%08x, ideal 0x%08x)\n",
+        uac2FeedbackGetKHz(&fb) * 1000.0, wire, trueWire);
+    if ((settled >= 0.0) && samples) {
+        printf("Settled (%g ppm): %.2f s\n", cfg.settlePpm, settled);
+    } else {
+        printf("Settled (%g ppm): no (last outside at %.2f s)\n",
+            cfg.settlePpm, lastBad);
+    }
+    if (samples) {
+        printf("Second half:      %.3f ppm rms, %.3f ppm max, "
+            "%.2f frames drift\n",
+            sqrt(sumSq / samples), maxErr, maxDrift - minDrift);
+    }
+
+    return((settled >= 0.0) ? 0 : 2);
+}
@@ -24,6 +24,22 @@
 #include "cpu_load.h"
 #include "clocks.h"
 
+#ifndef UAC2_BUFFER_TRACK
+#define UAC2_BUFFER_TRACK  0
+#endif
+
+#if UAC2_BUFFER_TRACK
+#include "buffer_track.h"
+#endif
+
+#ifndef UAC2_FEEDBACK_GATE_MS
+#define UAC2_FEEDBACK_GATE_MS       512
+#endif
+
+#ifndef UAC2_FEEDBACK_FILTER_SHIFT
+#define UAC2_FEEDBACK_FILTER_SHIFT  5
+#endif
+
 /*
  * General Info:
  *
@@ -99,6 +115,13 @@ static CLD_USB_Transfer_Request_Return_Type uac2_get_req_cmd (
     CLD_USB_Transfer_Params * p_transfer_data
 );
 static CLD_USB_Data_Received_Return_Type uac2_set_volume_req (void);
+static CLD_USB_Data_Received_Return_Type uac2_set_sample_rate_req (void);
+static void uac2_update_pkt_sizes(void);
+static void uac2_rx_ring_commit(void);
+static uint16_t uac2_tx_ring_prepare(uint8_t **data);
+static void uac2_tx_ring_release(void);
+static void uac2_feedback_restart(void);
+static void uac2_feedback_sof_poll(void);
 static void uac2_streaming_rx_endpoint_enabled (CLD_Boolean enabled);
 static void uac2_streaming_tx_endpoint_enabled (CLD_Boolean enabled);
 static void uac2_usb_event (CLD_USB_Event event);
@@ -147,6 +170,10 @@ typedef struct
     UAC2_VOLUME speaker_output_volume;
     UAC2_VOLUME mic_input_volume;
     UAC2_CLOCK_SOURCE clock_source;
+    uint32_t pending_sample_rate;
+    uint32_t sampleRates[UAC2_MAX_SAMPLE_RATES];
+    uint8_t numSampleRates;
+    CLD_Boolean highSpeed;
 
     CLD_Boolean in_enabled;
     CLD_Boolean in_idle;
@@ -160,6 +187,9 @@ typedef struct
     uint16_t maxInSizeFull;
     uint16_t minInSizeHigh;
     uint16_t maxInSizeHigh;
+    uint16_t inFrameSize;
+    uint8_t inIntervalFull;
+    uint8_t inIntervalHigh;
 
     CLD_Boolean inPktFirst;
     uint32_t inPktLastTime;
@@ -176,6 +206,9 @@ typedef struct
     uint16_t maxOutSizeFull;
     uint16_t minOutSizeHigh;
     uint16_t maxOutSizeHigh;
+    uint16_t outFrameSize;
+    uint8_t outIntervalFull;
+    uint8_t outIntervalHigh;
 
     CLD_Boolean outPktFirst;
     uint32_t outPktLastTime;
@@ -184,6 +217,17 @@ typedef struct
 
     CLD_Boolean rate_feedback_idle;
     CLD_Boolean first_feedback;
+    volatile CLD_Boolean feedback_run;
+
+    /* Service owned USB audio rings */
+    PaUtilRingBuffer rxRing;
+    uint8_t *rxRingData;
+    CLD_Boolean out_in_ring;
+    PaUtilRingBuffer txRing;
+    uint8_t *txRingData;
+    uint32_t in_ring_frames;
+    uint32_t inFrameAccum;
+    uint32_t inFrameAccumNext;
 
     UAC2_APP_CONFIG cfg;
     ADI_TMR_HANDLE periodic_timer_handle;
@@ -205,6 +249,9 @@ typedef struct
 __attribute__ ((section(".l3_uncached_data")))
 static UAC2_STATE uac2_state;
 
+/* Rate feedback engine state is only touched by the CPU */
+static UAC2_FEEDBACK uac2_feedback;
+
 /*************************************************************************
  * USB Feedback Isochronous IN Endpoint functions and data
  *************************************************************************/
@@ -249,7 +296,12 @@ static void uac2_tx_feedback_data ( void )
          uac2_state.rate_feedback_idle == CLD_TRUE) {
         if (uac2_state.first_feedback == CLD_TRUE) {
             feedback_transfer_data.desired_data_rate =
-                (float)uac2_state.cfg.usbSampleRate / 1000.0f;
+                (float)uac2_state.clock_source.current / 1000.0f;
+        } else if (uac2_state.cfg.feedbackEngine) {
+            if (uac2FeedbackValid(&uac2_feedback)) {
+                feedback_transfer_data.desired_data_rate =
+                    uac2FeedbackGetKHz(&uac2_feedback);
+            }
         } else {
             if (uac2_state.cfg.rateFeedbackCallback) {
                 rate = uac2_state.cfg.rateFeedbackCallback(uac2_state.cfg.usrPtr);
@@ -306,6 +358,9 @@ static void uac2_audio_stream_data_transmitted (void)
         uac2_state.cfg.usbInStats->ok++;
     }
 
+    /* Return the transmitted frames to the IN ring */
+    uac2_tx_ring_release();
+
     /* Prepare next IN transfer */
     uac2_state.in_idle = CLD_TRUE;
     uac2_tx_audio_data();
@@ -378,6 +433,9 @@ static void uac2_audio_stream_data_transmit_aborted (void)
         *pREG_USB0_EP2_TXCSR_P |= BITM_USB_EP_TXCSR_P_FLUSHFIFO | w0cRegisters;
     }
 
+    /* The aborted frames are dropped */
+    uac2_tx_ring_release();
+
     uac2_state.in_idle = CLD_TRUE;
     uac2_tx_audio_data();
 
@@ -411,6 +469,7 @@ static void uac2_tx_audio_data (void)
 {
     static CLD_USB_Transfer_Params audio_data_tx_params;
     void *nextData;
+    uint8_t *inPkt;
 
     /* If the Isochronous IN endpoint is enabled and idle */
     if ((uac2_state.in_enabled == CLD_TRUE) &&
@@ -432,19 +491,23 @@ static void uac2_tx_audio_data (void)
                 uac2_state.in_idle = CLD_FALSE;
             }
         } else {
-            if (uac2_state.cfg.txCallback) {
+            inPkt = uac2_state.in_data;
+            if (uac2_state.txRingData) {
+                uac2_state.in_size = uac2_tx_ring_prepare(&inPkt);
+            } else if (uac2_state.cfg.txCallback) {
                 nextData = uac2_state.in_data;
                 uac2_state.in_size = uac2_state.cfg.txCallback(
                     uac2_state.in_data, &nextData, uac2_state.minInSize, uac2_state.maxInSize,
                     uac2_state.cfg.usrPtr
                 );
                 uac2_state.in_data = nextData;
+                inPkt = uac2_state.in_data;
             } else {
                 uac2_state.in_size = 0;
             }
             /* Queue the packet for transmission */
             audio_data_tx_params.num_bytes = uac2_state.in_size;
-            audio_data_tx_params.p_data_buffer = uac2_state.in_data;
+            audio_data_tx_params.p_data_buffer = inPkt;
             audio_data_tx_params.callback.fp_usb_in_transfer_complete =
                 uac2_audio_stream_data_transmitted;
             audio_data_tx_params.transfer_timeout_ms = 100;
@@ -453,7 +516,12 @@ static void uac2_tx_audio_data (void)
             if (cld_sc58x_audio_2_0_lib_transmit_audio_data(&audio_data_tx_params) == CLD_USB_TRANSMIT_SUCCESSFUL) {
                 uac2_state.in_idle = CLD_FALSE;
                 uac2_state.cfg.usbInStats->lastPktSize = uac2_state.in_size;
+                if (uac2_state.txRingData) {
+                    uac2_state.inFrameAccum = uac2_state.inFrameAccumNext;
+                }
             } else {
+                /* Leave the frames in the IN ring to send next time */
+                uac2_state.in_ring_frames = 0;
                 if (uac2_state.cfg.usbInStats) {
                     uac2_state.cfg.usbInStats->failed++;
                 }
@@ -509,7 +577,11 @@ static CLD_USB_Data_Received_Return_Type uac2_stream_data_receive_complete (void
         uac2_state.cfg.usbOutStats->count++;
     }
 
-    if (uac2_state.cfg.rxCallback) {
+    if (uac2_state.rxRingData) {
+        if (uac2_state.out_in_ring == CLD_TRUE) {
+            uac2_rx_ring_commit();
+        }
+    } else if (uac2_state.cfg.rxCallback) {
         nextData = uac2_state.out_data;
         uac2_state.cfg.rxCallback(
             uac2_state.out_data, &nextData, uac2_state.out_size, uac2_state.cfg.usrPtr
@@ -560,8 +632,30 @@ static CLD_USB_Data_Received_Return_Type uac2_stream_data_receive_complete (void
  */
 static CLD_USB_Transfer_Request_Return_Type uac2_stream_data_received (CLD_USB_Transfer_Params * p_transfer_data)
 {
+    ring_buffer_size_t frames, n1, n2;
+    void *p1, *p2;
+
     uac2_state.out_size = p_transfer_data->num_bytes;
     p_transfer_data->p_data_buffer = uac2_state.out_data;
+    uac2_state.out_in_ring = CLD_FALSE;
+
+    /* Receive directly into the OUT ring if the whole packet fits.  Any
+     * part of the packet past the end of the ring lands in the ring's
+     * overhang and is moved to the start of the ring on completion.
+     * Packets which don't fit are received into the packet buffer and
+     * dropped.
+     */
+    if (uac2_state.rxRingData) {
+        frames = uac2_state.out_size / uac2_state.outFrameSize;
+        if (PaUtil_GetRingBufferWriteAvailable(&uac2_state.rxRing) >= frames) {
+            PaUtil_GetRingBufferWriteRegions(&uac2_state.rxRing, frames,
+                &p1, &n1, &p2, &n2);
+            p_transfer_data->p_data_buffer = p1;
+            uac2_state.out_in_ring = CLD_TRUE;
+        } else if (uac2_state.cfg.usbOutStats) {
+            uac2_state.cfg.usbOutStats->failed++;
+        }
+    }
     p_transfer_data->transfer_timeout_ms = 0;
     p_transfer_data->fp_transfer_aborted_callback = CLD_NULL;
     p_transfer_data->callback.fp_usb_out_transfer_complete = uac2_stream_data_receive_complete;
@@ -569,6 +663,191 @@ static CLD_USB_Transfer_Request_Return_Type uac2_stream_data_received (CLD_USB_T
     return CLD_USB_TRANSFER_ACCEPT;
 }
 
+/*************************************************************************
+ * Service owned USB audio ring functions
+ *************************************************************************/
+
+/**
+ * Allocates a ring of 'frames' audio frames plus one max size USB packet
+ * of overhang so packets can always be transferred contiguously.
+ */
+static uint8_t *uac2_ring_alloc(PaUtilRingBuffer *ring, uint32_t frames,
+    uint16_t frameSize)
+{
+    uint8_t *data;
+
+    data = UAC2_RING_MALLOC_ALIGNED(frames * frameSize + USB_MAX_PACKET_SIZE);
+    if (data == NULL) {
+        return(NULL);
+    }
+
+    if (PaUtil_InitializeRingBuffer(ring, frameSize, frames, data) < 0) {
+        UAC2_RING_FREE_ALIGNED(data);
+        return(NULL);
+    }
+
+    return(data);
+}
+
+/**
+ * Commits a packet received directly into the OUT ring.
+ */
+static void uac2_rx_ring_commit(void)
+{
+    ring_buffer_size_t frames, n1, n2;
+    void *p1, *p2;
+
+    frames = uac2_state.out_size / uac2_state.outFrameSize;
+
+    /* Move any overhang to the start of the ring */
+    PaUtil_GetRingBufferWriteRegions(&uac2_state.rxRing, frames,
+        &p1, &n1, &p2, &n2);
+    if (n2) {
+        UAC2_MEMCPY(p2, (uint8_t *)p1 + n1 * uac2_state.outFrameSize,
+            n2 * uac2_state.outFrameSize);
+    }
+
+#if UAC2_BUFFER_TRACK
+    if (uac2_state.cfg.usbOutBufferTrack) {
+        bufferTrackAccum(uac2_state.cfg.usbOutBufferTrackIdx,
+            PaUtil_GetRingBufferReadAvailable(&uac2_state.rxRing));
+    }
+#endif
+
+    PaUtil_AdvanceRingBufferWriteIndex(&uac2_state.rxRing, frames);
+
+    if (uac2_state.cfg.ringCallback) {
+        uac2_state.cfg.ringCallback(UAC2_DIR_OUT, frames,
+            uac2_state.cfg.usrPtr);
+    }
+}
+
+/**
+ * Prepares the next IN packet directly from the IN ring.  Returns the
+ * packet size in bytes and the packet address through 'data'.
+ */
+static uint16_t uac2_tx_ring_prepare(uint8_t **data)
+{
+    ring_buffer_size_t frames, n1, n2, avail;
+    uint32_t pktRate, maxFrames, accum;
+    uint8_t interval;
+    void *p1, *p2;
+
+    if (uac2_state.highSpeed == CLD_TRUE) {
+        pktRate = 8000;
+        interval = uac2_state.inIntervalHigh;
+    } else {
+        pktRate = 1000;
+        interval = uac2_state.inIntervalFull;
+    }
+    if (interval == 0) {
+        interval = 1;
+    }
+
+    /* Nominal frames for this packet including the fractional part
+     * carried over from previous packets (i.e. 44.1kHz).  The carry is
+     * only kept once the packet is queued.
+     */
+    accum = uac2_state.inFrameAccum +
+        uac2_state.clock_source.current * (1 << (interval - 1));
+    frames = accum / pktRate;
+    uac2_state.inFrameAccumNext = accum - frames * pktRate;
+
+    /* Limit to the packet size and the available frames */
+    maxFrames = uac2_state.maxInSize / uac2_state.inFrameSize;
+    if (frames > maxFrames) {
+        frames = maxFrames;
+    }
+    avail = PaUtil_GetRingBufferReadAvailable(&uac2_state.txRing);
+    if (frames > avail) {
+        frames = avail;
+    }
+
+    /* Copy any wrapped frames into the overhang */
+    PaUtil_GetRingBufferReadRegions(&uac2_state.txRing, frames,
+        &p1, &n1, &p2, &n2);
+    if (n2) {
+        UAC2_MEMCPY((uint8_t *)p1 + n1 * uac2_state.inFrameSize, p2,
+            n2 * uac2_state.inFrameSize);
+    }
+
+    uac2_state.in_ring_frames = frames;
+    *data = p1;
+
+    return(frames * uac2_state.inFrameSize);
+}
+
+/**
+ * Returns the frames of the last IN packet to the IN ring.
+ */
+static void uac2_tx_ring_release(void)
+{
+    uint32_t frames;
+
+    frames = uac2_state.in_ring_frames;
+    if ((uac2_state.txRingData == NULL) || (frames == 0)) {
+        return;
+    }
+
+#if UAC2_BUFFER_TRACK
+    if (uac2_state.cfg.usbInBufferTrack) {
+        bufferTrackAccum(uac2_state.cfg.usbInBufferTrackIdx,
+            PaUtil_GetRingBufferReadAvailable(&uac2_state.txRing));
+    }
+#endif
+
+    PaUtil_AdvanceRingBufferReadIndex(&uac2_state.txRing, frames);
+    uac2_state.in_ring_frames = 0;
+
+    if (uac2_state.cfg.ringCallback) {
+        uac2_state.cfg.ringCallback(UAC2_DIR_IN, frames,
+            uac2_state.cfg.usrPtr);
+    }
+}
+
+/*************************************************************************
+ * Rate feedback engine functions
+ *************************************************************************/
+
+/**
+ * Restarts the feedback engine for the current sample rate and bus speed.
+ */
+static void uac2_feedback_restart(void)
+{
+    UAC2_FEEDBACK_GET_TIME getTime;
+
+    /* Keep the SOF poll out of the engine while it is reset */
+    uac2_state.feedback_run = CLD_FALSE;
+
+    if (!uac2_state.cfg.feedbackEngine) {
+        return;
+    }
+
+    getTime = uac2_state.cfg.feedbackGetTime;
+    if (getTime == NULL) {
+        getTime = cpuLoadGetTimeStamp;
+    }
+
+    uac2FeedbackInit(&uac2_feedback, getTime,
+        uac2_state.clock_source.current, uac2_state.highSpeed == CLD_TRUE,
+        UAC2_FEEDBACK_GATE_MS, UAC2_FEEDBACK_FILTER_SHIFT);
+
+    uac2_state.feedback_run = CLD_TRUE;
+}
+
+/**
+ * Reports the USB frame number to the feedback engine.  Called from the
+ * 125uS timer so each SOF is timestamped within 125uS.  The timer is
+ * not locked to the bus so the detection delay does not accumulate.
+ */
+static void uac2_feedback_sof_poll(void)
+{
+    if ((uac2_state.feedback_run == CLD_TRUE) &&
+        (uac2_state.out_enabled == CLD_TRUE)) {
+        uac2FeedbackSofFrame(&uac2_feedback, *pREG_USB0_FRAME);
+    }
+}
+
 /*************************************************************************
  * Volume / Mute control functions
  *************************************************************************/
@@ -587,6 +866,44 @@ static CLD_USB_Data_Received_Return_Type uac2_set_volume_req (void)
     return CLD_USB_DATA_GOOD;
 }
 
+/**
+ * This function is called by the CLD Audio library when a Set Sample Rate
+ * request data has been completed.
+ *
+ * @retval CLD_USB_DATA_GOOD - Received data is valid.
+ * @retval CLD_USB_DATA_BAD_STALL - Received data is invalid.
+ */
+static CLD_USB_Data_Received_Return_Type uac2_set_sample_rate_req (void)
+{
+    uint32_t rate;
+    uint8_t i;
+
+    rate = uac2_state.pending_sample_rate;
+
+    /* Only accept advertised rates */
+    for (i = 0; i < uac2_state.numSampleRates; i++) {
+        if (uac2_state.sampleRates[i] == rate) {
+            break;
+        }
+    }
+    if (i == uac2_state.numSampleRates) {
+        return CLD_USB_DATA_BAD_STALL;
+    }
+
+    if (rate != uac2_state.clock_source.current) {
+        uac2_state.clock_source.current = rate;
+        uac2_update_pkt_sizes();
+        uac2_state.first_feedback = CLD_TRUE;
+        uac2_feedback_restart();
+        uac2_syslog("UAC 2.0 Sample Rate Changed");
+        if (uac2_state.cfg.sampleRateCallback) {
+            uac2_state.cfg.sampleRateCallback(rate, uac2_state.cfg.usrPtr);
+        }
+    }
+
+    return CLD_USB_DATA_GOOD;
+}
+
 /**
  * This function is called by the CLD Audio v2.0 library when a Set Command
  * request is received. This function sets the p_transfer_data parameters to
@@ -633,6 +950,7 @@ static CLD_USB_Transfer_Request_Return_Type uac2_set_req_cmd (CLD_SC58x_Audio_2_
     uint8_t maxChannels;
 
     UAC2_VOLUME *featureUnit;
+    CLD_USB_Data_Received_Return_Type (*complete)(void);
 
     /* Default to discarding the packet */
     rv = CLD_USB_TRANSFER_DISCARD;
@@ -640,8 +958,9 @@ static CLD_USB_Transfer_Request_Return_Type uac2_set_req_cmd (CLD_SC58x_Audio_2_
     pDataBuffer = NULL;
     numBytes = 0;
     maxChannels = 0;
+    complete = uac2_set_volume_req;
 
-    /* Select to the correct Feature Unit */
+    /* Select to the correct Feature Unit or Clock Source */
     switch (p_req_params->entity_id) {
         case SPKR_FEATURE_UNIT_ID:
             featureUnit = &uac2_state.speaker_output_volume;
@@ -651,6 +970,18 @@ static CLD_USB_Transfer_Request_Return_Type uac2_set_req_cmd (CLD_SC58x_Audio_2_
             featureUnit = &uac2_state.mic_input_volume;
             maxChannels = uac2_state.cfg.usbInChannels + 1;
             break;
+        case MIC_CLOCK_SOURCE_ID:
+        case SPKR_CLOCK_SOURCE_ID:
+            /* Both clock sources share a single clock domain */
+            controlSelector = (p_req_params->setup_packet_wValue >> 8) & 0xFF;
+            if ((p_req_params->req == CLD_REQ_CURRENT) &&
+                (controlSelector == UAC_CS_SAM_FREQ_CONTROL) &&
+                (uac2_state.numSampleRates > 1)) {
+                pDataBuffer = &uac2_state.pending_sample_rate;
+                numBytes = sizeof(uac2_state.pending_sample_rate);
+                complete = uac2_set_sample_rate_req;
+            }
+            break;
         default:
             break;
     }
@@ -692,7 +1023,7 @@ static CLD_USB_Transfer_Request_Return_Type uac2_set_req_cmd (CLD_SC58x_Audio_2_
         p_transfer_data->num_bytes = numBytes;
         p_transfer_data->transfer_timeout_ms = 0;
         p_transfer_data->fp_transfer_aborted_callback = CLD_NULL;
-        p_transfer_data->callback.fp_usb_out_transfer_complete = uac2_set_volume_req;
+        p_transfer_data->callback.fp_usb_out_transfer_complete = complete;
         rv = CLD_USB_TRANSFER_ACCEPT;
     }
 
@@ -739,7 +1070,7 @@ __attribute__ ((section(".l3_uncached_data")))
 static uac2_2_byte_control_range_parameter_block uac2_2_byte_range_resp;
 
 __attribute__ ((section(".l3_uncached_data")))
-static uac2_4_byte_control_range_parameter_block uac2_4_byte_range_resp;
+static uac2_sample_rate_range_parameter_block uac2_sample_rate_range_resp;
 
 static CLD_USB_Transfer_Request_Return_Type uac2_get_req_cmd (CLD_SC58x_Audio_2_0_Cmd_Req_Parameters * p_req_params, CLD_USB_Transfer_Params * p_transfer_data)
 {
@@ -832,12 +1163,9 @@ static CLD_USB_Transfer_Request_Return_Type uac2_get_req_cmd (CLD_SC58x_Audio_2_
 
         /* Clock Source range requests */
         if (p_req_params->req == CLD_REQ_RANGE) {
-            uac2_4_byte_range_resp.wNumSubRanges = 1;
-            uac2_4_byte_range_resp.sub_ranges[0].wMAX = clockSource->max;
-            uac2_4_byte_range_resp.sub_ranges[0].wMIN = clockSource->min;
-            uac2_4_byte_range_resp.sub_ranges[0].wRES = clockSource->resolution;
-            pDataBuffer = &uac2_4_byte_range_resp;
-            numBytes = sizeof(uac2_4_byte_range_resp);
+            numBytes = fillSampleRateRange(&uac2_sample_rate_range_resp,
+                uac2_state.sampleRates, uac2_state.numSampleRates);
+            pDataBuffer = &uac2_sample_rate_range_resp;
 
         /* Clock Source current requests */
         } else if (p_req_params->req == CLD_REQ_CURRENT) {
@@ -883,8 +1211,10 @@ static void uac2_streaming_rx_endpoint_enabled (CLD_Boolean enabled)
     if (enabled == CLD_TRUE) {
         uac2_syslog("UAC 2.0 OUT Enabled");
         uac2_state.first_feedback = CLD_TRUE;
+        uac2_feedback_restart();
     } else {
         uac2_syslog("UAC 2.0 OUT Disabled");
+        uac2_state.feedback_run = CLD_FALSE;
         uac2_state.rate_feedback_idle = CLD_TRUE;
         uac2_state.outPktFirst = CLD_TRUE;
     }
@@ -912,6 +1242,8 @@ static void uac2_streaming_tx_endpoint_enabled (CLD_Boolean enabled)
         uac2_state.in_active = CLD_FALSE;
         uac2_state.in_idle = CLD_TRUE;
         uac2_state.inPktFirst = CLD_TRUE;
+        uac2_state.in_ring_frames = 0;
+        uac2_state.inFrameAccum = 0;
     }
 }
 
@@ -977,17 +1309,11 @@ static void uac2_usb_event (CLD_USB_Event event)
         case CLD_USB_ENUMERATED_CONFIGURED:
             /* HACK: Get the speed directly from the peripheral */
             highSpeed = (*pREG_USB0_POWER & BITM_USB_POWER_HSEN);
+            uac2_state.highSpeed = highSpeed ? CLD_TRUE : CLD_FALSE;
+            uac2_update_pkt_sizes();
             if (highSpeed) {
-                uac2_state.minInSize = uac2_state.minInSizeHigh;
-                uac2_state.maxInSize = uac2_state.maxInSizeHigh;
-                uac2_state.minOutSize = uac2_state.minOutSizeHigh;
-                uac2_state.maxOutSize = uac2_state.maxOutSizeHigh;
                 uac2_syslog("UAC 2.0 High Speed Ready\n");
             } else {
-                uac2_state.minInSize = uac2_state.minInSizeFull;
-                uac2_state.maxInSize = uac2_state.maxInSizeFull;
-                uac2_state.minOutSize = uac2_state.minOutSizeFull;
-                uac2_state.maxOutSize = uac2_state.maxOutSizeFull;
                 uac2_syslog("UAC 2.0 Low Speed Ready\n");
             }
             break;
@@ -1006,6 +1332,33 @@ static void uac2_usb_event (CLD_USB_Event event)
     }
 }
 
+/**
+ * Updates the min/max packet sizes passed to the audio callbacks for
+ * the current bus speed and sample rate.
+ */
+static void uac2_update_pkt_sizes(void)
+{
+    uint32_t rate;
+
+    rate = uac2_state.clock_source.current;
+
+    if (uac2_state.highSpeed == CLD_TRUE) {
+        uac2_state.maxInSize = calcPktSize(rate, 8000,
+            uac2_state.inIntervalHigh, uac2_state.inFrameSize,
+            &uac2_state.minInSize);
+        uac2_state.maxOutSize = calcPktSize(rate, 8000,
+            uac2_state.outIntervalHigh, uac2_state.outFrameSize,
+            &uac2_state.minOutSize);
+    } else {
+        uac2_state.maxInSize = calcPktSize(rate, 1000,
+            uac2_state.inIntervalFull, uac2_state.inFrameSize,
+            &uac2_state.minInSize);
+        uac2_state.maxOutSize = calcPktSize(rate, 1000,
+            uac2_state.outIntervalFull, uac2_state.outFrameSize,
+            &uac2_state.minOutSize);
+    }
+}
+
 void uac2_syslog(char *log)
 {
     uac2_state.syslog[uac2_state.syslogHead++] = log;
@@ -1082,6 +1435,7 @@ static void uac20_timer_handler(void *pCBParam, uint32_t Event, void *pArg)
 
     if (Event == ADI_TMR_EVENT_DATA_INT) {
         cld_time_125us_tick();
+        uac2_feedback_sof_poll();
     }
 
     outCycles = cpuLoadGetTimeStamp();
@@ -1140,10 +1494,13 @@ unsigned char *createTerminalAndFeatureDescriptors(unsigned short *descriptorLen
     uac2_feature_unit_descriptor *micVolume;
     uac2_clock_source_descriptor *cs1;
     uac2_clock_source_descriptor *cs2;
+    bool programmable;
 
     unsigned char *descriptors;
     unsigned short offset, length;
 
+    programmable = (uac2_state.numSampleRates > 1);
+
     descriptors = NULL;
     offset = 0;
     length = 0;
@@ -1215,7 +1572,7 @@ unsigned char *createTerminalAndFeatureDescriptors(unsigned short *descriptorLen
     UAC20_DESCRIPTORS_FREE(micVolume);
 
     /* CLOCK SOURCE UNIT: cs1 */
-    cs1 = newClockSourceDescriptor(SPKR_CLOCK_SOURCE_ID);
+    cs1 = newClockSourceDescriptor(SPKR_CLOCK_SOURCE_ID, programmable);
     length = cs1->bLength;
     descriptors = UAC20_DESCRIPTORS_REALLOC(descriptors, offset + length);
     UAC2_MEMCPY(descriptors + offset, cs1, length);
@@ -1223,7 +1580,7 @@ unsigned char *createTerminalAndFeatureDescriptors(unsigned short *descriptorLen
     UAC20_DESCRIPTORS_FREE(cs1);
 
     /* CLOCK SOURCE UNIT: cs2 */
-    cs2 = newClockSourceDescriptor(MIC_CLOCK_SOURCE_ID);
+    cs2 = newClockSourceDescriptor(MIC_CLOCK_SOURCE_ID, programmable);
     length = cs2->bLength;
     descriptors = UAC20_DESCRIPTORS_REALLOC(descriptors, offset + length);
     UAC2_MEMCPY(descriptors + offset, cs2, length);
@@ -1266,8 +1623,16 @@ CLD_RV uac2_init(void)
     uac2_state.maxOutSizeFull = 0;
     uac2_state.minOutSizeHigh = 0;
     uac2_state.maxOutSizeHigh = 0;
+    uac2_state.numSampleRates = 0;
+    uac2_state.highSpeed = CLD_FALSE;
+    uac2_state.rxRingData = NULL;
+    uac2_state.out_in_ring = CLD_FALSE;
+    uac2_state.txRingData = NULL;
+    uac2_state.in_ring_frames = 0;
+    uac2_state.inFrameAccum = 0;
     uac2_state.rate_feedback_idle = CLD_TRUE;
     uac2_state.first_feedback = CLD_TRUE;
+    uac2_state.feedback_run = CLD_FALSE;
     uac2_state.periodic_timer_handle = NULL;
     uac2_state.inPktFirst = CLD_TRUE;
     uac2_state.outPktFirst = CLD_TRUE;
@@ -1300,16 +1665,61 @@ CLD_RV uac2_init(void)
  */
 CLD_RV uac2_config(UAC2_APP_CONFIG *cfg)
 {
-    uint8_t i;
+    uint32_t rate;
+    uint8_t i, j, n;
 
     /* Copy in application configuration parameters */
     UAC2_MEMCPY(&uac2_state.cfg, cfg, sizeof(uac2_state.cfg));
 
-    /* Initialize clock source info */
-    uac2_state.clock_source.current = uac2_state.cfg.usbSampleRate;
-    uac2_state.clock_source.min = uac2_state.cfg.usbSampleRate;
-    uac2_state.clock_source.max = uac2_state.cfg.usbSampleRate;
+    /* Build the list of supported sample rates */
+    if (uac2_state.cfg.usbSampleRates && uac2_state.cfg.numUsbSampleRates) {
+        uac2_state.numSampleRates = uac2_state.cfg.numUsbSampleRates;
+        if (uac2_state.numSampleRates > UAC2_MAX_SAMPLE_RATES) {
+            uac2_state.numSampleRates = UAC2_MAX_SAMPLE_RATES;
+        }
+        /*
+         * RANGE responses must list the sub-ranges in ascending order, so
+         * sort the rates and drop any duplicates.
+         */
+        n = 0;
+        for (i = 0; i < uac2_state.numSampleRates; i++) {
+            rate = uac2_state.cfg.usbSampleRates[i];
+            for (j = n; (j > 0) && (uac2_state.sampleRates[j - 1] > rate); j--) {
+                uac2_state.sampleRates[j] = uac2_state.sampleRates[j - 1];
+            }
+            if ((j > 0) && (uac2_state.sampleRates[j - 1] == rate)) {
+                for (; j < n; j++) {
+                    uac2_state.sampleRates[j] = uac2_state.sampleRates[j + 1];
+                }
+                continue;
+            }
+            uac2_state.sampleRates[j] = rate;
+            n++;
+        }
+        uac2_state.numSampleRates = n;
+    } else {
+        uac2_state.sampleRates[0] = cfg->usbSampleRate;
+        uac2_state.numSampleRates = 1;
+    }
+
+    /* Initialize clock source info.  Endpoints are sized for the
+     * highest rate.
+     */
+    uac2_state.clock_source.current = uac2_state.sampleRates[0];
+    uac2_state.clock_source.min = uac2_state.sampleRates[0];
+    uac2_state.clock_source.max = uac2_state.sampleRates[0];
     uac2_state.clock_source.resolution = 0;
+    for (i = 0; i < uac2_state.numSampleRates; i++) {
+        if (uac2_state.sampleRates[i] == cfg->usbSampleRate) {
+            uac2_state.clock_source.current = cfg->usbSampleRate;
+        }
+        if (uac2_state.sampleRates[i] < uac2_state.clock_source.min) {
+            uac2_state.clock_source.min = uac2_state.sampleRates[i];
+        }
+        if (uac2_state.sampleRates[i] > uac2_state.clock_source.max) {
+            uac2_state.clock_source.max = uac2_state.sampleRates[i];
+        }
+    }
 
     /* Copy static parameters from app cfg to CLD init params */
     uac2_init_params.vendor_id = cfg->vendorId;
@@ -1336,7 +1746,7 @@ CLD_RV uac2_config(UAC2_APP_CONFIG *cfg)
             USB_IN_ENDPOINT_ID, USB_IN_OUTPUT_TERMINAL_ID,
             &uac2_state.minInSizeFull, &uac2_state.maxInSizeFull,
             &uac2_state.minInSizeHigh, &uac2_state.maxInSizeHigh,
-            uac2_state.cfg.usbSampleRate, uac2_state.cfg.usbInChannels,
+            uac2_state.clock_source.max, uac2_state.cfg.usbInChannels,
             uac2_state.cfg.lowLatency,
             inFormatDescriptor, inEndpointDescriptor
         );
@@ -1351,11 +1761,42 @@ CLD_RV uac2_config(UAC2_APP_CONFIG *cfg)
             USB_OUT_ENDPOINT_ID, USB_OUT_INPUT_TERMINAL_ID,
             &uac2_state.minOutSizeFull, &uac2_state.maxOutSizeFull,
             &uac2_state.minOutSizeHigh, &uac2_state.maxOutSizeHigh,
-            uac2_state.cfg.usbSampleRate, uac2_state.cfg.usbOutChannels,
+            uac2_state.clock_source.max, uac2_state.cfg.usbOutChannels,
             uac2_state.cfg.lowLatency,
             outFormatDescriptor, outEndpointDescriptor
         );
 
+    /* Save the endpoint geometry for run-time sample rate changes */
+    uac2_state.inFrameSize =
+        inFormatDescriptor->bSubslotSize * uac2_state.cfg.usbInChannels;
+    uac2_state.inIntervalFull = uac2_init_params.
+        p_audio_streaming_tx_interface_params->b_interval_full_speed;
+    uac2_state.inIntervalHigh = uac2_init_params.
+        p_audio_streaming_tx_interface_params->b_interval_high_speed;
+    uac2_state.outFrameSize =
+        outFormatDescriptor->bSubslotSize * uac2_state.cfg.usbOutChannels;
+    uac2_state.outIntervalFull = uac2_init_params.
+        p_audio_streaming_rx_interface_params->b_interval_full_speed;
+    uac2_state.outIntervalHigh = uac2_init_params.
+        p_audio_streaming_rx_interface_params->b_interval_high_speed;
+    uac2_update_pkt_sizes();
+
+    /* Allocate the service owned audio rings */
+    if (uac2_state.cfg.usbOutRingFrames) {
+        uac2_state.rxRingData = uac2_ring_alloc(&uac2_state.rxRing,
+            uac2_state.cfg.usbOutRingFrames, uac2_state.outFrameSize);
+        if (uac2_state.rxRingData == NULL) {
+            return(CLD_FAIL);
+        }
+    }
+    if (uac2_state.cfg.usbInRingFrames) {
+        uac2_state.txRingData = uac2_ring_alloc(&uac2_state.txRing,
+            uac2_state.cfg.usbInRingFrames, uac2_state.inFrameSize);
+        if (uac2_state.txRingData == NULL) {
+            return(CLD_FAIL);
+        }
+    }
+
     /* Create and configure Rate Feedback parameters */
     uac2_init_params.p_audio_rate_feedback_rx_params =
         newRateFeedbackParams(USB_RATE_FEEDBACK_RATE_MS);
@@ -1455,6 +1896,62 @@ CLD_RV uac2_setTxPktBuffer(void *buf)
     return(CLD_SUCCESS);
 }
 
+/**
+ * Returns the service owned OUT (Rx) ring
+ */
+CLD_RV uac2_getRxRing(PaUtilRingBuffer **ring)
+{
+    if ((ring == NULL) || (uac2_state.rxRingData == NULL)) {
+        return(CLD_FAIL);
+    }
+    *ring = &uac2_state.rxRing;
+    return(CLD_SUCCESS);
+}
+
+/**
+ * Returns the service owned IN (Tx) ring
+ */
+CLD_RV uac2_getTxRing(PaUtilRingBuffer **ring)
+{
+    if ((ring == NULL) || (uac2_state.txRingData == NULL)) {
+        return(CLD_FAIL);
+    }
+    *ring = &uac2_state.txRing;
+    return(CLD_SUCCESS);
+}
+
+/**
+ * Reports audio frames consumed by the audio clock domain to the
+ * feedback engine
+ */
+void uac2_feedbackAudioFrames(uint32_t frames)
+{
+    if (uac2_state.cfg.feedbackEngine &&
+        (uac2_state.out_enabled == CLD_TRUE)) {
+        uac2FeedbackAudioEvent(&uac2_feedback, frames);
+    }
+}
+
+/**
+ * Returns the current feedback engine value in Hz
+ */
+float uac2_getFeedbackRate(void)
+{
+    if (!uac2_state.cfg.feedbackEngine ||
+        !uac2FeedbackValid(&uac2_feedback)) {
+        return(0.0f);
+    }
+    return(uac2FeedbackGetKHz(&uac2_feedback) * 1000.0f);
+}
+
+/**
+ * Returns the sample rate currently selected by the host
+ */
+uint32_t uac2_getSampleRate(void)
+{
+    return(uac2_state.clock_source.current);
+}
+
 /**
  * Starts the CLD SC58x USB Audio 2.0 Library.
  */
@@ -1540,6 +2037,16 @@ CLD_RV uac2_stop(void)
         uac2_state.out_data = NULL;
     }
 
+    /* Free the audio rings */
+    if (uac2_state.rxRingData) {
+        UAC2_RING_FREE_ALIGNED(uac2_state.rxRingData);
+        uac2_state.rxRingData = NULL;
+    }
+    if (uac2_state.txRingData) {
+        UAC2_RING_FREE_ALIGNED(uac2_state.txRingData);
+        uac2_state.txRingData = NULL;
+    }
+
     /* Free channel volume settings */
     if (uac2_state.speaker_output_volume.vol) {
         UAC2_FREE(uac2_state.speaker_output_volume.vol);
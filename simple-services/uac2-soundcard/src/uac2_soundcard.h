@@ -17,6 +17,8 @@
 
 #include "uac2_soundcard_cfg.h"
 #include "cld_sc58x_audio_2_0_lib.h"
+#include "pa_ringbuffer.h"
+#include "uac2_feedback.h"
 
 typedef enum {
     UAC2_DIR_UNKNOWN = 0,
@@ -30,6 +32,8 @@ typedef uint16_t (*UAC2_TX_CALLBACK)(void *data, void **nextData,
     uint16_t minSize, uint16_t maxSize, void *usrPtr);
 typedef uint32_t (*UAC2_RATE_FEEDBACK_CALLBACK)(void *usrPtr);
 typedef void (*UAC2_ENDPOINT_ENABLE_CALLBACK)(UAC2_DIR dir, bool enable, void *usrPtr);
+typedef void (*UAC2_SAMPLE_RATE_CALLBACK)(uint32_t sampleRate, void *usrPtr);
+typedef void (*UAC2_RING_CALLBACK)(UAC2_DIR dir, uint32_t frames, void *usrPtr);
 
 /* USB Audio OUT (Rx) endpoint stats */
 typedef struct {
@@ -44,12 +48,23 @@ typedef struct {
     uint32_t ok;
 } UAC2_ENDPOINT_STATS;
 
+/*
+ * Application configuration.  Zero-initialize the structure before
+ * filling it in, the optional features are off while their fields are
+ * NULL, 0 or false.
+ */
 typedef struct {
     uint8_t usbInChannels;            /*!< USB IN (Tx) channels */
     uint8_t usbInWordSizeBits;        /*!< USB IN (Tx) word size */
     uint8_t usbOutChannels;           /*!< USB OUT (Rx) channels */
     uint8_t usbOutWordSizeBits;       /*!< USB OUT (Rx) word size */
-    uint32_t usbSampleRate;           /*!< USB sample rate */
+    uint32_t usbSampleRate;           /*!< USB sample rate (initial rate if
+                                           usbSampleRates is set) */
+    const uint32_t *usbSampleRates;   /*!< Optional list of host selectable
+                                           sample rates, sorted into
+                                           ascending order and duplicates
+                                           dropped by uac2_config() */
+    uint8_t numUsbSampleRates;        /*!< Number of entries in usbSampleRates */
     uint32_t timerNum;                /*!< ADI Timer Service timer number */
     uint16_t vendorId;                /*!< USB Vendor ID */
     uint16_t productId;               /*!< USB Product ID */
@@ -63,6 +78,21 @@ typedef struct {
     UAC2_TX_CALLBACK txCallback;      /*!< UAC2 IN (Tx) callback */
     UAC2_RATE_FEEDBACK_CALLBACK rateFeedbackCallback;  /*!< UAC2 Rate Feedback callback */
     UAC2_ENDPOINT_ENABLE_CALLBACK endpointEnableCallback; /*!< UAC2 Endpoint enable callback */
+    UAC2_SAMPLE_RATE_CALLBACK sampleRateCallback; /*!< UAC2 Sample rate change callback */
+    uint32_t usbOutRingFrames;        /*!< USB OUT (Rx) ring size in frames
+                                           (power of 2, 0 = packet callbacks) */
+    uint32_t usbInRingFrames;         /*!< USB IN (Tx) ring size in frames
+                                           (power of 2, 0 = packet callbacks) */
+    bool usbOutBufferTrack;           /*!< Track the OUT ring fill level */
+    uint8_t usbOutBufferTrackIdx;     /*!< buffer-track index of the OUT ring */
+    bool usbInBufferTrack;            /*!< Track the IN ring fill level */
+    uint8_t usbInBufferTrackIdx;      /*!< buffer-track index of the IN ring */
+    UAC2_RING_CALLBACK ringCallback;  /*!< UAC2 ring packet callback */
+    bool feedbackEngine;              /*!< Generate the rate feedback
+                                           internally (ignores
+                                           rateFeedbackCallback) */
+    UAC2_FEEDBACK_GET_TIME feedbackGetTime; /*!< Feedback engine timestamp
+                                           (NULL = cpuLoadGetTimeStamp) */
     void *usrPtr;
 } UAC2_APP_CONFIG;
 
@@ -97,6 +127,32 @@ CLD_RV uac2_getTxPktSize(uint16_t *minFull, uint16_t *maxFull,
 CLD_RV uac2_setRxPktBuffer(void *buf);
 CLD_RV uac2_setTxPktBuffer(void *buf);
 
+/* Returns the sample rate currently selected by the host */
+uint32_t uac2_getSampleRate(void);
+
+/* These functions return the service owned audio rings when
+ * 'usbOutRingFrames' and/or 'usbInRingFrames' are non-zero.  They are
+ * valid following a successful call to uac2_config().
+ *
+ * USB OUT packets are received directly into the OUT ring and USB IN
+ * packets are sent directly from the IN ring.  Each ring element is
+ * one audio frame.  The application is the only reader of the OUT ring
+ * and the only writer of the IN ring and should use the PaUtil region
+ * functions for zero-copy access.  The rxCallback and txCallback
+ * functions are not called for a direction with a ring.
+ */
+CLD_RV uac2_getRxRing(PaUtilRingBuffer **ring);
+CLD_RV uac2_getTxRing(PaUtilRingBuffer **ring);
+
+/* Reports 'frames' audio frames consumed by the audio clock domain
+ * (i.e. from the SPORT DMA callback) to the internal feedback engine.
+ * Only used when 'feedbackEngine' is set.
+ */
+void uac2_feedbackAudioFrames(uint32_t frames);
+
+/* Returns the current feedback value in Hz, 0 if not yet measured */
+float uac2_getFeedbackRate(void);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
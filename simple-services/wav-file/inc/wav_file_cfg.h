@@ -19,4 +19,7 @@
 
 #define WAVE_FILE_BUF_SIZE       (16 * 1024)
 
+/* Enable fs-dev FatFs streaming mode for files with 'stream' set */
+//#define WAVE_FILE_FATFS_STREAM
+
 #endif
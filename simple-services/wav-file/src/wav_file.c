@@ -16,6 +16,10 @@
 #include "wav_file_cfg.h"
 #include "wav_file.h"
 
+#ifdef WAVE_FILE_FATFS_STREAM
+#include "fs_dev_fatfs.h"
+#endif
+
 #ifndef WAVE_FILE_BUF_SIZE
 #define WAVE_FILE_BUF_SIZE (16 * 1024)
 #endif
@@ -310,6 +314,12 @@ bool openWave(WAV_FILE *wf)
 {
     bool ok = false;
 
+#ifdef WAVE_FILE_FATFS_STREAM
+    if (wf->stream) {
+        fs_dev_fatfs_stream(wf->fname, wf->isSrc ? 0 : wf->streamPrealloc);
+    }
+#endif
+
     wf->f = fopen(wf->fname, wf->isSrc ? "rb" : "wb");
     if (wf->f) {
 #ifdef WAVE_FILE_BUF_SIZE
@@ -70,6 +70,8 @@ typedef struct WAV_FILE {
     bool isSrc;
     void *fileBuf;
     size_t dataOffset;
+    bool stream;
+    uint32_t streamPrealloc;
 } WAV_FILE;
 
 bool openWave(WAV_FILE *wf);
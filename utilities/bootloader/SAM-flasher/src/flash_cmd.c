@@ -16,9 +16,10 @@
 #include "flash_cmd.h"
 #include "serial.h"
 #include "slip.h"
+#include "crc32.h"
 #include "util.h"
 
-#define RESP_TIMEOUT_NS  (5000000000)
+#define RESP_TIMEOUT_MS  (5000)
 
 /***********************************************************************
  * Command Variables
@@ -36,7 +37,7 @@ unsigned char in[512];
  **********************************************************************/
 static int xfer(ser_handle serial, void *blob, int blobLen)
 {
-    unsigned char sBuf[512];
+    static unsigned char sBuf[2 * sizeof(CMD_PROGRAM2) + 2];
     int xferLen;
     int ret;
 
@@ -46,7 +47,7 @@ static int xfer(ser_handle serial, void *blob, int blobLen)
     return(ret);
 }
 
-static int waitForResp(ser_handle serial)
+static int waitForResp(ser_handle serial, int timeout_ms)
 {
     int frameReady;
     int timeout;
@@ -80,7 +81,7 @@ static int waitForResp(ser_handle serial)
         /* Check timeout */
         clock_gettime(0, &now);
         elapsed = clock_elapsed(&start, &now);
-        if (elapsed > RESP_TIMEOUT_NS) {
+        if (elapsed > (uint64_t)timeout_ms * 1000000) {
             timeout = 1;
         }
 
@@ -90,14 +91,14 @@ static int waitForResp(ser_handle serial)
     return(frameReady);
 }
 
-int waitfor(ser_handle serial, uint8_t cmd)
+int waitfor_ms(ser_handle serial, uint8_t cmd, int timeout_ms)
 {
     int frameReady;
     int ok;
     MSG_HEADER *header;
 
     ok = 0;
-    frameReady = waitForResp(serial);
+    frameReady = waitForResp(serial, timeout_ms);
     if (frameReady) {
         header = (MSG_HEADER *)resp;
         if (header->cmd == cmd) {
@@ -108,6 +109,25 @@ int waitfor(ser_handle serial, uint8_t cmd)
     return(ok);
 }
 
+int waitfor(ser_handle serial, uint8_t cmd)
+{
+    return(waitfor_ms(serial, cmd, RESP_TIMEOUT_MS));
+}
+
+int wait_resp(ser_handle serial)
+{
+    int frameReady;
+    MSG_HEADER *header;
+
+    frameReady = waitForResp(serial, RESP_TIMEOUT_MS);
+    if (frameReady) {
+        header = (MSG_HEADER *)resp;
+        return(header->cmd);
+    }
+
+    return(-1);
+}
+
 int send_nop(ser_handle serial)
 {
     CMD_NOP nop;
@@ -172,3 +192,92 @@ int process_program_ack(uint32_t address)
 
     return((program_ack->address == address && program_ack->ok));
 }
+
+int send_hello(ser_handle serial, int maxPayload, int window)
+{
+    CMD_HELLO hello;
+    int ret;
+
+    memset(&hello, 0, sizeof(hello));
+
+    hello.header.cmd = CMD_ID_HELLO;
+    hello.header.len = sizeof(hello);
+    hello.version = FLASH_CMD_VERSION;
+    hello.maxPayload = maxPayload;
+    hello.window = window;
+    ret = xfer(serial, &hello, sizeof(hello));
+
+    return(ret);
+}
+
+int send_check(ser_handle serial, uint32_t address, uint32_t length, uint32_t crc)
+{
+    CMD_CHECK check;
+    int ret;
+
+    memset(&check, 0, sizeof(check));
+
+    check.header.cmd = CMD_ID_CHECK;
+    check.header.len = sizeof(check);
+    check.address = address;
+    check.length = length;
+    check.crc = crc;
+    ret = xfer(serial, &check, sizeof(check));
+
+    return(ret);
+}
+
+int send_program2(ser_handle serial, uint32_t address, unsigned char *buf, int len)
+{
+    static CMD_PROGRAM2 program;
+    int ret;
+
+    memset(&program, 0, sizeof(program) - sizeof(program.data));
+
+    program.header.cmd = CMD_ID_PROGRAM2;
+    program.header.len = sizeof(program) - sizeof(program.data) + len;
+
+    program.address = address;
+    program.length = len;
+    program.crc = crc32_calc(CRC32_INIT, buf, len);
+    memcpy(program.data, buf, len);
+
+    ret = xfer(serial, &program, program.header.len);
+
+    return(ret);
+}
+
+int process_hello(int *version, int *maxPayload, int *window, uint32_t *sectorSize, uint32_t *appSize)
+{
+    CMD_HELLO *hello = (CMD_HELLO *)resp;
+
+    *version = hello->version;
+    *maxPayload = hello->maxPayload;
+    *window = hello->window;
+    *sectorSize = hello->sectorSize;
+    *appSize = hello->appSize;
+
+    return((hello->version >= FLASH_CMD_VERSION) &&
+        (hello->maxPayload > 0) && (hello->window > 0) &&
+        (hello->sectorSize > 0));
+}
+
+int process_check_ack(uint32_t *address, int *match)
+{
+    CMD_CHECK_ACK *check_ack = (CMD_CHECK_ACK *)resp;
+
+    *address = check_ack->address;
+    *match = check_ack->match;
+
+    return(1);
+}
+
+int process_program2_ack(uint32_t *address, int *status)
+{
+    CMD_PROGRAM2_ACK *program_ack = (CMD_PROGRAM2_ACK *)resp;
+
+    *address = program_ack->address;
+    *status = program_ack->status;
+
+    return(program_ack->status == PROGRAM2_OK);
+}
@@ -25,9 +25,28 @@ enum {
     CMD_ID_ERASE_STATUS,
     CMD_ID_PROGRAM,
     CMD_ID_PROGRAM_ACK,
-    CMD_ID_RESET
+    CMD_ID_RESET,
+    /* Protocol v2 */
+    CMD_ID_HELLO,
+    CMD_ID_CHECK,
+    CMD_ID_CHECK_ACK,
+    CMD_ID_PROGRAM2,
+    CMD_ID_PROGRAM2_ACK
 };
 
+enum {
+    PROGRAM2_OK = 0,
+    PROGRAM2_ERR_LENGTH,
+    PROGRAM2_ERR_RANGE,
+    PROGRAM2_ERR_CRC,
+    PROGRAM2_ERR_FLASH,
+    PROGRAM2_ERR_VERIFY
+};
+
+#define FLASH_CMD_VERSION      (2)
+#define FLASH_CMD_MAX_PAYLOAD  (4096)
+#define FLASH_CMD_MAX_WINDOW   (8)
+
 struct _msg_header {
     uint8_t cmd;
     uint16_t len;
@@ -72,6 +91,48 @@ struct _cmd_reset {
 } __attribute__((__packed__));
 typedef struct _cmd_reset CMD_RESET;
 
+struct _cmd_hello {
+    MSG_HEADER header;
+    uint16_t version;
+    uint16_t maxPayload;
+    uint16_t window;
+    uint16_t reserved;
+    uint32_t sectorSize;
+    uint32_t appSize;
+} __attribute__((__packed__));
+typedef struct _cmd_hello CMD_HELLO;
+
+struct _cmd_check {
+    MSG_HEADER header;
+    uint32_t address;
+    uint32_t length;
+    uint32_t crc;
+} __attribute__((__packed__));
+typedef struct _cmd_check CMD_CHECK;
+
+struct _cmd_check_ack {
+    MSG_HEADER header;
+    uint32_t address;
+    uint8_t match;
+} __attribute__((__packed__));
+typedef struct _cmd_check_ack CMD_CHECK_ACK;
+
+struct _cmd_program2 {
+    MSG_HEADER header;
+    uint32_t address;
+    uint32_t length;
+    uint32_t crc;
+    uint8_t data[FLASH_CMD_MAX_PAYLOAD];
+}  __attribute__((__packed__));
+typedef struct _cmd_program2 CMD_PROGRAM2;
+
+struct _cmd_program2_ack {
+    MSG_HEADER header;
+    uint32_t address;
+    uint8_t status;
+} __attribute__((__packed__));
+typedef struct _cmd_program2_ack CMD_PROGRAM2_ACK;
+
 /***********************************************************************
  * Start CMD Functions
  **********************************************************************/
@@ -80,12 +141,21 @@ extern "C" {
 #endif
 
 int waitfor(ser_handle serial, uint8_t cmd);
+int waitfor_ms(ser_handle serial, uint8_t cmd, int timeout_ms);
+int wait_resp(ser_handle serial);
 int send_nop(ser_handle serial);
 int send_erase_application(ser_handle serial);
 int send_program(ser_handle serial, int address, unsigned char *buf, int len);
 int process_erase_status(int *percent);
 int process_program_ack(uint32_t address);
 
+int send_hello(ser_handle serial, int maxPayload, int window);
+int send_check(ser_handle serial, uint32_t address, uint32_t length, uint32_t crc);
+int send_program2(ser_handle serial, uint32_t address, unsigned char *buf, int len);
+int process_hello(int *version, int *maxPayload, int *window, uint32_t *sectorSize, uint32_t *appSize);
+int process_check_ack(uint32_t *address, int *match);
+int process_program2_ack(uint32_t *address, int *status);
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,14 +30,19 @@
 #include "bool.h"
 #include "serial.h"
 #include "slip.h"
+#include "crc32.h"
 #include "flash_cmd.h"
 
+#define HELLO_TIMEOUT_MS  (500)
+#define PROGRAM_RETRIES   (3)
+
 static struct option long_option[] =
 {
    {"port", 0, NULL, 'p'},
    {"file", 0, NULL, 'f'},
    {"help", 0, NULL, 'h'},
    {"verbose", 0, NULL, 'v'},
+   {"v1", 0, NULL, '1'},
    {NULL, 0, NULL, 0},
 };
 
@@ -54,15 +59,237 @@ static void help(const char *name)
         "  -%c,--%s\t LDR file\n"
         "  -%c,--%s\t help\n"
         "  -%c,--%s\t increase debug verbosity\n"
+        "  -%c,--%s\t use protocol v1 only\n"
         "\n", basename(bname),
         long_option[0].val, long_option[0].name,
         long_option[1].val, long_option[1].name,
         long_option[2].val, long_option[2].name,
-        long_option[3].val, long_option[3].name
+        long_option[3].val, long_option[3].name,
+        long_option[4].val, long_option[4].name
     );
     free(bname);
 }
 
+/***********************************************************************
+ * Protocol v2 functions
+ **********************************************************************/
+typedef struct _CHUNK {
+    uint32_t address;
+    uint32_t length;
+    int retries;
+} CHUNK;
+
+static int send_chunk(ser_handle serial, int program, unsigned char *img, CHUNK *chunk)
+{
+    int ret;
+
+    if (program) {
+        ret = send_program2(serial, chunk->address, img + chunk->address, chunk->length);
+    } else {
+        ret = send_check(serial, chunk->address, chunk->length,
+            crc32_calc(CRC32_INIT, img + chunk->address, chunk->length));
+    }
+
+    return(ret);
+}
+
+/*
+ * Sends a CHECK or PROGRAM2 command for every chunk keeping up to
+ * 'window' of them outstanding.  Acks are matched by address.  For
+ * checks 'result' is set to the match flag of each chunk.  Programs
+ * which arrive corrupted are resent.
+ */
+static int pipeline(ser_handle serial, int program, unsigned char *img,
+    CHUNK *chunks, int n, int window, int *result, int verbose)
+{
+    int out[FLASH_CMD_MAX_WINDOW];
+    int outstanding;
+    int next;
+    int done;
+    int ok;
+    int id;
+    int i;
+    int value;
+    uint32_t address;
+    CHUNK *chunk;
+
+    outstanding = 0;
+    next = 0;
+    done = 0;
+    ok = 1;
+
+    while (ok && (done < n)) {
+
+        /* Fill the window */
+        while ((outstanding < window) && (next < n)) {
+            send_chunk(serial, program, img, &chunks[next]);
+            out[outstanding++] = next++;
+        }
+
+        /* Wait for an ack */
+        id = wait_resp(serial);
+        if (id < 0) {
+            printf("Bootloader not responding!\n");
+            ok = 0;
+            break;
+        }
+        if (program && (id == CMD_ID_PROGRAM2_ACK)) {
+            process_program2_ack(&address, &value);
+        } else if (!program && (id == CMD_ID_CHECK_ACK)) {
+            process_check_ack(&address, &value);
+        } else {
+            continue;
+        }
+
+        for (i = 0; i < outstanding; i++) {
+            if (chunks[out[i]].address == address) {
+                break;
+            }
+        }
+        if (i == outstanding) {
+            continue;
+        }
+        chunk = &chunks[out[i]];
+
+        if (program && (value != PROGRAM2_OK)) {
+            if ((value == PROGRAM2_ERR_CRC) && (chunk->retries < PROGRAM_RETRIES)) {
+                if (verbose >= 2) {
+                    printf("Resending 0x%08x\n", (unsigned)address); fflush(stdout);
+                }
+                chunk->retries++;
+                send_chunk(serial, program, img, chunk);
+                continue;
+            }
+            printf("Programming failed at 0x%08x (%d)\n", (unsigned)address, value);
+            ok = 0;
+            break;
+        }
+
+        if (result) {
+            result[out[i]] = value;
+        }
+        out[i] = out[--outstanding];
+        done++;
+
+        if (verbose >= 3) {
+            printf("%s %d%%\n", program ? "Programming" : "Checking",
+                (100 * done) / n); fflush(stdout);
+        }
+    }
+
+    return(ok);
+}
+
+/*
+ * Checks every sector of the image against the flash then programs
+ * the ones which differ.  The bootloader erases those sectors in the
+ * background while the checks and earlier programs are in flight.
+ */
+static int program_v2(ser_handle serial, FILE *f, int fileLen,
+    int maxPayload, int window, uint32_t sectorSize, uint32_t appSize,
+    int verbose)
+{
+    unsigned char *img;
+    CHUNK *checks;
+    CHUNK *programs;
+    int *match;
+    int nChecks, nPrograms;
+    int chunkSize;
+    int changed;
+    uint32_t address, end;
+    int ok;
+    int i;
+
+    img = NULL;
+    checks = NULL;
+    programs = NULL;
+    match = NULL;
+    ok = 1;
+
+    if ((uint32_t)fileLen > appSize) {
+        printf("LDR file too large (%d > %u bytes)\n", fileLen, (unsigned)appSize);
+        return(0);
+    }
+
+    /* Largest power of two payload which fits within a sector */
+    chunkSize = (maxPayload < (int)sectorSize) ? maxPayload : (int)sectorSize;
+    while (chunkSize & (chunkSize - 1)) {
+        chunkSize &= chunkSize - 1;
+    }
+    if (window > FLASH_CMD_MAX_WINDOW) {
+        window = FLASH_CMD_MAX_WINDOW;
+    }
+
+    nChecks = (fileLen + sectorSize - 1) / sectorSize;
+    img = malloc(fileLen + 1);
+    checks = calloc(nChecks + 1, sizeof(*checks));
+    match = calloc(nChecks + 1, sizeof(*match));
+    programs = calloc((fileLen / chunkSize) + 1, sizeof(*programs));
+    if (!img || !checks || !match || !programs) {
+        printf("Out of memory\n");
+        ok = 0;
+    }
+
+    if (ok) {
+        ok = (fread(img, 1, fileLen, f) == (size_t)fileLen);
+        if (!ok) {
+            perror("Unable to read ldr file");
+        }
+    }
+
+    /* Find the sectors which differ */
+    if (ok) {
+        if (verbose) {
+            printf("Checking flash...\n"); fflush(stdout);
+        }
+        for (i = 0; i < nChecks; i++) {
+            checks[i].address = i * sectorSize;
+            checks[i].length = ((fileLen - checks[i].address) < sectorSize) ?
+                (fileLen - checks[i].address) : sectorSize;
+        }
+        ok = pipeline(serial, 0, img, checks, nChecks, window, match, verbose);
+    }
+
+    /* Program them */
+    if (ok) {
+        nPrograms = 0;
+        changed = 0;
+        for (i = 0; i < nChecks; i++) {
+            if (match[i]) {
+                continue;
+            }
+            changed++;
+            end = checks[i].address + checks[i].length;
+            for (address = checks[i].address; address < end; address += chunkSize) {
+                programs[nPrograms].address = address;
+                programs[nPrograms].length = ((end - address) < (uint32_t)chunkSize) ?
+                    (end - address) : chunkSize;
+                nPrograms++;
+            }
+        }
+        if (verbose) {
+            printf("%d of %d sectors changed\n", changed, nChecks);
+            printf("Programming flash...\n"); fflush(stdout);
+        }
+        ok = pipeline(serial, 1, img, programs, nPrograms, window, NULL, verbose);
+    }
+
+    if (ok) {
+        if (verbose) {
+            printf("Programmed %d bytes\n", fileLen); fflush(stdout);
+        }
+    } else {
+        printf("Programming failed!\n");
+    }
+
+    free(programs);
+    free(match);
+    free(checks);
+    free(img);
+
+    return(ok);
+}
+
 /***********************************************************************
  * Main
  **********************************************************************/
@@ -83,6 +310,13 @@ int main(int argc, char **argv)
     int done;
     int percent;
 
+    int v1;
+    int version;
+    int maxPayload;
+    int window;
+    uint32_t sectorSize;
+    uint32_t appSize;
+
     /* Initialize some variables */
     commPortStr = NULL;
     ldrPath = NULL;
@@ -90,11 +324,14 @@ int main(int argc, char **argv)
     helpLevel = 0;
     verbose = 0;
     ok = 0;
+    v1 = 0;
+    version = 1;
+    serial = (ser_handle)-1;
 
     /* Parse program arguments */
     while (1) {
         int c;
-        if ((c = getopt_long(argc, argv, "hvp:f:", long_option, NULL)) < 0)
+        if ((c = getopt_long(argc, argv, "hvp:f:1", long_option, NULL)) < 0)
             break;
         switch (c) {
             case 'h':
@@ -109,6 +346,9 @@ int main(int argc, char **argv)
             case 'f':
                 ldrPath = strdup(optarg);
                 break;
+            case '1':
+                v1 = 1;
+                break;
             default:
                 helpLevel++;
                 break;
@@ -175,8 +415,33 @@ int main(int argc, char **argv)
         }
     }
 
+    /* Negotiate protocol v2, v1 bootloaders don't answer */
+    if (ok && !v1) {
+        send_hello(serial, FLASH_CMD_MAX_PAYLOAD, FLASH_CMD_MAX_WINDOW);
+        if (waitfor_ms(serial, CMD_ID_HELLO, HELLO_TIMEOUT_MS) &&
+            process_hello(&version, &maxPayload, &window, &sectorSize, &appSize)) {
+            version = FLASH_CMD_VERSION;
+        } else {
+            version = 1;
+        }
+        if (verbose) {
+            if (version > 1) {
+                printf("Protocol v%d, %d byte payload, window %d\n",
+                    version, maxPayload, window); fflush(stdout);
+            } else {
+                printf("Protocol v1\n"); fflush(stdout);
+            }
+        }
+    }
+
+    /* Check and program application */
+    if (ok && (version > 1)) {
+        ok = program_v2(serial, f, fileLen, maxPayload, window,
+            sectorSize, appSize, verbose);
+    }
+
     /* Erase application */
-    if (ok) {
+    if (ok && (version == 1)) {
         if (verbose) {
             printf("Erasing flash...\n"); fflush(stdout);
         }
@@ -193,7 +458,7 @@ int main(int argc, char **argv)
     }
 
     /* Program application */
-    if (ok) {
+    if (ok && (version == 1)) {
         if (verbose) {
             printf("Programming flash...\n"); fflush(stdout);
         }
@@ -169,6 +169,7 @@ static CLD_SC58x_CDC_Line_Coding user_cdc_line_coding =
 };
 
 volatile int paused = 0;
+volatile int tx_busy = 0;
 volatile int xfer_state = XFER_STATE_IDLE;
 
 #define USER_CDC_SERIAL_BUFFER_SIZE     512                 /*!< CDC Serial Data receive buffer size */
@@ -257,6 +258,7 @@ void user_cdc_main (void)
  */
 static void user_cdc_usb_in_transfer_complete (void)
 {
+    tx_busy = 0;
 }
 
 /**
@@ -456,10 +458,14 @@ void user_cdc_tx_serial_data (unsigned short length, unsigned char * p_buffer)
     transfer_params.num_bytes = length;
     transfer_params.p_data_buffer = p_buffer;
     transfer_params.callback.fp_usb_in_transfer_complete = user_cdc_usb_in_transfer_complete;
-    transfer_params.fp_transfer_aborted_callback = CLD_NULL;
+    transfer_params.fp_transfer_aborted_callback = user_cdc_usb_in_transfer_complete;
     transfer_params.transfer_timeout_ms = 1000;
 
-    cld_sc58x_cdc_lib_transmit_serial_data (&transfer_params);
+    tx_busy = 1;
+    if (cld_sc58x_cdc_lib_transmit_serial_data (&transfer_params) != CLD_USB_TRANSMIT_SUCCESSFUL)
+    {
+        tx_busy = 0;
+    }
 }
 
 /**
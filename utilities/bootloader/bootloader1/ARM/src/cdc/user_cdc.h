@@ -65,6 +65,7 @@ extern volatile int xfer_state;
 extern unsigned char user_cdc_serial_data_rx_buffer[];
 extern unsigned short user_cdc_serial_data_num_rx_bytes;
 extern volatile int paused;
+extern volatile int tx_busy;
 
 extern void user_cdc_tx_serial_data (unsigned short length, unsigned char * p_buffer);
 
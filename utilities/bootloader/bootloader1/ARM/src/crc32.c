@@ -0,0 +1,33 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#include <stdint.h>
+
+#include "crc32.h"
+
+/* Nibble table for the reflected 0xEDB88320 polynomial */
+static const uint32_t crc32_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t crc32_calc(uint32_t crc, const uint8_t *buf, int len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        crc = (crc >> 4) ^ crc32_table[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_table[crc & 0x0F];
+    }
+    return(~crc);
+}
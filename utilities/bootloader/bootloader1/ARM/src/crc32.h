@@ -0,0 +1,25 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#ifndef _crc32_h
+#define _crc32_h
+
+#include <stdint.h>
+
+#define CRC32_INIT  (0x00000000)
+
+/*
+ * Standard (IEEE 802.3 / zlib) CRC32.  Pass CRC32_INIT to start and
+ * the previous result to continue over split buffers.
+ */
+uint32_t crc32_calc(uint32_t crc, const uint8_t *buf, int len);
+
+#endif
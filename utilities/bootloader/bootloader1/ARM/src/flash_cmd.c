@@ -13,18 +13,25 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
 /* Flash driver includes */
-#include "drivers/flash/flash.h"
+#include "flash.h"
 
 /* Flash map includes */
 #include "flash_map.h"
 
 /* CLD library includes */
+#ifdef CDC_SIM_HOST
+#include "sim/cdc_sim.h"
+#else
 #include "cld_sc58x_cdc_lib.h"
+#endif
 
 /* Flash command includes */
 #include "slip.h"
+#include "crc32.h"
 #include "flash_cmd.h"
 #include "cdc/user_cdc.h"
 
@@ -33,8 +40,17 @@
 #define APPLICATION_BASE_ADDR        (APP_OFFSET)
 #define APPLICATION_ERASE_SECTORS    (APP_SIZE / ERASE_SECTOR_SIZE)
 
-uint8_t cmd[512];
-uint8_t resp[512];
+/* Largest protocol v2 program payload */
+#ifndef FLASH_CMD_MAX_PAYLOAD
+#define FLASH_CMD_MAX_PAYLOAD        (4096)
+#endif
+
+/* Largest protocol v2 window of outstanding commands */
+#ifndef FLASH_CMD_MAX_WINDOW
+#define FLASH_CMD_MAX_WINDOW         (8)
+#endif
+
+#define FLASH_CMD_VERSION            (2)
 
 enum {
     PROGRAM_STATE_IDLE = 0,
@@ -42,8 +58,7 @@ enum {
     PROGRAM_PROGRAMMING
 };
 
-extern FLASH_INFO mt25q_info;
-static FLASH_INFO *fi = &mt25q_info;
+static FLASH_INFO *fi = NULL;
 
 uint8_t state = PROGRAM_STATE_IDLE;
 uint32_t erase_sector = 0;
@@ -58,7 +73,22 @@ enum {
     CMD_ID_ERASE_STATUS,
     CMD_ID_PROGRAM,
     CMD_ID_PROGRAM_ACK,
-    CMD_ID_RESET
+    CMD_ID_RESET,
+    /* Protocol v2 */
+    CMD_ID_HELLO,
+    CMD_ID_CHECK,
+    CMD_ID_CHECK_ACK,
+    CMD_ID_PROGRAM2,
+    CMD_ID_PROGRAM2_ACK
+};
+
+enum {
+    PROGRAM2_OK = 0,
+    PROGRAM2_ERR_LENGTH,
+    PROGRAM2_ERR_RANGE,
+    PROGRAM2_ERR_CRC,
+    PROGRAM2_ERR_FLASH,
+    PROGRAM2_ERR_VERIFY
 };
 
 struct _msg_header {
@@ -106,15 +136,194 @@ struct _cmd_reset {
 } __attribute__((__packed__));
 typedef struct _cmd_reset CMD_RESET;
 
+struct _cmd_hello {
+    MSG_HEADER header;
+    uint16_t version;
+    uint16_t maxPayload;
+    uint16_t window;
+    uint16_t reserved;
+    uint32_t sectorSize;
+    uint32_t appSize;
+} __attribute__((__packed__));
+typedef struct _cmd_hello CMD_HELLO;
+
+struct _cmd_check {
+    MSG_HEADER header;
+    uint32_t address;
+    uint32_t length;
+    uint32_t crc;
+} __attribute__((__packed__));
+typedef struct _cmd_check CMD_CHECK;
+
+struct _cmd_check_ack {
+    MSG_HEADER header;
+    uint32_t address;
+    uint8_t match;
+} __attribute__((__packed__));
+typedef struct _cmd_check_ack CMD_CHECK_ACK;
+
+struct _cmd_program2 {
+    MSG_HEADER header;
+    uint32_t address;
+    uint32_t length;
+    uint32_t crc;
+    uint8_t data[FLASH_CMD_MAX_PAYLOAD];
+}  __attribute__((__packed__));
+typedef struct _cmd_program2 CMD_PROGRAM2;
+
+struct _cmd_program2_ack {
+    MSG_HEADER header;
+    uint32_t address;
+    uint8_t status;
+} __attribute__((__packed__));
+typedef struct _cmd_program2_ack CMD_PROGRAM2_ACK;
+
 /***********************************************************************
  * End CMD Interface
  **********************************************************************/
+
+/*
+ * Frames can span several USB packets so the decoder state is kept
+ * between packets.
+ */
+uint8_t cmd[sizeof(CMD_PROGRAM2)];
+static int rxOffset = 0;
+static int cmdOffset = 0;
+
+/*
+ * Responses are queued and sent as one USB transfer whenever the
+ * previous one has completed.  Frames are only decoded while there is
+ * room for their response so a full window of acks never overflows
+ * the queue.
+ */
+#define TX_QUEUE_SIZE       (512)
+#define TX_RESERVE          (2 * sizeof(CMD_HELLO) + 2)
+
+static uint8_t txQueue[2][TX_QUEUE_SIZE];
+static int txIdx = 0;
+static int txLen = 0;
+
+/*
+ * Protocol v2 sector state.  Sectors which fail a CRC check are
+ * queued for erase in the background and any sector not yet erased
+ * this session is erased before its first program.
+ */
+#define SECTOR_MAP_SIZE     ((APPLICATION_ERASE_SECTORS + 7) / 8)
+
+static uint8_t sectorErasePending[SECTOR_MAP_SIZE];
+static uint8_t sectorErased[SECTOR_MAP_SIZE];
+static uint32_t erasePendingCount = 0;
+static uint32_t eraseNext = 0;
+
+static bool sector_get(uint8_t *map, uint32_t sector)
+{
+    return((map[sector / 8] & (1 << (sector % 8))) != 0);
+}
+
+static void sector_set(uint8_t *map, uint32_t sector, bool set)
+{
+    if (set) {
+        map[sector / 8] |= (1 << (sector % 8));
+    } else {
+        map[sector / 8] &= ~(1 << (sector % 8));
+    }
+}
+
+static bool app_range(uint32_t address, uint32_t length)
+{
+    return((length > 0) && (address < APP_SIZE) &&
+        (length <= (APP_SIZE - address)));
+}
+
+static bool tx_room(void)
+{
+    return((TX_QUEUE_SIZE - txLen) >= TX_RESERVE);
+}
+
+static void tx_flush(void)
+{
+    uint8_t *buf;
+    int len;
+
+    if (tx_busy || (txLen == 0)) {
+        return;
+    }
+
+    buf = txQueue[txIdx];
+    len = txLen;
+    txIdx ^= 1;
+    txLen = 0;
+
+    user_cdc_tx_serial_data(len, buf);
+}
+
 void xfer(void *blob, uint16_t blobLen)
 {
     uint16_t xfer_len;
 
-    xfer_len = slip((uint8_t *)blob, blobLen, resp, sizeof(resp));
-    user_cdc_tx_serial_data(xfer_len, resp);
+    xfer_len = slip((uint8_t *)blob, blobLen,
+        txQueue[txIdx] + txLen, TX_QUEUE_SIZE - txLen);
+    txLen += xfer_len;
+}
+
+static int flash_crc(uint32_t address, uint32_t length, uint32_t *crc)
+{
+    uint8_t buf[256];
+    uint32_t len;
+    int ok;
+
+    ok = FLASH_OK;
+    *crc = CRC32_INIT;
+    while ((length > 0) && (ok == FLASH_OK)) {
+        len = (length > sizeof(buf)) ? sizeof(buf) : length;
+        ok = flash_read(fi, APPLICATION_BASE_ADDR + address, buf, len);
+        *crc = crc32_calc(*crc, buf, len);
+        address += len;
+        length -= len;
+    }
+
+    return(ok);
+}
+
+static int erase_sectors(uint32_t address, uint32_t length)
+{
+    uint32_t sector;
+    uint32_t last;
+    int ok;
+
+    ok = FLASH_OK;
+    last = (address + length - 1) / ERASE_SECTOR_SIZE;
+    for (sector = address / ERASE_SECTOR_SIZE; sector <= last; sector++) {
+        if (sector_get(sectorErased, sector)) {
+            continue;
+        }
+        ok = flash_erase(fi, APPLICATION_BASE_ADDR + sector * ERASE_SECTOR_SIZE,
+            ERASE_SECTOR_SIZE);
+        if (ok != FLASH_OK) {
+            break;
+        }
+        sector_set(sectorErased, sector, true);
+        if (sector_get(sectorErasePending, sector)) {
+            sector_set(sectorErasePending, sector, false);
+            erasePendingCount--;
+        }
+    }
+
+    return(ok);
+}
+
+static void erase_background(void)
+{
+    while (!sector_get(sectorErasePending, eraseNext)) {
+        eraseNext = (eraseNext + 1) % APPLICATION_ERASE_SECTORS;
+    }
+    erase_sectors(eraseNext * ERASE_SECTOR_SIZE, ERASE_SECTOR_SIZE);
+
+    /* Don't retry failures here, the program reports them */
+    if (sector_get(sectorErasePending, eraseNext)) {
+        sector_set(sectorErasePending, eraseNext, false);
+        erasePendingCount--;
+    }
 }
 
 void program_flash(CMD_PROGRAM *program)
@@ -133,6 +342,98 @@ void program_flash(CMD_PROGRAM *program)
     xfer(&program_ack, sizeof(program_ack));
 }
 
+void hello(CMD_HELLO *hello)
+{
+    CMD_HELLO resp;
+
+    /* Each v2 session starts with no sectors erased */
+    memset(sectorErasePending, 0, sizeof(sectorErasePending));
+    memset(sectorErased, 0, sizeof(sectorErased));
+    erasePendingCount = 0;
+    eraseNext = 0;
+    state = PROGRAM_STATE_IDLE;
+
+    memset(&resp, 0, sizeof(resp));
+    resp.header.cmd = CMD_ID_HELLO;
+    resp.header.len = sizeof(resp);
+    resp.version = FLASH_CMD_VERSION;
+    resp.maxPayload = (hello->maxPayload < FLASH_CMD_MAX_PAYLOAD) ?
+        hello->maxPayload : FLASH_CMD_MAX_PAYLOAD;
+    resp.window = (hello->window < FLASH_CMD_MAX_WINDOW) ?
+        hello->window : FLASH_CMD_MAX_WINDOW;
+    resp.sectorSize = ERASE_SECTOR_SIZE;
+    resp.appSize = APP_SIZE;
+
+    xfer(&resp, sizeof(resp));
+}
+
+void check_flash(CMD_CHECK *check)
+{
+    CMD_CHECK_ACK check_ack;
+    uint32_t sector;
+    uint32_t crc;
+    bool match;
+
+    /* Checks must cover part of a single sector */
+    match = false;
+    sector = check->address / ERASE_SECTOR_SIZE;
+    if (app_range(check->address, check->length) &&
+        ((check->address % ERASE_SECTOR_SIZE) == 0) &&
+        (check->length <= ERASE_SECTOR_SIZE)) {
+        match = (flash_crc(check->address, check->length, &crc) == FLASH_OK) &&
+            (crc == check->crc);
+        if (!match && !sector_get(sectorErased, sector) &&
+            !sector_get(sectorErasePending, sector)) {
+            sector_set(sectorErasePending, sector, true);
+            erasePendingCount++;
+        }
+    }
+
+    memset(&check_ack, 0, sizeof(check_ack));
+    check_ack.header.cmd = CMD_ID_CHECK_ACK;
+    check_ack.header.len = sizeof(check_ack);
+    check_ack.address = check->address;
+    check_ack.match = match;
+
+    xfer(&check_ack, sizeof(check_ack));
+}
+
+void program_flash2(CMD_PROGRAM2 *program, uint16_t len)
+{
+    CMD_PROGRAM2_ACK program_ack;
+    uint32_t crc;
+    uint8_t status;
+
+    if ((len < offsetof(CMD_PROGRAM2, data)) ||
+        (program->length > FLASH_CMD_MAX_PAYLOAD) ||
+        (len != (offsetof(CMD_PROGRAM2, data) + program->length))) {
+        status = PROGRAM2_ERR_LENGTH;
+    } else if (!app_range(program->address, program->length)) {
+        status = PROGRAM2_ERR_RANGE;
+    } else if (crc32_calc(CRC32_INIT, program->data, program->length) != program->crc) {
+        status = PROGRAM2_ERR_CRC;
+    } else if (erase_sectors(program->address, program->length) != FLASH_OK) {
+        status = PROGRAM2_ERR_FLASH;
+    } else if (flash_program(fi, APPLICATION_BASE_ADDR + program->address,
+            program->data, program->length) != FLASH_OK) {
+        status = PROGRAM2_ERR_FLASH;
+    } else if ((flash_crc(program->address, program->length, &crc) != FLASH_OK) ||
+            (crc != program->crc)) {
+        status = PROGRAM2_ERR_VERIFY;
+    } else {
+        status = PROGRAM2_OK;
+    }
+
+    memset(&program_ack, 0, sizeof(program_ack));
+    program_ack.header.cmd = CMD_ID_PROGRAM2_ACK;
+    program_ack.header.len = sizeof(program_ack);
+    program_ack.address = (len >= offsetof(CMD_PROGRAM2, length)) ?
+        program->address : 0;
+    program_ack.status = status;
+
+    xfer(&program_ack, sizeof(program_ack));
+}
+
 void process_command(MSG_HEADER *msg, uint16_t len)
 {
     CMD_NOP nop;
@@ -140,6 +441,10 @@ void process_command(MSG_HEADER *msg, uint16_t len)
 
     //printf("Cmd: %d, Len: %d\n", msg->cmd, msg->len);
 
+    if (len < sizeof(MSG_HEADER)) {
+        return;
+    }
+
     switch (msg->cmd) {
         case CMD_ID_NOP:
             printf("Connected...\n");
@@ -153,6 +458,8 @@ void process_command(MSG_HEADER *msg, uint16_t len)
             max_erase_sector = APPLICATION_ERASE_SECTORS - 1;
             state = PROGRAM_STATE_ERASING;
             programming = 0;
+            memset(sectorErasePending, 0, sizeof(sectorErasePending));
+            erasePendingCount = 0;
             break;
         case CMD_ID_PROGRAM:
             if (programming == 0) {
@@ -161,6 +468,25 @@ void process_command(MSG_HEADER *msg, uint16_t len)
             }
             program_flash((CMD_PROGRAM *)msg);
             break;
+        case CMD_ID_HELLO:
+            if (len >= sizeof(CMD_HELLO)) {
+                printf("Connected (v%d)...\n", FLASH_CMD_VERSION);
+                hello((CMD_HELLO *)msg);
+                programming = 0;
+            }
+            break;
+        case CMD_ID_CHECK:
+            if (len >= sizeof(CMD_CHECK)) {
+                check_flash((CMD_CHECK *)msg);
+            }
+            break;
+        case CMD_ID_PROGRAM2:
+            if (programming == 0) {
+                printf("Programming application...\n");
+                programming = 1;
+            }
+            program_flash2((CMD_PROGRAM2 *)msg, len);
+            break;
         default:
             break;
     }
@@ -180,40 +506,63 @@ void send_erase_status(uint32_t erase_sector, uint32_t max_sector)
     xfer(&erase_status, sizeof(erase_status));
 }
 
-void decode_frame(unsigned char *buf, unsigned short len)
+/*
+ * Returns false if decoding stopped early to wait for room in the
+ * response queue.  Call again with the same buffer to continue.
+ */
+bool decode_frame(unsigned char *buf, unsigned short len)
 {
     int frameReady;
-    int bufOffset;
-    int cmdOffset;
 
-    bufOffset = 0;
-    cmdOffset = 0;
-    while (bufOffset < len) {
-        frameReady = unslip(buf, len, &bufOffset, cmd, 512, &cmdOffset);
+    while (rxOffset < len) {
+        if (!tx_room()) {
+            return(false);
+        }
+        frameReady = unslip(buf, len, &rxOffset, cmd, sizeof(cmd), &cmdOffset);
         if (frameReady) {
             process_command((MSG_HEADER *)cmd, cmdOffset);
             cmdOffset = 0;
         }
     }
+    rxOffset = 0;
+
+    return(true);
+}
+
+void flash_cmd_init(FLASH_INFO *flash)
+{
+    fi = flash;
 }
 
 void flash_cmd_main(void)
 {
     int ok;
 
+    if (fi == NULL) {
+        return;
+    }
+
     if (xfer_state == XFER_STATE_DATA_READY) {
-        decode_frame(user_cdc_serial_data_rx_buffer, user_cdc_serial_data_num_rx_bytes);
-        xfer_state = XFER_STATE_IDLE;
-        if (paused) {
-            paused = false;
-            cld_sc58x_cdc_lib_resume_paused_serial_data_transfer();
+        if (decode_frame(user_cdc_serial_data_rx_buffer, user_cdc_serial_data_num_rx_bytes)) {
+            xfer_state = XFER_STATE_IDLE;
+            if (paused) {
+                paused = false;
+                cld_sc58x_cdc_lib_resume_paused_serial_data_transfer();
+            }
         }
+    } else if (erasePendingCount > 0) {
+        /* Send any acks first so the host keeps the window full */
+        tx_flush();
+        erase_background();
     }
 
     switch (state) {
         case PROGRAM_STATE_IDLE:
             break;
         case PROGRAM_STATE_ERASING:
+            if (!tx_room()) {
+                break;
+            }
             ok = flash_erase(fi, APPLICATION_BASE_ADDR + erase_sector * ERASE_SECTOR_SIZE, ERASE_SECTOR_SIZE);
             send_erase_status(erase_sector, max_erase_sector);
             if (erase_sector == max_erase_sector) {
@@ -227,4 +576,6 @@ void flash_cmd_main(void)
         default:
             break;
     }
+
+    tx_flush();
 }
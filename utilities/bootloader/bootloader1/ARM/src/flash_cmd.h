@@ -12,6 +12,9 @@
 #ifndef _flash_cmd_h
 #define _flash_cmd_h
 
+#include "flash.h"
+
+void flash_cmd_init(FLASH_INFO *fi);
 void flash_cmd_main(void);
 
 #endif
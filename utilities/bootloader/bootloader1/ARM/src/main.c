@@ -27,6 +27,9 @@
 /* CLD includes */
 #include "cdc/cdc.h"
 
+/* Flash command includes */
+#include "flash_cmd.h"
+
 #include "init.h"
 
 static FLASH_INFO *fi;
@@ -88,6 +91,8 @@ int main(int argc, char *argv[])
         while(1);
     }
 
+    flash_cmd_init(fi);
+
     printf("Waiting for USB connection...\n");
 
     /* Turn on the bootloader indicator LED */
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host (Linux) bootloader simulator.  Runs the bootloader flash
+ * command handler on a simulated flash behind a pty so SAM-flasher
+ * can be tested end-to-end without hardware.  See README.md.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "flash.h"
+#include "flash_sim.h"
+#include "flash_map.h"
+#include "flash_cmd.h"
+#include "cdc_sim.h"
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "\n"
+        "Usage: %s <options>\n"
+        "  -f <file>\t flash backing file (default memory only)\n"
+        "  -r\t\t sleep for the simulated flash timings\n"
+        "  -1\t\t exit after the first flasher session\n"
+        "\n", name);
+}
+
+static void print_stats(const FLASH_INFO *fi)
+{
+    FLASH_SIM_STATS stats;
+
+    flash_sim_stats(fi, &stats, true);
+    printf("Session: %u pages programmed, %u sectors erased, "
+        "%llu bytes read, %llu ms flash busy\n",
+        stats.programs, stats.erases,
+        (unsigned long long)stats.readBytes,
+        (unsigned long long)(stats.busyNs / 1000000));
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    FLASH_SIM_CONFIG cfg;
+    FLASH_INFO *fi;
+    const char *pty;
+    bool once;
+    int c;
+
+    /* MT25Q-like 4MB device */
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.size = 4 * 1024 * 1024;
+    cfg.eraseSize = 4 * 1024;
+    cfg.pageSize = 256;
+    cfg.readSetupNs = 1000;
+    cfg.readByteNs = 80;
+    cfg.programPageNs = 120000;
+    cfg.eraseBlockNs = 50000000;
+    cfg.strict = true;
+    once = false;
+
+    while ((c = getopt(argc, argv, "f:r1h")) != -1) {
+        switch (c) {
+            case 'f':
+                cfg.path = optarg;
+                break;
+            case 'r':
+                cfg.realTime = true;
+                break;
+            case '1':
+                once = true;
+                break;
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    fi = flash_sim_open(&cfg);
+    if (fi == NULL) {
+        printf("Unable to open simulated flash\n");
+        exit(1);
+    }
+
+    pty = cdc_sim_open();
+    if (pty == NULL) {
+        printf("Unable to open pty\n");
+        flash_sim_close(fi);
+        exit(1);
+    }
+
+    flash_cmd_init(fi);
+
+    printf("%s\n", pty);
+    fflush(stdout);
+
+    while (1) {
+        if (!cdc_sim_poll()) {
+            print_stats(fi);
+            if (once) {
+                break;
+            }
+        }
+        flash_cmd_main();
+    }
+
+    cdc_sim_close();
+    flash_sim_close(fi);
+
+    return(0);
+}
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "cdc_sim.h"
+#include "cdc/user_cdc.h"
+
+#define USER_CDC_SERIAL_BUFFER_SIZE     512
+
+volatile int paused = 0;
+volatile int tx_busy = 0;
+volatile int xfer_state = XFER_STATE_IDLE;
+
+unsigned short user_cdc_serial_data_num_rx_bytes;
+unsigned char user_cdc_serial_data_rx_buffer[USER_CDC_SERIAL_BUFFER_SIZE];
+
+static int master = -1;
+static bool connected = false;
+
+const char *cdc_sim_open(void)
+{
+    struct termios tio;
+    const char *name;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0) {
+        return(NULL);
+    }
+    if ((grantpt(master) < 0) || (unlockpt(master) < 0)) {
+        cdc_sim_close();
+        return(NULL);
+    }
+
+    /* Raw on both sides so the SLIP frames pass untouched */
+    if (tcgetattr(master, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(master, TCSANOW, &tio);
+    }
+
+    name = ptsname(master);
+    if (name == NULL) {
+        cdc_sim_close();
+    }
+
+    return(name);
+}
+
+void cdc_sim_close(void)
+{
+    if (master >= 0) {
+        close(master);
+        master = -1;
+    }
+    connected = false;
+}
+
+bool cdc_sim_poll(void)
+{
+    struct pollfd pfd;
+    ssize_t len;
+
+    if (xfer_state != XFER_STATE_IDLE) {
+        return(true);
+    }
+
+    pfd.fd = master;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 1) <= 0) {
+        return(true);
+    }
+
+    /* The master reports a hangup while the slave is closed */
+    if (pfd.revents & POLLHUP) {
+        if (connected) {
+            connected = false;
+            return(false);
+        }
+        usleep(10000);
+        return(true);
+    }
+
+    len = read(master, user_cdc_serial_data_rx_buffer,
+        sizeof(user_cdc_serial_data_rx_buffer));
+    if (len > 0) {
+        connected = true;
+        user_cdc_serial_data_num_rx_bytes = (unsigned short)len;
+        xfer_state = XFER_STATE_DATA_READY;
+    }
+
+    return(true);
+}
+
+void cld_sc58x_cdc_lib_resume_paused_serial_data_transfer(void)
+{
+}
+
+void user_cdc_tx_serial_data(unsigned short length, unsigned char *p_buffer)
+{
+    ssize_t ret;
+
+    while (length > 0) {
+        ret = write(master, p_buffer, length);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        p_buffer += ret;
+        length -= ret;
+    }
+}
@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2022 - Analog Devices Inc. All Rights Reserved.
+ * This software is proprietary and confidential to Analog Devices, Inc.
+ * and its licensors.
+ *
+ * This software is subject to the terms and conditions of the license set
+ * forth in the project LICENSE file. Downloading, reproducing, distributing or
+ * otherwise using the software constitutes acceptance of the license. The
+ * software may not be used except as expressly authorized under the license.
+ */
+
+/*
+ * Host (Linux) stand-in for the CLD CDC library and user_cdc.c so the
+ * bootloader flash command handler can be run against SAM-flasher
+ * over a pseudo-terminal.  The pty master plays the part of the USB
+ * bulk endpoints: OUT data is delivered in packets of up to 512 bytes
+ * through the same xfer_state handshake as user_cdc.c and IN
+ * transfers complete as soon as they are written.
+ *
+ * Build flash_cmd.c with CDC_SIM_HOST and FLASH_SIM_HOST defined.
+ */
+
+#ifndef _cdc_sim_h
+#define _cdc_sim_h
+
+#include <stdbool.h>
+
+/*
+ * Open a pty pair.  Returns the slave device name to pass to
+ * SAM-flasher, or NULL on error.
+ */
+const char *cdc_sim_open(void);
+
+/* Close the pty pair */
+void cdc_sim_close(void);
+
+/*
+ * Deliver the next OUT packet, if the previous one has been consumed.
+ * Returns false once the host has closed the slave side, after which
+ * the next call waits for it to be reopened.
+ */
+bool cdc_sim_poll(void);
+
+/* CLD library stand-in */
+void cld_sc58x_cdc_lib_resume_paused_serial_data_transfer(void);
+
+#endif
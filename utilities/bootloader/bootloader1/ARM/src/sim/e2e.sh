@@ -0,0 +1,131 @@
+#!/bin/bash
+#
+# Copyright (c) 2023 - Analog Devices Inc. All Rights Reserved.
+# This software is proprietary and confidential to Analog Devices, Inc.
+# and its licensors.
+#
+# This software is subject to the terms and conditions of the license set
+# forth in the project LICENSE file. Downloading, reproducing, distributing or
+# otherwise using the software constitutes acceptance of the license. The
+# software may not be used except as expressly authorized under the license.
+#
+# End to end test of SAM-flasher and the stage 1 bootloader over a pty.
+#
+# Builds bootloader_sim and sam-flasher, then flashes a series of random
+# images through protocol v2 and v1 and checks the application region of
+# the simulated flash after each.  The time of each session and the flash
+# statistics of the simulator are reported.  Run from the 'ARM/src'
+# directory with:
+#   sim/e2e.sh [-r] [-k]
+#
+#   -r   Sleep for the simulated flash timings
+#   -k   Keep the work directory
+#
+
+set -u
+
+FLASH=../../../../../simple-drivers/flash/src
+FLASHER=../../../SAM-flasher/src
+
+# Application image offset in the flash
+APP_OFFSET=$((0x40000))
+
+SIM_ARGS=
+KEEP=no
+while getopts "rkh" opt; do
+    case $opt in
+        r) SIM_ARGS=-r ;;
+        k) KEEP=yes ;;
+        *) echo "usage: sim/e2e.sh [-r] [-k]"; exit 1 ;;
+    esac
+done
+
+WORK=$(mktemp -d)
+SIM_PID=
+FAILS=0
+
+cleanup() {
+    if [ -n "$SIM_PID" ]; then
+        kill $SIM_PID 2>/dev/null
+        wait $SIM_PID 2>/dev/null
+    fi
+    if [ $KEEP = yes ]; then
+        echo "Work directory $WORK"
+    else
+        rm -rf "$WORK"
+    fi
+}
+trap cleanup EXIT
+
+gcc -O2 -DCDC_SIM_HOST -DFLASH_SIM_HOST -I$FLASH -I$FLASH/flash_sim -I. -Isim \
+    -o $WORK/bootloader_sim sim/bootloader_sim.c sim/cdc_sim.c flash_cmd.c \
+    slip.c crc32.c $FLASH/flash.c $FLASH/flash_sim/flash_sim.c -lpthread || exit 1
+gcc -O2 -I$FLASHER -o $WORK/sam-flasher $FLASHER/main.c $FLASHER/slip.c \
+    $FLASHER/serial_posix.c $FLASHER/flash_cmd.c $FLASHER/crc32.c \
+    $FLASHER/util.c || exit 1
+
+# Random images, the second differs from the first in two sectors
+head -c $((300 * 1024 + 123)) /dev/urandom > $WORK/img1.ldr
+cp $WORK/img1.ldr $WORK/img2.ldr
+printf '\x5a' | dd of=$WORK/img2.ldr bs=1 seek=5000 conv=notrunc 2>/dev/null
+printf '\xa5' | dd of=$WORK/img2.ldr bs=1 seek=200000 conv=notrunc 2>/dev/null
+head -c $((100 * 1024 + 7)) /dev/urandom > $WORK/img3.ldr
+
+$WORK/bootloader_sim -f $WORK/flash.bin $SIM_ARGS > $WORK/sim.log 2>&1 &
+SIM_PID=$!
+for i in $(seq 50); do
+    PTY=$(head -1 $WORK/sim.log)
+    [ -n "$PTY" ] && break
+    sleep 0.1
+done
+if [ -z "$PTY" ]; then
+    echo "bootloader_sim did not start"
+    exit 2
+fi
+echo "bootloader_sim on $PTY"
+echo
+
+# flash <title> <image> [sam-flasher options]
+flash() {
+    local title=$1 img=$2 start ms rc result
+    shift 2
+
+    start=$(date +%s%N)
+    $WORK/sam-flasher -p $PTY -f $WORK/$img "$@" > $WORK/flasher.log 2>&1
+    rc=$?
+    ms=$((($(date +%s%N) - start) / 1000000))
+
+    if [ $rc -ne 0 ]; then
+        result="FAIL (sam-flasher returned $rc)"
+    elif cmp -s -i 0:$APP_OFFSET -n $(stat -c %s $WORK/$img) \
+        $WORK/$img $WORK/flash.bin; then
+        result=ok
+    else
+        result="FAIL (flash contents)"
+    fi
+    printf "%-28s %5d.%03ds  %s\n" "$title" $((ms / 1000)) $((ms % 1000)) \
+        "$result"
+    if [ "$result" != ok ]; then
+        cat $WORK/flasher.log
+        FAILS=$((FAILS + 1))
+    fi
+
+    # Let the simulator print its statistics
+    sleep 0.2
+}
+
+flash "v2 first image" img1.ldr
+flash "v2 same image" img1.ldr
+flash "v2 two sectors changed" img2.ldr
+flash "v1 smaller image" img3.ldr -1
+flash "v2 after v1" img1.ldr
+
+echo
+cat $WORK/sim.log | tail -n +2
+
+if [ $FAILS -ne 0 ]; then
+    echo
+    echo "$FAILS sessions failed"
+    exit 2
+fi
+exit 0